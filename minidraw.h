@@ -108,6 +108,22 @@ typedef void* md_handle;
 typedef void* md_ptr;
 typedef void (* md_proc)(void);
 
+/* Threading. These are only used internally, but they need to be declared here so they can be stored in public structures. */
+#if defined(MD_WIN32)
+typedef md_handle md_thread;
+typedef md_handle md_mutex;
+typedef md_handle md_semaphore;
+#else
+typedef pthread_t md_thread;
+typedef pthread_mutex_t md_mutex;
+typedef struct
+{
+    int value;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} md_semaphore;
+#endif
+
 #if defined(_MSC_VER) && !defined(_WCHAR_T_DEFINED)
 typedef md_uint16 wchar_t;
 #endif
@@ -161,6 +177,7 @@ typedef md_uint32 md_utf32;
     #define MD_SUPPORT_CAIRO
     #define MD_SUPPORT_XFT
 #endif
+#define MD_SUPPORT_SOFTWARE    /* The software backend has no dependencies and is supported everywhere. */
 
 /* Backends */
 #if !defined(MD_NO_GDI) && defined(MD_SUPPORT_GDI)
@@ -178,6 +195,9 @@ typedef md_uint32 md_utf32;
 #if !defined(MD_NO_XFT) && defined(MD_SUPPORT_XFT)
     #define MD_ENABLE_XFT
 #endif
+#if !defined(MD_NO_SOFTWARE) && defined(MD_SUPPORT_SOFTWARE)
+    #define MD_ENABLE_SOFTWARE
+#endif
 
 
 /* Result Codes */
@@ -229,6 +249,7 @@ typedef enum
     /*md_backend_coregraphics,*/   /* Typography via Core Text */
     md_backend_cairo,         /* Typography via Pango */
     /*md_backend_xft*/             /* Typography via minidraw */
+    md_backend_software,      /* Typography via a built-in bitmap font */
     md_backend_custom
 } md_backend;
 
@@ -292,6 +313,13 @@ typedef enum
     md_antialias_mode_subpixel = 3  /* ClearType RGB style anti-aliasing. Falls back to md_antialias_mode_gray if unavailable. */
 } md_antialias_mode;
 
+typedef enum
+{
+    md_fast_shaping_mode_auto     = 0,  /* Default. Runs of printable ASCII are shaped from a table when the font has been found to not kern or substitute them. */
+    md_fast_shaping_mode_enabled  = 1,  /* Runs of printable ASCII are always shaped from a table. Kerning and ligatures are ignored. */
+    md_fast_shaping_mode_disabled = 2   /* Everything is shaped by the backend. */
+} md_fast_shaping_mode;
+
 typedef enum
 {
     md_fill_mode_winding = 0,       /* Default. */
@@ -323,6 +351,13 @@ typedef enum
     md_alignment_center,
 } md_alignment;
 
+typedef enum
+{
+    md_text_wrap_mode_none = 0,     /* Default. Lines are only ended by new-line characters. */
+    md_text_wrap_mode_word,         /* Lines are wrapped at the break opportunities defined by UAX #14. Words too long to fit on a line by themselves are broken between characters. */
+    md_text_wrap_mode_char          /* Lines are wrapped between any two characters. */
+} md_text_wrap_mode;
+
 /* Structures */
 #if defined(MD_SUPPORT_GDI)
 #if defined(__GNUC__)
@@ -453,6 +488,23 @@ typedef struct
     md_int32 advanceY;
 } md_glyph_metrics;
 
+typedef struct
+{
+    md_uint64 hitCount;     /* The number of glyphs that were drawn straight from the cache. */
+    md_uint64 missCount;    /* The number of glyphs that needed to be rendered before they could be drawn. */
+    md_uint32 glyphCount;   /* The number of glyphs currently in the cache. */
+    md_uint32 capacity;     /* The number of glyphs the cache can hold before it is flushed. */
+} md_glyph_cache_stats;
+
+typedef struct
+{
+    md_uint64 hitCount;         /* The number of calls to md_shape_utf8() that were satisfied by the cache. */
+    md_uint64 missCount;        /* The number of calls to md_shape_utf8() that needed to go to the backend. */
+    md_uint32 runCount;         /* The number of shaped runs currently in the cache. */
+    size_t sizeInBytes;         /* The amount of memory currently used by the cached runs. */
+    size_t capacityInBytes;     /* The maximum amount of memory the cached runs can use. */
+} md_shape_cache_stats;
+
 typedef struct
 {
     md_int32 boundsX;
@@ -464,6 +516,7 @@ typedef struct
     md_rect padding;
     md_alignment alignmentX;
     md_alignment alignmentY;
+    md_text_wrap_mode wrapMode; /* Lines are wrapped to fit inside the bounds, less the padding and border. Ignored when singleLine is set. */
     md_int32 borderWidth;       /* When positive, draws the border on the inside of the bounds. When negative draws it on the outside. */
     md_color borderColor;
     md_int32 tabWidthInPixels;  /* When 0, falls back to tabSizeInSpaces. */
@@ -492,7 +545,14 @@ typedef struct
         struct
         {
             /*PangoItem**/ md_ptr pPangoItem;
+            md_font* pFont;     /* The font that was used to itemize. */
         } cairo;
+    #endif
+    #if defined(MD_SUPPORT_SOFTWARE)
+        struct
+        {
+            md_font* pFont;     /* The font to use when drawing this item. */
+        } software;
     #endif
         md_uint32 _unused;
     } backend;
@@ -513,12 +573,30 @@ typedef struct
     } backend;
 } md_itemize_state;
 
+/*
+The output of itemization. Items are added with md_item_buffer_push(). When the buffer is full it is grown with onGrow, or if onGrow is NULL the
+rest of the items are only counted so the caller can find out how much room is needed. This allows the whole text to be itemized in one pass no
+matter how many items it ends up with.
+*/
+typedef struct md_item_buffer md_item_buffer;
+typedef md_result (* md_item_buffer_grow_proc)(md_item_buffer* pBuffer, md_uint32 newCapacity);   /* Must update pItems and capacity. */
+
+struct md_item_buffer
+{
+    md_item* pItems;                    /* Can be NULL, in which case items are only counted. */
+    md_uint32 capacity;
+    md_uint32 count;                    /* Includes any items that did not fit. */
+    md_item_buffer_grow_proc onGrow;    /* Optional. */
+    void* pUserData;
+};
+
 
 typedef void      (* md_uninit_proc)                      (md_api* pAPI);
-typedef md_result (* md_itemize_utf8_proc)                (md_font* pFont, const md_utf8* pTextUTF8, size_t textLength, md_item* pItems, md_uint32* pItemCount, md_itemize_state* pItemizeState);
-typedef md_result (* itemize_utf16_proc)                  (md_font* pFont, const md_utf16* pTextUTF16, size_t textLength, md_item* pItems, md_uint32* pItemCount, md_itemize_state* pItemizeState);
-typedef md_result (* itemize_utf32_proc)                  (md_font* pFont, const md_utf32* pTextUTF32, size_t textLength, md_item* pItems, md_uint32* pItemCount, md_itemize_state* pItemizeState);
+typedef md_result (* md_itemize_utf8_proc)                (md_font* pFont, const md_utf8* pTextUTF8, size_t textLength, md_item_buffer* pItems, md_itemize_state* pItemizeState);
+typedef md_result (* itemize_utf16_proc)                  (md_font* pFont, const md_utf16* pTextUTF16, size_t textLength, md_item_buffer* pItems, md_itemize_state* pItemizeState);
+typedef md_result (* itemize_utf32_proc)                  (md_font* pFont, const md_utf32* pTextUTF32, size_t textLength, md_item_buffer* pItems, md_itemize_state* pItemizeState);
 typedef void      (* free_itemize_state_proc)             (md_itemize_state* pItemizeState);
+typedef md_uint64 (* item_get_analysis_key_proc)          (const md_item* pItem);
 typedef md_result (* shape_utf8_proc)                     (md_font* pFont, md_item* pItem, const md_utf8* pTextUTF8, size_t textLength, md_glyph* pGlyphs, size_t* pGlyphCount, size_t* pClusters, md_text_metrics* pRunMetrics);
 typedef md_result (* shape_utf16_proc)                    (md_font* pFont, md_item* pItem, const md_utf16* pTextUTF16, size_t textLength, md_glyph* pGlyphs, size_t* pGlyphCount, size_t* pClusters, md_text_metrics* pRunMetrics);
 typedef md_result (* shape_utf32_proc)                    (md_font* pFont, md_item* pItem, const md_utf32* pTextUTF32, size_t textLength, md_glyph* pGlyphs, size_t* pGlyphCount, size_t* pClusters, md_text_metrics* pRunMetrics);
@@ -526,6 +604,7 @@ typedef md_result (* font_init_proc)                      (md_api* pAPI, const m
 typedef void      (* font_uninit_proc)                    (md_font* pFont);
 typedef md_result (* font_get_glyph_metrics_proc)         (md_font* pFont, const md_glyph* pGlyphs, size_t glyphCount, md_glyph_metrics* pGlyphMetrics);
 typedef md_result (* font_get_glyph_metrics_by_index_proc)(md_font* pFont, const md_uint32* pGlyphIndices, size_t glyphCount, md_glyph_metrics* pGlyphMetrics);
+typedef md_result (* font_get_glyph_cache_stats_proc)     (md_font* pFont, md_glyph_cache_stats* pStats);
 typedef md_result (* brush_init_proc)                     (md_api* pAPI, const md_brush_config* pConfig, md_brush* pBrush);
 typedef void      (* brush_uninit_proc)                   (md_brush* pBrush);
 typedef void      (* brush_set_origin_proc)               (md_brush* pBrush, md_int32 x, md_int32 y);
@@ -570,6 +649,7 @@ typedef void      (* gc_close_path_proc)                  (md_gc* pGC);
 typedef void      (* gc_clip_proc)                        (md_gc* pGC);
 typedef void      (* gc_reset_clip_proc)                  (md_gc* pGC);
 typedef md_bool32 (* gc_is_point_inside_clip_proc)        (md_gc* pGC, md_int32 x, md_int32 y);
+typedef md_result (* gc_get_clip_bounds_proc)             (md_gc* pGC, md_int32* pLeft, md_int32* pTop, md_int32* pRight, md_int32* pBottom);
 typedef void      (* gc_fill_proc)                        (md_gc* pGC);
 typedef void      (* gc_stroke_proc)                      (md_gc* pGC);
 typedef void      (* gc_fill_and_stroke_proc)             (md_gc* pGC);
@@ -584,6 +664,7 @@ typedef struct
     itemize_utf16_proc                   itemizeUTF16;
     itemize_utf32_proc                   itemizeUTF32;
     free_itemize_state_proc              freeItemizeState;
+    item_get_analysis_key_proc           itemGetAnalysisKey;
     shape_utf8_proc                      shapeUTF8;
     shape_utf16_proc                     shapeUTF16;
     shape_utf32_proc                     shapeUTF32;
@@ -591,6 +672,7 @@ typedef struct
     font_uninit_proc                     fontUninit;
     font_get_glyph_metrics_proc          fontGetGlyphMetrics;
     font_get_glyph_metrics_by_index_proc fontGetGlyphMetricsByIndex;
+    font_get_glyph_cache_stats_proc      fontGetGlyphCacheStats;
     brush_init_proc                      brushInit;
     brush_uninit_proc                    brushUninit;
     brush_set_origin_proc                brushSetOrigin;
@@ -635,6 +717,7 @@ typedef struct
     gc_clip_proc                         gcClip;
     gc_reset_clip_proc                   gcResetClip;
     gc_is_point_inside_clip_proc         gcIsPointInsideClip;
+    gc_get_clip_bounds_proc              gcGetClipBounds;
     gc_fill_proc                         gcFill;
     gc_stroke_proc                       gcStroke;
     gc_fill_and_stroke_proc              gcFillAndStroke;
@@ -727,6 +810,13 @@ struct md_api
     {
         int _unused;
     } xft;
+#endif
+#if defined(MD_SUPPORT_SOFTWARE)
+    struct
+    {
+        md_bool32 useSSE2 : 1;          /* Whether or not span compositing uses SSE2. Detected at initialization time. */
+        md_bool32 useAVX2 : 1;          /* Whether or not span compositing uses AVX2. Takes priority over SSE2. */
+    } software;
 #endif
     struct
     {
@@ -742,19 +832,130 @@ struct md_font_config
     md_font_weight weight;
     md_font_slant slant;
     md_antialias_mode antialiasMode;    /* Preferred anti-aliasing to use with this font. This is just a hint. */
+    size_t shapeCacheSizeInBytes;       /* The maximum amount of memory to use for caching the output of md_shape_utf8(). Set to 0 (the default) to disable caching. */
+    md_fast_shaping_mode fastShapingMode;   /* Controls whether or not md_shape_utf8() can skip the backend for runs of printable ASCII. Mainly useful for verifying the fast path. */
     void* pUserData;
     struct
     {
         /*PangoFontMap**/ md_ptr pPangoFontMap; /* Custom application-defined PangoFontMap to use when creating the font. */
         /*PangoContext**/ md_ptr pPangoContext; /* Custom application-defined PangoContext to use when creating the font. */
     } cairo;
+    struct
+    {
+        md_uint32 glyphCacheCapacity;   /* The maximum number of rendered glyphs to keep around. Defaults to 1024 when set to 0. */
+    } software;
+};
+
+/*
+Temporary memory for the text functions, such as the items and glyphs of the text being drawn. Memory is allocated and released in stack
+order and is kept around for the next call. When a block runs out a bigger one is chained onto it, and once everything has been released
+the blocks are merged into a single block so that the same amount of memory can be handed out again without going to the heap.
+*/
+typedef struct md_scratch_block md_scratch_block;
+struct md_scratch_block
+{
+    md_scratch_block* pPrev;
+    size_t offset;                      /* The position of this block within the scratch memory as a whole. Marks are in terms of this. */
+    size_t sizeInBytes;
+    size_t cursor;                      /* The offset of the next allocation from the start of the block's memory. */
+};
+
+typedef struct
+{
+    md_scratch_block* pBlock;           /* The block allocations are made from. Older blocks are linked from this. */
+    size_t wantedSizeInBytes;           /* The most memory that's been needed at the same time. */
+} md_scratch;
+
+typedef struct md_shape_cache_entry md_shape_cache_entry;
+struct md_shape_cache_entry
+{
+    md_shape_cache_entry* pNextInBucket;
+    md_shape_cache_entry* pPrev;        /* The next most recently used entry. */
+    md_shape_cache_entry* pNext;        /* The next least recently used entry. */
+    md_uint64 hash;                     /* The hash of analysisKey and the text. */
+    md_uint64 analysisKey;              /* From md_api_procs.itemGetAnalysisKey. Identifies everything other than the text that affects shaping. */
+    size_t sizeInBytes;                 /* The size of the allocation holding this entry. */
+    size_t textLength;
+    size_t glyphCount;
+    md_text_metrics runMetrics;
+    md_utf8* pText;                     /* These point to memory allocated along with the entry. */
+    md_glyph* pGlyphs;
+    size_t* pClusters;                  /* textLength in size. */
 };
 
+typedef struct
+{
+    md_shape_cache_entry** ppBuckets;
+    md_uint32 bucketCount;              /* Always a power of two. */
+    md_uint32 entryCount;
+    md_shape_cache_entry* pHead;        /* The most recently used entry. */
+    md_shape_cache_entry* pTail;        /* The least recently used entry. This is the first to be evicted. */
+    size_t sizeInBytes;
+    size_t capacityInBytes;             /* Zero when the cache is disabled. */
+    md_uint64 hitCount;
+    md_uint64 missCount;
+} md_shape_cache;
+
+#define MD_FAST_SHAPING_CHAR_COUNT  95  /* The printable ASCII characters, from the space to the tilde. */
+#define MD_FAST_SHAPING_MAX_TABLES  8
+
+typedef struct
+{
+    md_uint64 analysisKey;              /* From md_api_procs.itemGetAnalysisKey. The table is only used for items with this analysis. */
+    md_bool32 isValid;                  /* Whether or not every character could be shaped to exactly one glyph. The table is never used when this is false. */
+    md_bool32 isSafe;                   /* Whether or not shaping from the table matches the backend. False when the font kerns or substitutes any pair of characters. */
+    md_glyph glyphs[MD_FAST_SHAPING_CHAR_COUNT];
+    md_int32 lPadding[MD_FAST_SHAPING_CHAR_COUNT];
+    md_int32 rPadding[MD_FAST_SHAPING_CHAR_COUNT];
+} md_fast_shaping_table;
+
+#if defined(MD_SUPPORT_SOFTWARE)
+typedef struct
+{
+    md_uint32 key;                      /* The glyph index combined with the subpixel position and anti-aliasing mode it was rendered with. */
+    md_uint32 page;                     /* The atlas page the coverage lives in. */
+    md_uint16 x;                        /* The position of the coverage within the page. */
+    md_uint16 y;
+    md_uint16 sizeX;                    /* The size of the coverage. Zero for glyphs with nothing to draw. */
+    md_uint16 sizeY;
+    md_int16 offsetX;                   /* The position of the coverage relative to the glyph's origin. Only the area around the lit cells is stored. */
+    md_int16 offsetY;
+} md_glyph_cache_entry_software;
+
+typedef struct
+{
+    md_glyph_cache_entry_software* pEntries;
+    md_uint32 entryCount;
+    md_uint32 capacity;                 /* The maximum number of entries. The whole cache is flushed when it is reached. */
+    md_uint32* pSlots;                  /* Open addressing hash table. Each slot is an index into pEntries plus one, or zero when empty. */
+    md_uint32 slotMask;                 /* The number of slots minus one. Always a power of two. */
+    md_uint8** ppPages;                 /* Atlas pages of MD_SOFTWARE_GLYPH_ATLAS_SIZE*MD_SOFTWARE_GLYPH_ATLAS_SIZE coverage values. */
+    md_uint32 pageCount;
+    md_uint32 pageCap;
+    md_uint32 shelfX;                   /* Glyphs are packed into horizontal shelves on the last page. This is the next free spot on the current shelf. */
+    md_uint32 shelfY;
+    md_uint32 shelfHeight;
+    md_uint64 hitCount;
+    md_uint64 missCount;
+} md_glyph_cache_software;
+#endif
+
 struct md_font
 {
     md_api* pAPI;   /* The md_api object that was used to initialize the font. */
     void* pUserData;
     md_font_metrics metrics;
+    md_shape_cache shapeCache;  /* Shaped runs keyed by the item's analysis and text. Only used when md_font_config.shapeCacheSizeInBytes is non-zero. */
+    md_fast_shaping_mode fastShapingMode;
+    md_fast_shaping_table* pFastShapingTables;  /* One for each analysis that printable ASCII has been shaped with. Built on first use. */
+    md_uint32 fastShapingTableCount;
+    md_scratch scratch;         /* For items, glyphs and text conversions while itemizing, shaping and laying out text. */
+    struct
+    {
+        md_int32 lineSizeY;             /* The ascent minus the descent. Every line of text is this high. */
+        md_int32 spaceSizeX;            /* The advance of a space. Tab stops are based on this. */
+        md_bool32 hasSpaceSizeX;        /* Set once spaceSizeX has been retrieved. It needs shaping so it's done on first use. */
+    } metricsCache;
 
 #if defined(MD_SUPPORT_GDI)
     struct
@@ -789,6 +990,13 @@ struct md_font
         int _unused;
     } xft;
 #endif
+#if defined(MD_SUPPORT_SOFTWARE)
+    struct
+    {
+        md_uint32 scale;                /* The built-in font is 8x8. This is the number of pixels each cell of the font takes up in each dimension. */
+        md_glyph_cache_software glyphCache; /* Rendered glyphs. Filled lazily by md_gc_draw_glyphs(). Not thread-safe, same as the font objects of other backends. */
+    } software;
+#endif
 };
 
 typedef struct
@@ -801,7 +1009,7 @@ struct md_brush_config
 {
     md_brush_type type;
     void* pUserData;
-    md_color_stop* pColorStops; /* Only used with linear and radial brushes. */
+    md_color_stop* pColorStops; /* Only used with linear and radial brushes. Must be in increasing order of offset. */
     md_uint32 colorStopCount;
     struct
     {
@@ -809,10 +1017,10 @@ struct md_brush_config
     } solid;
     struct
     {
-        md_int32 x0;
+        md_int32 x0;        /* The start point. This is where offset 0 of the color stops is. */
         md_int32 y0;
-        md_int32 x1;
-        md_int32 x2;
+        md_int32 x1;        /* The end point. This is where offset 1 of the color stops is. */
+        md_int32 y1;
     } linear;
     struct
     {
@@ -852,6 +1060,14 @@ struct md_brush
         /*cairo_surface_t**/ md_ptr pCairoSurface;  /* Only used when the source is a cairo surface of a transient GC. */
     } cairo;
 #endif
+#if defined(MD_SUPPORT_SOFTWARE)
+    struct
+    {
+        md_int32 originX;
+        md_int32 originY;
+        md_uint32* pRamp;               /* The color stops baked into MD_SOFTWARE_GRADIENT_RAMP_SIZE premultiplied ARGB colors. Linear and radial brushes only. */
+    } software;
+#endif
 };
 
 struct md_gc_config
@@ -875,6 +1091,14 @@ struct md_gc_config
         /*cairo_t**/ md_ptr pCairoContext;
     } cairo;
 #endif
+#if defined(MD_SUPPORT_SOFTWARE)
+    struct
+    {
+        void* pImageData;               /* Optional application-defined buffer to render into. Premultiplied 32-bit 0xAARRGGBB pixels. Must remain valid for the life of the GC. Uses stride, or sizeX when stride is 0. */
+        md_uint32 threadCount;          /* The number of threads to render with, including the calling thread. Set to 0 or 1 to render everything on the calling thread. */
+        md_uint32 tileSize;             /* The height in pixels of each of the tiles the surface is split into when threadCount is greater than 1. Defaults to 64 when set to 0. */
+    } software;
+#endif
 };
 
 #if defined(MD_SUPPORT_GDI)
@@ -911,6 +1135,120 @@ typedef struct
     md_bool32 hasTransientLineBrush : 1;
 } md_gc_state_cairo;
 #endif
+#if defined(MD_SUPPORT_SOFTWARE)
+typedef struct
+{
+    float* pPoints;                     /* Interleaved X/Y pairs in device space. */
+    md_uint32 pointCount;
+    md_uint32 pointCap;
+    md_uint32* pContourEnds;            /* The index of the point one past the end of each contour. The top bit is set for closed contours. */
+    md_uint32 contourCount;
+    md_uint32 contourCap;
+} md_polygon_software;
+
+typedef struct
+{
+    md_uint8* pCommands;                /* MD_SOFTWARE_PATH_* */
+    md_uint32 commandCount;
+    md_uint32 commandCap;
+    float* pPoints;                     /* Interleaved X/Y pairs in device space. Transformed by the matrix at the time the segment was added. */
+    md_uint32 pointCount;
+    md_uint32 pointCap;
+    float startX;                       /* The start of the current sub-path. This is where the current point moves to after closing the path. */
+    float startY;
+    float currentX;
+    float currentY;
+    md_polygon_software flattened;      /* The path converted to straight line segments. Only rebuilt when the path has changed since it was last flattened. */
+    md_bool32 hasCurrentPoint : 1;
+    md_bool32 isFlattenedValid : 1;     /* Cleared whenever a segment is added to the path. */
+} md_path_software;
+
+typedef struct
+{
+    float x0;                           /* Edges always go top to bottom. y0 < y1. */
+    float y0;
+    float x1;
+    float y1;
+    md_int32 dir;                       /* 1 if the original edge went downwards, -1 if it went upwards. */
+} md_edge_software;
+
+typedef struct
+{
+    md_int32 x;
+    md_int32 y;
+    float cover;                        /* The signed height of the parts of edges that pass through this cell. */
+    float area;                         /* The signed area of this cell that is to the right of those edges. */
+} md_cell_software;
+
+typedef struct
+{
+    md_uint32* pActiveEdges;            /* Scratch buffers for the aliased rasterizer. Each of these has a capacity of activeEdgeCap. */
+    float* pCrossings;
+    md_uint32 activeEdgeCap;
+    md_cell_software* pCells;           /* Scratch buffer for the anti-aliased rasterizer. Only the cells touched by an edge are stored. */
+    md_uint32 cellCount;
+    md_uint32 cellCap;
+    md_uint32* pSpanSrc;                /* Scratch buffer for one scanline of source pixels. Also owns the memory of pSpanMask and pCoverage. */
+    md_uint8* pSpanMask;                /* Scratch buffer for one scanline of coverage values combined with the clip. sizeX in length. */
+    md_uint8* pCoverage;                /* Scratch buffer for one scanline of coverage values. sizeX in length. */
+} md_rasterizer_software;               /* The scratch memory needed by a single thread to rasterize and composite a polygon. */
+
+typedef struct
+{
+    md_gc* pGC;
+    md_thread thread;
+    md_rasterizer_software rasterizer;
+} md_worker_software;
+
+typedef struct
+{
+    float halfWidth;                    /* In device space. */
+    md_line_cap lineCap;
+    md_line_join lineJoin;
+    float miterLimit;
+    md_uint32 dashCount;
+    float dashes[16];                   /* In device space. */
+    md_bool32 isHairline : 1;           /* Set when the line is no more than a pixel wide. Round and bevel joins are skipped for these. */
+} md_stroke_params_software;
+
+typedef struct
+{
+    md_uint32 refCount;                 /* The number of states sharing the mask. A mask is never modified once it has been built. */
+    md_int32 left;                      /* The area of the surface covered by the mask, in pixels. */
+    md_int32 top;
+    md_uint32 sizeX;
+    md_uint32 sizeY;
+    md_uint8* pCoverage;                /* One byte of coverage per pixel. sizeX*sizeY in size. Allocated along with the mask. */
+} md_clip_mask_software;
+
+typedef struct
+{
+    md_matrix matrix;
+    float lineWidth;
+    md_line_cap lineCap;
+    md_line_join lineJoin;
+    float miterLimit;
+    md_uint32 dashCount;
+    float dashes[16];
+    md_blend_op blendOp;
+    md_antialias_mode antialiasMode;
+    md_fill_mode fillMode;
+    md_stretch_filter stretchFilter;
+    md_color textFGColor;
+    md_color textBGColor;
+    md_brush* pFillBrush;
+    md_brush* pLineBrush;
+    md_brush_config transientFillBrush;
+    md_brush_config transientLineBrush;
+    md_int32 clipLeft;                  /* The clip rectangle in pixels. Nothing outside of it is drawn. This is the bounds of the surface when there is no clip. */
+    md_int32 clipTop;
+    md_int32 clipRight;
+    md_int32 clipBottom;
+    md_clip_mask_software* pClipMask;   /* Coverage within the clip rectangle for clips that are not rectangles. NULL when the rectangle is the whole clip. */
+    md_bool32 hasTransientFillBrush : 1;
+    md_bool32 hasTransientLineBrush : 1;
+} md_gc_state_software;
+#endif
 
 struct md_gc
 {
@@ -918,6 +1256,7 @@ struct md_gc
     void* pUserData;
     md_format format;
     md_bool32 isTransient : 1;
+    md_scratch scratch;                 /* For converting glyphs to the backend's format when drawing them. */
 
 #if defined(MD_SUPPORT_GDI)
     struct
@@ -963,6 +1302,41 @@ struct md_gc
         int _unused;
     } xft;
 #endif
+#if defined(MD_SUPPORT_SOFTWARE)
+    struct
+    {
+        md_uint32* pImageData;          /* Premultiplied 0xAARRGGBB. */
+        md_uint32 sizeX;
+        md_uint32 sizeY;
+        md_uint32 stride;               /* In pixels. */
+        md_path_software path;          /* The current path. */
+        md_polygon_software stroke;     /* The fill geometry of the most recent stroke. Reused when the same outline is stroked again with the same parameters. */
+        md_polygon_software strokeSource;   /* A copy of the flattened path that was used to generate the geometry in stroke. */
+        md_stroke_params_software strokeParams; /* The parameters that were used to generate the geometry in stroke. */
+        md_polygon_software strokeContour;  /* Scratch buffers for the stroker. */
+        md_polygon_software strokeDash;
+        md_polygon_software scratch;    /* General purpose scratch geometry for drawing glyphs and images. */
+        md_edge_software* pEdges;       /* The edges of the polygon being rasterized. Shared between threads. */
+        md_uint32 edgeCap;
+        md_rasterizer_software rasterizer;  /* Scratch memory for rasterizing on the calling thread. */
+        md_worker_software* pWorkers;   /* The threads that help the calling thread render tiles. NULL when rendering on a single thread. */
+        md_uint32 workerCount;
+        md_uint32 tileSize;             /* The height of each tile in pixels. */
+        md_uint32* pTileBins;           /* The offset of the first edge of each tile, then a per-tile cursor, then the edge indices of each tile. */
+        md_uint32 tileBinCap;
+        md_mutex tileLock;              /* Protects nextTile and the result of the current tile job. */
+        md_semaphore workSemaphore;     /* Released once for each worker that should pick up pTileJob. */
+        md_semaphore doneSemaphore;     /* Released by a worker each time it has finished with pTileJob. */
+        void* pTileJob;                 /* The tile job currently being run. */
+        md_uint32 nextTile;             /* The next tile to be picked up by a thread. */
+        md_bool32 isTerminating;        /* Set when the workers need to exit. */
+        md_gc_state_software* pState;   /* Heap allocated via realloc() for now. May change to a per-API allocation scheme. */
+        md_uint32 stateCap;             /* The capacity of pState. */
+        md_uint32 stateCount;           /* The number of valid items in pState. */
+        md_bool32 ownsImageData : 1;    /* When set to true, pImageData will be freed in md_gc_uninit(). */
+        md_bool32 isStrokeValid : 1;    /* Whether or not stroke, strokeSource and strokeParams are valid. */
+    } software;
+#endif
 };
 
 
@@ -1354,10 +1728,15 @@ MD_INVALID_ARGS will be returned if [pFont] is NULL, [pText] is NULL, [textLengt
 
 MD_NO_SPACE will be returned when [pItems] is not large enough to contain the items. In this case, [pItemCount] will be set to the required count.
 
+The itemize state only needs to be freed when MD_SUCCESS is returned.
+
 Remarks
 -------
 This is the first function you should call when preparing text for drawing.
 
+Use md_itemize_utf8_to_buffer() if you don't want to guess the item count ahead of time. Retrying with a bigger buffer after MD_NO_SPACE means the
+text gets itemized twice.
+
 Some backends will perform font fallback at this point. This is why [pFont] is required. Other backends may defer font fallback to md_shape_*().
 
 Example
@@ -1377,6 +1756,35 @@ if (result == MD_SUCCESS) {
 */
 md_result md_itemize_utf8(md_font* pFont, const md_utf8* pTextUTF8, size_t textLength, md_item* pItems, md_uint32* pItemCount, md_itemize_state* pItemizeState);
 
+/*
+The same as md_itemize_utf8(), except for UTF-16 and UTF-32 text. Item offsets and lengths are in code units of the input encoding.
+
+Backends itemize natively in their own encoding. When this differs from the input encoding the text is converted once up front and the items are
+mapped back to the input encoding.
+*/
+md_result md_itemize_utf16(md_font* pFont, const md_utf16* pTextUTF16, size_t textLength, md_item* pItems, md_uint32* pItemCount, md_itemize_state* pItemizeState);
+md_result md_itemize_utf32(md_font* pFont, const md_utf32* pTextUTF32, size_t textLength, md_item* pItems, md_uint32* pItemCount, md_itemize_state* pItemizeState);
+
+/*
+The same as md_itemize_utf8(), except the items are appended to an md_item_buffer. When the buffer has an onGrow callback it is called whenever
+the buffer is full which means the text is only ever itemized once, regardless of how many items there are. Use this for large amounts of text
+where the item count cannot be guessed ahead of time.
+
+Items are appended after any that are already in the buffer. On output, [pItems]->count is the total item count.
+
+MD_NO_SPACE is returned when the buffer does not have an onGrow callback and is not large enough, in which case [pItems]->count will be set to the
+required count. MD_OUT_OF_MEMORY is returned if onGrow fails.
+*/
+md_result md_itemize_utf8_to_buffer(md_font* pFont, const md_utf8* pTextUTF8, size_t textLength, md_item_buffer* pItems, md_itemize_state* pItemizeState);
+md_result md_itemize_utf16_to_buffer(md_font* pFont, const md_utf16* pTextUTF16, size_t textLength, md_item_buffer* pItems, md_itemize_state* pItemizeState);
+md_result md_itemize_utf32_to_buffer(md_font* pFont, const md_utf32* pTextUTF32, size_t textLength, md_item_buffer* pItems, md_itemize_state* pItemizeState);
+
+/*
+Adds an item to the end of an md_item_buffer and returns a pointer to it, growing the buffer if necessary. NULL is returned if the item does not fit,
+in which case it is still counted. This is intended for use by backends.
+*/
+md_item* md_item_buffer_push(md_item_buffer* pBuffer);
+
 /*
 Frees the itemization state returned from md_itemize_*(). You should call this when you are finished with the items returned from md_itemize_*().
 */
@@ -1415,9 +1823,26 @@ Remarks
 You should call md_itemize_utf8() before calling this function.
 
 You can determine the number glyphs required for the input string by calling this with [pGlyphs] set the NULL.
+
+When the font was initialized with a non-zero md_font_config.shapeCacheSizeInBytes the output is cached. Calling this again with the same text and an
+item with the same analysis will not go back to the backend. This makes repeatedly measuring and drawing the same strings much cheaper.
+
+Runs made up entirely of printable ASCII characters are shaped from a per-font table rather than by the backend. By default this only happens when
+the font has been checked to not kern or substitute any pair of these characters, in which case the output is identical. This can be controlled
+with md_font_config.fastShapingMode.
 */
 md_result md_shape_utf8(md_font* pFont, md_item* pItem, const md_utf8* pTextUTF8, size_t textLength, md_glyph* pGlyphs, size_t* pGlyphCount, size_t* pClusters, md_text_metrics* pRunMetrics);
 
+/*
+The same as md_shape_utf8(), except for UTF-16 and UTF-32 text. [pItem] must have come from md_itemize_utf16() or md_itemize_utf32() respectively,
+and [pClusters] is indexed by code units of the input encoding.
+
+When the backend cannot shape the input encoding natively the run is converted and shaped through md_shape_utf8() so it can still make use of the
+shape cache.
+*/
+md_result md_shape_utf16(md_font* pFont, md_item* pItem, const md_utf16* pTextUTF16, size_t textLength, md_glyph* pGlyphs, size_t* pGlyphCount, size_t* pClusters, md_text_metrics* pRunMetrics);
+md_result md_shape_utf32(md_font* pFont, md_item* pItem, const md_utf32* pTextUTF32, size_t textLength, md_glyph* pGlyphs, size_t* pGlyphCount, size_t* pClusters, md_text_metrics* pRunMetrics);
+
 
 /*
 Measure the length of a glyph string in pixels.
@@ -1435,6 +1860,73 @@ Retrieves the position within a string that contains the given Unicode code poin
 md_result md_index_to_x(md_api* pAPI, const md_item* pItem, size_t index, size_t textLength, const size_t* pClusters, const md_glyph* pGlyphs, size_t glyphCount, md_int32* pX);
 
 
+/*
+A precomputed index of a shaped run for hit testing. md_x_to_index() and md_index_to_x() walk the glyphs on every call. With a run index, mapping
+a position to a code unit is a binary search and mapping a code unit to a position is a lookup. Use this when the same run is queried many times,
+such as when dragging a selection across a long line.
+
+The run index refers to the run's cluster array. It must stay valid for as long as the run index is being used.
+*/
+typedef struct
+{
+    const size_t* pClusters;    /* The cluster array of the run. Not owned by the run index. */
+    md_int32* pGlyphX;          /* The position of each glyph relative to the start of the run. */
+    size_t* pGlyphClusters;     /* The first code unit of each glyph. Glyphs without a code unit of their own take the one of the glyph before them. */
+    size_t glyphCount;
+    size_t textLength;
+    md_int32 sizeX;             /* The sum of the advances of every glyph. */
+    void* pHeap;
+} md_run_index;
+
+/*
+Builds the index of a run that has been shaped with md_shape_utf8().
+*/
+md_result md_run_index_init(const size_t* pClusters, size_t textLength, const md_glyph* pGlyphs, size_t glyphCount, md_run_index* pRunIndex);
+
+/*
+Frees the memory of a run index.
+*/
+void md_run_index_uninit(md_run_index* pRunIndex);
+
+/*
+Retrieves the code unit under each of the given positions. This is the batched equivalent of md_x_to_index().
+
+[pOffsetsToEdge] is optional.
+*/
+md_result md_run_index_x_to_index(const md_run_index* pRunIndex, const md_int32* pX, size_t count, size_t* pIndices, md_int32* pOffsetsToEdge);
+
+/*
+Retrieves the position of each of the given code units. This is the batched equivalent of md_index_to_x().
+*/
+md_result md_run_index_index_to_x(const md_run_index* pRunIndex, const size_t* pIndices, size_t count, md_int32* pX);
+
+/*
+Finds the positions in a string where a line is allowed to be broken as defined by UAX #14, the Unicode Line Breaking Algorithm.
+
+[pTextUTF8](in)
+    The text to find the break opportunities of.
+
+[textLength](in)
+    The length of the text in code units.
+
+[pBreaks](out)
+    A pointer to a buffer of at least [textLength] elements. Each element receives MD_LINE_BREAK_ALLOWED if the line can be broken before the
+    corresponding code unit, MD_LINE_BREAK_MANDATORY if it must be broken before it, or 0 if it can't be broken there.
+
+Remarks
+-------
+The first element is always 0. Elements for code units in the middle of a code point are always 0.
+
+Mandatory breaks are reported after new-line characters. The break at the very end of the text is not reported since there is nowhere to put it.
+
+Some rules require information beyond the line breaking class of a character such as the East Asian width or general category. These are
+not currently implemented. Complex scripts (class SA) are treated as alphabetic which means they will only be broken at spaces.
+*/
+#define MD_LINE_BREAK_ALLOWED       1
+#define MD_LINE_BREAK_MANDATORY     2
+md_result md_find_line_breaks_utf8(const md_utf8* pTextUTF8, size_t textLength, md_uint8* pBreaks);
+
+
 /**************************************************************************************************************************************************************
 
 Fonts
@@ -1464,10 +1956,28 @@ Retrieves the metrics of the given glyphs by their index.
 */
 md_result md_font_get_glyph_metrics_by_index(md_font* pFont, const md_uint32* pGlyphIndices, size_t glyphCount, md_glyph_metrics* pGlyphMetrics);
 
+/*
+Retrieves statistics about the font's cache of shaped runs. Use this to tune md_font_config.shapeCacheSizeInBytes.
+
+Returns MD_INVALID_OPERATION if the cache was not enabled when the font was initialized.
+*/
+md_result md_font_get_shape_cache_stats(md_font* pFont, md_shape_cache_stats* pStats);
+
+/*
+Retrieves statistics about the font's cache of rendered glyphs. Use this to tune md_font_config.software.glyphCacheCapacity.
+
+Returns MD_INVALID_OPERATION if the backend does not cache glyphs itself. Only the software backend does this.
+*/
+md_result md_font_get_glyph_cache_stats(md_font* pFont, md_glyph_cache_stats* pStats);
+
 /*
 Measures a string of text.
+
+The UTF-16 and UTF-32 versions convert the string once up front if the backend cannot work with the encoding natively.
 */
 md_result md_font_get_text_metrics_utf8(md_font* pFont, const md_utf8* pTextUTF8, size_t textLength, md_text_metrics* pTextMetrics);
+md_result md_font_get_text_metrics_utf16(md_font* pFont, const md_utf16* pTextUTF16, size_t textLength, md_text_metrics* pTextMetrics);
+md_result md_font_get_text_metrics_utf32(md_font* pFont, const md_utf32* pTextUTF32, size_t textLength, md_text_metrics* pTextMetrics);
 
 
 /**************************************************************************************************************************************************************
@@ -1604,6 +2114,13 @@ Determines if a point is within the current clipping region.
 */
 md_bool32 md_gc_is_point_inside_clip(md_gc* pGC, md_int32 x, md_int32 y);
 
+/*
+Retrieves a rectangle in user space that contains everything inside the current clipping region. Nothing outside of this rectangle
+can be drawn. This is useful for skipping anything that isn't going to be visible. The rectangle may be bigger than the actual
+clipping region, but it'll never be smaller. When everything is clipped the rectangle will be empty.
+*/
+md_result md_gc_get_clip_bounds(md_gc* pGC, md_int32* pLeft, md_int32* pTop, md_int32* pRight, md_int32* pBottom);
+
 /*
 Fills the current path using the current fill settings.
 
@@ -1675,8 +2192,12 @@ Remarks
 -------
 This function does not handle tabs. If your text includes tabs you may want to consider using mt_gc_draw_text_layout_utf8(), or handling them
 yourself using low level APIs.
+
+The UTF-16 and UTF-32 versions convert the string once up front if the backend cannot work with the encoding natively.
 */
 void md_gc_draw_text_utf8(md_gc* pGC, md_font* pFont, const md_utf8* pTextUTF8, size_t textLength, md_int32 x, md_int32 y, md_alignment originAlignmentX, md_alignment originAlignmentY, md_text_metrics* pMetrics);
+void md_gc_draw_text_utf16(md_gc* pGC, md_font* pFont, const md_utf16* pTextUTF16, size_t textLength, md_int32 x, md_int32 y, md_alignment originAlignmentX, md_alignment originAlignmentY, md_text_metrics* pMetrics);
+void md_gc_draw_text_utf32(md_gc* pGC, md_font* pFont, const md_utf32* pTextUTF32, size_t textLength, md_int32 x, md_int32 y, md_alignment originAlignmentX, md_alignment originAlignmentY, md_text_metrics* pMetrics);
 
 /*
 Helper API for initializing a default text layout.
@@ -1688,80 +2209,265 @@ Retrieves the X/Y coordinates of the code point at the given position.
 */
 void md_text_layout_cp_to_xy_utf8(md_font* pFont, const md_utf8* pTextUTF8, size_t textLength, const md_text_layout* pLayout, size_t cp, md_int32* pX, md_int32* pY);
 
+/*
+Retrieves the position of the code point under the given X/Y coordinates. Points above or below the text are clamped to the first or last
+line, and points to the left or right of a line are clamped to the start or end of that line. This is the same as md_text_block_xy_to_cp().
+*/
+void md_text_layout_xy_to_cp_utf8(md_font* pFont, const md_utf8* pTextUTF8, size_t textLength, const md_text_layout* pLayout, md_int32 x, md_int32 y, size_t* pCP);
+
+/*
+Batched versions of md_text_layout_cp_to_xy_utf8() and md_text_layout_xy_to_cp_utf8(). Each of these lays out the text once no matter how
+many queries there are, and stops as soon as every query has been answered. Use these when many positions need to be retrieved at the same
+time such as when drawing a selection or a set of search results. The queries can be in any order.
+*/
+md_result md_text_layout_cp_to_xy_batch_utf8(md_font* pFont, const md_utf8* pTextUTF8, size_t textLength, const md_text_layout* pLayout, const size_t* pCPs, size_t count, md_int32* pX, md_int32* pY);
+md_result md_text_layout_xy_to_cp_batch_utf8(md_font* pFont, const md_utf8* pTextUTF8, size_t textLength, const md_text_layout* pLayout, const md_int32* pX, const md_int32* pY, size_t count, size_t* pCPs);
+
 /*
 Helper API for laying out and drawing text inside a bounds.
 */
 void md_gc_draw_text_layout_utf8(md_gc* pGC, md_font* pFont, const md_utf8* pTextUTF8, size_t textLength, const md_text_layout* pLayout);
 
+
 /*
-Clears the surface to the given color.
-*/
-void md_gc_clear(md_gc* pGC, md_color color);
+A block of text that has been itemized, shaped and laid out ahead of time.
 
+Drawing text with md_gc_draw_text_layout_utf8() does all of the itemization, shaping and layout work every time it's called. For text that
+doesn't change between repaints that work can be done once by putting the text in a md_text_block. The block keeps its own copy of the text
+along with the items, glyphs, clusters and the position of each line and run, and only redoes the layout when the text, font or layout is
+changed with one of the md_text_block_set_*() functions. The layout itself is done lazily the next time the block is drawn, measured or
+hit-tested.
 
-/******************************************************************************
+Internally the text is split into paragraphs at new-line characters, each of which is itemized, shaped and laid out on its own. This allows
+the text to be edited with md_text_block_replace_text_utf8() and friends without redoing the layout of the whole block. Only the paragraphs
+touched by the edit are laid out again. Paragraphs after the edit are simply moved.
 
-Graphics Helpers
+The font must remain valid for the life of the block, or until it's replaced with md_text_block_set_font().
+*/
+typedef struct
+{
+    size_t    itemIndex;        /* Index of the item in the paragraph's pItems. */
+    size_t    offset;           /* Offset of the run in the paragraph's text. This is the same as the item unless the item was split by wrapping. */
+    size_t    length;
+    size_t    glyphOffset;      /* Index of the run's first glyph in the paragraph's pGlyphs. */
+    md_uint32 glyphCount;
+    size_t    clusterOffset;    /* Index of the run's first cluster in the paragraph's pClusters. There is one cluster for each code unit in the run. */
+    md_int32  posX;
+    md_int32  posY;             /* Relative to the top of the paragraph. */
+    md_int32  sizeX;
+    md_int32  sizeY;
+    md_uint32 flags;
+} md_text_block_run;
 
-******************************************************************************/
-/* Helper API for creating an RGBA color. */
-MD_INLINE md_color md_rgba(md_uint8 r, md_uint8 g, md_uint8 b, md_uint8 a)
+typedef struct
 {
-    md_color color;
-    color.r = r;
-    color.g = g;
-    color.b = b;
-    color.a = a;
-    return color;
-}
+    size_t    itemIndex;        /* Index of the first item on the line. */
+    md_uint32 itemCount;        /* The number of items on the line, not including the new-line item that terminates it. */
+    size_t    runIndex;         /* Index of the first run on the line. */
+    size_t    runCount;         /* The number of runs on the line, including the run for the new-line item if there is one. */
+    md_int32  posX;
+    md_int32  posY;             /* Relative to the top of the paragraph. */
+    md_int32  sizeX;
+    md_int32  sizeY;
+    md_int32  endX;             /* The pen position at the end of the line. */
+    md_int32  endY;
+} md_text_block_line;
 
-/* Helper API for creating an opaque RGB color. */
-MD_INLINE md_color md_rgb(md_uint8 r, md_uint8 g, md_uint8 b)
+typedef struct
 {
-    return md_rgba(r, g, b, 255);
-}
+    size_t    textOffset;       /* Offset of the paragraph in the block's text. Item offsets are relative to this. */
+    size_t    textLength;       /* Includes the new-line character that terminates the paragraph, if any. */
+    md_int32  posY;             /* Relative to the top of the text. */
+    md_int32  sizeX;
+    md_int32  sizeY;
+    md_itemize_state itemizeState;
+    md_item*  pItems;           /* The items, runs, lines, glyphs and clusters all share a single allocation starting at pItems. */
+    size_t    itemCount;
+    md_text_block_run* pRuns;
+    size_t    runCount;
+    md_text_block_line* pLines;
+    size_t    lineCount;
+    md_glyph* pGlyphs;
+    size_t    glyphCount;
+    size_t*   pClusters;
+    size_t*   pGlyphClusters;   /* The run index data of each run, laid out the same way as pGlyphs. Built on the first hit test and NULL until then. */
+    md_int32* pGlyphX;
+} md_text_block_paragraph;
 
-/*
-Copies and converts image data.
+typedef struct
+{
+    md_font* pFont;
+    md_text_layout layout;
+    md_utf8* pTextUTF8;         /* Owned by the block. Always null terminated. */
+    size_t textLength;
+    size_t textCap;
+    md_text_block_paragraph* pParagraphs;
+    size_t paragraphCount;
+    size_t paragraphCap;
+    md_int32 originX;           /* The position of the top left of the text after alignment. Paragraph positions are relative to this. */
+    md_int32 originY;
+    md_int32 sizeX;
+    md_int32 sizeY;
+    md_bool32 isDirty;          /* Set when the entire layout needs to be redone before the block can be used. */
 
-You are allowed to specify the same format for the source and target in which case this performs a direct copy with no conversion.
-*/
-void md_copy_image_data(void* pDst, const void* pSrc, md_uint32 sizeX, md_uint32 sizeY, md_uint32 dstStride, md_format dstFormat, md_uint32 srcStride, md_format srcFormat);
+    /* Working buffers for laying out a paragraph. The results are copied into the paragraph's own allocation when it's done. */
+    struct
+    {
+        md_item* pItems;
+        size_t itemCap;
+        md_text_block_run* pRuns;
+        size_t runCount;
+        size_t runCap;
+        md_text_block_line* pLines;
+        size_t lineCount;
+        size_t lineCap;
+        md_glyph* pGlyphs;
+        size_t glyphCount;
+        size_t glyphCap;
+        size_t* pClusters;
+        size_t clusterCount;
+        size_t clusterCap;
+    } scratch;
+} md_text_block;
 
 /*
-Copies the given image data and flips it.
+Initializes a text block. The text is copied. The layout is not done until it's needed.
 */
-void md_copy_and_flip_image_data_y(void* pDst, const void* pSrc, md_uint32 sizeX, md_uint32 sizeY, md_uint32 dstStride, md_format dstFormat, md_uint32 srcStride, md_format srcFormat);
+md_result md_text_block_init(md_font* pFont, const md_utf8* pTextUTF8, size_t textLength, const md_text_layout* pLayout, md_text_block* pBlock);
 
 /*
-Flips the given image data horizontally, in place.
+Uninitializes a text block.
 */
-void md_flip_image_data_y(void* pDst, md_uint32 sizeX, md_uint32 sizeY, md_uint32 stride, md_format format);
+void md_text_block_uninit(md_text_block* pBlock);
 
 /*
-Retrieves the number of bytes per pixel for the given format.
+Retrieves the text of the block. The returned string is null terminated and remains valid until the text is next changed.
 */
-md_uint32 md_get_bytes_per_pixel(md_format format);
+const md_utf8* md_text_block_get_text_utf8(const md_text_block* pBlock, size_t* pTextLength);
 
 /*
-Determines whether or not there's an alpha channel in the given format.
+Replaces the text of the block. Setting the same text again will not cause the layout to be redone.
 */
-md_bool32 md_format_has_alpha(md_format format);
+md_result md_text_block_set_text_utf8(md_text_block* pBlock, const md_utf8* pTextUTF8, size_t textLength);
 
+/*
+Replaces [length] code units of the text starting at [offset] with the given text. Only the paragraphs touched by the edit are laid out
+again. This is intended for editing large amounts of text.
 
-/**************************************************************************************************************************************************************
-
-Utilities
+Use md_text_block_insert_text_utf8() and md_text_block_delete_text() for plain insertions and deletions.
+*/
+md_result md_text_block_replace_text_utf8(md_text_block* pBlock, size_t offset, size_t length, const md_utf8* pTextUTF8, size_t textLength);
 
-**************************************************************************************************************************************************************/
 /*
-Checks if the given string is NULL or empty.
+Inserts text at the given offset. This is the same as md_text_block_replace_text_utf8() with a length of 0.
 */
-md_bool32 md_is_null_or_empty_utf8(const md_utf8* pUTF8);
-md_bool32 md_is_null_or_empty(const md_utf8* pUTF8) { return md_is_null_or_empty_utf8(pUTF8); }
+md_result md_text_block_insert_text_utf8(md_text_block* pBlock, size_t offset, const md_utf8* pTextUTF8, size_t textLength);
 
 /*
-Checks if the given string is NULL or contains only whitespace characters.
+Deletes [length] code units of text starting at [offset].
+*/
+md_result md_text_block_delete_text(md_text_block* pBlock, size_t offset, size_t length);
+
+/*
+Replaces the font of the block.
+*/
+md_result md_text_block_set_font(md_text_block* pBlock, md_font* pFont);
+
+/*
+Replaces the layout of the block. Setting a layout that's identical to the current one will not cause the layout to be redone.
+*/
+md_result md_text_block_set_layout(md_text_block* pBlock, const md_text_layout* pLayout);
+
+/*
+Retrieves the size of the text in the block. This is the width of the widest line and the combined height of every line.
+*/
+md_result md_text_block_get_text_metrics(md_text_block* pBlock, md_text_metrics* pMetrics);
+
+/*
+Retrieves the X/Y coordinates of the code point at the given position. This is the same as md_text_layout_cp_to_xy_utf8().
+*/
+md_result md_text_block_cp_to_xy(md_text_block* pBlock, size_t cp, md_int32* pX, md_int32* pY);
+
+/*
+Retrieves the position of the code point under the given X/Y coordinates. Points above or below the text are clamped to the first or last
+line, and points to the left or right of a line are clamped to the start or end of that line.
+*/
+md_result md_text_block_xy_to_cp(md_text_block* pBlock, md_int32 x, md_int32 y, size_t* pCP);
+
+/*
+Draws a text block. The output is the same as md_gc_draw_text_layout_utf8() with the block's font, text and layout.
+*/
+void md_gc_draw_text_block(md_gc* pGC, md_text_block* pBlock);
+
+/*
+Clears the surface to the given color.
+*/
+void md_gc_clear(md_gc* pGC, md_color color);
+
+
+/******************************************************************************
+
+Graphics Helpers
+
+******************************************************************************/
+/* Helper API for creating an RGBA color. */
+MD_INLINE md_color md_rgba(md_uint8 r, md_uint8 g, md_uint8 b, md_uint8 a)
+{
+    md_color color;
+    color.r = r;
+    color.g = g;
+    color.b = b;
+    color.a = a;
+    return color;
+}
+
+/* Helper API for creating an opaque RGB color. */
+MD_INLINE md_color md_rgb(md_uint8 r, md_uint8 g, md_uint8 b)
+{
+    return md_rgba(r, g, b, 255);
+}
+
+/*
+Copies and converts image data.
+
+You are allowed to specify the same format for the source and target in which case this performs a direct copy with no conversion.
+*/
+void md_copy_image_data(void* pDst, const void* pSrc, md_uint32 sizeX, md_uint32 sizeY, md_uint32 dstStride, md_format dstFormat, md_uint32 srcStride, md_format srcFormat);
+
+/*
+Copies the given image data and flips it.
+*/
+void md_copy_and_flip_image_data_y(void* pDst, const void* pSrc, md_uint32 sizeX, md_uint32 sizeY, md_uint32 dstStride, md_format dstFormat, md_uint32 srcStride, md_format srcFormat);
+
+/*
+Flips the given image data horizontally, in place.
+*/
+void md_flip_image_data_y(void* pDst, md_uint32 sizeX, md_uint32 sizeY, md_uint32 stride, md_format format);
+
+/*
+Retrieves the number of bytes per pixel for the given format.
+*/
+md_uint32 md_get_bytes_per_pixel(md_format format);
+
+/*
+Determines whether or not there's an alpha channel in the given format.
+*/
+md_bool32 md_format_has_alpha(md_format format);
+
+
+/**************************************************************************************************************************************************************
+
+Utilities
+
+**************************************************************************************************************************************************************/
+/*
+Checks if the given string is NULL or empty.
+*/
+md_bool32 md_is_null_or_empty_utf8(const md_utf8* pUTF8);
+md_bool32 md_is_null_or_empty(const md_utf8* pUTF8) { return md_is_null_or_empty_utf8(pUTF8); }
+
+/*
+Checks if the given string is NULL or contains only whitespace characters.
 */
 md_bool32 md_is_null_or_whitespace_utf8(const md_utf8* pUTF8);
 md_bool32 md_is_null_or_whitespace(const md_utf8* pUTF8) { return md_is_null_or_whitespace_utf8(pUTF8); }
@@ -1821,6 +2527,50 @@ md_bool32 md_is_null_or_whitespace(const md_utf8* pUTF8) { return md_is_null_or_
     #endif
 #endif
 
+/*
+SIMD. SSE2 is always available on 64-bit x86. SSSE3 and AVX2 are compiled in whenever the compiler supports them and are only used when they're detected
+at run time. With GCC and Clang these code paths are compiled with the target attribute so there's no need to pass in -mssse3 or -mavx2. Disable with
+MD_NO_SSE2, MD_NO_SSSE3 and MD_NO_AVX2. The SSSE3 code paths build on the SSE2 ones so disabling SSE2 disables SSSE3 as well.
+*/
+#if defined(MD_X64) || defined(MD_X86)
+    #if defined(_MSC_VER) && !defined(__clang__)
+        #if _MSC_VER >= 1400 && !defined(MD_NO_SSE2)
+            #define MD_SUPPORT_SSE2
+        #endif
+        #if _MSC_VER >= 1500 && defined(MD_SUPPORT_SSE2) && !defined(MD_NO_SSSE3)
+            #define MD_SUPPORT_SSSE3
+        #endif
+        #if _MSC_VER >= 1700 && !defined(MD_NO_AVX2)
+            #define MD_SUPPORT_AVX2
+        #endif
+        #define MD_TARGET_SSSE3
+        #define MD_TARGET_AVX2
+    #elif defined(__clang__) || (defined(__GNUC__) && ((__GNUC__ > 4) || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))
+        #if defined(__SSE2__) && !defined(MD_NO_SSE2)
+            #define MD_SUPPORT_SSE2
+        #endif
+        #if defined(MD_SUPPORT_SSE2) && !defined(MD_NO_SSSE3)
+            #define MD_SUPPORT_SSSE3
+        #endif
+        #if !defined(MD_NO_AVX2)
+            #define MD_SUPPORT_AVX2
+        #endif
+        #define MD_TARGET_SSSE3 __attribute__((target("ssse3")))
+        #define MD_TARGET_AVX2  __attribute__((target("avx2")))
+    #endif
+#endif
+
+#if defined(MD_SUPPORT_AVX2)
+    #include <immintrin.h>
+#elif defined(MD_SUPPORT_SSSE3)
+    #include <tmmintrin.h>
+#elif defined(MD_SUPPORT_SSE2)
+    #include <emmintrin.h>
+#endif
+#if (defined(MD_SUPPORT_SSE2) || defined(MD_SUPPORT_AVX2)) && defined(_MSC_VER) && !defined(__clang__)
+    #include <intrin.h>     /* For __cpuidex() and _xgetbv(). */
+#endif
+
 
 /* Standard library stuff. */
 #ifndef MD_MALLOC
@@ -1875,7 +2625,7 @@ md_bool32 md_is_null_or_whitespace(const md_utf8* pUTF8) { return md_is_null_or_
 #ifdef MD_WIN32
 #define MD_MOVE_MEMORY(dst, src, sz) MoveMemory((dst), (src), (sz))
 #else
-#define MD_MOVE_MEMORY(dst, src, sz) memcpy((dst), (src), (sz))
+#define MD_MOVE_MEMORY(dst, src, sz) memmove((dst), (src), (sz))
 #endif
 #endif
 
@@ -1928,6 +2678,9 @@ md_bool32 md_is_null_or_whitespace(const md_utf8* pUTF8) { return md_is_null_or_
         #endif
     #endif
 #endif
+#if defined(MD_ENABLE_SOFTWARE)
+    #define MD_HAS_SOFTWARE     /* No dependencies. Always available. */
+#endif
 
 #if defined(MD_WIN32)
 #include <windows.h>
@@ -1989,150 +2742,530 @@ static MD_INLINE md_bool32 md_is_big_endian()
     return !md_is_little_endian();
 }
 
-static MD_INLINE md_uint16 md_swap_endian_uint16(md_uint16 n)
+#if defined(MD_SUPPORT_SSE2) || defined(MD_SUPPORT_AVX2)
+static MD_INLINE void md_cpuid(int info[4], int fid)
 {
-#ifdef MD_HAS_BYTESWAP16_INTRINSIC
-    #if defined(_MSC_VER)
-        return _byteswap_ushort(n);
-    #elif defined(__GNUC__) || defined(__clang__)
-        return __builtin_bswap16(n);
+#if defined(_MSC_VER) && !defined(__clang__)
+    __cpuidex(info, fid, 0);
+#else
+    #if defined(MD_X86) && defined(__PIC__)
+        __asm__ __volatile__ (
+            "xchg{l} {%%}ebx, %k1;"
+            "cpuid;"
+            "xchg{l} {%%}ebx, %k1;"
+            : "=a"(info[0]), "=&r"(info[1]), "=c"(info[2]), "=d"(info[3]) : "a"(fid), "c"(0)
+        );
     #else
-        #error "This compiler does not support the byte swap intrinsic."
+        __asm__ __volatile__ (
+            "cpuid" : "=a"(info[0]), "=b"(info[1]), "=c"(info[2]), "=d"(info[3]) : "a"(fid), "c"(0)
+        );
     #endif
+#endif
+}
+
+static MD_INLINE md_uint64 md_xgetbv(int reg)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    return _xgetbv(reg);
 #else
-    return ((n & 0xFF00) >> 8) |
-           ((n & 0x00FF) << 8);
+    md_uint32 hi;
+    md_uint32 lo;
+
+    __asm__ __volatile__ ("xgetbv" : "=a"(lo), "=d"(hi) : "c"(reg));
+    return ((md_uint64)hi << 32) | (md_uint64)lo;
 #endif
 }
+#endif
 
-static MD_INLINE md_uint32 md_swap_endian_uint32(md_uint32 n)
+static MD_INLINE md_bool32 md_has_sse2()
 {
-#ifdef MD_HAS_BYTESWAP32_INTRINSIC
-    #if defined(_MSC_VER)
-        return _byteswap_ulong(n);
-    #elif defined(__GNUC__) || defined(__clang__)
-        return __builtin_bswap32(n);
+#if defined(MD_SUPPORT_SSE2)
+    #if defined(MD_X64)
+        return MD_TRUE;     /* 64-bit x86 always has SSE2. */
     #else
-        #error "This compiler does not support the byte swap intrinsic."
+        int info[4];
+        md_cpuid(info, 1);
+        return (info[3] & (1 << 26)) != 0;
     #endif
 #else
-    return ((n & 0xFF000000) >> 24) |
-           ((n & 0x00FF0000) >>  8) |
-           ((n & 0x0000FF00) <<  8) |
-           ((n & 0x000000FF) << 24);
+    return MD_FALSE;
 #endif
 }
 
-
-static MD_INLINE md_uint16 md_be2host_16(md_uint16 n)
+static MD_INLINE md_bool32 md_has_ssse3()
 {
-    if (md_is_little_endian()) {
-        return md_swap_endian_uint16(n);
-    }
+#if defined(MD_SUPPORT_SSSE3)
+    #if defined(__SSSE3__) || defined(__AVX__)
+        return MD_TRUE;     /* Enabled at compile time. */
+    #else
+        /*
+        This is queried by the UTF conversion functions on every call, which can be called on small chunks of text, and cpuid is slow, especially
+        under virtualization. The result never changes so it's cached. Every thread writes the same value so a race here is harmless.
+        */
+        static int hasSSSE3 = -1;
+        if (hasSSSE3 == -1) {
+            int info[4];
+            md_cpuid(info, 1);
+            hasSSSE3 = (info[2] & (1 << 9)) != 0;
+        }
 
-    return n;
+        return (md_bool32)hasSSSE3;
+    #endif
+#else
+    return MD_FALSE;
+#endif
 }
 
-static MD_INLINE md_uint32 md_be2host_32(md_uint32 n)
+static MD_INLINE md_bool32 md_has_avx2()
 {
-    if (md_is_little_endian()) {
-        return md_swap_endian_uint32(n);
-    }
-
-    return n;
-}
+#if defined(MD_SUPPORT_AVX2)
+    int info1[4];
+    int info7[4];
 
-static MD_INLINE md_uint16 md_le2host_16(md_uint16 n)
-{
-    if (!md_is_little_endian()) {
-        return md_swap_endian_uint16(n);
+    md_cpuid(info1, 1);
+    if ((info1[2] & (1 << 27)) == 0 || (info1[2] & (1 << 28)) == 0) {
+        return MD_FALSE;    /* No OSXSAVE or no AVX. */
     }
 
-    return n;
-}
+    if ((md_xgetbv(0) & 0x06) != 0x06) {
+        return MD_FALSE;    /* The OS is not saving the YMM registers. */
+    }
 
-static MD_INLINE md_uint32 md_le2host_32(md_uint32 n)
-{
-    if (!md_is_little_endian()) {
-        return md_swap_endian_uint32(n);
+    md_cpuid(info1, 0);
+    if (info1[0] < 7) {
+        return MD_FALSE;
     }
 
-    return n;
+    md_cpuid(info7, 7);
+    return (info7[1] & (1 << 5)) != 0;
+#else
+    return MD_FALSE;
+#endif
 }
 
+/* Threading */
+#if defined(MD_WIN32)
+    typedef unsigned long md_thread_result;     /* DWORD */
+    #define MD_THREADCALL __stdcall
+#else
+    typedef void* md_thread_result;
+    #define MD_THREADCALL
+#endif
+
+typedef md_thread_result (MD_THREADCALL * md_thread_entry_proc)(void* pData);
 
-static MD_INLINE md_uint16 md_host2be_16(md_uint16 n)
+MD_PRIVATE md_result md_thread_create(md_thread* pThread, md_thread_entry_proc entryProc, void* pData)
 {
-    if (md_is_little_endian()) {
-        return md_swap_endian_uint16(n);
+#if defined(MD_WIN32)
+    *pThread = (md_thread)CreateThread(NULL, 0, entryProc, pData, 0, NULL);
+    if (*pThread == NULL) {
+        return MD_ERROR;
+    }
+#else
+    if (pthread_create(pThread, NULL, entryProc, pData) != 0) {
+        return MD_ERROR;
     }
+#endif
 
-    return n;
+    return MD_SUCCESS;
 }
 
-static MD_INLINE md_uint32 md_host2be_32(md_uint32 n)
+MD_PRIVATE void md_thread_wait(md_thread* pThread)
 {
-    if (md_is_little_endian()) {
-        return md_swap_endian_uint32(n);
-    }
-
-    return n;
+#if defined(MD_WIN32)
+    WaitForSingleObject((HANDLE)*pThread, INFINITE);
+    CloseHandle((HANDLE)*pThread);
+#else
+    pthread_join(*pThread, NULL);
+#endif
 }
 
-static MD_INLINE md_uint16 md_host2le_16(md_uint16 n)
+MD_PRIVATE md_result md_mutex_init(md_mutex* pMutex)
 {
-    if (!md_is_little_endian()) {
-        return md_swap_endian_uint16(n);
+#if defined(MD_WIN32)
+    /* An auto-reset event that starts off signaled behaves like a mutex. */
+    *pMutex = (md_mutex)CreateEventW(NULL, FALSE, TRUE, NULL);
+    if (*pMutex == NULL) {
+        return MD_ERROR;
+    }
+#else
+    if (pthread_mutex_init(pMutex, NULL) != 0) {
+        return MD_ERROR;
     }
+#endif
 
-    return n;
+    return MD_SUCCESS;
 }
 
-static MD_INLINE md_uint32 md_host2le_32(md_uint32 n)
+MD_PRIVATE void md_mutex_uninit(md_mutex* pMutex)
 {
-    if (!md_is_little_endian()) {
-        return md_swap_endian_uint32(n);
-    }
-
-    return n;
+#if defined(MD_WIN32)
+    CloseHandle((HANDLE)*pMutex);
+#else
+    pthread_mutex_destroy(pMutex);
+#endif
 }
 
-md_result md_result_from_errno(int e)
+MD_PRIVATE void md_mutex_lock(md_mutex* pMutex)
 {
-    switch (e) {
-        case EACCES: return MD_ACCESS_DENIED;
-        case EEXIST: return MD_ALREADY_EXISTS;
-        case EINVAL: return MD_INVALID_ARGS;
-        case EMFILE: return MD_TOO_MANY_OPEN_FILES;
-        case ENOENT: return MD_DOES_NOT_EXIST;
-        case ENOMEM: return MD_OUT_OF_MEMORY;
-        case EBADF:  return MD_INVALID_ARGS;   /* Can be returned by ftell() and family. */
-        default: break;
-    }
-
-    return MD_ERROR;
+#if defined(MD_WIN32)
+    WaitForSingleObject((HANDLE)*pMutex, INFINITE);
+#else
+    pthread_mutex_lock(pMutex);
+#endif
 }
 
-
-md_handle md_dlopen(const char* filename)
+MD_PRIVATE void md_mutex_unlock(md_mutex* pMutex)
 {
-    md_handle handle;
+#if defined(MD_WIN32)
+    SetEvent((HANDLE)*pMutex);
+#else
+    pthread_mutex_unlock(pMutex);
+#endif
+}
 
-#ifdef _WIN32
-    handle = (md_handle)LoadLibraryA(filename);
+MD_PRIVATE md_result md_semaphore_init(md_semaphore* pSemaphore, int initialValue)
+{
+#if defined(MD_WIN32)
+    *pSemaphore = (md_semaphore)CreateSemaphoreW(NULL, (LONG)initialValue, 0x7FFFFFFF, NULL);
+    if (*pSemaphore == NULL) {
+        return MD_ERROR;
+    }
 #else
-    handle = (md_handle)dlopen(filename, RTLD_NOW);
+    pSemaphore->value = initialValue;
+
+    if (pthread_mutex_init(&pSemaphore->lock, NULL) != 0) {
+        return MD_ERROR;
+    }
+
+    if (pthread_cond_init(&pSemaphore->cond, NULL) != 0) {
+        pthread_mutex_destroy(&pSemaphore->lock);
+        return MD_ERROR;
+    }
 #endif
 
-    return handle;
+    return MD_SUCCESS;
 }
 
-void md_dlclose(md_handle handle)
+MD_PRIVATE void md_semaphore_uninit(md_semaphore* pSemaphore)
 {
-#ifdef _WIN32
-    FreeLibrary((HMODULE)handle);
+#if defined(MD_WIN32)
+    CloseHandle((HANDLE)*pSemaphore);
 #else
-    dlclose((void*)handle);
+    pthread_cond_destroy(&pSemaphore->cond);
+    pthread_mutex_destroy(&pSemaphore->lock);
+#endif
+}
+
+MD_PRIVATE void md_semaphore_wait(md_semaphore* pSemaphore)
+{
+#if defined(MD_WIN32)
+    WaitForSingleObject((HANDLE)*pSemaphore, INFINITE);
+#else
+    pthread_mutex_lock(&pSemaphore->lock);
+    {
+        while (pSemaphore->value == 0) {
+            pthread_cond_wait(&pSemaphore->cond, &pSemaphore->lock);
+        }
+
+        pSemaphore->value -= 1;
+    }
+    pthread_mutex_unlock(&pSemaphore->lock);
+#endif
+}
+
+MD_PRIVATE void md_semaphore_release(md_semaphore* pSemaphore)
+{
+#if defined(MD_WIN32)
+    ReleaseSemaphore((HANDLE)*pSemaphore, 1, NULL);
+#else
+    pthread_mutex_lock(&pSemaphore->lock);
+    {
+        pSemaphore->value += 1;
+        pthread_cond_signal(&pSemaphore->cond);
+    }
+    pthread_mutex_unlock(&pSemaphore->lock);
+#endif
+}
+
+/* Scratch Memory */
+#define MD_SCRATCH_ALIGNMENT        16
+#define MD_SCRATCH_MIN_BLOCK_SIZE   65536
+#define MD_SCRATCH_HEADER_SIZE      ((sizeof(md_scratch_block) + MD_SCRATCH_ALIGNMENT - 1) & ~(size_t)(MD_SCRATCH_ALIGNMENT - 1))
+
+MD_PRIVATE void md_scratch_uninit(md_scratch* pScratch)
+{
+    MD_ASSERT(pScratch != NULL);
+
+    while (pScratch->pBlock != NULL) {
+        md_scratch_block* pPrev = pScratch->pBlock->pPrev;
+        MD_FREE(pScratch->pBlock);
+        pScratch->pBlock = pPrev;
+    }
+
+    pScratch->wantedSizeInBytes = 0;
+}
+
+/*
+Retrieves the current position of the scratch memory. Pass this to md_scratch_release() to free everything that was allocated after it.
+*/
+MD_PRIVATE size_t md_scratch_get_mark(const md_scratch* pScratch)
+{
+    MD_ASSERT(pScratch != NULL);
+
+    if (pScratch->pBlock == NULL) {
+        return 0;
+    }
+
+    return pScratch->pBlock->offset + pScratch->pBlock->cursor;
+}
+
+MD_PRIVATE void* md_scratch_alloc(md_scratch* pScratch, size_t sizeInBytes)
+{
+    md_scratch_block* pBlock;
+    void* p;
+
+    MD_ASSERT(pScratch != NULL);
+
+    if (sizeInBytes > ((size_t)-1) - MD_SCRATCH_HEADER_SIZE - MD_SCRATCH_ALIGNMENT) {
+        return NULL;    /* Too big. */
+    }
+
+    sizeInBytes = (sizeInBytes + MD_SCRATCH_ALIGNMENT - 1) & ~(size_t)(MD_SCRATCH_ALIGNMENT - 1);
+
+    pBlock = pScratch->pBlock;
+    if (pBlock == NULL || pBlock->sizeInBytes - pBlock->cursor < sizeInBytes) {
+        /* Not enough room in the current block. A new one needs to be chained on and it grows geometrically. */
+        md_scratch_block* pNewBlock;
+        size_t newBlockSize;
+
+        if (pBlock == NULL) {
+            newBlockSize = MD_MAX(pScratch->wantedSizeInBytes, MD_SCRATCH_MIN_BLOCK_SIZE);
+        } else {
+            newBlockSize = pBlock->sizeInBytes * 2;
+        }
+
+        if (newBlockSize < sizeInBytes) {
+            newBlockSize = sizeInBytes;
+        }
+
+        pNewBlock = (md_scratch_block*)MD_MALLOC(MD_SCRATCH_HEADER_SIZE + newBlockSize);
+        if (pNewBlock == NULL) {
+            return NULL;
+        }
+
+        pNewBlock->pPrev       = pBlock;
+        pNewBlock->offset      = (pBlock != NULL) ? pBlock->offset + pBlock->sizeInBytes : 0;
+        pNewBlock->sizeInBytes = newBlockSize;
+        pNewBlock->cursor      = 0;
+
+        pScratch->pBlock = pNewBlock;
+        pScratch->wantedSizeInBytes = MD_MAX(pScratch->wantedSizeInBytes, pNewBlock->offset + pNewBlock->sizeInBytes);
+
+        pBlock = pNewBlock;
+    }
+
+    p = MD_OFFSET_PTR(pBlock, MD_SCRATCH_HEADER_SIZE + pBlock->cursor);
+    pBlock->cursor += sizeInBytes;
+
+    return p;
+}
+
+MD_PRIVATE void md_scratch_release(md_scratch* pScratch, size_t mark)
+{
+    md_scratch_block* pBlock;
+
+    MD_ASSERT(pScratch != NULL);
+
+    pBlock = pScratch->pBlock;
+    if (pBlock == NULL) {
+        return;
+    }
+
+    /* Blocks that were chained on after the mark can be freed. The first block is always kept. */
+    while (pBlock->pPrev != NULL && pBlock->offset >= mark) {
+        md_scratch_block* pPrev = pBlock->pPrev;
+        MD_FREE(pBlock);
+        pBlock = pPrev;
+    }
+
+    MD_ASSERT(mark >= pBlock->offset && mark - pBlock->offset <= pBlock->sizeInBytes);
+    pBlock->cursor = mark - pBlock->offset;
+
+    /* Once everything has been released a single block can take the place of all of the blocks that were needed. */
+    if (pBlock->cursor == 0 && pBlock->sizeInBytes < pScratch->wantedSizeInBytes) {
+        MD_FREE(pBlock);
+        pBlock = NULL;
+    }
+
+    pScratch->pBlock = pBlock;
+}
+
+
+/* Hashing. FNV-1a. The 64-bit constants are built up from two halves because C89 has no 64-bit literals. */
+static MD_INLINE md_uint64 md_hash_init(void)
+{
+    return ((md_uint64)0xCBF29CE4 << 32) | 0x84222325;
+}
+
+static MD_INLINE md_uint64 md_hash_bytes(md_uint64 hash, const void* pData, size_t dataSize)
+{
+    const md_uint64 prime = ((md_uint64)0x00000100 << 32) | 0x000001B3;
+    const md_uint8* pBytes = (const md_uint8*)pData;
+    size_t i;
+
+    for (i = 0; i < dataSize; ++i) {
+        hash ^= pBytes[i];
+        hash *= prime;
+    }
+
+    return hash;
+}
+
+static MD_INLINE md_uint16 md_swap_endian_uint16(md_uint16 n)
+{
+#ifdef MD_HAS_BYTESWAP16_INTRINSIC
+    #if defined(_MSC_VER)
+        return _byteswap_ushort(n);
+    #elif defined(__GNUC__) || defined(__clang__)
+        return __builtin_bswap16(n);
+    #else
+        #error "This compiler does not support the byte swap intrinsic."
+    #endif
+#else
+    return ((n & 0xFF00) >> 8) |
+           ((n & 0x00FF) << 8);
+#endif
+}
+
+static MD_INLINE md_uint32 md_swap_endian_uint32(md_uint32 n)
+{
+#ifdef MD_HAS_BYTESWAP32_INTRINSIC
+    #if defined(_MSC_VER)
+        return _byteswap_ulong(n);
+    #elif defined(__GNUC__) || defined(__clang__)
+        return __builtin_bswap32(n);
+    #else
+        #error "This compiler does not support the byte swap intrinsic."
+    #endif
+#else
+    return ((n & 0xFF000000) >> 24) |
+           ((n & 0x00FF0000) >>  8) |
+           ((n & 0x0000FF00) <<  8) |
+           ((n & 0x000000FF) << 24);
+#endif
+}
+
+
+static MD_INLINE md_uint16 md_be2host_16(md_uint16 n)
+{
+    if (md_is_little_endian()) {
+        return md_swap_endian_uint16(n);
+    }
+
+    return n;
+}
+
+static MD_INLINE md_uint32 md_be2host_32(md_uint32 n)
+{
+    if (md_is_little_endian()) {
+        return md_swap_endian_uint32(n);
+    }
+
+    return n;
+}
+
+static MD_INLINE md_uint16 md_le2host_16(md_uint16 n)
+{
+    if (!md_is_little_endian()) {
+        return md_swap_endian_uint16(n);
+    }
+
+    return n;
+}
+
+static MD_INLINE md_uint32 md_le2host_32(md_uint32 n)
+{
+    if (!md_is_little_endian()) {
+        return md_swap_endian_uint32(n);
+    }
+
+    return n;
+}
+
+
+static MD_INLINE md_uint16 md_host2be_16(md_uint16 n)
+{
+    if (md_is_little_endian()) {
+        return md_swap_endian_uint16(n);
+    }
+
+    return n;
+}
+
+static MD_INLINE md_uint32 md_host2be_32(md_uint32 n)
+{
+    if (md_is_little_endian()) {
+        return md_swap_endian_uint32(n);
+    }
+
+    return n;
+}
+
+static MD_INLINE md_uint16 md_host2le_16(md_uint16 n)
+{
+    if (!md_is_little_endian()) {
+        return md_swap_endian_uint16(n);
+    }
+
+    return n;
+}
+
+static MD_INLINE md_uint32 md_host2le_32(md_uint32 n)
+{
+    if (!md_is_little_endian()) {
+        return md_swap_endian_uint32(n);
+    }
+
+    return n;
+}
+
+md_result md_result_from_errno(int e)
+{
+    switch (e) {
+        case EACCES: return MD_ACCESS_DENIED;
+        case EEXIST: return MD_ALREADY_EXISTS;
+        case EINVAL: return MD_INVALID_ARGS;
+        case EMFILE: return MD_TOO_MANY_OPEN_FILES;
+        case ENOENT: return MD_DOES_NOT_EXIST;
+        case ENOMEM: return MD_OUT_OF_MEMORY;
+        case EBADF:  return MD_INVALID_ARGS;   /* Can be returned by ftell() and family. */
+        default: break;
+    }
+
+    return MD_ERROR;
+}
+
+
+md_handle md_dlopen(const char* filename)
+{
+    md_handle handle;
+
+#ifdef _WIN32
+    handle = (md_handle)LoadLibraryA(filename);
+#else
+    handle = (md_handle)dlopen(filename, RTLD_NOW);
+#endif
+
+    return handle;
+}
+
+void md_dlclose(md_handle handle)
+{
+#ifdef _WIN32
+    FreeLibrary((HMODULE)handle);
+#else
+    dlclose((void*)handle);
 #endif
 }
 
@@ -2341,33 +3474,96 @@ const md_utf8* md_next_line_utf8(const md_utf8* pTextUTF8, size_t textLength, co
     return pNextLineBegUTF8;
 }
 
-const md_utf8* md_next_tabbed_segment(const md_utf8* pTextUTF8, size_t textLength, const md_utf8** ppSegmentEndUTF8)
-{
-    const md_utf8* pSegmentEndUTF8 = pTextUTF8;
-    const md_utf8* pNextSegmentBegUTF8 = NULL;
+/*
+Skips over [lineCount] lines and returns the offset of the start of the line after them. The number of lines that were actually skipped
+is output to [pLinesSkipped] which will be less than [lineCount] when the end of the text is reached first. New lines are "\n", "\r" and
+"\r\n", the same as md_next_line_utf8(). Pass in (size_t)-1 for [lineCount] to count the number of new lines in the text.
+*/
+MD_PRIVATE size_t md_skip_lines_utf8(const md_utf8* pTextUTF8, size_t textLength, size_t lineCount, size_t* pLinesSkipped)
+{
+    size_t iByte = 0;
+    size_t linesSkipped = 0;
+#if defined(MD_SUPPORT_SSE2)
+    md_bool32 hasSSE2 = md_has_sse2();
+    __m128i lf = _mm_set1_epi8('\n');
+    __m128i cr = _mm_set1_epi8('\r');
+#endif
 
-    if (ppSegmentEndUTF8 != NULL) {
-        *ppSegmentEndUTF8 = pTextUTF8;
-    }
+    MD_ASSERT(pTextUTF8 != NULL);
 
-    if (pTextUTF8 == NULL) {
-        return NULL;
-    }
+    while (linesSkipped < lineCount && iByte < textLength) {
+        size_t iChunkEnd;
 
-    if (textLength == 0) {
-        return NULL;
-    }
+    #if defined(MD_SUPPORT_SSE2)
+        /* Most of the text will not be new-line characters so skip over it 16 bytes at a time. */
+        if (hasSSE2) {
+            while (iByte + 16 <= textLength) {
+                __m128i chunk = _mm_loadu_si128((const __m128i*)(pTextUTF8 + iByte));
+                if (_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, lf), _mm_cmpeq_epi8(chunk, cr))) != 0) {
+                    break;
+                }
 
-    if (textLength == (size_t)-1) {
-        size_t iByte = 0;
-        for (;;) {
-            if (pTextUTF8[iByte] == '\0') {
-                break;  /* Reached the end of the string. */
+                iByte += 16;
             }
+        }
+    #endif
 
-            if (pTextUTF8[iByte] == '\t') {
-                pSegmentEndUTF8 = pTextUTF8 + iByte;
-                pNextSegmentBegUTF8 = pSegmentEndUTF8 + 1;
+        /* There's a new-line character somewhere in the next 16 bytes, or we're near the end of the text. */
+        iChunkEnd = MD_MIN(iByte + 16, textLength);
+        while (iByte < iChunkEnd) {
+            md_utf8 c = pTextUTF8[iByte];
+            iByte += 1;
+
+            if (c == '\n') {
+                linesSkipped += 1;
+                break;
+            }
+
+            if (c == '\r') {
+                if (iByte < textLength && pTextUTF8[iByte] == '\n') {
+                    iByte += 1;
+                }
+
+                linesSkipped += 1;
+                break;
+            }
+        }
+    }
+
+    if (pLinesSkipped != NULL) {
+        *pLinesSkipped = linesSkipped;
+    }
+
+    return iByte;
+}
+
+const md_utf8* md_next_tabbed_segment(const md_utf8* pTextUTF8, size_t textLength, const md_utf8** ppSegmentEndUTF8)
+{
+    const md_utf8* pSegmentEndUTF8 = pTextUTF8;
+    const md_utf8* pNextSegmentBegUTF8 = NULL;
+
+    if (ppSegmentEndUTF8 != NULL) {
+        *ppSegmentEndUTF8 = pTextUTF8;
+    }
+
+    if (pTextUTF8 == NULL) {
+        return NULL;
+    }
+
+    if (textLength == 0) {
+        return NULL;
+    }
+
+    if (textLength == (size_t)-1) {
+        size_t iByte = 0;
+        for (;;) {
+            if (pTextUTF8[iByte] == '\0') {
+                break;  /* Reached the end of the string. */
+            }
+
+            if (pTextUTF8[iByte] == '\t') {
+                pSegmentEndUTF8 = pTextUTF8 + iByte;
+                pNextSegmentBegUTF8 = pSegmentEndUTF8 + 1;
 
                 /* Get past the entire tab group. */
                 iByte += 1;
@@ -2443,12 +3639,18 @@ MD_INLINE void md_utf32_cp_to_utf16_pair(md_utf32 utf32cp, md_utf16* pUTF16)
     pUTF16[1] = (md_utf16)(0xDC00 | ((u & 0x003FF) >>  0));
 }
 
-MD_INLINE md_utf32 md_utf16_pair_to_utf32_cp(const md_utf16* pUTF16)
+/* The surrogates must already be in host byte order. */
+MD_INLINE md_utf32 md_utf16_surrogates_to_utf32_cp(md_utf16 high, md_utf16 low)
 {
     /* RFC 2781 - Section 2.1 */
+    return (((md_utf32)(high & 0x003FF) << 10) | ((md_utf32)(low & 0x003FF) << 0)) + 0x10000;
+}
+
+MD_INLINE md_utf32 md_utf16_pair_to_utf32_cp(const md_utf16* pUTF16)
+{
     MD_ASSERT(pUTF16 != NULL);
 
-    return (((md_utf32)(pUTF16[0] & 0x003FF) << 10) | ((md_utf32)(pUTF16[1] & 0x003FF) << 0)) + 0x10000;
+    return md_utf16_surrogates_to_utf32_cp(pUTF16[0], pUTF16[1]);
 }
 
 MD_INLINE md_bool32 md_is_cp_in_surrogate_pair_range(md_utf32 utf32)
@@ -2490,7 +3692,7 @@ MD_INLINE size_t md_utf32_cp_to_utf8(md_utf32 utf32, md_utf8* pUTF8, size_t utf8
     /* This API assumes the the UTF-32 code point is valid. */
     MD_ASSERT(utf32 <= MD_UNICODE_MAX_CODE_POINT);
     MD_ASSERT(md_is_cp_in_surrogate_pair_range(utf32) == MD_FALSE);
-    MD_ASSERT(utf8Cap > 1);
+    MD_ASSERT(utf8Cap > 0);
 
     if (utf32 <= 0x7F) {
         if (utf8Cap >= 1) {
@@ -2552,7 +3754,7 @@ MD_INLINE size_t md_utf32_cp_to_utf16(md_utf32 utf32, md_utf16* pUTF16, size_t u
     /* This API assumes the the UTF-32 code point is valid. */
     MD_ASSERT(utf32 <= MD_UNICODE_MAX_CODE_POINT);
     MD_ASSERT(md_is_cp_in_surrogate_pair_range(utf32) == MD_FALSE);
-    MD_ASSERT(utf16Cap > 1);
+    MD_ASSERT(utf16Cap > 0);
 
     if (utf32 <= 0xFFFF) {
         if (utf16Cap >= 1) {
@@ -2571,33 +3773,79 @@ MD_INLINE size_t md_utf32_cp_to_utf16(md_utf32 utf32, md_utf16* pUTF16, size_t u
 }
 
 
+#if defined(MD_SUPPORT_SSE2)
+/* Returns the index of the lowest set bit. [n] must not be 0. MD_SUPPORT_SSE2 is only defined for compilers that have an intrinsic for this. */
+static MD_INLINE md_uint32 md_ctz32(md_uint32 n)
+{
+    MD_ASSERT(n != 0);
+#if defined(_MSC_VER) && !defined(__clang__)
+    {
+        unsigned long index;
+        _BitScanForward(&index, n);
+        return (md_uint32)index;
+    }
+#else
+    return (md_uint32)__builtin_ctz(n);
+#endif
+}
+
+static MD_INLINE __m128i md_swap_endian_epi16__sse2(__m128i v)
+{
+    return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+
+static MD_INLINE __m128i md_swap_endian_epi32__sse2(__m128i v)
+{
+    v = md_swap_endian_epi16__sse2(v);
+    return _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+}
+#endif
+
 void md_swap_endian_utf16(md_utf16* pUTF16, size_t count)
 {
     if (count == (size_t)-1) {
-        size_t i;
-        for (i = 0; i < count; ++i) {
-            pUTF16[i] = md_swap_endian_uint16(pUTF16[i]);
-        }
-    } else {
         while (pUTF16[0] != 0) {
             pUTF16[0] = md_swap_endian_uint16(pUTF16[0]);
             pUTF16 += 1;
         }
+    } else {
+        size_t i = 0;
+
+    #if defined(MD_SUPPORT_SSE2)
+        if (md_has_sse2()) {
+            for (; i + 8 <= count; i += 8) {
+                _mm_storeu_si128((__m128i*)(pUTF16 + i), md_swap_endian_epi16__sse2(_mm_loadu_si128((const __m128i*)(pUTF16 + i))));
+            }
+        }
+    #endif
+
+        for (; i < count; ++i) {
+            pUTF16[i] = md_swap_endian_uint16(pUTF16[i]);
+        }
     }
 }
 
 void md_swap_endian_utf32(md_utf32* pUTF32, size_t count)
 {
     if (count == (size_t)-1) {
-        size_t i;
-        for (i = 0; i < count; ++i) {
-            pUTF32[i] = md_swap_endian_uint32(pUTF32[i]);
-        }
-    } else {
         while (pUTF32[0] != 0) {
             pUTF32[0] = md_swap_endian_uint32(pUTF32[0]);
             pUTF32 += 1;
         }
+    } else {
+        size_t i = 0;
+
+    #if defined(MD_SUPPORT_SSE2)
+        if (md_has_sse2()) {
+            for (; i + 4 <= count; i += 4) {
+                _mm_storeu_si128((__m128i*)(pUTF32 + i), md_swap_endian_epi32__sse2(_mm_loadu_si128((const __m128i*)(pUTF32 + i))));
+            }
+        }
+    #endif
+
+        for (; i < count; ++i) {
+            pUTF32[i] = md_swap_endian_uint32(pUTF32[i]);
+        }
     }
 }
 
@@ -2721,7 +3969,7 @@ md_result md_utf8_to_utf16_length(size_t* pUTF16Len, const md_utf8* pUTF8, size_
                     }
                 } else {
                     if ((pUTF8[iUTF8+0] & 0xE0) == 0xC0) {
-                        if (iUTF8+1 > utf8Len) {
+                        if (iUTF8+1 >= utf8Len) {
                             result = MD_INVALID_ARGS;
                             break;
                         }
@@ -2729,7 +3977,7 @@ md_result md_utf8_to_utf16_length(size_t* pUTF16Len, const md_utf8* pUTF8, size_
                         utf16Len += 1;  /* Can be at most 1 UTF-16.*/
                         iUTF8    += 2;
                     } else if ((pUTF8[iUTF8+0] & 0xF0) == 0xE0) {
-                        if (iUTF8+2 > utf8Len) {
+                        if (iUTF8+2 >= utf8Len) {
                             result = MD_INVALID_ARGS;
                             break;
                         }
@@ -2738,11 +3986,11 @@ md_result md_utf8_to_utf16_length(size_t* pUTF16Len, const md_utf8* pUTF8, size_
                         iUTF8    += 3;
                     } else if ((pUTF8[iUTF8+0] & 0xF8) == 0xF0) {
                         md_uint32 cp;
-                        if (iUTF8+3 > utf8Len) {
+                        if (iUTF8+3 >= utf8Len) {
                             return MD_INVALID_ARGS;
                         }
 
-                        cp = ((md_utf32)(pUTF8[0] & 0x07) << 18) | ((md_utf32)(pUTF8[1] & 0x3F) << 12) | ((md_utf32)(pUTF8[2] & 0x3F) << 6) | (pUTF8[3] & 0x3F);
+                        cp = ((md_utf32)(pUTF8[iUTF8+0] & 0x07) << 18) | ((md_utf32)(pUTF8[iUTF8+1] & 0x3F) << 12) | ((md_utf32)(pUTF8[iUTF8+2] & 0x3F) << 6) | (pUTF8[iUTF8+3] & 0x3F);
                         if (!md_is_valid_code_point(cp)) {
                             if ((flags & MD_ERROR_ON_INVALID_CODE_POINT) != 0) {
                                 result = MD_INVALID_CODE_POINT;
@@ -2778,10 +4026,542 @@ md_result md_utf8_to_utf16_length(size_t* pUTF16Len, const md_utf8* pUTF8, size_
     return result;
 }
 
+#if defined(MD_SUPPORT_SSE2)
+/*
+Converts as much of the given UTF-8 string as possible 16 bytes at a time and returns the number of bytes that were consumed. Only ASCII is handled
+here. This stops at the first non-ASCII byte, when there are less than 16 bytes left, or when there's not enough room in the output buffer, at which
+point the scalar path takes over. The output buffer always has at least one free slot when this returns so the scalar path will see the same capacity
+it would have otherwise.
+*/
+static size_t md_utf8_to_utf16ne__sse2(md_utf16* pUTF16, size_t utf16Cap, size_t* pUTF16Len, const md_utf8* pUTF8, size_t utf8Len)
+{
+    __m128i zero = _mm_setzero_si128();
+    size_t iUTF8 = 0;
+
+    while (utf8Len - iUTF8 >= 16 && utf16Cap - iUTF8 > 16) {
+        __m128i utf8 = _mm_loadu_si128((const __m128i*)(pUTF8 + iUTF8));
+        md_uint32 nonASCIIMask = (md_uint32)_mm_movemask_epi8(utf8);
+
+        /* Always output the whole block. Anything after the first non-ASCII byte will be overwritten by the scalar path. */
+        _mm_storeu_si128((__m128i*)(pUTF16 + iUTF8 + 0), _mm_unpacklo_epi8(utf8, zero));
+        _mm_storeu_si128((__m128i*)(pUTF16 + iUTF8 + 8), _mm_unpackhi_epi8(utf8, zero));
+
+        if (nonASCIIMask != 0) {
+            iUTF8 += md_ctz32(nonASCIIMask);
+            break;
+        }
+
+        iUTF8 += 16;
+    }
+
+    *pUTF16Len = iUTF8;    /* One code unit per byte. */
+    return iUTF8;
+}
+
+/* The same as md_utf8_to_utf16ne__sse2(), except outputs UTF-32. */
+static size_t md_utf8_to_utf32ne__sse2(md_utf32* pUTF32, size_t utf32Cap, size_t* pUTF32Len, const md_utf8* pUTF8, size_t utf8Len)
+{
+    __m128i zero = _mm_setzero_si128();
+    size_t iUTF8 = 0;
+
+    while (utf8Len - iUTF8 >= 16 && utf32Cap - iUTF8 > 16) {
+        __m128i utf8 = _mm_loadu_si128((const __m128i*)(pUTF8 + iUTF8));
+        __m128i lo = _mm_unpacklo_epi8(utf8, zero);
+        __m128i hi = _mm_unpackhi_epi8(utf8, zero);
+        md_uint32 nonASCIIMask = (md_uint32)_mm_movemask_epi8(utf8);
+
+        _mm_storeu_si128((__m128i*)(pUTF32 + iUTF8 +  0), _mm_unpacklo_epi16(lo, zero));
+        _mm_storeu_si128((__m128i*)(pUTF32 + iUTF8 +  4), _mm_unpackhi_epi16(lo, zero));
+        _mm_storeu_si128((__m128i*)(pUTF32 + iUTF8 +  8), _mm_unpacklo_epi16(hi, zero));
+        _mm_storeu_si128((__m128i*)(pUTF32 + iUTF8 + 12), _mm_unpackhi_epi16(hi, zero));
+
+        if (nonASCIIMask != 0) {
+            iUTF8 += md_ctz32(nonASCIIMask);
+            break;
+        }
+
+        iUTF8 += 16;
+    }
+
+    *pUTF32Len = iUTF8;
+    return iUTF8;
+}
+
+/*
+Returns how many bytes from [iUTF8] onward are known to come before the null terminator. The vectorized paths must not read past the null terminator,
+but scanning for it up front would take an extra pass over the whole string, and converting a long string in small chunks would rescan the rest of it on
+every call. Instead it's scanned ahead a bit at a time, never further than [maxLen] bytes, as the conversion gets to it. [pScannedLen] is the number of
+bytes from [pUTF8] that have been scanned so far and [pHasFoundNull] is set once the null terminator has been found. Both should start at 0.
+*/
+static size_t md_utf8_scan_to_null(const md_utf8* pUTF8, size_t iUTF8, size_t maxLen, size_t* pScannedLen, md_bool32* pHasFoundNull)
+{
+    size_t scannedLen = *pScannedLen;
+
+    if (scannedLen < iUTF8) {
+        scannedLen = iUTF8; /* Everything before iUTF8 has already been converted so can't contain the null terminator. */
+    }
+
+    if (scannedLen - iUTF8 < 16 && *pHasFoundNull == MD_FALSE) {
+        size_t scanLen = 256;
+        const md_utf8* pNull;
+
+        if (scanLen > maxLen) {
+            scanLen = maxLen;
+        }
+
+        if (scanLen > scannedLen - iUTF8) {
+            scanLen -= scannedLen - iUTF8;
+
+            pNull = (const md_utf8*)memchr(pUTF8 + scannedLen, 0, scanLen);
+            if (pNull != NULL) {
+                scannedLen = (size_t)(pNull - pUTF8);
+                *pHasFoundNull = MD_TRUE;
+            } else {
+                scannedLen += scanLen;
+            }
+        }
+    }
+
+    *pScannedLen = scannedLen;
+    return scannedLen - iUTF8;
+}
+#endif
+
+#if defined(MD_SUPPORT_SSSE3)
+/* Shuffles for _mm_shuffle_epi8() that pack the 16-bit lanes selected by each bit of an 8-bit mask to the front. The remaining lanes are zeroed. */
+static const md_uint8 g_mdPack16Shuffles[256][16] = {
+    {0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x04, 0x05, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x04, 0x05, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x04, 0x05, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x06, 0x07, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x06, 0x07, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x06, 0x07, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x06, 0x07, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x04, 0x05, 0x06, 0x07, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x04, 0x05, 0x06, 0x07, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x08, 0x09, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x08, 0x09, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x08, 0x09, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x08, 0x09, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x04, 0x05, 0x08, 0x09, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x04, 0x05, 0x08, 0x09, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x04, 0x05, 0x08, 0x09, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x08, 0x09, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x06, 0x07, 0x08, 0x09, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x06, 0x07, 0x08, 0x09, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x06, 0x07, 0x08, 0x09, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x06, 0x07, 0x08, 0x09, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x0A, 0x0B, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x0A, 0x0B, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x0A, 0x0B, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x0A, 0x0B, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x04, 0x05, 0x0A, 0x0B, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x04, 0x05, 0x0A, 0x0B, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x04, 0x05, 0x0A, 0x0B, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x0A, 0x0B, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x06, 0x07, 0x0A, 0x0B, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x06, 0x07, 0x0A, 0x0B, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x06, 0x07, 0x0A, 0x0B, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x06, 0x07, 0x0A, 0x0B, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x04, 0x05, 0x06, 0x07, 0x0A, 0x0B, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x04, 0x05, 0x06, 0x07, 0x0A, 0x0B, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x0A, 0x0B, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x0A, 0x0B, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x08, 0x09, 0x0A, 0x0B, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x08, 0x09, 0x0A, 0x0B, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x08, 0x09, 0x0A, 0x0B, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x08, 0x09, 0x0A, 0x0B, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x04, 0x05, 0x08, 0x09, 0x0A, 0x0B, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x04, 0x05, 0x08, 0x09, 0x0A, 0x0B, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x04, 0x05, 0x08, 0x09, 0x0A, 0x0B, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x08, 0x09, 0x0A, 0x0B, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x80, 0x80, 0x80, 0x80},
+    {0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x04, 0x05, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x04, 0x05, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x04, 0x05, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x06, 0x07, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x06, 0x07, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x06, 0x07, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x06, 0x07, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x04, 0x05, 0x06, 0x07, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x04, 0x05, 0x06, 0x07, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x08, 0x09, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x08, 0x09, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x08, 0x09, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x08, 0x09, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x04, 0x05, 0x08, 0x09, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x04, 0x05, 0x08, 0x09, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x04, 0x05, 0x08, 0x09, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x08, 0x09, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x06, 0x07, 0x08, 0x09, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x06, 0x07, 0x08, 0x09, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x06, 0x07, 0x08, 0x09, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x06, 0x07, 0x08, 0x09, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80},
+    {0x0A, 0x0B, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x0A, 0x0B, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x0A, 0x0B, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x0A, 0x0B, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x04, 0x05, 0x0A, 0x0B, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x04, 0x05, 0x0A, 0x0B, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x04, 0x05, 0x0A, 0x0B, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x0A, 0x0B, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x06, 0x07, 0x0A, 0x0B, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x06, 0x07, 0x0A, 0x0B, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x06, 0x07, 0x0A, 0x0B, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x06, 0x07, 0x0A, 0x0B, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x04, 0x05, 0x06, 0x07, 0x0A, 0x0B, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x04, 0x05, 0x06, 0x07, 0x0A, 0x0B, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x0A, 0x0B, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x0A, 0x0B, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80},
+    {0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x04, 0x05, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x04, 0x05, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x04, 0x05, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80},
+    {0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80},
+    {0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x80, 0x80},
+    {0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x04, 0x05, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x04, 0x05, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x04, 0x05, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x06, 0x07, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x06, 0x07, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x06, 0x07, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x06, 0x07, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x04, 0x05, 0x06, 0x07, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x04, 0x05, 0x06, 0x07, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x08, 0x09, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x08, 0x09, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x08, 0x09, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x08, 0x09, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x04, 0x05, 0x08, 0x09, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x04, 0x05, 0x08, 0x09, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x04, 0x05, 0x08, 0x09, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x08, 0x09, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x06, 0x07, 0x08, 0x09, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x06, 0x07, 0x08, 0x09, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x06, 0x07, 0x08, 0x09, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x06, 0x07, 0x08, 0x09, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80},
+    {0x0A, 0x0B, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x0A, 0x0B, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x0A, 0x0B, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x0A, 0x0B, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x04, 0x05, 0x0A, 0x0B, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x04, 0x05, 0x0A, 0x0B, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x04, 0x05, 0x0A, 0x0B, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x0A, 0x0B, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x06, 0x07, 0x0A, 0x0B, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x06, 0x07, 0x0A, 0x0B, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x06, 0x07, 0x0A, 0x0B, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x06, 0x07, 0x0A, 0x0B, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x04, 0x05, 0x06, 0x07, 0x0A, 0x0B, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x04, 0x05, 0x06, 0x07, 0x0A, 0x0B, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x0A, 0x0B, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x0A, 0x0B, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80},
+    {0x08, 0x09, 0x0A, 0x0B, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x08, 0x09, 0x0A, 0x0B, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x08, 0x09, 0x0A, 0x0B, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x08, 0x09, 0x0A, 0x0B, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x04, 0x05, 0x08, 0x09, 0x0A, 0x0B, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x04, 0x05, 0x08, 0x09, 0x0A, 0x0B, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x04, 0x05, 0x08, 0x09, 0x0A, 0x0B, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x08, 0x09, 0x0A, 0x0B, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80},
+    {0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80},
+    {0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0E, 0x0F, 0x80, 0x80},
+    {0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x04, 0x05, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x04, 0x05, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x04, 0x05, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x06, 0x07, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x06, 0x07, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x06, 0x07, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x06, 0x07, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x04, 0x05, 0x06, 0x07, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x04, 0x05, 0x06, 0x07, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80},
+    {0x08, 0x09, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x08, 0x09, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x08, 0x09, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x08, 0x09, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x04, 0x05, 0x08, 0x09, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x04, 0x05, 0x08, 0x09, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x04, 0x05, 0x08, 0x09, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x08, 0x09, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80},
+    {0x06, 0x07, 0x08, 0x09, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x06, 0x07, 0x08, 0x09, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x06, 0x07, 0x08, 0x09, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x06, 0x07, 0x08, 0x09, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80},
+    {0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80},
+    {0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x04, 0x05, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x04, 0x05, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x04, 0x05, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80},
+    {0x06, 0x07, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x06, 0x07, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x06, 0x07, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x06, 0x07, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80},
+    {0x04, 0x05, 0x06, 0x07, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x04, 0x05, 0x06, 0x07, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80},
+    {0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80},
+    {0x04, 0x05, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x04, 0x05, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x04, 0x05, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80},
+    {0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80},
+    {0x02, 0x03, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80},
+    {0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80, 0x80, 0x80},
+    {0x00, 0x01, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80},
+    {0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x80, 0x80},
+    {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F}
+};
+
+static MD_INLINE md_uint32 md_popcount8(md_uint32 n)
+{
+    n = n - ((n >> 1) & 0x55);
+    n = (n & 0x33) + ((n >> 2) & 0x33);
+    return (n + (n >> 4)) & 0x0F;
+}
+
+/*
+Decodes a block of 16 bytes of ASCII and 2 and 3 byte sequences into UTF-16. The code units for sequences starting in the first 8 bytes are packed into
+*pLo and those starting in the last 8 bytes into *pHi, with their counts in *pLoCount and *pHiCount. Returns the number of bytes from the start of the
+block that make up whole sequences, which is where decoding stopped. It stops before a 4 byte sequence, an invalid octet, a continuation byte that
+doesn't belong to a sequence, a sequence that's cut short and a sequence that runs past the end of the block. The scalar path handles all of those. Like
+the scalar path, overlong encodings and surrogates are not checked for, so both produce the same output.
+*/
+static MD_INLINE MD_TARGET_SSSE3 md_uint32 md_utf8_decode_block__ssse3(__m128i utf8, __m128i* pLo, md_uint32* pLoCount, __m128i* pHi, md_uint32* pHiCount)
+{
+    __m128i zero    = _mm_setzero_si128();
+    __m128i next1   = _mm_srli_si128(utf8, 1);
+    __m128i next2   = _mm_srli_si128(utf8, 2);
+    __m128i isCont  = _mm_cmpeq_epi8(_mm_and_si128(utf8, _mm_set1_epi8((char)0xC0)), _mm_set1_epi8((char)0x80));
+    __m128i isLead2 = _mm_cmpeq_epi8(_mm_and_si128(utf8, _mm_set1_epi8((char)0xE0)), _mm_set1_epi8((char)0xC0));
+    __m128i isLead3 = _mm_cmpeq_epi8(_mm_and_si128(utf8, _mm_set1_epi8((char)0xF0)), _mm_set1_epi8((char)0xE0));
+    __m128i isC0C1  = _mm_cmpeq_epi8(_mm_and_si128(utf8, _mm_set1_epi8((char)0xFE)), _mm_set1_epi8((char)0xC0));
+    md_uint32 asciiMask = ~(md_uint32)_mm_movemask_epi8(utf8) & 0xFFFF;
+    md_uint32 contMask  = (md_uint32)_mm_movemask_epi8(isCont);
+    md_uint32 lead2Mask = (md_uint32)_mm_movemask_epi8(_mm_andnot_si128(isC0C1, isLead2));
+    md_uint32 lead3Mask = (md_uint32)_mm_movemask_epi8(isLead3);
+    md_uint32 startMask = asciiMask | lead2Mask | lead3Mask;
+    md_uint32 expectedContMask = (lead2Mask << 1) | (lead3Mask << 1) | (lead3Mask << 2);   /* Bits 16 and 17 are set for sequences that run past the end. */
+    __m128i isMulti;
+    __m128i x;
+    __m128i y;
+    __m128i cpLo;
+    __m128i cpHi;
+    md_uint32 errorMask;
+    md_uint32 errorIndex;
+    md_uint32 blockLen;
+
+    /*
+    Everything up to the first error is well formed. If the error is at a byte that's not expected to be a continuation byte, every sequence before it is
+    whole. Otherwise the sequence that byte belongs to is cut short and decoding stops at the start of that sequence instead.
+    */
+    errorMask  = (contMask ^ expectedContMask) | (~(startMask | contMask) & 0xFFFF) | 0x10000;
+    errorIndex = md_ctz32(errorMask);
+
+    if ((expectedContMask & (1U << errorIndex)) == 0) {
+        blockLen = errorIndex;
+    } else if (((lead2Mask | lead3Mask) & (1U << (errorIndex - 1))) != 0) {
+        blockLen = errorIndex - 1;
+    } else {
+        blockLen = errorIndex - 2;
+    }
+
+    startMask &= (1U << blockLen) - 1;
+
+    /*
+    Every lane is decoded as if it was the start of a sequence, one byte of the code point at a time. For 2 byte sequences the payload is in this byte and
+    the next and for 3 byte sequences it's in the next two, with the top 4 bits in this one. The lanes that aren't the start of a sequence are junk and
+    are dropped when packing.
+    */
+    isMulti = _mm_cmplt_epi8(utf8, zero);
+    x = _mm_or_si128(_mm_and_si128(isLead3, next1), _mm_andnot_si128(isLead3, utf8));
+    y = _mm_or_si128(_mm_and_si128(isLead3, next2), _mm_andnot_si128(isLead3, next1));
+    cpLo = _mm_or_si128(_mm_and_si128(_mm_slli_epi16(x, 6), _mm_set1_epi8((char)0xC0)), _mm_and_si128(y, _mm_set1_epi8(0x3F)));
+    cpLo = _mm_or_si128(_mm_and_si128(isMulti, cpLo), _mm_andnot_si128(isMulti, utf8));
+    cpHi = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(x, 2), _mm_set1_epi8(0x0F)), _mm_and_si128(isLead3, _mm_and_si128(_mm_slli_epi16(utf8, 4), _mm_set1_epi8((char)0xF0))));
+    cpHi = _mm_and_si128(isMulti, cpHi);
+
+    *pLo = _mm_shuffle_epi8(_mm_unpacklo_epi8(cpLo, cpHi), _mm_loadu_si128((const __m128i*)g_mdPack16Shuffles[startMask & 0xFF]));
+    *pHi = _mm_shuffle_epi8(_mm_unpackhi_epi8(cpLo, cpHi), _mm_loadu_si128((const __m128i*)g_mdPack16Shuffles[startMask >> 8]));
+    *pLoCount = md_popcount8(startMask & 0xFF);
+    *pHiCount = md_popcount8(startMask >> 8);
+
+    return blockLen;
+}
+
+/*
+Converts runs of ASCII and 2 and 3 byte sequences 16 bytes at a time. Returns the number of bytes that were consumed. The number of code units that were
+output is returned in *pUTF16Len. This stops where md_utf8_decode_block__ssse3() can't decode anything, when there are less than 16 bytes left, or when
+there's not enough room in the output buffer for 16 code units plus one.
+*/
+static MD_TARGET_SSSE3 size_t md_utf8_to_utf16ne__ssse3(md_utf16* pUTF16, size_t utf16Cap, size_t* pUTF16Len, const md_utf8* pUTF8, size_t utf8Len)
+{
+    __m128i zero = _mm_setzero_si128();
+    size_t iUTF8  = 0;
+    size_t iUTF16 = 0;
+
+    while (utf8Len - iUTF8 >= 16 && utf16Cap - iUTF16 > 16) {
+        __m128i utf8 = _mm_loadu_si128((const __m128i*)(pUTF8 + iUTF8));
+        __m128i lo;
+        __m128i hi;
+        md_uint32 loCount;
+        md_uint32 hiCount;
+        md_uint32 blockLen;
+
+        if (_mm_movemask_epi8(utf8) == 0) {
+            _mm_storeu_si128((__m128i*)(pUTF16 + iUTF16 + 0), _mm_unpacklo_epi8(utf8, zero));
+            _mm_storeu_si128((__m128i*)(pUTF16 + iUTF16 + 8), _mm_unpackhi_epi8(utf8, zero));
+            iUTF8  += 16;
+            iUTF16 += 16;
+            continue;
+        }
+
+        blockLen = md_utf8_decode_block__ssse3(utf8, &lo, &loCount, &hi, &hiCount);
+        if (blockLen == 0) {
+            break;
+        }
+
+        /* The second store overwrites the unused lanes of the first. Anything past the last code unit will be overwritten by the next block or the scalar path. */
+        _mm_storeu_si128((__m128i*)(pUTF16 + iUTF16), lo);
+        _mm_storeu_si128((__m128i*)(pUTF16 + iUTF16 + loCount), hi);
+        iUTF8  += blockLen;
+        iUTF16 += loCount + hiCount;
+    }
+
+    *pUTF16Len = iUTF16;
+    return iUTF8;
+}
+
+/* The same as md_utf8_to_utf16ne__ssse3(), except outputs UTF-32. */
+static MD_TARGET_SSSE3 size_t md_utf8_to_utf32ne__ssse3(md_utf32* pUTF32, size_t utf32Cap, size_t* pUTF32Len, const md_utf8* pUTF8, size_t utf8Len)
+{
+    __m128i zero = _mm_setzero_si128();
+    size_t iUTF8  = 0;
+    size_t iUTF32 = 0;
+
+    while (utf8Len - iUTF8 >= 16 && utf32Cap - iUTF32 > 16) {
+        __m128i utf8 = _mm_loadu_si128((const __m128i*)(pUTF8 + iUTF8));
+        __m128i lo;
+        __m128i hi;
+        md_uint32 loCount;
+        md_uint32 hiCount;
+        md_uint32 blockLen;
+
+        if (_mm_movemask_epi8(utf8) == 0) {
+            lo = _mm_unpacklo_epi8(utf8, zero);
+            hi = _mm_unpackhi_epi8(utf8, zero);
+            _mm_storeu_si128((__m128i*)(pUTF32 + iUTF32 +  0), _mm_unpacklo_epi16(lo, zero));
+            _mm_storeu_si128((__m128i*)(pUTF32 + iUTF32 +  4), _mm_unpackhi_epi16(lo, zero));
+            _mm_storeu_si128((__m128i*)(pUTF32 + iUTF32 +  8), _mm_unpacklo_epi16(hi, zero));
+            _mm_storeu_si128((__m128i*)(pUTF32 + iUTF32 + 12), _mm_unpackhi_epi16(hi, zero));
+            iUTF8  += 16;
+            iUTF32 += 16;
+            continue;
+        }
+
+        blockLen = md_utf8_decode_block__ssse3(utf8, &lo, &loCount, &hi, &hiCount);
+        if (blockLen == 0) {
+            break;
+        }
+
+        _mm_storeu_si128((__m128i*)(pUTF32 + iUTF32 + 0), _mm_unpacklo_epi16(lo, zero));
+        _mm_storeu_si128((__m128i*)(pUTF32 + iUTF32 + 4), _mm_unpackhi_epi16(lo, zero));
+        _mm_storeu_si128((__m128i*)(pUTF32 + iUTF32 + loCount + 0), _mm_unpacklo_epi16(hi, zero));
+        _mm_storeu_si128((__m128i*)(pUTF32 + iUTF32 + loCount + 4), _mm_unpackhi_epi16(hi, zero));
+        iUTF8  += blockLen;
+        iUTF32 += loCount + hiCount;
+    }
+
+    *pUTF32Len = iUTF32;
+    return iUTF8;
+}
+#endif
+
 md_result md_utf8_to_utf16ne(md_utf16* pUTF16, size_t utf16Cap, size_t* pUTF16Len, const md_utf8* pUTF8, size_t utf8Len, size_t* pUTF8LenProcessed, md_uint32 flags)
 {
     md_result result = MD_SUCCESS;
     size_t utf16CapOriginal = utf16Cap;
+#if defined(MD_SUPPORT_SSE2)
+    md_bool32 hasSSE2 = md_has_sse2();
+#endif
+#if defined(MD_SUPPORT_SSSE3)
+    md_bool32 hasSSSE3 = md_has_ssse3();
+#endif
 
     if (pUTF16 == NULL) {
         return md_utf8_to_utf16_length(pUTF16Len, pUTF8, utf8Len, flags);
@@ -2810,17 +4590,52 @@ md_result md_utf8_to_utf16ne(md_utf16* pUTF16, size_t utf16Cap, size_t* pUTF16Le
     if (utf8Len == (size_t)-1) {
         /* Null terminated string. */
         const md_utf8* pUTF8Original = pUTF8;
+    #if defined(MD_SUPPORT_SSE2)
+        size_t scannedLen = 0;  /* For md_utf8_scan_to_null(). */
+        md_bool32 hasFoundNull = MD_FALSE;
+    #endif
+
         while (pUTF8[0] != 0) {
             if (utf16Cap == 1) {
                 result = MD_OUT_OF_MEMORY;
                 break;
             }
 
+        #if defined(MD_SUPPORT_SSSE3)
+            /* Runs of ASCII and 2 and 3 byte sequences are decoded 16 bytes at a time. This covers runs of plain ASCII as well. */
+            if (hasSSSE3 && utf16Cap > 16 && (md_uint8)pUTF8[0] < 0xF0) {
+                size_t utf8LenAvailable = md_utf8_scan_to_null(pUTF8Original, (size_t)(pUTF8 - pUTF8Original), utf16Cap, &scannedLen, &hasFoundNull);
+                if (utf8LenAvailable >= 16) {
+                    size_t utf16LenSSSE3;
+                    size_t utf8LenSSSE3 = md_utf8_to_utf16ne__ssse3(pUTF16, utf16Cap, &utf16LenSSSE3, pUTF8, utf8LenAvailable);
+                    if (utf8LenSSSE3 > 0) {
+                        pUTF8    += utf8LenSSSE3;
+                        pUTF16   += utf16LenSSSE3;
+                        utf16Cap -= utf16LenSSSE3;
+                        continue;
+                    }
+                }
+            }
+        #endif
+
             if ((md_uint8)pUTF8[0] < 128) {   /* ASCII character. */
                 pUTF16[0] = pUTF8[0];
                 pUTF16   += 1;
                 utf16Cap -= 1;
                 pUTF8    += 1;
+
+            #if defined(MD_SUPPORT_SSE2)
+                /* If this is the start of a run of ASCII, convert the rest of it 16 bytes at a time. */
+                if (hasSSE2 && utf16Cap > 16 && (md_uint8)pUTF8[0] < 128) {
+                    size_t utf8LenAvailable = md_utf8_scan_to_null(pUTF8Original, (size_t)(pUTF8 - pUTF8Original), utf16Cap, &scannedLen, &hasFoundNull);
+                    if (utf8LenAvailable >= 16) {
+                        size_t utf16LenSSE2;
+                        pUTF8    += md_utf8_to_utf16ne__sse2(pUTF16, utf16Cap, &utf16LenSSE2, pUTF8, utf8LenAvailable);
+                        pUTF16   += utf16LenSSE2;
+                        utf16Cap -= utf16LenSSE2;
+                    }
+                }
+            #endif
             } else {
                 if (md_is_invalid_utf8_octet(pUTF8[0])) {
                     if ((flags & MD_ERROR_ON_INVALID_CODE_POINT) != 0) {
@@ -2855,8 +4670,9 @@ md_result md_utf8_to_utf16ne(md_utf16* pUTF16, size_t utf16Cap, size_t* pUTF16Le
                         utf16Cap -= 1;
                         pUTF8    += 3;
                     } else if ((pUTF8[0] & 0xF8) == 0xF0) {
-                        if (utf16Cap < 2) {
-                            break;  /* No enough room. */
+                        if (utf16Cap < 3) {
+                            result = MD_OUT_OF_MEMORY;  /* Not enough room for the surrogate pair and the null terminator. */
+                            break;
                         } else {
                             md_uint32 cp;
                             if (pUTF8[1] == 0 || pUTF8[2] == 0 || pUTF8[3] == 0) {
@@ -2911,11 +4727,34 @@ md_result md_utf8_to_utf16ne(md_utf16* pUTF16, size_t utf16Cap, size_t* pUTF16Le
                 break;
             }
 
+        #if defined(MD_SUPPORT_SSSE3)
+            /* Runs of ASCII and 2 and 3 byte sequences are decoded 16 bytes at a time. This covers runs of plain ASCII as well. */
+            if (hasSSSE3 && utf8Len - iUTF8 >= 16 && utf16Cap > 16 && (md_uint8)pUTF8[iUTF8] < 0xF0) {
+                size_t utf16LenSSSE3;
+                size_t utf8LenSSSE3 = md_utf8_to_utf16ne__ssse3(pUTF16, utf16Cap, &utf16LenSSSE3, pUTF8 + iUTF8, utf8Len - iUTF8);
+                if (utf8LenSSSE3 > 0) {
+                    iUTF8    += utf8LenSSSE3;
+                    pUTF16   += utf16LenSSSE3;
+                    utf16Cap -= utf16LenSSSE3;
+                    continue;
+                }
+            }
+        #endif
+
             if ((md_uint8)pUTF8[iUTF8+0] < 128) {   /* ASCII character. */
                 pUTF16[0] = pUTF8[iUTF8+0];
                 pUTF16   += 1;
                 utf16Cap -= 1;
                 iUTF8    += 1;
+
+            #if defined(MD_SUPPORT_SSE2)
+                if (hasSSE2 && utf8Len - iUTF8 >= 16 && utf16Cap > 16 && (md_uint8)pUTF8[iUTF8] < 128) {
+                    size_t utf16LenSSE2;
+                    iUTF8    += md_utf8_to_utf16ne__sse2(pUTF16, utf16Cap, &utf16LenSSE2, pUTF8 + iUTF8, utf8Len - iUTF8);
+                    pUTF16   += utf16LenSSE2;
+                    utf16Cap -= utf16LenSSE2;
+                }
+            #endif
             } else {
                 if (md_is_invalid_utf8_octet(pUTF8[iUTF8+0])) {
                     if ((flags & MD_ERROR_ON_INVALID_CODE_POINT) != 0) {
@@ -2930,7 +4769,7 @@ md_result md_utf8_to_utf16ne(md_utf16* pUTF16, size_t utf16Cap, size_t* pUTF16Le
                     }
                 } else {
                     if ((pUTF8[iUTF8+0] & 0xE0) == 0xC0) {
-                        if (iUTF8+1 > utf8Len) {
+                        if (iUTF8+1 >= utf8Len) {
                             result = MD_INVALID_ARGS;
                             break;
                         }
@@ -2940,7 +4779,7 @@ md_result md_utf8_to_utf16ne(md_utf16* pUTF16, size_t utf16Cap, size_t* pUTF16Le
                         utf16Cap -= 1;
                         iUTF8    += 2;
                     } else if ((pUTF8[iUTF8+0] & 0xF0) == 0xE0) {
-                        if (iUTF8+2 > utf8Len) {
+                        if (iUTF8+2 >= utf8Len) {
                             result = MD_INVALID_ARGS;
                             break;
                         }
@@ -2950,11 +4789,12 @@ md_result md_utf8_to_utf16ne(md_utf16* pUTF16, size_t utf16Cap, size_t* pUTF16Le
                         utf16Cap -= 1;
                         iUTF8    += 3;
                     } else if ((pUTF8[iUTF8+0] & 0xF8) == 0xF0) {
-                        if (utf16Cap < 2) {
-                            break;  /* No enough room. */
+                        if (utf16Cap < 3) {
+                            result = MD_OUT_OF_MEMORY;  /* Not enough room for the surrogate pair and the null terminator. */
+                            break;
                         } else {
                             md_uint32 cp;
-                            if (iUTF8+3 > utf8Len) {
+                            if (iUTF8+3 >= utf8Len) {
                                 result = MD_INVALID_ARGS;
                                 break;
                             }
@@ -3181,7 +5021,7 @@ md_result md_utf8_to_utf32_length(size_t* pUTF32Len, const md_utf8* pUTF8, size_
                             result = MD_INVALID_ARGS;
                             break;
                         }
-                        cp = ((md_utf32)(pUTF8[0] & 0x07) << 18) | ((md_utf32)(pUTF8[1] & 0x3F) << 12) | ((md_utf32)(pUTF8[2] & 0x3F) << 6) | (pUTF8[3] & 0x3F);
+                        cp = ((md_utf32)(pUTF8[iUTF8+0] & 0x07) << 18) | ((md_utf32)(pUTF8[iUTF8+1] & 0x3F) << 12) | ((md_utf32)(pUTF8[iUTF8+2] & 0x3F) << 6) | (pUTF8[iUTF8+3] & 0x3F);
                         if (!md_is_valid_code_point(cp)) {
                             if ((flags & MD_ERROR_ON_INVALID_CODE_POINT) != 0) {
                                 result = MD_INVALID_CODE_POINT;
@@ -3217,6 +5057,12 @@ md_result md_utf8_to_utf32ne(md_utf32* pUTF32, size_t utf32Cap, size_t* pUTF32Le
 {
     md_result result = MD_SUCCESS;
     size_t utf32CapOriginal = utf32Cap;
+#if defined(MD_SUPPORT_SSE2)
+    md_bool32 hasSSE2 = md_has_sse2();
+#endif
+#if defined(MD_SUPPORT_SSSE3)
+    md_bool32 hasSSSE3 = md_has_ssse3();
+#endif
 
     if (pUTF32 == NULL) {
         return md_utf8_to_utf32_length(pUTF32Len, pUTF8, utf8Len, flags);
@@ -3245,15 +5091,50 @@ md_result md_utf8_to_utf32ne(md_utf32* pUTF32, size_t utf32Cap, size_t* pUTF32Le
     if (utf8Len == (size_t)-1) {
         /* Null terminated string. */
         const md_utf8* pUTF8Original = pUTF8;
+    #if defined(MD_SUPPORT_SSE2)
+        size_t scannedLen = 0;  /* For md_utf8_scan_to_null(). */
+        md_bool32 hasFoundNull = MD_FALSE;
+    #endif
+
         while (pUTF8[0] != 0) {
             if (utf32Cap == 0) {
                 result = MD_OUT_OF_MEMORY;
                 break;
             }
 
+        #if defined(MD_SUPPORT_SSSE3)
+            /* Runs of ASCII and 2 and 3 byte sequences are decoded 16 bytes at a time. This covers runs of plain ASCII as well. */
+            if (hasSSSE3 && utf32Cap > 16 && (md_uint8)pUTF8[0] < 0xF0) {
+                size_t utf8LenAvailable = md_utf8_scan_to_null(pUTF8Original, (size_t)(pUTF8 - pUTF8Original), utf32Cap, &scannedLen, &hasFoundNull);
+                if (utf8LenAvailable >= 16) {
+                    size_t utf32LenSSSE3;
+                    size_t utf8LenSSSE3 = md_utf8_to_utf32ne__ssse3(pUTF32, utf32Cap, &utf32LenSSSE3, pUTF8, utf8LenAvailable);
+                    if (utf8LenSSSE3 > 0) {
+                        pUTF8    += utf8LenSSSE3;
+                        pUTF32   += utf32LenSSSE3;
+                        utf32Cap -= utf32LenSSSE3;
+                        continue;
+                    }
+                }
+            }
+        #endif
+
             if ((md_uint8)pUTF8[0] < 128) {   /* ASCII character. */
                 pUTF32[0] = pUTF8[0];
                 pUTF8 += 1;
+
+            #if defined(MD_SUPPORT_SSE2)
+                /* If this is the start of a run of ASCII, convert the rest of it 16 bytes at a time. The output pointer is advanced past this character at the bottom of the loop. */
+                if (hasSSE2 && utf32Cap - 1 > 16 && (md_uint8)pUTF8[0] < 128) {
+                    size_t utf8LenAvailable = md_utf8_scan_to_null(pUTF8Original, (size_t)(pUTF8 - pUTF8Original), utf32Cap - 1, &scannedLen, &hasFoundNull);
+                    if (utf8LenAvailable >= 16) {
+                        size_t utf32LenSSE2;
+                        pUTF8    += md_utf8_to_utf32ne__sse2(pUTF32 + 1, utf32Cap - 1, &utf32LenSSE2, pUTF8, utf8LenAvailable);
+                        pUTF32   += utf32LenSSE2;
+                        utf32Cap -= utf32LenSSE2;
+                    }
+                }
+            #endif
             } else {
                 if (md_is_invalid_utf8_octet(pUTF8[0])) {
                     if ((flags & MD_ERROR_ON_INVALID_CODE_POINT) != 0) {
@@ -3328,9 +5209,32 @@ md_result md_utf8_to_utf32ne(md_utf32* pUTF32, size_t utf32Cap, size_t* pUTF32Le
                 break;
             }
 
+        #if defined(MD_SUPPORT_SSSE3)
+            /* Runs of ASCII and 2 and 3 byte sequences are decoded 16 bytes at a time. This covers runs of plain ASCII as well. */
+            if (hasSSSE3 && utf8Len - iUTF8 >= 16 && utf32Cap > 16 && (md_uint8)pUTF8[iUTF8] < 0xF0) {
+                size_t utf32LenSSSE3;
+                size_t utf8LenSSSE3 = md_utf8_to_utf32ne__ssse3(pUTF32, utf32Cap, &utf32LenSSSE3, pUTF8 + iUTF8, utf8Len - iUTF8);
+                if (utf8LenSSSE3 > 0) {
+                    iUTF8    += utf8LenSSSE3;
+                    pUTF32   += utf32LenSSSE3;
+                    utf32Cap -= utf32LenSSSE3;
+                    continue;
+                }
+            }
+        #endif
+
             if ((md_uint8)pUTF8[iUTF8+0] < 128) {   /* ASCII character. */
                 pUTF32[0] = pUTF8[iUTF8+0];
                 iUTF8 += 1;
+
+            #if defined(MD_SUPPORT_SSE2)
+                if (hasSSE2 && utf8Len - iUTF8 >= 16 && utf32Cap - 1 > 16 && (md_uint8)pUTF8[iUTF8] < 128) {
+                    size_t utf32LenSSE2;
+                    iUTF8    += md_utf8_to_utf32ne__sse2(pUTF32 + 1, utf32Cap - 1, &utf32LenSSE2, pUTF8 + iUTF8, utf8Len - iUTF8);
+                    pUTF32   += utf32LenSSE2;
+                    utf32Cap -= utf32LenSSE2;
+                }
+            #endif
             } else {
                 if (md_is_invalid_utf8_octet(pUTF8[iUTF8+0])) {
                     if ((flags & MD_ERROR_ON_INVALID_CODE_POINT) != 0) {
@@ -3519,7 +5423,7 @@ md_result md_utf16_to_utf8_length_internal(size_t* pUTF8Len, const md_utf16* pUT
                         }
                     
                         if (w2 >= 0xDC00 && w2 <= 0xDFFF) {
-                            utf32 = md_utf16_pair_to_utf32_cp(pUTF16);
+                            utf32 = md_utf16_surrogates_to_utf32_cp(w1, w2);
                         } else {
                             if ((flags & MD_ERROR_ON_INVALID_CODE_POINT) != 0) {
                                 result = MD_INVALID_CODE_POINT;
@@ -3564,7 +5468,7 @@ md_result md_utf16_to_utf8_length_internal(size_t* pUTF8Len, const md_utf16* pUT
             } else {
                 /* 2 UTF-16 code units, or an error. */
                 if (w1 >= 0xD800 && w1 <= 0xDBFF) {
-                    if (iUTF16+1 > utf16Len) {
+                    if (iUTF16+1 >= utf16Len) {
                         result = MD_INVALID_ARGS; /* Ran out of input data. */
                         break;
                     } else {
@@ -3575,7 +5479,7 @@ md_result md_utf16_to_utf8_length_internal(size_t* pUTF8Len, const md_utf16* pUT
                         }
                     
                         if (w2 >= 0xDC00 && w2 <= 0xDFFF) {
-                            utf32 = md_utf16_pair_to_utf32_cp(pUTF16 + iUTF16);
+                            utf32 = md_utf16_surrogates_to_utf32_cp(w1, w2);
                         } else {
                             if ((flags & MD_ERROR_ON_INVALID_CODE_POINT) != 0) {
                                 result = MD_INVALID_CODE_POINT;
@@ -3662,6 +5566,69 @@ md_result md_utf16_to_utf8_length(size_t* pUTF8Len, const md_utf16* pUTF16, size
     return md_utf16ne_to_utf8_length(pUTF8Len, pUTF16, utf16Len, flags);
 }
 
+#if defined(MD_SUPPORT_SSE2)
+/*
+Converts runs of ASCII 16 code units at a time and returns the number of code units that were consumed, which is also the number of bytes that were
+output. This stops at the first code unit that is not ASCII, when there are less than 16 code units left, or when there's not enough room in the output
+buffer for 16 bytes plus one, at which point the scalar path takes over. SSE2 is only available on x86 which is little endian so big endian input is
+byte swapped as it's loaded.
+*/
+static size_t md_utf16_to_utf8__sse2(md_utf8* pUTF8, size_t utf8Cap, const md_utf16* pUTF16, size_t utf16Len, md_bool32 isLE)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i nonASCIIBits = _mm_set1_epi16((short)0xFF80);
+    size_t i = 0;
+
+    while (utf16Len - i >= 16 && utf8Cap - i > 16) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(pUTF16 + i + 0));
+        __m128i b = _mm_loadu_si128((const __m128i*)(pUTF16 + i + 8));
+        md_uint32 asciiMask;
+
+        if (!isLE) {
+            a = md_swap_endian_epi16__sse2(a);
+            b = md_swap_endian_epi16__sse2(b);
+        }
+
+        asciiMask = (md_uint32)_mm_movemask_epi8(_mm_packs_epi16(_mm_cmpeq_epi16(_mm_and_si128(a, nonASCIIBits), zero), _mm_cmpeq_epi16(_mm_and_si128(b, nonASCIIBits), zero)));
+
+        /* Always output the whole block. Anything after the first non-ASCII code unit will be overwritten by the scalar path. */
+        _mm_storeu_si128((__m128i*)(pUTF8 + i), _mm_packus_epi16(a, b));
+
+        if (asciiMask != 0xFFFF) {
+            i += md_ctz32(~asciiMask);
+            break;
+        }
+
+        i += 16;
+    }
+
+    return i;
+}
+
+/* The same as md_utf8_scan_to_null(), except for UTF-16. The byte order doesn't matter when looking for a null terminator. */
+static size_t md_utf16_scan_to_null(const md_utf16* pUTF16, size_t iUTF16, size_t maxLen, size_t* pScannedLen, md_bool32* pHasFoundNull)
+{
+    size_t scannedLen = *pScannedLen;
+
+    if (scannedLen < iUTF16) {
+        scannedLen = iUTF16;
+    }
+
+    if (scannedLen - iUTF16 < 16 && *pHasFoundNull == MD_FALSE) {
+        size_t scanEnd = iUTF16 + ((maxLen < 256) ? maxLen : 256);
+
+        for (; scannedLen < scanEnd; scannedLen += 1) {
+            if (pUTF16[scannedLen] == 0) {
+                *pHasFoundNull = MD_TRUE;
+                break;
+            }
+        }
+    }
+
+    *pScannedLen = scannedLen;
+    return scannedLen - iUTF16;
+}
+#endif
 
 md_result md_utf16_to_utf8_internal(md_utf8* pUTF8, size_t utf8Cap, size_t* pUTF8Len, const md_utf16* pUTF16, size_t utf16Len, size_t* pUTF16LenProcessed, md_uint32 flags, md_bool32 isLE)
 {
@@ -3671,6 +5638,10 @@ md_result md_utf16_to_utf8_internal(md_utf8* pUTF8, size_t utf8Cap, size_t* pUTF
     md_utf16 w2;
     md_utf32 utf32;
     size_t utf8cpLen;   /* Code point length in UTF-8 code units. */
+    size_t utf16cpLen;  /* Code point length in UTF-16 code units. The input is only advanced once the code point has been output. */
+#if defined(MD_SUPPORT_SSE2)
+    md_bool32 hasSSE2 = md_has_sse2();
+#endif
 
     if (pUTF8 == NULL) {
         return md_utf16_to_utf8_length_internal(pUTF8Len, pUTF16, utf16Len, flags, isLE);
@@ -3699,6 +5670,11 @@ md_result md_utf16_to_utf8_internal(md_utf8* pUTF8, size_t utf8Cap, size_t* pUTF
     if (utf16Len == (size_t)-1) {
         /* Null terminated string. */
         const md_utf16* pUTF16Original = pUTF16;
+    #if defined(MD_SUPPORT_SSE2)
+        size_t scannedLen = 0;  /* For md_utf16_scan_to_null(). */
+        md_bool32 hasFoundNull = MD_FALSE;
+    #endif
+
         while (pUTF16[0] != 0) {
             if (utf8Cap == 0) {
                 result = MD_OUT_OF_MEMORY;
@@ -3714,7 +5690,7 @@ md_result md_utf16_to_utf8_internal(md_utf8* pUTF8, size_t utf8Cap, size_t* pUTF
             if (w1 < 0xD800 || w1 > 0xDFFF) {
                 /* 1 UTF-16 code unit. */
                 utf32 = w1;
-                pUTF16 += 1;
+                utf16cpLen = 1;
             } else {
                 /* 2 UTF-16 code units, or an error. */
                 if (w1 >= 0xD800 && w1 <= 0xDBFF) {
@@ -3729,7 +5705,7 @@ md_result md_utf16_to_utf8_internal(md_utf8* pUTF8, size_t utf8Cap, size_t* pUTF
                         }
                     
                         if (w2 >= 0xDC00 && w2 <= 0xDFFF) {
-                            utf32 = md_utf16_pair_to_utf32_cp(pUTF16);
+                            utf32 = md_utf16_surrogates_to_utf32_cp(w1, w2);
                         } else {
                             if ((flags & MD_ERROR_ON_INVALID_CODE_POINT) != 0) {
                                 result = MD_INVALID_CODE_POINT;
@@ -3740,7 +5716,7 @@ md_result md_utf16_to_utf8_internal(md_utf8* pUTF8, size_t utf8Cap, size_t* pUTF
                             }
                         }
 
-                        pUTF16 += 2;
+                        utf16cpLen = 2;
                     }
                 } else {
                     if ((flags & MD_ERROR_ON_INVALID_CODE_POINT) != 0) {
@@ -3751,7 +5727,7 @@ md_result md_utf16_to_utf8_internal(md_utf8* pUTF8, size_t utf8Cap, size_t* pUTF
                         utf32 = MD_UNICODE_REPLACEMENT_CHARACTER;
                     }
 
-                    pUTF16 += 1;
+                    utf16cpLen = 1;
                 }
             }
 
@@ -3763,6 +5739,23 @@ md_result md_utf16_to_utf8_internal(md_utf8* pUTF8, size_t utf8Cap, size_t* pUTF
 
             pUTF8   += utf8cpLen;
             utf8Cap -= utf8cpLen;
+            pUTF16  += utf16cpLen;
+
+        #if defined(MD_SUPPORT_SSE2)
+            /* If this is the start of a run of ASCII, convert the rest of it 16 code units at a time. See the fixed length path below. */
+            if (utf8cpLen == 1 && hasSSE2 && utf8Cap > 16) {
+                w1 = (isLE) ? md_le2host_16(pUTF16[0]) : md_be2host_16(pUTF16[0]);
+                if (w1 < 0x80 && w1 != 0) {
+                    size_t utf16LenAvailable = md_utf16_scan_to_null(pUTF16Original, (size_t)(pUTF16 - pUTF16Original), utf8Cap, &scannedLen, &hasFoundNull);
+                    if (utf16LenAvailable >= 16) {
+                        size_t utf16LenSSE2 = md_utf16_to_utf8__sse2(pUTF8, utf8Cap, pUTF16, utf16LenAvailable, isLE);
+                        pUTF8   += utf16LenSSE2;
+                        utf8Cap -= utf16LenSSE2;
+                        pUTF16  += utf16LenSSE2;
+                    }
+                }
+            }
+        #endif
         }
 
         if (pUTF16LenProcessed != NULL) {
@@ -3786,11 +5779,11 @@ md_result md_utf16_to_utf8_internal(md_utf8* pUTF8, size_t utf8Cap, size_t* pUTF
             if (w1 < 0xD800 || w1 > 0xDFFF) {
                 /* 1 UTF-16 code unit. */
                 utf32 = w1;
-                iUTF16 += 1;
+                utf16cpLen = 1;
             } else {
                 /* 2 UTF-16 code units, or an error. */
                 if (w1 >= 0xD800 && w1 <= 0xDBFF) {
-                    if (iUTF16+1 > utf16Len) {
+                    if (iUTF16+1 >= utf16Len) {
                         result = MD_INVALID_ARGS; /* Ran out of input data. */
                         break;
                     } else {
@@ -3801,7 +5794,7 @@ md_result md_utf16_to_utf8_internal(md_utf8* pUTF8, size_t utf8Cap, size_t* pUTF
                         }
                     
                         if (w2 >= 0xDC00 && w2 <= 0xDFFF) {
-                            utf32 = md_utf16_pair_to_utf32_cp(pUTF16 + iUTF16);
+                            utf32 = md_utf16_surrogates_to_utf32_cp(w1, w2);
                         } else {
                             if ((flags & MD_ERROR_ON_INVALID_CODE_POINT) != 0) {
                                 result = MD_INVALID_CODE_POINT;
@@ -3812,7 +5805,7 @@ md_result md_utf16_to_utf8_internal(md_utf8* pUTF8, size_t utf8Cap, size_t* pUTF
                             }
                         }
 
-                        iUTF16 += 2;
+                        utf16cpLen = 2;
                     }
                 } else {
                     if ((flags & MD_ERROR_ON_INVALID_CODE_POINT) != 0) {
@@ -3823,7 +5816,7 @@ md_result md_utf16_to_utf8_internal(md_utf8* pUTF8, size_t utf8Cap, size_t* pUTF
                         utf32 = MD_UNICODE_REPLACEMENT_CHARACTER;
                     }
 
-                    iUTF16 += 1;
+                    utf16cpLen = 1;
                 }
             }
 
@@ -3835,6 +5828,23 @@ md_result md_utf16_to_utf8_internal(md_utf8* pUTF8, size_t utf8Cap, size_t* pUTF
 
             pUTF8   += utf8cpLen;
             utf8Cap -= utf8cpLen;
+            iUTF16  += utf16cpLen;
+
+        #if defined(MD_SUPPORT_SSE2)
+            /*
+            If this is the start of a run of ASCII, convert the rest of it 16 code units at a time. This is only tried when the next code unit is ASCII
+            as well so that text with lone spaces between non-ASCII characters doesn't pay for it on every space.
+            */
+            if (utf8cpLen == 1 && hasSSE2 && utf16Len - iUTF16 >= 16 && utf8Cap > 16) {
+                w1 = (isLE) ? md_le2host_16(pUTF16[iUTF16]) : md_be2host_16(pUTF16[iUTF16]);
+                if (w1 < 0x80) {
+                    size_t utf16LenSSE2 = md_utf16_to_utf8__sse2(pUTF8, utf8Cap, pUTF16 + iUTF16, utf16Len - iUTF16, isLE);
+                    pUTF8   += utf16LenSSE2;
+                    utf8Cap -= utf16LenSSE2;
+                    iUTF16  += utf16LenSSE2;
+                }
+            }
+        #endif
         }
 
         if (pUTF16LenProcessed != NULL) {
@@ -4019,7 +6029,7 @@ md_result md_utf16_to_utf32_length_internal(size_t* pUTF32Len, const md_utf16* p
             } else {
                 /* 2 UTF-16 code units, or an error. */
                 if (w1 >= 0xD800 && w1 <= 0xDBFF) {
-                    if (iUTF16+1 > utf16Len) {
+                    if (iUTF16+1 >= utf16Len) {
                         result = MD_INVALID_ARGS; /* Ran out of input data. */
                         break;
                     } else {
@@ -4177,7 +6187,7 @@ md_result md_utf16_to_utf32_internal(md_utf32* pUTF32, size_t utf32Cap, size_t*
                         }
                     
                         if (w2 >= 0xDC00 && w2 <= 0xDFFF) {
-                            utf32 = md_utf16_pair_to_utf32_cp(pUTF16);
+                            utf32 = md_utf16_surrogates_to_utf32_cp(w1, w2);
                         } else {
                             if ((flags & MD_ERROR_ON_INVALID_CODE_POINT) != 0) {
                                 result = MD_INVALID_CODE_POINT;
@@ -4238,7 +6248,7 @@ md_result md_utf16_to_utf32_internal(md_utf32* pUTF32, size_t utf32Cap, size_t*
             } else {
                 /* 2 UTF-16 code units, or an error. */
                 if (w1 >= 0xD800 && w1 <= 0xDBFF) {
-                    if (iUTF16+1 > utf16Len) {
+                    if (iUTF16+1 >= utf16Len) {
                         result = MD_INVALID_ARGS; /* Ran out of input data. */
                         break;
                     } else {
@@ -4249,7 +6259,7 @@ md_result md_utf16_to_utf32_internal(md_utf32* pUTF32, size_t utf32Cap, size_t*
                         }
                     
                         if (w2 >= 0xDC00 && w2 <= 0xDFFF) {
-                            utf32 = md_utf16_pair_to_utf32_cp(pUTF16 + iUTF16);
+                            utf32 = md_utf16_surrogates_to_utf32_cp(w1, w2);
                         } else {
                             if ((flags & MD_ERROR_ON_INVALID_CODE_POINT) != 0) {
                                 result = MD_INVALID_CODE_POINT;
@@ -4505,6 +6515,69 @@ md_result md_utf32_to_utf8_length(size_t* pUTF8Len, const md_utf32* pUTF32, size
     return md_utf32ne_to_utf8_length(pUTF8Len, pUTF32, utf32Len, flags);
 }
 
+#if defined(MD_SUPPORT_SSE2)
+/* The same as md_utf16_to_utf8__sse2(), except for UTF-32. */
+static size_t md_utf32_to_utf8__sse2(md_utf8* pUTF8, size_t utf8Cap, const md_utf32* pUTF32, size_t utf32Len, md_bool32 isLE)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i nonASCIIBits = _mm_set1_epi32(~0x7F);
+    size_t i = 0;
+
+    while (utf32Len - i >= 16 && utf8Cap - i > 16) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(pUTF32 + i +  0));
+        __m128i b = _mm_loadu_si128((const __m128i*)(pUTF32 + i +  4));
+        __m128i c = _mm_loadu_si128((const __m128i*)(pUTF32 + i +  8));
+        __m128i d = _mm_loadu_si128((const __m128i*)(pUTF32 + i + 12));
+        md_uint32 asciiMask;
+
+        if (!isLE) {
+            a = md_swap_endian_epi32__sse2(a);
+            b = md_swap_endian_epi32__sse2(b);
+            c = md_swap_endian_epi32__sse2(c);
+            d = md_swap_endian_epi32__sse2(d);
+        }
+
+        asciiMask = (md_uint32)_mm_movemask_epi8(_mm_packs_epi16(
+            _mm_packs_epi32(_mm_cmpeq_epi32(_mm_and_si128(a, nonASCIIBits), zero), _mm_cmpeq_epi32(_mm_and_si128(b, nonASCIIBits), zero)),
+            _mm_packs_epi32(_mm_cmpeq_epi32(_mm_and_si128(c, nonASCIIBits), zero), _mm_cmpeq_epi32(_mm_and_si128(d, nonASCIIBits), zero))));
+
+        _mm_storeu_si128((__m128i*)(pUTF8 + i), _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d)));
+
+        if (asciiMask != 0xFFFF) {
+            i += md_ctz32(~asciiMask);
+            break;
+        }
+
+        i += 16;
+    }
+
+    return i;
+}
+
+/* The same as md_utf8_scan_to_null(), except for UTF-32. */
+static size_t md_utf32_scan_to_null(const md_utf32* pUTF32, size_t iUTF32, size_t maxLen, size_t* pScannedLen, md_bool32* pHasFoundNull)
+{
+    size_t scannedLen = *pScannedLen;
+
+    if (scannedLen < iUTF32) {
+        scannedLen = iUTF32;
+    }
+
+    if (scannedLen - iUTF32 < 16 && *pHasFoundNull == MD_FALSE) {
+        size_t scanEnd = iUTF32 + ((maxLen < 256) ? maxLen : 256);
+
+        for (; scannedLen < scanEnd; scannedLen += 1) {
+            if (pUTF32[scannedLen] == 0) {
+                *pHasFoundNull = MD_TRUE;
+                break;
+            }
+        }
+    }
+
+    *pScannedLen = scannedLen;
+    return scannedLen - iUTF32;
+}
+#endif
 
 md_result md_utf32_to_utf8_internal(md_utf8* pUTF8, size_t utf8Cap, size_t* pUTF8Len, const md_utf32* pUTF32, size_t utf32Len, size_t* pUTF32LenProcessed, md_uint32 flags, md_bool32 isLE)
 {
@@ -4512,9 +6585,12 @@ md_result md_utf32_to_utf8_internal(md_utf8* pUTF8, size_t utf8Cap, size_t* pUTF
     size_t utf8CapOriginal = utf8Cap;
     size_t utf8cpLen;   /* Code point length in UTF-8 code units. */
     md_utf32 utf32;
+#if defined(MD_SUPPORT_SSE2)
+    md_bool32 hasSSE2 = md_has_sse2();
+#endif
 
     if (pUTF8 == NULL) {
-        return md_utf32_to_utf8_internal(pUTF8, utf8Cap, pUTF8Len, pUTF32, utf32Len, pUTF32LenProcessed, flags, isLE);
+        return md_utf32_to_utf8_length_internal(pUTF8Len, pUTF32, utf32Len, flags, isLE);
     }
 
     if (pUTF8Len != NULL) {
@@ -4540,6 +6616,11 @@ md_result md_utf32_to_utf8_internal(md_utf8* pUTF8, size_t utf8Cap, size_t* pUTF
     if (utf32Len == (size_t)-1) {
         /* Null terminated string. */
         const md_utf32* pUTF32Original = pUTF32;
+    #if defined(MD_SUPPORT_SSE2)
+        size_t scannedLen = 0;  /* For md_utf32_scan_to_null(). */
+        md_bool32 hasFoundNull = MD_FALSE;
+    #endif
+
         while (pUTF32[0] != 0) {
             if (utf8Cap == 0) {
                 result = MD_OUT_OF_MEMORY;
@@ -4570,6 +6651,22 @@ md_result md_utf32_to_utf8_internal(md_utf8* pUTF8, size_t utf8Cap, size_t* pUTF
             pUTF8   += utf8cpLen;
             utf8Cap -= utf8cpLen;
             pUTF32  += 1;
+
+        #if defined(MD_SUPPORT_SSE2)
+            /* If this is the start of a run of ASCII, convert the rest of it 16 code points at a time. See md_utf16_to_utf8_internal(). */
+            if (utf8cpLen == 1 && hasSSE2 && utf8Cap > 16) {
+                utf32 = (isLE) ? md_le2host_32(pUTF32[0]) : md_be2host_32(pUTF32[0]);
+                if (utf32 < 0x80 && utf32 != 0) {
+                    size_t utf32LenAvailable = md_utf32_scan_to_null(pUTF32Original, (size_t)(pUTF32 - pUTF32Original), utf8Cap, &scannedLen, &hasFoundNull);
+                    if (utf32LenAvailable >= 16) {
+                        size_t utf32LenSSE2 = md_utf32_to_utf8__sse2(pUTF8, utf8Cap, pUTF32, utf32LenAvailable, isLE);
+                        pUTF8   += utf32LenSSE2;
+                        utf8Cap -= utf32LenSSE2;
+                        pUTF32  += utf32LenSSE2;
+                    }
+                }
+            }
+        #endif
         }
 
         if (pUTF32LenProcessed != NULL) {
@@ -4607,6 +6704,19 @@ md_result md_utf32_to_utf8_internal(md_utf8* pUTF8, size_t utf8Cap, size_t* pUTF
 
             pUTF8   += utf8cpLen;
             utf8Cap -= utf8cpLen;
+
+        #if defined(MD_SUPPORT_SSE2)
+            /* If this is the start of a run of ASCII, convert the rest of it 16 code points at a time. See md_utf16_to_utf8_internal(). */
+            if (utf8cpLen == 1 && hasSSE2 && utf32Len - iUTF32 > 16 && utf8Cap > 16) {
+                utf32 = (isLE) ? md_le2host_32(pUTF32[iUTF32 + 1]) : md_be2host_32(pUTF32[iUTF32 + 1]);
+                if (utf32 < 0x80) {
+                    size_t utf32LenSSE2 = md_utf32_to_utf8__sse2(pUTF8, utf8Cap, pUTF32 + iUTF32 + 1, utf32Len - iUTF32 - 1, isLE);
+                    pUTF8   += utf32LenSSE2;
+                    utf8Cap -= utf32LenSSE2;
+                    iUTF32  += utf32LenSSE2;
+                }
+            }
+        #endif
         }
 
         if (pUTF32LenProcessed != NULL) {
@@ -4822,6 +6932,63 @@ md_result md_utf32_to_utf16_length(size_t* pUTF16Len, const md_utf32* pUTF32, si
     return md_utf32ne_to_utf16_length(pUTF16Len, pUTF32, utf32Len, flags);
 }
 
+#if defined(MD_SUPPORT_SSE2)
+/*
+Converts runs of code points that fit in a single UTF-16 code unit 16 code points at a time and returns the number of code points that were consumed,
+which is also the number of code units that were output. Surrogates, code points outside the BMP and anything invalid are left to the scalar path. The
+output is in the same byte order as the input.
+*/
+static size_t md_utf32_to_utf16__sse2(md_utf16* pUTF16, size_t utf16Cap, const md_utf32* pUTF32, size_t utf32Len, md_bool32 isLE)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i surrogateBits = _mm_set1_epi32(0xF800);
+    __m128i surrogate = _mm_set1_epi32(0xD800);
+    size_t i = 0;
+
+    while (utf32Len - i >= 16 && utf16Cap - i > 16) {
+        __m128i v[4];
+        __m128i valid[4];
+        __m128i lo;
+        __m128i hi;
+        md_uint32 validMask;
+        int j;
+
+        for (j = 0; j < 4; j += 1) {
+            v[j] = _mm_loadu_si128((const __m128i*)(pUTF32 + i + j*4));
+            if (!isLE) {
+                v[j] = md_swap_endian_epi32__sse2(v[j]);
+            }
+
+            /* Valid if the top 16 bits are clear and it's not in the surrogate range. */
+            valid[j] = _mm_andnot_si128(_mm_cmpeq_epi32(_mm_and_si128(v[j], surrogateBits), surrogate), _mm_cmpeq_epi32(_mm_srli_epi32(v[j], 16), zero));
+
+            /* Sign extend the low 16 bits so they survive the signed saturation when packing. */
+            v[j] = _mm_srai_epi32(_mm_slli_epi32(v[j], 16), 16);
+        }
+
+        validMask = (md_uint32)_mm_movemask_epi8(_mm_packs_epi16(_mm_packs_epi32(valid[0], valid[1]), _mm_packs_epi32(valid[2], valid[3])));
+
+        lo = _mm_packs_epi32(v[0], v[1]);
+        hi = _mm_packs_epi32(v[2], v[3]);
+        if (!isLE) {
+            lo = md_swap_endian_epi16__sse2(lo);
+            hi = md_swap_endian_epi16__sse2(hi);
+        }
+
+        _mm_storeu_si128((__m128i*)(pUTF16 + i + 0), lo);
+        _mm_storeu_si128((__m128i*)(pUTF16 + i + 8), hi);
+
+        if (validMask != 0xFFFF) {
+            i += md_ctz32(~validMask);
+            break;
+        }
+
+        i += 16;
+    }
+
+    return i;
+}
+#endif
 
 md_result md_utf32_to_utf16_internal(md_utf16* pUTF16, size_t utf16Cap, size_t* pUTF16Len, const md_utf32* pUTF32, size_t utf32Len, size_t* pUTF32LenProcessed, md_uint32 flags, md_bool32 isLE)
 {
@@ -4829,9 +6996,12 @@ md_result md_utf32_to_utf16_internal(md_utf16* pUTF16, size_t utf16Cap, size_t*
     size_t utf16CapOriginal = utf16Cap;
     size_t utf16cpLen;  /* Code point length in UTF-8 code units. */
     md_utf32 utf32;
+#if defined(MD_SUPPORT_SSE2)
+    md_bool32 hasSSE2 = md_has_sse2();
+#endif
 
     if (pUTF16 == NULL) {
-        return md_utf32_to_utf16_internal(pUTF16, utf16Cap, pUTF16Len, pUTF32, utf32Len, pUTF32LenProcessed, flags, isLE);
+        return md_utf32_to_utf16_length_internal(pUTF16Len, pUTF32, utf32Len, flags, isLE);
     }
 
     if (pUTF16Len != NULL) {
@@ -4857,7 +7027,29 @@ md_result md_utf32_to_utf16_internal(md_utf16* pUTF16, size_t utf16Cap, size_t*
     if (utf32Len == (size_t)-1) {
         /* Null terminated string. */
         const md_utf32* pUTF32Original = pUTF32;
+    #if defined(MD_SUPPORT_SSE2)
+        size_t scannedLen = 0;  /* For md_utf32_scan_to_null(). */
+        md_bool32 hasFoundNull = MD_FALSE;
+    #endif
+
         while (pUTF32[0] != 0) {
+        #if defined(MD_SUPPORT_SSE2)
+            /* See the fixed length path below. */
+            if (hasSSE2 && utf16Cap > 16) {
+                size_t utf32LenAvailable = md_utf32_scan_to_null(pUTF32Original, (size_t)(pUTF32 - pUTF32Original), utf16Cap, &scannedLen, &hasFoundNull);
+                if (utf32LenAvailable >= 16) {
+                    size_t utf32LenSSE2 = md_utf32_to_utf16__sse2(pUTF16, utf16Cap, pUTF32, utf32LenAvailable, isLE);
+                    pUTF16   += utf32LenSSE2;
+                    utf16Cap -= utf32LenSSE2;
+                    pUTF32   += utf32LenSSE2;
+
+                    if (pUTF32[0] == 0) {
+                        break;
+                    }
+                }
+            }
+        #endif
+
             if (utf16Cap == 0) {
                 result = MD_OUT_OF_MEMORY;
                 break;
@@ -4912,6 +7104,20 @@ md_result md_utf32_to_utf16_internal(md_utf16* pUTF16, size_t utf16Cap, size_t*
         /* Fixed length string. */
         size_t iUTF32;
         for (iUTF32 = 0; iUTF32 < utf32Len; iUTF32 += 1) {
+        #if defined(MD_SUPPORT_SSE2)
+            /* Most text is entirely within the BMP, in which case it's converted 16 code points at a time. Everything else goes through the scalar path below. */
+            if (hasSSE2 && utf32Len - iUTF32 >= 16 && utf16Cap > 16) {
+                size_t utf32LenSSE2 = md_utf32_to_utf16__sse2(pUTF16, utf16Cap, pUTF32 + iUTF32, utf32Len - iUTF32, isLE);
+                pUTF16   += utf32LenSSE2;
+                utf16Cap -= utf32LenSSE2;
+                iUTF32   += utf32LenSSE2;
+
+                if (iUTF32 == utf32Len) {
+                    break;
+                }
+            }
+        #endif
+
             if (utf16Cap == 0) {
                 result = MD_OUT_OF_MEMORY;
                 break;
@@ -5038,6 +7244,1135 @@ md_result md_utf32_to_utf16(md_utf16* pUTF16, size_t utf16Cap, size_t* pUTF16Len
 }
 
 
+/**************************************************************************************************************************************************************
+
+Line Breaking
+
+**************************************************************************************************************************************************************/
+/* Line breaking classes from UAX #14. Generated by tools/minidraw_build from LineBreak.txt. */
+typedef enum
+{
+    md_line_break_class_xx  = 0,
+    md_line_break_class_bk  = 1,
+    md_line_break_class_cr  = 2,
+    md_line_break_class_lf  = 3,
+    md_line_break_class_cm  = 4,
+    md_line_break_class_nl  = 5,
+    md_line_break_class_sg  = 6,
+    md_line_break_class_wj  = 7,
+    md_line_break_class_zw  = 8,
+    md_line_break_class_gl  = 9,
+    md_line_break_class_sp  = 10,
+    md_line_break_class_zwj = 11,
+    md_line_break_class_b2  = 12,
+    md_line_break_class_ba  = 13,
+    md_line_break_class_bb  = 14,
+    md_line_break_class_hy  = 15,
+    md_line_break_class_cb  = 16,
+    md_line_break_class_cl  = 17,
+    md_line_break_class_cp  = 18,
+    md_line_break_class_ex  = 19,
+    md_line_break_class_in  = 20,
+    md_line_break_class_ns  = 21,
+    md_line_break_class_op  = 22,
+    md_line_break_class_qu  = 23,
+    md_line_break_class_is  = 24,
+    md_line_break_class_nu  = 25,
+    md_line_break_class_po  = 26,
+    md_line_break_class_pr  = 27,
+    md_line_break_class_sy  = 28,
+    md_line_break_class_ai  = 29,
+    md_line_break_class_al  = 30,
+    md_line_break_class_cj  = 31,
+    md_line_break_class_eb  = 32,
+    md_line_break_class_em  = 33,
+    md_line_break_class_h2  = 34,
+    md_line_break_class_h3  = 35,
+    md_line_break_class_hl  = 36,
+    md_line_break_class_id  = 37,
+    md_line_break_class_jl  = 38,
+    md_line_break_class_jv  = 39,
+    md_line_break_class_jt  = 40,
+    md_line_break_class_ri  = 41,
+    md_line_break_class_sa  = 42
+} md_line_break_class;
+
+static const md_uint8  g_mdLineBreakChunks[2176] = {
+    0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,18,19,20,21,22,23,24,25,26,26,26,26,26,26,
+    26,26,26,26,26,26,27,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,
+    26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,28,26,29,30,31,32,33,34,35,36,37,38,39,33,34,35,
+    36,37,38,39,33,34,35,36,37,38,39,40,41,41,41,41,42,42,42,42,42,42,42,42,42,42,42,42,43,44,45,46,
+    47,48,49,50,51,52,53,54,55,56,57,58,59,60,61,62,63,64,65,42,42,42,42,66,63,67,68,42,42,42,42,42,
+    42,42,69,70,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,63,71,42,72,26,26,26,26,26,26,26,26,
+    26,26,26,73,26,74,75,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,76,77,78,42,42,42,42,79,42,
+    42,42,42,42,42,42,42,80,81,82,83,84,63,85,42,86,87,88,42,89,90,42,91,92,93,94,95,96,97,98,26,99,
+    26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,
+    26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,
+    26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,
+    26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,99,
+    26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,
+    26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,
+    26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,
+    26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,26,99,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+    100,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42
+};
+
+static const md_uint16 g_mdLineBreakBlocks[3232] = {
+    0,1,2,3,4,5,4,6,7,1,8,9,4,10,4,10,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,
+    4,4,4,4,4,4,4,4,4,4,4,4,11,12,4,4,1,1,1,1,13,14,15,16,17,4,18,4,4,4,4,4,
+    4,4,4,4,4,4,4,4,19,4,4,4,4,4,4,4,4,4,4,20,4,21,4,4,22,23,1,24,25,26,27,28,
+    29,30,4,4,31,1,32,33,4,4,4,4,4,34,35,36,37,38,4,1,39,4,4,4,4,4,40,41,36,4,31,42,
+    4,43,44,45,4,46,47,4,45,48,4,4,49,1,50,1,51,4,4,52,1,53,54,4,55,56,57,58,59,60,61,62,
+    63,56,57,64,65,66,67,68,69,18,57,70,71,72,61,73,74,56,57,70,75,76,61,77,78,79,80,81,82,83,67,84,
+    85,86,57,87,88,89,61,90,91,86,57,92,88,93,61,94,95,86,4,96,97,98,61,99,100,101,4,102,103,104,67,105,
+    106,107,107,108,109,110,111,111,112,107,113,114,115,116,111,111,117,118,36,119,120,4,121,122,123,124,1,125,126,127,111,111,
+    107,107,107,107,128,107,107,107,107,129,4,4,130,4,4,4,131,131,131,131,131,131,132,132,132,132,133,134,134,134,134,134,
+    4,4,4,4,135,136,4,4,135,4,4,137,138,139,4,4,4,138,4,4,4,140,141,121,4,142,4,4,4,4,4,143,
+    144,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,
+    4,4,4,4,4,4,4,4,144,145,4,4,4,4,146,147,4,148,4,149,4,150,151,152,107,107,107,107,107,153,154,142,
+    155,154,4,4,4,4,4,147,156,4,157,4,4,4,4,158,4,45,159,159,160,107,114,161,107,107,162,107,163,164,4,4,
+    4,165,107,107,107,166,107,167,154,154,114,1,168,111,111,111,169,4,4,170,171,172,173,174,175,4,176,36,4,4,40,177,
+    4,4,170,178,179,36,4,180,147,4,4,181,77,182,183,184,4,4,4,4,4,4,4,4,4,4,4,4,1,1,1,1,
+    4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,143,4,4,143,185,4,186,4,4,4,187,187,188,4,189,
+    190,191,192,193,194,195,196,197,198,121,199,200,201,1,1,202,203,204,205,4,4,206,207,208,209,208,4,4,4,210,4,4,
+    211,212,213,214,215,216,217,4,218,219,220,221,4,4,222,4,223,224,225,4,4,4,4,4,4,4,4,4,4,4,4,226,
+    4,4,227,111,47,111,228,228,228,228,228,228,228,228,228,229,228,228,228,228,207,228,228,230,228,231,232,233,234,235,236,4,
+    237,238,4,239,240,4,241,242,4,243,4,244,245,246,247,248,249,4,4,4,4,250,251,252,228,253,4,4,254,4,255,4,
+    4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,256,257,4,4,4,223,4,258,
+    4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,259,4,260,4,261,4,4,4,4,4,4,
+    4,4,4,4,4,4,4,4,4,4,4,4,4,4,262,263,4,4,130,4,4,4,264,265,4,227,266,266,266,266,1,1,
+    267,268,269,270,271,272,111,111,273,274,273,273,273,273,273,275,273,273,273,273,273,273,273,273,273,273,273,273,273,276,111,277,
+    278,279,280,281,282,273,283,273,284,285,286,273,283,273,284,287,288,273,273,289,273,273,273,273,290,273,273,273,273,273,275,291,
+    273,290,273,273,292,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,
+    273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,
+    273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,4,4,4,4,
+    273,293,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,
+    273,273,273,273,273,273,273,273,294,273,273,273,295,4,4,180,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,
+    296,4,297,111,4,4,262,298,4,299,4,4,4,4,4,300,4,4,4,4,4,4,4,4,4,4,4,4,47,301,111,302,
+    303,4,304,305,4,4,4,306,307,4,4,170,308,154,1,309,36,4,310,4,311,312,131,313,51,4,4,314,315,316,107,317,
+    4,4,318,319,320,321,107,107,107,107,107,107,322,323,31,324,325,326,266,4,4,4,327,4,4,4,4,4,4,4,328,154,
+    329,330,331,332,331,333,331,329,330,331,332,331,333,331,329,330,331,332,331,333,331,329,330,331,332,331,333,331,329,330,331,332,
+    331,333,331,329,330,331,332,331,333,331,329,330,331,332,331,333,331,329,330,331,332,331,333,331,329,330,331,332,331,333,331,329,
+    330,331,332,331,333,331,329,330,331,332,331,333,331,329,330,331,332,331,333,331,329,330,331,332,331,333,331,329,330,331,332,331,
+    333,331,329,330,331,332,331,333,331,329,330,331,332,331,333,331,329,330,331,332,331,333,331,329,330,331,332,331,333,331,329,330,
+    331,332,331,333,331,329,330,331,332,331,333,331,329,330,331,332,331,333,331,329,330,331,332,331,333,331,329,330,331,332,331,333,
+    331,329,330,331,332,331,333,331,329,330,331,332,331,333,331,329,330,331,332,331,333,331,329,330,331,332,331,333,331,329,330,331,
+    332,331,333,331,329,330,331,332,331,333,331,329,330,331,332,331,333,331,329,330,331,332,331,333,331,329,330,331,332,331,333,331,
+    329,330,331,332,331,333,331,329,330,331,332,331,333,331,329,330,331,332,331,333,331,329,330,331,332,331,334,132,335,134,134,336,
+    337,337,337,337,337,337,337,337,337,337,337,337,337,337,337,337,337,337,337,337,337,337,337,337,337,337,337,337,337,337,337,337,
+    111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,
+    111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,
+    273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,227,338,339,340,341,4,4,4,4,4,4,4,342,343,4,4,
+    4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,344,4,4,4,4,4,302,4,4,264,111,111,345,
+    1,346,1,347,348,349,350,187,4,4,4,4,4,4,4,351,352,353,273,354,273,355,356,357,273,358,273,290,359,360,361,362,
+    363,4,139,364,186,186,111,111,4,4,4,4,4,4,4,47,365,4,4,366,4,4,4,4,45,121,72,111,111,4,4,367,
+    111,111,111,111,111,111,111,111,4,121,4,4,4,72,33,327,4,4,368,4,47,4,4,369,4,370,4,4,371,372,111,111,
+    4,4,4,4,4,4,4,4,4,186,154,4,4,371,4,327,4,4,77,4,4,4,373,374,374,375,18,376,111,111,111,111,
+    4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,227,4,158,77,111,261,4,4,377,111,111,111,111,
+    378,4,4,379,4,380,4,4,4,45,381,111,111,111,4,382,4,383,4,384,111,111,111,111,4,4,4,385,4,302,4,4,
+    386,387,4,388,147,389,4,4,4,4,111,111,4,4,390,391,4,4,4,392,4,393,4,394,4,395,396,111,111,111,111,111,
+    4,4,4,4,147,111,111,111,4,4,4,342,4,4,4,397,4,4,398,154,111,111,111,111,111,111,111,111,111,111,111,111,
+    111,111,111,111,111,111,4,45,4,4,399,400,111,111,111,111,4,4,77,4,40,401,111,4,402,111,111,4,327,111,4,227,
+    175,4,4,403,404,302,405,406,175,4,4,407,408,4,147,154,175,4,311,409,410,4,4,411,175,4,4,314,412,413,20,414,
+    4,18,415,416,111,111,111,111,417,37,418,4,4,262,419,154,420,56,57,421,75,422,423,424,111,111,111,111,111,111,111,111,
+    4,4,4,425,426,427,400,111,4,4,4,1,428,154,111,111,111,111,111,111,111,111,111,111,4,4,262,429,430,431,111,111,
+    4,4,4,1,432,154,433,111,4,4,31,434,154,111,111,111,107,435,162,436,437,111,111,111,111,111,111,111,111,111,111,111,
+    4,4,415,438,111,111,111,111,111,111,4,4,4,4,36,439,440,441,4,442,443,154,111,111,111,111,444,4,4,445,446,111,
+    447,4,4,448,449,450,4,4,49,451,452,4,4,4,4,147,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,
+    57,4,262,453,454,36,121,455,4,456,124,319,111,111,111,111,457,4,4,458,459,154,460,4,461,462,154,111,111,111,111,111,
+    111,111,111,111,111,111,111,111,111,111,111,111,111,111,4,463,111,111,111,111,111,111,111,111,111,111,111,72,4,464,465,466,
+    4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,
+    4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,142,111,111,111,111,111,111,
+    4,4,4,4,4,4,45,467,4,4,4,4,4,4,4,4,4,4,4,4,468,111,111,111,111,111,111,111,111,111,111,111,
+    111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,4,4,4,4,4,4,342,
+    4,4,4,4,4,469,4,4,470,4,4,4,4,4,4,4,4,4,4,4,4,4,4,471,4,4,4,4,4,4,4,4,
+    4,4,45,472,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,
+    4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,473,4,4,4,
+    4,4,4,4,227,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,
+    4,4,4,147,4,45,474,4,4,4,4,45,154,4,186,475,4,4,4,476,477,478,18,479,4,111,111,111,111,111,111,111,
+    111,111,111,111,4,4,4,4,4,480,111,111,111,111,111,111,4,4,4,4,481,482,1,1,483,175,111,111,111,111,484,485,
+    273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,486,
+    273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,
+    4,4,4,4,4,4,4,4,4,4,4,4,4,158,111,111,487,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,
+    111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,488,
+    273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,489,111,111,490,491,273,273,273,273,273,273,273,273,273,
+    273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,277,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,
+    4,4,4,4,4,4,47,121,147,492,493,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,
+    111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,1,1,494,1,319,4,4,4,4,4,4,4,468,111,111,111,
+    4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,158,4,4,21,4,4,4,495,1,496,4,497,4,4,4,47,111,
+    4,4,4,4,498,111,111,111,111,111,111,111,111,111,4,468,4,4,4,4,4,227,4,147,111,111,111,111,111,111,111,111,
+    4,4,4,4,4,187,4,4,4,151,499,500,501,4,4,4,502,503,4,504,505,86,4,4,4,4,4,4,4,4,4,4,
+    4,4,4,4,4,4,4,4,4,4,393,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,506,507,507,507,
+    1,1,1,508,1,1,509,510,511,512,23,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,
+    111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,4,45,111,111,111,111,111,111,111,111,111,111,111,111,111,111,
+    453,513,514,111,111,111,111,111,111,111,111,111,111,111,111,111,4,4,121,515,316,111,111,111,111,111,111,111,111,111,111,111,
+    111,111,111,111,111,111,111,111,111,4,516,111,4,4,415,517,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,
+    111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,518,45,
+    4,4,4,4,4,4,4,4,4,4,4,4,519,319,111,111,4,4,4,4,520,521,111,111,111,111,111,111,111,111,111,111,
+    111,111,111,111,111,111,111,20,4,4,345,522,111,111,111,111,20,4,4,186,111,111,111,111,111,111,111,111,111,111,111,111,
+    501,4,523,524,525,526,527,528,529,327,530,327,111,111,111,400,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,111,
+    273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,531,228,532,228,228,228,533,228,228,228,531,273,273,273,534,535,
+    273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,536,537,273,538,539,273,273,540,
+    273,273,273,273,541,542,543,544,545,546,547,548,273,273,273,273,549,550,551,552,553,273,273,554,273,555,273,273,273,556,273,557,
+    273,273,273,273,558,4,4,559,273,273,560,561,562,273,273,273,4,4,4,4,4,4,4,563,4,4,4,4,4,551,273,273,
+    564,4,4,4,565,553,4,4,565,4,566,273,273,273,273,273,567,568,569,570,273,273,273,571,273,273,273,572,573,574,273,273,
+    4,4,4,4,4,563,273,273,273,273,273,273,575,273,273,576,4,4,4,4,4,4,4,4,4,577,4,4,47,111,111,154,
+    273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,273,578,
+    579,111,1,1,1,1,1,1,111,111,111,111,111,111,111,111,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,111
+};
+
+static const md_uint8  g_mdLineBreakClasses[9280] = {
+    4,4,4,4,4,4,4,4,4,13,3,1,1,2,4,4,
+    4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,
+    10,19,23,30,27,26,30,23,22,18,30,27,24,15,24,28,
+    25,25,25,25,25,25,25,25,25,25,24,24,30,30,30,19,
+    30,30,30,30,30,30,30,30,30,30,30,30,30,30,30,30,
+    30,30,30,30,30,30,30,30,30,30,30,22,27,18,30,30,
+    30,30,30,30,30,30,30,30,30,30,30,22,13,17,30,4,
+    4,4,4,4,4,5,4,4,4,4,4,4,4,4,4,4,
+    9,22,26,27,27,27,30,29,29,30,29,23,30,13,30,30,
+    26,27,29,29,14,30,29,29,29,29,29,23,29,29,29,22,
+    30,30,30,30,30,30,30,29,30,30,30,30,30,30,30,30,
+    30,30,30,30,30,30,30,29,14,29,29,29,14,29,30,30,
+    29,30,30,30,30,30,30,30,29,29,29,29,30,29,30,14,
+    4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,9,
+    4,4,4,4,4,4,4,4,4,4,4,4,9,9,9,9,
+    9,9,9,4,4,4,4,4,4,4,4,4,4,4,4,4,
+    30,30,30,30,30,30,30,30,0,0,30,30,30,30,24,30,
+    0,0,0,0,30,30,30,30,30,30,30,0,30,0,30,30,
+    30,30,0,30,30,30,30,30,30,30,30,30,30,30,30,30,
+    30,30,30,4,4,4,4,4,4,4,30,30,30,30,30,30,
+    0,30,30,30,30,30,30,30,30,30,30,30,30,30,30,30,
+    30,30,30,30,30,30,30,0,0,30,30,30,30,30,30,30,
+    30,30,30,30,30,30,30,30,30,24,13,0,0,30,30,27,
+    0,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,
+    4,4,4,4,4,4,4,4,4,4,4,4,4,4,13,4,
+    30,4,4,30,4,4,19,4,0,0,0,0,0,0,0,0,
+    36,36,36,36,36,36,36,36,36,36,36,36,36,36,36,36,
+    36,36,36,36,36,36,36,36,36,36,36,0,0,0,0,36,
+    36,36,36,30,30,0,0,0,0,0,0,0,0,0,0,0,
+    30,30,30,30,30,30,30,30,30,26,26,26,24,24,30,30,
+    4,4,4,4,4,4,4,4,4,4,4,19,4,19,19,19,
+    30,30,30,30,30,30,30,30,30,30,30,4,4,4,4,4,
+    25,25,25,25,25,25,25,25,25,25,26,25,25,30,30,30,
+    4,30,30,30,30,30,30,30,30,30,30,30,30,30,30,30,
+    30,30,30,30,19,30,4,4,4,4,4,4,4,30,30,4,
+    4,4,4,4,4,30,30,4,4,30,4,4,4,4,30,30,
+    25,25,25,25,25,25,25,25,25,25,30,30,30,30,30,30,
+    30,30,30,30,30,30,30,30,30,30,30,30,30,30,0,30,
+    30,4,30,30,30,30,30,30,30,30,30,30,30,30,30,30,
+    4,4,4,4,4,4,4,4,4,4,4,0,0,30,30,30,
+    30,30,30,30,30,30,4,4,4,4,4,4,4,4,4,4,
+    4,30,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+    4,4,4,4,30,30,30,30,24,19,30,0,0,4,27,27,
+    30,30,30,30,30,30,4,4,4,4,30,4,4,4,4,4,
+    4,4,4,4,30,4,4,4,30,4,4,4,4,4,0,0,
+    30,30,30,30,30,30,30,30,30,30,30,30,30,30,30,0,
+    30,30,30,30,30,30,30,30,30,4,4,4,0,0,30,0,
+    30,30,30,30,30,30,30,30,30,30,30,0,0,0,0,0,
+    30,30,0,0,0,0,0,0,4,4,4,4,4,4,4,4,
+    30,30,30,30,30,30,30,30,30,30,4,4,4,4,4,4,
+    4,4,30,4,4,4,4,4,4,4,4,4,4,4,4,4,
+    4,4,4,4,30,30,30,30,30,30,30,30,30,30,30,30,
+    30,30,30,30,30,30,30,30,30,30,4,4,4,30,4,4,
+    30,4,4,4,4,4,4,4,30,30,30,30,30,30,30,30,
+    30,30,4,4,13,13,25,25,25,25,25,25,25,25,25,25,
+    30,4,4,4,0,30,30,30,30,30,30,30,30,0,0,30,
+    30,0,0,30,30,30,30,30,30,30,30,30,30,30,30,30,
+    30,30,30,30,30,30,30,30,30,0,30,30,30,30,30,30,
+    30,0,30,0,0,0,30,30,30,30,0,0,4,30,4,4,
+    4,4,4,4,4,0,0,4,4,0,0,4,4,4,30,0,
+    0,0,0,0,0,0,0,4,0,0,0,0,30,30,0,30,
+    30,30,4,4,0,0,25,25,25,25,25,25,25,25,25,25,
+    30,30,26,26,30,30,30,30,30,26,30,27,30,30,4,0,
+    0,4,4,4,0,30,30,30,30,30,30,0,0,0,0,30,
+    30,0,30,30,0,30,30,0,30,30,0,0,4,0,4,4,
+    4,4,4,0,0,0,0,4,4,0,0,4,4,4,0,0,
+    0,4,0,0,0,0,0,0,0,30,30,30,30,0,30,0,
+    0,0,0,0,0,0,25,25,25,25,25,25,25,25,25,25,
+    4,4,30,30,30,4,30,0,0,0,0,0,0,0,0,0,
+    0,4,4,4,0,30,30,30,30,30,30,30,30,30,0,30,
+    30,0,30,30,0,30,30,30,30,30,0,0,4,30,4,4,
+    4,4,4,4,4,4,0,4,4,4,0,4,4,4,0,0,
+    30,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+    30,27,0,0,0,0,0,0,0,30,4,4,4,4,4,4,
+    0,4,4,4,0,30,30,30,30,30,30,30,30,0,0,30,
+    4,4,4,4,4,0,0,4,4,0,0,4,4,4,0,0,
+    0,0,0,0,0,4,4,4,0,0,0,0,30,30,0,30,
+    30,30,30,30,30,30,30,30,0,0,0,0,0,0,0,0,
+    0,0,4,30,0,30,30,30,30,30,30,0,0,0,30,30,
+    30,0,30,30,30,30,0,0,0,30,30,0,30,0,30,30,
+    0,0,0,30,30,0,0,0,30,30,30,0,0,0,30,30,
+    30,30,30,30,30,30,30,30,30,30,0,0,0,0,4,4,
+    4,4,4,0,0,0,4,4,4,0,4,4,4,4,0,0,
+    30,0,0,0,0,0,0,4,0,0,0,0,0,0,0,0,
+    30,30,30,30,30,30,30,30,30,27,30,0,0,0,0,0,
+    4,4,4,4,4,30,30,30,30,30,30,30,30,0,30,30,
+    30,0,30,30,30,30,30,30,30,30,30,30,30,30,30,30,
+    30,30,30,30,30,30,30,30,30,30,0,0,4,30,4,4,
+    4,4,4,4,4,0,4,4,4,0,4,4,4,4,0,0,
+    0,0,0,0,0,4,4,0,30,30,30,0,0,30,0,0,
+    0,0,0,0,0,0,0,14,30,30,30,30,30,30,30,30,
+    30,4,4,4,14,30,30,30,30,30,30,30,30,0,30,30,
+    30,30,30,30,0,30,30,30,30,30,0,0,4,30,4,4,
+    0,0,0,0,0,4,4,0,0,0,0,0,0,30,30,0,
+    0,30,30,0,0,0,0,0,0,0,0,0,0,0,0,0,
+    4,4,4,4,30,30,30,30,30,30,30,30,30,0,30,30,
+    30,30,30,30,30,30,30,30,30,30,30,4,4,30,4,4,
+    4,4,4,4,4,0,4,4,4,0,4,4,4,4,30,30,
+    0,0,0,0,30,30,30,4,30,30,30,30,30,30,30,30,
+    30,30,30,30,30,30,30,30,30,26,30,30,30,30,30,30,
+    0,4,4,4,0,30,30,30,30,30,30,30,30,30,30,30,
+    30,30,30,30,30,30,30,0,0,0,30,30,30,30,30,30,
+    30,30,0,30,30,30,30,30,30,30,30,30,0,30,0,0,
+    30,30,30,30,30,30,30,0,0,0,4,0,0,0,0,4,
+    4,4,4,4,4,0,4,0,4,4,4,4,4,4,4,4,
+    0,0,4,4,30,0,0,0,0,0,0,0,0,0,0,0,
+    0,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,
+    42,42,42,42,42,42,42,42,42,42,42,0,0,0,0,27,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,30,
+    25,25,25,25,25,25,25,25,25,25,13,13,0,0,0,0,
+    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+    0,42,42,0,42,0,42,42,42,42,42,0,42,42,42,42,
+    42,42,42,42,0,42,0,42,42,42,42,42,42,42,42,42,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,0,0,
+    42,42,42,42,42,0,42,0,42,42,42,42,42,42,0,0,
+    25,25,25,25,25,25,25,25,25,25,0,0,42,42,42,42,
+    30,14,14,14,14,30,14,14,9,14,14,13,9,19,19,19,
+    19,19,9,30,19,30,30,30,4,4,30,30,30,30,30,30,
+    30,30,30,30,13,4,30,4,30,4,22,17,22,17,4,4,
+    30,30,30,30,30,30,30,30,0,30,30,30,30,30,30,30,
+    30,30,30,30,30,30,30,30,30,30,30,30,30,0,0,0,
+    0,4,4,4,4,4,4,4,4,4,4,4,4,4,4,13,
+    4,4,4,4,4,13,4,4,30,30,30,30,30,4,4,4,
+    4,4,4,4,4,4,4,4,0,4,4,4,4,4,4,4,
+    4,4,4,4,4,4,4,4,4,4,4,4,4,0,13,13,
+    30,30,30,30,30,30,4,30,30,30,30,30,30,0,30,30,
+    14,14,13,14,30,30,30,30,30,9,9,0,0,0,0,0,
+    25,25,25,25,25,25,25,25,25,25,13,13,30,30,30,30,
+    25,25,25,25,25,25,25,25,25,25,42,42,42,42,42,42,
+    30,30,30,30,30,30,0,30,0,0,0,0,0,30,0,0,
+    38,38,38,38,38,38,38,38,38,38,38,38,38,38,38,38,
+    39,39,39,39,39,39,39,39,39,39,39,39,39,39,39,39,
+    39,39,39,39,39,39,39,39,40,40,40,40,40,40,40,40,
+    40,40,40,40,40,40,40,40,40,40,40,40,40,40,40,40,
+    30,30,30,30,30,30,30,30,30,0,30,30,30,30,0,0,
+    30,30,30,30,30,30,30,0,30,0,30,30,30,30,0,0,
+    30,0,30,30,30,30,0,0,30,30,30,30,30,30,30,0,
+    30,0,30,30,30,30,0,0,30,30,30,30,30,30,30,30,
+    30,30,30,30,30,30,30,0,30,30,30,30,30,30,30,30,
+    30,30,30,30,30,30,30,30,30,30,30,0,0,4,4,4,
+    30,13,30,30,30,30,30,30,30,30,30,30,30,30,30,30,
+    30,30,30,30,30,30,30,30,30,30,0,0,0,0,0,0,
+    30,30,30,30,30,30,0,0,30,30,30,30,30,30,0,0,
+    13,30,30,30,30,30,30,30,30,30,30,30,30,30,30,30,
+    30,30,30,30,30,30,30,30,30,30,30,22,17,0,0,0,
+    30,30,30,30,30,30,30,30,30,30,30,13,13,13,30,30,
+    30,30,30,30,30,30,30,30,30,0,0,0,0,0,0,0,
+    30,30,4,4,4,4,0,0,0,0,0,0,0,0,0,30,
+    30,30,4,4,4,13,13,0,0,0,0,0,0,0,0,0,
+    30,30,4,4,0,0,0,0,0,0,0,0,0,0,0,0,
+    30,30,30,30,30,30,30,30,30,30,30,30,30,0,30,30,
+    30,0,4,4,0,0,0,0,0,0,0,0,0,0,0,0,
+    42,42,42,42,13,13,21,42,13,30,13,27,42,42,0,0,
+    25,25,25,25,25,25,25,25,25,25,0,0,0,0,0,0,
+    30,30,19,19,13,13,14,30,19,19,30,4,4,4,9,4,
+    30,30,30,30,30,4,4,30,30,30,30,30,30,30,30,30,
+    30,30,30,30,30,30,30,30,30,4,30,0,0,0,0,0,
+    30,30,30,30,30,30,0,0,0,0,0,0,0,0,0,0,
+    4,4,4,4,4,4,4,4,4,4,4,4,0,0,0,0,
+    30,0,0,0,19,19,25,25,25,25,25,25,25,25,25,25,
+    42,42,42,42,42,0,0,0,0,0,0,0,0,0,0,0,
+    42,42,42,42,42,42,42,42,42,42,42,42,0,0,0,0,
+    42,42,42,42,42,42,42,42,42,42,0,0,0,0,0,0,
+    25,25,25,25,25,25,25,25,25,25,42,0,0,0,42,42,
+    30,30,30,30,30,30,30,4,4,4,4,4,0,0,30,30,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,42,42,0,
+    42,42,42,42,42,42,42,42,42,42,42,42,42,0,0,4,
+    4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,0,
+    4,4,4,4,4,30,30,30,30,30,30,30,30,30,30,30,
+    30,30,30,30,4,4,4,4,4,4,4,4,4,4,4,4,
+    4,4,4,4,4,30,30,30,30,30,30,30,30,0,0,0,
+    25,25,25,25,25,25,25,25,25,25,13,13,30,13,13,13,
+    13,30,30,30,30,30,30,30,30,30,30,4,4,4,4,4,
+    4,4,4,4,30,30,30,30,30,30,30,30,30,13,13,0,
+    4,4,4,30,30,30,30,30,30,30,30,30,30,30,30,30,
+    30,4,4,4,4,4,4,4,4,4,4,4,4,4,30,30,
+    4,4,4,4,0,0,0,0,0,0,0,0,30,30,30,30,
+    4,4,4,4,4,4,4,4,0,0,0,13,13,13,13,13,
+    25,25,25,25,25,25,25,25,25,25,0,0,0,30,30,30,
+    30,30,30,30,30,30,30,30,30,30,30,30,30,30,13,13,
+    30,30,30,30,30,30,30,30,30,30,30,0,0,30,30,30,
+    4,4,4,30,4,4,4,4,4,4,4,4,4,4,4,4,
+    4,4,4,4,4,4,4,4,4,30,30,30,30,4,30,30,
+    30,30,30,30,4,30,30,4,4,4,30,0,0,0,0,0,
+    30,30,30,30,30,30,30,30,0,30,0,30,0,30,0,30,
+    30,30,30,30,30,30,30,30,30,30,30,30,30,30,0,0,
+    30,30,30,30,30,0,30,30,30,30,30,30,30,30,30,30,
+    30,30,30,30,0,0,30,30,30,30,30,30,0,30,30,30,
+    0,0,30,30,30,0,30,30,30,30,30,30,30,14,30,0,
+    13,13,13,13,13,13,13,9,13,13,13,8,4,11,4,4,
+    13,9,13,13,12,29,29,30,23,23,22,23,23,23,22,23,
+    29,29,30,30,20,20,20,13,1,1,4,4,4,4,4,9,
+    26,26,26,26,26,26,26,26,30,23,23,29,21,21,30,30,
+    30,30,30,30,24,22,17,21,21,21,30,30,30,30,30,30,
+    30,30,30,30,30,30,13,30,13,13,13,13,30,13,13,13,
+    7,30,30,30,30,0,4,4,4,4,4,4,4,4,4,4,
+    30,30,0,0,29,30,30,30,30,30,30,30,30,22,17,29,
+    30,29,29,29,29,30,30,30,30,30,30,30,30,22,17,0,
+    27,27,27,27,27,27,27,26,27,27,27,27,27,27,27,27,
+    27,27,27,27,27,27,26,27,27,27,27,26,27,27,26,27,
+    26,27,27,27,27,27,27,27,27,27,27,27,27,27,27,27,
+    4,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+    30,30,30,26,30,29,30,30,30,26,30,30,30,30,30,30,
+    30,30,30,29,30,30,27,30,30,30,30,30,30,30,30,30,
+    30,29,29,30,30,30,30,30,30,30,30,29,30,30,30,30,
+    30,30,30,30,29,29,30,30,30,30,30,29,30,30,29,30,
+    29,29,29,29,29,29,29,29,29,29,29,29,30,30,30,30,
+    29,29,29,29,29,29,29,29,29,29,30,30,30,30,30,30,
+    30,30,30,30,30,30,30,30,30,29,30,30,0,0,0,0,
+    30,30,29,30,29,30,30,30,30,30,30,30,30,30,30,30,
+    29,30,29,29,30,30,30,29,29,30,30,29,30,30,30,29,
+    30,29,27,27,30,29,30,30,30,30,29,30,30,29,29,29,
+    29,30,30,29,30,29,30,29,29,29,29,29,29,30,29,30,
+    30,30,30,30,29,29,29,29,30,30,30,30,29,29,30,30,
+    30,30,30,30,30,30,30,30,29,30,30,30,29,30,30,30,
+    30,30,29,30,30,30,30,30,30,30,30,30,30,30,30,30,
+    29,29,30,30,29,29,29,29,30,30,29,29,30,30,29,29,
+    30,30,29,29,30,30,29,29,30,30,30,30,30,30,30,30,
+    30,30,30,30,30,29,30,30,30,29,30,30,30,30,30,30,
+    30,30,30,30,30,29,30,30,30,30,30,30,30,30,30,30,
+    30,30,30,30,30,30,30,30,30,30,30,30,30,30,30,29,
+    30,30,30,30,30,30,30,30,30,30,30,30,30,30,30,20,
+    30,30,30,30,30,30,30,30,22,17,22,17,30,30,30,30,
+    30,30,29,30,30,30,30,30,30,30,37,37,30,30,30,30,
+    30,30,30,30,30,30,30,30,30,22,17,30,30,30,30,30,
+    37,37,37,37,30,30,30,30,30,30,30,30,30,30,30,30,
+    30,30,30,30,30,30,30,0,0,0,0,0,0,0,0,0,
+    29,29,29,29,29,29,29,29,29,29,29,29,29,29,29,29,
+    29,29,29,29,29,29,29,29,29,29,29,29,29,29,29,30,
+    29,29,29,29,29,30,30,30,30,30,30,30,30,30,30,30,
+    30,30,29,29,29,29,30,30,30,30,30,30,30,30,30,30,
+    29,29,30,29,29,29,29,29,29,29,30,30,30,30,30,30,
+    30,30,29,29,30,30,29,29,30,30,30,30,29,29,30,30,
+    29,29,30,30,30,30,29,29,29,30,30,29,30,30,29,29,
+    29,29,30,30,30,30,30,30,30,30,30,30,30,30,30,30,
+    30,30,29,29,29,29,30,30,30,30,30,30,30,30,30,29,
+    37,37,37,37,30,29,29,30,30,29,30,30,30,30,29,29,
+    30,30,30,30,37,37,29,29,37,30,37,37,37,32,37,37,
+    30,30,30,30,30,30,30,30,30,37,37,37,30,30,30,30,
+    29,30,29,30,30,30,30,30,30,30,30,30,30,30,30,30,
+    29,29,30,29,29,29,30,29,37,29,29,30,29,29,30,29,
+    30,30,30,30,30,30,30,30,30,30,30,30,30,30,30,37,
+    30,30,30,30,30,30,30,30,30,30,30,30,30,30,29,29,
+    30,30,30,30,30,30,30,30,30,30,30,30,30,37,37,37,
+    37,37,37,37,37,37,37,37,37,29,29,29,29,37,30,37,
+    37,37,29,37,37,29,29,29,37,37,29,29,37,29,29,37,
+    37,37,30,29,30,30,30,30,29,29,37,29,29,29,29,29,
+    29,37,37,37,37,37,29,37,37,32,37,29,29,37,37,37,
+    37,37,37,37,37,30,30,30,37,37,32,32,32,32,30,30,
+    30,30,30,30,30,30,30,29,30,30,30,23,23,23,23,23,
+    23,30,19,19,37,30,30,30,22,17,22,17,22,17,22,17,
+    22,17,22,17,22,17,29,29,29,29,29,29,29,29,29,29,
+    29,29,29,29,30,30,30,30,30,30,30,30,30,30,30,30,
+    30,30,30,30,30,22,17,30,30,30,30,30,30,30,30,30,
+    30,30,30,30,30,30,22,17,22,17,22,17,22,17,22,17,
+    30,30,30,22,17,22,17,22,17,22,17,22,17,22,17,22,
+    17,22,17,22,17,22,17,22,17,30,30,30,30,30,30,30,
+    30,30,30,30,30,30,30,30,30,30,30,30,22,17,30,30,
+    30,30,30,30,30,29,29,29,29,29,30,30,30,30,30,30,
+    30,30,30,30,0,0,30,30,30,30,30,30,30,30,30,30,
+    30,30,30,30,30,30,0,30,30,30,30,30,30,30,30,30,
+    30,30,30,30,30,30,30,30,30,30,30,30,30,30,30,4,
+    4,4,30,30,0,0,0,0,0,19,13,13,13,30,19,13,
+    30,30,30,30,30,30,30,30,0,0,0,0,0,0,0,30,
+    13,0,0,0,0,0,0,0,0,0,0,0,0,0,0,4,
+    30,30,30,30,30,30,30,0,30,30,30,30,30,30,30,0,
+    23,23,23,23,23,23,23,23,23,23,23,23,23,23,13,13,
+    13,13,13,13,13,13,30,13,22,13,30,30,23,23,30,30,
+    23,23,22,17,22,17,22,17,22,17,13,13,13,13,19,30,
+    13,13,30,13,13,30,30,30,30,30,12,12,13,13,13,30,
+    13,13,22,13,13,13,13,13,13,13,13,30,13,30,13,13,
+    30,30,30,19,19,22,17,22,17,22,17,22,17,13,0,0,
+    37,37,37,37,37,37,37,37,37,37,37,37,37,37,37,37,
+    37,37,37,37,37,37,37,37,37,37,0,37,37,37,37,37,
+    37,37,37,37,0,0,0,0,0,0,0,0,0,0,0,0,
+    37,37,37,37,37,37,0,0,0,0,0,0,0,0,0,0,
+    37,37,37,37,37,37,37,37,37,37,37,37,0,0,0,0,
+    13,17,17,37,37,21,37,37,22,17,22,17,22,17,22,17,
+    22,17,37,37,22,17,22,17,22,17,22,17,21,22,17,17,
+    37,37,37,37,37,37,37,37,37,37,4,4,4,4,4,4,
+    37,37,37,37,37,4,37,37,37,37,37,21,21,37,37,37,
+    0,31,37,31,37,31,37,31,37,31,37,37,37,37,37,37,
+    37,37,37,31,37,37,37,37,37,37,37,37,37,37,37,37,
+    37,37,37,31,37,31,37,31,37,37,37,37,37,37,31,37,
+    37,37,37,37,37,31,31,0,0,4,4,21,21,21,21,37,
+    21,31,37,31,37,31,37,31,37,31,37,37,37,37,37,37,
+    37,37,37,37,37,31,31,37,37,37,37,21,31,21,21,37,
+    0,0,0,0,0,37,37,37,37,37,37,37,37,37,37,37,
+    0,37,37,37,37,37,37,37,37,37,37,37,37,37,37,37,
+    37,37,37,37,37,37,37,37,37,37,37,37,37,37,37,0,
+    31,31,31,31,31,31,31,31,31,31,31,31,31,31,31,31,
+    37,37,37,37,37,37,37,37,29,29,29,29,29,29,29,29,
+    37,37,37,37,37,21,37,37,37,37,37,37,37,37,37,37,
+    37,37,37,37,37,37,37,37,37,37,37,37,37,0,0,0,
+    37,37,37,37,37,37,37,0,0,0,0,0,0,0,0,0,
+    30,30,30,30,30,30,30,30,30,30,30,30,30,13,19,13,
+    25,25,25,25,25,25,25,25,25,25,30,30,0,0,0,0,
+    4,4,4,30,4,4,4,4,4,4,4,4,4,4,30,30,
+    30,30,30,30,30,30,30,30,30,30,30,30,30,30,4,4,
+    4,4,30,13,13,13,13,13,0,0,0,0,0,0,0,0,
+    30,30,0,30,0,30,30,30,30,30,0,0,0,0,0,0,
+    0,0,30,30,30,30,30,30,30,30,30,30,30,30,30,30,
+    30,30,4,30,30,30,4,30,30,30,30,4,30,30,30,30,
+    30,30,30,4,4,4,4,4,30,30,30,30,4,0,0,0,
+    30,30,30,30,30,30,30,30,26,30,0,0,0,0,0,0,
+    30,30,30,30,14,14,19,19,0,0,0,0,0,0,0,0,
+    4,4,30,30,30,30,30,30,30,30,30,30,30,30,30,30,
+    4,4,4,4,4,4,0,0,0,0,0,0,0,0,13,13,
+    4,4,30,30,30,30,30,30,30,30,30,30,14,30,30,4,
+    30,30,30,30,30,30,4,4,4,4,4,4,4,4,13,13,
+    30,30,30,30,30,30,30,4,4,4,4,4,4,4,4,4,
+    4,4,4,4,0,0,0,0,0,0,0,0,0,0,0,30,
+    38,38,38,38,38,38,38,38,38,38,38,38,38,0,0,0,
+    30,30,30,4,4,4,4,4,4,4,4,4,4,4,4,4,
+    4,30,30,30,30,30,30,13,13,13,30,30,30,30,0,30,
+    25,25,25,25,25,25,25,25,25,25,0,0,0,0,30,30,
+    25,25,25,25,25,25,25,25,25,25,42,42,42,42,42,0,
+    30,30,30,30,30,30,30,30,30,4,4,4,4,4,4,4,
+    4,4,4,4,4,4,4,0,0,0,0,0,0,0,0,0,
+    30,30,30,4,30,30,30,30,30,30,30,30,4,4,0,0,
+    25,25,25,25,25,25,25,25,25,25,0,0,30,13,13,13,
+    42,42,42,0,0,0,0,0,0,0,0,0,0,0,0,0,
+    0,0,0,0,0,0,0,0,0,0,0,42,42,42,42,42,
+    13,13,30,30,30,4,4,0,0,0,0,0,0,0,0,0,
+    0,30,30,30,30,30,30,0,0,30,30,30,30,30,30,0,
+    0,30,30,30,30,30,30,0,0,0,0,0,0,0,0,0,
+    30,30,30,30,30,30,30,30,30,30,30,30,0,0,0,0,
+    30,30,30,4,4,4,4,4,4,4,4,13,4,4,0,0,
+    34,35,35,35,35,35,35,35,35,35,35,35,35,35,35,35,
+    35,35,35,35,35,35,35,35,35,35,35,35,34,35,35,35,
+    35,35,35,35,35,35,35,35,35,35,35,35,35,35,35,35,
+    35,35,35,35,35,35,35,35,34,35,35,35,35,35,35,35,
+    35,35,35,35,34,35,35,35,35,35,35,35,35,35,35,35,
+    35,35,35,35,0,0,0,0,0,0,0,0,0,0,0,0,
+    39,39,39,39,39,39,39,0,0,0,0,40,40,40,40,40,
+    40,40,40,40,40,40,40,40,40,40,40,40,0,0,0,0,
+    6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,
+    0,0,0,30,30,30,30,30,0,0,0,0,0,36,4,36,
+    36,36,36,36,36,36,36,36,36,30,36,36,36,36,36,36,
+    36,36,36,36,36,36,36,0,36,36,36,36,36,0,36,0,
+    36,36,0,36,36,0,36,36,36,36,36,36,36,36,36,36,
+    30,30,30,0,0,0,0,0,0,0,0,0,0,0,0,0,
+    0,0,0,30,30,30,30,30,30,30,30,30,30,30,30,30,
+    30,30,30,30,30,30,30,30,30,30,30,30,30,30,17,22,
+    30,30,30,30,30,30,30,30,30,30,30,30,26,30,30,30,
+    24,17,17,24,24,19,19,22,17,20,0,0,0,0,0,0,
+    37,37,37,37,37,22,17,22,17,22,17,22,17,22,17,22,
+    17,22,17,22,17,37,37,22,17,37,37,37,37,37,37,37,
+    17,37,17,0,21,21,19,19,37,22,17,22,17,22,17,37,
+    37,37,37,37,37,37,37,0,37,27,26,37,0,0,0,0,
+    30,30,30,30,30,30,30,30,30,30,30,30,30,0,0,7,
+    0,19,37,37,27,26,37,37,22,17,37,37,17,37,17,37,
+    37,37,37,37,37,37,37,37,37,37,21,21,37,37,37,19,
+    37,37,37,37,37,37,37,37,37,37,37,22,37,17,37,37,
+    37,37,37,37,37,37,37,37,37,37,37,22,37,17,37,22,
+    17,17,22,17,17,21,37,31,31,31,31,31,31,31,31,31,
+    31,37,37,37,37,37,37,37,37,37,37,37,37,37,37,37,
+    37,37,37,37,37,37,37,37,37,37,37,37,37,37,21,21,
+    0,0,37,37,37,37,37,37,0,0,37,37,37,37,37,37,
+    0,0,37,37,37,37,37,37,0,0,37,37,37,0,0,0,
+    26,27,37,37,37,27,27,0,30,30,30,30,30,30,30,0,
+    0,0,0,0,0,0,0,0,0,4,4,4,16,29,0,0,
+    30,30,30,30,30,30,30,30,30,30,30,30,0,30,30,30,
+    30,30,30,30,30,30,30,30,30,30,30,0,30,30,0,30,
+    13,13,13,0,0,0,0,30,30,30,30,30,30,30,30,30,
+    30,30,30,30,0,0,0,30,30,30,30,30,30,30,30,30,
+    30,30,30,30,30,30,30,30,30,30,30,30,30,4,0,0,
+    30,30,30,30,0,0,0,0,0,0,0,0,0,30,30,30,
+    30,30,30,30,30,30,4,4,4,4,4,0,0,0,0,0,
+    30,30,30,30,30,30,30,30,30,30,30,30,30,30,0,13,
+    30,30,30,30,0,0,0,0,30,30,30,30,30,30,30,30,
+    13,30,30,30,30,30,0,0,0,0,0,0,0,0,0,0,
+    30,30,30,30,0,0,0,0,0,0,0,0,0,0,0,30,
+    30,30,30,30,30,30,30,30,30,30,30,0,30,30,30,30,
+    30,30,30,0,30,30,0,30,30,30,30,30,30,30,30,30,
+    30,30,0,30,30,30,30,30,30,30,0,30,30,0,0,0,
+    30,0,30,30,30,30,30,30,30,30,30,0,0,0,0,0,
+    30,30,30,30,30,30,0,0,30,0,30,30,30,30,30,30,
+    30,30,30,30,30,30,0,30,30,0,0,0,30,0,0,30,
+    30,30,30,30,30,30,0,13,30,30,30,30,30,30,30,30,
+    0,0,0,0,0,0,0,30,30,30,30,30,30,30,30,30,
+    30,30,30,0,30,30,0,0,0,0,0,30,30,30,30,30,
+    30,30,30,30,30,30,30,30,30,30,30,30,0,0,0,13,
+    30,30,30,30,30,30,30,30,30,30,0,0,0,0,0,30,
+    30,30,30,30,30,30,30,30,0,0,0,0,30,30,30,30,
+    30,4,4,4,0,4,4,0,0,0,0,0,4,4,4,4,
+    30,30,30,30,0,30,30,30,0,30,30,30,30,30,30,30,
+    30,30,30,30,30,30,0,0,4,4,4,0,0,0,0,4,
+    13,13,13,13,13,13,13,13,30,0,0,0,0,0,0,0,
+    30,30,30,30,30,4,4,0,0,0,0,30,30,30,30,30,
+    13,13,13,13,13,13,20,0,0,0,0,0,0,0,0,0,
+    30,30,30,30,30,30,0,0,0,13,13,13,13,13,13,13,
+    30,30,30,30,30,30,0,0,30,30,30,30,30,30,30,30,
+    30,30,30,0,0,0,0,0,30,30,30,30,30,30,30,30,
+    30,30,0,0,0,0,0,0,0,30,30,30,30,0,0,0,
+    0,0,0,0,0,0,0,0,0,30,30,30,30,30,30,30,
+    30,30,30,0,0,0,0,0,0,0,30,30,30,30,30,30,
+    30,30,30,30,4,4,4,4,0,0,0,0,0,0,0,0,
+    30,30,30,30,30,30,30,30,30,30,0,4,4,13,0,0,
+    30,30,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+    4,30,30,30,30,30,30,30,30,30,0,0,0,0,0,0,
+    30,30,4,4,4,4,30,30,30,30,0,0,0,0,0,0,
+    30,30,30,30,30,30,30,30,4,4,4,4,4,4,4,4,
+    4,4,4,4,4,4,4,13,13,30,30,30,30,30,0,0,
+    30,30,30,30,30,30,25,25,25,25,25,25,25,25,25,25,
+    4,30,30,4,4,30,0,0,0,0,0,0,0,0,0,4,
+    4,4,4,4,4,4,4,4,4,4,4,30,30,30,13,13,
+    13,13,4,0,0,0,0,0,0,0,0,0,0,30,0,0,
+    4,4,4,4,4,0,25,25,25,25,25,25,25,25,25,25,
+    13,13,13,13,30,4,4,30,0,0,0,0,0,0,0,0,
+    30,30,30,4,30,14,30,0,0,0,0,0,0,0,0,0,
+    4,30,30,30,30,13,13,30,13,4,4,4,4,30,4,4,
+    25,25,25,25,25,25,25,25,25,25,30,14,30,13,13,13,
+    30,30,30,30,30,0,0,0,0,0,0,0,0,0,0,0,
+    30,30,30,30,30,30,30,30,30,30,30,30,4,4,4,4,
+    4,4,4,4,4,4,4,4,13,13,30,13,13,30,4,0,
+    30,30,30,30,30,30,30,0,30,0,30,30,30,30,0,30,
+    30,30,30,30,30,30,30,30,30,13,0,0,0,0,0,0,
+    4,4,4,4,4,4,4,4,4,4,4,0,0,0,0,0,
+    4,4,4,4,0,30,30,30,30,30,30,30,30,0,0,30,
+    30,0,30,30,0,30,30,30,30,30,0,4,4,30,4,4,
+    30,0,0,0,0,0,0,4,0,0,0,0,0,30,30,30,
+    30,30,4,4,0,0,4,4,4,4,4,4,4,0,0,0,
+    4,4,4,4,4,0,0,0,0,0,0,0,0,0,0,0,
+    30,30,30,30,30,4,4,4,4,4,4,4,4,4,4,4,
+    4,4,4,4,4,4,4,30,30,30,30,13,13,13,13,30,
+    25,25,25,25,25,25,25,25,25,25,13,13,0,30,4,30,
+    4,4,4,4,30,30,30,30,0,0,0,0,0,0,0,0,
+    4,4,4,4,4,4,0,0,4,4,4,4,4,4,4,4,
+    4,14,13,13,19,19,30,30,30,13,13,13,13,13,13,13,
+    13,13,13,13,13,13,13,13,30,30,30,30,4,4,0,0,
+    4,13,13,30,30,0,0,0,0,0,0,0,0,0,0,0,
+    14,14,14,14,14,14,14,14,14,14,14,14,14,0,0,0,
+    4,4,4,4,4,4,4,4,30,30,0,0,0,0,0,0,
+    42,42,42,42,42,42,42,42,42,42,42,0,0,42,42,42,
+    25,25,25,25,25,25,25,25,25,25,42,42,13,13,13,42,
+    42,42,42,42,42,42,42,0,0,0,0,0,0,0,0,0,
+    4,4,4,4,4,4,4,4,4,4,4,30,0,0,0,0,
+    30,30,30,0,0,0,0,0,0,0,0,0,0,0,0,30,
+    30,30,30,30,30,30,30,0,0,30,0,0,30,30,30,30,
+    30,30,30,30,0,30,30,0,30,30,30,30,30,30,30,30,
+    4,4,4,4,4,4,0,4,4,0,0,4,4,4,4,30,
+    4,30,4,4,13,13,13,0,0,0,0,0,0,0,0,0,
+    30,30,30,30,30,30,30,30,0,0,30,30,30,30,30,30,
+    30,4,4,4,4,4,4,4,0,0,4,4,4,4,4,4,
+    4,30,14,30,4,0,0,0,0,0,0,0,0,0,0,0,
+    30,4,4,4,4,4,4,4,4,4,4,30,30,30,30,30,
+    30,30,30,4,4,4,4,4,4,4,30,4,4,4,4,14,
+    30,13,13,13,13,14,30,4,0,0,0,0,0,0,0,0,
+    30,4,4,4,4,4,4,4,4,4,4,4,30,30,30,30,
+    4,4,4,4,4,4,4,4,4,4,13,13,13,30,14,14,
+    14,13,13,0,0,0,0,0,0,0,0,0,0,0,0,0,
+    4,4,4,4,4,4,4,0,4,4,4,4,4,4,4,4,
+    30,13,13,13,13,13,0,0,0,0,0,0,0,0,0,0,
+    14,19,30,30,30,30,30,30,30,30,30,30,30,30,30,30,
+    0,0,4,4,4,4,4,4,4,4,4,4,4,4,4,4,
+    30,30,30,30,30,30,30,0,30,30,0,30,30,30,30,30,
+    30,4,4,4,4,4,4,0,0,0,4,0,4,4,0,4,
+    4,4,4,4,4,4,30,4,0,0,0,0,0,0,0,0,
+    30,30,30,30,30,30,0,30,30,0,30,30,30,30,30,30,
+    30,30,30,30,30,30,30,30,30,30,4,4,4,4,4,0,
+    4,4,0,4,4,4,4,4,30,0,0,0,0,0,0,0,
+    30,30,30,4,4,4,4,30,30,0,0,0,0,0,0,0,
+    30,30,30,30,30,30,30,30,30,30,30,30,30,26,26,26,
+    26,30,30,30,30,30,30,30,30,30,30,30,30,30,30,30,
+    30,30,0,0,0,0,0,0,0,0,0,0,0,0,0,13,
+    13,13,13,13,13,0,0,0,0,0,0,0,0,0,0,0,
+    30,30,30,30,0,0,0,0,0,0,0,0,0,0,0,0,
+    30,30,30,30,30,30,30,30,22,22,22,17,17,17,30,30,
+    30,30,17,30,30,30,22,17,22,17,30,30,30,30,30,30,
+    30,30,30,30,30,30,30,30,30,22,17,17,30,30,30,30,
+    9,9,9,9,9,9,9,22,17,0,0,0,0,0,0,0,
+    30,30,30,30,30,30,30,30,30,30,30,30,30,30,22,17,
+    25,25,25,25,25,25,25,25,25,25,0,0,0,0,13,13,
+    4,4,4,4,4,13,0,0,0,0,0,0,0,0,0,0,
+    4,4,4,4,4,4,4,13,13,13,30,30,30,30,30,30,
+    30,30,30,30,13,30,0,0,0,0,0,0,0,0,0,0,
+    25,25,25,25,25,25,25,25,25,25,0,30,30,30,30,30,
+    30,30,30,30,30,30,30,30,0,0,0,0,0,30,30,30,
+    30,30,30,30,30,30,30,13,13,30,30,0,0,0,0,0,
+    30,30,30,30,30,30,30,30,30,30,30,0,0,0,0,4,
+    30,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,
+    4,4,4,4,4,4,4,4,0,0,0,0,0,0,0,4,
+    21,21,21,21,9,0,0,0,0,0,0,0,0,0,0,0,
+    4,4,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+    37,37,37,37,37,37,37,37,0,0,0,0,0,0,0,0,
+    37,37,37,37,37,37,37,37,37,0,0,0,0,0,0,0,
+    30,30,30,30,0,30,30,30,30,30,30,30,0,30,30,0,
+    37,37,37,0,0,0,0,0,0,0,0,0,0,0,0,0,
+    31,31,31,0,0,0,0,0,0,0,0,0,0,0,0,0,
+    0,0,0,0,31,31,31,31,0,0,0,0,0,0,0,0,
+    30,30,30,30,30,30,30,30,30,30,0,0,30,4,4,13,
+    4,4,4,4,0,0,0,0,0,0,0,0,0,0,0,0,
+    4,4,4,4,4,4,4,4,4,4,4,4,4,4,0,0,
+    30,30,30,30,30,4,4,4,4,4,30,30,30,4,4,4,
+    4,4,4,30,30,4,4,4,4,4,4,4,30,30,30,30,
+    30,30,30,30,30,30,30,30,30,30,4,4,4,4,30,30,
+    30,30,4,4,4,30,0,0,0,0,0,0,0,0,0,0,
+    0,0,30,0,0,30,30,0,0,30,30,30,30,0,30,30,
+    30,30,30,30,30,30,30,30,30,30,0,30,0,30,30,30,
+    30,30,30,30,0,30,30,30,30,30,30,30,30,30,30,30,
+    30,30,30,30,30,30,0,30,30,30,30,0,0,30,30,30,
+    30,30,30,30,30,0,30,30,30,30,30,30,30,0,30,30,
+    30,30,30,30,30,30,30,30,30,30,0,30,30,30,30,0,
+    30,30,30,30,30,0,30,0,0,0,30,30,30,30,30,30,
+    30,30,30,30,30,30,30,30,30,30,30,30,0,0,25,25,
+    25,25,25,25,25,25,25,25,25,25,25,25,25,25,25,25,
+    4,4,4,4,4,4,4,30,30,30,30,4,4,4,4,4,
+    4,4,4,4,4,4,4,4,4,4,4,4,4,30,30,30,
+    30,30,30,30,30,4,30,30,30,30,30,30,30,30,30,30,
+    30,30,30,30,4,30,30,13,13,13,13,30,0,0,0,0,
+    0,0,0,0,0,0,0,0,0,0,0,4,4,4,4,4,
+    4,4,4,4,4,4,4,4,4,0,0,4,4,4,4,4,
+    4,4,0,4,4,0,4,4,4,4,4,0,0,0,0,0,
+    4,4,4,4,4,4,4,30,30,30,30,30,30,30,0,0,
+    30,30,30,30,30,30,30,30,30,30,30,30,30,30,4,0,
+    25,25,25,25,25,25,25,25,25,25,0,0,0,0,0,27,
+    30,30,30,30,30,30,30,0,30,30,30,30,0,30,30,0,
+    30,30,30,30,30,0,0,30,30,30,30,30,30,30,30,30,
+    30,30,30,30,4,4,4,4,4,4,4,30,0,0,0,0,
+    25,25,25,25,25,25,25,25,25,25,0,0,0,0,22,22,
+    26,30,30,30,30,0,0,0,0,0,0,0,0,0,0,0,
+    0,30,30,0,30,0,0,30,0,30,30,30,30,30,30,30,
+    30,30,30,0,30,30,30,30,0,30,0,30,0,0,0,0,
+    0,0,30,0,0,0,0,30,0,30,0,30,0,30,30,30,
+    0,30,30,0,30,0,0,30,0,30,0,30,0,30,0,30,
+    0,30,30,0,30,0,0,30,30,30,30,0,30,30,30,30,
+    30,30,30,0,30,30,30,30,0,30,30,30,30,0,30,0,
+    30,30,30,30,30,30,30,30,30,30,0,30,30,30,30,30,
+    0,30,30,30,0,30,30,30,30,30,0,30,30,30,30,30,
+    29,29,29,29,29,29,29,29,29,29,29,29,29,37,37,37,
+    29,29,29,29,29,29,29,29,29,29,29,29,29,29,30,30,
+    29,29,29,29,29,29,29,29,29,29,30,30,30,37,37,37,
+    37,37,37,37,37,37,41,41,41,41,41,41,41,41,41,41,
+    41,41,41,41,41,41,41,41,41,41,41,41,41,41,41,41,
+    37,37,37,37,37,32,37,37,37,37,37,37,37,37,37,37,
+    37,37,37,37,37,37,37,37,37,37,37,37,30,30,37,37,
+    37,37,37,37,37,30,30,37,37,37,37,37,30,37,37,37,
+    37,37,32,32,32,37,37,32,37,37,32,32,32,37,37,37,
+    37,37,37,37,37,37,37,37,37,37,37,33,33,33,33,33,
+    37,37,32,32,37,37,32,32,32,32,32,32,32,32,32,32,
+    32,37,37,37,37,37,37,37,37,37,37,37,37,37,37,37,
+    37,37,37,37,37,37,32,32,32,32,32,32,32,32,32,32,
+    32,32,32,32,32,32,32,32,32,37,37,37,32,37,37,37,
+    37,32,32,32,37,32,32,32,37,37,37,37,37,37,37,32,
+    37,32,37,37,37,37,37,37,37,37,37,37,37,37,37,37,
+    30,37,30,37,30,37,37,37,37,37,32,37,37,37,37,30,
+    37,30,30,37,37,37,37,37,37,37,37,37,37,37,37,37,
+    30,30,30,30,30,30,30,37,37,37,37,37,37,37,37,37,
+    37,37,37,37,37,37,37,30,30,30,30,30,30,30,30,30,
+    30,30,30,30,30,37,37,37,37,37,37,37,37,37,37,37,
+    37,37,30,30,30,30,30,30,30,30,30,30,30,30,30,30,
+    30,30,30,30,30,30,30,30,30,30,37,37,37,37,37,37,
+    37,37,37,37,32,32,37,37,37,37,32,37,37,37,37,37,
+    32,37,37,37,37,32,32,37,37,37,37,37,37,37,37,37,
+    37,37,37,37,30,30,30,30,30,30,30,30,37,37,37,37,
+    37,37,37,37,30,30,30,30,30,30,37,37,37,37,37,37,
+    37,37,37,37,37,32,32,32,37,37,37,32,32,32,32,32,
+    30,30,30,30,30,30,23,23,23,21,21,21,30,30,30,30,
+    37,37,37,32,37,37,37,37,37,37,37,37,37,37,37,37,
+    37,37,37,37,32,32,32,37,37,37,37,37,37,37,37,37,
+    32,37,37,37,37,37,37,37,37,37,37,37,32,37,37,37,
+    30,30,30,30,37,37,37,37,37,37,37,37,37,37,37,37,
+    30,30,30,30,30,30,30,30,30,30,30,30,37,37,37,37,
+    30,30,30,30,30,30,30,30,37,37,37,37,37,37,37,37,
+    30,30,30,30,30,30,30,30,30,30,30,30,30,30,37,37,
+    30,30,30,30,30,30,30,30,30,30,30,30,32,37,37,32,
+    37,37,37,37,37,37,37,37,32,32,32,32,32,32,32,32,
+    37,37,37,37,37,37,32,37,37,37,37,37,37,37,37,37,
+    32,32,32,32,32,32,32,32,32,32,37,37,32,32,32,37,
+    37,37,37,37,37,37,37,32,37,37,37,37,37,37,37,37,
+    37,37,37,37,37,32,32,37,32,32,37,32,37,37,37,37,
+    37,37,37,37,37,37,37,37,37,37,37,37,37,32,32,32,
+    37,32,32,32,32,32,32,32,32,32,32,32,32,32,37,37,
+    37,37,37,32,32,32,37,37,37,37,37,37,37,37,37,37,
+    32,32,32,32,32,32,32,37,37,37,37,37,37,37,37,37,
+    30,30,30,0,30,30,30,30,30,30,30,30,30,30,30,30,
+    37,37,37,37,37,37,37,37,37,37,37,37,37,37,0,0,
+    0,4,0,0,0,0,0,0,0,0,0,0,0,0,0,0
+};
+
+static md_line_break_class md_get_line_break_class(md_utf32 cp)
+{
+    md_uint32 block;
+
+    if (cp > 0x10FFFF) {
+        return md_line_break_class_xx;
+    }
+
+    block = g_mdLineBreakBlocks[(g_mdLineBreakChunks[cp >> 9] << 5) + ((cp >> 4) & 31)];
+    return (md_line_break_class)g_mdLineBreakClasses[(block << 4) + (cp & 15)];
+}
+
+/*
+Decodes the code point at the start of the given UTF-8 string. Invalid sequences are decoded as the replacement character one byte at a
+time. Returns the number of bytes making up the code point which is always at least 1.
+*/
+static size_t md_utf8_decode_cp(const md_utf8* pUTF8, size_t utf8Len, md_utf32* pUTF32)
+{
+    md_uint8 b0 = (md_uint8)pUTF8[0];
+    size_t length;
+    md_utf32 cp;
+    size_t i;
+
+    MD_ASSERT(utf8Len > 0);
+
+    if (b0 < 0x80) {
+        *pUTF32 = b0;
+        return 1;
+    }
+
+    if ((b0 & 0xE0) == 0xC0) {
+        length = 2;
+        cp = b0 & 0x1F;
+    } else if ((b0 & 0xF0) == 0xE0) {
+        length = 3;
+        cp = b0 & 0x0F;
+    } else if ((b0 & 0xF8) == 0xF0) {
+        length = 4;
+        cp = b0 & 0x07;
+    } else {
+        *pUTF32 = MD_UNICODE_REPLACEMENT_CHARACTER;
+        return 1;
+    }
+
+    if (length > utf8Len) {
+        *pUTF32 = MD_UNICODE_REPLACEMENT_CHARACTER;
+        return 1;
+    }
+
+    for (i = 1; i < length; ++i) {
+        md_uint8 b = (md_uint8)pUTF8[i];
+        if ((b & 0xC0) != 0x80) {
+            *pUTF32 = MD_UNICODE_REPLACEMENT_CHARACTER;
+            return 1;
+        }
+
+        cp = (cp << 6) | (b & 0x3F);
+    }
+
+    *pUTF32 = cp;
+    return length;
+}
+
+/* LB1. Resolves classes that the pair rules don't deal with. */
+static md_line_break_class md_resolve_line_break_class(md_line_break_class lbc)
+{
+    switch (lbc)
+    {
+        case md_line_break_class_ai:
+        case md_line_break_class_sg:
+        case md_line_break_class_xx:
+        case md_line_break_class_sa:
+        {
+            return md_line_break_class_al;
+        }
+
+        case md_line_break_class_cj:
+        {
+            return md_line_break_class_ns;
+        }
+
+        default: return lbc;
+    }
+}
+
+#define MD_LBC_BIT(lbc) ((md_uint64)1 << (lbc))
+#define MD_LBC_IS(lbc, mask) ((MD_LBC_BIT(lbc) & (mask)) != 0)
+
+#define MD_LBC_MASK_AL_HL       (MD_LBC_BIT(md_line_break_class_al) | MD_LBC_BIT(md_line_break_class_hl))
+#define MD_LBC_MASK_HANGUL      (MD_LBC_BIT(md_line_break_class_jl) | MD_LBC_BIT(md_line_break_class_jv) | MD_LBC_BIT(md_line_break_class_jt) | MD_LBC_BIT(md_line_break_class_h2) | MD_LBC_BIT(md_line_break_class_h3))
+#define MD_LBC_MASK_ID_EB_EM    (MD_LBC_BIT(md_line_break_class_id) | MD_LBC_BIT(md_line_break_class_eb) | MD_LBC_BIT(md_line_break_class_em))
+
+/*
+Determines whether or not a line can be broken between two characters for the rules from LB11 onwards. [a] is the class of the character
+before the break, [b] is the class of the character after it, [beforeSpaces] is the class of the last character before any spaces leading up
+to the break and [beforeA] is the class of the character before [a].
+*/
+static md_bool32 md_can_break_between(md_line_break_class a, md_line_break_class b, md_line_break_class beforeSpaces, md_line_break_class beforeA, md_uint32 riCount)
+{
+    /* LB11 */
+    if (a == md_line_break_class_wj || b == md_line_break_class_wj) {
+        return MD_FALSE;
+    }
+
+    /* LB12 */
+    if (a == md_line_break_class_gl) {
+        return MD_FALSE;
+    }
+
+    /* LB12a */
+    if (b == md_line_break_class_gl && a != md_line_break_class_sp && a != md_line_break_class_ba && a != md_line_break_class_hy) {
+        return MD_FALSE;
+    }
+
+    /* LB13 */
+    if (MD_LBC_IS(b, MD_LBC_BIT(md_line_break_class_cl) | MD_LBC_BIT(md_line_break_class_cp) | MD_LBC_BIT(md_line_break_class_ex) | MD_LBC_BIT(md_line_break_class_is) | MD_LBC_BIT(md_line_break_class_sy))) {
+        return MD_FALSE;
+    }
+
+    /* LB14 to LB17. These look past any spaces. */
+    if (beforeSpaces == md_line_break_class_op) {
+        return MD_FALSE;
+    }
+    if (beforeSpaces == md_line_break_class_qu && b == md_line_break_class_op) {
+        return MD_FALSE;
+    }
+    if ((beforeSpaces == md_line_break_class_cl || beforeSpaces == md_line_break_class_cp) && b == md_line_break_class_ns) {
+        return MD_FALSE;
+    }
+    if (beforeSpaces == md_line_break_class_b2 && b == md_line_break_class_b2) {
+        return MD_FALSE;
+    }
+
+    /* LB18 */
+    if (a == md_line_break_class_sp) {
+        return MD_TRUE;
+    }
+
+    /* LB19 */
+    if (a == md_line_break_class_qu || b == md_line_break_class_qu) {
+        return MD_FALSE;
+    }
+
+    /* LB20 */
+    if (a == md_line_break_class_cb || b == md_line_break_class_cb) {
+        return MD_TRUE;
+    }
+
+    /* LB21 */
+    if (b == md_line_break_class_ba || b == md_line_break_class_hy || b == md_line_break_class_ns || a == md_line_break_class_bb) {
+        return MD_FALSE;
+    }
+
+    /* LB21a */
+    if (beforeA == md_line_break_class_hl && (a == md_line_break_class_hy || a == md_line_break_class_ba)) {
+        return MD_FALSE;
+    }
+
+    /* LB21b */
+    if (a == md_line_break_class_sy && b == md_line_break_class_hl) {
+        return MD_FALSE;
+    }
+
+    /* LB22 */
+    if (b == md_line_break_class_in) {
+        return MD_FALSE;
+    }
+
+    /* LB23 */
+    if ((MD_LBC_IS(a, MD_LBC_MASK_AL_HL) && b == md_line_break_class_nu) || (a == md_line_break_class_nu && MD_LBC_IS(b, MD_LBC_MASK_AL_HL))) {
+        return MD_FALSE;
+    }
+
+    /* LB23a */
+    if ((a == md_line_break_class_pr && MD_LBC_IS(b, MD_LBC_MASK_ID_EB_EM)) || (MD_LBC_IS(a, MD_LBC_MASK_ID_EB_EM) && b == md_line_break_class_po)) {
+        return MD_FALSE;
+    }
+
+    /* LB24 */
+    if (((a == md_line_break_class_pr || a == md_line_break_class_po) && MD_LBC_IS(b, MD_LBC_MASK_AL_HL)) || (MD_LBC_IS(a, MD_LBC_MASK_AL_HL) && (b == md_line_break_class_pr || b == md_line_break_class_po))) {
+        return MD_FALSE;
+    }
+
+    /* LB25 */
+    if ((a == md_line_break_class_cl || a == md_line_break_class_cp || a == md_line_break_class_nu) && (b == md_line_break_class_po || b == md_line_break_class_pr)) {
+        return MD_FALSE;
+    }
+    if ((a == md_line_break_class_po || a == md_line_break_class_pr) && (b == md_line_break_class_op || b == md_line_break_class_nu)) {
+        return MD_FALSE;
+    }
+    if (b == md_line_break_class_nu && MD_LBC_IS(a, MD_LBC_BIT(md_line_break_class_hy) | MD_LBC_BIT(md_line_break_class_is) | MD_LBC_BIT(md_line_break_class_nu) | MD_LBC_BIT(md_line_break_class_sy))) {
+        return MD_FALSE;
+    }
+
+    /* LB26 */
+    if (a == md_line_break_class_jl && MD_LBC_IS(b, MD_LBC_BIT(md_line_break_class_jl) | MD_LBC_BIT(md_line_break_class_jv) | MD_LBC_BIT(md_line_break_class_h2) | MD_LBC_BIT(md_line_break_class_h3))) {
+        return MD_FALSE;
+    }
+    if ((a == md_line_break_class_jv || a == md_line_break_class_h2) && (b == md_line_break_class_jv || b == md_line_break_class_jt)) {
+        return MD_FALSE;
+    }
+    if ((a == md_line_break_class_jt || a == md_line_break_class_h3) && b == md_line_break_class_jt) {
+        return MD_FALSE;
+    }
+
+    /* LB27 */
+    if ((MD_LBC_IS(a, MD_LBC_MASK_HANGUL) && b == md_line_break_class_po) || (a == md_line_break_class_pr && MD_LBC_IS(b, MD_LBC_MASK_HANGUL))) {
+        return MD_FALSE;
+    }
+
+    /* LB28 */
+    if (MD_LBC_IS(a, MD_LBC_MASK_AL_HL) && MD_LBC_IS(b, MD_LBC_MASK_AL_HL)) {
+        return MD_FALSE;
+    }
+
+    /* LB29 */
+    if (a == md_line_break_class_is && MD_LBC_IS(b, MD_LBC_MASK_AL_HL)) {
+        return MD_FALSE;
+    }
+
+    /* LB30. The East Asian width of the parenthesis is not checked. */
+    if ((MD_LBC_IS(a, MD_LBC_MASK_AL_HL | MD_LBC_BIT(md_line_break_class_nu)) && b == md_line_break_class_op) || (a == md_line_break_class_cp && MD_LBC_IS(b, MD_LBC_MASK_AL_HL | MD_LBC_BIT(md_line_break_class_nu)))) {
+        return MD_FALSE;
+    }
+
+    /* LB30a. Regional indicators are paired up. [riCount] is the number of them in a row before the break. */
+    if (a == md_line_break_class_ri && b == md_line_break_class_ri && (riCount & 1) != 0) {
+        return MD_FALSE;
+    }
+
+    /* LB30b */
+    if (a == md_line_break_class_eb && b == md_line_break_class_em) {
+        return MD_FALSE;
+    }
+
+    /* LB31 */
+    return MD_TRUE;
+}
+
+md_result md_find_line_breaks_utf8(const md_utf8* pTextUTF8, size_t textLength, md_uint8* pBreaks)
+{
+    size_t iByte;
+    md_line_break_class prev         = md_line_break_class_xx;  /* The class of the previous character, after LB9 and LB10 have been applied. */
+    md_line_break_class beforePrev   = md_line_break_class_xx;
+    md_line_break_class beforeSpaces = md_line_break_class_xx;  /* The class of the last character that wasn't a space. */
+    md_bool32 prevIsZWJ = MD_FALSE;
+    md_uint32 riCount = 0;
+
+    if (pTextUTF8 == NULL || pBreaks == NULL) {
+        return MD_INVALID_ARGS;
+    }
+
+    if (textLength == (size_t)-1) {
+        textLength = strlen(pTextUTF8);
+    }
+
+    MD_ZERO_MEMORY(pBreaks, textLength);
+
+    iByte = 0;
+    while (iByte < textLength) {
+        md_utf32 cp;
+        size_t cpLength = md_utf8_decode_cp(pTextUTF8 + iByte, textLength - iByte, &cp);
+        md_line_break_class original = md_get_line_break_class(cp);
+        md_line_break_class lbc = md_resolve_line_break_class(original);
+        md_uint8 breakType = 0;
+
+        if (iByte == 0) {
+            /* LB2. Never break at the start of the text. LB10 for a combining mark with nothing to combine with. */
+            if (lbc == md_line_break_class_cm || lbc == md_line_break_class_zwj) {
+                lbc = md_line_break_class_al;
+            }
+        } else if (prev == md_line_break_class_bk || (prev == md_line_break_class_cr && lbc != md_line_break_class_lf) || prev == md_line_break_class_lf || prev == md_line_break_class_nl) {
+            breakType = MD_LINE_BREAK_MANDATORY;    /* LB4 and LB5 */
+        } else if (lbc == md_line_break_class_bk || lbc == md_line_break_class_cr || lbc == md_line_break_class_lf || lbc == md_line_break_class_nl || lbc == md_line_break_class_sp || lbc == md_line_break_class_zw) {
+            breakType = 0;                          /* LB5, LB6 and LB7 */
+        } else if (beforeSpaces == md_line_break_class_zw) {
+            breakType = MD_LINE_BREAK_ALLOWED;      /* LB8 */
+        } else if ((lbc == md_line_break_class_cm || lbc == md_line_break_class_zwj) && prev != md_line_break_class_sp) {
+            /* LB9. Combining marks take the class of the character they're attached to so the state doesn't change. */
+            prevIsZWJ = (original == md_line_break_class_zwj);
+            iByte += cpLength;
+            continue;
+        } else if (prevIsZWJ) {
+            breakType = 0;                          /* LB8a */
+        } else {
+            /* LB10. Combining marks that weren't handled by LB9 are treated as alphabetic. */
+            if (lbc == md_line_break_class_cm || lbc == md_line_break_class_zwj) {
+                lbc = md_line_break_class_al;
+            }
+
+            if (md_can_break_between(prev, lbc, beforeSpaces, beforePrev, riCount)) {
+                breakType = MD_LINE_BREAK_ALLOWED;
+            }
+        }
+
+        /* A combining mark after a space or the start of the text starts a new character. */
+        if (lbc == md_line_break_class_cm || lbc == md_line_break_class_zwj) {
+            lbc = md_line_break_class_al;
+        }
+
+        pBreaks[iByte] = breakType;
+
+        beforePrev = prev;
+        prev       = lbc;
+        if (lbc != md_line_break_class_sp) {
+            beforeSpaces = lbc;
+        }
+
+        riCount   = (lbc == md_line_break_class_ri) ? riCount + 1 : 0;
+        prevIsZWJ = (original == md_line_break_class_zwj);
+
+        iByte += cpLength;
+    }
+
+    return MD_SUCCESS;
+}
+
+
 
 /**************************************************************************************************************************************************************
  **************************************************************************************************************************************************************
@@ -6092,6 +9427,25 @@ md_bool32 md_gc_is_point_inside_clip__gdi(md_gc* pGC, md_int32 x, md_int32 y)
     return PtVisible((HDC)pGC->gdi.hDC, x, y);
 }
 
+md_result md_gc_get_clip_bounds__gdi(md_gc* pGC, md_int32* pLeft, md_int32* pTop, md_int32* pRight, md_int32* pBottom)
+{
+    RECT rect;
+
+    MD_ASSERT(pGC != NULL);
+
+    /* This is in logical coordinates. When everything is clipped the rectangle is empty. */
+    if (GetClipBox((HDC)pGC->gdi.hDC, &rect) == ERROR) {
+        return MD_ERROR;
+    }
+
+    *pLeft   = rect.left;
+    *pTop    = rect.top;
+    *pRight  = rect.right;
+    *pBottom = rect.bottom;
+
+    return MD_SUCCESS;
+}
+
 void md_gc_fill__gdi(md_gc* pGC)
 {
     md_uint32 iState;
@@ -6246,75 +9600,62 @@ void md_gc_draw_gc__gdi(md_gc* pGC, md_gc* pSrcGC, md_int32 srcX, md_int32 srcY)
 }
 
 /* API */
-md_result md_itemize_utf16__gdi(md_font* pFont, const md_utf16* pTextUTF16, size_t textLength, md_item* pItems, md_uint32* pItemCount, md_itemize_state* pItemizeState)
+md_result md_itemize_utf16__gdi(md_font* pFont, const md_utf16* pTextUTF16, size_t textLength, md_item_buffer* pItems, md_itemize_state* pItemizeState)
 {
     HRESULT hResult;
-    md_uint32 itemCapacity;
     int scriptItemCount = 0;
     int iItem;
-    MD_SCRIPT_ITEM  pScriptItemsStack[1024];
-    MD_SCRIPT_ITEM* pScriptItemsHeap = NULL;
-    MD_SCRIPT_ITEM* pScriptItems = NULL;   /* Set to either pScriptItemsStack or pScriptItemsHeap. */
+    size_t scratchMark;
+    size_t scriptItemCap;
+    MD_SCRIPT_ITEM* pScriptItems;
 
     MD_ASSERT(pFont != NULL);
     MD_ASSERT(pTextUTF16 != NULL);
     MD_ASSERT(pTextUTF16[0] != '\0');
     MD_ASSERT(textLength > 0);
-    MD_ASSERT(pItemCount != NULL);
+    MD_ASSERT(pItems != NULL);
     
-    /* Uniscribe doesn't need the itemization state so we just clear it to zero. */
-    MD_ZERO_OBJECT(pItemizeState);
+    /* Uniscribe doesn't need the itemization state. */
+    (void)pItemizeState;
 
     /* ScriptItemize() uses an integer for the text length, so keep it simple and return an error if we're asking for more. */
     if (textLength > 0x7FFFFFFF) {
         return MD_INVALID_ARGS;
     }
 
-    itemCapacity = *pItemCount;
-
     /*
     Unfortunately ScriptItemize() is kind of bad when it comes to counting the number of items in the string. From the documentation:
     
         If the function returns E_OUTOFMEMORY, the application can call it again with a larger pItems buffer.
 
-    This means that the way to do this is to repeatedly call ScriptItemize() with ever increasing buffer sizes. We first try using a
-    stack-allocated buffer. If this is too small we will use the heap.
+    There can never be more items than there are characters, so we size the buffer from the text length plus one for the terminating item
+    which means the first call will practically always succeed. The buffer comes out of the font's scratch memory. The loop is only there
+    for robustness.
     */
+    scratchMark   = md_scratch_get_mark(&pFont->scratch);
+    scriptItemCap = textLength + 2;   /* Plus one for the null terminator item, and another because Uniscribe wants at least two. */
+    for (;;) {
+        pScriptItems = (MD_SCRIPT_ITEM*)md_scratch_alloc(&pFont->scratch, sizeof(*pScriptItems) * scriptItemCap);
+        if (pScriptItems == NULL) {
+            md_scratch_release(&pFont->scratch, scratchMark);
+            return MD_OUT_OF_MEMORY;
+        }
 
-    /* Try itemizing into the stack first. If this fails we fall back to the heap. */
-    hResult = ((MD_PFN_ScriptItemize)pFont->pAPI->gdi.ScriptItemize)((const wchar_t*)pTextUTF16, (int)textLength, MD_COUNTOF(pScriptItemsStack)-1, NULL, NULL, (SCRIPT_ITEM*)pScriptItemsStack, &scriptItemCount);   /* Subtract 1 from item capacity because the last item is always used as a null terminator. */
-    if (hResult == S_OK) {
-        pScriptItems = &pScriptItemsStack[0];
-    } else {
-        if (hResult == E_OUTOFMEMORY) {
-            /* Not enough room in the stack so try the heap. We just continuously increase the size of the buffer until it's big enough. */
-            size_t heapCap = MD_COUNTOF(pScriptItemsStack);
-            while (hResult == E_OUTOFMEMORY) {
-                MD_SCRIPT_ITEM* pNewScriptItemsHeap;
-
-                heapCap *= 2;
-                if (heapCap > 0x7FFFFFFF) {
-                    MD_FREE(pScriptItemsHeap);
-                    return MD_INVALID_ARGS; /* String is too long for Uniscribe. */
-                }
-
-                pNewScriptItemsHeap = (MD_SCRIPT_ITEM*)MD_REALLOC(pScriptItemsHeap, sizeof(*pNewScriptItemsHeap) * heapCap);
-                if (pNewScriptItemsHeap == NULL) {
-                    MD_FREE(pScriptItemsHeap);
-                    return MD_OUT_OF_MEMORY;
-                }
-
-                pScriptItemsHeap = pNewScriptItemsHeap;
+        hResult = ((MD_PFN_ScriptItemize)pFont->pAPI->gdi.ScriptItemize)((const wchar_t*)pTextUTF16, (int)textLength, (int)(scriptItemCap-1), NULL, NULL, (SCRIPT_ITEM*)pScriptItems, &scriptItemCount);   /* Subtract 1 from item capacity because the last item is always used as a null terminator. */
+        if (hResult != E_OUTOFMEMORY) {
+            break;
+        }
 
-                hResult = ((MD_PFN_ScriptItemize)pFont->pAPI->gdi.ScriptItemize)((const wchar_t*)pTextUTF16, (int)textLength, (int)(heapCap-1), NULL, NULL, (SCRIPT_ITEM*)pScriptItemsHeap, &scriptItemCount);   /* Subtract 1 from item capacity because the last item is always used as a null terminator. */
-            }
+        md_scratch_release(&pFont->scratch, scratchMark);
 
-            pScriptItems = pScriptItemsHeap;
+        scriptItemCap *= 2;
+        if (scriptItemCap > 0x7FFFFFFF) {
+            return MD_INVALID_ARGS; /* String is too long for Uniscribe. */
         }
     }
 
     if (hResult != S_OK) {
-        MD_FREE(pScriptItemsHeap);
+        md_scratch_release(&pFont->scratch, scratchMark);
         return md_result_from_HRESULT(hResult); /* Something bad happened. */
     }
 
@@ -6333,30 +9674,19 @@ md_result md_itemize_utf16__gdi(md_font* pFont, const md_utf16* pTextUTF16, size
         }
     }
 
-    /*
-    Make sure the item count is always set, even in the event of future errors. This ensures the count is available in the event that the input capacity is too small in which
-    case the caller can resize their input buffer accordingly.
-    */
-    *pItemCount = (md_uint32)scriptItemCount;
-
-
     /* At this point we have our SCRIPT_ITEM objects, so now we need to convert the SCRIPT_ITEM objects to md_item objects. */
-    if (pItems != NULL) {
-        if (itemCapacity >= (md_uint32)scriptItemCount) {
-            for (iItem = 0; iItem < scriptItemCount; ++iItem) {
-                pItems[iItem].offset            = (size_t)pScriptItems[iItem].iCharPos;
-                pItems[iItem].length            = (size_t)(pScriptItems[iItem+1].iCharPos - pScriptItems[iItem].iCharPos);
-                pItems[iItem].backend.gdi.sa    = pScriptItems[iItem].a;
-                pItems[iItem].backend.gdi.hFont = pFont->gdi.hFont; /* For now always use the input font for all items, but we will likely want to implement some kind of font fallback system. Font fallback should be implemented in md_shape_utf16__gdi() for Unicode. */
-                pItems[iItem].backend.gdi.sc    = pFont->gdi.sc;    /* ^^^ */
-            }
-        } else {
-            MD_FREE(pScriptItemsHeap);
-            return MD_NO_SPACE; /* Not enough room*/
+    for (iItem = 0; iItem < scriptItemCount; ++iItem) {
+        md_item* pItem = md_item_buffer_push(pItems);
+        if (pItem != NULL) {
+            pItem->offset            = (size_t)pScriptItems[iItem].iCharPos;
+            pItem->length            = (size_t)(pScriptItems[iItem+1].iCharPos - pScriptItems[iItem].iCharPos);
+            pItem->backend.gdi.sa    = pScriptItems[iItem].a;
+            pItem->backend.gdi.hFont = pFont->gdi.hFont;    /* For now always use the input font for all items, but we will likely want to implement some kind of font fallback system. Font fallback should be implemented in md_shape_utf16__gdi() for Unicode. */
+            pItem->backend.gdi.sc    = pFont->gdi.sc;       /* ^^^ */
         }
     }
 
-    MD_FREE(pScriptItemsHeap);
+    md_scratch_release(&pFont->scratch, scratchMark);
     return MD_SUCCESS;
 }
 
@@ -6368,6 +9698,18 @@ void md_free_itemize_state__gdi(md_itemize_state* pItemizeState)
     (void)pItemizeState;
 }
 
+md_uint64 md_item_get_analysis_key__gdi(const md_item* pItem)
+{
+    md_uint32 sa;
+
+    MD_ASSERT(pItem != NULL);
+    MD_ASSERT(sizeof(pItem->backend.gdi.sa) == sizeof(sa));
+
+    /* Shaping depends on the SCRIPT_ANALYSIS and the font. GDI handles are 32-bit values so these can be packed together without any chance of a collision. */
+    MD_COPY_MEMORY(&sa, &pItem->backend.gdi.sa, sizeof(sa));
+    return ((md_uint64)sa << 32) ^ (md_uint64)(size_t)pItem->backend.gdi.hFont;
+}
+
 md_result md_shape_utf16__gdi(md_font* pFont, md_item* pItem, const md_utf16* pTextUTF16, size_t textLength, md_glyph* pGlyphs, size_t* pGlyphCount, size_t* pClusters, md_text_metrics* pRunMetrics)
 {
     HRESULT hResult;
@@ -6375,22 +9717,14 @@ md_result md_shape_utf16__gdi(md_font* pFont, md_item* pItem, const md_utf16* pT
     ABC abc;
     int glyphCount;
     size_t outputGlyphCap;
-    WORD  pUniscribeClustersStack[4096];
-    WORD* pUniscribeClustersHeap = NULL;
-    WORD* pUniscribeClusters = NULL;
-    void* pGlyphDataHeap = NULL;                    /* Single heap allocation for all per-glyph data. */
-    WORD  pUniscribeGlyphsStack[4096];
-    WORD* pUniscribeGlyphsHeap = NULL;              /* Offset of pGlyphDataHeap. */
+    size_t scratchMark;
+    size_t glyphCap;
+    size_t glyphDataMark;
+    WORD* pUniscribeClusters;
     WORD* pUniscribeGlyphs;
-    MD_SCRIPT_VISATTR  pUniscribeSVAStack[4096];
-    MD_SCRIPT_VISATTR* pUniscribeSVAHeap = NULL;    /* Offset of pGlyphDataHeap. */
-    MD_SCRIPT_VISATTR* pUniscribeSVA = NULL;
-    int  pUniscribeAdvancesStack[4096];
-    int* pUniscribeAdvancesHeap = NULL;             /* Offset of pGlyphDataHeap. */
-    int* pUniscribeAdvances = NULL;
-    GOFFSET  pUniscribeOffsetsStack[4096];
-    GOFFSET* pUniscribeOffsetsHeap = NULL;          /* Offset of pGlyphDataHeap. */
-    GOFFSET* pUniscribeOffsets = NULL;
+    MD_SCRIPT_VISATTR* pUniscribeSVA;
+    int* pUniscribeAdvances;
+    GOFFSET* pUniscribeOffsets;
 
     MD_ASSERT(pItem != NULL);
     MD_ASSERT(pFont != NULL);
@@ -6411,80 +9745,63 @@ md_result md_shape_utf16__gdi(md_font* pFont, md_item* pItem, const md_utf16* pT
         outputGlyphCap = 0;
     }
 
-    /* We need the same number of clusters as textLength. */
-    if (textLength <= MD_COUNTOF(pUniscribeClustersStack)) {
-        pUniscribeClusters = &pUniscribeClustersStack[0];
-    } else {
-        pUniscribeClustersHeap = (WORD*)MD_MALLOC(sizeof(*pUniscribeClustersHeap) * textLength);
-        if (pUniscribeClustersHeap == NULL) {
-            return MD_OUT_OF_MEMORY;
-        }
+    scratchMark = md_scratch_get_mark(&pFont->scratch);
 
-        pUniscribeClusters = pUniscribeClustersHeap;
+    /* We need the same number of clusters as textLength. */
+    pUniscribeClusters = (WORD*)md_scratch_alloc(&pFont->scratch, sizeof(*pUniscribeClusters) * textLength);
+    if (pUniscribeClusters == NULL) {
+        return MD_OUT_OF_MEMORY;
     }
 
     /* TODO: Font fallback. */
 
-    /* We first try with a NULL DC. If this fails we need to select the font into the global DC and try again. */
-    hResult = ((MD_PFN_ScriptShape)pFont->pAPI->gdi.ScriptShape)(NULL, (SCRIPT_CACHE*)&pFont->gdi.sc, (const WCHAR*)pTextUTF16, (int)textLength, MD_COUNTOF(pUniscribeGlyphsStack), (SCRIPT_ANALYSIS*)&pItem->backend.gdi.sa, pUniscribeGlyphsStack, pUniscribeClusters, (SCRIPT_VISATTR*)pUniscribeSVAStack, &glyphCount);
-    if (hResult == E_PENDING) {
-        /* Select the font into the global DC and try again, this time with the DC set to the global DC. */
-        hDC = (HDC)pFont->pAPI->gdi.hGlobalDC;
-        SelectObject(hDC, (HGDIOBJ)pFont->gdi.hFont);
-        hResult = ((MD_PFN_ScriptShape)pFont->pAPI->gdi.ScriptShape)(hDC, (SCRIPT_CACHE*)&pFont->gdi.sc, (const WCHAR*)pTextUTF16, (int)textLength, MD_COUNTOF(pUniscribeGlyphsStack), (SCRIPT_ANALYSIS*)&pItem->backend.gdi.sa, pUniscribeGlyphsStack, pUniscribeClusters, (SCRIPT_VISATTR*)pUniscribeSVAStack, &glyphCount);
-    }
-
-    if (hResult == S_OK) {
-        pUniscribeGlyphs   = &pUniscribeGlyphsStack[0];
-        pUniscribeSVA      = &pUniscribeSVAStack[0];
-        pUniscribeAdvances = &pUniscribeAdvancesStack[0];
-        pUniscribeOffsets  = &pUniscribeOffsetsStack[0];
-    } else {
-        if (hResult == E_OUTOFMEMORY) {
-            /* Not enough room in the stack, so try the heap. We need to continuously call ScriptShape() with ever increasing buffer sizes until it works. */
-            size_t heapCap = MD_COUNTOF(pUniscribeGlyphsStack);
-            while (hResult == E_OUTOFMEMORY) {
-                void* pNewGlyphDataHeap;
-
-                heapCap *= 2;
-                if (heapCap > 0x7FFFFFFF) {
-                    MD_FREE(pUniscribeClustersHeap);
-                    MD_FREE(pGlyphDataHeap);
-                    return MD_INVALID_ARGS; /* String is too long for Uniscribe. */
-                }
-
-                pNewGlyphDataHeap = MD_REALLOC(pGlyphDataHeap, (sizeof(*pUniscribeGlyphsHeap)+sizeof(*pUniscribeSVAHeap)+sizeof(*pUniscribeAdvancesHeap)+sizeof(*pUniscribeOffsetsHeap)) * heapCap);
-                if (pNewGlyphDataHeap == NULL) {
-                    MD_FREE(pUniscribeClustersHeap);
-                    MD_FREE(pGlyphDataHeap);
-                    return MD_OUT_OF_MEMORY;
-                }
+    /*
+    The per-glyph buffers are sized from the text length using the estimate recommended by the ScriptShape() documentation. If that turns out
+    to be too small we need to continuously call ScriptShape() with ever increasing buffer sizes until it works.
+    */
+    glyphDataMark = md_scratch_get_mark(&pFont->scratch);
+    glyphCap = textLength + (textLength / 2) + 16;
+    for (;;) {
+        pUniscribeGlyphs   =              (WORD*)md_scratch_alloc(&pFont->scratch, sizeof(*pUniscribeGlyphs)   * glyphCap);
+        pUniscribeSVA      = (MD_SCRIPT_VISATTR*)md_scratch_alloc(&pFont->scratch, sizeof(*pUniscribeSVA)      * glyphCap);
+        pUniscribeAdvances =               (int*)md_scratch_alloc(&pFont->scratch, sizeof(*pUniscribeAdvances) * glyphCap);
+        pUniscribeOffsets  =           (GOFFSET*)md_scratch_alloc(&pFont->scratch, sizeof(*pUniscribeOffsets)  * glyphCap);
+        if (pUniscribeGlyphs == NULL || pUniscribeSVA == NULL || pUniscribeAdvances == NULL || pUniscribeOffsets == NULL) {
+            md_scratch_release(&pFont->scratch, scratchMark);
+            return MD_OUT_OF_MEMORY;
+        }
 
-                pGlyphDataHeap = pNewGlyphDataHeap;
+        /* We first try with a NULL DC. If this fails we need to select the font into the global DC and try again. */
+        hResult = ((MD_PFN_ScriptShape)pFont->pAPI->gdi.ScriptShape)(hDC, (SCRIPT_CACHE*)&pFont->gdi.sc, (const WCHAR*)pTextUTF16, (int)textLength, (int)glyphCap, (SCRIPT_ANALYSIS*)&pItem->backend.gdi.sa, pUniscribeGlyphs, pUniscribeClusters, (SCRIPT_VISATTR*)pUniscribeSVA, &glyphCount);
+        if (hResult == E_PENDING && hDC == NULL) {
+            /* Select the font into the global DC and try again, this time with the DC set to the global DC. */
+            hDC = (HDC)pFont->pAPI->gdi.hGlobalDC;
+            SelectObject(hDC, (HGDIOBJ)pFont->gdi.hFont);
+            hResult = ((MD_PFN_ScriptShape)pFont->pAPI->gdi.ScriptShape)(hDC, (SCRIPT_CACHE*)&pFont->gdi.sc, (const WCHAR*)pTextUTF16, (int)textLength, (int)glyphCap, (SCRIPT_ANALYSIS*)&pItem->backend.gdi.sa, pUniscribeGlyphs, pUniscribeClusters, (SCRIPT_VISATTR*)pUniscribeSVA, &glyphCount);
+        }
 
-                pUniscribeGlyphsHeap   = (WORD*)pGlyphDataHeap;
-                pUniscribeSVAHeap      = (MD_SCRIPT_VISATTR*)MD_OFFSET_PTR(pGlyphDataHeap, (sizeof(*pUniscribeGlyphsHeap))                                                            * heapCap);
-                pUniscribeAdvancesHeap =               (int*)MD_OFFSET_PTR(pGlyphDataHeap, (sizeof(*pUniscribeGlyphsHeap)+sizeof(*pUniscribeSVAHeap))                                 * heapCap);
-                pUniscribeOffsetsHeap  =           (GOFFSET*)MD_OFFSET_PTR(pGlyphDataHeap, (sizeof(*pUniscribeGlyphsHeap)+sizeof(*pUniscribeSVAHeap)+sizeof(*pUniscribeAdvancesHeap)) * heapCap);
+        if (hResult != E_OUTOFMEMORY) {
+            break;
+        }
 
-                hResult = ((MD_PFN_ScriptShape)pFont->pAPI->gdi.ScriptShape)(hDC, (SCRIPT_CACHE*)&pFont->gdi.sc, (const WCHAR*)pTextUTF16, (int)textLength, (int)heapCap, (SCRIPT_ANALYSIS*)&pItem->backend.gdi.sa, pUniscribeGlyphsHeap, pUniscribeClusters, (SCRIPT_VISATTR*)pUniscribeSVAHeap, &glyphCount);
-            }
+        md_scratch_release(&pFont->scratch, glyphDataMark);
 
-            pUniscribeGlyphs   = pUniscribeGlyphsHeap;
-            pUniscribeSVA      = pUniscribeSVAHeap;
-            pUniscribeAdvances = pUniscribeAdvancesHeap;
-            pUniscribeOffsets  = pUniscribeOffsetsHeap;
-        } else {
-            MD_FREE(pUniscribeClustersHeap);
-            return md_result_from_HRESULT(hResult);
+        glyphCap *= 2;
+        if (glyphCap > 0x7FFFFFFF) {
+            md_scratch_release(&pFont->scratch, scratchMark);
+            return MD_INVALID_ARGS; /* String is too long for Uniscribe. */
         }
     }
 
+    if (hResult != S_OK) {
+        md_scratch_release(&pFont->scratch, scratchMark);
+        return md_result_from_HRESULT(hResult);
+    }
+
     /* Placement. */
     hResult = ((MD_PFN_ScriptPlace)pFont->pAPI->gdi.ScriptPlace)(hDC, (SCRIPT_CACHE*)&pFont->gdi.sc, pUniscribeGlyphs, (int)glyphCount, (const SCRIPT_VISATTR*)pUniscribeSVA, (SCRIPT_ANALYSIS*)&pItem->backend.gdi.sa, pUniscribeAdvances, pUniscribeOffsets, &abc);
     if (hResult != S_OK) {
-        MD_FREE(pUniscribeClustersHeap);
-        MD_FREE(pGlyphDataHeap);
+        md_scratch_release(&pFont->scratch, scratchMark);
         return md_result_from_HRESULT(hResult);
     }
 
@@ -6517,12 +9834,11 @@ md_result md_shape_utf16__gdi(md_font* pFont, md_item* pItem, const md_utf16* pT
         pRunMetrics->lPadding = abc.abcA;
         pRunMetrics->rPadding = abc.abcC;
         pRunMetrics->sizeX    = abc.abcA + abc.abcB + abc.abcC;
-        pRunMetrics->sizeY    = (pFont->metrics.ascent - pFont->metrics.descent);
+        pRunMetrics->sizeY    = pFont->metricsCache.lineSizeY;
     }
 
 
-    MD_FREE(pUniscribeClustersHeap);
-    MD_FREE(pGlyphDataHeap);
+    md_scratch_release(&pFont->scratch, scratchMark);
 
     /* Make sure MD_NO_SPACE is returned in the event that the output glyph count exceeds the capacity of the output buffer. */
     if (pGlyphCount != NULL && (size_t)glyphCount > outputGlyphCap) {
@@ -6536,37 +9852,24 @@ void md_gc_draw_glyphs__gdi(md_gc* pGC, const md_item* pItem, const md_glyph* pG
 {
     HRESULT hResult;
     size_t iGlyph;
-    void* pHeap = NULL;
-    WORD  pUniscribeGlyphsStack[4096];
-    WORD* pUniscribeGlyphsHeap = NULL;              /* Offset of pHeap. */
+    size_t scratchMark;
     WORD* pUniscribeGlyphs;
-    int  pUniscribeAdvancesStack[4096];
-    int* pUniscribeAdvancesHeap = NULL;             /* Offset of pHeap. */
-    int* pUniscribeAdvances = NULL;
-    GOFFSET  pUniscribeOffsetsStack[4096];
-    GOFFSET* pUniscribeOffsetsHeap = NULL;          /* Offset of pHeap. */
-    GOFFSET* pUniscribeOffsets = NULL;
+    int* pUniscribeAdvances;
+    GOFFSET* pUniscribeOffsets;
 
     /* ScriptTextOut() uses an integer for the glyph count, so keep it simple and return an error if we're asking for more. */
     if (glyphCount > 0x7FFFFFFF) {
         return; /* MD_INVALID_ARGS */
     }
 
-    if (glyphCount <= MD_COUNTOF(pUniscribeAdvancesStack)) {
-        /* Stack allocation. */
-        pUniscribeGlyphs   = &pUniscribeGlyphsStack[0];
-        pUniscribeAdvances = &pUniscribeAdvancesStack[0];
-        pUniscribeOffsets  = &pUniscribeOffsetsStack[0];
-    } else {
-        /* Heap allocation. */
-        pHeap = MD_MALLOC((sizeof(*pUniscribeGlyphsHeap)+sizeof(*pUniscribeAdvancesHeap)+sizeof(*pUniscribeOffsetsHeap)) * glyphCount);
-        if (pHeap == NULL) {
-            return; /* MD_OUT_OF_MEMORY */
-        }
+    scratchMark = md_scratch_get_mark(&pGC->scratch);
 
-        pUniscribeGlyphs   =    (WORD*)MD_OFFSET_PTR(pHeap, 0);
-        pUniscribeAdvances =     (int*)MD_OFFSET_PTR(pHeap, (sizeof(*pUniscribeGlyphsHeap))                                 * glyphCount);
-        pUniscribeOffsets  = (GOFFSET*)MD_OFFSET_PTR(pHeap, (sizeof(*pUniscribeGlyphsHeap)+sizeof(*pUniscribeAdvancesHeap)) * glyphCount);
+    pUniscribeGlyphs   =    (WORD*)md_scratch_alloc(&pGC->scratch, sizeof(*pUniscribeGlyphs)   * glyphCount);
+    pUniscribeAdvances =     (int*)md_scratch_alloc(&pGC->scratch, sizeof(*pUniscribeAdvances) * glyphCount);
+    pUniscribeOffsets  = (GOFFSET*)md_scratch_alloc(&pGC->scratch, sizeof(*pUniscribeOffsets)  * glyphCount);
+    if (pUniscribeGlyphs == NULL || pUniscribeAdvances == NULL || pUniscribeOffsets == NULL) {
+        md_scratch_release(&pGC->scratch, scratchMark);
+        return; /* MD_OUT_OF_MEMORY */
     }
 
     for (iGlyph = 0; iGlyph < (size_t)glyphCount; ++iGlyph) {
@@ -6579,6 +9882,9 @@ void md_gc_draw_glyphs__gdi(md_gc* pGC, const md_item* pItem, const md_glyph* pG
     SelectObject((HDC)pGC->gdi.hDC, (HFONT)pItem->backend.gdi.hFont);
 
     hResult = ((MD_PFN_ScriptTextOut)pGC->pAPI->gdi.ScriptTextOut)((HDC)pGC->gdi.hDC, &((md_item*)pItem)->backend.gdi.sc, x, y, /* fuOptions */ETO_OPAQUE, NULL, (SCRIPT_ANALYSIS*)&pItem->backend.gdi.sa, NULL, 0, pUniscribeGlyphs, (int)glyphCount, pUniscribeAdvances, NULL, pUniscribeOffsets);
+
+    md_scratch_release(&pGC->scratch, scratchMark);
+
     if (hResult != S_OK) {
         return; /* Error occurred. */
     }
@@ -6676,6 +9982,7 @@ md_result md_init__gdi(const md_api_config* pConfig, md_api* pAPI)
     pAPI->procs.itemizeUTF16               = md_itemize_utf16__gdi;
     pAPI->procs.itemizeUTF32               = NULL;   /* No native support for UTF-32 with Uniscribe. */
     pAPI->procs.freeItemizeState           = md_free_itemize_state__gdi;
+    pAPI->procs.itemGetAnalysisKey         = md_item_get_analysis_key__gdi;
     pAPI->procs.shapeUTF8                  = NULL;   /* No native support for UTF-8 with Uniscribe. */
     pAPI->procs.shapeUTF16                 = md_shape_utf16__gdi;
     pAPI->procs.shapeUTF32                 = NULL;   /* No native support for UTF-32 with Uniscribe. */
@@ -6727,6 +10034,7 @@ md_result md_init__gdi(const md_api_config* pConfig, md_api* pAPI)
     pAPI->procs.gcClip                     = md_gc_clip__gdi;
     pAPI->procs.gcResetClip                = md_gc_reset_clip__gdi;
     pAPI->procs.gcIsPointInsideClip        = md_gc_is_point_inside_clip__gdi;
+    pAPI->procs.gcGetClipBounds            = md_gc_get_clip_bounds__gdi;
     pAPI->procs.gcFill                     = md_gc_fill__gdi;
     pAPI->procs.gcStroke                   = md_gc_stroke__gdi;
     pAPI->procs.gcFillAndStroke            = md_gc_fill_and_stroke__gdi;
@@ -6962,6 +10270,36 @@ md_result md_font_get_glyph_metrics_by_index__cairo(md_font* pFont, const md_uin
 
 
 /* Brush */
+MD_PRIVATE cairo_pattern_t* md_create_gradient_pattern__cairo(const md_brush_config* pConfig)
+{
+    cairo_pattern_t* pCairoPattern;
+    md_uint32 iStop;
+
+    MD_ASSERT(pConfig != NULL);
+    MD_ASSERT(pConfig->type == md_brush_type_linear || pConfig->type == md_brush_type_radial);
+
+    if (pConfig->pColorStops == NULL && pConfig->colorStopCount > 0) {
+        return NULL;
+    }
+
+    if (pConfig->type == md_brush_type_linear) {
+        pCairoPattern = cairo_pattern_create_linear(pConfig->linear.x0, pConfig->linear.y0, pConfig->linear.x1, pConfig->linear.y1);
+    } else {
+        pCairoPattern = cairo_pattern_create_radial(pConfig->radial.cx0, pConfig->radial.cy0, pConfig->radial.radius0, pConfig->radial.cx1, pConfig->radial.cy1, pConfig->radial.radius1);
+    }
+
+    if (pCairoPattern == NULL) {
+        return NULL;
+    }
+
+    for (iStop = 0; iStop < pConfig->colorStopCount; ++iStop) {
+        const md_color_stop* pStop = &pConfig->pColorStops[iStop];
+        cairo_pattern_add_color_stop_rgba(pCairoPattern, pStop->offset, pStop->color.r/255.0, pStop->color.g/255.0, pStop->color.b/255.0, pStop->color.a/255.0);
+    }
+
+    return pCairoPattern;
+}
+
 md_result md_brush_init__cairo(md_api* pAPI, const md_brush_config* pConfig, md_brush* pBrush)
 {
     cairo_pattern_t* pCairoPattern = NULL;
@@ -6982,6 +10320,12 @@ md_result md_brush_init__cairo(md_api* pAPI, const md_brush_config* pConfig, md_
             }
         } break;
 
+        case md_brush_type_linear:
+        case md_brush_type_radial:
+        {
+            pCairoPattern = md_create_gradient_pattern__cairo(pConfig);
+        } break;
+
         case md_brush_type_gc:
         {
             if (pConfig->gc.pGC == NULL) {
@@ -7631,6 +10975,26 @@ md_bool32 md_gc_is_point_inside_clip__cairo(md_gc* pGC, md_int32 x, md_int32 y)
     return (md_bool32)cairo_in_clip((cairo_t*)pGC->cairo.pCairoContext, (double)x, (double)y);
 }
 
+md_result md_gc_get_clip_bounds__cairo(md_gc* pGC, md_int32* pLeft, md_int32* pTop, md_int32* pRight, md_int32* pBottom)
+{
+    double x1;
+    double y1;
+    double x2;
+    double y2;
+
+    MD_ASSERT(pGC != NULL);
+
+    /* This is in user space. */
+    cairo_clip_extents((cairo_t*)pGC->cairo.pCairoContext, &x1, &y1, &x2, &y2);
+
+    *pLeft   = (md_int32)floor(x1);
+    *pTop    = (md_int32)floor(y1);
+    *pRight  = (md_int32)ceil(x2);
+    *pBottom = (md_int32)ceil(y2);
+
+    return MD_SUCCESS;
+}
+
 
 MD_PRIVATE cairo_filter_t md_to_cairo_filter(md_stretch_filter filter)
 {
@@ -7659,9 +11023,15 @@ MD_PRIVATE void md_gc_set_source_from_brush_config__cairo(md_gc* pGC, const md_b
         {
             cairo_set_source_rgba((cairo_t*)pGC->cairo.pCairoContext, pConfig->solid.color.r/255.0, pConfig->solid.color.g/255.0, pConfig->solid.color.b/255.0, pConfig->solid.color.a/255.0);
         } break;
-        /*case md_brush_type_linear:
+        case md_brush_type_linear:
+        case md_brush_type_radial:
         {
-        } break;*/
+            cairo_pattern_t* pCairoPattern = md_create_gradient_pattern__cairo(pConfig);
+            if (pCairoPattern != NULL) {
+                cairo_set_source((cairo_t*)pGC->cairo.pCairoContext, pCairoPattern);
+                cairo_pattern_destroy(pCairoPattern);   /* The context holds its own reference. */
+            }
+        } break;
         case md_brush_type_gc:
         {
             cairo_set_source_surface((cairo_t*)pGC->cairo.pCairoContext, (cairo_surface_t*)pConfig->gc.pGC->cairo.pCairoSurface, 0, 0);
@@ -7792,20 +11162,27 @@ MD_PRIVATE void md_free_pango_items__cairo(GList* pPangoItems)
     g_list_free(pPangoItems);
 }
 
-md_result md_itemize_utf8__cairo(md_font* pFont, const md_utf8* pTextUTF8, size_t textLength, md_item* pItems, md_uint32* pItemCount, md_itemize_state* pItemizeState)
+MD_PRIVATE void md_push_item__cairo(md_font* pFont, md_item_buffer* pItems, PangoItem* pPangoItem, size_t offset, size_t length)
+{
+    md_item* pItem = md_item_buffer_push(pItems);
+    if (pItem != NULL) {
+        pItem->offset = offset;
+        pItem->length = length;
+        pItem->backend.cairo.pPangoItem = pPangoItem;
+        pItem->backend.cairo.pFont      = pFont;
+    }
+}
+
+md_result md_itemize_utf8__cairo(md_font* pFont, const md_utf8* pTextUTF8, size_t textLength, md_item_buffer* pItems, md_itemize_state* pItemizeState)
 {
     GList* pPangoItems;
-    md_uint32 itemCap;
-    md_uint32 itemCount = 0;
+    GList* pListItem;
 
     MD_ASSERT(pFont != NULL);
     MD_ASSERT(textLength > 0);
     MD_ASSERT(pTextUTF8 != NULL);
     MD_ASSERT(pTextUTF8[0] != '\0');
-    MD_ASSERT(pItemCount != NULL);
-    MD_ASSERT(pItemizeState != NULL);
-
-    itemCap = *pItemCount;
+    MD_ASSERT(pItems != NULL);
 
     pPangoItems = pango_itemize((PangoContext*)pFont->pAPI->cairo.pPangoContext, pTextUTF8, 0, (gint)textLength, (PangoAttrList*)pFont->cairo.pPangoAttrList, NULL);
     if (pPangoItems == NULL) {
@@ -7817,159 +11194,66 @@ md_result md_itemize_utf8__cairo(md_font* pFont, const md_utf8* pTextUTF8, size_
         * New lines
         * Tabs
     */
-    if (pItems != NULL) {
-        md_uint32 iItem = 0;
-        GList* pListItem;
-        for (pListItem = g_list_first(pPangoItems); pListItem != NULL; pListItem = g_list_next(pListItem)) {
-            const char* pLineBegUTF8;
-            const char* pLineEndUTF8;
-            PangoItem* pPangoItem = (PangoItem*)pListItem->data;
-
-            pLineBegUTF8 = pTextUTF8 + pPangoItem->offset;
-            for (;;) {  /* For each line... */
-                const char* pNextLineBegUTF8;
-                pNextLineBegUTF8 = md_next_line_utf8(pLineBegUTF8, (size_t)((pTextUTF8 + pPangoItem->offset + pPangoItem->length) - pLineBegUTF8), &pLineEndUTF8);
-
-                /* The space between pLineBegUTF8 and pLineEndUTF8 is the line content. */
-                if ((pLineEndUTF8 - pLineBegUTF8) > 0) {
-                    /* Split tabs. */
-                    const char* pTabbedSegmentBegUTF8 = pLineBegUTF8;
-                    const char* pTabbedSegmentEndUTF8;
-                    for (;;) {
-                        const char* pNextTabbedSegmentBegUTF8;
-                        pNextTabbedSegmentBegUTF8 = md_next_tabbed_segment(pTabbedSegmentBegUTF8, (size_t)(pLineEndUTF8 - pTabbedSegmentBegUTF8), &pTabbedSegmentEndUTF8);
-
-                        /* The main segment. */
-                        if ((pTabbedSegmentEndUTF8 - pTabbedSegmentBegUTF8) > 0) {
-                            itemCount += 1;
-                            if (itemCount > itemCap) {
-                                break;  /* Not enough room in the output buffer. */
-                            }
-
-                            pItems[iItem].offset = (size_t)(pTabbedSegmentBegUTF8 - pTextUTF8);
-                            pItems[iItem].length = (size_t)(pTabbedSegmentEndUTF8 - pTabbedSegmentBegUTF8);
-                            pItems[iItem].backend.cairo.pPangoItem = pPangoItem;
-                            iItem += 1;
-                        }
-
-                        /* The \t characters. */
-                        if ((pNextTabbedSegmentBegUTF8 - pTabbedSegmentEndUTF8) > 0) {
-                            itemCount += 1;
-                            if (itemCount > itemCap) {
-                                break;  /* Not enough room in the output buffer. */
-                            }
-
-                            pItems[iItem].offset = (size_t)(pTabbedSegmentEndUTF8 - pTextUTF8);
-                            pItems[iItem].length = (size_t)(pNextTabbedSegmentBegUTF8 - pTabbedSegmentEndUTF8);
-                            pItems[iItem].backend.cairo.pPangoItem = pPangoItem;
-                            iItem += 1;
-                        }
-
-                        /* Get out of the loop if we reached the end. */
-                        if (pNextTabbedSegmentBegUTF8 == NULL) {
-                            break;
-                        }
-
-                        pTabbedSegmentBegUTF8 = pNextTabbedSegmentBegUTF8;
+    for (pListItem = g_list_first(pPangoItems); pListItem != NULL; pListItem = g_list_next(pListItem)) {
+        const char* pLineBegUTF8;
+        const char* pLineEndUTF8;
+        PangoItem* pPangoItem = (PangoItem*)pListItem->data;
+
+        pLineBegUTF8 = pTextUTF8 + pPangoItem->offset;
+        for (;;) {  /* For each line... */
+            const char* pNextLineBegUTF8;
+            pNextLineBegUTF8 = md_next_line_utf8(pLineBegUTF8, (size_t)((pTextUTF8 + pPangoItem->offset + pPangoItem->length) - pLineBegUTF8), &pLineEndUTF8);
+
+            /* The space between pLineBegUTF8 and pLineEndUTF8 is the line content. */
+            if ((pLineEndUTF8 - pLineBegUTF8) > 0) {
+                /* Split tabs. */
+                const char* pTabbedSegmentBegUTF8 = pLineBegUTF8;
+                const char* pTabbedSegmentEndUTF8;
+                for (;;) {
+                    const char* pNextTabbedSegmentBegUTF8;
+                    pNextTabbedSegmentBegUTF8 = md_next_tabbed_segment(pTabbedSegmentBegUTF8, (size_t)(pLineEndUTF8 - pTabbedSegmentBegUTF8), &pTabbedSegmentEndUTF8);
+
+                    /* The main segment. */
+                    if ((pTabbedSegmentEndUTF8 - pTabbedSegmentBegUTF8) > 0) {
+                        md_push_item__cairo(pFont, pItems, pPangoItem, (size_t)(pTabbedSegmentBegUTF8 - pTextUTF8), (size_t)(pTabbedSegmentEndUTF8 - pTabbedSegmentBegUTF8));
                     }
 
-                    if (itemCount > itemCap) {
-                        break;  /* Not enough room in the output buffer. */
-                    }
-                }
-                
-                /* The space between pLineEndUTF8 and pNextLineBegUTF8 is the new line character. */
-                if ((pNextLineBegUTF8 - pLineEndUTF8) > 0) {
-                    itemCount += 1;
-                    if (itemCount > itemCap) {
-                        break;  /* Not enough room in the output buffer. */
+                    /* Get out of the loop if we reached the end. */
+                    if (pNextTabbedSegmentBegUTF8 == NULL) {
+                        break;
                     }
 
-                    pItems[iItem].offset = (size_t)(pLineEndUTF8 - pTextUTF8);
-                    pItems[iItem].length = (size_t)(pNextLineBegUTF8 - pLineEndUTF8);
-                    pItems[iItem].backend.cairo.pPangoItem = pPangoItem;
-                    iItem += 1;
-                }
+                    /* The \t characters. */
+                    if ((pNextTabbedSegmentBegUTF8 - pTabbedSegmentEndUTF8) > 0) {
+                        md_push_item__cairo(pFont, pItems, pPangoItem, (size_t)(pTabbedSegmentEndUTF8 - pTextUTF8), (size_t)(pNextTabbedSegmentBegUTF8 - pTabbedSegmentEndUTF8));
+                    }
 
-                /* Get out of the loop if we reached the end. */
-                if (pNextLineBegUTF8 == NULL) {
-                    break;
+                    pTabbedSegmentBegUTF8 = pNextTabbedSegmentBegUTF8;
                 }
-
-                pLineBegUTF8 = pNextLineBegUTF8;
             }
-        }
-
-        pItemizeState->backend.cairo.pPangoItems = pPangoItems;
-    } else {
-        /* Just counting. */
-        GList* pListItem;
-        for (pListItem = g_list_first(pPangoItems); pListItem != NULL; pListItem = g_list_next(pListItem)) {
-            const char* pLineBegUTF8;
-            const char* pLineEndUTF8;
-            PangoItem* pPangoItem = (PangoItem*)pListItem->data;
-
-            pLineBegUTF8 = pTextUTF8 + pPangoItem->offset;
-            for (;;) {  /* For each line... */
-                const char* pNextLineBegUTF8;
-                pNextLineBegUTF8 = md_next_line_utf8(pLineBegUTF8, (size_t)((pTextUTF8 + pPangoItem->offset + pPangoItem->length) - pLineBegUTF8), &pLineEndUTF8);
-
-                /* The space between pLineBegUTF8 and pLineEndUTF8 is the line content. */
-                if ((pLineEndUTF8 - pLineBegUTF8) > 0) {
-                    /* Split tabs. */
-                    const char* pTabbedSegmentBegUTF8 = pLineBegUTF8;
-                    const char* pTabbedSegmentEndUTF8;
-                    for (;;) {
-                        const char* pNextTabbedSegmentBegUTF8;
-                        pNextTabbedSegmentBegUTF8 = md_next_tabbed_segment(pTabbedSegmentBegUTF8, (size_t)(pLineEndUTF8 - pTabbedSegmentBegUTF8), &pTabbedSegmentEndUTF8);
-
-                        /* The main segment. */
-                        if ((pTabbedSegmentEndUTF8 - pTabbedSegmentBegUTF8) > 0) {
-                            itemCount += 1;
-                        }
-
-                        /* The \t characters. */
-                        if ((pNextTabbedSegmentBegUTF8 - pTabbedSegmentEndUTF8) > 0) {
-                            itemCount += 1;
-                        }
-
-                        /* Get out of the loop if we reached the end. */
-                        if (pNextTabbedSegmentBegUTF8 == NULL) {
-                            break;
-                        }
-
-                        pTabbedSegmentBegUTF8 = pNextTabbedSegmentBegUTF8;
-                    }
-                }
-                
-                /* The space between pLineEndUTF8 and pNextLineBegUTF8 is the new line character. */
-                if ((pNextLineBegUTF8 - pLineEndUTF8) > 0) {
-                    itemCount += 1;
-                }
 
-                /* Get out of the loop if we reached the end. */
-                if (pNextLineBegUTF8 == NULL) {
-                    break;
-                }
+            /* Get out of the loop if we reached the end. */
+            if (pNextLineBegUTF8 == NULL) {
+                break;
+            }
 
-                pLineBegUTF8 = pNextLineBegUTF8;
+            /* The space between pLineEndUTF8 and pNextLineBegUTF8 is the new line character. */
+            if ((pNextLineBegUTF8 - pLineEndUTF8) > 0) {
+                md_push_item__cairo(pFont, pItems, pPangoItem, (size_t)(pLineEndUTF8 - pTextUTF8), (size_t)(pNextLineBegUTF8 - pLineEndUTF8));
             }
-        }
 
-        if (pItemizeState != NULL) {
-            pItemizeState->backend.cairo.pPangoItems = pPangoItems;
-        } else {
-            md_free_pango_items__cairo(pPangoItems);
-            pPangoItems = NULL;
+            pLineBegUTF8 = pNextLineBegUTF8;
         }
     }
 
-    if (itemCount > itemCap) {
-        return MD_NO_SPACE;
+    /* The items reference the Pango items so they need to stay alive until the itemize state is freed. */
+    if (pItemizeState != NULL) {
+        pItemizeState->backend.cairo.pPangoItems = pPangoItems;
+    } else {
+        md_free_pango_items__cairo(pPangoItems);
+        pPangoItems = NULL;
     }
 
-    *pItemCount = itemCount;
-
     return MD_SUCCESS;
 }
 
@@ -7981,6 +11265,27 @@ void md_free_itemize_state__cairo(md_itemize_state* pItemizeState)
     pItemizeState->backend.cairo.pPangoItems = NULL;
 }
 
+md_uint64 md_item_get_analysis_key__cairo(const md_item* pItem)
+{
+    const PangoAnalysis* pAnalysis;
+    md_uint64 key;
+
+    MD_ASSERT(pItem != NULL);
+
+    /* Everything in the analysis that pango_shape() looks at. The font is the one Pango chose for the item which may be a fallback. */
+    pAnalysis = &((PangoItem*)pItem->backend.cairo.pPangoItem)->analysis;
+
+    key = md_hash_init();
+    key = md_hash_bytes(key, &pAnalysis->font,     sizeof(pAnalysis->font));
+    key = md_hash_bytes(key, &pAnalysis->language, sizeof(pAnalysis->language));
+    key = md_hash_bytes(key, &pAnalysis->level,    sizeof(pAnalysis->level));
+    key = md_hash_bytes(key, &pAnalysis->gravity,  sizeof(pAnalysis->gravity));
+    key = md_hash_bytes(key, &pAnalysis->flags,    sizeof(pAnalysis->flags));
+    key = md_hash_bytes(key, &pAnalysis->script,   sizeof(pAnalysis->script));
+
+    return key;
+}
+
 md_result md_shape_utf8__cairo(md_font* pFont, md_item* pItem, const md_utf8* pTextUTF8, size_t textLength, md_glyph* pGlyphs, size_t* pGlyphCount, size_t* pClusters, md_text_metrics* pRunMetrics)
 {
     PangoGlyphString* pPangoGlyphString;
@@ -8022,9 +11327,10 @@ md_result md_shape_utf8__cairo(md_font* pFont, md_item* pItem, const md_utf8* pT
             pGlyphs[iGlyph].backend.cairo.width   = pPangoGlyphString->glyphs[iGlyph].geometry.width;
             pGlyphs[iGlyph].backend.cairo.offsetX = pPangoGlyphString->glyphs[iGlyph].geometry.x_offset;
             pGlyphs[iGlyph].backend.cairo.offsetY = pPangoGlyphString->glyphs[iGlyph].geometry.y_offset;
+            pGlyphs[iGlyph].backend.cairo.isClusterStart = pPangoGlyphString->glyphs[iGlyph].attr.is_cluster_start;
             metrics.sizeX += pGlyphs[iGlyph].advance;
         }
-        metrics.sizeY = pFont->metrics.ascent - pFont->metrics.descent;
+        metrics.sizeY = pFont->metricsCache.lineSizeY;
     } else {
         /* The output glyph array is NULL, but we may still want to calculate metrics. */
         if (pRunMetrics != NULL) {
@@ -8034,7 +11340,7 @@ md_result md_shape_utf8__cairo(md_font* pFont, md_item* pItem, const md_utf8* pT
             for (iGlyph = 0; iGlyph < pPangoGlyphString->num_glyphs; ++iGlyph) {
                 metrics.sizeX += pPangoGlyphString->glyphs[iGlyph].geometry.width / PANGO_SCALE;
             }
-            metrics.sizeY = pFont->metrics.ascent - pFont->metrics.descent;
+            metrics.sizeY = pFont->metricsCache.lineSizeY;
         }
     }
 
@@ -8066,9 +11372,8 @@ void md_gc_draw_glyphs__cairo(md_gc* pGC, const md_item* pItem, const md_glyph*
     md_color bgColor;
     md_uint32 textWidth = 0;
     PangoGlyphString glyphString;
-    PangoGlyphInfo  pGlyphInfoStack[4096];
-    PangoGlyphInfo* pGlyphInfoHeap = NULL;
-    PangoGlyphInfo* pGlyphInfo = NULL;
+    size_t scratchMark;
+    PangoGlyphInfo* pGlyphInfo;
     PangoFont* pPangoFont;
     PangoFontMetrics* pPangoFontMetrics;
     md_int32 ascent;
@@ -8080,28 +11385,26 @@ void md_gc_draw_glyphs__cairo(md_gc* pGC, const md_item* pItem, const md_glyph*
 
     pPangoFont = ((PangoItem*)pItem->backend.cairo.pPangoItem)->analysis.font;
 
-    /* May want to optimize this... */
-    pPangoFontMetrics = pango_font_get_metrics(pPangoFont, NULL);
-    ascent  =  pango_font_metrics_get_ascent(pPangoFontMetrics)  / PANGO_SCALE;
-    descent = -pango_font_metrics_get_descent(pPangoFontMetrics) / PANGO_SCALE;
-    pango_font_metrics_unref(pPangoFontMetrics);
+    /* The metrics of our own font are already known. Only fallback fonts need to be queried. */
+    if (pPangoFont == (PangoFont*)pItem->backend.cairo.pFont->cairo.pPangoFont) {
+        ascent  = pItem->backend.cairo.pFont->metrics.ascent;
+        descent = pItem->backend.cairo.pFont->metrics.descent;
+    } else {
+        pPangoFontMetrics = pango_font_get_metrics(pPangoFont, NULL);
+        ascent  =  pango_font_metrics_get_ascent(pPangoFontMetrics)  / PANGO_SCALE;
+        descent = -pango_font_metrics_get_descent(pPangoFontMetrics) / PANGO_SCALE;
+        pango_font_metrics_unref(pPangoFontMetrics);
+    }
 
     iState  = pGC->cairo.stateCount-1;
     fgColor = pGC->cairo.pState[iState].textFGColor;
     bgColor = pGC->cairo.pState[iState].textBGColor;
 
     /* Unfortunately Pango's API doesn't map too well with minidraw's. We need to build our own glyph string. */
-    if (glyphCount <= MD_COUNTOF(pGlyphInfoStack)) {
-        /* Enough room on the stack. */
-        pGlyphInfo = pGlyphInfoStack;
-    } else {
-        /* Try a heap allocation. */
-        pGlyphInfoHeap = (PangoGlyphInfo*)MD_MALLOC(sizeof(*pGlyphInfoHeap) * glyphCount);
-        if (pGlyphInfoHeap == NULL) {
-            return; /* Out of memory. */
-        }
-
-        pGlyphInfo = pGlyphInfoHeap;
+    scratchMark = md_scratch_get_mark(&pGC->scratch);
+    pGlyphInfo  = (PangoGlyphInfo*)md_scratch_alloc(&pGC->scratch, sizeof(*pGlyphInfo) * glyphCount);
+    if (pGlyphInfo == NULL) {
+        return; /* Out of memory. */
     }
 
     glyphString.num_glyphs = (gint)glyphCount;
@@ -8127,7 +11430,7 @@ void md_gc_draw_glyphs__cairo(md_gc* pGC, const md_item* pItem, const md_glyph*
     cairo_set_source_rgba((cairo_t*)pGC->cairo.pCairoContext, fgColor.r/255.0, fgColor.g/255.0, fgColor.b/255.0, fgColor.a/255.0);
     pango_cairo_show_glyph_string((cairo_t*)pGC->cairo.pCairoContext, pPangoFont, &glyphString);
 
-    MD_FREE(pGlyphInfoHeap);
+    md_scratch_release(&pGC->scratch, scratchMark);
 }
 
 void md_gc_clear__cairo(md_gc* pGC, md_color color)
@@ -8163,6 +11466,7 @@ md_result md_init__cairo(const md_api_config* pConfig, md_api* pAPI)
     pAPI->procs.itemizeUTF16               = NULL;    /* No native support for UTF-16 with Pango. */
     pAPI->procs.itemizeUTF32               = NULL;    /* No native support for UTF-32 with Pango. */
     pAPI->procs.freeItemizeState           = md_free_itemize_state__cairo;
+    pAPI->procs.itemGetAnalysisKey         = md_item_get_analysis_key__cairo;
     pAPI->procs.shapeUTF8                  = md_shape_utf8__cairo;
     pAPI->procs.shapeUTF16                 = NULL;    /* No native support for UTF-16 with Pango. */
     pAPI->procs.shapeUTF32                 = NULL;    /* No native support for UTF-32 with Pango. */
@@ -8214,6 +11518,7 @@ md_result md_init__cairo(const md_api_config* pConfig, md_api* pAPI)
     pAPI->procs.gcClip                     = md_gc_clip__cairo;
     pAPI->procs.gcResetClip                = md_gc_reset_clip__cairo;
     pAPI->procs.gcIsPointInsideClip        = md_gc_is_point_inside_clip__cairo;
+    pAPI->procs.gcGetClipBounds            = md_gc_get_clip_bounds__cairo;
     pAPI->procs.gcFill                     = md_gc_fill__cairo;
     pAPI->procs.gcStroke                   = md_gc_stroke__cairo;
     pAPI->procs.gcFillAndStroke            = md_gc_fill_and_stroke__cairo;
@@ -8259,2393 +11564,10639 @@ md_result md_init__cairo(const md_api_config* pConfig, md_api* pAPI)
 
 /**************************************************************************************************************************************************************
 
- Custom
+ Software
 
  **************************************************************************************************************************************************************/
-md_result md_init__custom(const md_api_config* pConfig, md_api* pAPI)
+#if defined(MD_HAS_SOFTWARE)
+#include <math.h>   /* For sqrt(), sin(), cos(), tan(), floor() and ceil(). */
+
+#define MD_SOFTWARE_PATH_MOVE_TO    0
+#define MD_SOFTWARE_PATH_LINE_TO    1
+#define MD_SOFTWARE_PATH_CURVE_TO   2
+#define MD_SOFTWARE_PATH_CLOSE      3
+
+#define MD_SOFTWARE_CONTOUR_CLOSED  0x80000000  /* Set on an entry in md_polygon_software.pContourEnds when the contour was closed with md_gc_close_path(). */
+#define MD_SOFTWARE_FLATTEN_TOLERANCE   0.1f    /* The maximum distance in pixels between a curve and its flattened approximation. The same as Cairo's default. */
+#define MD_SOFTWARE_MAX_CURVE_SEGMENTS  512     /* Upper limit on the number of line segments a single curve can be flattened into. */
+#define MD_SOFTWARE_MAX_FAST_RECTS      8       /* The maximum number of rectangles in a path for it to be filled without going through the rasterizer. */
+#define MD_SOFTWARE_GLYPH_ATLAS_SIZE    256     /* The size in pixels of each glyph cache atlas page. Glyphs larger than this are drawn without the cache. */
+#define MD_SOFTWARE_GLYPH_SUBPIXEL_STEPS 4      /* The number of subpixel positions glyphs are rendered at in each dimension. */
+#define MD_SOFTWARE_GRADIENT_RAMP_SIZE  256     /* The number of colors a gradient's color stops are baked into. An extra transparent entry follows the ramp. */
+#define MD_SOFTWARE_PI              3.14159265358979323846
+
+/*
+The software backend has no font engine, so it ships with a small built-in 8x8 bitmap font covering printable ASCII (U+0020 to U+007E). This is the public
+domain font8x8_basic set by Daniel Hepper. Bit 0 of each byte is the left-most pixel. Glyph index 0 is reserved for code points that are not covered by
+the font and is drawn as a hollow box. Every other glyph index is the code point minus 0x1F.
+*/
+static const md_uint8 g_mdFont8x8__software[95][8] = {
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },   /* U+0020 (space) */
+    { 0x18, 0x3C, 0x3C, 0x18, 0x18, 0x00, 0x18, 0x00 },   /* U+0021 (!) */
+    { 0x36, 0x36, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },   /* U+0022 (") */
+    { 0x36, 0x36, 0x7F, 0x36, 0x7F, 0x36, 0x36, 0x00 },   /* U+0023 (#) */
+    { 0x0C, 0x3E, 0x03, 0x1E, 0x30, 0x1F, 0x0C, 0x00 },   /* U+0024 ($) */
+    { 0x00, 0x63, 0x33, 0x18, 0x0C, 0x66, 0x63, 0x00 },   /* U+0025 (%) */
+    { 0x1C, 0x36, 0x1C, 0x6E, 0x3B, 0x33, 0x6E, 0x00 },   /* U+0026 (&) */
+    { 0x06, 0x06, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00 },   /* U+0027 (') */
+    { 0x18, 0x0C, 0x06, 0x06, 0x06, 0x0C, 0x18, 0x00 },   /* U+0028 (() */
+    { 0x06, 0x0C, 0x18, 0x18, 0x18, 0x0C, 0x06, 0x00 },   /* U+0029 ()) */
+    { 0x00, 0x66, 0x3C, 0xFF, 0x3C, 0x66, 0x00, 0x00 },   /* U+002A (*) */
+    { 0x00, 0x0C, 0x0C, 0x3F, 0x0C, 0x0C, 0x00, 0x00 },   /* U+002B (+) */
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C, 0x06 },   /* U+002C (,) */
+    { 0x00, 0x00, 0x00, 0x3F, 0x00, 0x00, 0x00, 0x00 },   /* U+002D (-) */
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C, 0x00 },   /* U+002E (.) */
+    { 0x60, 0x30, 0x18, 0x0C, 0x06, 0x03, 0x01, 0x00 },   /* U+002F (/) */
+    { 0x3E, 0x63, 0x73, 0x7B, 0x6F, 0x67, 0x3E, 0x00 },   /* U+0030 (0) */
+    { 0x0C, 0x0E, 0x0C, 0x0C, 0x0C, 0x0C, 0x3F, 0x00 },   /* U+0031 (1) */
+    { 0x1E, 0x33, 0x30, 0x1C, 0x06, 0x33, 0x3F, 0x00 },   /* U+0032 (2) */
+    { 0x1E, 0x33, 0x30, 0x1C, 0x30, 0x33, 0x1E, 0x00 },   /* U+0033 (3) */
+    { 0x38, 0x3C, 0x36, 0x33, 0x7F, 0x30, 0x78, 0x00 },   /* U+0034 (4) */
+    { 0x3F, 0x03, 0x1F, 0x30, 0x30, 0x33, 0x1E, 0x00 },   /* U+0035 (5) */
+    { 0x1C, 0x06, 0x03, 0x1F, 0x33, 0x33, 0x1E, 0x00 },   /* U+0036 (6) */
+    { 0x3F, 0x33, 0x30, 0x18, 0x0C, 0x0C, 0x0C, 0x00 },   /* U+0037 (7) */
+    { 0x1E, 0x33, 0x33, 0x1E, 0x33, 0x33, 0x1E, 0x00 },   /* U+0038 (8) */
+    { 0x1E, 0x33, 0x33, 0x3E, 0x30, 0x18, 0x0E, 0x00 },   /* U+0039 (9) */
+    { 0x00, 0x0C, 0x0C, 0x00, 0x00, 0x0C, 0x0C, 0x00 },   /* U+003A (:) */
+    { 0x00, 0x0C, 0x0C, 0x00, 0x00, 0x0C, 0x0C, 0x06 },   /* U+003B (;) */
+    { 0x18, 0x0C, 0x06, 0x03, 0x06, 0x0C, 0x18, 0x00 },   /* U+003C (<) */
+    { 0x00, 0x00, 0x3F, 0x00, 0x00, 0x3F, 0x00, 0x00 },   /* U+003D (=) */
+    { 0x06, 0x0C, 0x18, 0x30, 0x18, 0x0C, 0x06, 0x00 },   /* U+003E (>) */
+    { 0x1E, 0x33, 0x30, 0x18, 0x0C, 0x00, 0x0C, 0x00 },   /* U+003F (?) */
+    { 0x3E, 0x63, 0x7B, 0x7B, 0x7B, 0x03, 0x1E, 0x00 },   /* U+0040 (@) */
+    { 0x0C, 0x1E, 0x33, 0x33, 0x3F, 0x33, 0x33, 0x00 },   /* U+0041 (A) */
+    { 0x3F, 0x66, 0x66, 0x3E, 0x66, 0x66, 0x3F, 0x00 },   /* U+0042 (B) */
+    { 0x3C, 0x66, 0x03, 0x03, 0x03, 0x66, 0x3C, 0x00 },   /* U+0043 (C) */
+    { 0x1F, 0x36, 0x66, 0x66, 0x66, 0x36, 0x1F, 0x00 },   /* U+0044 (D) */
+    { 0x7F, 0x46, 0x16, 0x1E, 0x16, 0x46, 0x7F, 0x00 },   /* U+0045 (E) */
+    { 0x7F, 0x46, 0x16, 0x1E, 0x16, 0x06, 0x0F, 0x00 },   /* U+0046 (F) */
+    { 0x3C, 0x66, 0x03, 0x03, 0x73, 0x66, 0x7C, 0x00 },   /* U+0047 (G) */
+    { 0x33, 0x33, 0x33, 0x3F, 0x33, 0x33, 0x33, 0x00 },   /* U+0048 (H) */
+    { 0x1E, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0x1E, 0x00 },   /* U+0049 (I) */
+    { 0x78, 0x30, 0x30, 0x30, 0x33, 0x33, 0x1E, 0x00 },   /* U+004A (J) */
+    { 0x67, 0x66, 0x36, 0x1E, 0x36, 0x66, 0x67, 0x00 },   /* U+004B (K) */
+    { 0x0F, 0x06, 0x06, 0x06, 0x46, 0x66, 0x7F, 0x00 },   /* U+004C (L) */
+    { 0x63, 0x77, 0x7F, 0x7F, 0x6B, 0x63, 0x63, 0x00 },   /* U+004D (M) */
+    { 0x63, 0x67, 0x6F, 0x7B, 0x73, 0x63, 0x63, 0x00 },   /* U+004E (N) */
+    { 0x1C, 0x36, 0x63, 0x63, 0x63, 0x36, 0x1C, 0x00 },   /* U+004F (O) */
+    { 0x3F, 0x66, 0x66, 0x3E, 0x06, 0x06, 0x0F, 0x00 },   /* U+0050 (P) */
+    { 0x1E, 0x33, 0x33, 0x33, 0x3B, 0x1E, 0x38, 0x00 },   /* U+0051 (Q) */
+    { 0x3F, 0x66, 0x66, 0x3E, 0x36, 0x66, 0x67, 0x00 },   /* U+0052 (R) */
+    { 0x1E, 0x33, 0x07, 0x0E, 0x38, 0x33, 0x1E, 0x00 },   /* U+0053 (S) */
+    { 0x3F, 0x2D, 0x0C, 0x0C, 0x0C, 0x0C, 0x1E, 0x00 },   /* U+0054 (T) */
+    { 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x3F, 0x00 },   /* U+0055 (U) */
+    { 0x33, 0x33, 0x33, 0x33, 0x33, 0x1E, 0x0C, 0x00 },   /* U+0056 (V) */
+    { 0x63, 0x63, 0x63, 0x6B, 0x7F, 0x77, 0x63, 0x00 },   /* U+0057 (W) */
+    { 0x63, 0x63, 0x36, 0x1C, 0x1C, 0x36, 0x63, 0x00 },   /* U+0058 (X) */
+    { 0x33, 0x33, 0x33, 0x1E, 0x0C, 0x0C, 0x1E, 0x00 },   /* U+0059 (Y) */
+    { 0x7F, 0x63, 0x31, 0x18, 0x4C, 0x66, 0x7F, 0x00 },   /* U+005A (Z) */
+    { 0x1E, 0x06, 0x06, 0x06, 0x06, 0x06, 0x1E, 0x00 },   /* U+005B ([) */
+    { 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0x40, 0x00 },   /* U+005C (\) */
+    { 0x1E, 0x18, 0x18, 0x18, 0x18, 0x18, 0x1E, 0x00 },   /* U+005D (]) */
+    { 0x08, 0x1C, 0x36, 0x63, 0x00, 0x00, 0x00, 0x00 },   /* U+005E (^) */
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF },   /* U+005F (_) */
+    { 0x0C, 0x0C, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00 },   /* U+0060 (`) */
+    { 0x00, 0x00, 0x1E, 0x30, 0x3E, 0x33, 0x6E, 0x00 },   /* U+0061 (a) */
+    { 0x07, 0x06, 0x06, 0x3E, 0x66, 0x66, 0x3B, 0x00 },   /* U+0062 (b) */
+    { 0x00, 0x00, 0x1E, 0x33, 0x03, 0x33, 0x1E, 0x00 },   /* U+0063 (c) */
+    { 0x38, 0x30, 0x30, 0x3E, 0x33, 0x33, 0x6E, 0x00 },   /* U+0064 (d) */
+    { 0x00, 0x00, 0x1E, 0x33, 0x3F, 0x03, 0x1E, 0x00 },   /* U+0065 (e) */
+    { 0x1C, 0x36, 0x06, 0x0F, 0x06, 0x06, 0x0F, 0x00 },   /* U+0066 (f) */
+    { 0x00, 0x00, 0x6E, 0x33, 0x33, 0x3E, 0x30, 0x1F },   /* U+0067 (g) */
+    { 0x07, 0x06, 0x36, 0x6E, 0x66, 0x66, 0x67, 0x00 },   /* U+0068 (h) */
+    { 0x0C, 0x00, 0x0E, 0x0C, 0x0C, 0x0C, 0x1E, 0x00 },   /* U+0069 (i) */
+    { 0x30, 0x00, 0x30, 0x30, 0x30, 0x33, 0x33, 0x1E },   /* U+006A (j) */
+    { 0x07, 0x06, 0x66, 0x36, 0x1E, 0x36, 0x67, 0x00 },   /* U+006B (k) */
+    { 0x0E, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0x1E, 0x00 },   /* U+006C (l) */
+    { 0x00, 0x00, 0x33, 0x7F, 0x7F, 0x6B, 0x63, 0x00 },   /* U+006D (m) */
+    { 0x00, 0x00, 0x1F, 0x33, 0x33, 0x33, 0x33, 0x00 },   /* U+006E (n) */
+    { 0x00, 0x00, 0x1E, 0x33, 0x33, 0x33, 0x1E, 0x00 },   /* U+006F (o) */
+    { 0x00, 0x00, 0x3B, 0x66, 0x66, 0x3E, 0x06, 0x0F },   /* U+0070 (p) */
+    { 0x00, 0x00, 0x6E, 0x33, 0x33, 0x3E, 0x30, 0x78 },   /* U+0071 (q) */
+    { 0x00, 0x00, 0x3B, 0x6E, 0x66, 0x06, 0x0F, 0x00 },   /* U+0072 (r) */
+    { 0x00, 0x00, 0x3E, 0x03, 0x1E, 0x30, 0x1F, 0x00 },   /* U+0073 (s) */
+    { 0x08, 0x0C, 0x3E, 0x0C, 0x0C, 0x2C, 0x18, 0x00 },   /* U+0074 (t) */
+    { 0x00, 0x00, 0x33, 0x33, 0x33, 0x33, 0x6E, 0x00 },   /* U+0075 (u) */
+    { 0x00, 0x00, 0x33, 0x33, 0x33, 0x1E, 0x0C, 0x00 },   /* U+0076 (v) */
+    { 0x00, 0x00, 0x63, 0x6B, 0x7F, 0x7F, 0x36, 0x00 },   /* U+0077 (w) */
+    { 0x00, 0x00, 0x63, 0x36, 0x1C, 0x36, 0x63, 0x00 },   /* U+0078 (x) */
+    { 0x00, 0x00, 0x33, 0x33, 0x33, 0x3E, 0x30, 0x1F },   /* U+0079 (y) */
+    { 0x00, 0x00, 0x3F, 0x19, 0x0C, 0x26, 0x3F, 0x00 },   /* U+007A (z) */
+    { 0x38, 0x0C, 0x0C, 0x07, 0x0C, 0x0C, 0x38, 0x00 },   /* U+007B ({) */
+    { 0x18, 0x18, 0x18, 0x00, 0x18, 0x18, 0x18, 0x00 },   /* U+007C (|) */
+    { 0x07, 0x0C, 0x0C, 0x38, 0x0C, 0x0C, 0x07, 0x00 },   /* U+007D (}) */
+    { 0x6E, 0x3B, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }    /* U+007E (~) */
+};
+
+static const md_uint8 g_mdFont8x8NotDef__software[8] = { 0x7E, 0x42, 0x42, 0x42, 0x42, 0x42, 0x7E, 0x00 };
+
+MD_PRIVATE const md_uint8* md_get_glyph_bitmap__software(md_uint32 glyphIndex)
 {
-    pAPI->procs = pConfig->custom.procs;
-    return MD_SUCCESS;
-}
+    if (glyphIndex == 0 || glyphIndex > MD_COUNTOF(g_mdFont8x8__software)) {
+        return g_mdFont8x8NotDef__software;
+    }
 
+    return g_mdFont8x8__software[glyphIndex - 1];
+}
 
+MD_PRIVATE md_format md_get_native_format__software()
+{
+    /* Pixels are stored as 32-bit 0xAARRGGBB words, the same as CAIRO_FORMAT_ARGB32. The byte order therefore depends on the endianness of the host. */
+    if (md_is_little_endian()) {
+        return md_format_bgra;
+    } else {
+        return md_format_argb;
+    }
+}
 
-/**************************************************************************************************************************************************************
 
-API
+/* Pixel Math */
+static MD_INLINE md_uint32 md_mul255__software(md_uint32 a, md_uint32 b)
+{
+    md_uint32 t = a*b + 128;
+    return (t + (t >> 8)) >> 8;
+}
 
-**************************************************************************************************************************************************************/
-md_result md_init(const md_api_config* pConfig, md_api* pAPI)
+static MD_INLINE md_uint32 md_scale_argb__software(md_uint32 argb, md_uint32 scale)
 {
-    md_result result = MD_ERROR;
+    /* Scales all four channels by scale/255 in two passes of two channels each. */
+    md_uint32 rb = (argb & 0x00FF00FF) * scale + 0x00800080;
+    md_uint32 ag = ((argb >> 8) & 0x00FF00FF) * scale + 0x00800080;
 
-    if (pAPI == NULL) {
-        return MD_INVALID_ARGS;
-    }
+    rb = ((rb + ((rb >> 8) & 0x00FF00FF)) >> 8) & 0x00FF00FF;
+    ag =  (ag + ((ag >> 8) & 0x00FF00FF))       & 0xFF00FF00;
 
-    MD_ZERO_OBJECT(pAPI);
+    return rb | ag;
+}
 
-    if (pConfig == NULL) {
-        return MD_INVALID_ARGS;
+static MD_INLINE md_uint32 md_blend_pixel__software(md_uint32 dst, md_uint32 src, md_uint32 coverage, md_blend_op blendOp)
+{
+    if (blendOp == md_blend_op_src_over) {
+        if (coverage < 255) {
+            src = md_scale_argb__software(src, coverage);
+        }
+
+        return src + md_scale_argb__software(dst, 255 - (src >> 24));
+    } else {
+        if (coverage == 255) {
+            return src;
+        }
+
+        return md_scale_argb__software(src, coverage) + md_scale_argb__software(dst, 255 - coverage);
     }
+}
 
-    pAPI->backend = pConfig->backend;
-    pAPI->pUserData = pConfig->pUserData;
+MD_PRIVATE md_uint32 md_color_to_argb__software(md_color color)
+{
+    /* Converts to premultiplied ARGB. */
+    return ((md_uint32)color.a << 24) | (md_mul255__software(color.r, color.a) << 16) | (md_mul255__software(color.g, color.a) << 8) | (md_mul255__software(color.b, color.a) << 0);
+}
 
-    switch (pConfig->backend)
-    {
-#if defined(MD_HAS_GDI)
-        case md_backend_gdi:
-        {
-            result = md_init__gdi(pConfig, pAPI);
-        } break;
-#endif
-#if defined(MD_HAS_CAIRO)
-        case md_backend_cairo:
-        {
-            result = md_init__cairo(pConfig, pAPI);
-        } break;
-#endif
 
-        case md_backend_custom:
-        {
-            result = md_init__custom(pConfig, pAPI);
-        } break;
+/* Matrix */
+MD_PRIVATE void md_matrix_init_identity__software(md_matrix* pMatrix)
+{
+    pMatrix->m00 = 1;
+    pMatrix->m01 = 0;
+    pMatrix->m10 = 0;
+    pMatrix->m11 = 1;
+    pMatrix->dx  = 0;
+    pMatrix->dy  = 0;
+}
 
-        default:
-        {
-            result = MD_INVALID_ARGS;
-        };
-    }
+MD_PRIVATE void md_matrix_multiply__software(md_matrix* pOut, const md_matrix* pA, const md_matrix* pB)
+{
+    /* The result transforms by B first and then by A. pOut is allowed to point to either of the inputs. */
+    md_matrix m;
 
-    if (result != MD_SUCCESS) {
-        return result;
-    }
+    m.m00 = pA->m00*pB->m00 + pA->m10*pB->m01;
+    m.m01 = pA->m01*pB->m00 + pA->m11*pB->m01;
+    m.m10 = pA->m00*pB->m10 + pA->m10*pB->m11;
+    m.m11 = pA->m01*pB->m10 + pA->m11*pB->m11;
+    m.dx  = pA->m00*pB->dx  + pA->m10*pB->dy + pA->dx;
+    m.dy  = pA->m01*pB->dx  + pA->m11*pB->dy + pA->dy;
 
-    return MD_SUCCESS;
+    *pOut = m;
 }
 
-void md_uninit(md_api* pAPI)
+MD_PRIVATE md_bool32 md_matrix_invert__software(md_matrix* pOut, const md_matrix* pMatrix)
 {
-    if (pAPI == NULL) {
-        return;
+    md_matrix m;
+    float det;
+
+    det = pMatrix->m00*pMatrix->m11 - pMatrix->m10*pMatrix->m01;
+    if (det == 0) {
+        return MD_FALSE;
     }
 
-    pAPI->procs.uninit(pAPI);
+    m.m00 =  pMatrix->m11 / det;
+    m.m01 = -pMatrix->m01 / det;
+    m.m10 = -pMatrix->m10 / det;
+    m.m11 =  pMatrix->m00 / det;
+    m.dx  = -(m.m00*pMatrix->dx + m.m10*pMatrix->dy);
+    m.dy  = -(m.m01*pMatrix->dx + m.m11*pMatrix->dy);
+
+    *pOut = m;
+    return MD_TRUE;
 }
 
-md_result md_itemize_utf8(md_font* pFont, const md_utf8* pTextUTF8, size_t textLength, md_item* pItems, md_uint32* pItemCount, md_itemize_state* pItemizeState)
+static MD_INLINE void md_matrix_transform_point__software(const md_matrix* pMatrix, float x, float y, float* pX, float* pY)
 {
-    md_result result;
-    md_uint32 itemCount;
+    *pX = pMatrix->m00*x + pMatrix->m10*y + pMatrix->dx;
+    *pY = pMatrix->m01*x + pMatrix->m11*y + pMatrix->dy;
+}
 
-    if (pItemCount == NULL) {
-        return MD_INVALID_ARGS;
+MD_PRIVATE float md_matrix_get_scale__software(const md_matrix* pMatrix)
+{
+    /* The geometric mean of the two axis scales. Used for converting user-space distances such as line widths to device space. */
+    float det = pMatrix->m00*pMatrix->m11 - pMatrix->m10*pMatrix->m01;
+    if (det < 0) {
+        det = -det;
     }
 
-    itemCount = *pItemCount;
+    return (float)sqrt(det);
+}
 
-    if (pFont == NULL || pTextUTF8 == NULL || textLength == 0) {
-        return MD_INVALID_ARGS;
-    }
 
-    if (textLength == (size_t)-1) {
-        textLength = strlen(pTextUTF8);
-    }
+/* Polygons */
+MD_PRIVATE void md_polygon_uninit__software(md_polygon_software* pPolygon)
+{
+    MD_ASSERT(pPolygon != NULL);
 
-    /*
-    We could do some generic itemization here such as line breaks and tabs, however it makes things awkward with memory management. I'm therefore
-    leaving this to each of the backends.
-    */
+    MD_FREE(pPolygon->pPoints);
+    MD_FREE(pPolygon->pContourEnds);
+    MD_ZERO_OBJECT(pPolygon);
+}
 
-    /* If the backend directly supports UTF-8, just pass it straight through. Otherwise we need to convert. */
-    if (pFont->pAPI->procs.itemizeUTF8) {
-        /* UTF-8 natively supported. */
-        result = pFont->pAPI->procs.itemizeUTF8(pFont, pTextUTF8, textLength, pItems, &itemCount, pItemizeState);
-    } else {
-        /* UTF-8 not natively supported. Need to convert the string to another format. */
-        if (pFont->pAPI->procs.itemizeUTF16) {
-            /*
-            Convert the input string to UTF-16, itemize, then convert offsets back to UTF-8 equivalents. To make things more efficient for small
-            strings we can try converting to a stack-allocated buffer first. If this is too small we will fall back to the heap which will be
-            slightly less efficient.
-            */
-            size_t utf16Len;
-            md_utf16  pUTF16Stack[4096];
-            md_utf16* pUTF16Heap = NULL;
-            md_utf16* pUTF16 = NULL;    /* Will be set to either pUTF16Stack or pUTF16Heap. */
-
-            result = md_utf8_to_utf16ne(pUTF16Stack, MD_COUNTOF(pUTF16Stack), &utf16Len, pTextUTF8, textLength, NULL, MD_ERROR_ON_INVALID_CODE_POINT);
-            if (result == MD_SUCCESS) {
-                pUTF16 = &pUTF16Stack[0];
-            } else {
-                /* Fall back to the heap. */
-                result = md_utf8_to_utf16ne_length(&utf16Len, pTextUTF8, textLength, 0);
-                if (result == MD_SUCCESS) {
-                    pUTF16Heap = (md_utf16*)MD_MALLOC(sizeof(*pUTF16Heap) * (utf16Len+1));
-                    if (pUTF16Heap != NULL) {
-                        result = md_utf8_to_utf16ne(pUTF16Heap, utf16Len+1, &utf16Len, pTextUTF8, textLength, NULL, MD_ERROR_ON_INVALID_CODE_POINT);
-                        if (result == MD_SUCCESS) {
-                            pUTF16 = pUTF16Heap;
-                        }
-                    } else {
-                        result = MD_OUT_OF_MEMORY;
-                    }
-                }
+MD_PRIVATE void md_polygon_reset__software(md_polygon_software* pPolygon)
+{
+    MD_ASSERT(pPolygon != NULL);
 
-                if (result != MD_SUCCESS) {
-                    return result;  /* An error occurred when converting to UTF-16. */
-                }
-            }
+    pPolygon->pointCount   = 0;
+    pPolygon->contourCount = 0;
+}
 
-            /* We have the UTF-16 string, so now we need to itemize these. */
-            result = pFont->pAPI->procs.itemizeUTF16(pFont, pUTF16, utf16Len, pItems, &itemCount, pItemizeState);
-            if (result == MD_SUCCESS) {
-                /* We have the items, so now we need to convert the offsets and lengths to the UTF-8 equivalents. */
-                if (pItems != NULL) {
-                    size_t runningOffset = 0;
-                    md_uint32 iItem;
-                    for (iItem = 0; iItem < itemCount; ++iItem) {
-                        size_t itemLengthUTF8;
-                        result = md_utf16ne_to_utf8_length(&itemLengthUTF8, pUTF16 + pItems[iItem].offset, pItems[iItem].length, 0);
-                        if (result != MD_SUCCESS) {
-                            break;  /* Conversion error. */
-                        }
+MD_PRIVATE md_result md_polygon_add_point__software(md_polygon_software* pPolygon, float x, float y)
+{
+    MD_ASSERT(pPolygon != NULL);
 
-                        pItems[iItem].offset = runningOffset;
-                        pItems[iItem].length = itemLengthUTF8;
-                        runningOffset += itemLengthUTF8;
-                    }
-                }
-            }
-            
-            /* Done. */
-            MD_FREE(pUTF16Heap);
-        } else if (pFont->pAPI->procs.itemizeUTF32) {
-            /* TODO: Convert the input string to UTF-32, itemize, then convert offsets back to UTF-8 equivalents. */
-            return MD_INVALID_OPERATION;
-        } else {
-            return MD_INVALID_OPERATION;    /* Itemization not supported by the backend. */
+    if (pPolygon->pointCount == pPolygon->pointCap) {
+        md_uint32 newCap = MD_MAX(64, pPolygon->pointCap * 2);
+        float* pNewPoints = (float*)MD_REALLOC(pPolygon->pPoints, newCap * sizeof(float) * 2);
+        if (pNewPoints == NULL) {
+            return MD_OUT_OF_MEMORY;
         }
-    }
 
-    *pItemCount = itemCount;
-
-    /* Make sure the API object is always set in the itemize state. */
-    if (pItemizeState) {
-        pItemizeState->pAPI = pFont->pAPI;
+        pPolygon->pPoints  = pNewPoints;
+        pPolygon->pointCap = newCap;
     }
 
-    return result;
+    pPolygon->pPoints[pPolygon->pointCount*2 + 0] = x;
+    pPolygon->pPoints[pPolygon->pointCount*2 + 1] = y;
+    pPolygon->pointCount += 1;
+
+    return MD_SUCCESS;
 }
 
-void md_free_itemize_state(md_itemize_state* pItemizeState)
+MD_PRIVATE md_uint32 md_polygon_get_contour_beg__software(const md_polygon_software* pPolygon, md_uint32 iContour)
 {
-    if (pItemizeState == NULL) {
-        return;
+    if (iContour == 0) {
+        return 0;
     }
 
-    if (pItemizeState->pAPI->procs.freeItemizeState) {
-        pItemizeState->pAPI->procs.freeItemizeState(pItemizeState);
-    }
+    return pPolygon->pContourEnds[iContour-1] & ~MD_SOFTWARE_CONTOUR_CLOSED;
 }
 
-md_result md_shape_utf8(md_font* pFont, md_item* pItem, const md_utf8* pTextUTF8, size_t textLength, md_glyph* pGlyphs, size_t* pGlyphCount, size_t* pClusters, md_text_metrics* pRunMetrics)
+MD_PRIVATE md_uint32 md_polygon_get_contour_end__software(const md_polygon_software* pPolygon, md_uint32 iContour)
 {
-    md_result result;
+    return pPolygon->pContourEnds[iContour] & ~MD_SOFTWARE_CONTOUR_CLOSED;
+}
 
-    if (pFont == NULL || pItem == NULL || pTextUTF8 == NULL) {
-        return MD_INVALID_ARGS;
-    }
+MD_PRIVATE md_result md_polygon_end_contour__software(md_polygon_software* pPolygon, md_bool32 isClosed)
+{
+    MD_ASSERT(pPolygon != NULL);
 
-    /* If we have a glyph array, we must have a glyph count. */
-    if (pGlyphs != NULL) {
-        if (pGlyphCount == NULL) {
-            return MD_INVALID_ARGS;
+    /* Empty contours are dropped. */
+    if (pPolygon->contourCount > 0) {
+        if (md_polygon_get_contour_end__software(pPolygon, pPolygon->contourCount-1) == pPolygon->pointCount) {
+            return MD_SUCCESS;
         }
-    }
-
-    /* If the backend directly supports UTF-8, just pass it straight through. Otherwise we need to convert. */
-    if (pFont->pAPI->procs.shapeUTF8) {
-        result = pFont->pAPI->procs.shapeUTF8(pFont, pItem, pTextUTF8, textLength, pGlyphs, pGlyphCount, pClusters, pRunMetrics);
     } else {
-        if (pFont->pAPI->procs.shapeUTF16) {
-            /* Convert to UTF-16. We can try using the stack first, and then fall back to a heap-allocation if necessary. */
-            size_t    utf16Len;
-            void*     pHeap = NULL;
-            md_utf16  pUTF16Stack[4096];
-            md_utf16* pUTF16Heap = NULL;
-            md_utf16* pUTF16 = NULL;    /* Will be set to either pUTF16Stack or pUTF16Heap. */
-            size_t    pUTF16ClustersStack[4096];
-            size_t*   pUTF16ClustersHeap = NULL;
-            size_t*   pUTF16Clusters = NULL;
-
-            result = md_utf8_to_utf16ne(pUTF16Stack, MD_COUNTOF(pUTF16Stack), &utf16Len, pTextUTF8, textLength, NULL, MD_ERROR_ON_INVALID_CODE_POINT);
-            if (result == MD_SUCCESS) {
-                pUTF16         = &pUTF16Stack[0];
-                pUTF16Clusters = &pUTF16ClustersStack[0];
-            } else {
-                /* Fall back to the heap. */
-                result = md_utf8_to_utf16ne_length(&utf16Len, pTextUTF8, textLength, 0);
-                if (result == MD_SUCCESS) {
-                    pHeap = MD_MALLOC((sizeof(*pUTF16Heap)+sizeof(*pUTF16ClustersHeap)) * (utf16Len+1));
-                    if (pHeap != NULL) {
-                        pUTF16Heap         = (md_utf16*)pHeap;
-                        pUTF16ClustersHeap = (size_t*)MD_OFFSET_PTR(pHeap, sizeof(*pUTF16Heap) * (utf16Len+1));
-
-                        result = md_utf8_to_utf16ne(pUTF16Heap, utf16Len+1, &utf16Len, pTextUTF8, textLength, NULL, MD_ERROR_ON_INVALID_CODE_POINT);
-                        if (result == MD_SUCCESS) {
-                            pUTF16         = pUTF16Heap;
-                            pUTF16Clusters = pUTF16ClustersHeap;
-                        } else {
-                            MD_FREE(pHeap);
-                            pHeap = NULL;   /* Safety. */
-                        }
-                    } else {
-                        result = MD_OUT_OF_MEMORY;
-                    }
-                }
-
-                if (result != MD_SUCCESS) {
-                    return result;  /* An error occurred when converting to UTF-16. */
-                }
-            }
-
-            MD_ASSERT(utf16Len <= textLength);
-
-            /* We have the UTF-16 string, so now we perform shaping. */
-            result = pFont->pAPI->procs.shapeUTF16(pFont, pItem, pUTF16, utf16Len, pGlyphs, pGlyphCount, pUTF16Clusters, pRunMetrics);
-            if (result == MD_SUCCESS) {
-                /* The values in pClusters need to be expanded so that they map to the original UTF-8 string. */
-                if (pClusters != NULL) {
-                    md_utf32 utf32;
-                    size_t utf16Count;
-                    size_t utf8Count;
-                    size_t iClusterUTF8;
-                    size_t iUTF8 = 0;
-                    size_t iUTF16;
-                    for (iUTF16 = 0; iUTF16 < utf16Len; /* Do nothing */) {
-                        /* First check if the UTF-16 code unit indicates a surrogate pair. If so, we need to consume the next UTF-16 code unit before we can determine the length. */
-                        if (pUTF16[iUTF16] < 0xD800 || pUTF16[iUTF16] > 0xDFFF) {
-                            /* 1 UTF-16 code unit. */
-                            utf32 = pUTF16[iUTF16];
-                            utf16Count = 1;
-                        } else {
-                            /* 2 UTF-16 code units. Errors will have been handled in the conversion step above, so no need to handle that here. */
-                            utf32 = md_utf16_pair_to_utf32_cp(pUTF16 + iUTF16);
-                            utf16Count = 2;
-                        }
-
-                        utf8Count = md_utf32_cp_to_utf8_length(utf32);
-                        for (iClusterUTF8 = 0; iClusterUTF8 < utf8Count; ++iClusterUTF8) {
-                            pClusters[iUTF8] = pUTF16Clusters[iUTF16];
-                            iUTF8 += 1;
-                        }
-
-                        iUTF16 += utf16Count;
-                    }
-                }
-            }
-
-            MD_FREE(pHeap);
-        } else if (pFont->pAPI->procs.shapeUTF32) {
-            /* TODO: Implement me. */
-            return MD_INVALID_OPERATION;
-        } else {
-            return MD_INVALID_OPERATION;    /* Shaping not supported by the backend. */
+        if (pPolygon->pointCount == 0) {
+            return MD_SUCCESS;
         }
     }
 
-    return result;
-}
-
-md_result md_measure_x(md_api* pAPI, const md_item* pItem, const md_glyph* pGlyphs, size_t glyphCount, md_int32* pX)
-{
-    size_t iGlyph;
-    md_int32 runningX;
-
-    if (pAPI == NULL || pItem == NULL || pGlyphs == NULL) {
-        return MD_SUCCESS;
-    }
+    if (pPolygon->contourCount == pPolygon->contourCap) {
+        md_uint32 newCap = MD_MAX(16, pPolygon->contourCap * 2);
+        md_uint32* pNewContourEnds = (md_uint32*)MD_REALLOC(pPolygon->pContourEnds, newCap * sizeof(*pNewContourEnds));
+        if (pNewContourEnds == NULL) {
+            return MD_OUT_OF_MEMORY;
+        }
 
-    runningX = 0;
-    for (iGlyph = 0; iGlyph < glyphCount; ++iGlyph) {
-        runningX += pGlyphs[iGlyph].advance;
+        pPolygon->pContourEnds = pNewContourEnds;
+        pPolygon->contourCap   = newCap;
     }
 
-    if (pX != NULL) {
-        *pX = runningX;
-    }
+    pPolygon->pContourEnds[pPolygon->contourCount] = pPolygon->pointCount | ((isClosed) ? MD_SOFTWARE_CONTOUR_CLOSED : 0);
+    pPolygon->contourCount += 1;
 
     return MD_SUCCESS;
 }
 
-md_result md_x_to_index(md_api* pAPI, const md_item* pItem, md_int32 x, size_t textLength, const size_t* pClusters, const md_glyph* pGlyphs, size_t glyphCount, size_t* pIndex, md_int32* pOffsetToEdge)
+MD_PRIVATE md_result md_polygon_add_rectangle__software(md_polygon_software* pPolygon, const md_matrix* pMatrix, float left, float top, float right, float bottom)
 {
-    /* Naive implementation for now while I figure things out. */
-
-    size_t iGlyph;
-    size_t iCluster;
-    md_int32 runningX;
-
-    if (pIndex != NULL) {
-        *pIndex = (size_t)0;
-    }
-    if (pOffsetToEdge != NULL) {
-        *pOffsetToEdge = 0;
-    }
-
-    /* If x is negative we need to clamp it to edge of the run. */
-    if (x < 0) {
-        return MD_SUCCESS;
-    }
+    md_result result;
+    float x;
+    float y;
 
-    if (pAPI == NULL || pItem == NULL || pClusters == NULL || pGlyphs == NULL) {
-        return MD_INVALID_ARGS;
+    md_matrix_transform_point__software(pMatrix, left,  top,    &x, &y); result  = md_polygon_add_point__software(pPolygon, x, y);
+    md_matrix_transform_point__software(pMatrix, right, top,    &x, &y); result |= md_polygon_add_point__software(pPolygon, x, y);
+    md_matrix_transform_point__software(pMatrix, right, bottom, &x, &y); result |= md_polygon_add_point__software(pPolygon, x, y);
+    md_matrix_transform_point__software(pMatrix, left,  bottom, &x, &y); result |= md_polygon_add_point__software(pPolygon, x, y);
+    if (result != MD_SUCCESS) {
+        return MD_OUT_OF_MEMORY;
     }
 
-    runningX = 0;
-    for (iGlyph = 0; iGlyph < glyphCount; iGlyph += 1) {
-        md_int32 nextRunningX = runningX + pGlyphs[iGlyph].advance;
-        if (x >= runningX && x < nextRunningX) {
-            /* It's somewhere on this glyph. */
-            md_bool32 found = MD_FALSE;
-            for (iCluster = 0; iCluster < textLength; iCluster += 1) {
-                if (pClusters[iCluster] == iGlyph) {
-                    if (pIndex != NULL) {
-                        *pIndex = iCluster;
-                    }
-                        
-                    found = MD_TRUE;
-                }
-            }
-
-            if (!found) {
-                return MD_INVALID_ARGS; /* Couldn't find the cluster for this glyph. */
-            }
+    return md_polygon_end_contour__software(pPolygon, MD_TRUE);
+}
 
-            if (pOffsetToEdge != NULL) {
-                *pOffsetToEdge = runningX - x;
-            }
 
-            return MD_SUCCESS;
-        }
+/* Paths */
+MD_PRIVATE void md_path_uninit__software(md_path_software* pPath)
+{
+    MD_ASSERT(pPath != NULL);
 
-        runningX = nextRunningX;
-    }
+    MD_FREE(pPath->pCommands);
+    MD_FREE(pPath->pPoints);
+    md_polygon_uninit__software(&pPath->flattened);
+    MD_ZERO_OBJECT(pPath);
+}
 
-    /* Geting here means the point is beyond the string. We just place it at the end. */
-    if (pIndex != NULL) {
-        *pIndex = textLength;
-    }
-    if (pOffsetToEdge != NULL) {
-        *pOffsetToEdge = 0;
-    }
+MD_PRIVATE void md_path_reset__software(md_path_software* pPath)
+{
+    MD_ASSERT(pPath != NULL);
 
-    return MD_SUCCESS;
+    pPath->commandCount     = 0;
+    pPath->pointCount       = 0;
+    pPath->hasCurrentPoint  = MD_FALSE;
+    pPath->isFlattenedValid = MD_FALSE;
 }
 
-md_result md_index_to_x(md_api* pAPI, const md_item* pItem, size_t index, size_t textLength, const size_t* pClusters, const md_glyph* pGlyphs, size_t glyphCount, md_int32* pX)
+MD_PRIVATE md_result md_path_push__software(md_path_software* pPath, md_uint8 command, const float* pPoints, md_uint32 pointCount)
 {
-    /* Naive implementation for now while I figure things out. */
+    MD_ASSERT(pPath != NULL);
 
-    size_t iGlyph;
-    md_int32 runningX;
+    if (pPath->commandCount == pPath->commandCap) {
+        md_uint32 newCap = MD_MAX(32, pPath->commandCap * 2);
+        md_uint8* pNewCommands = (md_uint8*)MD_REALLOC(pPath->pCommands, newCap * sizeof(*pNewCommands));
+        if (pNewCommands == NULL) {
+            return MD_OUT_OF_MEMORY;
+        }
 
-    if (pX != NULL) {
-        *pX = 0;
+        pPath->pCommands  = pNewCommands;
+        pPath->commandCap = newCap;
     }
 
-    if (pAPI == NULL || pClusters == NULL || pGlyphs == NULL) {
-        return MD_INVALID_ARGS;
-    }
+    if (pPath->pointCount + pointCount > pPath->pointCap) {
+        md_uint32 newCap = MD_MAX(64, MD_MAX(pPath->pointCap * 2, pPath->pointCount + pointCount));
+        float* pNewPoints = (float*)MD_REALLOC(pPath->pPoints, newCap * sizeof(float) * 2);
+        if (pNewPoints == NULL) {
+            return MD_OUT_OF_MEMORY;
+        }
 
-    if (glyphCount == 0) {
-        return MD_SUCCESS;
+        pPath->pPoints  = pNewPoints;
+        pPath->pointCap = newCap;
     }
 
-    /* Normalize the index if it's out of range. */
-    if (index > textLength) {
-        index = textLength;
-    }
+    pPath->pCommands[pPath->commandCount] = command;
+    pPath->commandCount += 1;
+    pPath->isFlattenedValid = MD_FALSE;
 
-    /* Special case when the code unit is beyond the length of the text. In this case we set pX to end of the run. */
-    runningX = 0;
-    if (index < textLength) {
-        size_t iTargetGlyph = pClusters[index];
-        if (iTargetGlyph > 0) {
-            for (iGlyph = 0; iGlyph < iTargetGlyph; iGlyph += 1) {
-                runningX += pGlyphs[iGlyph].advance;
-            }
-        }
+    if (pointCount > 0) {
+        MD_COPY_MEMORY(pPath->pPoints + pPath->pointCount*2, pPoints, pointCount * sizeof(float) * 2);
+        pPath->pointCount += pointCount;
 
-        if (pX != NULL) {
-            *pX = runningX;
-        }
-    } else {
-        /* Go to the end. */
-        MD_ASSERT(index == textLength);
-        return md_measure_x(pAPI, pItem, pGlyphs, glyphCount, pX);
+        pPath->currentX = pPoints[pointCount*2 - 2];
+        pPath->currentY = pPoints[pointCount*2 - 1];
+        pPath->hasCurrentPoint = MD_TRUE;
     }
 
     return MD_SUCCESS;
 }
 
-
-/**************************************************************************************************************************************************************
-
-Fonts
-
-**************************************************************************************************************************************************************/
-md_result md_font_init(md_api* pAPI, const md_font_config* pConfig, md_font* pFont)
+/*
+Points are transformed into device space as they are added to the path, just like Cairo. Changing the matrix part way through building a path does not
+affect any segments that have already been added.
+*/
+MD_PRIVATE void md_path_move_to__software(md_path_software* pPath, const md_matrix* pMatrix, float x, float y)
 {
-    md_result result;
+    float pt[2];
 
-    if (pFont == NULL) {
-        return MD_INVALID_ARGS;
+    md_matrix_transform_point__software(pMatrix, x, y, &pt[0], &pt[1]);
+    if (md_path_push__software(pPath, MD_SOFTWARE_PATH_MOVE_TO, pt, 1) == MD_SUCCESS) {
+        pPath->startX = pt[0];
+        pPath->startY = pt[1];
     }
+}
 
-    MD_ZERO_OBJECT(pFont);
+MD_PRIVATE void md_path_line_to__software(md_path_software* pPath, const md_matrix* pMatrix, float x, float y)
+{
+    float pt[2];
 
-    if (pAPI == NULL || pConfig == NULL) {
-        return MD_INVALID_ARGS;
+    if (!pPath->hasCurrentPoint) {
+        md_path_move_to__software(pPath, pMatrix, x, y);
+        return;
     }
 
-    pFont->pAPI = pAPI;
-    pFont->pUserData = pConfig->pUserData;
+    md_matrix_transform_point__software(pMatrix, x, y, &pt[0], &pt[1]);
+    md_path_push__software(pPath, MD_SOFTWARE_PATH_LINE_TO, pt, 1);
+}
 
-    result = pAPI->procs.fontInit(pAPI, pConfig, pFont);
-    if (result != MD_SUCCESS) {
-        return result;
+MD_PRIVATE void md_path_curve_to__software(md_path_software* pPath, const md_matrix* pMatrix, float x1, float y1, float x2, float y2, float x3, float y3)
+{
+    float pt[6];
+
+    if (!pPath->hasCurrentPoint) {
+        md_path_move_to__software(pPath, pMatrix, x1, y1);
     }
 
-    return MD_SUCCESS;
+    /* An affine transform of the control points is the same as transforming the curve itself. */
+    md_matrix_transform_point__software(pMatrix, x1, y1, &pt[0], &pt[1]);
+    md_matrix_transform_point__software(pMatrix, x2, y2, &pt[2], &pt[3]);
+    md_matrix_transform_point__software(pMatrix, x3, y3, &pt[4], &pt[5]);
+    md_path_push__software(pPath, MD_SOFTWARE_PATH_CURVE_TO, pt, 3);
 }
 
-void md_font_uninit(md_font* pFont)
+MD_PRIVATE void md_path_close__software(md_path_software* pPath)
 {
-    if (pFont == NULL) {
+    if (!pPath->hasCurrentPoint) {
         return;
     }
 
-    if (pFont->pAPI->procs.fontUninit) {
-        pFont->pAPI->procs.fontUninit(pFont);
+    if (md_path_push__software(pPath, MD_SOFTWARE_PATH_CLOSE, NULL, 0) == MD_SUCCESS) {
+        pPath->currentX = pPath->startX;
+        pPath->currentY = pPath->startY;
     }
-    
-    MD_ZERO_OBJECT(pFont);  /* Safety. */
 }
 
-md_result md_font_get_glyph_metrics(md_font* pFont, const md_glyph* pGlyphs, size_t glyphCount, md_glyph_metrics* pGlyphMetrics)
+MD_PRIVATE void md_path_arc__software(md_path_software* pPath, const md_matrix* pMatrix, float x, float y, float radius, float angle1, float angle2)
 {
-    if (pGlyphMetrics == NULL) {
-        return MD_INVALID_ARGS;
-    }
+    double a1 = angle1;
+    double a2 = angle2;
+    double r  = radius;
+    md_uint32 segmentCount;
+    md_uint32 iSegment;
+    double segmentAngle;
+    double h;
 
-    MD_ZERO_MEMORY(pGlyphMetrics, sizeof(*pGlyphMetrics) * glyphCount);
+    /* Same conventions as cairo_arc(). The arc goes in the direction of increasing angles and is connected to the current point with a straight line. */
+    while (a2 < a1) {
+        a2 += MD_SOFTWARE_PI * 2;
+    }
 
-    if (pFont == NULL || pGlyphs == NULL) {
-        return MD_INVALID_ARGS;
+    if (pPath->hasCurrentPoint) {
+        md_path_line_to__software(pPath, pMatrix, (float)(x + r*cos(a1)), (float)(y + r*sin(a1)));
+    } else {
+        md_path_move_to__software(pPath, pMatrix, (float)(x + r*cos(a1)), (float)(y + r*sin(a1)));
     }
 
-    if (pFont->pAPI->procs.fontGetGlyphMetrics == NULL) {
-        return MD_INVALID_OPERATION;
+    if (a2 == a1 || radius <= 0) {
+        return;
     }
 
-    return pFont->pAPI->procs.fontGetGlyphMetrics(pFont, pGlyphs, glyphCount, pGlyphMetrics);
+    /* Each quarter circle (or less) becomes a cubic Bzier curve. */
+    segmentCount = (md_uint32)ceil((a2 - a1) / (MD_SOFTWARE_PI / 2));
+    segmentAngle = (a2 - a1) / segmentCount;
+    h = 4.0/3.0 * tan(segmentAngle / 4);
+
+    for (iSegment = 0; iSegment < segmentCount; ++iSegment) {
+        double t0 = a1 + segmentAngle*iSegment;
+        double t1 = t0 + segmentAngle;
+        double c0 = cos(t0);
+        double s0 = sin(t0);
+        double c1 = cos(t1);
+        double s1 = sin(t1);
+
+        md_path_curve_to__software(pPath, pMatrix,
+            (float)(x + r*(c0 - h*s0)), (float)(y + r*(s0 + h*c0)),
+            (float)(x + r*(c1 + h*s1)), (float)(y + r*(s1 - h*c1)),
+            (float)(x + r*c1),          (float)(y + r*s1));
+    }
 }
 
-md_result md_font_get_glyph_metrics_by_index(md_font* pFont, const md_uint32* pGlyphIndices, size_t glyphCount, md_glyph_metrics* pGlyphMetrics)
+/*
+The number of segments is chosen with Wang's formula which gives the smallest uniform subdivision that keeps every segment within the tolerance of the
+curve. The control points are already in device space, so the tolerance is in pixels no matter what the matrix was when the curve was added. Small
+curves collapse down to a handful of segments and heavily zoomed curves get as many as they need.
+*/
+MD_PRIVATE md_uint32 md_get_curve_segment_count__software(float x0, float y0, const float* pControlPoints)
 {
-    if (pGlyphMetrics == NULL) {
-        return MD_INVALID_ARGS;
-    }
+    float ddx0 = x0                - 2*pControlPoints[0] + pControlPoints[2];
+    float ddy0 = y0                - 2*pControlPoints[1] + pControlPoints[3];
+    float ddx1 = pControlPoints[0] - 2*pControlPoints[2] + pControlPoints[4];
+    float ddy1 = pControlPoints[1] - 2*pControlPoints[3] + pControlPoints[5];
+    double dd;
+    double segmentCount;
 
-    MD_ZERO_MEMORY(pGlyphMetrics, sizeof(*pGlyphMetrics) * glyphCount);
+    dd = MD_MAX(ddx0*ddx0 + ddy0*ddy0, ddx1*ddx1 + ddy1*ddy1);
+    segmentCount = ceil(sqrt(0.75 * sqrt(dd) / MD_SOFTWARE_FLATTEN_TOLERANCE));
 
-    if (pFont == NULL || pGlyphIndices == NULL) {
-        return MD_INVALID_ARGS;
+    if (segmentCount < 1) {
+        return 1;
     }
-
-    if (pFont->pAPI->procs.fontGetGlyphMetricsByIndex == NULL) {
-        return MD_INVALID_OPERATION;
+    if (segmentCount > MD_SOFTWARE_MAX_CURVE_SEGMENTS) {
+        return MD_SOFTWARE_MAX_CURVE_SEGMENTS;
     }
 
-    return pFont->pAPI->procs.fontGetGlyphMetricsByIndex(pFont, pGlyphIndices, glyphCount, pGlyphMetrics);
+    return (md_uint32)segmentCount;
 }
 
-md_result md_font_get_text_metrics_utf8(md_font* pFont, const md_utf8* pTextUTF8, size_t textLength, md_text_metrics* pTextMetrics)
+MD_PRIVATE md_result md_path_flatten_curve__software(md_polygon_software* pPolygon, float x0, float y0, const float* pControlPoints)
 {
-    md_int32 lineHeight;
-    md_int32 lineWidth;
+    md_uint32 segmentCount;
+    md_uint32 iSegment;
 
-    if (pTextMetrics == NULL) {
-        return MD_INVALID_ARGS;
-    }
+    segmentCount = md_get_curve_segment_count__software(x0, y0, pControlPoints);
 
-    MD_ZERO_OBJECT(pTextMetrics);
+    for (iSegment = 1; iSegment <= segmentCount; ++iSegment) {
+        float t  = (float)iSegment / segmentCount;
+        float u  = 1 - t;
+        float w0 = u*u*u;
+        float w1 = 3*u*u*t;
+        float w2 = 3*u*t*t;
+        float w3 = t*t*t;
+        md_result result;
 
-    if (pFont == NULL || pTextUTF8 == NULL) {
-        return MD_INVALID_ARGS;
+        result = md_polygon_add_point__software(pPolygon,
+            w0*x0 + w1*pControlPoints[0] + w2*pControlPoints[2] + w3*pControlPoints[4],
+            w0*y0 + w1*pControlPoints[1] + w2*pControlPoints[3] + w3*pControlPoints[5]);
+        if (result != MD_SUCCESS) {
+            return result;
+        }
     }
 
-    lineHeight = (pFont->metrics.ascent - pFont->metrics.descent);
+    return MD_SUCCESS;
+}
 
-    if (textLength == 0) {
-        pTextMetrics->sizeY = lineHeight;
-        return MD_SUCCESS;  /* Nothing to do. */
+/*
+Converts the path to a list of contours made up of straight line segments. The output is stored in pPath->flattened which is used for both filling and
+stroking. Every move_to begins a new contour. A close_path ends the current contour and marks it as closed. This does nothing if the path has not been
+changed since the last time it was flattened.
+*/
+MD_PRIVATE md_result md_path_flatten__software(md_path_software* pPath)
+{
+    md_result result = MD_SUCCESS;
+    md_polygon_software* pPolygon;
+    md_uint32 iCommand;
+    md_uint32 iPoint = 0;
+    md_bool32 isContourOpen = MD_FALSE;
+    float startX = 0;
+    float startY = 0;
+
+    MD_ASSERT(pPath != NULL);
+
+    if (pPath->isFlattenedValid) {
+        return MD_SUCCESS;
     }
 
-    /* TODO: Add support for backend-optimized implementations. */
-#if 0
-    if (pFont->pAPI->procs.fontGetTextMetricsUTF8) {
-        return pFont->pAPI->procs.fontGetTextMetricsUTF8(pFont, pTextUTF8, textLength, pTextMetrics);
-    } else
-#endif
-    {
-        /* Generic implementation. */
-        md_result result;
-        md_int32  sizeX = 0;
-        md_int32  sizeY = lineHeight;
-        md_itemize_state itemizeState;
-        md_item   pItemsStack[1024];
-        md_item*  pItemsHeap = NULL;
-        md_item*  pItems = NULL;
-        md_uint32 itemCount;
-        md_uint32 iItem;
+    pPolygon = &pPath->flattened;
+    md_polygon_reset__software(pPolygon);
 
-        /* The first step is to itemize. */
-        itemCount = MD_COUNTOF(pItemsStack);
-        result = md_itemize_utf8(pFont, pTextUTF8, textLength, pItemsStack, &itemCount, &itemizeState);
-        if (result == MD_SUCCESS) {
-            pItems = &pItemsStack[0];
-        } else if (result == MD_NO_SPACE) {
-            /* Not enough room on the stack. Try again against the heap. */
-            pItemsHeap = (md_item*)MD_MALLOC(sizeof(*pItemsHeap) * itemCount);
-            if (pItemsHeap == NULL) {
-                return MD_OUT_OF_MEMORY;
-            }
+    for (iCommand = 0; iCommand < pPath->commandCount && result == MD_SUCCESS; ++iCommand) {
+        const float* pPoints = pPath->pPoints + iPoint*2;
 
-            result = md_itemize_utf8(pFont, pTextUTF8, textLength, pItemsHeap, &itemCount, &itemizeState);
-            if (result != MD_SUCCESS) {
-                return result;
-            }
+        switch (pPath->pCommands[iCommand])
+        {
+            case MD_SOFTWARE_PATH_MOVE_TO:
+            {
+                result = md_polygon_end_contour__software(pPolygon, MD_FALSE);
+                if (result == MD_SUCCESS) {
+                    result = md_polygon_add_point__software(pPolygon, pPoints[0], pPoints[1]);
+                }
 
-            pItems = pItemsHeap;
-        } else {
-            return result;
-        }
+                startX = pPoints[0];
+                startY = pPoints[1];
+                isContourOpen = MD_TRUE;
+                iPoint += 1;
+            } break;
 
-        /* We have the items so now we can measure them. */
-        lineWidth = 0;
-        for (iItem = 0; iItem < itemCount; ++iItem) {
-            /* No need to do shaping for new-lines. */
-            if (md_is_newline_utf8(pTextUTF8 + pItems[iItem].offset, pItems[iItem].length)) {
-                sizeY += lineHeight;
-                if (sizeX < lineWidth) {
-                    sizeX = lineWidth;
+            case MD_SOFTWARE_PATH_LINE_TO:
+            {
+                if (!isContourOpen) {
+                    result = md_polygon_add_point__software(pPolygon, startX, startY);   /* Continuing on from a closed contour. */
+                    isContourOpen = MD_TRUE;
                 }
-                lineWidth = 0;
-            } else {
-                md_text_metrics itemMetrics;
-                result = md_shape_utf8(pFont, &pItems[iItem], pTextUTF8 + pItems[iItem].offset, pItems[iItem].length, NULL, NULL, NULL, &itemMetrics);
-                if (result != MD_SUCCESS) {
-                    MD_FREE(pItemsHeap);
-                    pItemsHeap = NULL;
-                    md_free_itemize_state(&itemizeState);
-                    return result;
+
+                if (result == MD_SUCCESS) {
+                    result = md_polygon_add_point__software(pPolygon, pPoints[0], pPoints[1]);
                 }
 
-                lineWidth += itemMetrics.sizeX;
-            }
-        }
+                iPoint += 1;
+            } break;
 
-        /* Don't forget to check the last line. */
-        if (sizeX < lineWidth) {
-            sizeX = lineWidth;
-        }
+            case MD_SOFTWARE_PATH_CURVE_TO:
+            {
+                if (!isContourOpen) {
+                    result = md_polygon_add_point__software(pPolygon, startX, startY);
+                    isContourOpen = MD_TRUE;
+                }
 
-        pTextMetrics->sizeX = sizeX;
-        pTextMetrics->sizeY = sizeY;
+                if (result == MD_SUCCESS) {
+                    result = md_path_flatten_curve__software(pPolygon, pPolygon->pPoints[pPolygon->pointCount*2 - 2], pPolygon->pPoints[pPolygon->pointCount*2 - 1], pPoints);
+                }
 
-        md_free_itemize_state(&itemizeState);
-        return MD_SUCCESS;
+                iPoint += 3;
+            } break;
+
+            case MD_SOFTWARE_PATH_CLOSE:
+            {
+                if (isContourOpen) {
+                    result = md_polygon_end_contour__software(pPolygon, MD_TRUE);
+                    isContourOpen = MD_FALSE;
+                }
+            } break;
+
+            default: break;
+        }
     }
-}
 
+    if (result == MD_SUCCESS) {
+        result = md_polygon_end_contour__software(pPolygon, MD_FALSE);
+    }
 
-/**************************************************************************************************************************************************************
+    pPath->isFlattenedValid = (result == MD_SUCCESS);
 
-Graphics
+    return result;
+}
 
-**************************************************************************************************************************************************************/
-md_result md_brush_init(md_api* pAPI, const md_brush_config* pConfig, md_brush* pBrush)
+/*
+Checks whether or not the path is made up of nothing but rectangles that are aligned to the axes in device space, which is what md_gc_rectangle() produces
+when the matrix has no rotation or skew. On success each rectangle is output to pRects as left, top, right and bottom. Returns false when the path is
+anything else, or when there are more than rectCap rectangles.
+*/
+MD_PRIVATE md_bool32 md_path_get_rectangles__software(const md_path_software* pPath, float* pRects, md_uint32 rectCap, md_uint32* pRectCount)
 {
-    md_result result;
+    md_uint32 rectCount;
+    md_uint32 iRect;
 
-    if (pBrush == NULL) {
-        return MD_INVALID_ARGS;
-    }
+    MD_ASSERT(pPath      != NULL);
+    MD_ASSERT(pRects     != NULL);
+    MD_ASSERT(pRectCount != NULL);
 
-    MD_ZERO_OBJECT(pBrush);
+    if (pPath->commandCount == 0 || (pPath->commandCount % 5) != 0) {
+        return MD_FALSE;
+    }
 
-    if (pAPI == NULL || pConfig == NULL) {
-        return MD_INVALID_ARGS;
+    rectCount = pPath->commandCount / 5;
+    if (rectCount > rectCap || pPath->pointCount != rectCount * 4) {
+        return MD_FALSE;
     }
 
-    pBrush->pAPI = pAPI;
-    pBrush->pUserData = pConfig->pUserData;
-    pBrush->config = *pConfig;
+    for (iRect = 0; iRect < rectCount; ++iRect) {
+        const md_uint8* pCommands = pPath->pCommands + iRect*5;
+        const float* p = pPath->pPoints + iRect*8;
 
-    if (pAPI->procs.brushInit) {
-        result = pAPI->procs.brushInit(pAPI, pConfig, pBrush);
-        if (result != MD_SUCCESS) {
-            return result;
+        if (pCommands[0] != MD_SOFTWARE_PATH_MOVE_TO || pCommands[1] != MD_SOFTWARE_PATH_LINE_TO || pCommands[2] != MD_SOFTWARE_PATH_LINE_TO ||
+            pCommands[3] != MD_SOFTWARE_PATH_LINE_TO || pCommands[4] != MD_SOFTWARE_PATH_CLOSE) {
+            return MD_FALSE;
+        }
+
+        /* The first edge can be either horizontal or vertical depending on whether or not the matrix has a 90 degree rotation. */
+        if (!(p[1] == p[3] && p[2] == p[4] && p[5] == p[7] && p[6] == p[0]) &&
+            !(p[0] == p[2] && p[3] == p[5] && p[4] == p[6] && p[7] == p[1])) {
+            return MD_FALSE;
         }
+
+        pRects[iRect*4 + 0] = MD_MIN(p[0], p[4]);
+        pRects[iRect*4 + 1] = MD_MIN(p[1], p[5]);
+        pRects[iRect*4 + 2] = MD_MAX(p[0], p[4]);
+        pRects[iRect*4 + 3] = MD_MAX(p[1], p[5]);
     }
 
-    return MD_SUCCESS;
+    *pRectCount = rectCount;
+    return MD_TRUE;
 }
 
-void md_brush_uninit(md_brush* pBrush)
+
+/* Rasterization */
+typedef void (* md_span_proc_software)(void* pUserData, md_rasterizer_software* pRasterizer, md_int32 x, md_int32 y, md_int32 count, const md_uint8* pCoverage, md_uint8 coverage);
+
+MD_PRIVATE int md_compare_edges__software(const void* a, const void* b)
 {
-    if (pBrush == NULL) {
-        return;
+    float y0a = ((const md_edge_software*)a)->y0;
+    float y0b = ((const md_edge_software*)b)->y0;
+
+    if (y0a < y0b) {
+        return -1;
+    }
+    if (y0a > y0b) {
+        return 1;
     }
 
-    MD_ASSERT(pBrush->pAPI != NULL);
+    return 0;
+}
 
-    if (pBrush->pAPI->procs.brushUninit) {
-        pBrush->pAPI->procs.brushUninit(pBrush);
+MD_PRIVATE int md_compare_cells__software(const void* a, const void* b)
+{
+    const md_cell_software* pCellA = (const md_cell_software*)a;
+    const md_cell_software* pCellB = (const md_cell_software*)b;
+
+    if (pCellA->y != pCellB->y) {
+        return (pCellA->y < pCellB->y) ? -1 : 1;
+    }
+    if (pCellA->x != pCellB->x) {
+        return (pCellA->x < pCellB->x) ? -1 : 1;
     }
 
-    MD_ZERO_OBJECT(pBrush);  /* Safety. */
+    return 0;
 }
 
-void md_brush_set_origin(md_brush* pBrush, md_int32 x, md_int32 y)
+MD_PRIVATE md_result md_rasterizer_init__software(md_uint32 sizeX, md_rasterizer_software* pRasterizer)
 {
-    if (pBrush == NULL) {
-        return;
-    }
+    MD_ASSERT(pRasterizer != NULL);
 
-    MD_ASSERT(pBrush->pAPI != NULL);
+    MD_ZERO_OBJECT(pRasterizer);
 
-    if (pBrush->pAPI->procs.brushSetOrigin) {
-        pBrush->pAPI->procs.brushSetOrigin(pBrush, x, y);
+    /* Scanline scratch buffers. The source pixels go first to keep them aligned. */
+    pRasterizer->pSpanSrc = (md_uint32*)MD_MALLOC(sizeX * (sizeof(md_uint32) + 2));
+    if (pRasterizer->pSpanSrc == NULL) {
+        return MD_OUT_OF_MEMORY;
     }
+
+    pRasterizer->pSpanMask = (md_uint8*)(pRasterizer->pSpanSrc + sizeX);
+    pRasterizer->pCoverage = pRasterizer->pSpanMask + sizeX;
+
+    return MD_SUCCESS;
 }
 
-md_result md_gc_init(md_api* pAPI, const md_gc_config* pConfig, md_gc* pGC)
+MD_PRIVATE void md_rasterizer_uninit__software(md_rasterizer_software* pRasterizer)
 {
-    md_result result;
-
-    if (pGC == NULL) {
-        return MD_INVALID_ARGS;
-    }
+    MD_ASSERT(pRasterizer != NULL);
 
-    MD_ZERO_OBJECT(pGC);
+    MD_FREE(pRasterizer->pActiveEdges);
+    MD_FREE(pRasterizer->pCrossings);
+    MD_FREE(pRasterizer->pCells);
+    MD_FREE(pRasterizer->pSpanSrc);
+    MD_ZERO_OBJECT(pRasterizer);
+}
 
-    if (pAPI == NULL || pConfig == NULL) {
-        return MD_INVALID_ARGS;
-    }
+MD_PRIVATE md_result md_rasterizer_reserve_active_edges__software(md_rasterizer_software* pRasterizer, md_uint32 edgeCount)
+{
+    if (edgeCount > pRasterizer->activeEdgeCap) {
+        md_uint32 newCap = MD_MAX(edgeCount, pRasterizer->activeEdgeCap * 2);
+        md_uint32* pNewActiveEdges;
+        float* pNewCrossings;
 
-    pGC->pAPI = pAPI;
-    pGC->pUserData = pConfig->pUserData;
+        pNewActiveEdges = (md_uint32*)MD_REALLOC(pRasterizer->pActiveEdges, newCap * sizeof(*pNewActiveEdges));
+        if (pNewActiveEdges == NULL) {
+            return MD_OUT_OF_MEMORY;
+        }
+        pRasterizer->pActiveEdges = pNewActiveEdges;
 
-    if (pAPI->procs.gcInit) {
-        result = pAPI->procs.gcInit(pAPI, pConfig, pGC);
-        if (result != MD_SUCCESS) {
-            return result;
+        pNewCrossings = (float*)MD_REALLOC(pRasterizer->pCrossings, newCap * sizeof(float) * 2);
+        if (pNewCrossings == NULL) {
+            return MD_OUT_OF_MEMORY;
         }
+        pRasterizer->pCrossings = pNewCrossings;
+
+        pRasterizer->activeEdgeCap = newCap;
     }
 
     return MD_SUCCESS;
 }
 
-void md_gc_uninit(md_gc* pGC)
+MD_PRIVATE md_result md_gc_reserve_edges__software(md_gc* pGC, md_uint32 edgeCount)
 {
-    if (pGC == NULL) {
-        return;
-    }
+    if (edgeCount > pGC->software.edgeCap) {
+        md_uint32 newCap = MD_MAX(edgeCount, pGC->software.edgeCap * 2);
+        md_edge_software* pNewEdges;
 
-    MD_ASSERT(pGC->pAPI != NULL);
+        pNewEdges = (md_edge_software*)MD_REALLOC(pGC->software.pEdges, newCap * sizeof(*pNewEdges));
+        if (pNewEdges == NULL) {
+            return MD_OUT_OF_MEMORY;
+        }
 
-    if (pGC->pAPI->procs.gcUninit) {
-        pGC->pAPI->procs.gcUninit(pGC);
+        pGC->software.pEdges  = pNewEdges;
+        pGC->software.edgeCap = newCap;
     }
+
+    return MD_SUCCESS;
 }
 
-md_result md_gc_get_image_data_size_in_bytes(md_gc* pGC, md_format outputFormat, size_t* pSizeInBytes)
+/*
+Converts each contour of the polygon to a list of edges going from top to bottom. Every contour is treated as closed. Horizontal edges never cross a
+scanline so they are discarded.
+*/
+MD_PRIVATE md_result md_build_edges__software(md_gc* pGC, const md_polygon_software* pPolygon, md_uint32* pEdgeCount, float* pMinY, float* pMaxY)
 {
     md_result result;
-    md_uint32 sizeX;
-    md_uint32 sizeY;
+    md_uint32 edgeCount = 0;
+    md_uint32 iContour;
+    md_edge_software* pEdges;
+    float minY =  3.402823466e+38f;
+    float maxY = -3.402823466e+38f;
 
-    if (pSizeInBytes != NULL) {
-        *pSizeInBytes = 0;  /* Safety. */
+    result = md_gc_reserve_edges__software(pGC, pPolygon->pointCount);
+    if (result != MD_SUCCESS) {
+        return result;
     }
 
-    if (pGC == NULL || pSizeInBytes == NULL) {
-        return MD_INVALID_ARGS;
-    }
+    pEdges = pGC->software.pEdges;
 
-    MD_ASSERT(pGC->pAPI != NULL);
+    for (iContour = 0; iContour < pPolygon->contourCount; ++iContour) {
+        md_uint32 iBeg = md_polygon_get_contour_beg__software(pPolygon, iContour);
+        md_uint32 iEnd = md_polygon_get_contour_end__software(pPolygon, iContour);
+        md_uint32 iPoint;
 
-    result = md_gc_get_size(pGC, &sizeX, &sizeY);
-    if (result != MD_SUCCESS) {
-        return result;
+        if (iEnd - iBeg < 2) {
+            continue;
+        }
+
+        for (iPoint = iBeg; iPoint < iEnd; ++iPoint) {
+            md_uint32 iNext = (iPoint+1 < iEnd) ? iPoint+1 : iBeg;
+            float x0 = pPolygon->pPoints[iPoint*2 + 0];
+            float y0 = pPolygon->pPoints[iPoint*2 + 1];
+            float x1 = pPolygon->pPoints[iNext *2 + 0];
+            float y1 = pPolygon->pPoints[iNext *2 + 1];
+
+            if (y0 == y1) {
+                continue;
+            }
+
+            if (y0 < y1) {
+                pEdges[edgeCount].x0  = x0;
+                pEdges[edgeCount].y0  = y0;
+                pEdges[edgeCount].x1  = x1;
+                pEdges[edgeCount].y1  = y1;
+                pEdges[edgeCount].dir = 1;
+            } else {
+                pEdges[edgeCount].x0  = x1;
+                pEdges[edgeCount].y0  = y1;
+                pEdges[edgeCount].x1  = x0;
+                pEdges[edgeCount].y1  = y0;
+                pEdges[edgeCount].dir = -1;
+            }
+
+            minY = MD_MIN(minY, pEdges[edgeCount].y0);
+            maxY = MD_MAX(maxY, pEdges[edgeCount].y1);
+            edgeCount += 1;
+        }
     }
 
-    *pSizeInBytes = sizeX * sizeY * md_get_bytes_per_pixel(outputFormat);
+    *pEdgeCount = edgeCount;
+    *pMinY = minY;
+    *pMaxY = maxY;
 
     return MD_SUCCESS;
 }
 
-md_result md_gc_get_image_data(md_gc* pGC, md_format outputFormat, void* pImageData)
+/*
+Fills the rows in [yBeg, yEnd) without anti-aliasing by sampling at the center of each pixel. Used with md_antialias_mode_none. pEdgeIndices is the list
+of edges touching those rows, or NULL to use every edge. Either way the edges must be in the order they were sorted into by md_compare_edges__software().
+Spans are emitted in top-to-bottom, left-to-right order and are clipped to the bounds of the surface.
+*/
+MD_PRIVATE md_result md_rasterize_edges_aliased__software(md_gc* pGC, md_rasterizer_software* pRasterizer, const md_uint32* pEdgeIndices, md_uint32 edgeCount, md_int32 yBeg, md_int32 yEnd, md_fill_mode fillMode, md_span_proc_software onSpan, void* pUserData)
 {
     md_result result;
+    md_uint32 activeCount = 0;
+    md_uint32 iEdge;
+    md_int32 y;
+    md_edge_software* pEdges;
+    md_uint32* pActiveEdges;
+    float* pCrossings;
 
-    if (pGC == NULL || pImageData == NULL) {
-        return MD_INVALID_ARGS;
+    result = md_rasterizer_reserve_active_edges__software(pRasterizer, edgeCount);
+    if (result != MD_SUCCESS) {
+        return result;
     }
 
-    MD_ASSERT(pGC->pAPI != NULL);
+    pEdges       = pGC->software.pEdges;
+    pActiveEdges = pRasterizer->pActiveEdges;
+    pCrossings   = pRasterizer->pCrossings;
 
-    if (pGC->pAPI->procs.gcGetImageData) {
-        result = pGC->pAPI->procs.gcGetImageData(pGC, outputFormat, pImageData);
-        if (result != MD_SUCCESS) {
-            return result;
-        }
+    iEdge = 0;
+    for (y = yBeg; y < yEnd; ++y) {
+        float sampleY = y + 0.5f;
+        md_uint32 crossingCount = 0;
+        md_uint32 iActive;
+        md_uint32 iCrossing;
+        md_int32 winding = 0;
+        float spanBegX = 0;
 
-        return result;
-    } else {
-        return MD_INVALID_OPERATION;
-    }
-}
+        /* Bring in new edges and drop old ones. */
+        while (iEdge < edgeCount) {
+            md_uint32 iNewEdge = (pEdgeIndices != NULL) ? pEdgeIndices[iEdge] : iEdge;
+            if (pEdges[iNewEdge].y0 > sampleY) {
+                break;
+            }
 
-md_result md_gc_get_size(md_gc* pGC, md_uint32* pSizeX, md_uint32* pSizeY)
-{
-    if (pSizeX != NULL) {
-        *pSizeX = 0;
-    }
-    if (pSizeY != NULL) {
-        *pSizeY = 0;
-    }
+            pActiveEdges[activeCount] = iNewEdge;
+            activeCount += 1;
+            iEdge += 1;
+        }
 
-    if (pGC == NULL) {
-        return MD_INVALID_ARGS;
-    }
+        for (iActive = 0; iActive < activeCount; /* Do nothing. */) {
+            const md_edge_software* pEdge = &pEdges[pActiveEdges[iActive]];
+            if (pEdge->y1 <= sampleY) {
+                pActiveEdges[iActive] = pActiveEdges[activeCount-1];
+                activeCount -= 1;
+            } else {
+                iActive += 1;
+            }
+        }
 
-    MD_ASSERT(pGC->pAPI != NULL);
+        /* Find where each active edge crosses the sample line and sort them left to right. Insertion sort because these lists are short. */
+        for (iActive = 0; iActive < activeCount; ++iActive) {
+            const md_edge_software* pEdge = &pEdges[pActiveEdges[iActive]];
+            float x = pEdge->x0 + (sampleY - pEdge->y0) * (pEdge->x1 - pEdge->x0) / (pEdge->y1 - pEdge->y0);
+            md_uint32 iInsert = crossingCount;
 
-    if (pGC->pAPI->procs.gcGetSize) {
-        md_uint32 sizeX;
-        md_uint32 sizeY;
-        md_result result = pGC->pAPI->procs.gcGetSize(pGC, &sizeX, &sizeY);
-        if (result != MD_SUCCESS) {
-            return result;
-        }
+            while (iInsert > 0 && pCrossings[(iInsert-1)*2] > x) {
+                pCrossings[iInsert*2 + 0] = pCrossings[(iInsert-1)*2 + 0];
+                pCrossings[iInsert*2 + 1] = pCrossings[(iInsert-1)*2 + 1];
+                iInsert -= 1;
+            }
 
-        if (pSizeX != NULL) {
-            *pSizeX = sizeX;
+            pCrossings[iInsert*2 + 0] = x;
+            pCrossings[iInsert*2 + 1] = (float)pEdge->dir;
+            crossingCount += 1;
         }
-        if (pSizeY != NULL) {
-            *pSizeY = sizeY;
+
+        for (iCrossing = 0; iCrossing < crossingCount; ++iCrossing) {
+            md_bool32 wasInside;
+            md_bool32 isInside;
+
+            if (fillMode == md_fill_mode_evenodd) {
+                wasInside = (winding & 1) != 0;
+                winding  += (md_int32)pCrossings[iCrossing*2 + 1];
+                isInside  = (winding & 1) != 0;
+            } else {
+                wasInside = winding != 0;
+                winding  += (md_int32)pCrossings[iCrossing*2 + 1];
+                isInside  = winding != 0;
+            }
+
+            if (!wasInside && isInside) {
+                spanBegX = pCrossings[iCrossing*2 + 0];
+            } else if (wasInside && !isInside) {
+                /* Pixels whose centers are inside [spanBegX, spanEndX). */
+                md_int32 x0 = (md_int32)ceil(spanBegX - 0.5f);
+                md_int32 x1 = (md_int32)ceil(pCrossings[iCrossing*2 + 0] - 0.5f);
+
+                x0 = MD_MAX(x0, 0);
+                x1 = MD_MIN(x1, (md_int32)pGC->software.sizeX);
+                if (x1 > x0) {
+                    onSpan(pUserData, pRasterizer, x0, y, x1 - x0, NULL, 255);
+                }
+            }
         }
     }
 
     return MD_SUCCESS;
 }
 
-md_result md_gc_save(md_gc* pGC)
+MD_PRIVATE md_result md_add_cell__software(md_rasterizer_software* pRasterizer, md_int32 x, md_int32 y, float cover, float area)
 {
-    if (pGC == NULL) {
-        return MD_INVALID_ARGS;
+    md_cell_software* pCell;
+
+    /* Edges tend to touch the same cell many times in a row so those are merged as they come in. */
+    if (pRasterizer->cellCount > 0) {
+        pCell = &pRasterizer->pCells[pRasterizer->cellCount-1];
+        if (pCell->x == x && pCell->y == y) {
+            pCell->cover += cover;
+            pCell->area  += area;
+            return MD_SUCCESS;
+        }
     }
 
-    MD_ASSERT(pGC->pAPI != NULL);
+    if (pRasterizer->cellCount == pRasterizer->cellCap) {
+        md_uint32 newCap = MD_MAX(256, pRasterizer->cellCap * 2);
+        md_cell_software* pNewCells = (md_cell_software*)MD_REALLOC(pRasterizer->pCells, newCap * sizeof(*pNewCells));
+        if (pNewCells == NULL) {
+            return MD_OUT_OF_MEMORY;
+        }
 
-    if (pGC->pAPI->procs.gcSave) {
-        return pGC->pAPI->procs.gcSave(pGC);
+        pRasterizer->pCells  = pNewCells;
+        pRasterizer->cellCap = newCap;
     }
-    
+
+    pCell = &pRasterizer->pCells[pRasterizer->cellCount];
+    pCell->x     = x;
+    pCell->y     = y;
+    pCell->cover = cover;
+    pCell->area  = area;
+    pRasterizer->cellCount += 1;
+
     return MD_SUCCESS;
 }
 
-md_result md_gc_restore(md_gc* pGC)
+/*
+Accumulates a segment that is contained within a single scanline. ya must be less than yb. The segment has already been clipped against the left and
+right sides of the surface, except for the parts left of the surface which are passed in with a cell X position of -1 so that their cover still gets
+carried over to the visible cells.
+*/
+MD_PRIVATE md_result md_add_row_segment__software(md_rasterizer_software* pRasterizer, md_int32 row, float xa, float ya, float xb, float yb, float dir)
 {
-    if (pGC == NULL) {
-        return MD_INVALID_ARGS;
+    md_result result;
+    md_int32 ix;
+    md_int32 ixEnd;
+    float dxdy;
+
+    if (xa <= 0 && xb <= 0) {
+        return md_add_cell__software(pRasterizer, -1, row, (yb - ya) * dir, 0);
     }
 
-    MD_ASSERT(pGC->pAPI != NULL);
+    ix    = (md_int32)floor(xa);
+    ixEnd = (md_int32)floor(xb);
 
-    if (pGC->pAPI->procs.gcRestore) {
-        return pGC->pAPI->procs.gcRestore(pGC);
+    if (ix == ixEnd) {
+        float dy = (yb - ya) * dir;
+        return md_add_cell__software(pRasterizer, ix, row, dy, dy * (1 - ((xa + xb) * 0.5f - ix)));
     }
-    
-    return MD_SUCCESS;
-}
 
-void md_gc_set_matrix(md_gc* pGC, const md_matrix* pMatrix)
-{
-    if (pGC == NULL || pMatrix == NULL) {
-        return;
-    }
+    /* The segment crosses at least one vertical cell boundary. Walk each cell it touches. */
+    dxdy = (xb - xa) / (yb - ya);
 
-    MD_ASSERT(pGC->pAPI != NULL);
+    if (xa < xb) {
+        while (ix < ixEnd) {
+            float xBoundary = (float)(ix + 1);
+            float yBoundary = ya + (xBoundary - xa) / dxdy;
+            float dy;
 
-    if (pGC->pAPI->procs.gcSetMatrix) {
-        pGC->pAPI->procs.gcSetMatrix(pGC, pMatrix);
-    }
-}
+            if (yBoundary > yb) {
+                yBoundary = yb;
+            }
 
-void md_gc_get_matrix(md_gc* pGC, md_matrix* pMatrix)
-{
-    if (pGC == NULL || pMatrix == NULL) {
-        return;
-    }
+            dy = (yBoundary - ya) * dir;
+            result = md_add_cell__software(pRasterizer, ix, row, dy, dy * (1 - ((xa + xBoundary) * 0.5f - ix)));
+            if (result != MD_SUCCESS) {
+                return result;
+            }
 
-    MD_ASSERT(pGC->pAPI != NULL);
+            xa = xBoundary;
+            ya = yBoundary;
+            ix += 1;
+        }
+    } else {
+        while (ix > ixEnd) {
+            float xBoundary = (float)ix;
+            float yBoundary = ya + (xBoundary - xa) / dxdy;
+            float dy;
 
-    if (pGC->pAPI->procs.gcGetMatrix) {
-        pGC->pAPI->procs.gcGetMatrix(pGC, pMatrix);
-    }
-}
+            if (yBoundary > yb) {
+                yBoundary = yb;
+            }
 
-void md_gc_set_matrix_identity(md_gc* pGC)
-{
-    if (pGC == NULL) {
-        return;
-    }
+            dy = (yBoundary - ya) * dir;
+            result = md_add_cell__software(pRasterizer, ix, row, dy, dy * (1 - ((xa + xBoundary) * 0.5f - ix)));
+            if (result != MD_SUCCESS) {
+                return result;
+            }
 
-    MD_ASSERT(pGC->pAPI != NULL);
+            xa = xBoundary;
+            ya = yBoundary;
+            ix -= 1;
+        }
+    }
 
-    if (pGC->pAPI->procs.gcSetMatrixIdentity) {
-        pGC->pAPI->procs.gcSetMatrixIdentity(pGC);
+    {
+        float dy = (yb - ya) * dir;
+        return md_add_cell__software(pRasterizer, ix, row, dy, dy * (1 - ((xa + xb) * 0.5f - ix)));
     }
 }
 
-void md_gc_transform(md_gc* pGC, const md_matrix* pMatrix)
+/* Accumulates the parts of an edge that fall within the rows in [yBeg, yEnd). */
+MD_PRIVATE md_result md_add_edge__software(md_gc* pGC, md_rasterizer_software* pRasterizer, const md_edge_software* pEdge, md_int32 yBeg, md_int32 yEnd)
 {
-    if (pGC == NULL || pMatrix == NULL) {
-        return;
-    }
+    md_result result;
+    float sizeX = (float)pGC->software.sizeX;
+    float dir = (float)pEdge->dir;
+    float dxdy;
+    md_int32 row;
+    md_int32 rowEnd;
+
+    dxdy   = (pEdge->x1 - pEdge->x0) / (pEdge->y1 - pEdge->y0);
+    row    = (md_int32)MD_MAX((float)yBeg, (float)floor(pEdge->y0));
+    rowEnd = (md_int32)MD_MIN((float)yEnd, (float)ceil(pEdge->y1));
+
+    for (/* Do nothing. */; row < rowEnd; ++row) {
+        float ya = MD_MAX(pEdge->y0, (float)row);
+        float yb = MD_MIN(pEdge->y1, (float)(row + 1));
+        float xa = pEdge->x0 + (ya - pEdge->y0) * dxdy;
+        float xb = pEdge->x0 + (yb - pEdge->y0) * dxdy;
+        float xLo;
+        float xHi;
+
+        if (yb <= ya) {
+            continue;
+        }
 
-    MD_ASSERT(pGC->pAPI != NULL);
+        xLo = MD_MIN(xa, xb);
+        xHi = MD_MAX(xa, xb);
 
-    if (pGC->pAPI->procs.gcTransform) {
-        pGC->pAPI->procs.gcTransform(pGC, pMatrix);
-    }
-}
+        /* Anything to the right of the surface has no effect on any visible pixel. */
+        if (xLo >= sizeX) {
+            continue;
+        }
 
-void md_gc_translate(md_gc* pGC, md_int32 offsetX, md_int32 offsetY)
-{
-    if (pGC == NULL) {
-        return;
-    }
+        if (xHi > sizeX) {
+            float yCut = ya + (sizeX - xa) / dxdy;
+            if (xa > xb) {
+                ya = yCut;
+                xa = sizeX;
+            } else {
+                yb = yCut;
+                xb = sizeX;
+            }
+        }
 
-    MD_ASSERT(pGC->pAPI != NULL);
+        /* Anything to the left only contributes its cover which is accumulated into a single cell just outside the surface. */
+        if (xLo < 0 && xHi > 0) {
+            float yCut = ya + (0 - xa) / dxdy;
+            if (xa < xb) {
+                result = md_add_row_segment__software(pRasterizer, row, xa, ya, -1, yCut, dir);
+                ya = yCut;
+                xa = 0;
+            } else {
+                result = md_add_row_segment__software(pRasterizer, row, -1, yCut, xb, yb, dir);
+                yb = yCut;
+                xb = 0;
+            }
 
-    if (pGC->pAPI->procs.gcTranslate) {
-        pGC->pAPI->procs.gcTranslate(pGC, offsetX, offsetY);
+            if (result != MD_SUCCESS) {
+                return result;
+            }
+        }
+
+        if (yb > ya) {
+            result = md_add_row_segment__software(pRasterizer, row, xa, ya, xb, yb, dir);
+            if (result != MD_SUCCESS) {
+                return result;
+            }
+        }
     }
+
+    return MD_SUCCESS;
 }
 
-void md_gc_rotate(md_gc* pGC, float rotationInRadians)
+static MD_INLINE md_uint8 md_coverage_from_area__software(float area, md_fill_mode fillMode)
 {
-    if (pGC == NULL) {
-        return;
+    if (area < 0) {
+        area = -area;
     }
 
-    MD_ASSERT(pGC->pAPI != NULL);
-
-    if (pGC->pAPI->procs.gcRotate) {
-        pGC->pAPI->procs.gcRotate(pGC, rotationInRadians);
+    if (fillMode == md_fill_mode_evenodd) {
+        area = (float)fmod(area, 2);
+        if (area > 1) {
+            area = 2 - area;
+        }
+    } else {
+        if (area > 1) {
+            area = 1;
+        }
     }
+
+    return (md_uint8)(area * 255 + 0.5f);
 }
 
-void md_gc_scale(md_gc* pGC, float scaleX, float scaleY)
+/*
+Fills the rows in [yBeg, yEnd) with anti-aliasing. Each edge deposits its signed area and cover into only the cells it passes through. The cells are then
+swept left to right along each scanline with a running sum of the cover, which gives the coverage of the pixels between cells without needing to visit
+them individually. Pixels in the interior of a shape are therefore emitted as solid spans and the cost of filling scales with the length of the outline
+rather than the area of the shape. pEdgeIndices is the list of edges touching those rows, or NULL to use every edge.
+*/
+MD_PRIVATE md_result md_rasterize_edges_antialiased__software(md_gc* pGC, md_rasterizer_software* pRasterizer, const md_uint32* pEdgeIndices, md_uint32 edgeCount, md_int32 yBeg, md_int32 yEnd, md_fill_mode fillMode, md_span_proc_software onSpan, void* pUserData)
 {
-    if (pGC == NULL) {
-        return;
+    md_result result;
+    md_uint32 iEdge;
+    md_uint32 iCell;
+    md_uint32 cellCount;
+    md_cell_software* pCells;
+    md_uint8* pCoverage;
+
+    pRasterizer->cellCount = 0;
+    for (iEdge = 0; iEdge < edgeCount; ++iEdge) {
+        result = md_add_edge__software(pGC, pRasterizer, &pGC->software.pEdges[(pEdgeIndices != NULL) ? pEdgeIndices[iEdge] : iEdge], yBeg, yEnd);
+        if (result != MD_SUCCESS) {
+            return result;
+        }
     }
 
-    MD_ASSERT(pGC->pAPI != NULL);
-
-    if (pGC->pAPI->procs.gcScale) {
-        pGC->pAPI->procs.gcScale(pGC, scaleX, scaleY);
+    pCells    = pRasterizer->pCells;
+    pCoverage = pRasterizer->pCoverage;
+    cellCount = pRasterizer->cellCount;
+    if (cellCount > 1) {
+        qsort(pCells, cellCount, sizeof(*pCells), md_compare_cells__software);  /* pCells can be NULL when nothing has been rasterized yet. */
     }
-}
 
-void md_gc_set_miter_limit(md_gc* pGC, float limit)
-{
-    if (pGC == NULL) {
-        return;
-    }
+    iCell = 0;
+    while (iCell < cellCount) {
+        md_int32 y = pCells[iCell].y;
+        md_int32 runBegX = 0;
+        md_int32 runEndX = 0;  /* The pixels in [runBegX, runEndX) have coverage values in pCoverage which are yet to be emitted. */
+        float accumulatedCover = 0;
 
-    MD_ASSERT(pGC->pAPI != NULL);
+        while (iCell < cellCount && pCells[iCell].y == y) {
+            md_int32 x = pCells[iCell].x;
+            float cover = 0;
+            float area  = 0;
 
-    if (pGC->pAPI->procs.gcSetMiterLimit) {
-        pGC->pAPI->procs.gcSetMiterLimit(pGC, limit);
-    }
-}
+            /* All of the cells with the same position are combined. */
+            while (iCell < cellCount && pCells[iCell].y == y && pCells[iCell].x == x) {
+                cover += pCells[iCell].cover;
+                area  += pCells[iCell].area;
+                iCell += 1;
+            }
 
-void md_gc_set_line_width(md_gc* pGC, md_int32 width)
-{
-    if (pGC == NULL) {
-        return;
-    }
+            if (x >= 0 && x < (md_int32)pGC->software.sizeX) {
+                /* Any gap since the previous cell is a run of pixels which all have the same coverage. */
+                if (x > runEndX) {
+                    md_uint8 gapCoverage = md_coverage_from_area__software(accumulatedCover, fillMode);
 
-    MD_ASSERT(pGC->pAPI != NULL);
+                    if (runEndX > runBegX) {
+                        onSpan(pUserData, pRasterizer, runBegX, y, runEndX - runBegX, pCoverage + runBegX, 0);
+                    }
 
-    if (pGC->pAPI->procs.gcSetLineWidth) {
-        pGC->pAPI->procs.gcSetLineWidth(pGC, width);
+                    if (gapCoverage > 0) {
+                        onSpan(pUserData, pRasterizer, runEndX, y, x - runEndX, NULL, gapCoverage);
+                    }
+
+                    runBegX = x;
+                }
+
+                pCoverage[x] = md_coverage_from_area__software(accumulatedCover + area, fillMode);
+                runEndX = x + 1;
+            }
+
+            accumulatedCover += cover;
+        }
+
+        if (runEndX > runBegX) {
+            onSpan(pUserData, pRasterizer, runBegX, y, runEndX - runBegX, pCoverage + runBegX, 0);
+        }
+
+        /* The cover only adds back up to zero by the end of the scanline when the shape does not extend past the right side of the surface. */
+        if (runEndX < (md_int32)pGC->software.sizeX) {
+            md_uint8 tailCoverage = md_coverage_from_area__software(accumulatedCover, fillMode);
+            if (tailCoverage > 0) {
+                onSpan(pUserData, pRasterizer, runEndX, y, (md_int32)pGC->software.sizeX - runEndX, NULL, tailCoverage);
+            }
+        }
     }
+
+    return MD_SUCCESS;
 }
 
-void md_gc_set_line_cap(md_gc* pGC, md_line_cap cap)
+MD_PRIVATE md_result md_rasterize_edges__software(md_gc* pGC, md_rasterizer_software* pRasterizer, const md_uint32* pEdgeIndices, md_uint32 edgeCount, md_int32 yBeg, md_int32 yEnd, md_fill_mode fillMode, md_antialias_mode antialiasMode, md_span_proc_software onSpan, void* pUserData)
 {
-    if (pGC == NULL) {
-        return;
+    if (edgeCount == 0) {
+        return MD_SUCCESS;
     }
 
-    MD_ASSERT(pGC->pAPI != NULL);
-
-    if (pGC->pAPI->procs.gcSetLineCap) {
-        pGC->pAPI->procs.gcSetLineCap(pGC, cap);
+    if (antialiasMode == md_antialias_mode_none) {
+        return md_rasterize_edges_aliased__software(pGC, pRasterizer, pEdgeIndices, edgeCount, yBeg, yEnd, fillMode, onSpan, pUserData);
+    } else {
+        return md_rasterize_edges_antialiased__software(pGC, pRasterizer, pEdgeIndices, edgeCount, yBeg, yEnd, fillMode, onSpan, pUserData);
     }
 }
 
-void md_gc_set_line_join(md_gc* pGC, md_line_join join)
-{
-    if (pGC == NULL) {
-        return;
-    }
 
-    MD_ASSERT(pGC->pAPI != NULL);
+/* Tiles */
+typedef md_result (* md_tile_proc_software)(void* pUserData, md_rasterizer_software* pRasterizer, md_uint32 iTile, md_int32 yBeg, md_int32 yEnd);
 
-    if (pGC->pAPI->procs.gcSetLineJoin) {
-        pGC->pAPI->procs.gcSetLineJoin(pGC, join);
-    }
+typedef struct
+{
+    md_tile_proc_software onTile;
+    void* pUserData;
+    md_uint32 tileEnd;
+    md_result result;               /* The first error returned by onTile. */
+} md_tile_job_software;
+
+static MD_INLINE void md_gc_get_tile_rows__software(md_gc* pGC, md_uint32 iTile, md_int32* pYBeg, md_int32* pYEnd)
+{
+    *pYBeg = (md_int32)(iTile * pGC->software.tileSize);
+    *pYEnd = (md_int32)MD_MIN((iTile + 1) * pGC->software.tileSize, pGC->software.sizeY);
 }
 
-void md_gc_set_line_dash(md_gc* pGC, const float* dashes, md_uint32 count)
+/* Called from each participating thread. Tiles are handed out one at a time until there are none left. */
+MD_PRIVATE void md_gc_run_tile_job__software(md_gc* pGC, md_tile_job_software* pJob, md_rasterizer_software* pRasterizer)
 {
-    if (pGC == NULL) {
-        return;
-    }
+    for (;;) {
+        md_uint32 iTile;
+        md_int32 yBeg;
+        md_int32 yEnd;
+        md_result result;
 
-    MD_ASSERT(pGC->pAPI != NULL);
+        md_mutex_lock(&pGC->software.tileLock);
+        {
+            iTile = pGC->software.nextTile;
+            if (iTile < pJob->tileEnd) {
+                pGC->software.nextTile += 1;
+            }
+        }
+        md_mutex_unlock(&pGC->software.tileLock);
 
-    if (count > 16) {
-        return; /* Count cannot be more than 16. */
-    }
+        if (iTile >= pJob->tileEnd) {
+            break;
+        }
 
-    if (pGC->pAPI->procs.gcSetLineDash) {
-        pGC->pAPI->procs.gcSetLineDash(pGC, dashes, count);
+        md_gc_get_tile_rows__software(pGC, iTile, &yBeg, &yEnd);
+
+        result = pJob->onTile(pJob->pUserData, pRasterizer, iTile, yBeg, yEnd);
+        if (result != MD_SUCCESS) {
+            md_mutex_lock(&pGC->software.tileLock);
+            {
+                if (pJob->result == MD_SUCCESS) {
+                    pJob->result = result;
+                }
+            }
+            md_mutex_unlock(&pGC->software.tileLock);
+        }
     }
 }
 
-void md_gc_set_line_brush(md_gc* pGC, md_brush* pBrush)
+/*
+Calls onTile for each tile in [tileBeg, tileEnd). Tiles are horizontal bands of the surface which means no two tiles ever touch the same pixel, and the
+result is the same regardless of which thread ends up processing which tile. The calling thread processes tiles as well, and this does not return until
+every tile is done. When allowThreads is false, or the GC was not initialized with any worker threads, the tiles are processed in order on the calling
+thread.
+*/
+MD_PRIVATE md_result md_gc_run_tiles__software(md_gc* pGC, md_uint32 tileBeg, md_uint32 tileEnd, md_bool32 allowThreads, md_tile_proc_software onTile, void* pUserData)
 {
-    if (pGC == NULL) {
-        return;
+    md_tile_job_software job;
+    md_uint32 workerCount;
+    md_uint32 iWorker;
+
+    if (tileEnd <= tileBeg) {
+        return MD_SUCCESS;
     }
 
-    MD_ASSERT(pGC->pAPI != NULL);
+    workerCount = (allowThreads) ? MD_MIN(pGC->software.workerCount, tileEnd - tileBeg - 1) : 0;
+    if (workerCount == 0) {
+        md_uint32 iTile;
+        for (iTile = tileBeg; iTile < tileEnd; ++iTile) {
+            md_int32 yBeg;
+            md_int32 yEnd;
+            md_result result;
 
-    if (pGC->pAPI->procs.gcSetLineBrush) {
-        pGC->pAPI->procs.gcSetLineBrush(pGC, pBrush);
+            md_gc_get_tile_rows__software(pGC, iTile, &yBeg, &yEnd);
+
+            result = onTile(pUserData, &pGC->software.rasterizer, iTile, yBeg, yEnd);
+            if (result != MD_SUCCESS) {
+                return result;
+            }
+        }
+
+        return MD_SUCCESS;
     }
-}
 
-void md_gc_set_line_brush_solid(md_gc* pGC, md_color color)
-{
-    if (pGC == NULL) {
-        return;
+    job.onTile    = onTile;
+    job.pUserData = pUserData;
+    job.tileEnd   = tileEnd;
+    job.result    = MD_SUCCESS;
+
+    pGC->software.pTileJob = &job;
+    pGC->software.nextTile = tileBeg;
+
+    for (iWorker = 0; iWorker < workerCount; ++iWorker) {
+        md_semaphore_release(&pGC->software.workSemaphore);
     }
 
-    MD_ASSERT(pGC->pAPI != NULL);
+    md_gc_run_tile_job__software(pGC, &job, &pGC->software.rasterizer);
 
-    if (pGC->pAPI->procs.gcSetLineBrushSolid) {
-        pGC->pAPI->procs.gcSetLineBrushSolid(pGC, color);
+    for (iWorker = 0; iWorker < workerCount; ++iWorker) {
+        md_semaphore_wait(&pGC->software.doneSemaphore);
     }
+
+    pGC->software.pTileJob = NULL;
+
+    return job.result;
 }
 
-void md_gc_set_line_brush_gc(md_gc* pGC, md_gc* pSrcGC)
+static md_thread_result MD_THREADCALL md_worker_entry__software(void* pData)
 {
-    if (pGC == NULL) {
-        return;
-    }
+    md_worker_software* pWorker = (md_worker_software*)pData;
+    md_gc* pGC = pWorker->pGC;
 
-    MD_ASSERT(pGC->pAPI != NULL);
+    for (;;) {
+        md_semaphore_wait(&pGC->software.workSemaphore);
 
-    if (pGC->pAPI->procs.gcSetLineBrushGC) {
-        pGC->pAPI->procs.gcSetLineBrushGC(pGC, pSrcGC);
+        if (pGC->software.isTerminating) {
+            break;
+        }
+
+        md_gc_run_tile_job__software(pGC, (md_tile_job_software*)pGC->software.pTileJob, &pWorker->rasterizer);
+        md_semaphore_release(&pGC->software.doneSemaphore);
     }
+
+    return (md_thread_result)0;
 }
 
-void md_gc_set_fill_brush(md_gc* pGC, md_brush* pBrush)
+MD_PRIVATE void md_gc_uninit_workers__software(md_gc* pGC)
 {
-    if (pGC == NULL) {
+    md_uint32 iWorker;
+
+    if (pGC->software.pWorkers == NULL) {
         return;
     }
 
-    MD_ASSERT(pGC->pAPI != NULL);
+    pGC->software.isTerminating = MD_TRUE;
+    for (iWorker = 0; iWorker < pGC->software.workerCount; ++iWorker) {
+        md_semaphore_release(&pGC->software.workSemaphore);
+    }
 
-    if (pGC->pAPI->procs.gcSetFillBrush) {
-        pGC->pAPI->procs.gcSetFillBrush(pGC, pBrush);
+    for (iWorker = 0; iWorker < pGC->software.workerCount; ++iWorker) {
+        md_thread_wait(&pGC->software.pWorkers[iWorker].thread);
+        md_rasterizer_uninit__software(&pGC->software.pWorkers[iWorker].rasterizer);
     }
+
+    MD_FREE(pGC->software.pWorkers);
+    pGC->software.pWorkers    = NULL;
+    pGC->software.workerCount = 0;
+
+    md_semaphore_uninit(&pGC->software.doneSemaphore);
+    md_semaphore_uninit(&pGC->software.workSemaphore);
+    md_mutex_uninit(&pGC->software.tileLock);
 }
 
-void md_gc_set_fill_brush_solid(md_gc* pGC, md_color color)
+MD_PRIVATE md_result md_gc_init_workers__software(md_gc* pGC, md_uint32 threadCount)
 {
-    if (pGC == NULL) {
-        return;
+    md_result result;
+    md_uint32 iWorker;
+
+    if (threadCount <= 1) {
+        return MD_SUCCESS;  /* Everything is rendered on the calling thread. */
     }
 
-    MD_ASSERT(pGC->pAPI != NULL);
+    result = md_mutex_init(&pGC->software.tileLock);
+    if (result != MD_SUCCESS) {
+        return result;
+    }
 
-    if (pGC->pAPI->procs.gcSetFillBrushSolid) {
-        pGC->pAPI->procs.gcSetFillBrushSolid(pGC, color);
+    result = md_semaphore_init(&pGC->software.workSemaphore, 0);
+    if (result != MD_SUCCESS) {
+        md_mutex_uninit(&pGC->software.tileLock);
+        return result;
     }
-}
 
-void md_gc_set_fill_brush_gc(md_gc* pGC, md_gc* pSrcGC)
-{
-    if (pGC == NULL) {
-        return;
+    result = md_semaphore_init(&pGC->software.doneSemaphore, 0);
+    if (result != MD_SUCCESS) {
+        md_semaphore_uninit(&pGC->software.workSemaphore);
+        md_mutex_uninit(&pGC->software.tileLock);
+        return result;
     }
 
-    MD_ASSERT(pGC->pAPI != NULL);
+    pGC->software.pWorkers = (md_worker_software*)MD_CALLOC(threadCount - 1, sizeof(*pGC->software.pWorkers));
+    if (pGC->software.pWorkers == NULL) {
+        md_semaphore_uninit(&pGC->software.doneSemaphore);
+        md_semaphore_uninit(&pGC->software.workSemaphore);
+        md_mutex_uninit(&pGC->software.tileLock);
+        return MD_OUT_OF_MEMORY;
+    }
 
-    if (pGC->pAPI->procs.gcSetFillBrushGC) {
-        pGC->pAPI->procs.gcSetFillBrushGC(pGC, pSrcGC);
+    /* workerCount is only incremented once a worker is fully up and running so that an error here can be cleaned up with md_gc_uninit_workers__software(). */
+    pGC->software.workerCount   = 0;
+    pGC->software.isTerminating = MD_FALSE;
+
+    for (iWorker = 0; iWorker < threadCount - 1; ++iWorker) {
+        md_worker_software* pWorker = &pGC->software.pWorkers[iWorker];
+        pWorker->pGC = pGC;
+
+        result = md_rasterizer_init__software(pGC->software.sizeX, &pWorker->rasterizer);
+        if (result != MD_SUCCESS) {
+            md_gc_uninit_workers__software(pGC);
+            return result;
+        }
+
+        result = md_thread_create(&pWorker->thread, md_worker_entry__software, pWorker);
+        if (result != MD_SUCCESS) {
+            md_rasterizer_uninit__software(&pWorker->rasterizer);
+            md_gc_uninit_workers__software(pGC);
+            return result;
+        }
+
+        pGC->software.workerCount += 1;
     }
+
+    return MD_SUCCESS;
 }
 
-void md_gc_set_text_fg_color(md_gc* pGC, md_color fgColor)
+/* Gets the range of tiles touched by the part of an edge within the rows in [yBeg, yEnd). Returns false if the edge does not touch any of those rows. */
+static MD_INLINE md_bool32 md_gc_get_edge_tiles__software(md_gc* pGC, const md_edge_software* pEdge, md_int32 yBeg, md_int32 yEnd, md_uint32* pTileBeg, md_uint32* pTileEnd)
 {
-    if (pGC == NULL) {
-        return;
+    md_int32 rowBeg = (md_int32)MD_MAX((float)yBeg, (float)floor(pEdge->y0));
+    md_int32 rowEnd = (md_int32)MD_MIN((float)yEnd, (float)ceil(pEdge->y1));
+
+    if (rowEnd <= rowBeg) {
+        return MD_FALSE;
     }
 
-    MD_ASSERT(pGC->pAPI != NULL);
+    *pTileBeg = (md_uint32)rowBeg       / pGC->software.tileSize;
+    *pTileEnd = (md_uint32)(rowEnd - 1) / pGC->software.tileSize + 1;
 
-    if (pGC->pAPI->procs.gcSetTextFGColor) {
-        pGC->pAPI->procs.gcSetTextFGColor(pGC, fgColor);
-    }
+    return MD_TRUE;
 }
 
-void md_gc_set_text_bg_color(md_gc* pGC, md_color bgColor)
-{
-    if (pGC == NULL) {
-        return;
+/*
+Sorts the edges into a list for each tile in [tileBeg, tileEnd), which must cover the rows in [yBeg, yEnd). An edge spanning several tiles is added to each
+of them. The edges of each tile stay in the same relative order as pEdges. Use md_gc_get_tile_edges__software() to retrieve the list for a tile.
+*/
+MD_PRIVATE md_result md_gc_bin_edges__software(md_gc* pGC, md_uint32 edgeCount, md_int32 yBeg, md_int32 yEnd, md_uint32 tileBeg, md_uint32 tileEnd)
+{
+    md_uint32 tileCount = tileEnd - tileBeg;
+    md_uint32 binnedCount = 0;
+    md_uint32 binCap;
+    md_uint32* pOffsets;
+    md_uint32* pCursors;
+    md_uint32* pIndices;
+    md_uint32 iEdge;
+    md_uint32 iTile;
+
+    for (iEdge = 0; iEdge < edgeCount; ++iEdge) {
+        md_uint32 edgeTileBeg;
+        md_uint32 edgeTileEnd;
+        if (md_gc_get_edge_tiles__software(pGC, &pGC->software.pEdges[iEdge], yBeg, yEnd, &edgeTileBeg, &edgeTileEnd)) {
+            binnedCount += edgeTileEnd - edgeTileBeg;
+        }
     }
 
-    MD_ASSERT(pGC->pAPI != NULL);
+    binCap = (tileCount + 1) + tileCount + binnedCount;
+    if (binCap > pGC->software.tileBinCap) {
+        md_uint32 newCap = MD_MAX(binCap, pGC->software.tileBinCap * 2);
+        md_uint32* pNewBins = (md_uint32*)MD_REALLOC(pGC->software.pTileBins, newCap * sizeof(*pNewBins));
+        if (pNewBins == NULL) {
+            return MD_OUT_OF_MEMORY;
+        }
 
-    if (pGC->pAPI->procs.gcSetTextBGColor) {
-        pGC->pAPI->procs.gcSetTextBGColor(pGC, bgColor);
+        pGC->software.pTileBins  = pNewBins;
+        pGC->software.tileBinCap = newCap;
     }
-}
 
-md_color md_gc_get_text_fg_color(md_gc* pGC)
-{
-    if (pGC != NULL) {
-        MD_ASSERT(pGC->pAPI != NULL);
+    pOffsets = pGC->software.pTileBins;
+    pCursors = pOffsets + tileCount + 1;
+    pIndices = pCursors + tileCount;
 
-        if (pGC->pAPI->procs.gcGetTextFGColor) {
-            return pGC->pAPI->procs.gcGetTextFGColor(pGC);
+    MD_ZERO_MEMORY(pOffsets, (tileCount + 1) * sizeof(*pOffsets));
+    for (iEdge = 0; iEdge < edgeCount; ++iEdge) {
+        md_uint32 edgeTileBeg;
+        md_uint32 edgeTileEnd;
+        if (md_gc_get_edge_tiles__software(pGC, &pGC->software.pEdges[iEdge], yBeg, yEnd, &edgeTileBeg, &edgeTileEnd)) {
+            for (iTile = edgeTileBeg; iTile < edgeTileEnd; ++iTile) {
+                pOffsets[iTile - tileBeg + 1] += 1;
+            }
         }
     }
 
-    return md_rgba(0, 0, 0, 255);
-}
-
-md_color md_gc_get_text_bg_color(md_gc* pGC)
-{
-    if (pGC != NULL) {
-        MD_ASSERT(pGC->pAPI != NULL);
+    for (iTile = 0; iTile < tileCount; ++iTile) {
+        pOffsets[iTile + 1] += pOffsets[iTile];
+        pCursors[iTile]      = pOffsets[iTile];
+    }
 
-        if (pGC->pAPI->procs.gcGetTextBGColor) {
-            return pGC->pAPI->procs.gcGetTextBGColor(pGC);
+    for (iEdge = 0; iEdge < edgeCount; ++iEdge) {
+        md_uint32 edgeTileBeg;
+        md_uint32 edgeTileEnd;
+        if (md_gc_get_edge_tiles__software(pGC, &pGC->software.pEdges[iEdge], yBeg, yEnd, &edgeTileBeg, &edgeTileEnd)) {
+            for (iTile = edgeTileBeg; iTile < edgeTileEnd; ++iTile) {
+                pIndices[pCursors[iTile - tileBeg]] = iEdge;
+                pCursors[iTile - tileBeg] += 1;
+            }
         }
     }
 
-    return md_rgba(0, 0, 0, 0);
+    return MD_SUCCESS;
 }
 
-void md_gc_set_blend_op(md_gc* pGC, md_blend_op op)
+static MD_INLINE const md_uint32* md_gc_get_tile_edges__software(md_gc* pGC, md_uint32 tileCount, md_uint32 iBin, md_uint32* pEdgeCount)
 {
-    if (pGC == NULL) {
-        return;
-    }
-
-    MD_ASSERT(pGC->pAPI != NULL);
+    const md_uint32* pOffsets = pGC->software.pTileBins;
+    const md_uint32* pIndices = pOffsets + (tileCount + 1) + tileCount;
 
-    if (pGC->pAPI->procs.gcSetBlendOp) {
-        pGC->pAPI->procs.gcSetBlendOp(pGC, op);
-    }
+    *pEdgeCount = pOffsets[iBin + 1] - pOffsets[iBin];
+    return pIndices + pOffsets[iBin];
 }
 
-void md_gc_set_antialias_mode(md_gc* pGC, md_antialias_mode mode)
+typedef struct
 {
-    if (pGC == NULL) {
-        return;
-    }
+    md_gc* pGC;
+    md_uint32 tileBeg;
+    md_uint32 tileCount;
+    md_fill_mode fillMode;
+    md_antialias_mode antialiasMode;
+    md_span_proc_software onSpan;
+    void* pUserData;
+} md_rasterize_tile_data_software;
 
-    MD_ASSERT(pGC->pAPI != NULL);
+MD_PRIVATE md_result md_rasterize_tile__software(void* pUserData, md_rasterizer_software* pRasterizer, md_uint32 iTile, md_int32 yBeg, md_int32 yEnd)
+{
+    md_rasterize_tile_data_software* pData = (md_rasterize_tile_data_software*)pUserData;
+    const md_uint32* pEdgeIndices;
+    md_uint32 edgeCount;
 
-    if (pGC->pAPI->procs.gcSetAntialiasMode) {
-        pGC->pAPI->procs.gcSetAntialiasMode(pGC, mode);
-    }
+    pEdgeIndices = md_gc_get_tile_edges__software(pData->pGC, pData->tileCount, iTile - pData->tileBeg, &edgeCount);
+    return md_rasterize_edges__software(pData->pGC, pRasterizer, pEdgeIndices, edgeCount, yBeg, yEnd, pData->fillMode, pData->antialiasMode, pData->onSpan, pData->pUserData);
 }
 
-void md_gc_set_fill_mode(md_gc* pGC, md_fill_mode mode)
+/*
+Fills the given polygon, sending each span of covered pixels to onSpan. Spans are always clipped to the bounds of the surface, and to the top and bottom
+of the clip rectangle of the current state. When the GC has worker
+threads the polygon is split into tiles and onSpan will be called from multiple threads at the same time, but never for the same pixel. Set allowThreads
+to false when onSpan is not safe to call like that. The spans within each tile are emitted top to bottom, and left to right within each scanline.
+*/
+MD_PRIVATE md_result md_rasterize_polygon__software(md_gc* pGC, const md_polygon_software* pPolygon, md_fill_mode fillMode, md_antialias_mode antialiasMode, md_bool32 allowThreads, md_span_proc_software onSpan, void* pUserData)
 {
-    if (pGC == NULL) {
-        return;
+    md_result result;
+    md_uint32 edgeCount;
+    md_int32 yBeg;
+    md_int32 yEnd;
+    float minY;
+    float maxY;
+    md_uint32 tileBeg;
+    md_uint32 tileEnd;
+    md_gc_state_software* pState;
+    md_rasterize_tile_data_software data;
+
+    MD_ASSERT(pGC      != NULL);
+    MD_ASSERT(pPolygon != NULL);
+    MD_ASSERT(onSpan   != NULL);
+
+    result = md_build_edges__software(pGC, pPolygon, &edgeCount, &minY, &maxY);
+    if (result != MD_SUCCESS || edgeCount == 0) {
+        return result;
     }
 
-    MD_ASSERT(pGC->pAPI != NULL);
+    /* The aliased rasterizer brings in edges from top to bottom. */
+    if (antialiasMode == md_antialias_mode_none) {
+        qsort(pGC->software.pEdges, edgeCount, sizeof(*pGC->software.pEdges), md_compare_edges__software);
+    }
 
-    if (pGC->pAPI->procs.gcSetFillMode) {
-        pGC->pAPI->procs.gcSetFillMode(pGC, mode);
+    pState = &pGC->software.pState[pGC->software.stateCount-1];
+
+    yBeg = (md_int32)MD_MAX((float)pState->clipTop,    (float)floor(minY));
+    yEnd = (md_int32)MD_MIN((float)pState->clipBottom, (float)ceil(maxY));
+    if (yEnd <= yBeg) {
+        return MD_SUCCESS;
     }
-}
 
-void md_gc_set_stretch_filter(md_gc* pGC, md_stretch_filter filter)
-{
-    if (pGC == NULL) {
-        return;
+    /*
+    Without any worker threads the whole polygon is done in one go. Otherwise it's always split into tiles, even when the tiles end up being processed on
+    the calling thread, so that the output is the same no matter how the work gets distributed.
+    */
+    if (pGC->software.pWorkers == NULL) {
+        return md_rasterize_edges__software(pGC, &pGC->software.rasterizer, NULL, edgeCount, yBeg, yEnd, fillMode, antialiasMode, onSpan, pUserData);
     }
 
-    MD_ASSERT(pGC->pAPI != NULL);
+    tileBeg = (md_uint32)yBeg       / pGC->software.tileSize;
+    tileEnd = (md_uint32)(yEnd - 1) / pGC->software.tileSize + 1;
 
-    if (pGC->pAPI->procs.gcSetStretchFilter) {
-        pGC->pAPI->procs.gcSetStretchFilter(pGC, filter);
+    result = md_gc_bin_edges__software(pGC, edgeCount, yBeg, yEnd, tileBeg, tileEnd);
+    if (result != MD_SUCCESS) {
+        return result;
     }
+
+    data.pGC           = pGC;
+    data.tileBeg       = tileBeg;
+    data.tileCount     = tileEnd - tileBeg;
+    data.fillMode      = fillMode;
+    data.antialiasMode = antialiasMode;
+    data.onSpan        = onSpan;
+    data.pUserData     = pUserData;
+    return md_gc_run_tiles__software(pGC, tileBeg, tileEnd, allowThreads, md_rasterize_tile__software, &data);
 }
 
-void md_gc_move_to(md_gc* pGC, md_int32 x, md_int32 y)
-{
-    if (pGC == NULL) {
-        return;
-    }
 
-    MD_ASSERT(pGC->pAPI != NULL);
+/* Compositing */
+typedef struct
+{
+    md_brush_type type;
+    md_blend_op blendOp;
+    md_uint32 color;            /* Premultiplied ARGB. Solid brushes only. */
+    md_gc* pSrcGC;              /* GC brushes only. */
+    md_matrix toPattern;        /* Transforms a device-space position to a position in pSrcGC. GC brushes only. */
+    md_stretch_filter filter;
+    md_int32 offsetX;           /* When isIntegerOffset is true, toPattern is a whole pixel translation by these amounts. */
+    md_int32 offsetY;
+    const md_uint32* pRamp;     /* Gradient brushes only. toPattern transforms device space to the user space the gradient was defined in. */
+    float linearX;              /* The offset into the ramp of a linear gradient is linearX*u + linearY*v + linearC. */
+    float linearY;
+    float linearC;
+    float radialCX;             /* The center and radius of the start circle of a radial gradient. */
+    float radialCY;
+    float radialR0;
+    float radialDX;             /* The change in center and radius between the start and end circles. */
+    float radialDY;
+    float radialDR;
+    float radialA;              /* The squared term of the quadratic solved for each pixel. Constant for the whole gradient. */
+    md_bool32 isIntegerOffset : 1;  /* When true, source pixels can be read straight out of pSrcGC without sampling. */
+} md_paint_software;
 
-    if (pGC->pAPI->procs.gcMoveTo) {
-        pGC->pAPI->procs.gcMoveTo(pGC, x, y);
-    }
-}
+typedef struct
+{
+    md_gc* pGC;
+    const md_paint_software* pPaint;
+} md_paint_span_data_software;
 
-void md_gc_line_to(md_gc* pGC, md_int32 x, md_int32 y)
+MD_PRIVATE md_bool32 md_paint_init__software(md_gc* pGC, const md_brush_config* pConfig, const md_uint32* pRamp, md_int32 originX, md_int32 originY, md_paint_software* pPaint)
 {
-    if (pGC == NULL) {
-        return;
+    md_gc_state_software* pState;
+
+    MD_ASSERT(pGC    != NULL);
+    MD_ASSERT(pPaint != NULL);
+
+    if (pConfig == NULL) {
+        return MD_FALSE;    /* No brush has been set. */
     }
 
-    MD_ASSERT(pGC->pAPI != NULL);
+    pState = &pGC->software.pState[pGC->software.stateCount-1];
 
-    if (pGC->pAPI->procs.gcLineTo) {
-        pGC->pAPI->procs.gcLineTo(pGC, x, y);
+    MD_ZERO_OBJECT(pPaint);
+    pPaint->type    = pConfig->type;
+    pPaint->blendOp = pState->blendOp;
+    pPaint->filter  = pState->stretchFilter;
+
+    switch (pConfig->type)
+    {
+        case md_brush_type_solid:
+        {
+            pPaint->color = md_color_to_argb__software(pConfig->solid.color);
+        } break;
+
+        case md_brush_type_gc:
+        {
+            md_matrix origin;
+
+            if (pConfig->gc.pGC == NULL || pConfig->gc.pGC->software.pImageData == NULL) {
+                return MD_FALSE;
+            }
+
+            /* The pattern is anchored in user space, so it moves with the current matrix. The origin works like the translation of a Cairo pattern matrix. */
+            if (!md_matrix_invert__software(&pPaint->toPattern, &pState->matrix)) {
+                return MD_FALSE;
+            }
+
+            md_matrix_init_identity__software(&origin);
+            origin.dx = (float)originX;
+            origin.dy = (float)originY;
+            md_matrix_multiply__software(&pPaint->toPattern, &origin, &pPaint->toPattern);
+
+            pPaint->pSrcGC = pConfig->gc.pGC;
+
+            /* The common case of drawing a GC without any scaling or rotation can be done without per-pixel sampling. This is the same for both filters. */
+            if (pPaint->toPattern.m00 == 1 && pPaint->toPattern.m01 == 0 && pPaint->toPattern.m10 == 0 && pPaint->toPattern.m11 == 1 &&
+                pPaint->toPattern.dx == (float)floor(pPaint->toPattern.dx) && pPaint->toPattern.dy == (float)floor(pPaint->toPattern.dy) &&
+                fabs(pPaint->toPattern.dx) < 1048576 && fabs(pPaint->toPattern.dy) < 1048576) {
+                pPaint->offsetX = (md_int32)pPaint->toPattern.dx;
+                pPaint->offsetY = (md_int32)pPaint->toPattern.dy;
+                pPaint->isIntegerOffset = MD_TRUE;
+            }
+        } break;
+
+        case md_brush_type_linear:
+        case md_brush_type_radial:
+        {
+            md_matrix origin;
+
+            if (pRamp == NULL) {
+                return MD_FALSE;    /* Gradients are only supported with md_brush objects since that's where the ramp lives. */
+            }
+
+            /* The gradient is defined in user space. The origin works the same way as it does for GC brushes. */
+            if (!md_matrix_invert__software(&pPaint->toPattern, &pState->matrix)) {
+                return MD_FALSE;
+            }
+
+            md_matrix_init_identity__software(&origin);
+            origin.dx = (float)originX;
+            origin.dy = (float)originY;
+            md_matrix_multiply__software(&pPaint->toPattern, &origin, &pPaint->toPattern);
+
+            pPaint->pRamp = pRamp;
+
+            if (pConfig->type == md_brush_type_linear) {
+                float dx  = (float)(pConfig->linear.x1 - pConfig->linear.x0);
+                float dy  = (float)(pConfig->linear.y1 - pConfig->linear.y0);
+                float len = dx*dx + dy*dy;
+
+                if (len > 0) {
+                    pPaint->linearX = dx / len;
+                    pPaint->linearY = dy / len;
+                    pPaint->linearC = -(pConfig->linear.x0*pPaint->linearX + pConfig->linear.y0*pPaint->linearY);
+                } else {
+                    pPaint->linearC = 1;    /* The start and end points are the same. Everything takes the color of the last stop. */
+                }
+            } else {
+                pPaint->radialCX = (float)pConfig->radial.cx0;
+                pPaint->radialCY = (float)pConfig->radial.cy0;
+                pPaint->radialR0 = (float)pConfig->radial.radius0;
+                pPaint->radialDX = (float)(pConfig->radial.cx1     - pConfig->radial.cx0);
+                pPaint->radialDY = (float)(pConfig->radial.cy1     - pConfig->radial.cy0);
+                pPaint->radialDR = (float)(pConfig->radial.radius1 - pConfig->radial.radius0);
+                pPaint->radialA  = pPaint->radialDX*pPaint->radialDX + pPaint->radialDY*pPaint->radialDY - pPaint->radialDR*pPaint->radialDR;
+            }
+        } break;
+
+        default:
+        {
+            return MD_FALSE;
+        };
     }
+
+    return MD_TRUE;
 }
 
-void md_gc_rectangle(md_gc* pGC, md_int32 left, md_int32 top, md_int32 right, md_int32 bottom)
+static MD_INLINE md_uint32 md_gc_get_pixel__software(md_gc* pGC, md_int32 x, md_int32 y)
 {
-    if (pGC == NULL) {
-        return;
+    if (x < 0 || y < 0 || x >= (md_int32)pGC->software.sizeX || y >= (md_int32)pGC->software.sizeY) {
+        return 0;   /* Transparent outside of the bounds of the surface. */
     }
 
-    MD_ASSERT(pGC->pAPI != NULL);
-
-    if (pGC->pAPI->procs.gcRectangle) {
-        pGC->pAPI->procs.gcRectangle(pGC, left, top, right, bottom);
-    }
+    return pGC->software.pImageData[y*pGC->software.stride + x];
 }
 
-void md_gc_arc(md_gc* pGC, md_int32 x, md_int32 y, md_int32 radius, float angle1InRadians, float angle2InRadians)
+MD_PRIVATE md_uint32 md_paint_sample__software(const md_paint_software* pPaint, md_int32 x, md_int32 y)
 {
-    if (pGC == NULL) {
-        return;
+    float u;
+    float v;
+
+    if (pPaint->type == md_brush_type_solid) {
+        return pPaint->color;
     }
 
-    MD_ASSERT(pGC->pAPI != NULL);
+    md_matrix_transform_point__software(&pPaint->toPattern, x + 0.5f, y + 0.5f, &u, &v);
 
-    if (pGC->pAPI->procs.gcArc) {
-        pGC->pAPI->procs.gcArc(pGC, x, y, radius, angle1InRadians, angle2InRadians);
+    if (pPaint->filter == md_stretch_filter_linear) {
+        md_int32 u0;
+        md_int32 v0;
+        md_uint32 fu;
+        md_uint32 fv;
+        md_uint32 p00, p10, p01, p11;
+        md_uint32 top;
+        md_uint32 bot;
+
+        u -= 0.5f;
+        v -= 0.5f;
+        u0 = (md_int32)floor(u);
+        v0 = (md_int32)floor(v);
+        fu = (md_uint32)((u - u0) * 255);
+        fv = (md_uint32)((v - v0) * 255);
+
+        p00 = md_gc_get_pixel__software(pPaint->pSrcGC, u0,   v0  );
+        p10 = md_gc_get_pixel__software(pPaint->pSrcGC, u0+1, v0  );
+        p01 = md_gc_get_pixel__software(pPaint->pSrcGC, u0,   v0+1);
+        p11 = md_gc_get_pixel__software(pPaint->pSrcGC, u0+1, v0+1);
+
+        top = md_scale_argb__software(p00, 255 - fu) + md_scale_argb__software(p10, fu);
+        bot = md_scale_argb__software(p01, 255 - fu) + md_scale_argb__software(p11, fu);
+        return md_scale_argb__software(top, 255 - fv) + md_scale_argb__software(bot, fv);
+    } else {
+        return md_gc_get_pixel__software(pPaint->pSrcGC, (md_int32)floor(u), (md_int32)floor(v));
     }
 }
 
-void md_gc_curve_to(md_gc* pGC, md_int32 x1, md_int32 y1, md_int32 x2, md_int32 y2, md_int32 x3, md_int32 y3)
+/* Gradients */
+MD_PRIVATE md_uint32* md_gradient_ramp_alloc__software(const md_color_stop* pStops, md_uint32 stopCount)
 {
-    if (pGC == NULL) {
-        return;
+    md_uint32* pRamp;
+    md_uint32 iColor;
+    md_uint32 iStop = 0;
+
+    pRamp = (md_uint32*)MD_MALLOC(sizeof(*pRamp) * (MD_SOFTWARE_GRADIENT_RAMP_SIZE + 1));
+    if (pRamp == NULL) {
+        return NULL;
     }
 
-    MD_ASSERT(pGC->pAPI != NULL);
+    /* Colors are interpolated before being premultiplied, the same as pixman. With no stops the gradient is fully transparent, the same as Cairo. */
+    for (iColor = 0; iColor < MD_SOFTWARE_GRADIENT_RAMP_SIZE; ++iColor) {
+        float t = (float)iColor / (MD_SOFTWARE_GRADIENT_RAMP_SIZE - 1);
+        md_color color;
 
-    if (pGC->pAPI->procs.gcCurveTo) {
-        pGC->pAPI->procs.gcCurveTo(pGC, x1, y1, x2, y2, x3, y3);
+        if (stopCount == 0) {
+            pRamp[iColor] = 0;
+            continue;
+        }
+
+        while (iStop < stopCount && pStops[iStop].offset < t) {
+            iStop += 1;
+        }
+
+        if (iStop == 0) {
+            color = pStops[0].color;
+        } else if (iStop == stopCount) {
+            color = pStops[stopCount-1].color;
+        } else {
+            const md_color_stop* pStop0 = &pStops[iStop-1];
+            const md_color_stop* pStop1 = &pStops[iStop];
+            float f = (pStop1->offset > pStop0->offset) ? (t - pStop0->offset) / (pStop1->offset - pStop0->offset) : 1;
+
+            color.r = (md_uint8)(pStop0->color.r + (pStop1->color.r - pStop0->color.r)*f + 0.5f);
+            color.g = (md_uint8)(pStop0->color.g + (pStop1->color.g - pStop0->color.g)*f + 0.5f);
+            color.b = (md_uint8)(pStop0->color.b + (pStop1->color.b - pStop0->color.b)*f + 0.5f);
+            color.a = (md_uint8)(pStop0->color.a + (pStop1->color.a - pStop0->color.a)*f + 0.5f);
+        }
+
+        pRamp[iColor] = md_color_to_argb__software(color);
     }
+
+    /* Pixels that fall outside of a radial gradient index the entry past the end of the ramp. */
+    pRamp[MD_SOFTWARE_GRADIENT_RAMP_SIZE] = 0;
+
+    return pRamp;
 }
 
-void md_gc_close_path(md_gc* pGC)
+static MD_INLINE md_int32 md_gradient_ramp_index__software(float t)
 {
-    if (pGC == NULL) {
-        return;
-    }
+    t = (t > 0) ? t : 0;    /* Written this way so NaN maps to 0, the same as the SIMD path. */
+    t = (t < 1) ? t : 1;
+    return (md_int32)(t*(MD_SOFTWARE_GRADIENT_RAMP_SIZE - 1) + 0.5f);
+}
 
-    MD_ASSERT(pGC->pAPI != NULL);
+/*
+The gradient span functions fill pixels [iBeg, count) of pDst. The SIMD versions use the scalar ones for the last few pixels which is why they take iBeg
+rather than an offset pointer. This keeps the results identical to doing the whole span with the scalar version.
+*/
+MD_PRIVATE void md_gradient_span_linear_scalar__software(const md_paint_software* pPaint, float t0, float dt, md_uint32* pDst, md_int32 iBeg, md_int32 count)
+{
+    md_int32 i;
 
-    if (pGC->pAPI->procs.gcClosePath) {
-        pGC->pAPI->procs.gcClosePath(pGC);
+    for (i = iBeg; i < count; ++i) {
+        pDst[i] = pPaint->pRamp[md_gradient_ramp_index__software(t0 + (float)i*dt)];
     }
 }
 
-void md_gc_rectangle_border_inner(md_gc* pGC, md_int32 left, md_int32 top, md_int32 right, md_int32 bottom, md_int32 borderWidth)
+MD_PRIVATE void md_gradient_span_radial_scalar__software(const md_paint_software* pPaint, float px0, float py0, float du, float dv, md_uint32* pDst, md_int32 iBeg, md_int32 count)
 {
+    float r0dr  = pPaint->radialR0 * pPaint->radialDR;
+    float r0sq  = pPaint->radialR0 * pPaint->radialR0;
+    float invA  = 1 / pPaint->radialA;
+    md_int32 i;
+
+    MD_ASSERT(pPaint->radialA != 0);
+
     /*
-    There's two ways to do this. We can define the path as 4 rectangles (one for each side of the border) or we can define it as an outer
-    path and an inner path. The advantage of the former is that it works will both types of fill modes whereas the later will only work with
-    even-odd filling. For this reason I am using the former option as it should Just Work in more configurations.
+    Same as Cairo, the color of a pixel comes from the largest t for which the pixel lies on the circle interpolated between the start and end circles
+    with a radius that is not negative. This is a quadratic in t. Pixels without a solution are transparent.
     */
+    for (i = iBeg; i < count; ++i) {
+        float px = px0 + (float)i*du;
+        float py = py0 + (float)i*dv;
+        float b  = px*pPaint->radialDX + py*pPaint->radialDY + r0dr;
+        float c  = px*px + py*py - r0sq;
+        float d  = b*b - pPaint->radialA*c;
+        float s;
+        float t1;
+        float t2;
+
+        if (d < 0) {
+            pDst[i] = pPaint->pRamp[MD_SOFTWARE_GRADIENT_RAMP_SIZE];
+            continue;
+        }
 
-    /* 4-Rectangles Version. Make sure there is no overlap between the pieces. */
-    md_gc_rectangle(pGC, left,                top,                  left  + borderWidth, bottom);               /* Left */
-    md_gc_rectangle(pGC, right - borderWidth, top,                  right,               bottom);               /* Right */
-    md_gc_rectangle(pGC, left  + borderWidth, top,                  right - borderWidth, top + borderWidth);    /* Top */
-    md_gc_rectangle(pGC, left  + borderWidth, bottom - borderWidth, right - borderWidth, bottom);               /* Bottom */
-
-    /* Outer / Inner Version. */
-#if 0
-    /* Outer */
-    md_gc_move_to(pGC, left, top);
-    md_gc_line_to(pGC, left, bottom);
-    md_gc_line_to(pGC, right, bottom);
-    md_gc_line_to(pGC, right, top);
-    md_gc_line_to(pGC, left, top);
+        s  = (float)sqrt(d);
+        t1 = (b + s)*invA;
+        t2 = (b - s)*invA;
+        if (t1 < t2) {
+            float temp = t1;
+            t1 = t2;
+            t2 = temp;
+        }
 
-    /* Inner */
-    left   += borderWidth;
-    top    += borderWidth;
-    right  -= borderWidth;
-    bottom -= borderWidth;
-    if (left < right && top < bottom) {
-        md_gc_move_to(pGC, left, top);
-        md_gc_line_to(pGC, left, bottom);
-        md_gc_line_to(pGC, right, bottom);
-        md_gc_line_to(pGC, right, top);
-        md_gc_line_to(pGC, left, top);
+        if (pPaint->radialR0 + t1*pPaint->radialDR >= 0) {
+            pDst[i] = pPaint->pRamp[md_gradient_ramp_index__software(t1)];
+        } else if (pPaint->radialR0 + t2*pPaint->radialDR >= 0) {
+            pDst[i] = pPaint->pRamp[md_gradient_ramp_index__software(t2)];
+        } else {
+            pDst[i] = pPaint->pRamp[MD_SOFTWARE_GRADIENT_RAMP_SIZE];
+        }
     }
-#endif
 }
 
-void md_gc_rectangle_border_outer(md_gc* pGC, md_int32 left, md_int32 top, md_int32 right, md_int32 bottom, md_int32 borderWidth)
+#if defined(MD_SUPPORT_SSE2)
+static MD_INLINE __m128i md_gradient_ramp_index__sse2(__m128 t)
 {
-    md_gc_rectangle(pGC, left - borderWidth, top - borderWidth, left,                bottom + borderWidth); /* Left */
-    md_gc_rectangle(pGC, right,              top - borderWidth, right + borderWidth, bottom + borderWidth); /* Right */
-    md_gc_rectangle(pGC, left,               top - borderWidth, right,               top);                  /* Top */
-    md_gc_rectangle(pGC, left,               bottom,            right,               bottom + borderWidth); /* Bottom */
+    t = _mm_min_ps(_mm_max_ps(t, _mm_setzero_ps()), _mm_set1_ps(1));
+    return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(t, _mm_set1_ps(MD_SOFTWARE_GRADIENT_RAMP_SIZE - 1)), _mm_set1_ps(0.5f)));
 }
 
-void md_gc_clip(md_gc* pGC)
+MD_PRIVATE void md_gradient_span_linear_sse2__software(const md_paint_software* pPaint, float t0, float dt, md_uint32* pDst, md_int32 count)
 {
-    if (pGC == NULL) {
-        return;
-    }
+    __m128 step = _mm_setr_ps(0, 1, 2, 3);
+    md_int32 indices[4];
+    md_int32 i;
 
-    MD_ASSERT(pGC->pAPI != NULL);
+    /* The offsets are done four at a time. There's no gather in SSE2 so the ramp lookups are done one at a time. */
+    for (i = 0; i + 4 <= count; i += 4) {
+        __m128 fi = _mm_add_ps(_mm_set1_ps((float)i), step);
+        _mm_storeu_si128((__m128i*)indices, md_gradient_ramp_index__sse2(_mm_add_ps(_mm_set1_ps(t0), _mm_mul_ps(fi, _mm_set1_ps(dt)))));
 
-    if (pGC->pAPI->procs.gcClip) {
-        pGC->pAPI->procs.gcClip(pGC);
+        pDst[i+0] = pPaint->pRamp[indices[0]];
+        pDst[i+1] = pPaint->pRamp[indices[1]];
+        pDst[i+2] = pPaint->pRamp[indices[2]];
+        pDst[i+3] = pPaint->pRamp[indices[3]];
     }
+
+    md_gradient_span_linear_scalar__software(pPaint, t0, dt, pDst, i, count);
 }
 
-void md_gc_reset_clip(md_gc* pGC)
+MD_PRIVATE void md_gradient_span_radial_sse2__software(const md_paint_software* pPaint, float px0, float py0, float du, float dv, md_uint32* pDst, md_int32 count)
 {
-    if (pGC == NULL) {
-        return;
-    }
+    __m128 step = _mm_setr_ps(0, 1, 2, 3);
+    __m128 zero = _mm_setzero_ps();
+    __m128 a    = _mm_set1_ps(pPaint->radialA);
+    __m128 invA = _mm_set1_ps(1 / pPaint->radialA);
+    __m128 cdx  = _mm_set1_ps(pPaint->radialDX);
+    __m128 cdy  = _mm_set1_ps(pPaint->radialDY);
+    __m128 r0   = _mm_set1_ps(pPaint->radialR0);
+    __m128 dr   = _mm_set1_ps(pPaint->radialDR);
+    __m128 r0dr = _mm_set1_ps(pPaint->radialR0 * pPaint->radialDR);
+    __m128 r0sq = _mm_set1_ps(pPaint->radialR0 * pPaint->radialR0);
+    __m128i outside = _mm_set1_epi32(MD_SOFTWARE_GRADIENT_RAMP_SIZE);
+    md_int32 indices[4];
+    md_int32 i;
 
-    MD_ASSERT(pGC->pAPI != NULL);
+    MD_ASSERT(pPaint->radialA != 0);
 
-    if (pGC->pAPI->procs.gcResetClip) {
-        pGC->pAPI->procs.gcResetClip(pGC);
+    for (i = 0; i + 4 <= count; i += 4) {
+        __m128 fi = _mm_add_ps(_mm_set1_ps((float)i), step);
+        __m128 px = _mm_add_ps(_mm_set1_ps(px0), _mm_mul_ps(fi, _mm_set1_ps(du)));
+        __m128 py = _mm_add_ps(_mm_set1_ps(py0), _mm_mul_ps(fi, _mm_set1_ps(dv)));
+        __m128 b  = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, cdx), _mm_mul_ps(py, cdy)), r0dr);
+        __m128 c  = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(px, px), _mm_mul_ps(py, py)), r0sq);
+        __m128 d  = _mm_sub_ps(_mm_mul_ps(b, b), _mm_mul_ps(a, c));
+        __m128 s  = _mm_sqrt_ps(_mm_max_ps(d, zero));
+        __m128 t1 = _mm_mul_ps(_mm_add_ps(b, s), invA);
+        __m128 t2 = _mm_mul_ps(_mm_sub_ps(b, s), invA);
+        __m128 tBig   = _mm_max_ps(t1, t2);
+        __m128 tSmall = _mm_min_ps(t1, t2);
+        __m128 useBig   = _mm_cmpge_ps(_mm_add_ps(r0, _mm_mul_ps(tBig,   dr)), zero);
+        __m128 useSmall = _mm_cmpge_ps(_mm_add_ps(r0, _mm_mul_ps(tSmall, dr)), zero);
+        __m128 valid    = _mm_and_ps(_mm_cmpge_ps(d, zero), _mm_or_ps(useBig, useSmall));
+        __m128 t        = _mm_or_ps(_mm_and_ps(useBig, tBig), _mm_andnot_ps(useBig, tSmall));
+        __m128i index   = md_gradient_ramp_index__sse2(t);
+
+        index = _mm_or_si128(_mm_and_si128(_mm_castps_si128(valid), index), _mm_andnot_si128(_mm_castps_si128(valid), outside));
+        _mm_storeu_si128((__m128i*)indices, index);
+
+        pDst[i+0] = pPaint->pRamp[indices[0]];
+        pDst[i+1] = pPaint->pRamp[indices[1]];
+        pDst[i+2] = pPaint->pRamp[indices[2]];
+        pDst[i+3] = pPaint->pRamp[indices[3]];
     }
+
+    md_gradient_span_radial_scalar__software(pPaint, px0, py0, du, dv, pDst, i, count);
 }
+#endif
 
-md_bool32 md_gc_is_point_inside_clip(md_gc* pGC, md_int32 x, md_int32 y)
+MD_PRIVATE void md_paint_fetch_gradient_span__software(md_gc* pGC, const md_paint_software* pPaint, md_int32 x, md_int32 y, md_int32 count, md_uint32* pDst)
 {
-    if (pGC == NULL) {
-        return MD_FALSE;
-    }
+    float u0;
+    float v0;
+    float du = pPaint->toPattern.m00;   /* The change in pattern space for each step to the right in device space. */
+    float dv = pPaint->toPattern.m01;
 
-    MD_ASSERT(pGC->pAPI != NULL);
+    md_matrix_transform_point__software(&pPaint->toPattern, x + 0.5f, y + 0.5f, &u0, &v0);
 
-    if (pGC->pAPI->procs.gcIsPointInsideClip) {
-        return pGC->pAPI->procs.gcIsPointInsideClip(pGC, x, y);
+    if (pPaint->type == md_brush_type_linear) {
+        float t0 = u0*pPaint->linearX + v0*pPaint->linearY + pPaint->linearC;
+        float dt = du*pPaint->linearX + dv*pPaint->linearY;
+
+    #if defined(MD_SUPPORT_SSE2)
+        if (pGC->pAPI->software.useSSE2) {
+            md_gradient_span_linear_sse2__software(pPaint, t0, dt, pDst, count);
+            return;
+        }
+    #endif
+
+        md_gradient_span_linear_scalar__software(pPaint, t0, dt, pDst, 0, count);
+    } else {
+        md_int32 i;
+
+        if (pPaint->radialA == 0) {
+            /*
+            The edge of the end circle touches the start circle. The quadratic degenerates to a linear equation. This is rare enough that it's
+            done one pixel at a time without SIMD.
+            */
+            for (i = 0; i < count; ++i) {
+                float px = u0 + (float)i*du - pPaint->radialCX;
+                float py = v0 + (float)i*dv - pPaint->radialCY;
+                float b  = px*pPaint->radialDX + py*pPaint->radialDY + pPaint->radialR0*pPaint->radialDR;
+                float c  = px*px + py*py - pPaint->radialR0*pPaint->radialR0;
+                float t  = (b != 0) ? c / (2*b) : -1;
+
+                if (b != 0 && pPaint->radialR0 + t*pPaint->radialDR >= 0) {
+                    pDst[i] = pPaint->pRamp[md_gradient_ramp_index__software(t)];
+                } else {
+                    pDst[i] = pPaint->pRamp[MD_SOFTWARE_GRADIENT_RAMP_SIZE];
+                }
+            }
+
+            return;
+        }
+
+    #if defined(MD_SUPPORT_SSE2)
+        if (pGC->pAPI->software.useSSE2) {
+            md_gradient_span_radial_sse2__software(pPaint, u0 - pPaint->radialCX, v0 - pPaint->radialCY, du, dv, pDst, count);
+            return;
+        }
+    #endif
+
+        md_gradient_span_radial_scalar__software(pPaint, u0 - pPaint->radialCX, v0 - pPaint->radialCY, du, dv, pDst, 0, count);
     }
 
-    return MD_FALSE;
+    (void)pGC;
 }
 
-void md_gc_fill(md_gc* pGC)
+
+/* Span Compositing */
+/*
+The blending kernels all take the same parameters. pSrc is either an array of source pixels or NULL in which case color is used for every pixel. pMask
+is either an array of coverage values or NULL in which case coverage is used for every pixel. Every kernel produces bit-identical results.
+*/
+MD_PRIVATE void md_blend_span_scalar__software(md_uint32* pDst, const md_uint32* pSrc, md_uint32 color, const md_uint8* pMask, md_uint32 coverage, md_uint32 count, md_blend_op blendOp)
 {
-    if (pGC == NULL) {
-        return;
-    }
+    md_uint32 i;
 
-    MD_ASSERT(pGC->pAPI != NULL);
+    for (i = 0; i < count; ++i) {
+        md_uint32 c = (pMask != NULL) ? pMask[i] : coverage;
+        if (c == 0) {
+            continue;
+        }
 
-    if (pGC->pAPI->procs.gcFill) {
-        pGC->pAPI->procs.gcFill(pGC);
+        pDst[i] = md_blend_pixel__software(pDst[i], (pSrc != NULL) ? pSrc[i] : color, c, blendOp);
     }
 }
 
-void md_gc_stroke(md_gc* pGC)
+#if defined(MD_SUPPORT_SSE2)
+static MD_INLINE __m128i md_mul255_epu16__sse2(__m128i a, __m128i b)
 {
-    if (pGC == NULL) {
-        return;
-    }
+    /* Same rounding as md_mul255__software(). */
+    return _mm_mulhi_epu16(_mm_add_epi16(_mm_mullo_epi16(a, b), _mm_set1_epi16(128)), _mm_set1_epi16(257));
+}
 
-    MD_ASSERT(pGC->pAPI != NULL);
+static MD_INLINE __m128i md_blend_epu16__sse2(__m128i d, __m128i s, __m128i m, md_blend_op blendOp)
+{
+    __m128i x255 = _mm_set1_epi16(255);
 
-    if (pGC->pAPI->procs.gcStroke) {
-        pGC->pAPI->procs.gcStroke(pGC);
+    if (blendOp == md_blend_op_src_over) {
+        __m128i a;
+
+        s = md_mul255_epu16__sse2(s, m);
+        a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+        return _mm_add_epi16(s, md_mul255_epu16__sse2(d, _mm_sub_epi16(x255, a)));
+    } else {
+        return _mm_add_epi16(md_mul255_epu16__sse2(s, m), md_mul255_epu16__sse2(d, _mm_sub_epi16(x255, m)));
     }
 }
 
-void md_gc_fill_and_stroke(md_gc* pGC)
+MD_PRIVATE void md_blend_span_sse2__software(md_uint32* pDst, const md_uint32* pSrc, md_uint32 color, const md_uint8* pMask, md_uint32 coverage, md_uint32 count, md_blend_op blendOp)
 {
-    if (pGC == NULL) {
-        return;
-    }
+    __m128i zero = _mm_setzero_si128();
+    __m128i solid = _mm_unpacklo_epi8(_mm_set1_epi32((int)color), zero);
+    __m128i coverage16 = _mm_set1_epi16((short)coverage);
+    md_uint32 i;
 
-    MD_ASSERT(pGC->pAPI != NULL);
+    /* Four pixels at a time, each channel widened to 16 bits. */
+    for (i = 0; i + 4 <= count; i += 4) {
+        __m128i d;
+        __m128i dLo;
+        __m128i dHi;
+        __m128i sLo;
+        __m128i sHi;
+        __m128i mLo;
+        __m128i mHi;
+
+        if (pMask != NULL) {
+            md_uint32 mask4;
+            __m128i m;
+
+            MD_COPY_MEMORY(&mask4, pMask + i, 4);
+            if (mask4 == 0) {
+                continue;
+            }
 
-    if (pGC->pAPI->procs.gcFillAndStroke) {
-        pGC->pAPI->procs.gcFillAndStroke(pGC);
+            /* Spread the coverage of each pixel across its four channels. */
+            m   = _mm_cvtsi32_si128((int)mask4);
+            m   = _mm_unpacklo_epi8(m, m);
+            m   = _mm_unpacklo_epi16(m, m);
+            mLo = _mm_unpacklo_epi8(m, zero);
+            mHi = _mm_unpackhi_epi8(m, zero);
+        } else {
+            mLo = coverage16;
+            mHi = coverage16;
+        }
+
+        if (pSrc != NULL) {
+            __m128i s = _mm_loadu_si128((const __m128i*)(pSrc + i));
+            sLo = _mm_unpacklo_epi8(s, zero);
+            sHi = _mm_unpackhi_epi8(s, zero);
+        } else {
+            sLo = solid;
+            sHi = solid;
+        }
+
+        d   = _mm_loadu_si128((const __m128i*)(pDst + i));
+        dLo = md_blend_epu16__sse2(_mm_unpacklo_epi8(d, zero), sLo, mLo, blendOp);
+        dHi = md_blend_epu16__sse2(_mm_unpackhi_epi8(d, zero), sHi, mHi, blendOp);
+        _mm_storeu_si128((__m128i*)(pDst + i), _mm_packus_epi16(dLo, dHi));
     }
+
+    md_blend_span_scalar__software(pDst + i, (pSrc != NULL) ? pSrc + i : NULL, color, (pMask != NULL) ? pMask + i : NULL, coverage, count - i, blendOp);
 }
+#endif
 
-void md_gc_draw_gc(md_gc* pGC, md_gc* pSrcGC, md_int32 srcX, md_int32 srcY)
+#if defined(MD_SUPPORT_AVX2)
+static MD_INLINE MD_TARGET_AVX2 __m256i md_mul255_epu16__avx2(__m256i a, __m256i b)
 {
-    if (pGC == NULL) {
-        return;
-    }
+    return _mm256_mulhi_epu16(_mm256_add_epi16(_mm256_mullo_epi16(a, b), _mm256_set1_epi16(128)), _mm256_set1_epi16(257));
+}
 
-    MD_ASSERT(pGC->pAPI != NULL);
+static MD_INLINE MD_TARGET_AVX2 __m256i md_blend_epu16__avx2(__m256i d, __m256i s, __m256i m, md_blend_op blendOp)
+{
+    __m256i x255 = _mm256_set1_epi16(255);
 
-    if (pSrcGC == NULL) {
-        return; /* Nothing to draw. */
-    }
+    if (blendOp == md_blend_op_src_over) {
+        __m256i a;
 
-    if (pGC->pAPI->procs.gcDrawGC) {
-        pGC->pAPI->procs.gcDrawGC(pGC, pSrcGC, srcX, srcY);
+        s = md_mul255_epu16__avx2(s, m);
+        a = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+        return _mm256_add_epi16(s, md_mul255_epu16__avx2(d, _mm256_sub_epi16(x255, a)));
+    } else {
+        return _mm256_add_epi16(md_mul255_epu16__avx2(s, m), md_mul255_epu16__avx2(d, _mm256_sub_epi16(x255, m)));
     }
 }
 
-void md_gc_draw_glyphs(md_gc* pGC, const md_item* pItem, const md_glyph* pGlyphs, size_t glyphCount, md_int32 x, md_int32 y)
+MD_PRIVATE MD_TARGET_AVX2 void md_blend_span_avx2__software(md_uint32* pDst, const md_uint32* pSrc, md_uint32 color, const md_uint8* pMask, md_uint32 coverage, md_uint32 count, md_blend_op blendOp)
 {
-    if (pGC == NULL || pItem == NULL || pGlyphs == NULL) {
-        return;
-    }
+    __m256i zero = _mm256_setzero_si256();
+    __m256i solid = _mm256_unpacklo_epi8(_mm256_set1_epi32((int)color), zero);
+    __m256i coverage16 = _mm256_set1_epi16((short)coverage);
+    md_uint32 i;
 
-    MD_ASSERT(pGC->pAPI != NULL);
+    /*
+    Eight pixels at a time. The unpack and pack instructions work within each 128-bit lane, so the low half of each lane holds pixels 0-1 and 4-5 and the
+    high half holds 2-3 and 6-7. Everything is unpacked the same way so it all lines back up when packed.
+    */
+    for (i = 0; i + 8 <= count; i += 8) {
+        __m256i d;
+        __m256i dLo;
+        __m256i dHi;
+        __m256i sLo;
+        __m256i sHi;
+        __m256i mLo;
+        __m256i mHi;
+
+        if (pMask != NULL) {
+            md_uint32 mask8[2];
+            __m128i m;
+            __m256i mm;
+
+            MD_COPY_MEMORY(mask8, pMask + i, 8);
+            if ((mask8[0] | mask8[1]) == 0) {
+                continue;
+            }
 
-    if (glyphCount == 0) {
-        return; /* Nothing to draw. */
-    }
+            m   = _mm_loadl_epi64((const __m128i*)mask8);
+            m   = _mm_unpacklo_epi8(m, m);
+            mm  = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_unpacklo_epi16(m, m)), _mm_unpackhi_epi16(m, m), 1);
+            mLo = _mm256_unpacklo_epi8(mm, zero);
+            mHi = _mm256_unpackhi_epi8(mm, zero);
+        } else {
+            mLo = coverage16;
+            mHi = coverage16;
+        }
 
-    if (pGC->pAPI->procs.gcDrawGlyphs) {
-        pGC->pAPI->procs.gcDrawGlyphs(pGC, pItem, pGlyphs, glyphCount, x, y);
+        if (pSrc != NULL) {
+            __m256i s = _mm256_loadu_si256((const __m256i*)(pSrc + i));
+            sLo = _mm256_unpacklo_epi8(s, zero);
+            sHi = _mm256_unpackhi_epi8(s, zero);
+        } else {
+            sLo = solid;
+            sHi = solid;
+        }
+
+        d   = _mm256_loadu_si256((const __m256i*)(pDst + i));
+        dLo = md_blend_epu16__avx2(_mm256_unpacklo_epi8(d, zero), sLo, mLo, blendOp);
+        dHi = md_blend_epu16__avx2(_mm256_unpackhi_epi8(d, zero), sHi, mHi, blendOp);
+        _mm256_storeu_si256((__m256i*)(pDst + i), _mm256_packus_epi16(dLo, dHi));
     }
+
+    md_blend_span_scalar__software(pDst + i, (pSrc != NULL) ? pSrc + i : NULL, color, (pMask != NULL) ? pMask + i : NULL, coverage, count - i, blendOp);
 }
+#endif
 
-void md_gc_draw_text_utf8(md_gc* pGC, md_font* pFont, const md_utf8* pTextUTF8, size_t textLength, md_int32 x, md_int32 y, md_alignment originAlignmentX, md_alignment originAlignmentY, md_text_metrics* pMetrics)
+MD_PRIVATE void md_blend_span__software(md_gc* pGC, md_uint32* pDst, const md_uint32* pSrc, md_uint32 color, const md_uint8* pMask, md_uint32 coverage, md_uint32 count, md_blend_op blendOp)
 {
-    md_result result;
+    if (count == 0) {
+        return;
+    }
 
-    if (pMetrics != NULL) {
-        MD_ZERO_OBJECT(pMetrics);
+    if (pMask == NULL) {
+        if (coverage == 0) {
+            return;
+        }
+
+        /* Solid fills that completely replace the destination. */
+        if (pSrc == NULL && coverage == 255 && (blendOp == md_blend_op_src || (color >> 24) == 255)) {
+            md_uint32 i;
+            for (i = 0; i < count; ++i) {
+                pDst[i] = color;
+            }
+
+            return;
+        }
+
+        if (pSrc != NULL && coverage == 255 && blendOp == md_blend_op_src) {
+            MD_COPY_MEMORY(pDst, pSrc, count * sizeof(*pDst));
+            return;
+        }
     }
 
-    if (pGC == NULL || pFont == NULL || pTextUTF8 == NULL || textLength == 0) {
+    /* Blending a transparent color over the top of something does nothing. */
+    if (pSrc == NULL && color == 0 && blendOp == md_blend_op_src_over) {
         return;
     }
 
-    if (textLength == (size_t)-1) {
-        textLength = strlen(pTextUTF8);
+#if defined(MD_SUPPORT_AVX2)
+    if (pGC->pAPI->software.useAVX2) {
+        md_blend_span_avx2__software(pDst, pSrc, color, pMask, coverage, count, blendOp);
+        return;
+    }
+#endif
+#if defined(MD_SUPPORT_SSE2)
+    if (pGC->pAPI->software.useSSE2) {
+        md_blend_span_sse2__software(pDst, pSrc, color, pMask, coverage, count, blendOp);
+        return;
     }
+#endif
 
-    /* TODO: Implement support for vertical text layouts. Not sure yet how to identify a font or script as vertical... */
+    (void)pGC;
+    md_blend_span_scalar__software(pDst, pSrc, color, pMask, coverage, count, blendOp);
+}
 
-    /* TODO: Implement support for backend-optimized implementations of this method. */
-#if 0
-    if (pGC->pAPI->gcDrawTextUTF8) {
-        pGC->pAPI->gcDrawTextUTF8(pGC, pFont, pTextUTF8, textLength, x, y, originAlignmentX, originAlignmentY);
-    } else
-#endif
-    {
-        /* Generic implementation. This is optimized for simplicity rather than speed. Consider this to be the reference implementation. */
-        md_int32 originX = 0;
-        md_int32 originY = 0;
-        md_int32 penX;
-        md_int32 penY;
-        md_text_metrics metrics;
-        md_int32 lineSizeY = (pFont->metrics.ascent - pFont->metrics.descent);
-        
 
-        /* The starting position of the pen depends on the alignment of the origin. */
-        if (originAlignmentX == md_alignment_left && originAlignmentY == md_alignment_top) {
-            /* Simple case. The pen starts at [x] and [y] exactly. */
-            originX = x;
-            originY = y;
-        } else {
-            /* We need to measure the string to know where to start the pen. */
-            result = md_font_get_text_metrics_utf8(pFont, pTextUTF8, textLength, &metrics);
-            if (result != MD_SUCCESS) {
-                return;
-            }
+MD_PRIVATE void md_composite_span__software(md_gc* pGC, md_rasterizer_software* pRasterizer, const md_paint_software* pPaint, md_int32 x, md_int32 y, md_int32 count, const md_uint8* pCoverage, md_uint8 coverage)
+{
+    md_uint32* pDst;
+    md_gc_state_software* pState;
+    md_int32 i;
 
-            /* X */
-            if (originAlignmentX == md_alignment_right) {
-                originX = x - metrics.sizeX;
-            } else if (originAlignmentX == md_alignment_center) {
-                originX = x - (metrics.sizeX / 2);
-            }
+    MD_ASSERT(x >= 0 && x + count <= (md_int32)pGC->software.sizeX);
+    MD_ASSERT(y >= 0 && y         <  (md_int32)pGC->software.sizeY);
 
-            /* Y */
-            if (originAlignmentY == md_alignment_bottom) {
-                originY = y - metrics.sizeY;
-            } else if (originAlignmentY == md_alignment_center) {
-                originY = y - (metrics.sizeY / 2);
-            }
+    pState = &pGC->software.pState[pGC->software.stateCount-1];
+
+    /* The clip rectangle is just a matter of trimming the span. */
+    if (y < pState->clipTop || y >= pState->clipBottom) {
+        return;
+    }
+
+    if (x < pState->clipLeft) {
+        md_int32 skip = pState->clipLeft - x;
+        if (pCoverage != NULL) {
+            pCoverage += skip;
         }
 
-        penX = originX;
-        penY = originY;
+        x     += skip;
+        count -= skip;
+    }
 
-        metrics.lPadding = 0;
-        metrics.rPadding = 0;
-        metrics.sizeX    = 0;
-        metrics.sizeY    = lineSizeY;
+    if (x + count > pState->clipRight) {
+        count = pState->clipRight - x;
+    }
 
-        /* We've figured out the pen position, so now we can draw the text. */
-        /* NOTE: Only supporting left-to-right, top-to-bottom for now. Still figuring out vertical text... */
-        {
-            md_itemize_state itemizeState;
-            md_item   pItemsStack[1024];
-            md_item*  pItemsHeap = NULL;
-            md_item*  pItems = NULL;
-            md_uint32 itemCount;
-            md_uint32 iItem;
+    if (count <= 0) {
+        return;
+    }
 
-            /* First step is to itemize as usual. */
-            itemCount = MD_COUNTOF(pItemsStack);
-            result = md_itemize_utf8(pFont, pTextUTF8, textLength, pItemsStack, &itemCount, &itemizeState);
-            if (result == MD_SUCCESS) {
-                pItems = &pItemsStack[0];
-            } else if (result == MD_NO_SPACE) {
-                /* Not enough room on the stack. Try again against the heap. */
-                pItemsHeap = (md_item*)MD_MALLOC(sizeof(*pItemsHeap) * itemCount);
-                if (pItemsHeap == NULL) {
-                    return; /* Out of memory. */
-                }
+    pDst = pGC->software.pImageData + y*pGC->software.stride + x;
 
-                result = md_itemize_utf8(pFont, pTextUTF8, textLength, pItemsHeap, &itemCount, &itemizeState);
-                if (result != MD_SUCCESS) {
-                    return; /* Failed to itemize. */
-                }
+    /* The clip mask is folded into the coverage up front so the blending kernels only ever need to deal with a single mask. */
+    if (pState->pClipMask != NULL) {
+        const md_uint8* pClip = pState->pClipMask->pCoverage + (y - pState->pClipMask->top)*(md_int32)pState->pClipMask->sizeX + (x - pState->pClipMask->left);
+        md_uint8* pMask = pRasterizer->pSpanMask;
 
-                pItems = pItemsHeap;
-            } else {
-                return; /* Failed to itemize. */
-            }
+        for (i = 0; i < count; ++i) {
+            pMask[i] = (md_uint8)md_mul255__software((pCoverage != NULL) ? pCoverage[i] : coverage, pClip[i]);
+        }
 
-            /* Now we just shape and draw. */
-            if (originAlignmentX == md_alignment_left) {
-                /* Simple case. No need for measuring lines. */
-                md_int32 lineSizeX = 0;
-                for (iItem = 0; iItem < itemCount; ++iItem) {
-                    md_item* pItem = &pItems[iItem];
+        pCoverage = pMask;
+    }
 
-                    if (md_is_newline_utf8(pTextUTF8 + pItem->offset, pItem->length)) {
-                        penX  = originX;
-                        penY += lineSizeY;
+    if (pPaint->type == md_brush_type_solid) {
+        md_blend_span__software(pGC, pDst, NULL, pPaint->color, pCoverage, coverage, (md_uint32)count, pPaint->blendOp);
+        return;
+    }
 
-                        metrics.sizeY += lineSizeY;
-                        if (metrics.sizeX < lineSizeX) {
-                            metrics.sizeX = lineSizeX;
-                        }
-                    } else {
-                        md_text_metrics itemMetrics;
-                        md_glyph  pGlyphsStack[4096];
-                        md_glyph* pGlyphsHeap = NULL;
-                        md_glyph* pGlyphs = NULL;
-                        size_t glyphCount;
+    if (pPaint->isIntegerOffset && pPaint->pSrcGC != pGC) {
+        /* The source can be read directly. Anything outside of the bounds of the source is transparent. */
+        md_gc* pSrcGC = pPaint->pSrcGC;
+        md_int32 srcY = y + pPaint->offsetY;
+        md_int32 srcX = x + pPaint->offsetX;
+        md_int32 beg = 0;
+        md_int32 end = 0;
 
-                        glyphCount = MD_COUNTOF(pGlyphsStack);
-                        result = md_shape_utf8(pFont, pItem, pTextUTF8 + pItem->offset, pItem->length, pGlyphsStack, &glyphCount, NULL, &itemMetrics);
-                        if (result == MD_SUCCESS) {
-                            pGlyphs = &pGlyphsStack[0];
-                        } else if (result == MD_NO_SPACE) {
-                            /* Try the heap. */
-                            pGlyphsHeap = (md_glyph*)MD_MALLOC(sizeof(*pGlyphsHeap) * glyphCount);
-                            if (pGlyphsHeap == NULL) {
-                                break;  /* Out of memory. */
-                            }
+        if (srcY >= 0 && srcY < (md_int32)pSrcGC->software.sizeY) {
+            beg = MD_CLAMP(-srcX,                                   0,   count);
+            end = MD_CLAMP((md_int32)pSrcGC->software.sizeX - srcX, beg, count);
+        }
 
-                            result = md_shape_utf8(pFont, pItem, pTextUTF8 + pItem->offset, pItem->length, pGlyphsHeap, &glyphCount, NULL, &itemMetrics);
-                            if (result != MD_SUCCESS) {
-                                break;  /* Failed to shape this item. */
-                            }
+        md_blend_span__software(pGC, pDst, NULL, 0, pCoverage, coverage, (md_uint32)beg, pPaint->blendOp);
+        if (end > beg) {
+            md_blend_span__software(pGC, pDst + beg, pSrcGC->software.pImageData + srcY*(md_int32)pSrcGC->software.stride + srcX + beg, 0, (pCoverage != NULL) ? pCoverage + beg : NULL, coverage, (md_uint32)(end - beg), pPaint->blendOp);
+        }
+        md_blend_span__software(pGC, pDst + end, NULL, 0, (pCoverage != NULL) ? pCoverage + end : NULL, coverage, (md_uint32)(count - end), pPaint->blendOp);
+        return;
+    }
 
-                            pGlyphs = pGlyphsHeap;
-                        } else {
-                            break;  /* Failed to shape this item. */
-                        }
+    /* General case. Sample the whole span into a temporary buffer and then blend it in one go. */
+    if (pPaint->type == md_brush_type_linear || pPaint->type == md_brush_type_radial) {
+        md_paint_fetch_gradient_span__software(pGC, pPaint, x, y, count, pRasterizer->pSpanSrc);
+    } else {
+        for (i = 0; i < count; ++i) {
+            pRasterizer->pSpanSrc[i] = md_paint_sample__software(pPaint, x + i, y);
+        }
+    }
 
-                        md_gc_draw_glyphs(pGC, &pItems[iItem], pGlyphs, glyphCount, penX, penY);
+    md_blend_span__software(pGC, pDst, pRasterizer->pSpanSrc, 0, pCoverage, coverage, (md_uint32)count, pPaint->blendOp);
+}
 
-                        MD_FREE(pGlyphsHeap);
-                        pGlyphsHeap = NULL;
+MD_PRIVATE void md_paint_span__software(void* pUserData, md_rasterizer_software* pRasterizer, md_int32 x, md_int32 y, md_int32 count, const md_uint8* pCoverage, md_uint8 coverage)
+{
+    md_paint_span_data_software* pData = (md_paint_span_data_software*)pUserData;
+    md_composite_span__software(pData->pGC, pRasterizer, pData->pPaint, x, y, count, pCoverage, coverage);
+}
 
-                        penX += itemMetrics.sizeX;
-                        lineSizeX += itemMetrics.sizeX;
-                    }
-                }
+MD_PRIVATE void md_gc_fill_polygon__software(md_gc* pGC, const md_polygon_software* pPolygon, md_fill_mode fillMode, const md_paint_software* pPaint)
+{
+    md_paint_span_data_software data;
 
-                if (metrics.sizeX < lineSizeX) {
-                    metrics.sizeX = lineSizeX;
-                }
-            } else {
-                /* Complicated case. We need to go line-by-line, measure it, then position it based on the alignment. */
-                md_int32 lineSizeX;
+    data.pGC    = pGC;
+    data.pPaint = pPaint;
+    /* A GC being drawn onto itself can't be split between threads because a tile might read pixels that another tile is in the middle of writing. */
+    md_rasterize_polygon__software(pGC, pPolygon, fillMode, pGC->software.pState[pGC->software.stateCount-1].antialiasMode, pPaint->pSrcGC != pGC, md_paint_span__software, &data);
+}
 
-                iItem = 0;
-                while (iItem < itemCount) {  /* For each line... */
-                    md_uint32 iLineBeg = iItem;
-                    md_uint32 iLineEnd = iItem;
-                    
-                    lineSizeX = 0;
+typedef struct
+{
+    md_gc* pGC;
+    const md_paint_software* pPaint;
+    md_int32 left;
+    md_int32 top;
+    md_int32 right;
+    md_int32 bottom;
+} md_fill_rectangle_data_software;
 
-                    /* Find the range of items making up this line. */
-                    for (; iLineEnd < itemCount; ++iLineEnd) {
-                        md_item* pItem = &pItems[iLineEnd];
-                        if (md_is_newline_utf8(pTextUTF8 + pItem->offset, pItem->length)) {
-                            metrics.sizeY += lineSizeY;
-                            if (metrics.sizeX < lineSizeX) {
-                                metrics.sizeX = lineSizeX;
-                            }
+MD_PRIVATE md_result md_fill_rectangle_tile__software(void* pUserData, md_rasterizer_software* pRasterizer, md_uint32 iTile, md_int32 yBeg, md_int32 yEnd)
+{
+    md_fill_rectangle_data_software* pData = (md_fill_rectangle_data_software*)pUserData;
+    md_int32 y;
 
-                            break;
-                        } else {
-                            md_text_metrics itemMetrics;
-                            result = md_shape_utf8(pFont, pItem, pTextUTF8 + pItem->offset, pItem->length, NULL, NULL, NULL, &itemMetrics);
-                            if (result != MD_SUCCESS) {
-                                break;
-                            }
+    (void)iTile;
 
-                            lineSizeX += itemMetrics.sizeX;
-                        }
-                    }
+    yBeg = MD_MAX(yBeg, pData->top);
+    yEnd = MD_MIN(yEnd, pData->bottom);
 
-                    if (iLineBeg != iLineEnd) {
-                        if (originAlignmentX == md_alignment_right) {
-                            penX = x - lineSizeX;
-                        } else if (originAlignmentX == md_alignment_center) {
-                            penX = x - (lineSizeX / 2);
-                        } else {
-                            penX = originX;
-                        }
-                    
-                        for (iItem = iLineBeg; iItem < iLineEnd; ++iItem) {
-                            md_item* pItem = &pItems[iItem];
-                            md_text_metrics itemMetrics;
-                            md_glyph  pGlyphsStack[4096];
-                            md_glyph* pGlyphsHeap = NULL;
-                            md_glyph* pGlyphs = NULL;
-                            size_t glyphCount;
+    for (y = yBeg; y < yEnd; ++y) {
+        md_composite_span__software(pData->pGC, pRasterizer, pData->pPaint, pData->left, y, pData->right - pData->left, NULL, 255);
+    }
 
-                            glyphCount = MD_COUNTOF(pGlyphsStack);
-                            result = md_shape_utf8(pFont, pItem, pTextUTF8 + pItem->offset, pItem->length, pGlyphsStack, &glyphCount, NULL, &itemMetrics);
-                            if (result == MD_SUCCESS) {
-                                pGlyphs = &pGlyphsStack[0];
-                            } else if (result == MD_NO_SPACE) {
-                                /* Try the heap. */
-                                pGlyphsHeap = (md_glyph*)MD_MALLOC(sizeof(*pGlyphsHeap) * glyphCount);
-                                if (pGlyphsHeap == NULL) {
-                                    break;  /* Out of memory. */
-                                }
+    return MD_SUCCESS;
+}
 
-                                result = md_shape_utf8(pFont, pItem, pTextUTF8 + pItem->offset, pItem->length, pGlyphsHeap, &glyphCount, NULL, &itemMetrics);
-                                if (result != MD_SUCCESS) {
-                                    break;  /* Failed to shape this item. */
-                                }
+/* Fills a whole-pixel rectangle in device space by compositing each row directly. The rectangle is clipped to the clip rectangle. */
+MD_PRIVATE void md_gc_fill_rectangle__software(md_gc* pGC, md_int32 left, md_int32 top, md_int32 right, md_int32 bottom, const md_paint_software* pPaint)
+{
+    md_gc_state_software* pState = &pGC->software.pState[pGC->software.stateCount-1];
+    md_fill_rectangle_data_software data;
 
-                                pGlyphs = pGlyphsHeap;
-                            } else {
-                                break;  /* Failed to shape this item. */
-                            }
+    data.pGC    = pGC;
+    data.pPaint = pPaint;
+    data.left   = MD_MAX(left,   pState->clipLeft);
+    data.top    = MD_MAX(top,    pState->clipTop);
+    data.right  = MD_MIN(right,  pState->clipRight);
+    data.bottom = MD_MIN(bottom, pState->clipBottom);
 
-                            /* This hack is specifically for GDI. We need to clip against the item metrics or else we'll overwrite one pixel too far to the left. Very annoying. */
-                            if (pGC->pAPI->backend == md_backend_gdi) {
-                                md_gc_save(pGC);
-                                {
-                                    md_gc_rectangle(pGC, penX, penY, penX + itemMetrics.sizeX, penY + itemMetrics.sizeY);
-                                    md_gc_clip(pGC);
-                                    md_gc_draw_glyphs(pGC, pItem, pGlyphs, glyphCount, penX, penY);
-                                }
-                                md_gc_restore(pGC);
-                            } else {
-                                md_gc_draw_glyphs(pGC, pItem, pGlyphs, glyphCount, penX, penY);
-                            }
+    if (data.right <= data.left || data.bottom <= data.top) {
+        return;
+    }
 
-                            MD_FREE(pGlyphsHeap);
-                            pGlyphsHeap = NULL;
+    md_gc_run_tiles__software(pGC, (md_uint32)data.top / pGC->software.tileSize, (md_uint32)(data.bottom - 1) / pGC->software.tileSize + 1, pPaint->pSrcGC != pGC, md_fill_rectangle_tile__software, &data);
+}
 
-                            penX += itemMetrics.sizeX;
-                        }
-                    }
+/*
+Converts a left/top/right/bottom rectangle in device space to the range of pixels whose centers are inside it, which is the same as what the aliased
+rasterizer would produce. When every edge is on a pixel boundary this is also the same as the anti-aliased rasterizer.
+*/
+static MD_INLINE void md_gc_get_rectangle_pixels__software(md_gc* pGC, const float* pRect, md_int32* pPixels)
+{
+    pPixels[0] = (md_int32)ceil(MD_CLAMP(pRect[0], -1.0f, (float)pGC->software.sizeX + 1) - 0.5f);
+    pPixels[1] = (md_int32)ceil(MD_CLAMP(pRect[1], -1.0f, (float)pGC->software.sizeY + 1) - 0.5f);
+    pPixels[2] = (md_int32)ceil(MD_CLAMP(pRect[2], -1.0f, (float)pGC->software.sizeX + 1) - 0.5f);
+    pPixels[3] = (md_int32)ceil(MD_CLAMP(pRect[3], -1.0f, (float)pGC->software.sizeY + 1) - 0.5f);
+}
 
-                    penY += lineSizeY;
+static MD_INLINE md_bool32 md_is_rectangle_pixel_aligned__software(const float* pRect)
+{
+    return pRect[0] == (float)floor(pRect[0]) && pRect[1] == (float)floor(pRect[1]) && pRect[2] == (float)floor(pRect[2]) && pRect[3] == (float)floor(pRect[3]);
+}
 
-                    if (metrics.sizeX < lineSizeX) {
-                        metrics.sizeX = lineSizeX;
-                    }
+/*
+Fills the current path without going through the rasterizer when it's made up of nothing but axis-aligned rectangles that do not overlap each other.
+These come up all the time when drawing text layouts and UI elements. Without anti-aliasing, the pixels covered by a rectangle are those whose centers are
+inside it, just like the rasterizer. With anti-aliasing this only applies when every edge is on a pixel boundary. Returns false when the path needs to
+go through the general path instead.
+*/
+MD_PRIVATE md_bool32 md_gc_fill_path_rectangles__software(md_gc* pGC, const md_paint_software* pPaint)
+{
+    md_gc_state_software* pState = &pGC->software.pState[pGC->software.stateCount-1];
+    float rects[MD_SOFTWARE_MAX_FAST_RECTS*4];
+    md_uint32 rectCount;
+    md_uint32 iRect;
+    md_uint32 jRect;
 
-                    /* Go past the new-line item. */
-                    iItem += 1;
-                }
-            }
+    if (!md_path_get_rectangles__software(&pGC->software.path, rects, MD_SOFTWARE_MAX_FAST_RECTS, &rectCount)) {
+        return MD_FALSE;
+    }
 
-            MD_FREE(pItemsHeap);
-            md_free_itemize_state(&itemizeState);
+    for (iRect = 0; iRect < rectCount; ++iRect) {
+        const float* pRect = &rects[iRect*4];
+
+        if (pState->antialiasMode != md_antialias_mode_none && !md_is_rectangle_pixel_aligned__software(pRect)) {
+            return MD_FALSE;
         }
 
-        if (pMetrics != NULL) {
-            *pMetrics = metrics;
+        /* Overlapping rectangles interact through the fill rule and the winding direction of each one so those need to be rasterized properly. */
+        for (jRect = 0; jRect < iRect; ++jRect) {
+            const float* pOther = &rects[jRect*4];
+            if (pRect[0] < pOther[2] && pOther[0] < pRect[2] && pRect[1] < pOther[3] && pOther[1] < pRect[3]) {
+                return MD_FALSE;
+            }
         }
     }
+
+    for (iRect = 0; iRect < rectCount; ++iRect) {
+        md_int32 pixels[4];
+        md_gc_get_rectangle_pixels__software(pGC, &rects[iRect*4], pixels);
+        md_gc_fill_rectangle__software(pGC, pixels[0], pixels[1], pixels[2], pixels[3], pPaint);
+    }
+
+    return MD_TRUE;
 }
 
-md_result md_font_get_text_layout_metrics_utf8(md_font* pFont, const md_utf8* pTextUTF8, size_t textLength, const md_text_layout* pLayout, md_text_metrics* pTextMetrics)
+MD_PRIVATE md_clip_mask_software* md_clip_mask_alloc__software(md_int32 left, md_int32 top, md_uint32 sizeX, md_uint32 sizeY)
 {
-    md_int32 lineSizeX;
-    md_int32 lineSizeY;
+    md_clip_mask_software* pMask;
 
-    if (pTextMetrics == NULL) {
-        return MD_INVALID_ARGS;
+    pMask = (md_clip_mask_software*)MD_CALLOC(1, sizeof(*pMask) + (size_t)sizeX*sizeY);
+    if (pMask == NULL) {
+        return NULL;
     }
 
-    MD_ZERO_OBJECT(pTextMetrics);
+    pMask->refCount  = 1;
+    pMask->left      = left;
+    pMask->top       = top;
+    pMask->sizeX     = sizeX;
+    pMask->sizeY     = sizeY;
+    pMask->pCoverage = (md_uint8*)(pMask + 1);
 
-    if (pFont == NULL || pTextUTF8 == NULL || pLayout == NULL) {
-        return MD_INVALID_ARGS;
+    return pMask;
+}
+
+static MD_INLINE void md_clip_mask_retain__software(md_clip_mask_software* pMask)
+{
+    if (pMask != NULL) {
+        pMask->refCount += 1;
     }
+}
 
-    lineSizeY = (pFont->metrics.ascent - pFont->metrics.descent);
+static MD_INLINE void md_clip_mask_release__software(md_clip_mask_software* pMask)
+{
+    if (pMask != NULL) {
+        MD_ASSERT(pMask->refCount > 0);
 
-    if (textLength == 0) {
-        pTextMetrics->sizeY = lineSizeY;
-        return MD_SUCCESS;  /* Nothing to do. */
+        pMask->refCount -= 1;
+        if (pMask->refCount == 0) {
+            MD_FREE(pMask);
+        }
     }
+}
 
-#if 0
-    if (pFont->pAPI->procs.fontGetTextLayoutMetricsUTF8) {
-        return pFont->pAPI->procs.fontGetTextLayoutMetricsUTF8(pFont, pTextUTF8, textLength, pLayout, pMetrics);
+
+/* Stroking */
+MD_PRIVATE md_bool32 md_polygon_equals__software(const md_polygon_software* pA, const md_polygon_software* pB)
+{
+    if (pA->pointCount != pB->pointCount || pA->contourCount != pB->contourCount) {
+        return MD_FALSE;
     }
-#endif
-    {
-        /* Generic implementation. */
-        /*
-        TODO:
-            - Add support for word wrap.
-            - Handle different line heights for different items (may happen with font fallback).
-        */
-        md_result result;
-        md_int32  sizeX = 0;
-        md_int32  sizeY = lineSizeY;
-        md_itemize_state itemizeState;
-        md_item   pItemsStack[1024];
-        md_item*  pItemsHeap = NULL;
-        md_item*  pItems = NULL;
-        md_uint32 itemCount;
-        md_uint32 iItem;
-        md_int32  tabSizeXInPixels = pLayout->tabWidthInPixels;
 
-        /* The first step is to itemize. */
-        itemCount = MD_COUNTOF(pItemsStack);
-        result = md_itemize_utf8(pFont, pTextUTF8, textLength, pItemsStack, &itemCount, &itemizeState);
-        if (result == MD_SUCCESS) {
-            pItems = &pItemsStack[0];
-        } else if (result == MD_NO_SPACE) {
-            /* Not enough room on the stack. Try again against the heap. */
-            pItemsHeap = (md_item*)MD_MALLOC(sizeof(*pItemsHeap) * itemCount);
-            if (pItemsHeap == NULL) {
-                return MD_OUT_OF_MEMORY;
-            }
+    if (pA->pointCount > 0 && memcmp(pA->pPoints, pB->pPoints, pA->pointCount * sizeof(float) * 2) != 0) {
+        return MD_FALSE;
+    }
 
-            result = md_itemize_utf8(pFont, pTextUTF8, textLength, pItemsHeap, &itemCount, &itemizeState);
-            if (result != MD_SUCCESS) {
-                return result;
-            }
+    if (pA->contourCount > 0 && memcmp(pA->pContourEnds, pB->pContourEnds, pA->contourCount * sizeof(md_uint32)) != 0) {
+        return MD_FALSE;
+    }
 
-            pItems = pItemsHeap;
-        } else {
-            return result;
-        }
+    return MD_TRUE;
+}
 
-        /* We have the items so now we can measure them. */
-        lineSizeX = 0;
-        for (iItem = 0; iItem < itemCount; ++iItem) {
-            /* No need to do shaping for new-lines. */
-            if (md_is_newline_utf8(pTextUTF8 + pItems[iItem].offset, pItems[iItem].length)) {
-                if (pLayout->singleLine == MD_FALSE) {
-                    sizeY += lineSizeY;
-                    if (sizeX < lineSizeX) {
-                        sizeX = lineSizeX;
-                    }
-                    lineSizeX = 0;
-                }
-            } else if (md_is_tab_utf8(pTextUTF8 + pItems[iItem].offset, pItems[iItem].length)) {
-                /*
-                It's a tab item. To measure this we first find the width of the first tab character. And then we just take the remaining tab characters and multiply it by
-                the tab width.
-                */
-                if (tabSizeXInPixels == 0) {
-                    char spaceCh[1] = {' '};
-                    md_text_metrics spaceMetrics;
-                    if (md_font_get_text_metrics_utf8(pFont, spaceCh, 1, &spaceMetrics) != MD_SUCCESS) {
-                        MD_ZERO_OBJECT(&spaceMetrics);
-                        spaceMetrics.sizeX = 8;
-                        spaceMetrics.sizeY = (pFont->metrics.ascent - pFont->metrics.descent);
-                    }
+MD_PRIVATE md_result md_polygon_copy__software(md_polygon_software* pDst, const md_polygon_software* pSrc)
+{
+    md_uint32 iContour;
 
-                    tabSizeXInPixels = spaceMetrics.sizeX * pLayout->tabWidthInSpaces;
+    md_polygon_reset__software(pDst);
 
-                    lineSizeX = ((lineSizeX / tabSizeXInPixels) * tabSizeXInPixels) + (pItems[iItem].length * tabSizeXInPixels);
-                }
-            } else {
-                md_text_metrics itemMetrics;
-                result = md_shape_utf8(pFont, &pItems[iItem], pTextUTF8, pItems[iItem].length, NULL, NULL, NULL, &itemMetrics);
-                if (result != MD_SUCCESS) {
-                    MD_FREE(pItemsHeap);
-                    pItemsHeap = NULL;
-                    md_free_itemize_state(&itemizeState);
-                    return result;
-                }
+    for (iContour = 0; iContour < pSrc->contourCount; ++iContour) {
+        md_uint32 iBeg = md_polygon_get_contour_beg__software(pSrc, iContour);
+        md_uint32 iEnd = md_polygon_get_contour_end__software(pSrc, iContour);
+        md_uint32 iPoint;
 
-                lineSizeX += itemMetrics.sizeX;
+        for (iPoint = iBeg; iPoint < iEnd; ++iPoint) {
+            if (md_polygon_add_point__software(pDst, pSrc->pPoints[iPoint*2 + 0], pSrc->pPoints[iPoint*2 + 1]) != MD_SUCCESS) {
+                return MD_OUT_OF_MEMORY;
             }
         }
 
-        /* Don't forget to check the last line. */
-        if (sizeX < lineSizeX) {
-            sizeX = lineSizeX;
+        if (md_polygon_end_contour__software(pDst, (pSrc->pContourEnds[iContour] & MD_SOFTWARE_CONTOUR_CLOSED) != 0) != MD_SUCCESS) {
+            return MD_OUT_OF_MEMORY;
         }
-
-        pTextMetrics->sizeX = sizeX;
-        pTextMetrics->sizeY = sizeY;
-
-        md_free_itemize_state(&itemizeState);
-        return MD_SUCCESS;
     }
+
+    return MD_SUCCESS;
 }
 
-md_text_layout md_text_layout_init_default()
+MD_PRIVATE md_bool32 md_stroke_params_equal__software(const md_stroke_params_software* pA, const md_stroke_params_software* pB)
 {
-    md_text_layout layout;
-
-    MD_ZERO_OBJECT(&layout);
-    layout.alignmentX       = md_alignment_left;
-    layout.alignmentY       = md_alignment_top;
-    layout.fillBackground   = MD_TRUE;
-    layout.singleLine       = MD_FALSE;
-    layout.tabWidthInSpaces = 4;
-
-    return layout;
-}
+    md_uint32 iDash;
 
+    if (pA->halfWidth != pB->halfWidth || pA->lineCap != pB->lineCap || pA->lineJoin != pB->lineJoin || pA->miterLimit != pB->miterLimit || pA->dashCount != pB->dashCount) {
+        return MD_FALSE;
+    }
 
-#define MD_TEXT_LAYOUT_WHITESPACE   (1UL << 0)
-#define MD_TEXT_LAYOUT_NEWLINE      (1UL << 1)
+    for (iDash = 0; iDash < pA->dashCount; ++iDash) {
+        if (pA->dashes[iDash] != pB->dashes[iDash]) {
+            return MD_FALSE;
+        }
+    }
 
-typedef struct
-{
-    void* pUserData;
-    void      (* onInit)      (void* pUserData, const md_text_layout* pLayout);
-    void      (* onUninit)    (void* pUserData, const md_text_layout* pLayout);
-    void      (* onBeginItems)(void* pUserData, const md_text_layout* pLayout, md_int32 penX, md_int32 penY);
-    void      (* onEndItems)  (void* pUserData, const md_text_layout* pLayout, md_int32 penX, md_int32 penY);
-    void      (* onBeginLine) (void* pUserData, const md_text_layout* pLayout, const char* pTextUTF8, const md_item* pItems, md_uint32 itemCount, md_int32 penX, md_int32 penY, md_int32 sizeX, md_int32 sizeY);
-    void      (* onEndLine)   (void* pUserData, const md_text_layout* pLayout, md_int32 penX, md_int32 penY);
-    md_result (* onItem)      (void* pUserData, const md_text_layout* pLayout, const char* pTextUTF8, const md_item* pItem, const md_glyph* pGlyphs, md_uint32 glyphCount, const size_t* pClusters, md_int32 penX, md_int32 penY, md_int32 sizeX, md_int32 sizeY, md_uint32 flags);
-} md_layout_callbacks;
+    return MD_TRUE;
+}
 
 /*
-Main function for performing layout operations of text. Customizations of the layout breakdown are done via callbacks.
+Every piece of stroke geometry is emitted as its own closed contour, and they are all wound the same way so that they union together under the non-zero
+fill rule. This ends a piece that begins at iFirstPoint, flipping it if necessary.
 */
-static md_result md_text_layout_do_layout_utf8(md_font* pFont, const md_utf8* pTextUTF8, size_t textLength, const md_text_layout* pLayout, const md_layout_callbacks* pCallbacks)
+MD_PRIVATE md_result md_stroke_end_piece__software(md_polygon_software* pOutput, md_uint32 iFirstPoint)
 {
-    md_result result = MD_SUCCESS;
-    md_itemize_state itemizeState;
-    md_item   pItemsStack[1024];
-    md_item*  pItemsHeap = NULL;
-    md_item*  pItems = NULL;
-    md_uint32 itemCount;
-    md_uint32 iItem;
-    size_t    pClustersStack[1024];
-    size_t*   pClustersHeap = NULL;
-    size_t*   pClusters = NULL;
-    size_t    clustersHeapCap = 0;
-    md_glyph  pGlyphsStack[1024];
-    md_glyph* pGlyphsHeap = NULL;
-    md_glyph* pGlyphs = NULL;
-    size_t    glyphsHeapCap = 0;
+    float area = 0;
+    md_uint32 iPoint;
+    md_uint32 pointCount = pOutput->pointCount - iFirstPoint;
+    float* pPoints = pOutput->pPoints + iFirstPoint*2;
 
-    MD_ASSERT(pFont      != NULL);
-    MD_ASSERT(pTextUTF8  != NULL);
-    MD_ASSERT(pLayout    != NULL);
-    MD_ASSERT(pCallbacks != NULL);
+    for (iPoint = 0; iPoint < pointCount; ++iPoint) {
+        md_uint32 iNext = (iPoint+1 < pointCount) ? iPoint+1 : 0;
+        area += pPoints[iPoint*2 + 0]*pPoints[iNext*2 + 1] - pPoints[iNext*2 + 0]*pPoints[iPoint*2 + 1];
+    }
 
-    /* Itemize first. */
-    itemCount = MD_COUNTOF(pItemsStack);
-    result = md_itemize_utf8(pFont, pTextUTF8, textLength, pItemsStack, &itemCount, &itemizeState);
-    if (result == MD_SUCCESS) {
-        pItems = &pItemsStack[0];
-    } else if (result == MD_NO_SPACE) {
-        /* Not enough room on the stack. Try again against the heap. */
-        pItemsHeap = (md_item*)MD_MALLOC(sizeof(*pItemsHeap) * itemCount);
-        if (pItemsHeap == NULL) {
-            return MD_OUT_OF_MEMORY;
-        }
+    if (area > 0) {
+        for (iPoint = 0; iPoint < pointCount/2; ++iPoint) {
+            md_uint32 iOther = pointCount - iPoint - 1;
+            float x = pPoints[iPoint*2 + 0];
+            float y = pPoints[iPoint*2 + 1];
 
-        result = md_itemize_utf8(pFont, pTextUTF8, textLength, pItemsHeap, &itemCount, &itemizeState);
-        if (result != MD_SUCCESS) {
-            return result;
+            pPoints[iPoint*2 + 0] = pPoints[iOther*2 + 0];
+            pPoints[iPoint*2 + 1] = pPoints[iOther*2 + 1];
+            pPoints[iOther*2 + 0] = x;
+            pPoints[iOther*2 + 1] = y;
         }
+    }
 
-        pItems = pItemsHeap;
-    } else {
-        return result;
+    return md_polygon_end_contour__software(pOutput, MD_TRUE);
+}
+
+MD_PRIVATE md_result md_stroke_add_quad__software(md_polygon_software* pOutput, float x0, float y0, float x1, float y1, float x2, float y2, float x3, float y3)
+{
+    md_uint32 iFirstPoint = pOutput->pointCount;
+    md_result result;
+
+    result  = md_polygon_add_point__software(pOutput, x0, y0);
+    result |= md_polygon_add_point__software(pOutput, x1, y1);
+    result |= md_polygon_add_point__software(pOutput, x2, y2);
+    result |= md_polygon_add_point__software(pOutput, x3, y3);
+    if (result != MD_SUCCESS) {
+        return MD_OUT_OF_MEMORY;
     }
 
-    if (pCallbacks->onInit) {
-        pCallbacks->onInit(pCallbacks->pUserData, pLayout);
+    return md_stroke_end_piece__software(pOutput, iFirstPoint);
+}
+
+/* Adds a pie slice centered on cx/cy, or a full circle when the sweep is a full turn. The number of segments depends on the radius. */
+MD_PRIVATE md_result md_stroke_add_wedge__software(md_polygon_software* pOutput, float cx, float cy, float radius, double angle, double sweep)
+{
+    md_uint32 iFirstPoint = pOutput->pointCount;
+    md_uint32 segmentCount;
+    md_uint32 iSegment;
+    md_bool32 isFullCircle;
+    double step;
+
+    isFullCircle = (sweep >= MD_SOFTWARE_PI*2 || sweep <= -MD_SOFTWARE_PI*2);
+
+    if (radius > MD_SOFTWARE_FLATTEN_TOLERANCE) {
+        step = 2 * acos(1 - MD_SOFTWARE_FLATTEN_TOLERANCE / radius);
+    } else {
+        step = MD_SOFTWARE_PI / 2;
     }
+
+    segmentCount = (md_uint32)ceil(((sweep < 0) ? -sweep : sweep) / step);
+    segmentCount = MD_MAX(segmentCount, (isFullCircle) ? 4 : 1);
+
+    if (!isFullCircle) {
+        if (md_polygon_add_point__software(pOutput, cx, cy) != MD_SUCCESS) {
+            return MD_OUT_OF_MEMORY;
+        }
+    }
+
+    for (iSegment = 0; iSegment <= segmentCount; ++iSegment) {
+        double a = angle + sweep * iSegment / segmentCount;
+
+        if (isFullCircle && iSegment == segmentCount) {
+            break;  /* The last point is the same as the first. */
+        }
+
+        if (md_polygon_add_point__software(pOutput, (float)(cx + cos(a)*radius), (float)(cy + sin(a)*radius)) != MD_SUCCESS) {
+            return MD_OUT_OF_MEMORY;
+        }
+    }
+
+    return md_stroke_end_piece__software(pOutput, iFirstPoint);
+}
+
+/* Adds the cap at the end of an open polyline. dx/dy is the unit direction pointing away from the line. */
+MD_PRIVATE md_result md_stroke_add_cap__software(md_polygon_software* pOutput, const md_stroke_params_software* pParams, float x, float y, float dx, float dy)
+{
+    float hw = pParams->halfWidth;
+    float nx = -dy * hw;
+    float ny =  dx * hw;
+
+    switch (pParams->lineCap)
     {
-        md_int32 originX;
-        md_int32 originY;
-        md_int32 penX;
-        md_int32 penY;
-        md_int32 lineSizeX;
-        md_int32 lineSizeY = (pFont->metrics.ascent - pFont->metrics.descent);
-        md_int32 tabSizeXInPixels = 0;
+        case md_line_cap_square:
+        {
+            return md_stroke_add_quad__software(pOutput, x + nx, y + ny, x + nx + dx*hw, y + ny + dy*hw, x - nx + dx*hw, y - ny + dy*hw, x - nx, y - ny);
+        };
 
-        originX = pLayout->boundsX + pLayout->textOffsetX + pLayout->padding.left;
-        if (pLayout->borderWidth > 0) {
-            originX += pLayout->borderWidth;
+        case md_line_cap_round:
+        {
+            /* Half a circle starting at the normal and sweeping around through the direction of the cap. */
+            return md_stroke_add_wedge__software(pOutput, x, y, hw, atan2(ny, nx), -MD_SOFTWARE_PI);
+        };
+
+        case md_line_cap_flat:
+        default:
+        {
+            return MD_SUCCESS;
+        };
+    }
+}
+
+/* Adds the join between two segments meeting at x/y. d0 is the unit direction of the incoming segment and d1 is the unit direction of the outgoing one. */
+MD_PRIVATE md_result md_stroke_add_join__software(md_polygon_software* pOutput, const md_stroke_params_software* pParams, float x, float y, float d0x, float d0y, float d1x, float d1y)
+{
+    float hw = pParams->halfWidth;
+    float cross = d0x*d1y - d0y*d1x;
+    float dot   = d0x*d1x + d0y*d1y;
+    float o0x;
+    float o0y;
+    float o1x;
+    float o1y;
+
+    /* Segments that continue on in a straight line are already seamlessly joined by their quads. */
+    if (cross > -1e-4f && cross < 1e-4f) {
+        if (dot > 0) {
+            return MD_SUCCESS;
+        }
+
+        /* The path doubles back on itself. Only a round join has anything to fill, which is the half circle past the end of the incoming segment. */
+        if (pParams->lineJoin == md_line_join_round) {
+            return md_stroke_add_wedge__software(pOutput, x, y, hw, atan2(d0x, -d0y), -MD_SOFTWARE_PI);
         }
 
-        /* If we are not aligned to the top we need to measure so that we can position the text properly. */
-        if (pLayout->alignmentY == md_alignment_top) {
-            originY = pLayout->boundsY + pLayout->textOffsetY + pLayout->padding.top;
-            if (pLayout->borderWidth > 0) {
-                originY += pLayout->borderWidth;
+        return MD_SUCCESS;
+    }
+
+    /* The join is only needed on the outside of the turn. The inside is already covered by the overlapping quads. */
+    if (cross > 0) {
+        o0x =  d0y * hw;
+        o0y = -d0x * hw;
+        o1x =  d1y * hw;
+        o1y = -d1x * hw;
+    } else {
+        o0x = -d0y * hw;
+        o0y =  d0x * hw;
+        o1x = -d1y * hw;
+        o1y =  d1x * hw;
+    }
+
+    switch (pParams->lineJoin)
+    {
+        case md_line_join_round:
+        {
+            double sweep;
+
+            /* Round joins are imperceptible on hairlines. Skip them the same way as bevels. */
+            if (pParams->isHairline) {
+                break;
             }
-        } else {
-            md_text_metrics metrics;
-            result = md_font_get_text_layout_metrics_utf8(pFont, pTextUTF8, textLength, pLayout, &metrics);
-            if (result != MD_SUCCESS) {
-                md_free_itemize_state(&itemizeState);
-                return result;
+
+            /* The arc goes the short way around from the outer edge of the incoming segment to the outer edge of the outgoing one. */
+            sweep = atan2((cross < 0) ? -cross : cross, dot);
+            if (o0x*o1y - o0y*o1x < 0) {
+                sweep = -sweep;
             }
 
-            if (pLayout->alignmentY == md_alignment_bottom) {
-                originY = pLayout->boundsY +  (pLayout->boundsSizeY - metrics.sizeY) + pLayout->textOffsetY - pLayout->padding.bottom;
-                if (pLayout->borderWidth > 0) {
-                    originY -= pLayout->borderWidth;
-                }
-            } else if (pLayout->alignmentY == md_alignment_center) {
-                originY = pLayout->boundsY + ((pLayout->boundsSizeY - metrics.sizeY) / 2) + pLayout->textOffsetY;
-            } else {
-                return MD_INVALID_ARGS;
+            return md_stroke_add_wedge__software(pOutput, x, y, hw, atan2(o0y, o0x), sweep);
+        };
+
+        case md_line_join_miter:
+        {
+            /* The length of the miter relative to the line width is 1/sin(theta/2) where theta is the angle between the two segments. */
+            float ratio = (float)(1 / sqrt((1 + dot) * 0.5f));
+            if (ratio <= pParams->miterLimit) {
+                float mx = o0x + o1x;
+                float my = o0y + o1y;
+                float scale = hw * ratio / (float)sqrt(mx*mx + my*my);
+
+                return md_stroke_add_quad__software(pOutput, x, y, x + o0x, y + o0y, x + mx*scale, y + my*scale, x + o1x, y + o1y);
             }
+        } break;    /* Miter limit exceeded. Use a bevel. */
+
+        case md_line_join_bevel:
+        default: break;
+    }
+
+    /* Bevel. */
+    if (!pParams->isHairline) {
+        md_uint32 iFirstPoint = pOutput->pointCount;
+        md_result result;
+
+        result  = md_polygon_add_point__software(pOutput, x, y);
+        result |= md_polygon_add_point__software(pOutput, x + o0x, y + o0y);
+        result |= md_polygon_add_point__software(pOutput, x + o1x, y + o1y);
+        if (result != MD_SUCCESS) {
+            return MD_OUT_OF_MEMORY;
         }
 
-        penX = originX;
-        penY = originY;
+        return md_stroke_end_piece__software(pOutput, iFirstPoint);
+    }
 
+    return MD_SUCCESS;
+}
 
-        if (pCallbacks->onBeginItems) {
-            pCallbacks->onBeginItems(pCallbacks->pUserData, pLayout, penX, penY);
+/*
+Strokes a single polyline. The points must not contain any consecutive duplicates. When isClosed is set, the last point is connected back to the first
+and every vertex gets a join. Otherwise the two ends get caps.
+*/
+MD_PRIVATE md_result md_stroke_polyline__software(md_polygon_software* pOutput, const md_stroke_params_software* pParams, const float* pPoints, md_uint32 pointCount, md_bool32 isClosed)
+{
+    md_result result;
+    md_uint32 segmentCount;
+    md_uint32 iSegment;
+    float hw = pParams->halfWidth;
+    float prevDX = 0;
+    float prevDY = 0;
+    float firstDX = 0;
+    float firstDY = 0;
+
+    if (pointCount == 0) {
+        return MD_SUCCESS;
+    }
+
+    /* A lone point is drawn as a dot with round and square caps, just like Cairo. */
+    if (pointCount == 1) {
+        if (pParams->lineCap == md_line_cap_round) {
+            return md_stroke_add_wedge__software(pOutput, pPoints[0], pPoints[1], hw, 0, MD_SOFTWARE_PI*2);
+        }
+        if (pParams->lineCap == md_line_cap_square) {
+            return md_stroke_add_quad__software(pOutput, pPoints[0] - hw, pPoints[1] - hw, pPoints[0] + hw, pPoints[1] - hw, pPoints[0] + hw, pPoints[1] + hw, pPoints[0] - hw, pPoints[1] + hw);
         }
-        {
-            iItem = 0;
-            while (iItem < itemCount) {  /* For each line... */
-                md_uint32 iLineBeg = iItem;
-                md_uint32 iLineEnd = iItem;
-                md_int32 lineX;
 
-                lineSizeX = 0;
+        return MD_SUCCESS;
+    }
 
-                /* Find the range of items making up this line. */
-                for (; iLineEnd < itemCount; ++iLineEnd) {
-                    md_item* pItem = &pItems[iLineEnd];
-                    if (md_is_newline_utf8(pTextUTF8 + pItem->offset, pItem->length)) {
-                        if (pLayout->singleLine == MD_FALSE) {
-                            break;
-                        }
-                    } else if (md_is_tab_utf8(pTextUTF8 + pItem->offset, pItem->length)) {
-                        /*
-                        It's a tab item. To measure this we first find the width of the first tab character. And then we just take the remaining tab characters and multiply it by
-                        the tab width.
-                        */
-                        if (tabSizeXInPixels == 0) {
-                            char spaceCh[1] = {' '};
-                            md_text_metrics spaceMetrics;
-                            if (md_font_get_text_metrics_utf8(pFont, spaceCh, 1, &spaceMetrics) != MD_SUCCESS) {
-                                MD_ZERO_OBJECT(&spaceMetrics);
-                                spaceMetrics.sizeX = 8;
-                                spaceMetrics.sizeY = (pFont->metrics.ascent - pFont->metrics.descent);
-                            }
+    if (pointCount == 2) {
+        isClosed = MD_FALSE;    /* Closing a single segment would just retrace it. */
+    }
 
-                            tabSizeXInPixels = spaceMetrics.sizeX * pLayout->tabWidthInSpaces;
-                        }
+    segmentCount = (isClosed) ? pointCount : pointCount - 1;
 
-                        lineSizeX = ((lineSizeX / tabSizeXInPixels) * tabSizeXInPixels) + (pItem->length * tabSizeXInPixels);
-                    } else {
-                        md_text_metrics itemMetrics;
-                        result = md_shape_utf8(pFont, pItem, pTextUTF8 + pItem->offset, pItem->length, NULL, NULL, NULL, &itemMetrics);
-                        if (result != MD_SUCCESS) {
-                            break;
-                        }
+    for (iSegment = 0; iSegment < segmentCount; ++iSegment) {
+        md_uint32 i0 = iSegment;
+        md_uint32 i1 = (iSegment+1 < pointCount) ? iSegment+1 : 0;
+        float x0 = pPoints[i0*2 + 0];
+        float y0 = pPoints[i0*2 + 1];
+        float x1 = pPoints[i1*2 + 0];
+        float y1 = pPoints[i1*2 + 1];
+        float dx = x1 - x0;
+        float dy = y1 - y0;
+        float len = (float)sqrt(dx*dx + dy*dy);
+        float nx;
+        float ny;
 
-                        lineSizeX += itemMetrics.sizeX;
+        dx /= len;
+        dy /= len;
+        nx = -dy * hw;
+        ny =  dx * hw;
 
-                        /* TODO: If word wrapping is enabled, and this item extends past the bounds, we need to split the line. */
-                    }
-                }
+        result = md_stroke_add_quad__software(pOutput, x0 + nx, y0 + ny, x1 + nx, y1 + ny, x1 - nx, y1 - ny, x0 - nx, y0 - ny);
+        if (result != MD_SUCCESS) {
+            return result;
+        }
 
-                lineX = penX;
+        if (iSegment == 0) {
+            firstDX = dx;
+            firstDY = dy;
 
-                if (iLineBeg != iLineEnd) {
-                    if (pLayout->alignmentX == md_alignment_right) {
-                        penX = pLayout->boundsX + (pLayout->boundsSizeX - lineSizeX) - pLayout->padding.right;
-                        if (pLayout->borderWidth > 0) {
-                            penX -= pLayout->borderWidth;
-                        }
-                    } else if (pLayout->alignmentX == md_alignment_center) {
-                        penX = pLayout->boundsX + ((pLayout->boundsSizeX - lineSizeX) / 2);
-                    } else {
-                        penX = pLayout->boundsX + pLayout->padding.left;
-                        if (pLayout->borderWidth > 0) {
-                            penX += pLayout->borderWidth;
-                        }
-                    }
-                    penX += pLayout->textOffsetX;
+            if (!isClosed) {
+                result = md_stroke_add_cap__software(pOutput, pParams, x0, y0, -dx, -dy);
+            }
+        } else {
+            result = md_stroke_add_join__software(pOutput, pParams, x0, y0, prevDX, prevDY, dx, dy);
+        }
 
-                    lineX = penX;
+        if (result != MD_SUCCESS) {
+            return result;
+        }
 
-                    if (pCallbacks->onBeginLine) {
-                        pCallbacks->onBeginLine(pCallbacks->pUserData, pLayout, pTextUTF8, pItems + iLineBeg, iLineEnd - iLineBeg, penX, penY, lineSizeX, lineSizeY);
-                    }
-                    {
-                        for (iItem = iLineBeg; iItem <= iLineEnd && iItem < itemCount; ++iItem) {
-                            md_item* pItem = &pItems[iItem];
-                            md_text_metrics itemMetrics;
-                            size_t glyphCount;
+        prevDX = dx;
+        prevDY = dy;
+    }
 
-                            if (pItem->length <= MD_COUNTOF(pClustersStack)) {
-                                /* Put the clusters on the stack. */
-                                pClusters = &pClustersStack[0];
-                            } else {
-                                /* Put the clusters on the heap. */
-                                if (clustersHeapCap < pItem->length) {
-                                    size_t* pNewClustersHeap = (size_t*)MD_REALLOC(pClustersHeap, sizeof(*pClustersHeap) * pItem->length);
-                                    if (pNewClustersHeap == NULL) {
-                                        MD_FREE(pClustersHeap);
-                                        result = MD_OUT_OF_MEMORY;
-                                        break;
-                                    }
+    if (isClosed) {
+        return md_stroke_add_join__software(pOutput, pParams, pPoints[0], pPoints[1], prevDX, prevDY, firstDX, firstDY);
+    } else {
+        return md_stroke_add_cap__software(pOutput, pParams, pPoints[(pointCount-1)*2 + 0], pPoints[(pointCount-1)*2 + 1], prevDX, prevDY);
+    }
+}
 
-                                    pClustersHeap   = pNewClustersHeap;
-                                    clustersHeapCap = pItem->length;
-                                }
+MD_PRIVATE md_result md_stroke_add_dash_point__software(md_polygon_software* pDash, float x, float y)
+{
+    if (pDash->pointCount > 0) {
+        float dx = x - pDash->pPoints[pDash->pointCount*2 - 2];
+        float dy = y - pDash->pPoints[pDash->pointCount*2 - 1];
+        if (dx*dx + dy*dy < 1e-8f) {
+            return MD_SUCCESS;
+        }
+    }
 
-                                pClusters = pClustersHeap;
-                            }
+    return md_polygon_add_point__software(pDash, x, y);
+}
 
-                            /* Now we need to shape so we can get access to glyphs and clusters. */
-                            glyphCount = MD_COUNTOF(pGlyphsStack);
-                            result = md_shape_utf8(pFont, pItem, pTextUTF8 + pItem->offset, pItem->length, pGlyphsStack, &glyphCount, pClusters, &itemMetrics);
-                            if (result == MD_SUCCESS) {
-                                pGlyphs = &pGlyphsStack[0];
-                            } else if (result == MD_NO_SPACE) {
-                                /* Try the heap. */
-                                if (glyphCount > glyphsHeapCap) {
-                                    md_glyph* pNewGlyphsHeap = (md_glyph*)MD_REALLOC(pGlyphsHeap, sizeof(*pGlyphsHeap) * glyphCount);
-                                    if (pNewGlyphsHeap == NULL) {
-                                        MD_FREE(pGlyphsHeap);
-                                        result = MD_OUT_OF_MEMORY;
-                                        break;
-                                    }
+/*
+Like Cairo, the on and off phases alternate independently of the position in the dash array. An odd number of dashes therefore alternates between on
+and off each time the pattern repeats.
+*/
+MD_PRIVATE md_result md_stroke_dashed_polyline__software(md_polygon_software* pOutput, md_polygon_software* pDash, const md_stroke_params_software* pParams, const float* pPoints, md_uint32 pointCount, md_bool32 isClosed)
+{
+    md_result result;
+    md_uint32 segmentCount;
+    md_uint32 iSegment;
+    md_uint32 iDash = 0;
+    float dashRemaining = pParams->dashes[0];
+    md_bool32 isDashOn = MD_TRUE;
 
-                                    pGlyphsHeap   = pNewGlyphsHeap;
-                                    glyphsHeapCap = glyphCount;
-                                }
+    if (pointCount < 2) {
+        return md_stroke_polyline__software(pOutput, pParams, pPoints, pointCount, MD_FALSE);
+    }
 
-                                result = md_shape_utf8(pFont, pItem, pTextUTF8 + pItem->offset, pItem->length, pGlyphsHeap, &glyphCount, pClusters, &itemMetrics);
-                                if (result != MD_SUCCESS) {
-                                    break;  /* Failed to shape this item. */
-                                }
+    /* The dash pattern restarts at the beginning of each contour. Each "on" dash is stroked as its own open polyline. */
+    md_polygon_reset__software(pDash);
+    result = md_polygon_add_point__software(pDash, pPoints[0], pPoints[1]);
+    if (result != MD_SUCCESS) {
+        return result;
+    }
 
-                                pGlyphs = pGlyphsHeap;
-                            } else {
-                                break;  /* Failed to shape this item. */
-                            }
+    segmentCount = (isClosed) ? pointCount : pointCount - 1;
 
-                            /* Tabs need to be handled slightly differently to other characters due to it's different kind of spacing. */
-                            if (md_is_tab_utf8(pTextUTF8 + pItem->offset, pItem->length)) {
-                                /* It's a tab. */
-                                md_int32 lineSizeXSoFar = penX - lineX;
-                                md_int32 tabEndX = ((lineSizeXSoFar / tabSizeXInPixels) * tabSizeXInPixels) + (pItem->length * tabSizeXInPixels) + lineX;
+    for (iSegment = 0; iSegment < segmentCount; ++iSegment) {
+        md_uint32 i1 = (iSegment+1 < pointCount) ? iSegment+1 : 0;
+        float x0 = pPoints[iSegment*2 + 0];
+        float y0 = pPoints[iSegment*2 + 1];
+        float x1 = pPoints[i1*2 + 0];
+        float y1 = pPoints[i1*2 + 1];
+        float len = (float)sqrt((x1 - x0)*(x1 - x0) + (y1 - y0)*(y1 - y0));
+        float pos = 0;
 
-                                if (pCallbacks->onItem) {
-                                    result = pCallbacks->onItem(pCallbacks->pUserData, pLayout, pTextUTF8, pItem, pGlyphs, glyphCount, pClusters, penX, penY, tabEndX - penX, lineSizeY, MD_TEXT_LAYOUT_WHITESPACE);
-                                    if (result == MD_CANCELLED) {
-                                        break;
-                                    }
-                                }
+        while (len - pos > dashRemaining) {
+            float t;
+            float x;
+            float y;
 
-                                penX = tabEndX;
-                            } else {
-                                md_uint32 flags = 0;
-                                if (md_is_newline_utf8(pTextUTF8 + pItems[iItem].offset, pItems[iItem].length)) {
-                                    flags |= MD_TEXT_LAYOUT_WHITESPACE | MD_TEXT_LAYOUT_NEWLINE;
-                                }
+            pos += dashRemaining;
+            t = pos / len;
+            x = x0 + (x1 - x0)*t;
+            y = y0 + (y1 - y0)*t;
 
-                                if (pCallbacks->onItem) {
-                                    pCallbacks->onItem(pCallbacks->pUserData, pLayout, pTextUTF8, pItem, pGlyphs, glyphCount, pClusters, penX, penY, itemMetrics.sizeX, itemMetrics.sizeY, 0);
-                                    if (result == MD_CANCELLED) {
-                                        break;
-                                    }
-                                }
+            if (isDashOn) {
+                result = md_stroke_add_dash_point__software(pDash, x, y);
+                if (result == MD_SUCCESS) {
+                    result = md_stroke_polyline__software(pOutput, pParams, pDash->pPoints, pDash->pointCount, MD_FALSE);
+                }
+            } else {
+                md_polygon_reset__software(pDash);
+                result = md_polygon_add_point__software(pDash, x, y);
+            }
 
-                                penX += itemMetrics.sizeX;
+            if (result != MD_SUCCESS) {
+                return result;
+            }
 
-                                if (!pLayout->singleLine && (flags & MD_TEXT_LAYOUT_NEWLINE) != 0) {
-                                    penY += lineSizeY;
-                                }
-                            }
-                        }
-                    }
-                    if (pCallbacks->onEndLine) {
-                        pCallbacks->onEndLine(pCallbacks->pUserData, pLayout, penX, penY);
-                    }
+            iDash = (iDash + 1) % pParams->dashCount;
+            dashRemaining = pParams->dashes[iDash];
+            isDashOn = !isDashOn;
+        }
+
+        dashRemaining -= len - pos;
+
+        if (isDashOn) {
+            result = md_stroke_add_dash_point__software(pDash, x1, y1);
+            if (result != MD_SUCCESS) {
+                return result;
+            }
+        }
+    }
+
+    if (isDashOn && pDash->pointCount > 1) {
+        return md_stroke_polyline__software(pOutput, pParams, pDash->pPoints, pDash->pointCount, MD_FALSE);
+    }
+
+    return MD_SUCCESS;
+}
+
+/*
+Converts the outline of a polygon to fill geometry. The pieces are wound consistently and need to be filled with md_fill_mode_winding. Parameters are
+in device space.
+*/
+MD_PRIVATE md_result md_stroke_polygon__software(md_gc* pGC, const md_polygon_software* pPolygon, const md_stroke_params_software* pParams, md_polygon_software* pOutput)
+{
+    md_polygon_software* pContour = &pGC->software.strokeContour;
+    md_uint32 iContour;
+
+    MD_ASSERT(pGC      != NULL);
+    MD_ASSERT(pPolygon != NULL);
+    MD_ASSERT(pParams  != NULL);
+    MD_ASSERT(pOutput  != NULL);
+
+    md_polygon_reset__software(pOutput);
+
+    if (pParams->halfWidth <= 0) {
+        return MD_SUCCESS;
+    }
+
+    for (iContour = 0; iContour < pPolygon->contourCount; ++iContour) {
+        md_uint32 iBeg = md_polygon_get_contour_beg__software(pPolygon, iContour);
+        md_uint32 iEnd = md_polygon_get_contour_end__software(pPolygon, iContour);
+        md_bool32 isClosed = (pPolygon->pContourEnds[iContour] & MD_SOFTWARE_CONTOUR_CLOSED) != 0;
+        md_uint32 iPoint;
+        md_result result;
+
+        /* Zero length segments have no direction, so they are dropped up front. */
+        md_polygon_reset__software(pContour);
+        for (iPoint = iBeg; iPoint < iEnd; ++iPoint) {
+            float x = pPolygon->pPoints[iPoint*2 + 0];
+            float y = pPolygon->pPoints[iPoint*2 + 1];
+
+            if (pContour->pointCount > 0) {
+                float dx = x - pContour->pPoints[pContour->pointCount*2 - 2];
+                float dy = y - pContour->pPoints[pContour->pointCount*2 - 1];
+                if (dx*dx + dy*dy < 1e-8f) {
+                    continue;
                 }
+            }
+
+            result = md_polygon_add_point__software(pContour, x, y);
+            if (result != MD_SUCCESS) {
+                return result;
+            }
+        }
+
+        if (isClosed && pContour->pointCount > 1) {
+            float dx = pContour->pPoints[0] - pContour->pPoints[pContour->pointCount*2 - 2];
+            float dy = pContour->pPoints[1] - pContour->pPoints[pContour->pointCount*2 - 1];
+            if (dx*dx + dy*dy < 1e-8f) {
+                pContour->pointCount -= 1;
+            }
+        }
+
+        if (pParams->dashCount > 0) {
+            result = md_stroke_dashed_polyline__software(pOutput, &pGC->software.strokeDash, pParams, pContour->pPoints, pContour->pointCount, isClosed);
+        } else {
+            result = md_stroke_polyline__software(pOutput, pParams, pContour->pPoints, pContour->pointCount, isClosed);
+        }
+
+        if (result != MD_SUCCESS) {
+            return result;
+        }
+    }
+
+    return MD_SUCCESS;
+}
+
+MD_PRIVATE void md_stroke_params_init__software(const md_gc_state_software* pState, md_stroke_params_software* pParams)
+{
+    float scale = md_matrix_get_scale__software(&pState->matrix);
+    float dashLength = 0;
+    md_uint32 iDash;
+
+    MD_ZERO_OBJECT(pParams);
+    pParams->halfWidth  = pState->lineWidth * 0.5f * scale;
+    pParams->lineCap    = pState->lineCap;
+    pParams->lineJoin   = pState->lineJoin;
+    pParams->miterLimit = pState->miterLimit;
+    pParams->isHairline = (pParams->halfWidth <= 0.5f);
+
+    for (iDash = 0; iDash < pState->dashCount; ++iDash) {
+        if (pState->dashes[iDash] < 0) {
+            return; /* Invalid dash pattern. Draw solid. */
+        }
+
+        dashLength += pState->dashes[iDash];
+    }
+
+    if (dashLength > 0) {
+        pParams->dashCount = pState->dashCount;
+        for (iDash = 0; iDash < pParams->dashCount; ++iDash) {
+            pParams->dashes[iDash] = pState->dashes[iDash] * scale;
+        }
+    }
+}
+
+
+/* Glyph Cache */
+MD_PRIVATE md_result md_glyph_cache_init__software(md_uint32 capacity, md_glyph_cache_software* pCache)
+{
+    md_uint32 slotCount;
+
+    MD_ASSERT(pCache != NULL);
+
+    MD_ZERO_OBJECT(pCache);
+
+    if (capacity == 0) {
+        capacity = 1024;
+    }
+    capacity = MD_MIN(capacity, 0x10000000);
+
+    /* The hash table is kept no more than half full so probe sequences stay short. */
+    slotCount = 1;
+    while (slotCount < capacity*2) {
+        slotCount <<= 1;
+    }
+
+    pCache->pEntries = (md_glyph_cache_entry_software*)MD_MALLOC(sizeof(*pCache->pEntries) * capacity);
+    if (pCache->pEntries == NULL) {
+        return MD_OUT_OF_MEMORY;
+    }
+
+    pCache->pSlots = (md_uint32*)MD_CALLOC(slotCount, sizeof(*pCache->pSlots));
+    if (pCache->pSlots == NULL) {
+        MD_FREE(pCache->pEntries);
+        pCache->pEntries = NULL;
+        return MD_OUT_OF_MEMORY;
+    }
+
+    pCache->capacity = capacity;
+    pCache->slotMask = slotCount - 1;
+
+    return MD_SUCCESS;
+}
+
+MD_PRIVATE void md_glyph_cache_flush__software(md_glyph_cache_software* pCache)
+{
+    md_uint32 iPage;
+
+    MD_ASSERT(pCache != NULL);
+
+    for (iPage = 0; iPage < pCache->pageCount; ++iPage) {
+        MD_FREE(pCache->ppPages[iPage]);
+    }
+
+    if (pCache->pSlots != NULL) {
+        MD_ZERO_MEMORY(pCache->pSlots, sizeof(*pCache->pSlots) * (pCache->slotMask + 1));
+    }
+
+    pCache->entryCount  = 0;
+    pCache->pageCount   = 0;
+    pCache->shelfX      = 0;
+    pCache->shelfY      = 0;
+    pCache->shelfHeight = 0;
+}
+
+MD_PRIVATE void md_glyph_cache_uninit__software(md_glyph_cache_software* pCache)
+{
+    MD_ASSERT(pCache != NULL);
+
+    md_glyph_cache_flush__software(pCache);
+
+    MD_FREE(pCache->ppPages);
+    MD_FREE(pCache->pSlots);
+    MD_FREE(pCache->pEntries);
+    MD_ZERO_OBJECT(pCache);
+}
+
+static MD_INLINE md_uint32 md_glyph_cache_make_key__software(md_uint32 glyphIndex, md_uint32 subX, md_uint32 subY)
+{
+    MD_ASSERT(subX < MD_SOFTWARE_GLYPH_SUBPIXEL_STEPS && subY < MD_SOFTWARE_GLYPH_SUBPIXEL_STEPS);
+    return (glyphIndex << 4) | (subY << 2) | subX;
+}
+
+static MD_INLINE md_uint32 md_glyph_cache_hash__software(md_uint32 key)
+{
+    md_uint32 hash = key * 0x9E3779B1;
+    return hash ^ (hash >> 15);
+}
+
+MD_PRIVATE md_result md_glyph_cache_alloc_rect__software(md_glyph_cache_software* pCache, md_uint32 sizeX, md_uint32 sizeY, md_glyph_cache_entry_software* pEntry)
+{
+    MD_ASSERT(sizeX <= MD_SOFTWARE_GLYPH_ATLAS_SIZE && sizeY <= MD_SOFTWARE_GLYPH_ATLAS_SIZE);
+
+    /* Move down to a new shelf if the glyph doesn't fit on the end of the current one, and onto a new page if it doesn't fit below it. */
+    if (pCache->shelfX + sizeX > MD_SOFTWARE_GLYPH_ATLAS_SIZE) {
+        pCache->shelfX      = 0;
+        pCache->shelfY     += pCache->shelfHeight;
+        pCache->shelfHeight = 0;
+    }
+
+    if (pCache->pageCount == 0 || pCache->shelfY + sizeY > MD_SOFTWARE_GLYPH_ATLAS_SIZE) {
+        md_uint8* pPage;
+
+        if (pCache->pageCount == pCache->pageCap) {
+            md_uint32 newPageCap = MD_MAX(4, pCache->pageCap * 2);
+            md_uint8** ppNewPages = (md_uint8**)MD_REALLOC(pCache->ppPages, sizeof(*ppNewPages) * newPageCap);
+            if (ppNewPages == NULL) {
+                return MD_OUT_OF_MEMORY;
+            }
+
+            pCache->ppPages = ppNewPages;
+            pCache->pageCap = newPageCap;
+        }
+
+        pPage = (md_uint8*)MD_MALLOC(MD_SOFTWARE_GLYPH_ATLAS_SIZE * MD_SOFTWARE_GLYPH_ATLAS_SIZE);
+        if (pPage == NULL) {
+            return MD_OUT_OF_MEMORY;
+        }
+
+        pCache->ppPages[pCache->pageCount] = pPage;
+        pCache->pageCount  += 1;
+        pCache->shelfX      = 0;
+        pCache->shelfY      = 0;
+        pCache->shelfHeight = 0;
+    }
+
+    pEntry->page  = pCache->pageCount - 1;
+    pEntry->x     = (md_uint16)pCache->shelfX;
+    pEntry->y     = (md_uint16)pCache->shelfY;
+    pEntry->sizeX = (md_uint16)sizeX;
+    pEntry->sizeY = (md_uint16)sizeY;
+
+    pCache->shelfX     += sizeX;
+    pCache->shelfHeight = MD_MAX(pCache->shelfHeight, sizeY);
+
+    return MD_SUCCESS;
+}
+
+static MD_INLINE md_uint32 md_glyph_cell_coverage__software(const md_uint8* pBitmap, md_int32 scale, md_int32 px, md_int32 py)
+{
+    /* Whether or not the pixel at the given position of the unshifted glyph is lit. */
+    if (px < 0 || py < 0 || px >= 8*scale || py >= 8*scale) {
+        return 0;
+    }
+
+    return (pBitmap[py / scale] >> (px / scale)) & 1;
+}
+
+MD_PRIVATE void md_glyph_render__software(const md_uint8* pBitmap, md_int32 scale, md_uint32 subX, md_uint32 subY, md_int32 originX, md_int32 originY, md_uint32 sizeX, md_uint32 sizeY, md_uint8* pDst, md_uint32 dstStride)
+{
+    /*
+    The glyph is a set of whole pixel squares shifted to the right and down by a fraction of a pixel, so each output pixel is covered by at most four of
+    them. The coverage is exactly the area of those squares that fall within the pixel.
+    */
+    const md_uint32 wx0 = subX;
+    const md_uint32 wx1 = MD_SOFTWARE_GLYPH_SUBPIXEL_STEPS - subX;
+    const md_uint32 wy0 = subY;
+    const md_uint32 wy1 = MD_SOFTWARE_GLYPH_SUBPIXEL_STEPS - subY;
+    const md_uint32 total = MD_SOFTWARE_GLYPH_SUBPIXEL_STEPS * MD_SOFTWARE_GLYPH_SUBPIXEL_STEPS;
+    md_uint32 row;
+    md_uint32 col;
+
+    for (row = 0; row < sizeY; ++row) {
+        md_int32 py = originY + (md_int32)row;
+
+        for (col = 0; col < sizeX; ++col) {
+            md_int32 px = originX + (md_int32)col;
+            md_uint32 area =
+                wy0 * (wx0 * md_glyph_cell_coverage__software(pBitmap, scale, px - 1, py - 1) + wx1 * md_glyph_cell_coverage__software(pBitmap, scale, px, py - 1)) +
+                wy1 * (wx0 * md_glyph_cell_coverage__software(pBitmap, scale, px - 1, py    ) + wx1 * md_glyph_cell_coverage__software(pBitmap, scale, px, py    ));
+
+            pDst[row*dstStride + col] = (md_uint8)((area*255 + total/2) / total);
+        }
+    }
+}
+
+MD_PRIVATE md_result md_glyph_cache_get__software(md_font* pFont, md_uint32 glyphIndex, md_uint32 subX, md_uint32 subY, const md_glyph_cache_entry_software** ppEntry)
+{
+    md_glyph_cache_software* pCache = &pFont->software.glyphCache;
+    md_glyph_cache_entry_software* pEntry;
+    const md_uint8* pBitmap;
+    md_int32 scale = (md_int32)pFont->software.scale;
+    md_uint32 key;
+    md_uint32 iSlot;
+    md_int32 rowBeg = 8;
+    md_int32 rowEnd = 0;
+    md_int32 colBeg = 8;
+    md_int32 colEnd = 0;
+    md_int32 row;
+    md_result result;
+
+    key = md_glyph_cache_make_key__software(glyphIndex, subX, subY);
+
+    for (iSlot = md_glyph_cache_hash__software(key) & pCache->slotMask; pCache->pSlots[iSlot] != 0; iSlot = (iSlot + 1) & pCache->slotMask) {
+        if (pCache->pEntries[pCache->pSlots[iSlot] - 1].key == key) {
+            pCache->hitCount += 1;
+            *ppEntry = &pCache->pEntries[pCache->pSlots[iSlot] - 1];
+            return MD_SUCCESS;
+        }
+    }
+
+    /* Not cached. Everything is thrown away when the cache is full which keeps things simple. Text tends to reuse a small set of glyphs anyway. */
+    pCache->missCount += 1;
+
+    if (pCache->entryCount == pCache->capacity) {
+        md_glyph_cache_flush__software(pCache);
+        iSlot = md_glyph_cache_hash__software(key) & pCache->slotMask;
+    }
+
+    pEntry = &pCache->pEntries[pCache->entryCount];
+    MD_ZERO_OBJECT(pEntry);
+    pEntry->key = key;
+
+    /* Only the cells that are lit need to be stored. Subpixel positioning bleeds into one extra row and column. */
+    pBitmap = md_get_glyph_bitmap__software(glyphIndex);
+    for (row = 0; row < 8; ++row) {
+        if (pBitmap[row] != 0) {
+            md_int32 col;
+
+            rowBeg = MD_MIN(rowBeg, row);
+            rowEnd = row + 1;
+
+            for (col = 0; col < 8; ++col) {
+                if ((pBitmap[row] & (1 << col)) != 0) {
+                    colBeg = MD_MIN(colBeg, col);
+                    colEnd = MD_MAX(colEnd, col + 1);
+                }
+            }
+        }
+    }
+
+    if (rowEnd > rowBeg) {
+        md_uint32 sizeX = (md_uint32)((colEnd - colBeg)*scale + ((subX > 0) ? 1 : 0));
+        md_uint32 sizeY = (md_uint32)((rowEnd - rowBeg)*scale + ((subY > 0) ? 1 : 0));
+
+        result = md_glyph_cache_alloc_rect__software(pCache, sizeX, sizeY, pEntry);
+        if (result != MD_SUCCESS) {
+            return result;
+        }
+
+        pEntry->offsetX = (md_int16)(colBeg*scale);
+        pEntry->offsetY = (md_int16)(rowBeg*scale);
+
+        md_glyph_render__software(pBitmap, scale, subX, subY, pEntry->offsetX, pEntry->offsetY, sizeX, sizeY, pCache->ppPages[pEntry->page] + pEntry->y*MD_SOFTWARE_GLYPH_ATLAS_SIZE + pEntry->x, MD_SOFTWARE_GLYPH_ATLAS_SIZE);
+    }
+
+    pCache->pSlots[iSlot] = pCache->entryCount + 1;
+    pCache->entryCount += 1;
+
+    *ppEntry = pEntry;
+    return MD_SUCCESS;
+}
+
+
+/* Font */
+md_result md_font_init__software(md_api* pAPI, const md_font_config* pConfig, md_font* pFont)
+{
+    md_uint32 sizeInPixels;
+
+    MD_ASSERT(pAPI    != NULL);
+    MD_ASSERT(pConfig != NULL);
+    MD_ASSERT(pFont   != NULL);
+
+    (void)pAPI;
+
+    sizeInPixels = pConfig->sizeInPixels;
+    if (sizeInPixels == 0) {
+        sizeInPixels = (pConfig->sizeInPoints * 96) / 72;   /* Assume 96 DPI. */
+    }
+
+    /* The built-in font is scaled up by whole multiples of its 8x8 cell. The baseline sits above the bottom row which is used for descenders. */
+    pFont->software.scale = MD_MAX(1, (sizeInPixels + 4) / 8);
+
+    pFont->metrics.ascent  =  7 * (md_int32)pFont->software.scale;
+    pFont->metrics.descent = -1 * (md_int32)pFont->software.scale;
+
+    return md_glyph_cache_init__software(pConfig->software.glyphCacheCapacity, &pFont->software.glyphCache);
+}
+
+void md_font_uninit__software(md_font* pFont)
+{
+    MD_ASSERT(pFont != NULL);
+
+    md_glyph_cache_uninit__software(&pFont->software.glyphCache);
+    pFont->software.scale = 0;
+}
+
+MD_PRIVATE void md_font_get_glyph_metrics_single__software(md_font* pFont, md_uint32 glyphIndex, md_glyph_metrics* pGlyphMetrics)
+{
+    md_int32 cellSize = 8 * (md_int32)pFont->software.scale;
+
+    (void)glyphIndex;   /* Every glyph in the built-in font occupies the same cell. */
+
+    pGlyphMetrics->sizeX    = cellSize;
+    pGlyphMetrics->sizeY    = cellSize;
+    pGlyphMetrics->bearingX = 0;
+    pGlyphMetrics->bearingY = -pFont->metrics.ascent;
+    pGlyphMetrics->advanceX = cellSize;
+    pGlyphMetrics->advanceY = 0;
+}
+
+md_result md_font_get_glyph_metrics__software(md_font* pFont, const md_glyph* pGlyphs, size_t glyphCount, md_glyph_metrics* pGlyphMetrics)
+{
+    size_t iGlyph;
+
+    MD_ASSERT(pFont         != NULL);
+    MD_ASSERT(pGlyphs       != NULL);
+    MD_ASSERT(pGlyphMetrics != NULL);
+
+    for (iGlyph = 0; iGlyph < glyphCount; ++iGlyph) {
+        md_font_get_glyph_metrics_single__software(pFont, pGlyphs[iGlyph].index, &pGlyphMetrics[iGlyph]);
+    }
+
+    return MD_SUCCESS;
+}
+
+md_result md_font_get_glyph_metrics_by_index__software(md_font* pFont, const md_uint32* pGlyphIndices, size_t glyphCount, md_glyph_metrics* pGlyphMetrics)
+{
+    size_t iGlyph;
+
+    MD_ASSERT(pFont         != NULL);
+    MD_ASSERT(pGlyphIndices != NULL);
+    MD_ASSERT(pGlyphMetrics != NULL);
+
+    for (iGlyph = 0; iGlyph < glyphCount; ++iGlyph) {
+        md_font_get_glyph_metrics_single__software(pFont, pGlyphIndices[iGlyph], &pGlyphMetrics[iGlyph]);
+    }
+
+    return MD_SUCCESS;
+}
+
+md_result md_font_get_glyph_cache_stats__software(md_font* pFont, md_glyph_cache_stats* pStats)
+{
+    MD_ASSERT(pFont  != NULL);
+    MD_ASSERT(pStats != NULL);
+
+    pStats->hitCount   = pFont->software.glyphCache.hitCount;
+    pStats->missCount  = pFont->software.glyphCache.missCount;
+    pStats->glyphCount = pFont->software.glyphCache.entryCount;
+    pStats->capacity   = pFont->software.glyphCache.capacity;
+
+    return MD_SUCCESS;
+}
+
+
+/* Brush */
+md_result md_brush_init__software(md_api* pAPI, const md_brush_config* pConfig, md_brush* pBrush)
+{
+    MD_ASSERT(pAPI    != NULL);
+    MD_ASSERT(pConfig != NULL);
+    MD_ASSERT(pBrush  != NULL);
+
+    (void)pAPI;
+
+    switch (pConfig->type)
+    {
+        case md_brush_type_solid:
+        {
+        } break;
+
+        case md_brush_type_gc:
+        {
+            if (pConfig->gc.pGC == NULL || pConfig->gc.pGC->software.pImageData == NULL) {
+                return MD_INVALID_ARGS; /* Source GC is not in a valid state. */
+            }
+        } break;
+
+        case md_brush_type_linear:
+        case md_brush_type_radial:
+        {
+            if (pConfig->pColorStops == NULL && pConfig->colorStopCount > 0) {
+                return MD_INVALID_ARGS;
+            }
+
+            /* The color stops are baked into a ramp once here so filling only needs to do a lookup for each pixel. */
+            pBrush->software.pRamp = md_gradient_ramp_alloc__software(pConfig->pColorStops, pConfig->colorStopCount);
+            if (pBrush->software.pRamp == NULL) {
+                return MD_OUT_OF_MEMORY;
+            }
+        } break;
+
+        default:
+        {
+            return MD_INVALID_ARGS;
+        };
+    }
+
+    pBrush->software.originX = 0;
+    pBrush->software.originY = 0;
+
+    return MD_SUCCESS;
+}
+
+void md_brush_uninit__software(md_brush* pBrush)
+{
+    MD_ASSERT(pBrush != NULL);
+
+    MD_FREE(pBrush->software.pRamp);
+    pBrush->software.pRamp = NULL;
+}
+
+void md_brush_set_origin__software(md_brush* pBrush, md_int32 x, md_int32 y)
+{
+    MD_ASSERT(pBrush != NULL);
+
+    pBrush->software.originX = x;
+    pBrush->software.originY = y;
+}
+
+
+/* Graphics */
+md_result md_gc_init__software(md_api* pAPI, const md_gc_config* pConfig, md_gc* pGC)
+{
+    md_result result;
+
+    MD_ASSERT(pAPI    != NULL);
+    MD_ASSERT(pConfig != NULL);
+    MD_ASSERT(pGC     != NULL);
+
+    (void)pAPI;
+
+    if (pConfig->sizeX == 0 || pConfig->sizeY == 0) {
+        return MD_INVALID_ARGS;
+    }
+
+    pGC->isTransient = MD_FALSE;
+    pGC->format = pConfig->format;
+    pGC->software.sizeX = pConfig->sizeX;
+    pGC->software.sizeY = pConfig->sizeY;
+
+    if (pConfig->software.pImageData != NULL) {
+        /* Rendering straight into an application-defined buffer. */
+        pGC->software.pImageData    = (md_uint32*)pConfig->software.pImageData;
+        pGC->software.stride        = (pConfig->stride != 0) ? pConfig->stride : pConfig->sizeX;
+        pGC->software.ownsImageData = MD_FALSE;
+    } else {
+        pGC->software.stride     = pConfig->sizeX;
+        pGC->software.pImageData = (md_uint32*)MD_MALLOC(pConfig->sizeX * pConfig->sizeY * sizeof(md_uint32));
+        if (pGC->software.pImageData == NULL) {
+            return MD_OUT_OF_MEMORY;
+        }
+
+        if (pConfig->pInitialImageData != NULL) {
+            /* Image data needs to be converted. */
+            md_copy_image_data(pGC->software.pImageData, pConfig->pInitialImageData, pConfig->sizeX, pConfig->sizeY, 0, md_get_native_format__software(), pConfig->stride, pConfig->format);
+        } else {
+            /* Clear to zero initially. */
+            MD_ZERO_MEMORY(pGC->software.pImageData, pConfig->sizeX * pConfig->sizeY * sizeof(md_uint32));
+        }
+
+        pGC->software.ownsImageData = MD_TRUE;
+    }
+
+    result = md_rasterizer_init__software(pConfig->sizeX, &pGC->software.rasterizer);
+    if (result != MD_SUCCESS) {
+        if (pGC->software.ownsImageData) {
+            MD_FREE(pGC->software.pImageData);
+        }
+        pGC->software.pImageData = NULL;
+        return result;
+    }
+
+    /* We need at least one item in the state stack. */
+    pGC->software.stateCount = 1;
+    pGC->software.stateCap   = 1;
+    pGC->software.pState = (md_gc_state_software*)MD_CALLOC(pGC->software.stateCap, sizeof(*pGC->software.pState));
+    if (pGC->software.pState == NULL) {
+        md_rasterizer_uninit__software(&pGC->software.rasterizer);
+
+        if (pGC->software.ownsImageData) {
+            MD_FREE(pGC->software.pImageData);
+        }
+        pGC->software.pImageData = NULL;
+        return MD_OUT_OF_MEMORY;
+    }
+
+    /* Worker threads for splitting large surfaces into tiles which are rendered in parallel. */
+    pGC->software.tileSize = (pConfig->software.tileSize != 0) ? pConfig->software.tileSize : 64;
+
+    result = md_gc_init_workers__software(pGC, pConfig->software.threadCount);
+    if (result != MD_SUCCESS) {
+        MD_FREE(pGC->software.pState);
+        pGC->software.pState = NULL;
+
+        md_rasterizer_uninit__software(&pGC->software.rasterizer);
+
+        if (pGC->software.ownsImageData) {
+            MD_FREE(pGC->software.pImageData);
+        }
+        pGC->software.pImageData = NULL;
+        return result;
+    }
+
+    /* Defaults match those of the Cairo backend. */
+    md_matrix_init_identity__software(&pGC->software.pState[0].matrix);
+    pGC->software.pState[0].lineWidth   = 1;
+    pGC->software.pState[0].miterLimit  = 10;
+    pGC->software.pState[0].blendOp     = md_blend_op_src;
+    pGC->software.pState[0].textFGColor = md_rgba(0, 0, 0, 255);
+    pGC->software.pState[0].clipRight   = (md_int32)pGC->software.sizeX;
+    pGC->software.pState[0].clipBottom  = (md_int32)pGC->software.sizeY;
+
+    return MD_SUCCESS;
+}
+
+void md_gc_uninit__software(md_gc* pGC)
+{
+    md_uint32 iState;
+
+    MD_ASSERT(pGC != NULL);
+
+    md_gc_uninit_workers__software(pGC);
+
+    for (iState = 0; iState < pGC->software.stateCount; ++iState) {
+        md_clip_mask_release__software(pGC->software.pState[iState].pClipMask);
+    }
+
+    MD_FREE(pGC->software.pState);
+    pGC->software.pState = NULL;
+
+    md_path_uninit__software(&pGC->software.path);
+    md_polygon_uninit__software(&pGC->software.stroke);
+    md_polygon_uninit__software(&pGC->software.strokeSource);
+    md_polygon_uninit__software(&pGC->software.strokeContour);
+    md_polygon_uninit__software(&pGC->software.strokeDash);
+    md_polygon_uninit__software(&pGC->software.scratch);
+
+    MD_FREE(pGC->software.pEdges);
+    MD_FREE(pGC->software.pTileBins);
+    pGC->software.pEdges    = NULL;
+    pGC->software.pTileBins = NULL;
+
+    md_rasterizer_uninit__software(&pGC->software.rasterizer);
+
+    if (pGC->software.ownsImageData) {
+        MD_FREE(pGC->software.pImageData);
+    }
+    pGC->software.pImageData = NULL;
+}
+
+md_result md_gc_get_size__software(md_gc* pGC, md_uint32* pSizeX, md_uint32* pSizeY)
+{
+    MD_ASSERT(pGC    != NULL);
+    MD_ASSERT(pSizeX != NULL);
+    MD_ASSERT(pSizeY != NULL);
+
+    *pSizeX = pGC->software.sizeX;
+    *pSizeY = pGC->software.sizeY;
+
+    return MD_SUCCESS;
+}
+
+md_result md_gc_get_image_data__software(md_gc* pGC, md_format outputFormat, void* pImageData)
+{
+    MD_ASSERT(pGC != NULL);
+
+    md_copy_image_data(pImageData, pGC->software.pImageData, pGC->software.sizeX, pGC->software.sizeY, 0, outputFormat, pGC->software.stride, md_get_native_format__software());
+
+    return MD_SUCCESS;
+}
+
+md_result md_gc_save__software(md_gc* pGC)
+{
+    md_gc_state_software* pNewState;
+
+    MD_ASSERT(pGC != NULL);
+    MD_ASSERT(pGC->software.stateCount > 0);
+
+    if (pGC->software.stateCount == pGC->software.stateCap) {
+        md_uint32 newCap = MD_MAX(1, pGC->software.stateCap * 2);
+        md_gc_state_software* pNewStates = (md_gc_state_software*)MD_REALLOC(pGC->software.pState, newCap * sizeof(*pNewStates));
+        if (pNewStates == NULL) {
+            return MD_OUT_OF_MEMORY;
+        }
+
+        pGC->software.pState   = pNewStates;
+        pGC->software.stateCap = newCap;
+    }
+
+    MD_ASSERT(pGC->software.stateCount < pGC->software.stateCap);
+
+    pNewState = &pGC->software.pState[pGC->software.stateCount];
+    *pNewState = pGC->software.pState[pGC->software.stateCount-1];
+
+    /* Clip masks are never modified after they're built so the new state can just share it. */
+    md_clip_mask_retain__software(pNewState->pClipMask);
+
+    pGC->software.stateCount += 1;
+
+    return MD_SUCCESS;
+}
+
+md_result md_gc_restore__software(md_gc* pGC)
+{
+    MD_ASSERT(pGC != NULL);
+    MD_ASSERT(pGC->software.stateCount > 0);
+
+    if (pGC->software.stateCount == 1) {
+        return MD_INVALID_OPERATION;    /* Nothing to restore. */
+    }
+
+    pGC->software.stateCount -= 1;
+    md_clip_mask_release__software(pGC->software.pState[pGC->software.stateCount].pClipMask);
+
+    return MD_SUCCESS;
+}
+
+void md_gc_set_matrix__software(md_gc* pGC, const md_matrix* pMatrix)
+{
+    MD_ASSERT(pGC != NULL);
+    MD_ASSERT(pMatrix != NULL);
+
+    pGC->software.pState[pGC->software.stateCount-1].matrix = *pMatrix;
+}
+
+void md_gc_get_matrix__software(md_gc* pGC, md_matrix* pMatrix)
+{
+    MD_ASSERT(pGC != NULL);
+    MD_ASSERT(pMatrix != NULL);
+
+    *pMatrix = pGC->software.pState[pGC->software.stateCount-1].matrix;
+}
+
+void md_gc_set_matrix_identity__software(md_gc* pGC)
+{
+    MD_ASSERT(pGC != NULL);
+
+    md_matrix_init_identity__software(&pGC->software.pState[pGC->software.stateCount-1].matrix);
+}
+
+void md_gc_transform__software(md_gc* pGC, const md_matrix* pMatrix)
+{
+    md_matrix* pCurrent;
+
+    MD_ASSERT(pGC != NULL);
+    MD_ASSERT(pMatrix != NULL);
+
+    /* Same as cairo_transform(). The new matrix is applied to user space before the existing one. */
+    pCurrent = &pGC->software.pState[pGC->software.stateCount-1].matrix;
+    md_matrix_multiply__software(pCurrent, pCurrent, pMatrix);
+}
+
+void md_gc_translate__software(md_gc* pGC, md_int32 offsetX, md_int32 offsetY)
+{
+    md_matrix m;
+
+    MD_ASSERT(pGC != NULL);
+
+    md_matrix_init_identity__software(&m);
+    m.dx = (float)offsetX;
+    m.dy = (float)offsetY;
+
+    md_gc_transform__software(pGC, &m);
+}
+
+void md_gc_rotate__software(md_gc* pGC, float rotationInRadians)
+{
+    md_matrix m;
+    float c;
+    float s;
+
+    MD_ASSERT(pGC != NULL);
+
+    c = (float)cos(rotationInRadians);
+    s = (float)sin(rotationInRadians);
+
+    m.m00 =  c;
+    m.m01 =  s;
+    m.m10 = -s;
+    m.m11 =  c;
+    m.dx  =  0;
+    m.dy  =  0;
+
+    md_gc_transform__software(pGC, &m);
+}
+
+void md_gc_scale__software(md_gc* pGC, float scaleX, float scaleY)
+{
+    md_matrix m;
+
+    MD_ASSERT(pGC != NULL);
+
+    md_matrix_init_identity__software(&m);
+    m.m00 = scaleX;
+    m.m11 = scaleY;
+
+    md_gc_transform__software(pGC, &m);
+}
+
+void md_gc_set_miter_limit__software(md_gc* pGC, float limit)
+{
+    MD_ASSERT(pGC != NULL);
+
+    pGC->software.pState[pGC->software.stateCount-1].miterLimit = limit;
+}
+
+void md_gc_set_line_width__software(md_gc* pGC, md_int32 width)
+{
+    MD_ASSERT(pGC != NULL);
+
+    pGC->software.pState[pGC->software.stateCount-1].lineWidth = (float)width;
+}
+
+void md_gc_set_line_cap__software(md_gc* pGC, md_line_cap cap)
+{
+    MD_ASSERT(pGC != NULL);
+
+    pGC->software.pState[pGC->software.stateCount-1].lineCap = cap;
+}
+
+void md_gc_set_line_join__software(md_gc* pGC, md_line_join join)
+{
+    MD_ASSERT(pGC != NULL);
+
+    pGC->software.pState[pGC->software.stateCount-1].lineJoin = join;
+}
+
+void md_gc_set_line_dash__software(md_gc* pGC, const float* dashes, md_uint32 count)
+{
+    md_gc_state_software* pState;
+    md_uint32 iDash;
+
+    MD_ASSERT(pGC != NULL);
+    MD_ASSERT(count <= 16);
+
+    pState = &pGC->software.pState[pGC->software.stateCount-1];
+    pState->dashCount = MD_MIN(count, MD_COUNTOF(pState->dashes));
+
+    for (iDash = 0; iDash < pState->dashCount; ++iDash) {
+        pState->dashes[iDash] = dashes[iDash];
+    }
+}
+
+void md_gc_set_line_brush__software(md_gc* pGC, md_brush* pBrush)
+{
+    md_uint32 iState;
+
+    MD_ASSERT(pGC != NULL);
+
+    iState = pGC->software.stateCount-1;
+    pGC->software.pState[iState].pLineBrush = pBrush;
+    pGC->software.pState[iState].hasTransientLineBrush = MD_FALSE;
+}
+
+void md_gc_set_line_brush_solid__software(md_gc* pGC, md_color color)
+{
+    md_uint32 iState;
+
+    MD_ASSERT(pGC != NULL);
+
+    iState = pGC->software.stateCount-1;
+    pGC->software.pState[iState].transientLineBrush.type = md_brush_type_solid;
+    pGC->software.pState[iState].transientLineBrush.solid.color = color;
+    pGC->software.pState[iState].pLineBrush = NULL;
+    pGC->software.pState[iState].hasTransientLineBrush = MD_TRUE;
+}
+
+void md_gc_set_line_brush_gc__software(md_gc* pGC, md_gc* pSrcGC)
+{
+    md_uint32 iState;
+
+    MD_ASSERT(pGC != NULL);
+
+    iState = pGC->software.stateCount-1;
+    pGC->software.pState[iState].transientLineBrush.type = md_brush_type_gc;
+    pGC->software.pState[iState].transientLineBrush.gc.pGC = pSrcGC;
+    pGC->software.pState[iState].pLineBrush = NULL;
+    pGC->software.pState[iState].hasTransientLineBrush = MD_TRUE;
+}
+
+void md_gc_set_fill_brush__software(md_gc* pGC, md_brush* pBrush)
+{
+    md_uint32 iState;
+
+    MD_ASSERT(pGC != NULL);
+
+    iState = pGC->software.stateCount-1;
+    pGC->software.pState[iState].pFillBrush = pBrush;
+    pGC->software.pState[iState].hasTransientFillBrush = MD_FALSE;
+}
+
+void md_gc_set_fill_brush_solid__software(md_gc* pGC, md_color color)
+{
+    md_uint32 iState;
+
+    MD_ASSERT(pGC != NULL);
+
+    iState = pGC->software.stateCount-1;
+    pGC->software.pState[iState].transientFillBrush.type = md_brush_type_solid;
+    pGC->software.pState[iState].transientFillBrush.solid.color = color;
+    pGC->software.pState[iState].pFillBrush = NULL;
+    pGC->software.pState[iState].hasTransientFillBrush = MD_TRUE;
+}
+
+void md_gc_set_fill_brush_gc__software(md_gc* pGC, md_gc* pSrcGC)
+{
+    md_uint32 iState;
+
+    MD_ASSERT(pGC != NULL);
+
+    iState = pGC->software.stateCount-1;
+    pGC->software.pState[iState].transientFillBrush.type = md_brush_type_gc;
+    pGC->software.pState[iState].transientFillBrush.gc.pGC = pSrcGC;
+    pGC->software.pState[iState].pFillBrush = NULL;
+    pGC->software.pState[iState].hasTransientFillBrush = MD_TRUE;
+}
+
+void md_gc_set_text_fg_color__software(md_gc* pGC, md_color fgColor)
+{
+    MD_ASSERT(pGC != NULL);
+
+    pGC->software.pState[pGC->software.stateCount-1].textFGColor = fgColor;
+}
+
+void md_gc_set_text_bg_color__software(md_gc* pGC, md_color bgColor)
+{
+    MD_ASSERT(pGC != NULL);
+
+    pGC->software.pState[pGC->software.stateCount-1].textBGColor = bgColor;
+}
+
+md_color md_gc_get_text_fg_color__software(md_gc* pGC)
+{
+    MD_ASSERT(pGC != NULL);
+
+    return pGC->software.pState[pGC->software.stateCount-1].textFGColor;
+}
+
+md_color md_gc_get_text_bg_color__software(md_gc* pGC)
+{
+    MD_ASSERT(pGC != NULL);
+
+    return pGC->software.pState[pGC->software.stateCount-1].textBGColor;
+}
+
+void md_gc_set_blend_op__software(md_gc* pGC, md_blend_op op)
+{
+    MD_ASSERT(pGC != NULL);
+
+    pGC->software.pState[pGC->software.stateCount-1].blendOp = op;
+}
+
+void md_gc_set_antialias_mode__software(md_gc* pGC, md_antialias_mode mode)
+{
+    MD_ASSERT(pGC != NULL);
+
+    pGC->software.pState[pGC->software.stateCount-1].antialiasMode = mode;
+}
+
+void md_gc_set_fill_mode__software(md_gc* pGC, md_fill_mode mode)
+{
+    MD_ASSERT(pGC != NULL);
+
+    pGC->software.pState[pGC->software.stateCount-1].fillMode = mode;
+}
+
+void md_gc_set_stretch_filter__software(md_gc* pGC, md_stretch_filter filter)
+{
+    MD_ASSERT(pGC != NULL);
+
+    pGC->software.pState[pGC->software.stateCount-1].stretchFilter = filter;
+}
+
+void md_gc_move_to__software(md_gc* pGC, md_int32 x, md_int32 y)
+{
+    MD_ASSERT(pGC != NULL);
+
+    md_path_move_to__software(&pGC->software.path, &pGC->software.pState[pGC->software.stateCount-1].matrix, (float)x, (float)y);
+}
+
+void md_gc_line_to__software(md_gc* pGC, md_int32 x, md_int32 y)
+{
+    MD_ASSERT(pGC != NULL);
+
+    md_path_line_to__software(&pGC->software.path, &pGC->software.pState[pGC->software.stateCount-1].matrix, (float)x, (float)y);
+}
+
+void md_gc_rectangle__software(md_gc* pGC, md_int32 left, md_int32 top, md_int32 right, md_int32 bottom)
+{
+    const md_matrix* pMatrix;
+
+    MD_ASSERT(pGC != NULL);
+
+    pMatrix = &pGC->software.pState[pGC->software.stateCount-1].matrix;
+
+    md_path_move_to__software(&pGC->software.path, pMatrix, (float)left,  (float)top);
+    md_path_line_to__software(&pGC->software.path, pMatrix, (float)right, (float)top);
+    md_path_line_to__software(&pGC->software.path, pMatrix, (float)right, (float)bottom);
+    md_path_line_to__software(&pGC->software.path, pMatrix, (float)left,  (float)bottom);
+    md_path_close__software(&pGC->software.path);
+}
+
+void md_gc_arc__software(md_gc* pGC, md_int32 x, md_int32 y, md_int32 radius, float angle1InRadians, float angle2InRadians)
+{
+    MD_ASSERT(pGC != NULL);
+
+    md_path_arc__software(&pGC->software.path, &pGC->software.pState[pGC->software.stateCount-1].matrix, (float)x, (float)y, (float)radius, angle1InRadians, angle2InRadians);
+}
+
+void md_gc_curve_to__software(md_gc* pGC, md_int32 x1, md_int32 y1, md_int32 x2, md_int32 y2, md_int32 x3, md_int32 y3)
+{
+    MD_ASSERT(pGC != NULL);
+
+    md_path_curve_to__software(&pGC->software.path, &pGC->software.pState[pGC->software.stateCount-1].matrix, (float)x1, (float)y1, (float)x2, (float)y2, (float)x3, (float)y3);
+}
+
+void md_gc_close_path__software(md_gc* pGC)
+{
+    MD_ASSERT(pGC != NULL);
+
+    md_path_close__software(&pGC->software.path);
+}
+
+typedef struct
+{
+    md_clip_mask_software* pMask;
+} md_clip_span_data_software;
+
+MD_PRIVATE void md_clip_span__software(void* pUserData, md_rasterizer_software* pRasterizer, md_int32 x, md_int32 y, md_int32 count, const md_uint8* pCoverage, md_uint8 coverage)
+{
+    md_clip_span_data_software* pData = (md_clip_span_data_software*)pUserData;
+    md_clip_mask_software* pMask = pData->pMask;
+    md_uint8* pRow;
+    md_int32 xEnd;
+    md_int32 i;
+
+    (void)pRasterizer;
+
+    /* The rasterizer only restricts rows to the clip rectangle so the span needs to be trimmed to the mask. */
+    if (y < pMask->top || y >= pMask->top + (md_int32)pMask->sizeY) {
+        return;
+    }
+
+    xEnd = MD_MIN(x + count, pMask->left + (md_int32)pMask->sizeX);
+    if (x < pMask->left) {
+        if (pCoverage != NULL) {
+            pCoverage += pMask->left - x;
+        }
+        x = pMask->left;
+    }
+
+    pRow = pMask->pCoverage + (y - pMask->top)*(md_int32)pMask->sizeX - pMask->left;
+    for (i = x; i < xEnd; ++i) {
+        pRow[i] = (pCoverage != NULL) ? pCoverage[i - x] : coverage;
+    }
+}
+
+static MD_INLINE void md_gc_intersect_clip_rect__software(md_gc_state_software* pState, md_int32 left, md_int32 top, md_int32 right, md_int32 bottom)
+{
+    pState->clipLeft   = MD_MAX(pState->clipLeft,   left);
+    pState->clipTop    = MD_MAX(pState->clipTop,    top);
+    pState->clipRight  = MD_MIN(pState->clipRight,  right);
+    pState->clipBottom = MD_MIN(pState->clipBottom, bottom);
+
+    /* Keep empty clips well formed so the rectangle can always be used as a range. */
+    if (pState->clipRight < pState->clipLeft) {
+        pState->clipRight = pState->clipLeft;
+    }
+    if (pState->clipBottom < pState->clipTop) {
+        pState->clipBottom = pState->clipTop;
+    }
+}
+
+/*
+Clipping is done in two parts. The first is a rectangle in whole pixels which is the only thing that's needed when clipping to an axis-aligned rectangle,
+which is by far the most common case. This costs nothing to set up, save and restore, and drawing just trims spans against it. Any other shape is
+rasterized into a coverage mask which covers just the clip rectangle, after the rectangle has been shrunk down to the bounds of the shape. Masks are
+read-only once they've been built so saving the state only needs to add a reference to the mask.
+*/
+void md_gc_clip__software(md_gc* pGC)
+{
+    md_gc_state_software* pState;
+    float rect[4];
+    md_uint32 rectCount;
+
+    MD_ASSERT(pGC != NULL);
+
+    pState = &pGC->software.pState[pGC->software.stateCount-1];
+
+    if (md_path_get_rectangles__software(&pGC->software.path, rect, 1, &rectCount) && (pState->antialiasMode == md_antialias_mode_none || md_is_rectangle_pixel_aligned__software(rect))) {
+        md_int32 pixels[4];
+        md_gc_get_rectangle_pixels__software(pGC, rect, pixels);
+        md_gc_intersect_clip_rect__software(pState, pixels[0], pixels[1], pixels[2], pixels[3]);
+    } else if (md_path_flatten__software(&pGC->software.path) == MD_SUCCESS) {
+        const md_polygon_software* pPolygon = &pGC->software.path.flattened;
+        md_clip_mask_software* pOldMask = pState->pClipMask;
+        md_clip_mask_software* pNewMask;
+        md_clip_span_data_software data;
+        md_gc_state_software oldState = *pState;
+        float minX =  3.402823466e+38f;
+        float minY =  3.402823466e+38f;
+        float maxX = -3.402823466e+38f;
+        float maxY = -3.402823466e+38f;
+        md_uint32 iPoint;
+
+        for (iPoint = 0; iPoint < pPolygon->pointCount; ++iPoint) {
+            minX = MD_MIN(minX, pPolygon->pPoints[iPoint*2 + 0]);
+            minY = MD_MIN(minY, pPolygon->pPoints[iPoint*2 + 1]);
+            maxX = MD_MAX(maxX, pPolygon->pPoints[iPoint*2 + 0]);
+            maxY = MD_MAX(maxY, pPolygon->pPoints[iPoint*2 + 1]);
+        }
+
+        /* Nothing outside the bounds of the shape can be visible. An empty path clips everything. */
+        if (pPolygon->pointCount > 0) {
+            minX = MD_CLAMP(minX, -1.0f, (float)pGC->software.sizeX + 1);
+            minY = MD_CLAMP(minY, -1.0f, (float)pGC->software.sizeY + 1);
+            maxX = MD_CLAMP(maxX, -1.0f, (float)pGC->software.sizeX + 1);
+            maxY = MD_CLAMP(maxY, -1.0f, (float)pGC->software.sizeY + 1);
+            md_gc_intersect_clip_rect__software(pState, (md_int32)floor(minX), (md_int32)floor(minY), (md_int32)ceil(maxX), (md_int32)ceil(maxY));
+        } else {
+            md_gc_intersect_clip_rect__software(pState, 0, 0, 0, 0);
+        }
+
+        if (pState->clipRight > pState->clipLeft && pState->clipBottom > pState->clipTop) {
+            pNewMask = md_clip_mask_alloc__software(pState->clipLeft, pState->clipTop, (md_uint32)(pState->clipRight - pState->clipLeft), (md_uint32)(pState->clipBottom - pState->clipTop));
+            if (pNewMask == NULL) {
+                *pState = oldState;     /* Out of memory. Leave the clip as it was. */
+            } else {
+                data.pMask = pNewMask;
+                md_rasterize_polygon__software(pGC, pPolygon, pState->fillMode, pState->antialiasMode, MD_TRUE, md_clip_span__software, &data);
+
+                /* The new clip region is the intersection with the existing one. The new mask is always inside the old one. */
+                if (pOldMask != NULL) {
+                    md_uint32 y;
+                    for (y = 0; y < pNewMask->sizeY; ++y) {
+                        md_uint8* pNewRow = pNewMask->pCoverage + y*pNewMask->sizeX;
+                        const md_uint8* pOldRow = pOldMask->pCoverage + (pNewMask->top + (md_int32)y - pOldMask->top)*(md_int32)pOldMask->sizeX + (pNewMask->left - pOldMask->left);
+                        md_uint32 x;
+
+                        for (x = 0; x < pNewMask->sizeX; ++x) {
+                            pNewRow[x] = (md_uint8)md_mul255__software(pNewRow[x], pOldRow[x]);
+                        }
+                    }
+                }
+
+                md_clip_mask_release__software(pOldMask);
+                pState->pClipMask = pNewMask;
+            }
+        } else {
+            /* Everything is clipped. A mask is not needed. */
+            md_clip_mask_release__software(pOldMask);
+            pState->pClipMask = NULL;
+        }
+    }
+
+    /* Like Cairo, clipping consumes the path. */
+    md_path_reset__software(&pGC->software.path);
+}
+
+void md_gc_reset_clip__software(md_gc* pGC)
+{
+    md_gc_state_software* pState;
+
+    MD_ASSERT(pGC != NULL);
+
+    pState = &pGC->software.pState[pGC->software.stateCount-1];
+
+    md_clip_mask_release__software(pState->pClipMask);
+    pState->pClipMask  = NULL;
+    pState->clipLeft   = 0;
+    pState->clipTop    = 0;
+    pState->clipRight  = (md_int32)pGC->software.sizeX;
+    pState->clipBottom = (md_int32)pGC->software.sizeY;
+}
+
+md_bool32 md_gc_is_point_inside_clip__software(md_gc* pGC, md_int32 x, md_int32 y)
+{
+    md_gc_state_software* pState;
+    float deviceX;
+    float deviceY;
+    md_int32 pixelX;
+    md_int32 pixelY;
+
+    MD_ASSERT(pGC != NULL);
+
+    pState = &pGC->software.pState[pGC->software.stateCount-1];
+
+    /* The point is in user space. */
+    md_matrix_transform_point__software(&pState->matrix, (float)x, (float)y, &deviceX, &deviceY);
+    pixelX = (md_int32)floor(MD_CLAMP(deviceX, -1.0f, (float)pGC->software.sizeX));
+    pixelY = (md_int32)floor(MD_CLAMP(deviceY, -1.0f, (float)pGC->software.sizeY));
+
+    if (pixelX < pState->clipLeft || pixelY < pState->clipTop || pixelX >= pState->clipRight || pixelY >= pState->clipBottom) {
+        return MD_FALSE;
+    }
+
+    if (pState->pClipMask == NULL) {
+        return MD_TRUE;
+    }
+
+    return pState->pClipMask->pCoverage[(pixelY - pState->pClipMask->top)*(md_int32)pState->pClipMask->sizeX + (pixelX - pState->pClipMask->left)] > 0;
+}
+
+md_result md_gc_get_clip_bounds__software(md_gc* pGC, md_int32* pLeft, md_int32* pTop, md_int32* pRight, md_int32* pBottom)
+{
+    md_gc_state_software* pState;
+    md_matrix inverse;
+    float corners[8];
+    float minX;
+    float minY;
+    float maxX;
+    float maxY;
+    md_uint32 iCorner;
+
+    MD_ASSERT(pGC != NULL);
+
+    pState = &pGC->software.pState[pGC->software.stateCount-1];
+
+    /* Nothing can be drawn when the transform can't be inverted. */
+    if (pState->clipRight <= pState->clipLeft || pState->clipBottom <= pState->clipTop || !md_matrix_invert__software(&inverse, &pState->matrix)) {
+        *pLeft   = 0;
+        *pTop    = 0;
+        *pRight  = 0;
+        *pBottom = 0;
+        return MD_SUCCESS;
+    }
+
+    /* The clip rectangle is in device space so it needs to be brought back into user space. Any mask will be inside the rectangle. */
+    md_matrix_transform_point__software(&inverse, (float)pState->clipLeft,  (float)pState->clipTop,    &corners[0], &corners[1]);
+    md_matrix_transform_point__software(&inverse, (float)pState->clipRight, (float)pState->clipTop,    &corners[2], &corners[3]);
+    md_matrix_transform_point__software(&inverse, (float)pState->clipLeft,  (float)pState->clipBottom, &corners[4], &corners[5]);
+    md_matrix_transform_point__software(&inverse, (float)pState->clipRight, (float)pState->clipBottom, &corners[6], &corners[7]);
+
+    minX = maxX = corners[0];
+    minY = maxY = corners[1];
+    for (iCorner = 1; iCorner < 4; ++iCorner) {
+        minX = MD_MIN(minX, corners[iCorner*2 + 0]);
+        minY = MD_MIN(minY, corners[iCorner*2 + 1]);
+        maxX = MD_MAX(maxX, corners[iCorner*2 + 0]);
+        maxY = MD_MAX(maxY, corners[iCorner*2 + 1]);
+    }
+
+    *pLeft   = (md_int32)floor(minX);
+    *pTop    = (md_int32)floor(minY);
+    *pRight  = (md_int32)ceil(maxX);
+    *pBottom = (md_int32)ceil(maxY);
+
+    return MD_SUCCESS;
+}
+
+MD_PRIVATE md_bool32 md_paint_init_from_fill_brush__software(md_gc* pGC, md_paint_software* pPaint)
+{
+    md_gc_state_software* pState = &pGC->software.pState[pGC->software.stateCount-1];
+
+    if (pState->hasTransientFillBrush) {
+        return md_paint_init__software(pGC, &pState->transientFillBrush, NULL, 0, 0, pPaint);
+    } else if (pState->pFillBrush != NULL) {
+        return md_paint_init__software(pGC, &pState->pFillBrush->config, pState->pFillBrush->software.pRamp, pState->pFillBrush->software.originX, pState->pFillBrush->software.originY, pPaint);
+    } else {
+        return MD_FALSE;
+    }
+}
+
+MD_PRIVATE md_bool32 md_paint_init_from_line_brush__software(md_gc* pGC, md_paint_software* pPaint)
+{
+    md_gc_state_software* pState = &pGC->software.pState[pGC->software.stateCount-1];
+
+    if (pState->hasTransientLineBrush) {
+        return md_paint_init__software(pGC, &pState->transientLineBrush, NULL, 0, 0, pPaint);
+    } else if (pState->pLineBrush != NULL) {
+        return md_paint_init__software(pGC, &pState->pLineBrush->config, pState->pLineBrush->software.pRamp, pState->pLineBrush->software.originX, pState->pLineBrush->software.originY, pPaint);
+    } else {
+        return MD_FALSE;
+    }
+}
+
+MD_PRIVATE void md_gc_fill_path__software(md_gc* pGC)
+{
+    md_paint_software paint;
+
+    if (!md_paint_init_from_fill_brush__software(pGC, &paint)) {
+        return;
+    }
+
+    md_gc_fill_polygon__software(pGC, &pGC->software.path.flattened, pGC->software.pState[pGC->software.stateCount-1].fillMode, &paint);
+}
+
+MD_PRIVATE void md_gc_stroke_path__software(md_gc* pGC)
+{
+    md_paint_software paint;
+    md_stroke_params_software params;
+
+    if (!md_paint_init_from_line_brush__software(pGC, &paint)) {
+        return;
+    }
+
+    md_stroke_params_init__software(&pGC->software.pState[pGC->software.stateCount-1], &params);
+
+    /* Strokes are expensive to generate so the geometry of the last one is kept around in case the same outline is stroked again. */
+    if (!pGC->software.isStrokeValid || !md_stroke_params_equal__software(&params, &pGC->software.strokeParams) || !md_polygon_equals__software(&pGC->software.path.flattened, &pGC->software.strokeSource)) {
+        pGC->software.isStrokeValid = MD_FALSE;
+
+        if (md_stroke_polygon__software(pGC, &pGC->software.path.flattened, &params, &pGC->software.stroke) != MD_SUCCESS) {
+            return;
+        }
+
+        if (md_polygon_copy__software(&pGC->software.strokeSource, &pGC->software.path.flattened) == MD_SUCCESS) {
+            pGC->software.strokeParams  = params;
+            pGC->software.isStrokeValid = MD_TRUE;
+        }
+    }
+
+    /* Stroke geometry is always filled with the non-zero rule so that overlapping parts of the stroke do not cancel each other out. */
+    md_gc_fill_polygon__software(pGC, &pGC->software.stroke, md_fill_mode_winding, &paint);
+}
+
+void md_gc_fill__software(md_gc* pGC)
+{
+    md_paint_software paint;
+
+    MD_ASSERT(pGC != NULL);
+
+    if (md_paint_init_from_fill_brush__software(pGC, &paint)) {
+        if (!md_gc_fill_path_rectangles__software(pGC, &paint)) {
+            if (md_path_flatten__software(&pGC->software.path) == MD_SUCCESS) {
+                md_gc_fill_polygon__software(pGC, &pGC->software.path.flattened, pGC->software.pState[pGC->software.stateCount-1].fillMode, &paint);
+            }
+        }
+    }
+
+    md_path_reset__software(&pGC->software.path);
+}
+
+void md_gc_stroke__software(md_gc* pGC)
+{
+    MD_ASSERT(pGC != NULL);
+
+    if (md_path_flatten__software(&pGC->software.path) == MD_SUCCESS) {
+        md_gc_stroke_path__software(pGC);
+    }
+
+    md_path_reset__software(&pGC->software.path);
+}
+
+void md_gc_fill_and_stroke__software(md_gc* pGC)
+{
+    MD_ASSERT(pGC != NULL);
+
+    if (md_path_flatten__software(&pGC->software.path) == MD_SUCCESS) {
+        md_gc_fill_path__software(pGC);
+        md_gc_stroke_path__software(pGC);
+    }
+
+    md_path_reset__software(&pGC->software.path);
+}
+
+void md_gc_draw_gc__software(md_gc* pGC, md_gc* pSrcGC, md_int32 srcX, md_int32 srcY)
+{
+    md_brush_config brush;
+    md_paint_software paint;
+    md_polygon_software* pBounds;
+
+    MD_ASSERT(pGC != NULL);
+    MD_ASSERT(pSrcGC != NULL);
+
+    if (pSrcGC->software.pImageData == NULL) {
+        return;
+    }
+
+    MD_ZERO_OBJECT(&brush);
+    brush.type = md_brush_type_gc;
+    brush.gc.pGC = pSrcGC;
+
+    /* The source is positioned at srcX/srcY in user space. Like the Cairo backend, the source is always sampled with nearest filtering. */
+    if (!md_paint_init__software(pGC, &brush, NULL, -srcX, -srcY, &paint)) {
+        return;
+    }
+    paint.filter = md_stretch_filter_nearest;
+
+    pBounds = &pGC->software.scratch;
+    md_polygon_reset__software(pBounds);
+    if (md_polygon_add_rectangle__software(pBounds, &pGC->software.pState[pGC->software.stateCount-1].matrix, (float)srcX, (float)srcY, (float)(srcX + (md_int32)pSrcGC->software.sizeX), (float)(srcY + (md_int32)pSrcGC->software.sizeY)) != MD_SUCCESS) {
+        return;
+    }
+
+    md_gc_fill_polygon__software(pGC, pBounds, md_fill_mode_winding, &paint);
+}
+
+
+/* API */
+MD_PRIVATE size_t md_utf8_cp_length__software(const md_utf8* pTextUTF8, size_t textLength)
+{
+    md_uint8 lead = (md_uint8)pTextUTF8[0];
+    size_t length;
+
+    MD_ASSERT(textLength > 0);
+
+    if (lead < 0x80) {
+        length = 1;
+    } else if ((lead & 0xE0) == 0xC0) {
+        length = 2;
+    } else if ((lead & 0xF0) == 0xE0) {
+        length = 3;
+    } else if ((lead & 0xF8) == 0xF0) {
+        length = 4;
+    } else {
+        length = 1; /* Invalid lead byte. Treat it as a code point of its own. */
+    }
+
+    return MD_MIN(length, textLength);
+}
+
+MD_PRIVATE void md_push_item__software(md_font* pFont, md_item_buffer* pItems, size_t offset, size_t length)
+{
+    md_item* pItem = md_item_buffer_push(pItems);
+    if (pItem != NULL) {
+        pItem->offset = offset;
+        pItem->length = length;
+        pItem->backend.software.pFont = pFont;
+    }
+}
+
+md_result md_itemize_utf8__software(md_font* pFont, const md_utf8* pTextUTF8, size_t textLength, md_item_buffer* pItems, md_itemize_state* pItemizeState)
+{
+    const md_utf8* pTextEndUTF8;
+    const md_utf8* pLineBegUTF8;
+
+    MD_ASSERT(pFont != NULL);
+    MD_ASSERT(textLength > 0);
+    MD_ASSERT(pTextUTF8 != NULL);
+    MD_ASSERT(pItems != NULL);
+
+    (void)pItemizeState;    /* Nothing needs to persist between itemization and shaping. */
+
+    pTextEndUTF8 = pTextUTF8 + textLength;
+
+    /* The built-in font has no script or font fallback concerns, so items are only split on new lines and tabs, just like the other backends. */
+    pLineBegUTF8 = pTextUTF8;
+    while (pLineBegUTF8 != NULL) {
+        const md_utf8* pLineEndUTF8;
+        const md_utf8* pNextLineBegUTF8;
+
+        pNextLineBegUTF8 = md_next_line_utf8(pLineBegUTF8, (size_t)(pTextEndUTF8 - pLineBegUTF8), &pLineEndUTF8);
+
+        /* The space between pLineBegUTF8 and pLineEndUTF8 is the line content. */
+        if ((pLineEndUTF8 - pLineBegUTF8) > 0) {
+            const md_utf8* pSegmentBegUTF8 = pLineBegUTF8;
+            while (pSegmentBegUTF8 != NULL) {
+                const md_utf8* pSegmentEndUTF8;
+                const md_utf8* pNextSegmentBegUTF8;
+
+                pNextSegmentBegUTF8 = md_next_tabbed_segment(pSegmentBegUTF8, (size_t)(pLineEndUTF8 - pSegmentBegUTF8), &pSegmentEndUTF8);
+
+                /* The main segment. */
+                if ((pSegmentEndUTF8 - pSegmentBegUTF8) > 0) {
+                    md_push_item__software(pFont, pItems, (size_t)(pSegmentBegUTF8 - pTextUTF8), (size_t)(pSegmentEndUTF8 - pSegmentBegUTF8));
+                }
+
+                /* The \t characters. */
+                if (pNextSegmentBegUTF8 != NULL && (pNextSegmentBegUTF8 - pSegmentEndUTF8) > 0) {
+                    md_push_item__software(pFont, pItems, (size_t)(pSegmentEndUTF8 - pTextUTF8), (size_t)(pNextSegmentBegUTF8 - pSegmentEndUTF8));
+                }
+
+                pSegmentBegUTF8 = pNextSegmentBegUTF8;
+            }
+        }
+
+        /* The space between pLineEndUTF8 and pNextLineBegUTF8 is the new line character. */
+        if (pNextLineBegUTF8 != NULL && (pNextLineBegUTF8 - pLineEndUTF8) > 0) {
+            md_push_item__software(pFont, pItems, (size_t)(pLineEndUTF8 - pTextUTF8), (size_t)(pNextLineBegUTF8 - pLineEndUTF8));
+        }
+
+        pLineBegUTF8 = pNextLineBegUTF8;
+    }
+
+    return MD_SUCCESS;
+}
+
+md_uint64 md_item_get_analysis_key__software(const md_item* pItem)
+{
+    MD_ASSERT(pItem != NULL);
+
+    /* There's only ever one font per item and shaping doesn't depend on anything else. The cache is already per-font so there's nothing to add. */
+    (void)pItem;
+    return 0;
+}
+
+md_result md_shape_utf8__software(md_font* pFont, md_item* pItem, const md_utf8* pTextUTF8, size_t textLength, md_glyph* pGlyphs, size_t* pGlyphCount, size_t* pClusters, md_text_metrics* pRunMetrics)
+{
+    size_t glyphCap;
+    size_t glyphCount = 0;
+    size_t iByte;
+    md_int32 advance;
+    md_text_metrics metrics;
+
+    MD_ASSERT(pItem != NULL);
+    MD_ASSERT(pFont != NULL);
+    MD_ASSERT(pTextUTF8 != NULL);
+
+    (void)pItem;
+
+    if (pGlyphCount != NULL) {
+        glyphCap = *pGlyphCount;
+    } else {
+        glyphCap = 0;
+    }
+
+    advance = 8 * (md_int32)pFont->software.scale;
+
+    /* There is exactly one glyph for each code point. No ligatures and no reordering. */
+    iByte = 0;
+    while (iByte < textLength) {
+        size_t cpLength = md_utf8_cp_length__software(pTextUTF8 + iByte, textLength - iByte);
+        size_t iCodeUnit;
+
+        if (pGlyphs != NULL) {
+            md_uint8 c = (md_uint8)pTextUTF8[iByte];
+
+            if (glyphCount >= glyphCap) {
+                return MD_NO_SPACE; /* No room to store each glyph. */
+            }
+
+            MD_ZERO_OBJECT(&pGlyphs[glyphCount]);
+            pGlyphs[glyphCount].index   = (c >= 0x20 && c <= 0x7E) ? (md_uint32)(c - 0x1F) : 0;
+            pGlyphs[glyphCount].advance = advance;
+        }
+
+        if (pClusters != NULL) {
+            for (iCodeUnit = 0; iCodeUnit < cpLength; ++iCodeUnit) {
+                pClusters[iByte + iCodeUnit] = glyphCount;
+            }
+        }
+
+        glyphCount += 1;
+        iByte += cpLength;
+    }
+
+    if (pGlyphCount != NULL) {
+        *pGlyphCount = glyphCount;
+    }
+
+    if (pRunMetrics != NULL) {
+        MD_ZERO_OBJECT(&metrics);
+        metrics.sizeX = (md_int32)glyphCount * advance;
+        metrics.sizeY = pFont->metricsCache.lineSizeY;
+        *pRunMetrics = metrics;
+    }
+
+    return MD_SUCCESS;
+}
+
+void md_gc_draw_glyphs__software(md_gc* pGC, const md_item* pItem, const md_glyph* pGlyphs, size_t glyphCount, md_int32 x, md_int32 y)
+{
+    md_gc_state_software* pState;
+    md_font* pFont;
+    md_brush_config brush;
+    md_paint_software paint;
+    md_polygon_software* pPolygon;
+    md_int32 scale;
+    md_int32 textWidth = 0;
+    md_int32 penX;
+    size_t iGlyph;
+
+    MD_ASSERT(pGC     != NULL);
+    MD_ASSERT(pItem   != NULL);
+    MD_ASSERT(pGlyphs != NULL);
+
+    pState = &pGC->software.pState[pGC->software.stateCount-1];
+    pFont  = pItem->backend.software.pFont;
+    scale  = (md_int32)pFont->software.scale;
+    pPolygon = &pGC->software.scratch;
+
+    for (iGlyph = 0; iGlyph < glyphCount; ++iGlyph) {
+        textWidth += pGlyphs[iGlyph].advance;
+    }
+
+    MD_ZERO_OBJECT(&brush);
+    brush.type = md_brush_type_solid;
+
+    /* Background. Same as Cairo, this is drawn with the current blend op which means a transparent background will erase when blending is disabled. */
+    if (pState->textBGColor.a > 0 || pState->blendOp == md_blend_op_src) {
+        brush.solid.color = pState->textBGColor;
+        md_paint_init__software(pGC, &brush, NULL, 0, 0, &paint);
+
+        md_polygon_reset__software(pPolygon);
+        if (md_polygon_add_rectangle__software(pPolygon, &pState->matrix, (float)x, (float)y, (float)(x + textWidth), (float)(y + pFont->metricsCache.lineSizeY)) == MD_SUCCESS) {
+            md_gc_fill_polygon__software(pGC, pPolygon, md_fill_mode_winding, &paint);
+        }
+    }
+
+    /* Text. */
+    brush.solid.color = pState->textFGColor;
+    md_paint_init__software(pGC, &brush, NULL, 0, 0, &paint);
+
+    /*
+    When the matrix is only a translation each glyph is blitted from the font's glyph cache. Glyphs are rendered at a quantized subpixel offset when
+    anti-aliasing is enabled. Otherwise they're snapped to the nearest pixel the same way rectangles are.
+    */
+    if (pState->matrix.m00 == 1 && pState->matrix.m01 == 0 && pState->matrix.m10 == 0 && pState->matrix.m11 == 1 && 8*scale + 1 <= MD_SOFTWARE_GLYPH_ATLAS_SIZE) {
+        md_int32 cellSize = 8*scale + 1;
+        float originY = (float)y + pState->matrix.dy;
+        float originX;
+        md_int32 glyphY;
+        md_uint32 subY = 0;
+
+        /* Nothing to draw if the run is entirely above or below the clip. */
+        if (originY + cellSize <= (float)pState->clipTop || originY >= (float)pState->clipBottom) {
+            return;
+        }
+
+        if (pState->antialiasMode == md_antialias_mode_none) {
+            glyphY = (md_int32)ceil(originY - 0.5f);
+        } else {
+            glyphY = (md_int32)floor(originY);
+            subY   = (md_uint32)((originY - (float)glyphY) * MD_SOFTWARE_GLYPH_SUBPIXEL_STEPS + 0.5f);
+            if (subY == MD_SOFTWARE_GLYPH_SUBPIXEL_STEPS) {
+                glyphY += 1;
+                subY    = 0;
+            }
+        }
+
+        penX = x;
+        for (iGlyph = 0; iGlyph < glyphCount; ++iGlyph) {
+            const md_glyph_cache_entry_software* pEntry;
+            const md_uint8* pCoverage;
+            md_int32 glyphX;
+            md_int32 dstX;
+            md_int32 dstY;
+            md_int32 row;
+            md_int32 colBeg;
+            md_int32 colEnd;
+            md_uint32 subX = 0;
+
+            originX = (float)penX + pState->matrix.dx;
+            penX   += pGlyphs[iGlyph].advance;
+
+            if (originX + cellSize <= (float)pState->clipLeft || originX >= (float)pState->clipRight) {
+                continue;
+            }
+
+            if (pState->antialiasMode == md_antialias_mode_none) {
+                glyphX = (md_int32)ceil(originX - 0.5f);
+            } else {
+                glyphX = (md_int32)floor(originX);
+                subX   = (md_uint32)((originX - (float)glyphX) * MD_SOFTWARE_GLYPH_SUBPIXEL_STEPS + 0.5f);
+                if (subX == MD_SOFTWARE_GLYPH_SUBPIXEL_STEPS) {
+                    glyphX += 1;
+                    subX    = 0;
+                }
+            }
+
+            if (md_glyph_cache_get__software(pFont, pGlyphs[iGlyph].index, subX, subY, &pEntry) != MD_SUCCESS) {
+                return;
+            }
+
+            if (pEntry->sizeX == 0) {
+                continue;   /* Nothing to draw. */
+            }
+
+            dstX   = glyphX + pEntry->offsetX;
+            dstY   = glyphY + pEntry->offsetY;
+            colBeg = MD_MAX(dstX, pState->clipLeft);
+            colEnd = MD_MIN(dstX + (md_int32)pEntry->sizeX, pState->clipRight);
+            if (colBeg >= colEnd) {
+                continue;
+            }
+
+            pCoverage = pFont->software.glyphCache.ppPages[pEntry->page] + pEntry->y*MD_SOFTWARE_GLYPH_ATLAS_SIZE + pEntry->x + (colBeg - dstX);
+
+            for (row = MD_MAX(dstY, pState->clipTop); row < MD_MIN(dstY + (md_int32)pEntry->sizeY, pState->clipBottom); ++row) {
+                md_composite_span__software(pGC, &pGC->software.rasterizer, &paint, colBeg, row, colEnd - colBeg, pCoverage + (row - dstY)*MD_SOFTWARE_GLYPH_ATLAS_SIZE, 0);
+            }
+        }
+
+        return;
+    }
+
+    /* Fall back to emitting each lit cell of each glyph as a rectangle and filling the whole run in one go. */
+    md_polygon_reset__software(pPolygon);
+
+    penX = x;
+    for (iGlyph = 0; iGlyph < glyphCount; ++iGlyph) {
+        const md_uint8* pBitmap = md_get_glyph_bitmap__software(pGlyphs[iGlyph].index);
+        md_int32 row;
+        md_int32 col;
+
+        for (row = 0; row < 8; ++row) {
+            for (col = 0; col < 8; ++col) {
+                if ((pBitmap[row] & (1 << col)) != 0) {
+                    float cellX = (float)(penX + col*scale);
+                    float cellY = (float)(y    + row*scale);
+                    if (md_polygon_add_rectangle__software(pPolygon, &pState->matrix, cellX, cellY, cellX + scale, cellY + scale) != MD_SUCCESS) {
+                        return;
+                    }
+                }
+            }
+        }
+
+        penX += pGlyphs[iGlyph].advance;
+    }
+
+    md_gc_fill_polygon__software(pGC, pPolygon, md_fill_mode_winding, &paint);
+}
+
+void md_gc_clear__software(md_gc* pGC, md_color color)
+{
+    md_brush_config brush;
+    md_paint_software paint;
+
+    MD_ASSERT(pGC != NULL);
+
+    MD_ZERO_OBJECT(&brush);
+    brush.type = md_brush_type_solid;
+    brush.solid.color = color;
+    md_paint_init__software(pGC, &brush, NULL, 0, 0, &paint);
+
+    /* Same as Cairo. The matrix is ignored, but the clip is respected, and the color is blended over the top of the existing contents. */
+    paint.blendOp = md_blend_op_src_over;
+
+    md_gc_fill_rectangle__software(pGC, 0, 0, (md_int32)pGC->software.sizeX, (md_int32)pGC->software.sizeY, &paint);
+}
+
+
+void md_uninit__software(md_api* pAPI)
+{
+    MD_ASSERT(pAPI != NULL);
+
+    (void)pAPI;
+}
+
+md_result md_init__software(const md_api_config* pConfig, md_api* pAPI)
+{
+    MD_ASSERT(pConfig != NULL);
+    MD_ASSERT(pAPI != NULL);
+
+    (void)pConfig;
+
+#if defined(MD_SUPPORT_SSE2)
+    pAPI->software.useSSE2 = md_has_sse2();
+#endif
+#if defined(MD_SUPPORT_AVX2)
+    pAPI->software.useAVX2 = md_has_avx2();
+#endif
+
+    pAPI->procs.uninit                     = md_uninit__software;
+    pAPI->procs.itemizeUTF8                = md_itemize_utf8__software;
+    pAPI->procs.itemizeUTF16               = NULL;
+    pAPI->procs.itemizeUTF32               = NULL;
+    pAPI->procs.freeItemizeState           = NULL;    /* Nothing is allocated during itemization. */
+    pAPI->procs.itemGetAnalysisKey         = md_item_get_analysis_key__software;
+    pAPI->procs.shapeUTF8                  = md_shape_utf8__software;
+    pAPI->procs.shapeUTF16                 = NULL;
+    pAPI->procs.shapeUTF32                 = NULL;
+    pAPI->procs.fontInit                   = md_font_init__software;
+    pAPI->procs.fontUninit                 = md_font_uninit__software;
+    pAPI->procs.fontGetGlyphMetrics        = md_font_get_glyph_metrics__software;
+    pAPI->procs.fontGetGlyphMetricsByIndex = md_font_get_glyph_metrics_by_index__software;
+    pAPI->procs.fontGetGlyphCacheStats     = md_font_get_glyph_cache_stats__software;
+    pAPI->procs.brushInit                  = md_brush_init__software;
+    pAPI->procs.brushUninit                = md_brush_uninit__software;
+    pAPI->procs.brushSetOrigin             = md_brush_set_origin__software;
+    pAPI->procs.gcInit                     = md_gc_init__software;
+    pAPI->procs.gcUninit                   = md_gc_uninit__software;
+    pAPI->procs.gcGetImageData             = md_gc_get_image_data__software;
+    pAPI->procs.gcGetSize                  = md_gc_get_size__software;
+    pAPI->procs.gcSave                     = md_gc_save__software;
+    pAPI->procs.gcRestore                  = md_gc_restore__software;
+    pAPI->procs.gcSetMatrix                = md_gc_set_matrix__software;
+    pAPI->procs.gcGetMatrix                = md_gc_get_matrix__software;
+    pAPI->procs.gcSetMatrixIdentity        = md_gc_set_matrix_identity__software;
+    pAPI->procs.gcTransform                = md_gc_transform__software;
+    pAPI->procs.gcTranslate                = md_gc_translate__software;
+    pAPI->procs.gcRotate                   = md_gc_rotate__software;
+    pAPI->procs.gcScale                    = md_gc_scale__software;
+    pAPI->procs.gcSetLineWidth             = md_gc_set_line_width__software;
+    pAPI->procs.gcSetLineCap               = md_gc_set_line_cap__software;
+    pAPI->procs.gcSetLineJoin              = md_gc_set_line_join__software;
+    pAPI->procs.gcSetMiterLimit            = md_gc_set_miter_limit__software;
+    pAPI->procs.gcSetLineDash              = md_gc_set_line_dash__software;
+    pAPI->procs.gcSetLineBrush             = md_gc_set_line_brush__software;
+    pAPI->procs.gcSetLineBrushSolid        = md_gc_set_line_brush_solid__software;
+    pAPI->procs.gcSetLineBrushGC           = md_gc_set_line_brush_gc__software;
+    pAPI->procs.gcSetFillBrush             = md_gc_set_fill_brush__software;
+    pAPI->procs.gcSetFillBrushSolid        = md_gc_set_fill_brush_solid__software;
+    pAPI->procs.gcSetFillBrushGC           = md_gc_set_fill_brush_gc__software;
+    pAPI->procs.gcSetTextFGColor           = md_gc_set_text_fg_color__software;
+    pAPI->procs.gcSetTextBGColor           = md_gc_set_text_bg_color__software;
+    pAPI->procs.gcGetTextFGColor           = md_gc_get_text_fg_color__software;
+    pAPI->procs.gcGetTextBGColor           = md_gc_get_text_bg_color__software;
+    pAPI->procs.gcSetBlendOp               = md_gc_set_blend_op__software;
+    pAPI->procs.gcSetAntialiasMode         = md_gc_set_antialias_mode__software;
+    pAPI->procs.gcSetFillMode              = md_gc_set_fill_mode__software;
+    pAPI->procs.gcSetStretchFilter         = md_gc_set_stretch_filter__software;
+    pAPI->procs.gcMoveTo                   = md_gc_move_to__software;
+    pAPI->procs.gcLineTo                   = md_gc_line_to__software;
+    pAPI->procs.gcRectangle                = md_gc_rectangle__software;
+    pAPI->procs.gcArc                      = md_gc_arc__software;
+    pAPI->procs.gcCurveTo                  = md_gc_curve_to__software;
+    pAPI->procs.gcClosePath                = md_gc_close_path__software;
+    pAPI->procs.gcClip                     = md_gc_clip__software;
+    pAPI->procs.gcResetClip                = md_gc_reset_clip__software;
+    pAPI->procs.gcIsPointInsideClip        = md_gc_is_point_inside_clip__software;
+    pAPI->procs.gcGetClipBounds            = md_gc_get_clip_bounds__software;
+    pAPI->procs.gcFill                     = md_gc_fill__software;
+    pAPI->procs.gcStroke                   = md_gc_stroke__software;
+    pAPI->procs.gcFillAndStroke            = md_gc_fill_and_stroke__software;
+    pAPI->procs.gcDrawGC                   = md_gc_draw_gc__software;
+    pAPI->procs.gcDrawGlyphs               = md_gc_draw_glyphs__software;
+    pAPI->procs.gcClear                    = md_gc_clear__software;
+
+    return MD_SUCCESS;
+}
+
+#endif
+
+
+
+/**************************************************************************************************************************************************************
+
+ Custom
+
+ **************************************************************************************************************************************************************/
+md_result md_init__custom(const md_api_config* pConfig, md_api* pAPI)
+{
+    pAPI->procs = pConfig->custom.procs;
+    return MD_SUCCESS;
+}
+
+
+
+/**************************************************************************************************************************************************************
+
+API
+
+**************************************************************************************************************************************************************/
+md_result md_init(const md_api_config* pConfig, md_api* pAPI)
+{
+    md_result result = MD_ERROR;
+
+    if (pAPI == NULL) {
+        return MD_INVALID_ARGS;
+    }
+
+    MD_ZERO_OBJECT(pAPI);
+
+    if (pConfig == NULL) {
+        return MD_INVALID_ARGS;
+    }
+
+    pAPI->backend = pConfig->backend;
+    pAPI->pUserData = pConfig->pUserData;
+
+    switch (pConfig->backend)
+    {
+#if defined(MD_HAS_GDI)
+        case md_backend_gdi:
+        {
+            result = md_init__gdi(pConfig, pAPI);
+        } break;
+#endif
+#if defined(MD_HAS_CAIRO)
+        case md_backend_cairo:
+        {
+            result = md_init__cairo(pConfig, pAPI);
+        } break;
+#endif
+#if defined(MD_HAS_SOFTWARE)
+        case md_backend_software:
+        {
+            result = md_init__software(pConfig, pAPI);
+        } break;
+#endif
+
+        case md_backend_custom:
+        {
+            result = md_init__custom(pConfig, pAPI);
+        } break;
+
+        default:
+        {
+            result = MD_INVALID_ARGS;
+        };
+    }
+
+    if (result != MD_SUCCESS) {
+        return result;
+    }
+
+    return MD_SUCCESS;
+}
+
+void md_uninit(md_api* pAPI)
+{
+    if (pAPI == NULL) {
+        return;
+    }
+
+    pAPI->procs.uninit(pAPI);
+}
+
+/*
+Text encodings for the generic text paths so they can be shared between UTF-8, UTF-16 and UTF-32. The value is the size of a code unit in bytes.
+*/
+#define MD_ENCODING_UTF8    1
+#define MD_ENCODING_UTF16   2
+#define MD_ENCODING_UTF32   4
+
+#define MD_TEXT_AT(pText, offset, encoding) ((const void*)((const md_uint8*)(pText) + ((offset) * (encoding))))
+
+static md_uint32 md_get_code_unit(const void* pText, size_t index, md_uint32 encoding)
+{
+    if (encoding == MD_ENCODING_UTF8) {
+        return (md_uint8)((const md_utf8*)pText)[index];
+    } else if (encoding == MD_ENCODING_UTF16) {
+        return ((const md_utf16*)pText)[index];
+    } else {
+        return ((const md_utf32*)pText)[index];
+    }
+}
+
+static size_t md_get_text_length_null_terminated(const void* pText, md_uint32 encoding)
+{
+    size_t textLength = 0;
+    while (md_get_code_unit(pText, textLength, encoding) != 0) {
+        textLength += 1;
+    }
+
+    return textLength;
+}
+
+static md_bool32 md_is_newline(const void* pText, size_t textLength, md_uint32 encoding)
+{
+    if (encoding == MD_ENCODING_UTF8) {
+        return md_is_newline_utf8((const md_utf8*)pText, textLength);
+    }
+
+    if (textLength == 1) {
+        md_uint32 c = md_get_code_unit(pText, 0, encoding);
+        return c == '\r' || c == '\n';
+    }
+
+    if (textLength == 2) {
+        return md_get_code_unit(pText, 0, encoding) == '\r' && md_get_code_unit(pText, 1, encoding) == '\n';
+    }
+
+    return MD_FALSE;
+}
+
+/*
+Decodes the code point at [index] and returns the number of code units it takes up. The text is assumed to be valid which is the case for anything
+that has been through one of the conversion functions.
+*/
+static size_t md_decode_code_point(const void* pText, size_t textLength, size_t index, md_uint32 encoding, md_utf32* pCP)
+{
+    size_t unitCount;
+
+    if (encoding == MD_ENCODING_UTF8) {
+        const md_uint8* pUTF8 = (const md_uint8*)pText + index;
+        if (pUTF8[0] < 0x80) {
+            *pCP = pUTF8[0];
+            return 1;
+        } else if ((pUTF8[0] & 0xE0) == 0xC0) {
+            unitCount = 2;
+        } else if ((pUTF8[0] & 0xF0) == 0xE0) {
+            unitCount = 3;
+        } else {
+            unitCount = 4;
+        }
+
+        if (unitCount > textLength - index) {
+            *pCP = 0xFFFD;
+            return textLength - index;
+        }
+
+        if (unitCount == 2) {
+            *pCP = ((md_utf32)(pUTF8[0] & 0x1F) << 6) | (pUTF8[1] & 0x3F);
+        } else if (unitCount == 3) {
+            *pCP = ((md_utf32)(pUTF8[0] & 0x0F) << 12) | ((md_utf32)(pUTF8[1] & 0x3F) << 6) | (pUTF8[2] & 0x3F);
+        } else {
+            *pCP = ((md_utf32)(pUTF8[0] & 0x07) << 18) | ((md_utf32)(pUTF8[1] & 0x3F) << 12) | ((md_utf32)(pUTF8[2] & 0x3F) << 6) | (pUTF8[3] & 0x3F);
+        }
+
+        return unitCount;
+    } else if (encoding == MD_ENCODING_UTF16) {
+        const md_utf16* pUTF16 = (const md_utf16*)pText + index;
+        if (pUTF16[0] >= 0xD800 && pUTF16[0] <= 0xDBFF && textLength - index >= 2) {
+            *pCP = md_utf16_pair_to_utf32_cp(pUTF16);
+            return 2;
+        }
+
+        *pCP = pUTF16[0];
+        return 1;
+    } else {
+        *pCP = ((const md_utf32*)pText)[index];
+        return 1;
+    }
+}
+
+static size_t md_get_code_point_length(md_utf32 cp, md_uint32 encoding)
+{
+    if (encoding == MD_ENCODING_UTF8) {
+        return md_utf32_cp_to_utf8_length(cp);
+    } else if (encoding == MD_ENCODING_UTF16) {
+        return md_utf32_cp_to_utf16_length(cp);
+    } else {
+        return 1;
+    }
+}
+
+/*
+Converts text between encodings into scratch memory. The output is sized from the worst case expansion so there's no need for a measuring pass. On
+failure the scratch memory is left as it was.
+*/
+MD_PRIVATE md_result md_convert_text__scratch(md_scratch* pScratch, const void* pText, size_t textLength, md_uint32 encoding, md_uint32 outputEncoding, const void** ppOutput, size_t* pOutputLength)
+{
+    md_result result;
+    size_t mark;
+    size_t outputCap;
+    void* pOutput;
+
+    MD_ASSERT(encoding != outputEncoding);
+
+    if (textLength > ((size_t)-1) / 16 - 1) {
+        return MD_INVALID_ARGS; /* Too long. */
+    }
+
+    /* Worst case number of output code units per input code unit. */
+    if (outputEncoding == MD_ENCODING_UTF8) {
+        outputCap = textLength * ((encoding == MD_ENCODING_UTF16) ? 3 : 4);
+    } else if (outputEncoding == MD_ENCODING_UTF16) {
+        outputCap = textLength * ((encoding == MD_ENCODING_UTF32) ? 2 : 1);
+    } else {
+        outputCap = textLength;
+    }
+    outputCap += 1;
+
+    mark = md_scratch_get_mark(pScratch);
+
+    pOutput = md_scratch_alloc(pScratch, outputCap * outputEncoding);
+    if (pOutput == NULL) {
+        return MD_OUT_OF_MEMORY;
+    }
+
+    if (encoding == MD_ENCODING_UTF8) {
+        if (outputEncoding == MD_ENCODING_UTF16) {
+            result = md_utf8_to_utf16ne((md_utf16*)pOutput, outputCap, pOutputLength, (const md_utf8*)pText, textLength, NULL, MD_ERROR_ON_INVALID_CODE_POINT);
+        } else {
+            result = md_utf8_to_utf32ne((md_utf32*)pOutput, outputCap, pOutputLength, (const md_utf8*)pText, textLength, NULL, MD_ERROR_ON_INVALID_CODE_POINT);
+        }
+    } else if (encoding == MD_ENCODING_UTF16) {
+        if (outputEncoding == MD_ENCODING_UTF8) {
+            result = md_utf16ne_to_utf8((md_utf8*)pOutput, outputCap, pOutputLength, (const md_utf16*)pText, textLength, NULL, MD_ERROR_ON_INVALID_CODE_POINT);
+        } else {
+            result = md_utf16ne_to_utf32ne((md_utf32*)pOutput, outputCap, pOutputLength, (const md_utf16*)pText, textLength, NULL, MD_ERROR_ON_INVALID_CODE_POINT);
+        }
+    } else {
+        if (outputEncoding == MD_ENCODING_UTF8) {
+            result = md_utf32ne_to_utf8((md_utf8*)pOutput, outputCap, pOutputLength, (const md_utf32*)pText, textLength, NULL, MD_ERROR_ON_INVALID_CODE_POINT);
+        } else {
+            result = md_utf32ne_to_utf16ne((md_utf16*)pOutput, outputCap, pOutputLength, (const md_utf32*)pText, textLength, NULL, MD_ERROR_ON_INVALID_CODE_POINT);
+        }
+    }
+
+    if (result != MD_SUCCESS) {
+        md_scratch_release(pScratch, mark);
+        return result;
+    }
+
+    *ppOutput = pOutput;
+    return MD_SUCCESS;
+}
+
+/*
+Converts the offsets and lengths of items that were itemized from text in [nativeEncoding] to their equivalents in [encoding]. Items are contiguous
+so the offsets are just a running total.
+*/
+static void md_remap_items(const void* pNativeText, size_t nativeTextLength, md_uint32 nativeEncoding, md_uint32 encoding, md_item* pItems, md_uint32 itemCount)
+{
+    size_t runningOffset = 0;
+    md_uint32 iItem;
+
+    for (iItem = 0; iItem < itemCount; ++iItem) {
+        size_t iUnit = pItems[iItem].offset;
+        size_t iUnitEnd = pItems[iItem].offset + pItems[iItem].length;
+        size_t length = 0;
+
+        while (iUnit < iUnitEnd) {
+            md_utf32 cp;
+            iUnit  += md_decode_code_point(pNativeText, nativeTextLength, iUnit, nativeEncoding, &cp);
+            length += md_get_code_point_length(cp, encoding);
+        }
+
+        pItems[iItem].offset = runningOffset;
+        pItems[iItem].length = length;
+        runningOffset += length;
+    }
+}
+
+/*
+Expands clusters that were output for text in [nativeEncoding] so they map to each code unit of the same text in [encoding].
+*/
+static void md_remap_clusters(const void* pText, size_t textLength, md_uint32 encoding, md_uint32 nativeEncoding, const size_t* pNativeClusters, size_t* pClusters)
+{
+    size_t iUnit = 0;
+    size_t iNativeUnit = 0;
+
+    while (iUnit < textLength) {
+        md_utf32 cp;
+        size_t unitCount = md_decode_code_point(pText, textLength, iUnit, encoding, &cp);
+        size_t cluster = pNativeClusters[iNativeUnit];
+        size_t iCluster;
+
+        for (iCluster = 0; iCluster < unitCount; ++iCluster) {
+            pClusters[iUnit + iCluster] = cluster;
+        }
+
+        iUnit       += unitCount;
+        iNativeUnit += md_get_code_point_length(cp, nativeEncoding);
+    }
+}
+
+static md_bool32 md_has_itemize_proc(md_api* pAPI, md_uint32 encoding)
+{
+    if (encoding == MD_ENCODING_UTF8) {
+        return pAPI->procs.itemizeUTF8 != NULL;
+    } else if (encoding == MD_ENCODING_UTF16) {
+        return pAPI->procs.itemizeUTF16 != NULL;
+    } else {
+        return pAPI->procs.itemizeUTF32 != NULL;
+    }
+}
+
+static md_bool32 md_has_shape_proc(md_api* pAPI, md_uint32 encoding)
+{
+    if (encoding == MD_ENCODING_UTF8) {
+        return pAPI->procs.shapeUTF8 != NULL;
+    } else if (encoding == MD_ENCODING_UTF16) {
+        return pAPI->procs.shapeUTF16 != NULL;
+    } else {
+        return pAPI->procs.shapeUTF32 != NULL;
+    }
+}
+
+/*
+Retrieves the encoding the backend should be given for text in [encoding]. This is [encoding] itself when the backend supports it natively. Otherwise
+it's the first one the backend does support, preferring UTF-8. Returns 0 if the backend doesn't support anything.
+*/
+static md_uint32 md_get_itemize_encoding(md_api* pAPI, md_uint32 encoding)
+{
+    if (md_has_itemize_proc(pAPI, encoding)) {
+        return encoding;
+    }
+
+    if (md_has_itemize_proc(pAPI, MD_ENCODING_UTF8)) {
+        return MD_ENCODING_UTF8;
+    }
+    if (md_has_itemize_proc(pAPI, MD_ENCODING_UTF16)) {
+        return MD_ENCODING_UTF16;
+    }
+    if (md_has_itemize_proc(pAPI, MD_ENCODING_UTF32)) {
+        return MD_ENCODING_UTF32;
+    }
+
+    return 0;
+}
+
+static md_uint32 md_get_shape_encoding(md_api* pAPI, md_uint32 encoding)
+{
+    if (md_has_shape_proc(pAPI, encoding)) {
+        return encoding;
+    }
+
+    if (md_has_shape_proc(pAPI, MD_ENCODING_UTF8)) {
+        return MD_ENCODING_UTF8;
+    }
+    if (md_has_shape_proc(pAPI, MD_ENCODING_UTF16)) {
+        return MD_ENCODING_UTF16;
+    }
+    if (md_has_shape_proc(pAPI, MD_ENCODING_UTF32)) {
+        return MD_ENCODING_UTF32;
+    }
+
+    return 0;
+}
+
+/*
+Retrieves the encoding to convert whole strings to when the backend can't both itemize and shape [encoding] natively. This is the first encoding that
+can be both itemized and shaped natively, preferring UTF-8.
+*/
+static md_uint32 md_get_text_encoding(md_api* pAPI, md_uint32 encoding)
+{
+    if (md_has_itemize_proc(pAPI, encoding) && md_has_shape_proc(pAPI, encoding)) {
+        return encoding;
+    }
+
+    if (md_has_itemize_proc(pAPI, MD_ENCODING_UTF8) && md_has_shape_proc(pAPI, MD_ENCODING_UTF8)) {
+        return MD_ENCODING_UTF8;
+    }
+    if (md_has_itemize_proc(pAPI, MD_ENCODING_UTF16) && md_has_shape_proc(pAPI, MD_ENCODING_UTF16)) {
+        return MD_ENCODING_UTF16;
+    }
+    if (md_has_itemize_proc(pAPI, MD_ENCODING_UTF32) && md_has_shape_proc(pAPI, MD_ENCODING_UTF32)) {
+        return MD_ENCODING_UTF32;
+    }
+
+    return MD_ENCODING_UTF8;    /* Not natively supported at all. UTF-8 will go through the conversion paths. */
+}
+
+static md_result md_itemize__backend(md_font* pFont, const void* pText, size_t textLength, md_uint32 encoding, md_item_buffer* pItems, md_itemize_state* pItemizeState)
+{
+    if (encoding == MD_ENCODING_UTF8) {
+        return pFont->pAPI->procs.itemizeUTF8(pFont, (const md_utf8*)pText, textLength, pItems, pItemizeState);
+    } else if (encoding == MD_ENCODING_UTF16) {
+        return pFont->pAPI->procs.itemizeUTF16(pFont, (const md_utf16*)pText, textLength, pItems, pItemizeState);
+    } else {
+        return pFont->pAPI->procs.itemizeUTF32(pFont, (const md_utf32*)pText, textLength, pItems, pItemizeState);
+    }
+}
+
+static md_result md_shape__backend(md_font* pFont, md_item* pItem, const void* pText, size_t textLength, md_uint32 encoding, md_glyph* pGlyphs, size_t* pGlyphCount, size_t* pClusters, md_text_metrics* pRunMetrics)
+{
+    if (encoding == MD_ENCODING_UTF8) {
+        return pFont->pAPI->procs.shapeUTF8(pFont, pItem, (const md_utf8*)pText, textLength, pGlyphs, pGlyphCount, pClusters, pRunMetrics);
+    } else if (encoding == MD_ENCODING_UTF16) {
+        return pFont->pAPI->procs.shapeUTF16(pFont, pItem, (const md_utf16*)pText, textLength, pGlyphs, pGlyphCount, pClusters, pRunMetrics);
+    } else {
+        return pFont->pAPI->procs.shapeUTF32(pFont, pItem, (const md_utf32*)pText, textLength, pGlyphs, pGlyphCount, pClusters, pRunMetrics);
+    }
+}
+
+md_item* md_item_buffer_push(md_item_buffer* pBuffer)
+{
+    md_item* pItem;
+
+    MD_ASSERT(pBuffer != NULL);
+
+    if (pBuffer->count >= pBuffer->capacity && pBuffer->onGrow != NULL && pBuffer->count < 0xFFFFFFFF) {
+        md_uint32 newCapacity = (pBuffer->capacity < 0x7FFFFFFF) ? MD_MAX(pBuffer->capacity * 2, 16) : 0xFFFFFFFF;
+        if (pBuffer->onGrow(pBuffer, newCapacity) != MD_SUCCESS) {
+            MD_ASSERT(pBuffer->capacity <= pBuffer->count);  /* The callback shouldn't change the buffer on failure. */
+        }
+    }
+
+    if (pBuffer->pItems != NULL && pBuffer->count < pBuffer->capacity) {
+        pItem = &pBuffer->pItems[pBuffer->count];
+    } else {
+        pItem = NULL;   /* Doesn't fit. Still needs to be counted. */
+    }
+
+    pBuffer->count += 1;
+    return pItem;
+}
+
+MD_PRIVATE md_result md_itemize__buffer(md_font* pFont, const void* pText, size_t textLength, md_uint32 encoding, md_item_buffer* pItems, md_itemize_state* pItemizeState)
+{
+    md_result result;
+    md_uint32 nativeEncoding;
+
+    if (pItems == NULL || pFont == NULL || pText == NULL || textLength == 0) {
+        return MD_INVALID_ARGS;
+    }
+
+    if (textLength == (size_t)-1) {
+        textLength = md_get_text_length_null_terminated(pText, encoding);
+        if (textLength == 0) {
+            return MD_INVALID_ARGS;
+        }
+    }
+
+    /* Make sure the API object is always set in the itemize state. The rest is cleared so it can be safely freed if the backend fails. */
+    if (pItemizeState != NULL) {
+        MD_ZERO_OBJECT(pItemizeState);
+        pItemizeState->pAPI = pFont->pAPI;
+    }
+
+    /*
+    We could do some generic itemization here such as line breaks and tabs, however it makes things awkward with memory management. I'm therefore
+    leaving this to each of the backends.
+    */
+    nativeEncoding = md_get_itemize_encoding(pFont->pAPI, encoding);
+    if (nativeEncoding == 0) {
+        return MD_INVALID_OPERATION;    /* Itemization not supported by the backend. */
+    }
+
+    /* If the backend directly supports the encoding, just pass it straight through. Otherwise we need to convert. */
+    if (nativeEncoding == encoding) {
+        result = md_itemize__backend(pFont, pText, textLength, encoding, pItems, pItemizeState);
+    } else {
+        /* Convert the whole string, itemize, then convert offsets back to the input encoding. The converted string lives in the font's scratch memory. */
+        md_uint32 firstItem = pItems->count;
+        size_t scratchMark = md_scratch_get_mark(&pFont->scratch);
+        const void* pNativeText;
+        size_t nativeTextLength;
+
+        result = md_convert_text__scratch(&pFont->scratch, pText, textLength, encoding, nativeEncoding, &pNativeText, &nativeTextLength);
+        if (result != MD_SUCCESS) {
+            return result;  /* An error occurred when converting. */
+        }
+
+        result = md_itemize__backend(pFont, pNativeText, nativeTextLength, nativeEncoding, pItems, pItemizeState);
+        if (result == MD_SUCCESS && pItems->pItems != NULL && firstItem < pItems->capacity) {
+            md_remap_items(pNativeText, nativeTextLength, nativeEncoding, encoding, pItems->pItems + firstItem, MD_MIN(pItems->count, pItems->capacity) - firstItem);
+        }
+
+        md_scratch_release(&pFont->scratch, scratchMark);
+    }
+
+    if (result == MD_SUCCESS && pItems->pItems != NULL && pItems->count > pItems->capacity) {
+        if (pItems->onGrow != NULL) {
+            result = MD_OUT_OF_MEMORY;  /* The buffer failed to grow. */
+        } else {
+            result = MD_NO_SPACE;
+        }
+    }
+
+    /* The items are not usable on failure so there's no need for the caller to hold on to the itemize state. */
+    if (result != MD_SUCCESS) {
+        md_free_itemize_state(pItemizeState);
+    }
+
+    return result;
+}
+
+MD_PRIVATE md_result md_itemize__fixed(md_font* pFont, const void* pText, size_t textLength, md_uint32 encoding, md_item* pItems, md_uint32* pItemCount, md_itemize_state* pItemizeState)
+{
+    md_result result;
+    md_item_buffer buffer;
+
+    if (pItemCount == NULL) {
+        return MD_INVALID_ARGS;
+    }
+
+    buffer.pItems    = pItems;
+    buffer.capacity  = (pItems != NULL) ? *pItemCount : 0;
+    buffer.count     = 0;
+    buffer.onGrow    = NULL;
+    buffer.pUserData = NULL;
+
+    result = md_itemize__buffer(pFont, pText, textLength, encoding, &buffer, pItemizeState);
+    if (result == MD_SUCCESS || result == MD_NO_SPACE) {
+        *pItemCount = buffer.count;
+    }
+
+    return result;
+}
+
+md_result md_itemize_utf8_to_buffer(md_font* pFont, const md_utf8* pTextUTF8, size_t textLength, md_item_buffer* pItems, md_itemize_state* pItemizeState)
+{
+    return md_itemize__buffer(pFont, pTextUTF8, textLength, MD_ENCODING_UTF8, pItems, pItemizeState);
+}
+
+md_result md_itemize_utf16_to_buffer(md_font* pFont, const md_utf16* pTextUTF16, size_t textLength, md_item_buffer* pItems, md_itemize_state* pItemizeState)
+{
+    return md_itemize__buffer(pFont, pTextUTF16, textLength, MD_ENCODING_UTF16, pItems, pItemizeState);
+}
+
+md_result md_itemize_utf32_to_buffer(md_font* pFont, const md_utf32* pTextUTF32, size_t textLength, md_item_buffer* pItems, md_itemize_state* pItemizeState)
+{
+    return md_itemize__buffer(pFont, pTextUTF32, textLength, MD_ENCODING_UTF32, pItems, pItemizeState);
+}
+
+md_result md_itemize_utf8(md_font* pFont, const md_utf8* pTextUTF8, size_t textLength, md_item* pItems, md_uint32* pItemCount, md_itemize_state* pItemizeState)
+{
+    return md_itemize__fixed(pFont, pTextUTF8, textLength, MD_ENCODING_UTF8, pItems, pItemCount, pItemizeState);
+}
+
+md_result md_itemize_utf16(md_font* pFont, const md_utf16* pTextUTF16, size_t textLength, md_item* pItems, md_uint32* pItemCount, md_itemize_state* pItemizeState)
+{
+    return md_itemize__fixed(pFont, pTextUTF16, textLength, MD_ENCODING_UTF16, pItems, pItemCount, pItemizeState);
+}
+
+md_result md_itemize_utf32(md_font* pFont, const md_utf32* pTextUTF32, size_t textLength, md_item* pItems, md_uint32* pItemCount, md_itemize_state* pItemizeState)
+{
+    return md_itemize__fixed(pFont, pTextUTF32, textLength, MD_ENCODING_UTF32, pItems, pItemCount, pItemizeState);
+}
+
+void md_free_itemize_state(md_itemize_state* pItemizeState)
+{
+    if (pItemizeState == NULL) {
+        return;
+    }
+
+    if (pItemizeState->pAPI->procs.freeItemizeState) {
+        pItemizeState->pAPI->procs.freeItemizeState(pItemizeState);
+    }
+}
+
+static md_result md_item_buffer_grow__heap(md_item_buffer* pBuffer, md_uint32 newCapacity)
+{
+    md_item* pNewItems;
+
+    MD_ASSERT(pBuffer != NULL);
+
+    if ((((size_t)-1) / sizeof(*pNewItems)) / newCapacity == 0) {
+        return MD_OUT_OF_MEMORY;    /* Too big for a 32-bit build. */
+    }
+
+    /* pUserData is the heap allocation. It's NULL while the items are still in the initial buffer which means they need to be copied over. */
+    pNewItems = (md_item*)MD_REALLOC(pBuffer->pUserData, sizeof(*pNewItems) * newCapacity);
+    if (pNewItems == NULL) {
+        return MD_OUT_OF_MEMORY;
+    }
+
+    if (pBuffer->pUserData == NULL && pBuffer->capacity > 0) {
+        MD_COPY_MEMORY(pNewItems, pBuffer->pItems, sizeof(*pNewItems) * pBuffer->capacity);
+    }
+
+    pBuffer->pUserData = pNewItems;
+    pBuffer->pItems    = pNewItems;
+    pBuffer->capacity  = newCapacity;
+
+    return MD_SUCCESS;
+}
+
+/*
+Itemizes text in a single pass. The items start out in the font's scratch memory and are moved to the heap if there are too many of them. Free the
+items with md_free_scratch_items() and then md_scratch_release() after freeing the itemize state. On failure nothing needs to be freed.
+*/
+MD_PRIVATE md_result md_itemize__scratch(md_font* pFont, const void* pText, size_t textLength, md_uint32 encoding, md_item_buffer* pItems, md_itemize_state* pItemizeState)
+{
+    md_result result;
+    size_t mark;
+
+    MD_ASSERT(pFont  != NULL);
+    MD_ASSERT(pItems != NULL);
+
+    mark = md_scratch_get_mark(&pFont->scratch);
+
+    /* There can never be more items than there are code units. */
+    pItems->capacity  = (md_uint32)MD_MIN(textLength, 1024);
+    pItems->count     = 0;
+    pItems->onGrow    = md_item_buffer_grow__heap;
+    pItems->pUserData = NULL;
+    pItems->pItems    = (md_item*)md_scratch_alloc(&pFont->scratch, sizeof(*pItems->pItems) * pItems->capacity);
+    if (pItems->pItems == NULL) {
+        return MD_OUT_OF_MEMORY;
+    }
+
+    result = md_itemize__buffer(pFont, pText, textLength, encoding, pItems, pItemizeState);
+    if (result != MD_SUCCESS) {
+        MD_FREE(pItems->pUserData);
+        md_scratch_release(&pFont->scratch, mark);
+        return result;
+    }
+
+    return MD_SUCCESS;
+}
+
+MD_PRIVATE void md_free_scratch_items(md_item_buffer* pItems)
+{
+    MD_ASSERT(pItems != NULL);
+
+    MD_FREE(pItems->pUserData);
+    pItems->pUserData = NULL;
+}
+
+/*
+Shapes a run that's in an encoding the backend doesn't support natively. The run is converted to [nativeEncoding] in the font's scratch memory and
+the clusters are mapped back to the input encoding. Conversions to UTF-8 go through md_shape_utf8() so they can use the shape cache.
+*/
+MD_PRIVATE md_result md_shape__convert(md_font* pFont, md_item* pItem, const void* pText, size_t textLength, md_uint32 encoding, md_uint32 nativeEncoding, md_glyph* pGlyphs, size_t* pGlyphCount, size_t* pClusters, md_text_metrics* pRunMetrics)
+{
+    md_result result;
+    size_t scratchMark;
+    const void* pNativeText;
+    size_t nativeTextLength;
+    size_t* pNativeClusters = NULL;
+
+    scratchMark = md_scratch_get_mark(&pFont->scratch);
+
+    result = md_convert_text__scratch(&pFont->scratch, pText, textLength, encoding, nativeEncoding, &pNativeText, &nativeTextLength);
+    if (result != MD_SUCCESS) {
+        return result;  /* An error occurred when converting. */
+    }
+
+    if (pClusters != NULL) {
+        pNativeClusters = (size_t*)md_scratch_alloc(&pFont->scratch, sizeof(*pNativeClusters) * (nativeTextLength+1));
+        if (pNativeClusters == NULL) {
+            md_scratch_release(&pFont->scratch, scratchMark);
+            return MD_OUT_OF_MEMORY;
+        }
+    }
+
+    if (nativeEncoding == MD_ENCODING_UTF8) {
+        result = md_shape_utf8(pFont, pItem, (const md_utf8*)pNativeText, nativeTextLength, pGlyphs, pGlyphCount, pNativeClusters, pRunMetrics);
+    } else {
+        result = md_shape__backend(pFont, pItem, pNativeText, nativeTextLength, nativeEncoding, pGlyphs, pGlyphCount, pNativeClusters, pRunMetrics);
+    }
+
+    /* The values in pClusters need to be expanded so that they map to the original string. */
+    if (result == MD_SUCCESS && pClusters != NULL) {
+        md_remap_clusters(pText, textLength, encoding, nativeEncoding, pNativeClusters, pClusters);
+    }
+
+    md_scratch_release(&pFont->scratch, scratchMark);
+    return result;
+}
+
+MD_PRIVATE md_result md_shape_utf8__uncached(md_font* pFont, md_item* pItem, const md_utf8* pTextUTF8, size_t textLength, md_glyph* pGlyphs, size_t* pGlyphCount, size_t* pClusters, md_text_metrics* pRunMetrics)
+{
+    md_uint32 nativeEncoding;
+
+    nativeEncoding = md_get_shape_encoding(pFont->pAPI, MD_ENCODING_UTF8);
+    if (nativeEncoding == 0) {
+        return MD_INVALID_OPERATION;    /* Shaping not supported by the backend. */
+    }
+
+    /* If the backend directly supports UTF-8, just pass it straight through. Otherwise we need to convert. */
+    if (nativeEncoding == MD_ENCODING_UTF8) {
+        return pFont->pAPI->procs.shapeUTF8(pFont, pItem, pTextUTF8, textLength, pGlyphs, pGlyphCount, pClusters, pRunMetrics);
+    } else {
+        return md_shape__convert(pFont, pItem, pTextUTF8, textLength, MD_ENCODING_UTF8, nativeEncoding, pGlyphs, pGlyphCount, pClusters, pRunMetrics);
+    }
+}
+
+/*
+Shape Cache
+
+Shaped runs are cached per font and looked up by the item's analysis key and the text. Entries are kept in least-recently-used order and the oldest
+are evicted when the cache goes over its capacity. Each entry is a single allocation holding the text, glyphs and clusters.
+*/
+MD_PRIVATE md_result md_shape_cache_init(size_t capacityInBytes, md_shape_cache* pCache)
+{
+    md_uint32 bucketCount;
+
+    MD_ASSERT(pCache != NULL);
+
+    MD_ZERO_OBJECT(pCache);
+
+    if (capacityInBytes == 0) {
+        return MD_SUCCESS;  /* Caching is disabled. */
+    }
+
+    /* Aim for about one entry per bucket assuming short runs of text. */
+    bucketCount = 64;
+    while (bucketCount < 0x10000 && (size_t)bucketCount*512 < capacityInBytes) {
+        bucketCount <<= 1;
+    }
+
+    pCache->ppBuckets = (md_shape_cache_entry**)MD_CALLOC(bucketCount, sizeof(*pCache->ppBuckets));
+    if (pCache->ppBuckets == NULL) {
+        return MD_OUT_OF_MEMORY;
+    }
+
+    pCache->bucketCount     = bucketCount;
+    pCache->capacityInBytes = capacityInBytes;
+
+    return MD_SUCCESS;
+}
+
+MD_PRIVATE void md_shape_cache_uninit(md_shape_cache* pCache)
+{
+    md_shape_cache_entry* pEntry;
+
+    MD_ASSERT(pCache != NULL);
+
+    pEntry = pCache->pHead;
+    while (pEntry != NULL) {
+        md_shape_cache_entry* pNext = pEntry->pNext;
+        MD_FREE(pEntry);
+        pEntry = pNext;
+    }
+
+    MD_FREE(pCache->ppBuckets);
+    MD_ZERO_OBJECT(pCache);
+}
+
+MD_PRIVATE void md_shape_cache_unlink(md_shape_cache* pCache, md_shape_cache_entry* pEntry)
+{
+    if (pEntry->pPrev != NULL) {
+        pEntry->pPrev->pNext = pEntry->pNext;
+    } else {
+        pCache->pHead = pEntry->pNext;
+    }
+
+    if (pEntry->pNext != NULL) {
+        pEntry->pNext->pPrev = pEntry->pPrev;
+    } else {
+        pCache->pTail = pEntry->pPrev;
+    }
+
+    pEntry->pPrev = NULL;
+    pEntry->pNext = NULL;
+}
+
+MD_PRIVATE void md_shape_cache_link_head(md_shape_cache* pCache, md_shape_cache_entry* pEntry)
+{
+    pEntry->pPrev = NULL;
+    pEntry->pNext = pCache->pHead;
+
+    if (pCache->pHead != NULL) {
+        pCache->pHead->pPrev = pEntry;
+    } else {
+        pCache->pTail = pEntry;
+    }
+
+    pCache->pHead = pEntry;
+}
+
+MD_PRIVATE void md_shape_cache_evict_tail(md_shape_cache* pCache)
+{
+    md_shape_cache_entry* pEntry = pCache->pTail;
+    md_shape_cache_entry** ppLink;
+
+    MD_ASSERT(pEntry != NULL);
+
+    /* Remove it from its bucket first. */
+    for (ppLink = &pCache->ppBuckets[pEntry->hash & (pCache->bucketCount - 1)]; *ppLink != pEntry; ppLink = &(*ppLink)->pNextInBucket) {
+        MD_ASSERT(*ppLink != NULL);
+    }
+    *ppLink = pEntry->pNextInBucket;
+
+    md_shape_cache_unlink(pCache, pEntry);
+
+    pCache->sizeInBytes -= pEntry->sizeInBytes;
+    pCache->entryCount  -= 1;
+    MD_FREE(pEntry);
+}
+
+MD_PRIVATE md_shape_cache_entry* md_shape_cache_find(md_shape_cache* pCache, md_uint64 hash, md_uint64 analysisKey, const md_utf8* pTextUTF8, size_t textLength)
+{
+    md_shape_cache_entry* pEntry;
+
+    for (pEntry = pCache->ppBuckets[hash & (pCache->bucketCount - 1)]; pEntry != NULL; pEntry = pEntry->pNextInBucket) {
+        if (pEntry->hash == hash && pEntry->analysisKey == analysisKey && pEntry->textLength == textLength && memcmp(pEntry->pText, pTextUTF8, textLength) == 0) {
+            return pEntry;
+        }
+    }
+
+    return NULL;
+}
+
+MD_PRIVATE md_shape_cache_entry* md_shape_cache_alloc_entry(size_t textLength, size_t glyphCap)
+{
+    md_shape_cache_entry* pEntry;
+    size_t glyphsOffset;
+    size_t clustersOffset;
+    size_t textOffset;
+    size_t sizeInBytes;
+
+    glyphsOffset   = (sizeof(*pEntry) + 7) & ~(size_t)7;
+    clustersOffset = (glyphsOffset + sizeof(md_glyph)*glyphCap + 7) & ~(size_t)7;
+    textOffset     = clustersOffset + sizeof(size_t)*textLength;
+    sizeInBytes    = textOffset + textLength;
+
+    pEntry = (md_shape_cache_entry*)MD_MALLOC(sizeInBytes);
+    if (pEntry == NULL) {
+        return NULL;
+    }
+
+    MD_ZERO_OBJECT(pEntry);
+    pEntry->sizeInBytes = sizeInBytes;
+    pEntry->textLength  = textLength;
+    pEntry->pGlyphs     = (md_glyph*)MD_OFFSET_PTR(pEntry, glyphsOffset);
+    pEntry->pClusters   = (size_t*)  MD_OFFSET_PTR(pEntry, clustersOffset);
+    pEntry->pText       = (md_utf8*) MD_OFFSET_PTR(pEntry, textOffset);
+
+    return pEntry;
+}
+
+MD_PRIVATE md_result md_shape_utf8__cached(md_font* pFont, md_item* pItem, const md_utf8* pTextUTF8, size_t textLength, md_glyph* pGlyphs, size_t* pGlyphCount, size_t* pClusters, md_text_metrics* pRunMetrics)
+{
+    md_shape_cache* pCache = &pFont->shapeCache;
+    md_shape_cache_entry* pEntry;
+    md_uint64 analysisKey;
+    md_uint64 hash;
+    md_bool32 isCached = MD_TRUE;
+    md_result result = MD_SUCCESS;
+
+    analysisKey = pFont->pAPI->procs.itemGetAnalysisKey(pItem);
+    hash        = md_hash_bytes(md_hash_bytes(md_hash_init(), &analysisKey, sizeof(analysisKey)), pTextUTF8, textLength);
+
+    pEntry = md_shape_cache_find(pCache, hash, analysisKey, pTextUTF8, textLength);
+    if (pEntry != NULL) {
+        pCache->hitCount += 1;
+
+        md_shape_cache_unlink(pCache, pEntry);
+        md_shape_cache_link_head(pCache, pEntry);
+    } else {
+        md_text_metrics runMetrics;
+        size_t glyphCount;
+
+        pCache->missCount += 1;
+
+        /*
+        Most runs have no more glyphs than bytes of text so try that first. Should that not be enough the backend is asked for the real count and it's
+        shaped again. The memory used by any unused glyphs is a small price to pay for not shaping twice in the common case.
+        */
+        glyphCount = textLength + 1;
+        pEntry = md_shape_cache_alloc_entry(textLength, glyphCount);
+        if (pEntry == NULL) {
+            return MD_OUT_OF_MEMORY;
+        }
+
+        result = md_shape_utf8__uncached(pFont, pItem, pTextUTF8, textLength, pEntry->pGlyphs, &glyphCount, pEntry->pClusters, &runMetrics);
+        if (result == MD_NO_SPACE) {
+            MD_FREE(pEntry);
+
+            result = md_shape_utf8__uncached(pFont, pItem, pTextUTF8, textLength, NULL, &glyphCount, NULL, &runMetrics);
+            if (result != MD_SUCCESS) {
+                return result;
+            }
+
+            pEntry = md_shape_cache_alloc_entry(textLength, glyphCount);
+            if (pEntry == NULL) {
+                return MD_OUT_OF_MEMORY;
+            }
+
+            result = md_shape_utf8__uncached(pFont, pItem, pTextUTF8, textLength, pEntry->pGlyphs, &glyphCount, pEntry->pClusters, &runMetrics);
+        }
+
+        if (result != MD_SUCCESS) {
+            MD_FREE(pEntry);
+            return result;
+        }
+
+        pEntry->hash        = hash;
+        pEntry->analysisKey = analysisKey;
+        pEntry->glyphCount  = glyphCount;
+        pEntry->runMetrics  = runMetrics;
+        MD_COPY_MEMORY(pEntry->pText, pTextUTF8, textLength);
+
+        if (pEntry->sizeInBytes <= pCache->capacityInBytes) {
+            md_uint32 iBucket;
+
+            /* Make room by evicting the least recently used runs. */
+            while (pCache->sizeInBytes + pEntry->sizeInBytes > pCache->capacityInBytes) {
+                md_shape_cache_evict_tail(pCache);
+            }
+
+            iBucket = (md_uint32)(hash & (pCache->bucketCount - 1));
+            pEntry->pNextInBucket = pCache->ppBuckets[iBucket];
+            pCache->ppBuckets[iBucket] = pEntry;
+            md_shape_cache_link_head(pCache, pEntry);
+
+            pCache->sizeInBytes += pEntry->sizeInBytes;
+            pCache->entryCount  += 1;
+        } else {
+            isCached = MD_FALSE;    /* Too big to ever fit. It's still used for this call. */
+        }
+    }
+
+    /* The output works the same way as it does without the cache. */
+    if (pGlyphs != NULL && *pGlyphCount < pEntry->glyphCount) {
+        result = MD_NO_SPACE;
+    } else {
+        if (pGlyphs != NULL) {
+            MD_COPY_MEMORY(pGlyphs, pEntry->pGlyphs, sizeof(*pGlyphs) * pEntry->glyphCount);
+        }
+
+        if (pClusters != NULL) {
+            MD_COPY_MEMORY(pClusters, pEntry->pClusters, sizeof(*pClusters) * textLength);
+        }
+
+        if (pRunMetrics != NULL) {
+            *pRunMetrics = pEntry->runMetrics;
+        }
+    }
+
+    if (pGlyphCount != NULL) {
+        *pGlyphCount = pEntry->glyphCount;
+    }
+
+    if (!isCached) {
+        MD_FREE(pEntry);
+    }
+
+    return result;
+}
+
+MD_PRIVATE md_bool32 md_is_fast_shaping_text_utf8(const md_utf8* pTextUTF8, size_t textLength)
+{
+    size_t i;
+
+    for (i = 0; i < textLength; ++i) {
+        if ((md_uint8)pTextUTF8[i] < 0x20 || (md_uint8)pTextUTF8[i] > 0x7E) {
+            return MD_FALSE;
+        }
+    }
+
+    return textLength > 0;
+}
+
+/*
+Builds the table of glyphs for the given item's analysis. Each character is shaped on its own to get its glyph. The table is then checked
+by shaping a string that contains every pair of characters. If each character comes out as the same glyph no matter what it's next to,
+the font doesn't kern or substitute any of them and shaping from the table gives exactly the same output as the backend.
+*/
+MD_PRIVATE void md_fast_shaping_table_init(md_font* pFont, md_item* pItem, md_uint64 analysisKey, md_fast_shaping_table* pTable)
+{
+    md_result result;
+    md_uint32 iChar;
+    md_utf8* pProbe;
+    md_glyph* pProbeGlyphs;
+    size_t* pProbeClusters;
+    size_t probeLength;
+    size_t probeGlyphCount;
+    size_t iProbe;
+    md_text_metrics probeMetrics;
+    md_int32 probeSizeX;
+    void* pHeap;
+
+    MD_ZERO_OBJECT(pTable);
+    pTable->analysisKey = analysisKey;
+
+    for (iChar = 0; iChar < MD_FAST_SHAPING_CHAR_COUNT; ++iChar) {
+        char ch = (char)(' ' + iChar);
+        size_t glyphCount = 1;
+        size_t cluster;
+        md_text_metrics metrics;
+
+        result = md_shape_utf8__uncached(pFont, pItem, &ch, 1, &pTable->glyphs[iChar], &glyphCount, &cluster, &metrics);
+        if (result != MD_SUCCESS || glyphCount != 1) {
+            return;
+        }
+
+        pTable->lPadding[iChar] = metrics.lPadding;
+        pTable->rPadding[iChar] = metrics.rPadding;
+    }
+
+    pTable->isValid = MD_TRUE;
+
+    /* A de Bruijn sequence contains every pair exactly once. It's built from the Lyndon words of length 1 and 2 and then closed off with the first character. */
+    probeLength = (MD_FAST_SHAPING_CHAR_COUNT * MD_FAST_SHAPING_CHAR_COUNT) + 1;
+
+    pHeap = MD_MALLOC((sizeof(*pProbeGlyphs) + sizeof(*pProbeClusters) + sizeof(*pProbe)) * probeLength);
+    if (pHeap == NULL) {
+        return;
+    }
+
+    pProbeGlyphs   = (md_glyph*)pHeap;
+    pProbeClusters = (size_t*)MD_OFFSET_PTR(pHeap, sizeof(*pProbeGlyphs) * probeLength);
+    pProbe         = (md_utf8*)MD_OFFSET_PTR(pHeap, (sizeof(*pProbeGlyphs) + sizeof(*pProbeClusters)) * probeLength);
+
+    iProbe = 0;
+    for (iChar = 0; iChar < MD_FAST_SHAPING_CHAR_COUNT; ++iChar) {
+        md_uint32 iNextChar;
+
+        pProbe[iProbe++] = (char)(' ' + iChar);
+        for (iNextChar = iChar + 1; iNextChar < MD_FAST_SHAPING_CHAR_COUNT; ++iNextChar) {
+            pProbe[iProbe++] = (char)(' ' + iChar);
+            pProbe[iProbe++] = (char)(' ' + iNextChar);
+        }
+    }
+    pProbe[iProbe++] = ' ';
+    MD_ASSERT(iProbe == probeLength);
+
+    /* The glyphs are compared byte for byte so anything the backend doesn't set needs to be the same as the table. */
+    MD_ZERO_MEMORY(pProbeGlyphs, sizeof(*pProbeGlyphs) * probeLength);
+
+    probeGlyphCount = probeLength;
+    result = md_shape_utf8__uncached(pFont, pItem, pProbe, probeLength, pProbeGlyphs, &probeGlyphCount, pProbeClusters, &probeMetrics);
+    if (result == MD_SUCCESS && probeGlyphCount == probeLength) {
+        pTable->isSafe = MD_TRUE;
+
+        probeSizeX = 0;
+        for (iProbe = 0; iProbe < probeLength; ++iProbe) {
+            if (pProbeClusters[iProbe] != iProbe || memcmp(&pProbeGlyphs[iProbe], &pTable->glyphs[(md_uint8)pProbe[iProbe] - ' '], sizeof(md_glyph)) != 0) {
+                pTable->isSafe = MD_FALSE;
+                break;
+            }
+
+            probeSizeX += pProbeGlyphs[iProbe].advance;
+        }
+
+        if (probeSizeX != probeMetrics.sizeX) {
+            pTable->isSafe = MD_FALSE;
+        }
+    }
+
+    MD_FREE(pHeap);
+}
+
+/*
+Retrieves the fast shaping table to use with the given item, building it if necessary. Returns NULL if the table can't be used.
+*/
+MD_PRIVATE const md_fast_shaping_table* md_font_get_fast_shaping_table(md_font* pFont, md_item* pItem)
+{
+    md_uint64 analysisKey;
+    md_uint32 iTable;
+    md_fast_shaping_table* pTables;
+    md_fast_shaping_table* pTable;
+
+    if (pFont->pAPI->procs.itemGetAnalysisKey == NULL) {
+        return NULL;    /* There's no way to tell which items a table can be used with. */
+    }
+
+    analysisKey = pFont->pAPI->procs.itemGetAnalysisKey(pItem);
+
+    pTable = NULL;
+    for (iTable = 0; iTable < pFont->fastShapingTableCount; ++iTable) {
+        if (pFont->pFastShapingTables[iTable].analysisKey == analysisKey) {
+            pTable = &pFont->pFastShapingTables[iTable];
+            break;
+        }
+    }
+
+    if (pTable == NULL) {
+        if (pFont->fastShapingTableCount == MD_FAST_SHAPING_MAX_TABLES) {
+            return NULL;
+        }
+
+        pTables = (md_fast_shaping_table*)MD_REALLOC(pFont->pFastShapingTables, sizeof(*pTables) * (pFont->fastShapingTableCount + 1));
+        if (pTables == NULL) {
+            return NULL;
+        }
+
+        pFont->pFastShapingTables = pTables;
+
+        pTable = &pFont->pFastShapingTables[pFont->fastShapingTableCount];
+        md_fast_shaping_table_init(pFont, pItem, analysisKey, pTable);
+        pFont->fastShapingTableCount += 1;
+    }
+
+    if (!pTable->isValid) {
+        return NULL;
+    }
+
+    if (!pTable->isSafe && pFont->fastShapingMode != md_fast_shaping_mode_enabled) {
+        return NULL;
+    }
+
+    return pTable;
+}
+
+MD_PRIVATE md_result md_shape_utf8__fast(md_font* pFont, const md_fast_shaping_table* pTable, const md_utf8* pTextUTF8, size_t textLength, md_glyph* pGlyphs, size_t* pGlyphCount, size_t* pClusters, md_text_metrics* pRunMetrics)
+{
+    size_t i;
+
+    /* There is always one glyph per character. */
+    if (pGlyphs != NULL && *pGlyphCount < textLength) {
+        *pGlyphCount = textLength;
+        return MD_NO_SPACE;
+    }
+
+    if (pGlyphs != NULL) {
+        for (i = 0; i < textLength; ++i) {
+            pGlyphs[i] = pTable->glyphs[(md_uint8)pTextUTF8[i] - ' '];
+        }
+    }
+
+    if (pClusters != NULL) {
+        for (i = 0; i < textLength; ++i) {
+            pClusters[i] = i;
+        }
+    }
+
+    if (pRunMetrics != NULL) {
+        md_int32 sizeX = 0;
+        for (i = 0; i < textLength; ++i) {
+            sizeX += pTable->glyphs[(md_uint8)pTextUTF8[i] - ' '].advance;
+        }
+
+        pRunMetrics->lPadding = pTable->lPadding[(md_uint8)pTextUTF8[0]              - ' '];
+        pRunMetrics->rPadding = pTable->rPadding[(md_uint8)pTextUTF8[textLength - 1] - ' '];
+        pRunMetrics->sizeX    = sizeX;
+        pRunMetrics->sizeY    = pFont->metricsCache.lineSizeY;
+    }
+
+    if (pGlyphCount != NULL) {
+        *pGlyphCount = textLength;
+    }
+
+    return MD_SUCCESS;
+}
+
+md_result md_shape_utf8(md_font* pFont, md_item* pItem, const md_utf8* pTextUTF8, size_t textLength, md_glyph* pGlyphs, size_t* pGlyphCount, size_t* pClusters, md_text_metrics* pRunMetrics)
+{
+    if (pFont == NULL || pItem == NULL || pTextUTF8 == NULL) {
+        return MD_INVALID_ARGS;
+    }
+
+    /* If we have a glyph array, we must have a glyph count. */
+    if (pGlyphs != NULL) {
+        if (pGlyphCount == NULL) {
+            return MD_INVALID_ARGS;
+        }
+    }
+
+    if (pFont->fastShapingMode != md_fast_shaping_mode_disabled && md_is_fast_shaping_text_utf8(pTextUTF8, textLength)) {
+        const md_fast_shaping_table* pTable = md_font_get_fast_shaping_table(pFont, pItem);
+        if (pTable != NULL) {
+            return md_shape_utf8__fast(pFont, pTable, pTextUTF8, textLength, pGlyphs, pGlyphCount, pClusters, pRunMetrics);
+        }
+    }
+
+    if (pFont->shapeCache.capacityInBytes > 0) {
+        return md_shape_utf8__cached(pFont, pItem, pTextUTF8, textLength, pGlyphs, pGlyphCount, pClusters, pRunMetrics);
+    } else {
+        return md_shape_utf8__uncached(pFont, pItem, pTextUTF8, textLength, pGlyphs, pGlyphCount, pClusters, pRunMetrics);
+    }
+}
+
+MD_PRIVATE md_result md_shape__encoding(md_font* pFont, md_item* pItem, const void* pText, size_t textLength, md_uint32 encoding, md_glyph* pGlyphs, size_t* pGlyphCount, size_t* pClusters, md_text_metrics* pRunMetrics)
+{
+    md_uint32 nativeEncoding;
+
+    if (encoding == MD_ENCODING_UTF8) {
+        return md_shape_utf8(pFont, pItem, (const md_utf8*)pText, textLength, pGlyphs, pGlyphCount, pClusters, pRunMetrics);
+    }
+
+    if (pFont == NULL || pItem == NULL || pText == NULL) {
+        return MD_INVALID_ARGS;
+    }
+
+    /* If we have a glyph array, we must have a glyph count. */
+    if (pGlyphs != NULL) {
+        if (pGlyphCount == NULL) {
+            return MD_INVALID_ARGS;
+        }
+    }
+
+    nativeEncoding = md_get_shape_encoding(pFont->pAPI, encoding);
+    if (nativeEncoding == 0) {
+        return MD_INVALID_OPERATION;    /* Shaping not supported by the backend. */
+    }
+
+    if (nativeEncoding == encoding) {
+        return md_shape__backend(pFont, pItem, pText, textLength, encoding, pGlyphs, pGlyphCount, pClusters, pRunMetrics);
+    } else {
+        return md_shape__convert(pFont, pItem, pText, textLength, encoding, nativeEncoding, pGlyphs, pGlyphCount, pClusters, pRunMetrics);
+    }
+}
+
+md_result md_shape_utf16(md_font* pFont, md_item* pItem, const md_utf16* pTextUTF16, size_t textLength, md_glyph* pGlyphs, size_t* pGlyphCount, size_t* pClusters, md_text_metrics* pRunMetrics)
+{
+    return md_shape__encoding(pFont, pItem, pTextUTF16, textLength, MD_ENCODING_UTF16, pGlyphs, pGlyphCount, pClusters, pRunMetrics);
+}
+
+md_result md_shape_utf32(md_font* pFont, md_item* pItem, const md_utf32* pTextUTF32, size_t textLength, md_glyph* pGlyphs, size_t* pGlyphCount, size_t* pClusters, md_text_metrics* pRunMetrics)
+{
+    return md_shape__encoding(pFont, pItem, pTextUTF32, textLength, MD_ENCODING_UTF32, pGlyphs, pGlyphCount, pClusters, pRunMetrics);
+}
+
+/*
+Shapes an item into glyphs allocated from the font's scratch memory. Free the glyphs with md_scratch_release(). On failure the scratch memory
+is left as it was.
+*/
+MD_PRIVATE md_result md_shape__scratch(md_font* pFont, md_item* pItem, const void* pText, size_t textLength, md_uint32 encoding, md_glyph** ppGlyphs, size_t* pGlyphCount, md_text_metrics* pRunMetrics)
+{
+    md_result result;
+    size_t mark;
+    md_glyph* pGlyphs;
+    size_t glyphCount = textLength + 1;   /* Usually there are fewer glyphs than code units. */
+
+    MD_ASSERT(pFont       != NULL);
+    MD_ASSERT(ppGlyphs    != NULL);
+    MD_ASSERT(pGlyphCount != NULL);
+
+    mark = md_scratch_get_mark(&pFont->scratch);
+
+    pGlyphs = (md_glyph*)md_scratch_alloc(&pFont->scratch, sizeof(*pGlyphs) * glyphCount);
+    if (pGlyphs == NULL) {
+        return MD_OUT_OF_MEMORY;
+    }
+
+    result = md_shape__encoding(pFont, pItem, pText, textLength, encoding, pGlyphs, &glyphCount, NULL, pRunMetrics);
+    if (result == MD_NO_SPACE) {
+        md_scratch_release(&pFont->scratch, mark);
+
+        pGlyphs = (md_glyph*)md_scratch_alloc(&pFont->scratch, sizeof(*pGlyphs) * glyphCount);
+        if (pGlyphs == NULL) {
+            return MD_OUT_OF_MEMORY;
+        }
+
+        result = md_shape__encoding(pFont, pItem, pText, textLength, encoding, pGlyphs, &glyphCount, NULL, pRunMetrics);
+    }
+
+    if (result != MD_SUCCESS) {
+        md_scratch_release(&pFont->scratch, mark);
+        return result;
+    }
+
+    *ppGlyphs    = pGlyphs;
+    *pGlyphCount = glyphCount;
+
+    return MD_SUCCESS;
+}
+
+md_result md_measure_x(md_api* pAPI, const md_item* pItem, const md_glyph* pGlyphs, size_t glyphCount, md_int32* pX)
+{
+    size_t iGlyph;
+    md_int32 runningX;
+
+    if (pAPI == NULL || pItem == NULL || pGlyphs == NULL) {
+        return MD_SUCCESS;
+    }
+
+    runningX = 0;
+    for (iGlyph = 0; iGlyph < glyphCount; ++iGlyph) {
+        runningX += pGlyphs[iGlyph].advance;
+    }
+
+    if (pX != NULL) {
+        *pX = runningX;
+    }
+
+    return MD_SUCCESS;
+}
+
+/*
+Finds the first code unit of the given glyph. Glyphs that don't start a cluster, such as the second glyph of a character that's been decomposed,
+belong to the cluster of the nearest glyph before them that does.
+*/
+MD_PRIVATE size_t md_find_glyph_cluster(const size_t* pClusters, size_t textLength, size_t iGlyph)
+{
+    size_t iCluster;
+    size_t iBestCluster = 0;
+    size_t iBestGlyph = 0;
+    md_bool32 found = MD_FALSE;
+
+    for (iCluster = 0; iCluster < textLength; iCluster += 1) {
+        size_t iClusterGlyph = pClusters[iCluster];
+        if (iClusterGlyph <= iGlyph && (!found || iClusterGlyph > iBestGlyph)) {
+            iBestCluster = iCluster;
+            iBestGlyph   = iClusterGlyph;
+            found        = MD_TRUE;
+        }
+    }
+
+    return iBestCluster;
+}
+
+md_result md_x_to_index(md_api* pAPI, const md_item* pItem, md_int32 x, size_t textLength, const size_t* pClusters, const md_glyph* pGlyphs, size_t glyphCount, size_t* pIndex, md_int32* pOffsetToEdge)
+{
+    size_t iGlyph;
+    md_int32 runningX;
+
+    if (pIndex != NULL) {
+        *pIndex = (size_t)0;
+    }
+    if (pOffsetToEdge != NULL) {
+        *pOffsetToEdge = 0;
+    }
+
+    /* If x is negative we need to clamp it to edge of the run. */
+    if (x < 0) {
+        return MD_SUCCESS;
+    }
+
+    if (pAPI == NULL || pItem == NULL || pClusters == NULL || pGlyphs == NULL) {
+        return MD_INVALID_ARGS;
+    }
+
+    runningX = 0;
+    for (iGlyph = 0; iGlyph < glyphCount; iGlyph += 1) {
+        md_int32 nextRunningX = runningX + pGlyphs[iGlyph].advance;
+        if (x >= runningX && x < nextRunningX) {
+            /* It's somewhere on this glyph. */
+            if (pIndex != NULL) {
+                *pIndex = md_find_glyph_cluster(pClusters, textLength, iGlyph);
+            }
+
+            if (pOffsetToEdge != NULL) {
+                *pOffsetToEdge = runningX - x;
+            }
+
+            return MD_SUCCESS;
+        }
+
+        runningX = nextRunningX;
+    }
+
+    /* Geting here means the point is beyond the string. We just place it at the end. */
+    if (pIndex != NULL) {
+        *pIndex = textLength;
+    }
+    if (pOffsetToEdge != NULL) {
+        *pOffsetToEdge = 0;
+    }
+
+    return MD_SUCCESS;
+}
+
+md_result md_index_to_x(md_api* pAPI, const md_item* pItem, size_t index, size_t textLength, const size_t* pClusters, const md_glyph* pGlyphs, size_t glyphCount, md_int32* pX)
+{
+    size_t iGlyph;
+    md_int32 runningX;
+
+    if (pX != NULL) {
+        *pX = 0;
+    }
+
+    if (pAPI == NULL || pClusters == NULL || pGlyphs == NULL) {
+        return MD_INVALID_ARGS;
+    }
+
+    if (glyphCount == 0) {
+        return MD_SUCCESS;
+    }
+
+    /* Normalize the index if it's out of range. */
+    if (index > textLength) {
+        index = textLength;
+    }
+
+    /* Special case when the code unit is beyond the length of the text. In this case we set pX to end of the run. */
+    runningX = 0;
+    if (index < textLength) {
+        size_t iTargetGlyph = pClusters[index];
+        if (iTargetGlyph > 0) {
+            for (iGlyph = 0; iGlyph < iTargetGlyph; iGlyph += 1) {
+                runningX += pGlyphs[iGlyph].advance;
+            }
+        }
+
+        if (pX != NULL) {
+            *pX = runningX;
+        }
+    } else {
+        /* Go to the end. */
+        MD_ASSERT(index == textLength);
+        return md_measure_x(pAPI, pItem, pGlyphs, glyphCount, pX);
+    }
+
+    return MD_SUCCESS;
+}
+
+/*
+Fills the arrays of a run index. This is separate from md_run_index_init() so that the arrays can be stored elsewhere, such as alongside the
+glyphs of a md_text_block.
+*/
+MD_PRIVATE void md_run_index_build(const size_t* pClusters, size_t textLength, const md_glyph* pGlyphs, size_t glyphCount, md_int32* pGlyphX, size_t* pGlyphClusters)
+{
+    size_t iGlyph;
+    size_t iCluster;
+    md_int32 runningX = 0;
+
+    for (iGlyph = 0; iGlyph < glyphCount; iGlyph += 1) {
+        pGlyphX[iGlyph]        = runningX;
+        pGlyphClusters[iGlyph] = textLength;    /* Marks the glyph as not having a cluster yet. */
+        runningX += pGlyphs[iGlyph].advance;
+    }
+
+    /* Going backwards means the first code unit of each glyph is the one that sticks. */
+    for (iCluster = textLength; iCluster > 0; iCluster -= 1) {
+        size_t iClusterGlyph = pClusters[iCluster - 1];
+        if (iClusterGlyph < glyphCount) {
+            pGlyphClusters[iClusterGlyph] = iCluster - 1;
+        }
+    }
+
+    for (iGlyph = 0; iGlyph < glyphCount; iGlyph += 1) {
+        if (pGlyphClusters[iGlyph] == textLength) {
+            pGlyphClusters[iGlyph] = (iGlyph > 0) ? pGlyphClusters[iGlyph - 1] : 0;
+        }
+    }
+}
+
+/*
+Initializes a run index against arrays that have already been filled with md_run_index_build(). The run index does not take ownership.
+*/
+MD_PRIVATE void md_run_index_init_preallocated(const size_t* pClusters, size_t textLength, const md_glyph* pGlyphs, size_t glyphCount, md_int32* pGlyphX, size_t* pGlyphClusters, md_run_index* pRunIndex)
+{
+    MD_ZERO_OBJECT(pRunIndex);
+    pRunIndex->pClusters      = pClusters;
+    pRunIndex->pGlyphX        = pGlyphX;
+    pRunIndex->pGlyphClusters = pGlyphClusters;
+    pRunIndex->glyphCount     = glyphCount;
+    pRunIndex->textLength     = textLength;
+
+    if (glyphCount > 0) {
+        pRunIndex->sizeX = pGlyphX[glyphCount - 1] + pGlyphs[glyphCount - 1].advance;
+    }
+}
+
+md_result md_run_index_init(const size_t* pClusters, size_t textLength, const md_glyph* pGlyphs, size_t glyphCount, md_run_index* pRunIndex)
+{
+    void* pHeap;
+
+    if (pRunIndex == NULL) {
+        return MD_INVALID_ARGS;
+    }
+
+    MD_ZERO_OBJECT(pRunIndex);
+
+    if (pClusters == NULL || pGlyphs == NULL) {
+        return MD_INVALID_ARGS;
+    }
+
+    pHeap = MD_MALLOC((sizeof(size_t) + sizeof(md_int32)) * (glyphCount + 1));
+    if (pHeap == NULL) {
+        return MD_OUT_OF_MEMORY;
+    }
+
+    md_run_index_build(pClusters, textLength, pGlyphs, glyphCount, (md_int32*)MD_OFFSET_PTR(pHeap, sizeof(size_t) * (glyphCount + 1)), (size_t*)pHeap);
+    md_run_index_init_preallocated(pClusters, textLength, pGlyphs, glyphCount, (md_int32*)MD_OFFSET_PTR(pHeap, sizeof(size_t) * (glyphCount + 1)), (size_t*)pHeap, pRunIndex);
+    pRunIndex->pHeap = pHeap;
+
+    return MD_SUCCESS;
+}
+
+void md_run_index_uninit(md_run_index* pRunIndex)
+{
+    if (pRunIndex == NULL) {
+        return;
+    }
+
+    MD_FREE(pRunIndex->pHeap);
+    MD_ZERO_OBJECT(pRunIndex);
+}
+
+md_result md_run_index_x_to_index(const md_run_index* pRunIndex, const md_int32* pX, size_t count, size_t* pIndices, md_int32* pOffsetsToEdge)
+{
+    size_t i;
+
+    if (pRunIndex == NULL || pX == NULL || pIndices == NULL) {
+        return MD_INVALID_ARGS;
+    }
+
+    for (i = 0; i < count; i += 1) {
+        md_int32 x = pX[i];
+        size_t index;
+        md_int32 offsetToEdge = 0;
+
+        if (x < 0) {
+            index = 0;  /* Clamp to the start of the run. */
+        } else if (x >= pRunIndex->sizeX) {
+            index = pRunIndex->textLength;  /* Beyond the end of the run. */
+        } else {
+            /* Find the last glyph starting at or before x. Glyphs without an advance share their position with the next glyph so they're skipped over naturally. */
+            size_t lo = 0;
+            size_t hi = pRunIndex->glyphCount;
+            while (hi - lo > 1) {
+                size_t mid = lo + ((hi - lo) / 2);
+                if (pRunIndex->pGlyphX[mid] <= x) {
+                    lo = mid;
+                } else {
+                    hi = mid;
+                }
+            }
+
+            index        = pRunIndex->pGlyphClusters[lo];
+            offsetToEdge = pRunIndex->pGlyphX[lo] - x;
+        }
+
+        pIndices[i] = index;
+        if (pOffsetsToEdge != NULL) {
+            pOffsetsToEdge[i] = offsetToEdge;
+        }
+    }
+
+    return MD_SUCCESS;
+}
+
+md_result md_run_index_index_to_x(const md_run_index* pRunIndex, const size_t* pIndices, size_t count, md_int32* pX)
+{
+    size_t i;
+
+    if (pRunIndex == NULL || pIndices == NULL || pX == NULL) {
+        return MD_INVALID_ARGS;
+    }
+
+    for (i = 0; i < count; i += 1) {
+        size_t index = pIndices[i];
+
+        if (index < pRunIndex->textLength && pRunIndex->pClusters[index] < pRunIndex->glyphCount) {
+            pX[i] = pRunIndex->pGlyphX[pRunIndex->pClusters[index]];
+        } else {
+            pX[i] = pRunIndex->sizeX;
+        }
+    }
+
+    return MD_SUCCESS;
+}
+
+
+/**************************************************************************************************************************************************************
+
+Fonts
+
+**************************************************************************************************************************************************************/
+md_result md_font_init(md_api* pAPI, const md_font_config* pConfig, md_font* pFont)
+{
+    md_result result;
+
+    if (pFont == NULL) {
+        return MD_INVALID_ARGS;
+    }
+
+    MD_ZERO_OBJECT(pFont);
+
+    if (pAPI == NULL || pConfig == NULL) {
+        return MD_INVALID_ARGS;
+    }
+
+    pFont->pAPI = pAPI;
+    pFont->pUserData = pConfig->pUserData;
+    pFont->fastShapingMode = pConfig->fastShapingMode;
+
+    result = pAPI->procs.fontInit(pAPI, pConfig, pFont);
+    if (result != MD_SUCCESS) {
+        return result;
+    }
+
+    /* The advance of a space needs shaping and is retrieved on first use with md_font_load_space_size(). */
+    pFont->metricsCache.lineSizeY = pFont->metrics.ascent - pFont->metrics.descent;
+
+    /* The shape cache can only be used if the backend can tell us what affects the shaping of an item. */
+    if (pAPI->procs.itemGetAnalysisKey != NULL) {
+        result = md_shape_cache_init(pConfig->shapeCacheSizeInBytes, &pFont->shapeCache);
+        if (result != MD_SUCCESS) {
+            if (pAPI->procs.fontUninit) {
+                pAPI->procs.fontUninit(pFont);
+            }
+
+            return result;
+        }
+    }
+
+    return MD_SUCCESS;
+}
+
+void md_font_uninit(md_font* pFont)
+{
+    if (pFont == NULL) {
+        return;
+    }
+
+    md_shape_cache_uninit(&pFont->shapeCache);
+    md_scratch_uninit(&pFont->scratch);
+
+    MD_FREE(pFont->pFastShapingTables);
+    pFont->pFastShapingTables = NULL;
+
+    if (pFont->pAPI->procs.fontUninit) {
+        pFont->pAPI->procs.fontUninit(pFont);
+    }
+    
+    MD_ZERO_OBJECT(pFont);  /* Safety. */
+}
+
+md_result md_font_get_glyph_metrics(md_font* pFont, const md_glyph* pGlyphs, size_t glyphCount, md_glyph_metrics* pGlyphMetrics)
+{
+    if (pGlyphMetrics == NULL) {
+        return MD_INVALID_ARGS;
+    }
+
+    MD_ZERO_MEMORY(pGlyphMetrics, sizeof(*pGlyphMetrics) * glyphCount);
+
+    if (pFont == NULL || pGlyphs == NULL) {
+        return MD_INVALID_ARGS;
+    }
+
+    if (pFont->pAPI->procs.fontGetGlyphMetrics == NULL) {
+        return MD_INVALID_OPERATION;
+    }
+
+    return pFont->pAPI->procs.fontGetGlyphMetrics(pFont, pGlyphs, glyphCount, pGlyphMetrics);
+}
+
+md_result md_font_get_glyph_metrics_by_index(md_font* pFont, const md_uint32* pGlyphIndices, size_t glyphCount, md_glyph_metrics* pGlyphMetrics)
+{
+    if (pGlyphMetrics == NULL) {
+        return MD_INVALID_ARGS;
+    }
+
+    MD_ZERO_MEMORY(pGlyphMetrics, sizeof(*pGlyphMetrics) * glyphCount);
+
+    if (pFont == NULL || pGlyphIndices == NULL) {
+        return MD_INVALID_ARGS;
+    }
+
+    if (pFont->pAPI->procs.fontGetGlyphMetricsByIndex == NULL) {
+        return MD_INVALID_OPERATION;
+    }
+
+    return pFont->pAPI->procs.fontGetGlyphMetricsByIndex(pFont, pGlyphIndices, glyphCount, pGlyphMetrics);
+}
+
+md_result md_font_get_shape_cache_stats(md_font* pFont, md_shape_cache_stats* pStats)
+{
+    if (pStats == NULL) {
+        return MD_INVALID_ARGS;
+    }
+
+    MD_ZERO_OBJECT(pStats);
+
+    if (pFont == NULL) {
+        return MD_INVALID_ARGS;
+    }
+
+    if (pFont->shapeCache.capacityInBytes == 0) {
+        return MD_INVALID_OPERATION;
+    }
+
+    pStats->hitCount        = pFont->shapeCache.hitCount;
+    pStats->missCount       = pFont->shapeCache.missCount;
+    pStats->runCount        = pFont->shapeCache.entryCount;
+    pStats->sizeInBytes     = pFont->shapeCache.sizeInBytes;
+    pStats->capacityInBytes = pFont->shapeCache.capacityInBytes;
+
+    return MD_SUCCESS;
+}
+
+md_result md_font_get_glyph_cache_stats(md_font* pFont, md_glyph_cache_stats* pStats)
+{
+    if (pStats == NULL) {
+        return MD_INVALID_ARGS;
+    }
+
+    MD_ZERO_OBJECT(pStats);
+
+    if (pFont == NULL) {
+        return MD_INVALID_ARGS;
+    }
+
+    if (pFont->pAPI->procs.fontGetGlyphCacheStats == NULL) {
+        return MD_INVALID_OPERATION;
+    }
+
+    return pFont->pAPI->procs.fontGetGlyphCacheStats(pFont, pStats);
+}
+
+/*
+Fills the advance of a space in the font's metrics cache if it hasn't been already. The shape cache is bypassed so that this doesn't push
+out real text. If the space can't be measured it falls back to 8 pixels so that tab stops are still usable.
+*/
+static void md_font_load_space_size(md_font* pFont)
+{
+    char ch = ' ';
+    md_result result;
+    md_itemize_state itemizeState;
+    md_item item;
+    md_uint32 itemCount = 1;
+    size_t glyphCount = 0;
+    md_text_metrics metrics;
+
+    MD_ASSERT(pFont != NULL);
+
+    if (pFont->metricsCache.hasSpaceSizeX) {
+        return;
+    }
+
+    pFont->metricsCache.hasSpaceSizeX = MD_TRUE;
+
+    MD_ZERO_OBJECT(&metrics);
+
+    result = md_itemize_utf8(pFont, &ch, 1, &item, &itemCount, &itemizeState);
+    if (result == MD_SUCCESS) {
+        result = md_shape_utf8__uncached(pFont, &item, &ch, 1, NULL, &glyphCount, NULL, &metrics);
+        md_free_itemize_state(&itemizeState);
+    }
+
+    pFont->metricsCache.spaceSizeX = (result == MD_SUCCESS) ? metrics.sizeX : 0;
+    if (pFont->metricsCache.spaceSizeX <= 0) {
+        pFont->metricsCache.spaceSizeX = 8;
+    }
+}
+
+static md_result md_font_get_text_metrics__encoding(md_font* pFont, const void* pText, size_t textLength, md_uint32 encoding, md_text_metrics* pTextMetrics)
+{
+    md_int32 lineHeight;
+    md_int32 lineWidth;
+
+    if (pTextMetrics == NULL) {
+        return MD_INVALID_ARGS;
+    }
+
+    MD_ZERO_OBJECT(pTextMetrics);
+
+    if (pFont == NULL || pText == NULL) {
+        return MD_INVALID_ARGS;
+    }
+
+    lineHeight = pFont->metricsCache.lineSizeY;
+
+    if (textLength == 0) {
+        pTextMetrics->sizeY = lineHeight;
+        return MD_SUCCESS;  /* Nothing to do. */
+    }
+
+    /* TODO: Add support for backend-optimized implementations. */
+#if 0
+    if (encoding == MD_ENCODING_UTF8 && pFont->pAPI->procs.fontGetTextMetricsUTF8) {
+        return pFont->pAPI->procs.fontGetTextMetricsUTF8(pFont, (const md_utf8*)pText, textLength, pTextMetrics);
+    } else
+#endif
+    {
+        /* Generic implementation. */
+        md_result result;
+        md_int32  sizeX = 0;
+        md_int32  sizeY = lineHeight;
+        md_itemize_state itemizeState;
+        size_t    scratchMark;
+        md_item_buffer items;
+        md_item*  pItems;
+        md_uint32 itemCount;
+        md_uint32 iItem;
+
+        /* The first step is to itemize. */
+        scratchMark = md_scratch_get_mark(&pFont->scratch);
+        result = md_itemize__scratch(pFont, pText, textLength, encoding, &items, &itemizeState);
+        if (result != MD_SUCCESS) {
+            return result;
+        }
+
+        pItems    = items.pItems;
+        itemCount = items.count;
+
+        /* We have the items so now we can measure them. */
+        lineWidth = 0;
+        for (iItem = 0; iItem < itemCount; ++iItem) {
+            /* No need to do shaping for new-lines. */
+            if (md_is_newline(MD_TEXT_AT(pText, pItems[iItem].offset, encoding), pItems[iItem].length, encoding)) {
+                sizeY += lineHeight;
+                if (sizeX < lineWidth) {
+                    sizeX = lineWidth;
+                }
+                lineWidth = 0;
+            } else {
+                md_text_metrics itemMetrics;
+                result = md_shape__encoding(pFont, &pItems[iItem], MD_TEXT_AT(pText, pItems[iItem].offset, encoding), pItems[iItem].length, encoding, NULL, NULL, NULL, &itemMetrics);
+                if (result != MD_SUCCESS) {
+                    md_free_itemize_state(&itemizeState);
+                    md_free_scratch_items(&items);
+                    md_scratch_release(&pFont->scratch, scratchMark);
+                    return result;
+                }
+
+                lineWidth += itemMetrics.sizeX;
+            }
+        }
+
+        /* Don't forget to check the last line. */
+        if (sizeX < lineWidth) {
+            sizeX = lineWidth;
+        }
+
+        pTextMetrics->sizeX = sizeX;
+        pTextMetrics->sizeY = sizeY;
+
+        md_free_itemize_state(&itemizeState);
+        md_free_scratch_items(&items);
+        md_scratch_release(&pFont->scratch, scratchMark);
+        return MD_SUCCESS;
+    }
+}
+
+/*
+Runs a whole-string text function in an encoding the backend can handle natively. UTF-8 is always used as is so that it can take advantage of the shape
+cache. Anything else is converted once for the whole string rather than once per item.
+*/
+static md_result md_font_get_text_metrics__any(md_font* pFont, const void* pText, size_t textLength, md_uint32 encoding, md_text_metrics* pTextMetrics)
+{
+    md_result result;
+    md_uint32 textEncoding;
+    size_t scratchMark;
+    const void* pConvertedText;
+    size_t convertedTextLength;
+
+    if (pFont == NULL || pText == NULL || encoding == MD_ENCODING_UTF8) {
+        return md_font_get_text_metrics__encoding(pFont, pText, textLength, encoding, pTextMetrics);
+    }
+
+    textEncoding = md_get_text_encoding(pFont->pAPI, encoding);
+    if (textEncoding == encoding) {
+        return md_font_get_text_metrics__encoding(pFont, pText, textLength, encoding, pTextMetrics);
+    }
+
+    if (textLength == (size_t)-1) {
+        textLength = md_get_text_length_null_terminated(pText, encoding);
+    }
+
+    scratchMark = md_scratch_get_mark(&pFont->scratch);
+
+    result = md_convert_text__scratch(&pFont->scratch, pText, textLength, encoding, textEncoding, &pConvertedText, &convertedTextLength);
+    if (result != MD_SUCCESS) {
+        if (pTextMetrics != NULL) {
+            MD_ZERO_OBJECT(pTextMetrics);
+        }
+        return result;
+    }
+
+    result = md_font_get_text_metrics__encoding(pFont, pConvertedText, convertedTextLength, textEncoding, pTextMetrics);
+
+    md_scratch_release(&pFont->scratch, scratchMark);
+    return result;
+}
+
+md_result md_font_get_text_metrics_utf8(md_font* pFont, const md_utf8* pTextUTF8, size_t textLength, md_text_metrics* pTextMetrics)
+{
+    return md_font_get_text_metrics__any(pFont, pTextUTF8, textLength, MD_ENCODING_UTF8, pTextMetrics);
+}
+
+md_result md_font_get_text_metrics_utf16(md_font* pFont, const md_utf16* pTextUTF16, size_t textLength, md_text_metrics* pTextMetrics)
+{
+    return md_font_get_text_metrics__any(pFont, pTextUTF16, textLength, MD_ENCODING_UTF16, pTextMetrics);
+}
+
+md_result md_font_get_text_metrics_utf32(md_font* pFont, const md_utf32* pTextUTF32, size_t textLength, md_text_metrics* pTextMetrics)
+{
+    return md_font_get_text_metrics__any(pFont, pTextUTF32, textLength, MD_ENCODING_UTF32, pTextMetrics);
+}
+
+
+/**************************************************************************************************************************************************************
+
+Graphics
+
+**************************************************************************************************************************************************************/
+md_result md_brush_init(md_api* pAPI, const md_brush_config* pConfig, md_brush* pBrush)
+{
+    md_result result;
+
+    if (pBrush == NULL) {
+        return MD_INVALID_ARGS;
+    }
+
+    MD_ZERO_OBJECT(pBrush);
+
+    if (pAPI == NULL || pConfig == NULL) {
+        return MD_INVALID_ARGS;
+    }
+
+    pBrush->pAPI = pAPI;
+    pBrush->pUserData = pConfig->pUserData;
+    pBrush->config = *pConfig;
+
+    if (pAPI->procs.brushInit) {
+        result = pAPI->procs.brushInit(pAPI, pConfig, pBrush);
+        if (result != MD_SUCCESS) {
+            return result;
+        }
+    }
+
+    return MD_SUCCESS;
+}
+
+void md_brush_uninit(md_brush* pBrush)
+{
+    if (pBrush == NULL) {
+        return;
+    }
+
+    MD_ASSERT(pBrush->pAPI != NULL);
+
+    if (pBrush->pAPI->procs.brushUninit) {
+        pBrush->pAPI->procs.brushUninit(pBrush);
+    }
+
+    MD_ZERO_OBJECT(pBrush);  /* Safety. */
+}
+
+void md_brush_set_origin(md_brush* pBrush, md_int32 x, md_int32 y)
+{
+    if (pBrush == NULL) {
+        return;
+    }
+
+    MD_ASSERT(pBrush->pAPI != NULL);
+
+    if (pBrush->pAPI->procs.brushSetOrigin) {
+        pBrush->pAPI->procs.brushSetOrigin(pBrush, x, y);
+    }
+}
+
+md_result md_gc_init(md_api* pAPI, const md_gc_config* pConfig, md_gc* pGC)
+{
+    md_result result;
+
+    if (pGC == NULL) {
+        return MD_INVALID_ARGS;
+    }
+
+    MD_ZERO_OBJECT(pGC);
+
+    if (pAPI == NULL || pConfig == NULL) {
+        return MD_INVALID_ARGS;
+    }
+
+    pGC->pAPI = pAPI;
+    pGC->pUserData = pConfig->pUserData;
+
+    if (pAPI->procs.gcInit) {
+        result = pAPI->procs.gcInit(pAPI, pConfig, pGC);
+        if (result != MD_SUCCESS) {
+            return result;
+        }
+    }
+
+    return MD_SUCCESS;
+}
+
+void md_gc_uninit(md_gc* pGC)
+{
+    if (pGC == NULL) {
+        return;
+    }
+
+    MD_ASSERT(pGC->pAPI != NULL);
+
+    if (pGC->pAPI->procs.gcUninit) {
+        pGC->pAPI->procs.gcUninit(pGC);
+    }
+
+    md_scratch_uninit(&pGC->scratch);
+}
+
+md_result md_gc_get_image_data_size_in_bytes(md_gc* pGC, md_format outputFormat, size_t* pSizeInBytes)
+{
+    md_result result;
+    md_uint32 sizeX;
+    md_uint32 sizeY;
+
+    if (pSizeInBytes != NULL) {
+        *pSizeInBytes = 0;  /* Safety. */
+    }
+
+    if (pGC == NULL || pSizeInBytes == NULL) {
+        return MD_INVALID_ARGS;
+    }
+
+    MD_ASSERT(pGC->pAPI != NULL);
+
+    result = md_gc_get_size(pGC, &sizeX, &sizeY);
+    if (result != MD_SUCCESS) {
+        return result;
+    }
+
+    *pSizeInBytes = sizeX * sizeY * md_get_bytes_per_pixel(outputFormat);
+
+    return MD_SUCCESS;
+}
+
+md_result md_gc_get_image_data(md_gc* pGC, md_format outputFormat, void* pImageData)
+{
+    md_result result;
+
+    if (pGC == NULL || pImageData == NULL) {
+        return MD_INVALID_ARGS;
+    }
+
+    MD_ASSERT(pGC->pAPI != NULL);
+
+    if (pGC->pAPI->procs.gcGetImageData) {
+        result = pGC->pAPI->procs.gcGetImageData(pGC, outputFormat, pImageData);
+        if (result != MD_SUCCESS) {
+            return result;
+        }
+
+        return result;
+    } else {
+        return MD_INVALID_OPERATION;
+    }
+}
+
+md_result md_gc_get_size(md_gc* pGC, md_uint32* pSizeX, md_uint32* pSizeY)
+{
+    if (pSizeX != NULL) {
+        *pSizeX = 0;
+    }
+    if (pSizeY != NULL) {
+        *pSizeY = 0;
+    }
+
+    if (pGC == NULL) {
+        return MD_INVALID_ARGS;
+    }
+
+    MD_ASSERT(pGC->pAPI != NULL);
+
+    if (pGC->pAPI->procs.gcGetSize) {
+        md_uint32 sizeX;
+        md_uint32 sizeY;
+        md_result result = pGC->pAPI->procs.gcGetSize(pGC, &sizeX, &sizeY);
+        if (result != MD_SUCCESS) {
+            return result;
+        }
+
+        if (pSizeX != NULL) {
+            *pSizeX = sizeX;
+        }
+        if (pSizeY != NULL) {
+            *pSizeY = sizeY;
+        }
+    }
+
+    return MD_SUCCESS;
+}
+
+md_result md_gc_save(md_gc* pGC)
+{
+    if (pGC == NULL) {
+        return MD_INVALID_ARGS;
+    }
+
+    MD_ASSERT(pGC->pAPI != NULL);
+
+    if (pGC->pAPI->procs.gcSave) {
+        return pGC->pAPI->procs.gcSave(pGC);
+    }
+    
+    return MD_SUCCESS;
+}
+
+md_result md_gc_restore(md_gc* pGC)
+{
+    if (pGC == NULL) {
+        return MD_INVALID_ARGS;
+    }
+
+    MD_ASSERT(pGC->pAPI != NULL);
+
+    if (pGC->pAPI->procs.gcRestore) {
+        return pGC->pAPI->procs.gcRestore(pGC);
+    }
+    
+    return MD_SUCCESS;
+}
+
+void md_gc_set_matrix(md_gc* pGC, const md_matrix* pMatrix)
+{
+    if (pGC == NULL || pMatrix == NULL) {
+        return;
+    }
+
+    MD_ASSERT(pGC->pAPI != NULL);
+
+    if (pGC->pAPI->procs.gcSetMatrix) {
+        pGC->pAPI->procs.gcSetMatrix(pGC, pMatrix);
+    }
+}
+
+void md_gc_get_matrix(md_gc* pGC, md_matrix* pMatrix)
+{
+    if (pGC == NULL || pMatrix == NULL) {
+        return;
+    }
+
+    MD_ASSERT(pGC->pAPI != NULL);
+
+    if (pGC->pAPI->procs.gcGetMatrix) {
+        pGC->pAPI->procs.gcGetMatrix(pGC, pMatrix);
+    }
+}
+
+void md_gc_set_matrix_identity(md_gc* pGC)
+{
+    if (pGC == NULL) {
+        return;
+    }
+
+    MD_ASSERT(pGC->pAPI != NULL);
+
+    if (pGC->pAPI->procs.gcSetMatrixIdentity) {
+        pGC->pAPI->procs.gcSetMatrixIdentity(pGC);
+    }
+}
+
+void md_gc_transform(md_gc* pGC, const md_matrix* pMatrix)
+{
+    if (pGC == NULL || pMatrix == NULL) {
+        return;
+    }
+
+    MD_ASSERT(pGC->pAPI != NULL);
+
+    if (pGC->pAPI->procs.gcTransform) {
+        pGC->pAPI->procs.gcTransform(pGC, pMatrix);
+    }
+}
+
+void md_gc_translate(md_gc* pGC, md_int32 offsetX, md_int32 offsetY)
+{
+    if (pGC == NULL) {
+        return;
+    }
+
+    MD_ASSERT(pGC->pAPI != NULL);
+
+    if (pGC->pAPI->procs.gcTranslate) {
+        pGC->pAPI->procs.gcTranslate(pGC, offsetX, offsetY);
+    }
+}
+
+void md_gc_rotate(md_gc* pGC, float rotationInRadians)
+{
+    if (pGC == NULL) {
+        return;
+    }
+
+    MD_ASSERT(pGC->pAPI != NULL);
+
+    if (pGC->pAPI->procs.gcRotate) {
+        pGC->pAPI->procs.gcRotate(pGC, rotationInRadians);
+    }
+}
+
+void md_gc_scale(md_gc* pGC, float scaleX, float scaleY)
+{
+    if (pGC == NULL) {
+        return;
+    }
+
+    MD_ASSERT(pGC->pAPI != NULL);
+
+    if (pGC->pAPI->procs.gcScale) {
+        pGC->pAPI->procs.gcScale(pGC, scaleX, scaleY);
+    }
+}
+
+void md_gc_set_miter_limit(md_gc* pGC, float limit)
+{
+    if (pGC == NULL) {
+        return;
+    }
+
+    MD_ASSERT(pGC->pAPI != NULL);
+
+    if (pGC->pAPI->procs.gcSetMiterLimit) {
+        pGC->pAPI->procs.gcSetMiterLimit(pGC, limit);
+    }
+}
+
+void md_gc_set_line_width(md_gc* pGC, md_int32 width)
+{
+    if (pGC == NULL) {
+        return;
+    }
+
+    MD_ASSERT(pGC->pAPI != NULL);
+
+    if (pGC->pAPI->procs.gcSetLineWidth) {
+        pGC->pAPI->procs.gcSetLineWidth(pGC, width);
+    }
+}
+
+void md_gc_set_line_cap(md_gc* pGC, md_line_cap cap)
+{
+    if (pGC == NULL) {
+        return;
+    }
+
+    MD_ASSERT(pGC->pAPI != NULL);
+
+    if (pGC->pAPI->procs.gcSetLineCap) {
+        pGC->pAPI->procs.gcSetLineCap(pGC, cap);
+    }
+}
+
+void md_gc_set_line_join(md_gc* pGC, md_line_join join)
+{
+    if (pGC == NULL) {
+        return;
+    }
+
+    MD_ASSERT(pGC->pAPI != NULL);
+
+    if (pGC->pAPI->procs.gcSetLineJoin) {
+        pGC->pAPI->procs.gcSetLineJoin(pGC, join);
+    }
+}
+
+void md_gc_set_line_dash(md_gc* pGC, const float* dashes, md_uint32 count)
+{
+    if (pGC == NULL) {
+        return;
+    }
+
+    MD_ASSERT(pGC->pAPI != NULL);
+
+    if (count > 16) {
+        return; /* Count cannot be more than 16. */
+    }
+
+    if (pGC->pAPI->procs.gcSetLineDash) {
+        pGC->pAPI->procs.gcSetLineDash(pGC, dashes, count);
+    }
+}
+
+void md_gc_set_line_brush(md_gc* pGC, md_brush* pBrush)
+{
+    if (pGC == NULL) {
+        return;
+    }
+
+    MD_ASSERT(pGC->pAPI != NULL);
+
+    if (pGC->pAPI->procs.gcSetLineBrush) {
+        pGC->pAPI->procs.gcSetLineBrush(pGC, pBrush);
+    }
+}
+
+void md_gc_set_line_brush_solid(md_gc* pGC, md_color color)
+{
+    if (pGC == NULL) {
+        return;
+    }
+
+    MD_ASSERT(pGC->pAPI != NULL);
+
+    if (pGC->pAPI->procs.gcSetLineBrushSolid) {
+        pGC->pAPI->procs.gcSetLineBrushSolid(pGC, color);
+    }
+}
+
+void md_gc_set_line_brush_gc(md_gc* pGC, md_gc* pSrcGC)
+{
+    if (pGC == NULL) {
+        return;
+    }
+
+    MD_ASSERT(pGC->pAPI != NULL);
+
+    if (pGC->pAPI->procs.gcSetLineBrushGC) {
+        pGC->pAPI->procs.gcSetLineBrushGC(pGC, pSrcGC);
+    }
+}
+
+void md_gc_set_fill_brush(md_gc* pGC, md_brush* pBrush)
+{
+    if (pGC == NULL) {
+        return;
+    }
+
+    MD_ASSERT(pGC->pAPI != NULL);
+
+    if (pGC->pAPI->procs.gcSetFillBrush) {
+        pGC->pAPI->procs.gcSetFillBrush(pGC, pBrush);
+    }
+}
+
+void md_gc_set_fill_brush_solid(md_gc* pGC, md_color color)
+{
+    if (pGC == NULL) {
+        return;
+    }
+
+    MD_ASSERT(pGC->pAPI != NULL);
+
+    if (pGC->pAPI->procs.gcSetFillBrushSolid) {
+        pGC->pAPI->procs.gcSetFillBrushSolid(pGC, color);
+    }
+}
+
+void md_gc_set_fill_brush_gc(md_gc* pGC, md_gc* pSrcGC)
+{
+    if (pGC == NULL) {
+        return;
+    }
+
+    MD_ASSERT(pGC->pAPI != NULL);
+
+    if (pGC->pAPI->procs.gcSetFillBrushGC) {
+        pGC->pAPI->procs.gcSetFillBrushGC(pGC, pSrcGC);
+    }
+}
+
+void md_gc_set_text_fg_color(md_gc* pGC, md_color fgColor)
+{
+    if (pGC == NULL) {
+        return;
+    }
+
+    MD_ASSERT(pGC->pAPI != NULL);
+
+    if (pGC->pAPI->procs.gcSetTextFGColor) {
+        pGC->pAPI->procs.gcSetTextFGColor(pGC, fgColor);
+    }
+}
+
+void md_gc_set_text_bg_color(md_gc* pGC, md_color bgColor)
+{
+    if (pGC == NULL) {
+        return;
+    }
+
+    MD_ASSERT(pGC->pAPI != NULL);
+
+    if (pGC->pAPI->procs.gcSetTextBGColor) {
+        pGC->pAPI->procs.gcSetTextBGColor(pGC, bgColor);
+    }
+}
+
+md_color md_gc_get_text_fg_color(md_gc* pGC)
+{
+    if (pGC != NULL) {
+        MD_ASSERT(pGC->pAPI != NULL);
+
+        if (pGC->pAPI->procs.gcGetTextFGColor) {
+            return pGC->pAPI->procs.gcGetTextFGColor(pGC);
+        }
+    }
+
+    return md_rgba(0, 0, 0, 255);
+}
+
+md_color md_gc_get_text_bg_color(md_gc* pGC)
+{
+    if (pGC != NULL) {
+        MD_ASSERT(pGC->pAPI != NULL);
+
+        if (pGC->pAPI->procs.gcGetTextBGColor) {
+            return pGC->pAPI->procs.gcGetTextBGColor(pGC);
+        }
+    }
+
+    return md_rgba(0, 0, 0, 0);
+}
+
+void md_gc_set_blend_op(md_gc* pGC, md_blend_op op)
+{
+    if (pGC == NULL) {
+        return;
+    }
+
+    MD_ASSERT(pGC->pAPI != NULL);
+
+    if (pGC->pAPI->procs.gcSetBlendOp) {
+        pGC->pAPI->procs.gcSetBlendOp(pGC, op);
+    }
+}
+
+void md_gc_set_antialias_mode(md_gc* pGC, md_antialias_mode mode)
+{
+    if (pGC == NULL) {
+        return;
+    }
+
+    MD_ASSERT(pGC->pAPI != NULL);
+
+    if (pGC->pAPI->procs.gcSetAntialiasMode) {
+        pGC->pAPI->procs.gcSetAntialiasMode(pGC, mode);
+    }
+}
+
+void md_gc_set_fill_mode(md_gc* pGC, md_fill_mode mode)
+{
+    if (pGC == NULL) {
+        return;
+    }
+
+    MD_ASSERT(pGC->pAPI != NULL);
+
+    if (pGC->pAPI->procs.gcSetFillMode) {
+        pGC->pAPI->procs.gcSetFillMode(pGC, mode);
+    }
+}
+
+void md_gc_set_stretch_filter(md_gc* pGC, md_stretch_filter filter)
+{
+    if (pGC == NULL) {
+        return;
+    }
+
+    MD_ASSERT(pGC->pAPI != NULL);
+
+    if (pGC->pAPI->procs.gcSetStretchFilter) {
+        pGC->pAPI->procs.gcSetStretchFilter(pGC, filter);
+    }
+}
+
+void md_gc_move_to(md_gc* pGC, md_int32 x, md_int32 y)
+{
+    if (pGC == NULL) {
+        return;
+    }
+
+    MD_ASSERT(pGC->pAPI != NULL);
+
+    if (pGC->pAPI->procs.gcMoveTo) {
+        pGC->pAPI->procs.gcMoveTo(pGC, x, y);
+    }
+}
+
+void md_gc_line_to(md_gc* pGC, md_int32 x, md_int32 y)
+{
+    if (pGC == NULL) {
+        return;
+    }
+
+    MD_ASSERT(pGC->pAPI != NULL);
+
+    if (pGC->pAPI->procs.gcLineTo) {
+        pGC->pAPI->procs.gcLineTo(pGC, x, y);
+    }
+}
+
+void md_gc_rectangle(md_gc* pGC, md_int32 left, md_int32 top, md_int32 right, md_int32 bottom)
+{
+    if (pGC == NULL) {
+        return;
+    }
+
+    MD_ASSERT(pGC->pAPI != NULL);
+
+    if (pGC->pAPI->procs.gcRectangle) {
+        pGC->pAPI->procs.gcRectangle(pGC, left, top, right, bottom);
+    }
+}
+
+void md_gc_arc(md_gc* pGC, md_int32 x, md_int32 y, md_int32 radius, float angle1InRadians, float angle2InRadians)
+{
+    if (pGC == NULL) {
+        return;
+    }
+
+    MD_ASSERT(pGC->pAPI != NULL);
+
+    if (pGC->pAPI->procs.gcArc) {
+        pGC->pAPI->procs.gcArc(pGC, x, y, radius, angle1InRadians, angle2InRadians);
+    }
+}
+
+void md_gc_curve_to(md_gc* pGC, md_int32 x1, md_int32 y1, md_int32 x2, md_int32 y2, md_int32 x3, md_int32 y3)
+{
+    if (pGC == NULL) {
+        return;
+    }
+
+    MD_ASSERT(pGC->pAPI != NULL);
+
+    if (pGC->pAPI->procs.gcCurveTo) {
+        pGC->pAPI->procs.gcCurveTo(pGC, x1, y1, x2, y2, x3, y3);
+    }
+}
+
+void md_gc_close_path(md_gc* pGC)
+{
+    if (pGC == NULL) {
+        return;
+    }
+
+    MD_ASSERT(pGC->pAPI != NULL);
+
+    if (pGC->pAPI->procs.gcClosePath) {
+        pGC->pAPI->procs.gcClosePath(pGC);
+    }
+}
+
+void md_gc_rectangle_border_inner(md_gc* pGC, md_int32 left, md_int32 top, md_int32 right, md_int32 bottom, md_int32 borderWidth)
+{
+    /*
+    There's two ways to do this. We can define the path as 4 rectangles (one for each side of the border) or we can define it as an outer
+    path and an inner path. The advantage of the former is that it works will both types of fill modes whereas the later will only work with
+    even-odd filling. For this reason I am using the former option as it should Just Work in more configurations.
+    */
+
+    /* 4-Rectangles Version. Make sure there is no overlap between the pieces. */
+    md_gc_rectangle(pGC, left,                top,                  left  + borderWidth, bottom);               /* Left */
+    md_gc_rectangle(pGC, right - borderWidth, top,                  right,               bottom);               /* Right */
+    md_gc_rectangle(pGC, left  + borderWidth, top,                  right - borderWidth, top + borderWidth);    /* Top */
+    md_gc_rectangle(pGC, left  + borderWidth, bottom - borderWidth, right - borderWidth, bottom);               /* Bottom */
+
+    /* Outer / Inner Version. */
+#if 0
+    /* Outer */
+    md_gc_move_to(pGC, left, top);
+    md_gc_line_to(pGC, left, bottom);
+    md_gc_line_to(pGC, right, bottom);
+    md_gc_line_to(pGC, right, top);
+    md_gc_line_to(pGC, left, top);
+
+    /* Inner */
+    left   += borderWidth;
+    top    += borderWidth;
+    right  -= borderWidth;
+    bottom -= borderWidth;
+    if (left < right && top < bottom) {
+        md_gc_move_to(pGC, left, top);
+        md_gc_line_to(pGC, left, bottom);
+        md_gc_line_to(pGC, right, bottom);
+        md_gc_line_to(pGC, right, top);
+        md_gc_line_to(pGC, left, top);
+    }
+#endif
+}
+
+void md_gc_rectangle_border_outer(md_gc* pGC, md_int32 left, md_int32 top, md_int32 right, md_int32 bottom, md_int32 borderWidth)
+{
+    md_gc_rectangle(pGC, left - borderWidth, top - borderWidth, left,                bottom + borderWidth); /* Left */
+    md_gc_rectangle(pGC, right,              top - borderWidth, right + borderWidth, bottom + borderWidth); /* Right */
+    md_gc_rectangle(pGC, left,               top - borderWidth, right,               top);                  /* Top */
+    md_gc_rectangle(pGC, left,               bottom,            right,               bottom + borderWidth); /* Bottom */
+}
+
+void md_gc_clip(md_gc* pGC)
+{
+    if (pGC == NULL) {
+        return;
+    }
+
+    MD_ASSERT(pGC->pAPI != NULL);
+
+    if (pGC->pAPI->procs.gcClip) {
+        pGC->pAPI->procs.gcClip(pGC);
+    }
+}
+
+void md_gc_reset_clip(md_gc* pGC)
+{
+    if (pGC == NULL) {
+        return;
+    }
+
+    MD_ASSERT(pGC->pAPI != NULL);
+
+    if (pGC->pAPI->procs.gcResetClip) {
+        pGC->pAPI->procs.gcResetClip(pGC);
+    }
+}
+
+md_bool32 md_gc_is_point_inside_clip(md_gc* pGC, md_int32 x, md_int32 y)
+{
+    if (pGC == NULL) {
+        return MD_FALSE;
+    }
+
+    MD_ASSERT(pGC->pAPI != NULL);
+
+    if (pGC->pAPI->procs.gcIsPointInsideClip) {
+        return pGC->pAPI->procs.gcIsPointInsideClip(pGC, x, y);
+    }
+
+    return MD_FALSE;
+}
+
+md_result md_gc_get_clip_bounds(md_gc* pGC, md_int32* pLeft, md_int32* pTop, md_int32* pRight, md_int32* pBottom)
+{
+    md_int32 left;
+    md_int32 top;
+    md_int32 right;
+    md_int32 bottom;
+    md_result result;
+
+    if (pLeft   != NULL) { *pLeft   = 0; }
+    if (pTop    != NULL) { *pTop    = 0; }
+    if (pRight  != NULL) { *pRight  = 0; }
+    if (pBottom != NULL) { *pBottom = 0; }
+
+    if (pGC == NULL) {
+        return MD_INVALID_ARGS;
+    }
+
+    MD_ASSERT(pGC->pAPI != NULL);
+
+    if (pGC->pAPI->procs.gcGetClipBounds == NULL) {
+        return MD_INVALID_OPERATION;
+    }
+
+    result = pGC->pAPI->procs.gcGetClipBounds(pGC, &left, &top, &right, &bottom);
+    if (result != MD_SUCCESS) {
+        return result;
+    }
+
+    if (pLeft   != NULL) { *pLeft   = left;   }
+    if (pTop    != NULL) { *pTop    = top;    }
+    if (pRight  != NULL) { *pRight  = right;  }
+    if (pBottom != NULL) { *pBottom = bottom; }
+
+    return MD_SUCCESS;
+}
+
+void md_gc_fill(md_gc* pGC)
+{
+    if (pGC == NULL) {
+        return;
+    }
+
+    MD_ASSERT(pGC->pAPI != NULL);
+
+    if (pGC->pAPI->procs.gcFill) {
+        pGC->pAPI->procs.gcFill(pGC);
+    }
+}
+
+void md_gc_stroke(md_gc* pGC)
+{
+    if (pGC == NULL) {
+        return;
+    }
+
+    MD_ASSERT(pGC->pAPI != NULL);
+
+    if (pGC->pAPI->procs.gcStroke) {
+        pGC->pAPI->procs.gcStroke(pGC);
+    }
+}
+
+void md_gc_fill_and_stroke(md_gc* pGC)
+{
+    if (pGC == NULL) {
+        return;
+    }
+
+    MD_ASSERT(pGC->pAPI != NULL);
+
+    if (pGC->pAPI->procs.gcFillAndStroke) {
+        pGC->pAPI->procs.gcFillAndStroke(pGC);
+    }
+}
+
+void md_gc_draw_gc(md_gc* pGC, md_gc* pSrcGC, md_int32 srcX, md_int32 srcY)
+{
+    if (pGC == NULL) {
+        return;
+    }
+
+    MD_ASSERT(pGC->pAPI != NULL);
+
+    if (pSrcGC == NULL) {
+        return; /* Nothing to draw. */
+    }
+
+    if (pGC->pAPI->procs.gcDrawGC) {
+        pGC->pAPI->procs.gcDrawGC(pGC, pSrcGC, srcX, srcY);
+    }
+}
+
+void md_gc_draw_glyphs(md_gc* pGC, const md_item* pItem, const md_glyph* pGlyphs, size_t glyphCount, md_int32 x, md_int32 y)
+{
+    if (pGC == NULL || pItem == NULL || pGlyphs == NULL) {
+        return;
+    }
+
+    MD_ASSERT(pGC->pAPI != NULL);
+
+    if (glyphCount == 0) {
+        return; /* Nothing to draw. */
+    }
+
+    if (pGC->pAPI->procs.gcDrawGlyphs) {
+        pGC->pAPI->procs.gcDrawGlyphs(pGC, pItem, pGlyphs, glyphCount, x, y);
+    }
+}
+
+static void md_gc_draw_text__encoding(md_gc* pGC, md_font* pFont, const void* pText, size_t textLength, md_uint32 encoding, md_int32 x, md_int32 y, md_alignment originAlignmentX, md_alignment originAlignmentY, md_text_metrics* pMetrics)
+{
+    md_result result;
+
+    if (pMetrics != NULL) {
+        MD_ZERO_OBJECT(pMetrics);
+    }
+
+    if (pGC == NULL || pFont == NULL || pText == NULL || textLength == 0) {
+        return;
+    }
+
+    if (textLength == (size_t)-1) {
+        textLength = md_get_text_length_null_terminated(pText, encoding);
+    }
+
+    /* TODO: Implement support for vertical text layouts. Not sure yet how to identify a font or script as vertical... */
+
+    /* TODO: Implement support for backend-optimized implementations of this method. */
+#if 0
+    if (encoding == MD_ENCODING_UTF8 && pGC->pAPI->gcDrawTextUTF8) {
+        pGC->pAPI->gcDrawTextUTF8(pGC, pFont, (const md_utf8*)pText, textLength, x, y, originAlignmentX, originAlignmentY);
+    } else
+#endif
+    {
+        /* Generic implementation. This is optimized for simplicity rather than speed. Consider this to be the reference implementation. */
+        md_int32 originX = 0;
+        md_int32 originY = 0;
+        md_int32 penX;
+        md_int32 penY;
+        md_text_metrics metrics;
+        md_int32 lineSizeY = pFont->metricsCache.lineSizeY;
+        
+
+        /* The starting position of the pen depends on the alignment of the origin. */
+        if (originAlignmentX == md_alignment_left && originAlignmentY == md_alignment_top) {
+            /* Simple case. The pen starts at [x] and [y] exactly. */
+            originX = x;
+            originY = y;
+        } else {
+            /* We need to measure the string to know where to start the pen. */
+            result = md_font_get_text_metrics__encoding(pFont, pText, textLength, encoding, &metrics);
+            if (result != MD_SUCCESS) {
+                return;
+            }
+
+            /* X */
+            if (originAlignmentX == md_alignment_right) {
+                originX = x - metrics.sizeX;
+            } else if (originAlignmentX == md_alignment_center) {
+                originX = x - (metrics.sizeX / 2);
+            }
+
+            /* Y */
+            if (originAlignmentY == md_alignment_bottom) {
+                originY = y - metrics.sizeY;
+            } else if (originAlignmentY == md_alignment_center) {
+                originY = y - (metrics.sizeY / 2);
+            }
+        }
+
+        penX = originX;
+        penY = originY;
+
+        metrics.lPadding = 0;
+        metrics.rPadding = 0;
+        metrics.sizeX    = 0;
+        metrics.sizeY    = lineSizeY;
+
+        /* We've figured out the pen position, so now we can draw the text. */
+        /* NOTE: Only supporting left-to-right, top-to-bottom for now. Still figuring out vertical text... */
+        {
+            md_itemize_state itemizeState;
+            size_t    scratchMark;
+            md_item_buffer items;
+            md_item*  pItems;
+            md_uint32 itemCount;
+            md_uint32 iItem;
+
+            /* First step is to itemize as usual. */
+            scratchMark = md_scratch_get_mark(&pFont->scratch);
+            result = md_itemize__scratch(pFont, pText, textLength, encoding, &items, &itemizeState);
+            if (result != MD_SUCCESS) {
+                return; /* Failed to itemize. */
+            }
+
+            pItems    = items.pItems;
+            itemCount = items.count;
+
+            /* Now we just shape and draw. */
+            if (originAlignmentX == md_alignment_left) {
+                /* Simple case. No need for measuring lines. */
+                md_int32 lineSizeX = 0;
+                for (iItem = 0; iItem < itemCount; ++iItem) {
+                    md_item* pItem = &pItems[iItem];
+
+                    if (md_is_newline(MD_TEXT_AT(pText, pItem->offset, encoding), pItem->length, encoding)) {
+                        penX  = originX;
+                        penY += lineSizeY;
+
+                        metrics.sizeY += lineSizeY;
+                        if (metrics.sizeX < lineSizeX) {
+                            metrics.sizeX = lineSizeX;
+                        }
+                    } else {
+                        md_text_metrics itemMetrics;
+                        size_t glyphMark = md_scratch_get_mark(&pFont->scratch);
+                        md_glyph* pGlyphs;
+                        size_t glyphCount;
+
+                        result = md_shape__scratch(pFont, pItem, MD_TEXT_AT(pText, pItem->offset, encoding), pItem->length, encoding, &pGlyphs, &glyphCount, &itemMetrics);
+                        if (result != MD_SUCCESS) {
+                            break;  /* Failed to shape this item. */
+                        }
+
+                        md_gc_draw_glyphs(pGC, &pItems[iItem], pGlyphs, glyphCount, penX, penY);
+
+                        md_scratch_release(&pFont->scratch, glyphMark);
+
+                        penX += itemMetrics.sizeX;
+                        lineSizeX += itemMetrics.sizeX;
+                    }
+                }
+
+                if (metrics.sizeX < lineSizeX) {
+                    metrics.sizeX = lineSizeX;
+                }
+            } else {
+                /* Complicated case. We need to go line-by-line, measure it, then position it based on the alignment. */
+                md_int32 lineSizeX;
+
+                iItem = 0;
+                while (iItem < itemCount) {  /* For each line... */
+                    md_uint32 iLineBeg = iItem;
+                    md_uint32 iLineEnd = iItem;
+                    
+                    lineSizeX = 0;
+
+                    /* Find the range of items making up this line. */
+                    for (; iLineEnd < itemCount; ++iLineEnd) {
+                        md_item* pItem = &pItems[iLineEnd];
+                        if (md_is_newline(MD_TEXT_AT(pText, pItem->offset, encoding), pItem->length, encoding)) {
+                            metrics.sizeY += lineSizeY;
+                            if (metrics.sizeX < lineSizeX) {
+                                metrics.sizeX = lineSizeX;
+                            }
+
+                            break;
+                        } else {
+                            md_text_metrics itemMetrics;
+                            result = md_shape__encoding(pFont, pItem, MD_TEXT_AT(pText, pItem->offset, encoding), pItem->length, encoding, NULL, NULL, NULL, &itemMetrics);
+                            if (result != MD_SUCCESS) {
+                                break;
+                            }
+
+                            lineSizeX += itemMetrics.sizeX;
+                        }
+                    }
+
+                    if (iLineBeg != iLineEnd) {
+                        if (originAlignmentX == md_alignment_right) {
+                            penX = x - lineSizeX;
+                        } else if (originAlignmentX == md_alignment_center) {
+                            penX = x - (lineSizeX / 2);
+                        } else {
+                            penX = originX;
+                        }
+                    
+                        for (iItem = iLineBeg; iItem < iLineEnd; ++iItem) {
+                            md_item* pItem = &pItems[iItem];
+                            md_text_metrics itemMetrics;
+                            size_t glyphMark = md_scratch_get_mark(&pFont->scratch);
+                            md_glyph* pGlyphs;
+                            size_t glyphCount;
+
+                            result = md_shape__scratch(pFont, pItem, MD_TEXT_AT(pText, pItem->offset, encoding), pItem->length, encoding, &pGlyphs, &glyphCount, &itemMetrics);
+                            if (result != MD_SUCCESS) {
+                                break;  /* Failed to shape this item. */
+                            }
+
+                            /* This hack is specifically for GDI. We need to clip against the item metrics or else we'll overwrite one pixel too far to the left. Very annoying. */
+                            if (pGC->pAPI->backend == md_backend_gdi) {
+                                md_gc_save(pGC);
+                                {
+                                    md_gc_rectangle(pGC, penX, penY, penX + itemMetrics.sizeX, penY + itemMetrics.sizeY);
+                                    md_gc_clip(pGC);
+                                    md_gc_draw_glyphs(pGC, pItem, pGlyphs, glyphCount, penX, penY);
+                                }
+                                md_gc_restore(pGC);
+                            } else {
+                                md_gc_draw_glyphs(pGC, pItem, pGlyphs, glyphCount, penX, penY);
+                            }
+
+                            md_scratch_release(&pFont->scratch, glyphMark);
+
+                            penX += itemMetrics.sizeX;
+                        }
+                    }
+
+                    penY += lineSizeY;
+
+                    if (metrics.sizeX < lineSizeX) {
+                        metrics.sizeX = lineSizeX;
+                    }
+
+                    /* Go past the new-line item. */
+                    iItem += 1;
+                }
+            }
+
+            md_free_itemize_state(&itemizeState);
+            md_free_scratch_items(&items);
+            md_scratch_release(&pFont->scratch, scratchMark);
+        }
+
+        if (pMetrics != NULL) {
+            *pMetrics = metrics;
+        }
+    }
+}
+
+static void md_gc_draw_text__any(md_gc* pGC, md_font* pFont, const void* pText, size_t textLength, md_uint32 encoding, md_int32 x, md_int32 y, md_alignment originAlignmentX, md_alignment originAlignmentY, md_text_metrics* pMetrics)
+{
+    md_uint32 textEncoding;
+    size_t scratchMark;
+    const void* pConvertedText;
+    size_t convertedTextLength;
+
+    if (pGC == NULL || pFont == NULL || pText == NULL || textLength == 0 || encoding == MD_ENCODING_UTF8) {
+        md_gc_draw_text__encoding(pGC, pFont, pText, textLength, encoding, x, y, originAlignmentX, originAlignmentY, pMetrics);
+        return;
+    }
+
+    /* See md_font_get_text_metrics__any(). */
+    textEncoding = md_get_text_encoding(pFont->pAPI, encoding);
+    if (textEncoding == encoding) {
+        md_gc_draw_text__encoding(pGC, pFont, pText, textLength, encoding, x, y, originAlignmentX, originAlignmentY, pMetrics);
+        return;
+    }
+
+    if (textLength == (size_t)-1) {
+        textLength = md_get_text_length_null_terminated(pText, encoding);
+    }
+
+    scratchMark = md_scratch_get_mark(&pFont->scratch);
+
+    if (md_convert_text__scratch(&pFont->scratch, pText, textLength, encoding, textEncoding, &pConvertedText, &convertedTextLength) != MD_SUCCESS) {
+        if (pMetrics != NULL) {
+            MD_ZERO_OBJECT(pMetrics);
+        }
+        return;
+    }
+
+    md_gc_draw_text__encoding(pGC, pFont, pConvertedText, convertedTextLength, textEncoding, x, y, originAlignmentX, originAlignmentY, pMetrics);
+
+    md_scratch_release(&pFont->scratch, scratchMark);
+}
+
+void md_gc_draw_text_utf8(md_gc* pGC, md_font* pFont, const md_utf8* pTextUTF8, size_t textLength, md_int32 x, md_int32 y, md_alignment originAlignmentX, md_alignment originAlignmentY, md_text_metrics* pMetrics)
+{
+    md_gc_draw_text__any(pGC, pFont, pTextUTF8, textLength, MD_ENCODING_UTF8, x, y, originAlignmentX, originAlignmentY, pMetrics);
+}
+
+void md_gc_draw_text_utf16(md_gc* pGC, md_font* pFont, const md_utf16* pTextUTF16, size_t textLength, md_int32 x, md_int32 y, md_alignment originAlignmentX, md_alignment originAlignmentY, md_text_metrics* pMetrics)
+{
+    md_gc_draw_text__any(pGC, pFont, pTextUTF16, textLength, MD_ENCODING_UTF16, x, y, originAlignmentX, originAlignmentY, pMetrics);
+}
+
+void md_gc_draw_text_utf32(md_gc* pGC, md_font* pFont, const md_utf32* pTextUTF32, size_t textLength, md_int32 x, md_int32 y, md_alignment originAlignmentX, md_alignment originAlignmentY, md_text_metrics* pMetrics)
+{
+    md_gc_draw_text__any(pGC, pFont, pTextUTF32, textLength, MD_ENCODING_UTF32, x, y, originAlignmentX, originAlignmentY, pMetrics);
+}
+
+md_text_layout md_text_layout_init_default()
+{
+    md_text_layout layout;
+
+    MD_ZERO_OBJECT(&layout);
+    layout.alignmentX       = md_alignment_left;
+    layout.alignmentY       = md_alignment_top;
+    layout.wrapMode         = md_text_wrap_mode_none;
+    layout.fillBackground   = MD_TRUE;
+    layout.singleLine       = MD_FALSE;
+    layout.tabWidthInSpaces = 4;
+
+    return layout;
+}
+
+
+#define MD_TEXT_LAYOUT_WHITESPACE   (1UL << 0)
+#define MD_TEXT_LAYOUT_NEWLINE      (1UL << 1)
+
+typedef struct
+{
+    void* pUserData;
+    void      (* onInit)      (void* pUserData, const md_text_layout* pLayout);
+    void      (* onUninit)    (void* pUserData, const md_text_layout* pLayout);
+    void      (* onBeginItems)(void* pUserData, const md_text_layout* pLayout, md_int32 penX, md_int32 penY);
+    void      (* onEndItems)  (void* pUserData, const md_text_layout* pLayout, md_int32 penX, md_int32 penY);
+    void      (* onBeginLine) (void* pUserData, const md_text_layout* pLayout, const char* pTextUTF8, const md_item* pItems, md_uint32 itemCount, md_int32 penX, md_int32 penY, md_int32 sizeX, md_int32 sizeY);
+    void      (* onEndLine)   (void* pUserData, const md_text_layout* pLayout, md_int32 penX, md_int32 penY);
+    md_result (* onItem)      (void* pUserData, const md_text_layout* pLayout, const char* pTextUTF8, const md_item* pItem, const md_glyph* pGlyphs, md_uint32 glyphCount, const size_t* pClusters, md_int32 penX, md_int32 penY, md_int32 sizeX, md_int32 sizeY, md_uint32 flags);
+} md_layout_callbacks;
+
+/*
+Per-item shaping results for a single line. Each item on a line is shaped exactly once while the line is being measured and the results
+are kept here until the line has been aligned and its items emitted. The buffers are reused between lines.
+*/
+typedef struct
+{
+    md_uint32 glyphOffset;      /* Index of the item's first glyph in pGlyphs. */
+    md_uint32 glyphCount;
+    size_t    clusterOffset;    /* Index of the item's first cluster in pClusters. */
+    md_int32  sizeX;
+    md_int32  sizeY;
+    md_bool32 isSplittable;     /* Whether or not the item can be split between clusters when wrapping. False for tabs and right-to-left runs. */
+} md_text_layout_shaped_item;
+
+typedef struct
+{
+    md_text_layout_shaped_item* pItems;
+    md_uint32 itemCount;
+    size_t    itemCap;
+    md_glyph* pGlyphs;
+    size_t    glyphCount;
+    size_t    glyphCap;
+    size_t*   pClusters;
+    size_t    clusterCount;
+    size_t    clusterCap;
+    md_uint8* pBreaks;          /* Line break opportunities for each code unit of the line when wrapping. See md_find_line_breaks_utf8(). */
+    size_t    breakCap;
+    size_t*   pSplitClusters;   /* The clusters of an item that's been split by wrapping, rebased against the first glyph of the split. */
+    size_t    splitClusterCap;
+} md_text_layout_line;
+
+static void md_text_layout_line_uninit(md_text_layout_line* pLine)
+{
+    MD_ASSERT(pLine != NULL);
+
+    MD_FREE(pLine->pItems);
+    MD_FREE(pLine->pGlyphs);
+    MD_FREE(pLine->pClusters);
+    MD_FREE(pLine->pBreaks);
+    MD_FREE(pLine->pSplitClusters);
+}
+
+/*
+Grows a heap allocated array so that it can hold at least [count] elements. The capacity is doubled so that appending one element at a
+time is amortized. Returns NULL if the allocation fails in which case the original array is left untouched.
+*/
+static void* md_grow_array(void* pArray, size_t* pCap, size_t count, size_t stride, size_t minCap)
+{
+    void* pNewArray;
+    size_t newCap;
+
+    MD_ASSERT(pCap != NULL);
+
+    if (count <= *pCap) {
+        return pArray;
+    }
+
+    newCap = (*pCap == 0) ? minCap : (*pCap)*2;
+    if (newCap < count) {
+        newCap = count;
+    }
+
+    pNewArray = MD_REALLOC(pArray, newCap * stride);
+    if (pNewArray == NULL) {
+        return NULL;
+    }
+
+    *pCap = newCap;
+    return pNewArray;
+}
+
+static md_result md_text_layout_line_reserve(md_text_layout_line* pLine, size_t itemCount, size_t glyphCount, size_t clusterCount)
+{
+    void* pNewArray;
+
+    MD_ASSERT(pLine != NULL);
+
+    pNewArray = md_grow_array(pLine->pItems, &pLine->itemCap, itemCount, sizeof(*pLine->pItems), 16);
+    if (pNewArray == NULL) {
+        return MD_OUT_OF_MEMORY;
+    }
+    pLine->pItems = (md_text_layout_shaped_item*)pNewArray;
+
+    pNewArray = md_grow_array(pLine->pGlyphs, &pLine->glyphCap, glyphCount, sizeof(*pLine->pGlyphs), 256);
+    if (pNewArray == NULL) {
+        return MD_OUT_OF_MEMORY;
+    }
+    pLine->pGlyphs = (md_glyph*)pNewArray;
+
+    pNewArray = md_grow_array(pLine->pClusters, &pLine->clusterCap, clusterCount, sizeof(*pLine->pClusters), 256);
+    if (pNewArray == NULL) {
+        return MD_OUT_OF_MEMORY;
+    }
+    pLine->pClusters = (size_t*)pNewArray;
+
+    return MD_SUCCESS;
+}
+
+/*
+Shapes an item and appends the glyphs and clusters to the end of the line's buffers. Most runs produce no more glyphs than they have
+bytes, so room for that many is reserved up front and the shaper is only run a second time when that guess was too small.
+*/
+static md_result md_text_layout_line_shape_item_utf8(md_text_layout_line* pLine, md_font* pFont, const md_utf8* pTextUTF8, md_item* pItem)
+{
+    md_result result;
+    md_text_layout_shaped_item* pShapedItem;
+    md_text_metrics itemMetrics;
+    size_t glyphCount;
+    size_t iCluster;
+
+    result = md_text_layout_line_reserve(pLine, pLine->itemCount + 1, pLine->glyphCount + pItem->length, pLine->clusterCount + pItem->length);
+    if (result != MD_SUCCESS) {
+        return result;
+    }
+
+    glyphCount = pLine->glyphCap - pLine->glyphCount;
+    result = md_shape_utf8(pFont, pItem, pTextUTF8 + pItem->offset, pItem->length, pLine->pGlyphs + pLine->glyphCount, &glyphCount, pLine->pClusters + pLine->clusterCount, &itemMetrics);
+    if (result == MD_NO_SPACE) {
+        result = md_text_layout_line_reserve(pLine, 0, pLine->glyphCount + glyphCount, 0);
+        if (result != MD_SUCCESS) {
+            return result;
+        }
+
+        glyphCount = pLine->glyphCap - pLine->glyphCount;
+        result = md_shape_utf8(pFont, pItem, pTextUTF8 + pItem->offset, pItem->length, pLine->pGlyphs + pLine->glyphCount, &glyphCount, pLine->pClusters + pLine->clusterCount, &itemMetrics);
+    }
+
+    if (result != MD_SUCCESS) {
+        return result;
+    }
+
+    pShapedItem = &pLine->pItems[pLine->itemCount];
+    pShapedItem->glyphOffset   = (md_uint32)pLine->glyphCount;
+    pShapedItem->glyphCount    = (md_uint32)glyphCount;
+    pShapedItem->clusterOffset = pLine->clusterCount;
+    pShapedItem->sizeX         = itemMetrics.sizeX;
+    pShapedItem->sizeY         = itemMetrics.sizeY;
+    pShapedItem->isSplittable  = !md_is_tab_utf8(pTextUTF8 + pItem->offset, pItem->length) && !md_is_newline_utf8(pTextUTF8 + pItem->offset, pItem->length);
+
+    /* Splitting an item relies on the clusters being in logical order. */
+    for (iCluster = 1; iCluster < pItem->length && pShapedItem->isSplittable; ++iCluster) {
+        if (pLine->pClusters[pLine->clusterCount + iCluster] < pLine->pClusters[pLine->clusterCount + iCluster - 1]) {
+            pShapedItem->isSplittable = MD_FALSE;
+        }
+    }
+
+    pLine->itemCount    += 1;
+    pLine->glyphCount   += glyphCount;
+    pLine->clusterCount += pItem->length;
+
+    return MD_SUCCESS;
+}
+
+/*
+Calculates the position of the top left of the text within the layout bounds. [textSizeY] is only used when the text is not aligned to the top.
+*/
+static md_result md_text_layout_get_origin(const md_text_layout* pLayout, md_int32 textSizeY, md_int32* pOriginX, md_int32* pOriginY)
+{
+    md_int32 originX;
+    md_int32 originY;
+
+    MD_ASSERT(pLayout  != NULL);
+    MD_ASSERT(pOriginX != NULL);
+    MD_ASSERT(pOriginY != NULL);
+
+    originX = pLayout->boundsX + pLayout->textOffsetX + pLayout->padding.left;
+    if (pLayout->borderWidth > 0) {
+        originX += pLayout->borderWidth;
+    }
+
+    if (pLayout->alignmentY == md_alignment_top) {
+        originY = pLayout->boundsY + pLayout->textOffsetY + pLayout->padding.top;
+        if (pLayout->borderWidth > 0) {
+            originY += pLayout->borderWidth;
+        }
+    } else if (pLayout->alignmentY == md_alignment_bottom) {
+        originY = pLayout->boundsY +  (pLayout->boundsSizeY - textSizeY) + pLayout->textOffsetY - pLayout->padding.bottom;
+        if (pLayout->borderWidth > 0) {
+            originY -= pLayout->borderWidth;
+        }
+    } else if (pLayout->alignmentY == md_alignment_center) {
+        originY = pLayout->boundsY + ((pLayout->boundsSizeY - textSizeY) / 2) + pLayout->textOffsetY;
+    } else {
+        return MD_INVALID_ARGS;
+    }
+
+    *pOriginX = originX;
+    *pOriginY = originY;
+
+    return MD_SUCCESS;
+}
+
+/*
+Retrieves the distance between tab stops in pixels. When the layout doesn't specify it in pixels it's based on the width of a space.
+*/
+static md_int32 md_text_layout_get_tab_size_x(md_font* pFont, const md_text_layout* pLayout)
+{
+    md_int32 tabSizeXInPixels = pLayout->tabWidthInPixels;
+
+    if (tabSizeXInPixels <= 0) {
+        md_font_load_space_size(pFont);
+        tabSizeXInPixels = pFont->metricsCache.spaceSizeX * pLayout->tabWidthInSpaces;
+    }
+
+    /* Tab stops need to be at least a pixel apart or else we'll divide by zero. */
+    if (tabSizeXInPixels <= 0) {
+        tabSizeXInPixels = 1;
+    }
+
+    return tabSizeXInPixels;
+}
+
+/*
+Calculates the position of the end of a group of tabs starting at [x], relative to the start of the line.
+*/
+static md_int32 md_text_layout_get_tab_end_x(md_int32 x, size_t tabCount, md_int32 tabSizeXInPixels)
+{
+    return ((x / tabSizeXInPixels) * tabSizeXInPixels) + ((md_int32)tabCount * tabSizeXInPixels);
+}
+
+/*
+Measures the code units between [beg] and [end] of an item that's been shaped with md_text_layout_line_shape_item_utf8(). This is done by
+adding up the advances of the glyphs in the range which means the item does not need to be shaped again when it's split by wrapping. The
+size from the shaper is used when measuring the whole item.
+*/
+static md_int32 md_text_layout_line_get_item_size_x(const md_text_layout_line* pLine, const md_text_layout_shaped_item* pShapedItem, size_t itemLength, size_t beg, size_t end)
+{
+    const size_t* pClusters = pLine->pClusters + pShapedItem->clusterOffset;
+    size_t iGlyph;
+    size_t iGlyphEnd;
+    md_int32 sizeX = 0;
+
+    if (beg == 0 && end == itemLength) {
+        return pShapedItem->sizeX;
+    }
+
+    iGlyphEnd = (end < itemLength) ? pClusters[end] : pShapedItem->glyphCount;
+    for (iGlyph = pClusters[beg]; iGlyph < iGlyphEnd; ++iGlyph) {
+        sizeX += pLine->pGlyphs[pShapedItem->glyphOffset + iGlyph].advance;
+    }
+
+    return sizeX;
+}
+
+/*
+Finds the line break opportunities of a line that is going to be wrapped. [pItems] are the items making up the line, not including the
+new-line item, and must have already been shaped into [pShapedItems]. Breaks are only kept where they fall on a cluster boundary.
+*/
+static md_result md_text_layout_line_find_breaks_utf8(md_text_layout_line* pLine, const md_utf8* pTextUTF8, const md_item* pItems, const md_text_layout_shaped_item* pShapedItems, md_uint32 itemCount, md_text_wrap_mode wrapMode)
+{
+    md_result result;
+    size_t lineOffset;
+    size_t lineLength;
+    md_uint32 iItem;
+    size_t iCluster;
+    void* pNewBreaks;
+
+    if (itemCount == 0) {
+        return MD_SUCCESS;
+    }
+
+    lineOffset = pItems[0].offset;
+    lineLength = (pItems[itemCount - 1].offset + pItems[itemCount - 1].length) - lineOffset;
+
+    pNewBreaks = md_grow_array(pLine->pBreaks, &pLine->breakCap, lineLength, sizeof(*pLine->pBreaks), 256);
+    if (pNewBreaks == NULL) {
+        return MD_OUT_OF_MEMORY;
+    }
+    pLine->pBreaks = (md_uint8*)pNewBreaks;
+
+    if (wrapMode == md_text_wrap_mode_char) {
+        MD_ZERO_MEMORY(pLine->pBreaks, lineLength);
+        for (iCluster = 1; iCluster < lineLength; ++iCluster) {
+            pLine->pBreaks[iCluster] = MD_LINE_BREAK_ALLOWED;
+        }
+    } else {
+        result = md_find_line_breaks_utf8(pTextUTF8 + lineOffset, lineLength, pLine->pBreaks);
+        if (result != MD_SUCCESS) {
+            return result;
+        }
+    }
+
+    for (iItem = 0; iItem < itemCount; ++iItem) {
+        const md_text_layout_shaped_item* pShapedItem = &pShapedItems[iItem];
+        const size_t* pClusters = pLine->pClusters + pShapedItem->clusterOffset;
+        md_uint8* pItemBreaks = pLine->pBreaks + (pItems[iItem].offset - lineOffset);
+
+        for (iCluster = 1; iCluster < pItems[iItem].length; ++iCluster) {
+            if (!pShapedItem->isSplittable || pClusters[iCluster] == pClusters[iCluster - 1]) {
+                pItemBreaks[iCluster] = 0;
+            }
+        }
+    }
+
+    return MD_SUCCESS;
+}
+
+/*
+Finds where a wrapped line ends. On input, [piItem] and [pOffset] are the item and code unit within that item that the line starts at. On
+output they're set to where the next line starts, which will be [itemCount] and 0 if the rest of the items fit.
+
+Spaces and tabs at the end of the line are allowed to hang past the edge. If there's no break opportunity before the line overflows, it's
+broken at the cluster that overflows instead. At least one cluster is always put on a line.
+*/
+static void md_text_layout_line_find_wrap_point_utf8(const md_text_layout_line* pLine, const md_utf8* pTextUTF8, const md_item* pItems, const md_text_layout_shaped_item* pShapedItems, md_uint32 itemCount, md_int32 tabSizeXInPixels, md_int32 wrapSizeX, md_uint32* piItem, size_t* pOffset)
+{
+    md_uint32 iItemBeg = *piItem;
+    size_t offsetBeg = *pOffset;
+    md_uint32 iItemBreak = 0;
+    size_t offsetBreak = 0;
+    md_bool32 hasBreak = MD_FALSE;
+    md_uint32 iItem;
+    size_t lineOffset;
+    md_int32 x = 0;
+
+    MD_ASSERT(iItemBeg < itemCount);
+
+    lineOffset = pItems[0].offset;
+
+    for (iItem = iItemBeg; iItem < itemCount; ++iItem) {
+        const md_item* pItem = &pItems[iItem];
+        const md_text_layout_shaped_item* pShapedItem = &pShapedItems[iItem];
+        const md_uint8* pItemBreaks = pLine->pBreaks + (pItem->offset - lineOffset);
+        const size_t* pClusters = pLine->pClusters + pShapedItem->clusterOffset;
+        size_t iCluster = (iItem == iItemBeg) ? offsetBeg : 0;
+
+        if (md_is_tab_utf8(pTextUTF8 + pItem->offset, pItem->length)) {
+            /* Tabs never cause an overflow. */
+            if (pItemBreaks[0] != 0 && iItem != iItemBeg) {
+                iItemBreak  = iItem;
+                offsetBreak = 0;
+                hasBreak    = MD_TRUE;
+            }
+
+            x = md_text_layout_get_tab_end_x(x, pItem->length, tabSizeXInPixels);
+            continue;
+        }
+
+        /* Most of the time the whole item will fit in which case all we need is the last break opportunity within it. */
+        if (iCluster == 0 && x + pShapedItem->sizeX <= wrapSizeX) {
+            size_t iBreak;
+            for (iBreak = pItem->length; iBreak > 0; --iBreak) {
+                if (pItemBreaks[iBreak - 1] != 0 && (iItem != iItemBeg || iBreak - 1 != 0)) {
+                    iItemBreak  = iItem;
+                    offsetBreak = iBreak - 1;
+                    hasBreak    = MD_TRUE;
+                    break;
+                }
+            }
+
+            x += pShapedItem->sizeX;
+            continue;
+        }
+
+        /* Getting here means the line will overflow somewhere in this item. Go through it cluster by cluster. */
+        while (iCluster < pItem->length) {
+            size_t iNextCluster = iCluster + 1;
+            md_bool32 isLineStart = (iItem == iItemBeg && iCluster == offsetBeg);
+            md_bool32 isSpace = MD_TRUE;
+            md_int32 clusterSizeX;
+            size_t iCodeUnit;
+
+            if (pShapedItem->isSplittable) {
+                while (iNextCluster < pItem->length && pClusters[iNextCluster] == pClusters[iCluster]) {
+                    iNextCluster += 1;
+                }
+            } else {
+                iNextCluster = pItem->length;
+            }
+
+            if (pItemBreaks[iCluster] != 0 && !isLineStart) {
+                iItemBreak  = iItem;
+                offsetBreak = iCluster;
+                hasBreak    = MD_TRUE;
+            }
+
+            for (iCodeUnit = iCluster; iCodeUnit < iNextCluster; ++iCodeUnit) {
+                if (pTextUTF8[pItem->offset + iCodeUnit] != ' ') {
+                    isSpace = MD_FALSE;
+                    break;
+                }
+            }
+
+            clusterSizeX = md_text_layout_line_get_item_size_x(pLine, pShapedItem, pItem->length, iCluster, iNextCluster);
+
+            if (!isSpace && !isLineStart && x + clusterSizeX > wrapSizeX) {
+                if (hasBreak) {
+                    *piItem  = iItemBreak;
+                    *pOffset = offsetBreak;
+                } else {
+                    /* There's nowhere to break the line so it needs to be broken in the middle of a word. */
+                    *piItem  = iItem;
+                    *pOffset = iCluster;
+                }
+
+                return;
+            }
+
+            x += clusterSizeX;
+            iCluster = iNextCluster;
+        }
+    }
+
+    /* Everything fits. */
+    *piItem  = itemCount;
+    *pOffset = 0;
+}
+
+/*
+Measures a line made up of the items between ([iItemBeg], [offsetBeg]) and ([iItemEnd], [offsetEnd]), where the offsets are the code unit
+within the item. When [excludeTrailingWhitespace] is set, spaces and tabs at the end of the line don't contribute to the size. This is used
+for wrapped lines so that whitespace hanging off the end of a line doesn't affect alignment.
+*/
+static md_int32 md_text_layout_line_get_size_x(const md_text_layout_line* pLine, const md_utf8* pTextUTF8, const md_item* pItems, const md_text_layout_shaped_item* pShapedItems, md_uint32 iItemBeg, size_t offsetBeg, md_uint32 iItemEnd, size_t offsetEnd, md_int32 tabSizeXInPixels, md_bool32 excludeTrailingWhitespace)
+{
+    md_uint32 iItem;
+    md_int32 x = 0;
+    md_int32 contentX = 0;   /* The position of the end of the last character that isn't whitespace. */
+
+    for (iItem = iItemBeg; iItem < iItemEnd || (iItem == iItemEnd && offsetEnd > 0); ++iItem) {
+        const md_item* pItem = &pItems[iItem];
+        size_t beg = (iItem == iItemBeg) ? offsetBeg : 0;
+        size_t end = (iItem == iItemEnd) ? offsetEnd : pItem->length;
+
+        if (md_is_newline_utf8(pTextUTF8 + pItem->offset, pItem->length)) {
+            continue;   /* Only happens in single line mode. New-lines don't take up any room. */
+        }
+
+        if (md_is_tab_utf8(pTextUTF8 + pItem->offset, pItem->length)) {
+            x = md_text_layout_get_tab_end_x(x, end - beg, tabSizeXInPixels);
+        } else {
+            md_int32 sizeX = md_text_layout_line_get_item_size_x(pLine, &pShapedItems[iItem], pItem->length, beg, end);
+
+            if (excludeTrailingWhitespace && !pShapedItems[iItem].isSplittable) {
+                contentX = x + sizeX;
+            } else if (excludeTrailingWhitespace) {
+                size_t contentEnd = end;
+                while (contentEnd > beg && pTextUTF8[pItem->offset + contentEnd - 1] == ' ') {
+                    contentEnd -= 1;
+                }
+
+                if (contentEnd == end) {
+                    contentX = x + sizeX;
+                } else if (contentEnd > beg) {
+                    contentX = x + md_text_layout_line_get_item_size_x(pLine, &pShapedItems[iItem], pItem->length, beg, contentEnd);
+                }
+            }
+
+            x += sizeX;
+        }
+    }
+
+    if (excludeTrailingWhitespace) {
+        return contentX;
+    } else {
+        return x;
+    }
+}
+
+/*
+Main function for performing layout operations of text against items that have already been itemized. Customizations of the layout
+breakdown are done via callbacks.
+
+Each item is shaped once. A line is shaped and measured in full before any of its items are emitted since the line's width is needed for
+horizontal alignment. When wrapping is enabled the line is then broken up using the advances of the glyphs that have already been shaped.
+Items that are split by wrapping are passed to onItem as a copy of the original item with the offset and length adjusted.
+*/
+static md_result md_text_layout_do_layout_items_utf8(md_font* pFont, const md_utf8* pTextUTF8, md_item* pItems, md_uint32 itemCount, const md_text_layout* pLayout, const md_layout_callbacks* pCallbacks)
+{
+    md_result result = MD_SUCCESS;
+    md_uint32 iItem;
+    md_text_layout_line line;
+    md_int32  originX;
+    md_int32  originY;
+    md_int32  lineSizeY = pFont->metricsCache.lineSizeY;
+    md_int32  tabSizeXInPixels = 0;
+    md_int32  wrapSizeX = 0;
+    md_bool32 isWrapping;
+    md_bool32 isShapedUpFront;
+
+    MD_ASSERT(pFont      != NULL);
+    MD_ASSERT(pTextUTF8  != NULL);
+    MD_ASSERT(pLayout    != NULL);
+    MD_ASSERT(pCallbacks != NULL);
+
+    MD_ZERO_OBJECT(&line);
+
+    isWrapping = (pLayout->wrapMode != md_text_wrap_mode_none && pLayout->singleLine == MD_FALSE);
+    if (isWrapping) {
+        wrapSizeX = pLayout->boundsSizeX - pLayout->padding.left - pLayout->padding.right;
+        if (pLayout->borderWidth > 0) {
+            wrapSizeX -= pLayout->borderWidth*2;
+        }
+    }
+
+    /*
+    When wrapping, the number of lines can't be known without shaping the text. If it's needed for vertical alignment the whole text is
+    shaped in one go so that each item is still only shaped once.
+    */
+    isShapedUpFront = (isWrapping && pLayout->alignmentY != md_alignment_top);
+    if (isShapedUpFront) {
+        for (iItem = 0; iItem < itemCount; ++iItem) {
+            result = md_text_layout_line_shape_item_utf8(&line, pFont, pTextUTF8, &pItems[iItem]);
+            if (result != MD_SUCCESS) {
+                md_text_layout_line_uninit(&line);
+                return result;
+            }
+
+            if (tabSizeXInPixels == 0 && md_is_tab_utf8(pTextUTF8 + pItems[iItem].offset, pItems[iItem].length)) {
+                tabSizeXInPixels = md_text_layout_get_tab_size_x(pFont, pLayout);
+            }
+        }
+    }
+
+    /*
+    If we are not aligned to the top we need the height of the text so that we can position it properly. Every line is the same height
+    so this is just a matter of counting lines. There's no need to measure the text in full.
+    */
+    {
+        md_int32 textSizeY = lineSizeY;
+
+        if (pLayout->alignmentY != md_alignment_top && pLayout->singleLine == MD_FALSE) {
+            for (iItem = 0; iItem < itemCount; ++iItem) {
+                if (md_is_newline_utf8(pTextUTF8 + pItems[iItem].offset, pItems[iItem].length)) {
+                    textSizeY += lineSizeY;
+                }
+            }
+
+            if (isShapedUpFront) {
+                /* Each line that gets wrapped adds to the height. */
+                md_uint32 iLineBeg = 0;
+                while (iLineBeg < itemCount) {
+                    md_uint32 iLineEnd = iLineBeg;
+                    md_uint32 iWrapItem = 0;
+                    size_t wrapOffset = 0;
+
+                    while (iLineEnd < itemCount && !md_is_newline_utf8(pTextUTF8 + pItems[iLineEnd].offset, pItems[iLineEnd].length)) {
+                        iLineEnd += 1;
+                    }
+
+                    if (iLineEnd > iLineBeg) {
+                        result = md_text_layout_line_find_breaks_utf8(&line, pTextUTF8, pItems + iLineBeg, line.pItems + iLineBeg, iLineEnd - iLineBeg, pLayout->wrapMode);
+                        if (result != MD_SUCCESS) {
+                            md_text_layout_line_uninit(&line);
+                            return result;
+                        }
+
+                        for (;;) {
+                            md_text_layout_line_find_wrap_point_utf8(&line, pTextUTF8, pItems + iLineBeg, line.pItems + iLineBeg, iLineEnd - iLineBeg, tabSizeXInPixels, wrapSizeX, &iWrapItem, &wrapOffset);
+                            if (iWrapItem == iLineEnd - iLineBeg) {
+                                break;
+                            }
+
+                            textSizeY += lineSizeY;
+                        }
+                    }
+
+                    iLineBeg = iLineEnd + 1;
+                }
+            }
+        }
+
+        result = md_text_layout_get_origin(pLayout, textSizeY, &originX, &originY);
+        if (result != MD_SUCCESS) {
+            md_text_layout_line_uninit(&line);
+            return result;
+        }
+    }
+
+    if (pCallbacks->onInit) {
+        pCallbacks->onInit(pCallbacks->pUserData, pLayout);
+    }
+    {
+        md_int32 penX;
+        md_int32 penY;
+        md_int32 lineSizeX;
+
+        penX = originX;
+        penY = originY;
+
+        if (pCallbacks->onBeginItems) {
+            pCallbacks->onBeginItems(pCallbacks->pUserData, pLayout, penX, penY);
+        }
+        {
+            iItem = 0;
+            while (iItem < itemCount) {  /* For each line... */
+                md_uint32 iLineBeg = iItem;
+                md_uint32 iLineEnd = iItem;
+                md_uint32 iShapedItemBase;  /* The index of the item whose shaping results are at the start of the line buffers. */
+                md_uint32 iWrapItem;        /* The item and code unit within it that the current wrapped line starts at. Relative to iLineBeg. */
+                size_t    wrapOffset;
+                md_bool32 isLastWrappedLine;
+
+                /*
+                Find the range of items making up this line, shaping each one as we go. The new-line item that terminates the line is
+                shaped as well because it's passed to onItem like any other item, but it doesn't contribute to the width of the line.
+                */
+                if (isShapedUpFront) {
+                    while (iLineEnd < itemCount && !md_is_newline_utf8(pTextUTF8 + pItems[iLineEnd].offset, pItems[iLineEnd].length)) {
+                        iLineEnd += 1;
+                    }
+
+                    iShapedItemBase = 0;
+                } else {
+                    line.itemCount    = 0;
+                    line.glyphCount   = 0;
+                    line.clusterCount = 0;
+
+                    for (; iLineEnd < itemCount; ++iLineEnd) {
+                        md_item* pItem = &pItems[iLineEnd];
+
+                        result = md_text_layout_line_shape_item_utf8(&line, pFont, pTextUTF8, pItem);
+                        if (result != MD_SUCCESS) {
+                            break;
+                        }
+
+                        if (md_is_newline_utf8(pTextUTF8 + pItem->offset, pItem->length)) {
+                            if (pLayout->singleLine == MD_FALSE) {
+                                break;
+                            }
+                        } else if (md_is_tab_utf8(pTextUTF8 + pItem->offset, pItem->length)) {
+                            if (tabSizeXInPixels == 0) {
+                                tabSizeXInPixels = md_text_layout_get_tab_size_x(pFont, pLayout);
+                            }
+                        }
+                    }
+
+                    iShapedItemBase = iLineBeg;
+                }
+
+                if (result != MD_SUCCESS) {
+                    break;  /* Failed to shape an item. */
+                }
+
+                if (isWrapping) {
+                    result = md_text_layout_line_find_breaks_utf8(&line, pTextUTF8, pItems + iLineBeg, line.pItems + (iLineBeg - iShapedItemBase), iLineEnd - iLineBeg, pLayout->wrapMode);
+                    if (result != MD_SUCCESS) {
+                        break;
+                    }
+                }
+
+                /* The line is laid out as any number of wrapped lines. When wrapping is disabled this is always just the one. */
+                iWrapItem  = 0;
+                wrapOffset = 0;
+                do {
+                    md_uint32 iWrapItemBeg = iWrapItem;
+                    size_t    wrapOffsetBeg = wrapOffset;
+                    md_int32  lineX;
+
+                    if (isWrapping && iLineEnd > iLineBeg) {
+                        md_text_layout_line_find_wrap_point_utf8(&line, pTextUTF8, pItems + iLineBeg, line.pItems + (iLineBeg - iShapedItemBase), iLineEnd - iLineBeg, tabSizeXInPixels, wrapSizeX, &iWrapItem, &wrapOffset);
+                    } else {
+                        iWrapItem  = iLineEnd - iLineBeg;
+                        wrapOffset = 0;
+                    }
+
+                    isLastWrappedLine = (iWrapItem == iLineEnd - iLineBeg);
+
+                    lineSizeX = md_text_layout_line_get_size_x(&line, pTextUTF8, pItems + iLineBeg, line.pItems + (iLineBeg - iShapedItemBase), iWrapItemBeg, wrapOffsetBeg, iWrapItem, wrapOffset, tabSizeXInPixels, isWrapping);
+
+                    if (pLayout->alignmentX == md_alignment_right) {
+                        penX = pLayout->boundsX + (pLayout->boundsSizeX - lineSizeX) - pLayout->padding.right;
+                        if (pLayout->borderWidth > 0) {
+                            penX -= pLayout->borderWidth;
+                        }
+                    } else if (pLayout->alignmentX == md_alignment_center) {
+                        penX = pLayout->boundsX + ((pLayout->boundsSizeX - lineSizeX) / 2);
+                    } else {
+                        penX = pLayout->boundsX + pLayout->padding.left;
+                        if (pLayout->borderWidth > 0) {
+                            penX += pLayout->borderWidth;
+                        }
+                    }
+                    penX += pLayout->textOffsetX;
+
+                    lineX = penX;
+
+                    if (pCallbacks->onBeginLine) {
+                        pCallbacks->onBeginLine(pCallbacks->pUserData, pLayout, pTextUTF8, pItems + iLineBeg + iWrapItemBeg, (iWrapItem - iWrapItemBeg) + ((wrapOffset > 0) ? 1 : 0), penX, penY, lineSizeX, lineSizeY);
+                    }
+                    {
+                        /* The new-line item is only emitted with the last wrapped line. */
+                        md_uint32 iLastItem = (isLastWrappedLine) ? iLineEnd : iLineBeg + iWrapItem;
+
+                        for (iItem = iLineBeg + iWrapItemBeg; iItem <= iLastItem && iItem < itemCount; ++iItem) {
+                            md_item* pItem = &pItems[iItem];
+                            const md_text_layout_shaped_item* pShapedItem = &line.pItems[iItem - iShapedItemBase];
+                            const md_glyph* pGlyphs   = line.pGlyphs   + pShapedItem->glyphOffset;
+                            const size_t*   pClusters = line.pClusters + pShapedItem->clusterOffset;
+                            md_uint32       glyphCount = pShapedItem->glyphCount;
+                            md_int32        sizeX = pShapedItem->sizeX;
+                            size_t          beg = (iItem == iLineBeg + iWrapItemBeg) ? wrapOffsetBeg : 0;
+                            size_t          end = pItem->length;
+                            md_item         splitItem;
+
+                            if (iItem == iLineBeg + iWrapItem && !isLastWrappedLine) {
+                                end = wrapOffset;
+                                if (end == 0) {
+                                    break;  /* The wrapped line ends at the start of this item. */
+                                }
+                            }
+
+                            /* Items that have been split by wrapping need to have their glyphs and clusters adjusted. */
+                            if (beg > 0 || end < pItem->length) {
+                                size_t iGlyph = pClusters[beg];
+                                size_t iCluster;
+                                void* pNewClusters;
+
+                                pNewClusters = md_grow_array(line.pSplitClusters, &line.splitClusterCap, end - beg, sizeof(*line.pSplitClusters), 256);
+                                if (pNewClusters == NULL) {
+                                    result = MD_OUT_OF_MEMORY;
+                                    break;
+                                }
+                                line.pSplitClusters = (size_t*)pNewClusters;
+
+                                for (iCluster = beg; iCluster < end; ++iCluster) {
+                                    line.pSplitClusters[iCluster - beg] = pClusters[iCluster] - iGlyph;
+                                }
+
+                                sizeX      = md_text_layout_line_get_item_size_x(&line, pShapedItem, pItem->length, beg, end);
+                                glyphCount = (md_uint32)(((end < pItem->length) ? pClusters[end] : pShapedItem->glyphCount) - iGlyph);
+                                pGlyphs   += iGlyph;
+                                pClusters  = line.pSplitClusters;
+
+                                splitItem = *pItem;
+                                splitItem.offset += beg;
+                                splitItem.length  = end - beg;
+                                pItem = &splitItem;
+                            }
+
+                            /* Tabs need to be handled slightly differently to other characters due to it's different kind of spacing. */
+                            if (md_is_tab_utf8(pTextUTF8 + pItem->offset, pItem->length)) {
+                                /* It's a tab. */
+                                md_int32 tabEndX = md_text_layout_get_tab_end_x(penX - lineX, pItem->length, tabSizeXInPixels) + lineX;
+
+                                if (pCallbacks->onItem) {
+                                    result = pCallbacks->onItem(pCallbacks->pUserData, pLayout, pTextUTF8, pItem, pGlyphs, glyphCount, pClusters, penX, penY, tabEndX - penX, lineSizeY, MD_TEXT_LAYOUT_WHITESPACE);
+                                    if (result != MD_SUCCESS) {
+                                        break;  /* Cancelled or errored. */
+                                    }
+                                }
+
+                                penX = tabEndX;
+                            } else {
+                                md_uint32 flags = 0;
+                                if (md_is_newline_utf8(pTextUTF8 + pItem->offset, pItem->length)) {
+                                    flags |= MD_TEXT_LAYOUT_WHITESPACE | MD_TEXT_LAYOUT_NEWLINE;
+                                }
+
+                                if (pCallbacks->onItem) {
+                                    result = pCallbacks->onItem(pCallbacks->pUserData, pLayout, pTextUTF8, pItem, pGlyphs, glyphCount, pClusters, penX, penY, sizeX, pShapedItem->sizeY, flags);
+                                    if (result != MD_SUCCESS) {
+                                        break;  /* Cancelled or errored. */
+                                    }
+                                }
+
+                                penX += sizeX;
+
+                                if (!pLayout->singleLine && (flags & MD_TEXT_LAYOUT_NEWLINE) != 0) {
+                                    penY += lineSizeY;
+                                }
+                            }
+                        }
+                    }
+                    if (pCallbacks->onEndLine) {
+                        pCallbacks->onEndLine(pCallbacks->pUserData, pLayout, penX, penY);
+                    }
+
+                    /* A wrapped line moves down to the next line without a new-line character. */
+                    if (!isLastWrappedLine) {
+                        penY += lineSizeY;
+                    }
+                } while (result == MD_SUCCESS && !isLastWrappedLine);
+
+                /* Don't continue iteration if we've cancelled.*/
+                if (result != MD_SUCCESS) {
+                    break;
+                }
+
+                iItem = iLineEnd + 1;
+            }
+        }
+        if (pCallbacks->onEndItems) {
+            pCallbacks->onEndItems(pCallbacks->pUserData, pLayout, penX, penY);
+        }
+    }
+    if (pCallbacks->onUninit) {
+        pCallbacks->onUninit(pCallbacks->pUserData, pLayout);
+    }
+
+    md_text_layout_line_uninit(&line);
+
+    /* It's not an error if we cancelled. */
+    if (result == MD_CANCELLED) {
+        result =  MD_SUCCESS;
+    }
+
+    return result;
+}
+
+/*
+Itemizes the text and then lays it out with md_text_layout_do_layout_items_utf8().
+*/
+static md_result md_text_layout_do_layout_utf8(md_font* pFont, const md_utf8* pTextUTF8, size_t textLength, const md_text_layout* pLayout, const md_layout_callbacks* pCallbacks)
+{
+    md_result result;
+    md_itemize_state itemizeState;
+    size_t    scratchMark;
+    md_item_buffer items;
+
+    MD_ASSERT(pFont      != NULL);
+    MD_ASSERT(pTextUTF8  != NULL);
+    MD_ASSERT(pLayout    != NULL);
+    MD_ASSERT(pCallbacks != NULL);
+
+    scratchMark = md_scratch_get_mark(&pFont->scratch);
+    result = md_itemize__scratch(pFont, pTextUTF8, textLength, MD_ENCODING_UTF8, &items, &itemizeState);
+    if (result != MD_SUCCESS) {
+        return result;
+    }
+
+    result = md_text_layout_do_layout_items_utf8(pFont, pTextUTF8, items.pItems, items.count, pLayout, pCallbacks);
+
+    md_free_itemize_state(&itemizeState);
+    md_free_scratch_items(&items);
+    md_scratch_release(&pFont->scratch, scratchMark);
+
+    return result;
+}
+
+typedef struct
+{
+    md_int32 beginY;
+    md_int32 endY;
+    md_int32 sizeX;
+} md_font_get_text_layout_metrics_utf8_state;
+
+static void md_font_get_text_layout_metrics_utf8__on_begin_items(void* pUserData, const md_text_layout* pLayout, md_int32 penX, md_int32 penY)
+{
+    md_font_get_text_layout_metrics_utf8_state* pState = (md_font_get_text_layout_metrics_utf8_state*)pUserData;
+
+    (void)pLayout;
+    (void)penX;
+
+    pState->beginY = penY;
+}
+
+static void md_font_get_text_layout_metrics_utf8__on_end_items(void* pUserData, const md_text_layout* pLayout, md_int32 penX, md_int32 penY)
+{
+    md_font_get_text_layout_metrics_utf8_state* pState = (md_font_get_text_layout_metrics_utf8_state*)pUserData;
+
+    (void)pLayout;
+    (void)penX;
+
+    pState->endY = penY;
+}
+
+static void md_font_get_text_layout_metrics_utf8__on_begin_line(void* pUserData, const md_text_layout* pLayout, const char* pTextUTF8, const md_item* pItems, md_uint32 itemCount, md_int32 penX, md_int32 penY, md_int32 sizeX, md_int32 sizeY)
+{
+    md_font_get_text_layout_metrics_utf8_state* pState = (md_font_get_text_layout_metrics_utf8_state*)pUserData;
+
+    (void)pLayout;
+    (void)pTextUTF8;
+    (void)pItems;
+    (void)itemCount;
+    (void)penX;
+    (void)penY;
+    (void)sizeY;
+
+    if (pState->sizeX < sizeX) {
+        pState->sizeX = sizeX;
+    }
+}
+
+md_result md_font_get_text_layout_metrics_utf8(md_font* pFont, const md_utf8* pTextUTF8, size_t textLength, const md_text_layout* pLayout, md_text_metrics* pTextMetrics)
+{
+    md_result result;
+    md_int32 lineSizeY;
+    md_text_layout layout;
+    md_layout_callbacks callbacks;
+    md_font_get_text_layout_metrics_utf8_state state;
+
+    if (pTextMetrics == NULL) {
+        return MD_INVALID_ARGS;
+    }
+
+    MD_ZERO_OBJECT(pTextMetrics);
+
+    if (pFont == NULL || pTextUTF8 == NULL || pLayout == NULL) {
+        return MD_INVALID_ARGS;
+    }
+
+    lineSizeY = pFont->metricsCache.lineSizeY;
+
+    if (textLength == 0) {
+        pTextMetrics->sizeY = lineSizeY;
+        return MD_SUCCESS;  /* Nothing to do. */
+    }
+
+    /*
+    The text is measured by running it through the layout proper so that tabs and wrapping are measured exactly as they would be drawn. The
+    vertical alignment has no bearing on the size so it's forced to the top which saves the layout from having to count lines up front.
+    */
+    layout = *pLayout;
+    layout.alignmentY = md_alignment_top;
+
+    MD_ZERO_OBJECT(&state);
+
+    MD_ZERO_OBJECT(&callbacks);
+    callbacks.pUserData    = &state;
+    callbacks.onBeginItems = md_font_get_text_layout_metrics_utf8__on_begin_items;
+    callbacks.onEndItems   = md_font_get_text_layout_metrics_utf8__on_end_items;
+    callbacks.onBeginLine  = md_font_get_text_layout_metrics_utf8__on_begin_line;
+
+    result = md_text_layout_do_layout_utf8(pFont, pTextUTF8, textLength, &layout, &callbacks);
+    if (result != MD_SUCCESS) {
+        return result;
+    }
+
+    pTextMetrics->sizeX = state.sizeX;
+    pTextMetrics->sizeY = (state.endY - state.beginY) + lineSizeY;
+
+    return MD_SUCCESS;
+}
+
+typedef struct
+{
+    size_t cp;
+    size_t index;   /* The index of the query in the caller's arrays. */
+} md_text_layout_cp_query;
+
+typedef struct
+{
+    md_int32 x;
+    md_int32 y;
+    size_t index;
+    md_bool32 isResolved;   /* Whether or not the query has been resolved on the current line. */
+} md_text_layout_xy_query;
+
+static int md_compare_cp_queries(const void* a, const void* b)
+{
+    const md_text_layout_cp_query* pA = (const md_text_layout_cp_query*)a;
+    const md_text_layout_cp_query* pB = (const md_text_layout_cp_query*)b;
+
+    if (pA->cp < pB->cp) {
+        return -1;
+    } else if (pA->cp > pB->cp) {
+        return 1;
+    } else {
+        return 0;
+    }
+}
+
+static int md_compare_xy_queries(const void* a, const void* b)
+{
+    const md_text_layout_xy_query* pA = (const md_text_layout_xy_query*)a;
+    const md_text_layout_xy_query* pB = (const md_text_layout_xy_query*)b;
+
+    if (pA->y < pB->y) {
+        return -1;
+    } else if (pA->y > pB->y) {
+        return 1;
+    } else {
+        return 0;
+    }
+}
+
+typedef struct
+{
+    md_api* pAPI;
+    md_text_layout_cp_query* pQueries;  /* Sorted by code point. */
+    size_t queryCount;
+    size_t iQuery;                      /* The first query that hasn't been answered. */
+    md_int32* pX;
+    md_int32* pY;
+} md_text_layout_cp_to_xy_utf8_state;
+
+void md_text_layout_cp_to_xy_utf8__on_end_items(void* pUserData, const md_text_layout* pLayout, md_int32 penX, md_int32 penY)
+{
+    md_text_layout_cp_to_xy_utf8_state* pState = (md_text_layout_cp_to_xy_utf8_state*)pUserData;
+
+    (void)pLayout;
+
+    /* Anything we haven't yet found is past the end of the text which means it goes where the pen finished up. */
+    for (; pState->iQuery < pState->queryCount; pState->iQuery += 1) {
+        pState->pX[pState->pQueries[pState->iQuery].index] = penX;
+        pState->pY[pState->pQueries[pState->iQuery].index] = penY;
+    }
+}
+
+md_result md_text_layout_cp_to_xy_utf8__on_item(void* pUserData, const md_text_layout* pLayout, const char* pTextUTF8, const md_item* pItem, const md_glyph* pGlyphs, md_uint32 glyphCount, const size_t* pClusters, md_int32 penX, md_int32 penY, md_int32 sizeX, md_int32 sizeY, md_uint32 flags)
+{
+    md_text_layout_cp_to_xy_utf8_state* pState = (md_text_layout_cp_to_xy_utf8_state*)pUserData;
+
+    (void)pLayout;
+    (void)sizeX;
+    (void)sizeY;
+    (void)pTextUTF8;
+    (void)flags;
+
+    /* Items come through in order of their offset so any queries in this item will be next in line. */
+    while (pState->iQuery < pState->queryCount && pState->pQueries[pState->iQuery].cp < pItem->offset + pItem->length) {
+        const md_text_layout_cp_query* pQuery = &pState->pQueries[pState->iQuery];
+        md_int32 x;
+
+        md_index_to_x(pState->pAPI, pItem, pQuery->cp - pItem->offset, pItem->length, pClusters, pGlyphs, glyphCount, &x);
+
+        pState->pX[pQuery->index] = penX + x;
+        pState->pY[pQuery->index] = penY;
+        pState->iQuery += 1;
+    }
+
+    if (pState->iQuery == pState->queryCount) {
+        return MD_CANCELLED;    /* We're done. Don't iterate any more items. */
+    }
+
+    return MD_SUCCESS;
+}
+
+md_result md_text_layout_cp_to_xy_batch_utf8(md_font* pFont, const md_utf8* pTextUTF8, size_t textLength, const md_text_layout* pLayout, const size_t* pCPs, size_t count, md_int32* pX, md_int32* pY)
+{
+    md_result result;
+    md_text_layout_cp_to_xy_utf8_state state;
+    md_layout_callbacks callbacks;
+    md_text_layout_cp_query  pQueriesStack[64];
+    md_text_layout_cp_query* pQueriesHeap = NULL;
+    md_text_layout_cp_query* pQueries;
+    size_t iQuery;
+
+    if (pCPs == NULL || pX == NULL || pY == NULL) {
+        return MD_INVALID_ARGS;
+    }
+
+    /* Safety. */
+    for (iQuery = 0; iQuery < count; ++iQuery) {
+        pX[iQuery] = 0;
+        pY[iQuery] = 0;
+    }
+
+    if (pFont == NULL || pTextUTF8 == NULL || pLayout == NULL) {
+        return MD_INVALID_ARGS;
+    }
+
+    if (textLength == 0 || count == 0) {
+        return MD_SUCCESS;
+    }
+
+    if (count <= MD_COUNTOF(pQueriesStack)) {
+        pQueries = pQueriesStack;
+    } else {
+        pQueriesHeap = (md_text_layout_cp_query*)MD_MALLOC(sizeof(*pQueriesHeap) * count);
+        if (pQueriesHeap == NULL) {
+            return MD_OUT_OF_MEMORY;
+        }
+
+        pQueries = pQueriesHeap;
+    }
+
+    for (iQuery = 0; iQuery < count; ++iQuery) {
+        pQueries[iQuery].cp    = pCPs[iQuery];
+        pQueries[iQuery].index = iQuery;
+    }
+
+    qsort(pQueries, count, sizeof(*pQueries), md_compare_cp_queries);
+
+    /* This is based on the same algorithm as is used in md_gc_draw_text_layout_utf8(). */
+    state.pAPI       = pFont->pAPI;
+    state.pQueries   = pQueries;
+    state.queryCount = count;
+    state.iQuery     = 0;
+    state.pX         = pX;
+    state.pY         = pY;
+
+    callbacks.pUserData    = &state;
+    callbacks.onInit       = NULL;
+    callbacks.onUninit     = NULL;
+    callbacks.onBeginItems = NULL;
+    callbacks.onEndItems   = md_text_layout_cp_to_xy_utf8__on_end_items;
+    callbacks.onBeginLine  = NULL;
+    callbacks.onEndLine    = NULL;
+    callbacks.onItem       = md_text_layout_cp_to_xy_utf8__on_item;
+    result = md_text_layout_do_layout_utf8(pFont, pTextUTF8, textLength, pLayout, &callbacks);
+
+    MD_FREE(pQueriesHeap);
+    return result;
+}
+
+void md_text_layout_cp_to_xy_utf8(md_font* pFont, const md_utf8* pTextUTF8, size_t textLength, const md_text_layout* pLayout, size_t cp, md_int32* pX, md_int32* pY)
+{
+    md_int32 x = 0;
+    md_int32 y = 0;
+
+    md_text_layout_cp_to_xy_batch_utf8(pFont, pTextUTF8, textLength, pLayout, &cp, 1, &x, &y);
+
+    if (pX != NULL) { *pX = x; }
+    if (pY != NULL) { *pY = y; }
+}
+
+
+/*
+Position to code point queries are answered a line at a time. The queries are sorted by their Y position so the queries that belong to a line
+are always the next ones in the list. Each of them is then tested against the items of the line as they come through. Anything that isn't on
+any of the items goes to the end of the line.
+
+Points below the last line need special care because it's not known whether or not a line is the last until its items have been emitted.
+These are tested against any line that might be the last and the results are simply overwritten if it turns out that it isn't.
+*/
+typedef struct
+{
+    md_api* pAPI;
+    size_t textLength;
+    md_bool32 singleLine;
+    md_text_layout_xy_query* pQueries;  /* Sorted by Y. */
+    size_t queryCount;
+    size_t iQuery;                      /* The first query that hasn't been assigned to a line. */
+    size_t iLineQueryEnd;               /* One past the last query being tested against the current line. */
+    size_t iLineBelowQuery;             /* The first query that's below the current line. */
+    md_int32 lineBottom;
+    size_t lineEndCP;                   /* Where the cursor goes for points to the right of the line. */
+    size_t lineEndOffset;               /* The end of the last item on the line, including the new-line character. */
+    md_bool32 lineEndsWithNewline;
+    size_t* pCPs;
+} md_text_layout_xy_to_cp_utf8_state;
+
+static void md_text_layout_xy_to_cp_utf8__on_begin_line(void* pUserData, const md_text_layout* pLayout, const char* pTextUTF8, const md_item* pItems, md_uint32 itemCount, md_int32 penX, md_int32 penY, md_int32 sizeX, md_int32 sizeY)
+{
+    md_text_layout_xy_to_cp_utf8_state* pState = (md_text_layout_xy_to_cp_utf8_state*)pUserData;
+    md_bool32 mightBeLast;
+    size_t iQuery;
+
+    (void)pLayout;
+    (void)penX;
+    (void)sizeX;
+
+    pState->lineBottom = penY + sizeY;
+
+    /* Anything above the bottom of the line belongs to it, including anything above the first line. */
+    pState->iLineBelowQuery = pState->iQuery;
+    while (pState->iLineBelowQuery < pState->queryCount && pState->pQueries[pState->iLineBelowQuery].y < pState->lineBottom) {
+        pState->iLineBelowQuery += 1;
+    }
+
+    /*
+    The line might be the last one if its items reach the end of the text, not counting a new-line at the very end. This is only a rough
+    test because a wrapped line that ends part way through the last item will also get through here. Empty lines are always treated as
+    though they might be the last.
+    */
+    mightBeLast = MD_TRUE;
+    if (itemCount > 0) {
+        size_t lineEnd = pItems[itemCount - 1].offset + pItems[itemCount - 1].length;
+        if (lineEnd < pState->textLength) {
+            mightBeLast = md_is_newline_utf8(pTextUTF8 + lineEnd, pState->textLength - lineEnd) && pState->singleLine == MD_FALSE;
+        }
+    }
+
+    pState->iLineQueryEnd = (mightBeLast) ? pState->queryCount : pState->iLineBelowQuery;
+
+    for (iQuery = pState->iQuery; iQuery < pState->iLineQueryEnd; ++iQuery) {
+        pState->pQueries[iQuery].isResolved = MD_FALSE;
+    }
+
+    pState->lineEndCP           = (itemCount > 0) ? pItems[0].offset : 0;
+    pState->lineEndOffset       = pState->lineEndCP;
+    pState->lineEndsWithNewline = MD_FALSE;
+}
+
+static void md_text_layout_xy_to_cp_utf8__on_end_line(void* pUserData, const md_text_layout* pLayout, md_int32 penX, md_int32 penY)
+{
+    md_text_layout_xy_to_cp_utf8_state* pState = (md_text_layout_xy_to_cp_utf8_state*)pUserData;
+    size_t iQuery;
+
+    (void)pLayout;
+    (void)penX;
+    (void)penY;
+
+    for (iQuery = pState->iQuery; iQuery < pState->iLineQueryEnd; ++iQuery) {
+        md_text_layout_xy_query* pQuery = &pState->pQueries[iQuery];
+
+        if (pQuery->y >= pState->lineBottom && pState->lineEndsWithNewline && pState->lineEndOffset == pState->textLength && pState->singleLine == MD_FALSE) {
+            pState->pCPs[pQuery->index] = pState->textLength;   /* Below a new-line at the end of the text. This is where the empty line would be. */
+        } else if (!pQuery->isResolved) {
+            pState->pCPs[pQuery->index] = pState->lineEndCP;    /* To the right of the line. */
+        }
+    }
+
+    /* Only the queries that are definitely on this line are done with. Anything below it will be tested again against the next line. */
+    pState->iQuery = pState->iLineBelowQuery;
+}
+
+static md_result md_text_layout_xy_to_cp_utf8__on_item(void* pUserData, const md_text_layout* pLayout, const char* pTextUTF8, const md_item* pItem, const md_glyph* pGlyphs, md_uint32 glyphCount, const size_t* pClusters, md_int32 penX, md_int32 penY, md_int32 sizeX, md_int32 sizeY, md_uint32 flags)
+{
+    md_text_layout_xy_to_cp_utf8_state* pState = (md_text_layout_xy_to_cp_utf8_state*)pUserData;
+    size_t iQuery;
+
+    (void)pLayout;
+    (void)pTextUTF8;
+    (void)penY;
+    (void)sizeY;
+
+    for (iQuery = pState->iQuery; iQuery < pState->iLineQueryEnd; ++iQuery) {
+        md_text_layout_xy_query* pQuery = &pState->pQueries[iQuery];
+        size_t cp;
+
+        if (pQuery->isResolved) {
+            continue;
+        }
+
+        if (pQuery->x < penX) {
+            cp = pItem->offset; /* Only happens to the left of the first item. */
+        } else if (pQuery->x < penX + sizeX) {
+            if ((flags & MD_TEXT_LAYOUT_NEWLINE) != 0) {
+                cp = pItem->offset;
+            } else if ((flags & MD_TEXT_LAYOUT_WHITESPACE) != 0) {
+                /* Tabs. Snap to whichever side is closest. */
+                cp = pItem->offset + (((pQuery->x - penX) < (sizeX / 2)) ? 0 : pItem->length);
+            } else {
+                size_t index;
+                md_x_to_index(pState->pAPI, pItem, pQuery->x - penX, pItem->length, pClusters, pGlyphs, glyphCount, &index, NULL);
+                cp = pItem->offset + index;
+            }
+        } else {
+            continue;
+        }
+
+        pState->pCPs[pQuery->index] = cp;
+        pQuery->isResolved = MD_TRUE;
+    }
+
+    /* The cursor goes before the new-line character if there is one. */
+    if ((flags & MD_TEXT_LAYOUT_NEWLINE) != 0) {
+        pState->lineEndCP           = pItem->offset;
+        pState->lineEndsWithNewline = MD_TRUE;
+    } else {
+        pState->lineEndCP           = pItem->offset + pItem->length;
+    }
+
+    pState->lineEndOffset = pItem->offset + pItem->length;
+
+    /* We can stop once every query has been assigned to a line. */
+    if (pState->iQuery == pState->queryCount) {
+        return MD_CANCELLED;
+    }
+
+    return MD_SUCCESS;
+}
+
+md_result md_text_layout_xy_to_cp_batch_utf8(md_font* pFont, const md_utf8* pTextUTF8, size_t textLength, const md_text_layout* pLayout, const md_int32* pX, const md_int32* pY, size_t count, size_t* pCPs)
+{
+    md_result result;
+    md_text_layout_xy_to_cp_utf8_state state;
+    md_layout_callbacks callbacks;
+    md_text_layout_xy_query  pQueriesStack[64];
+    md_text_layout_xy_query* pQueriesHeap = NULL;
+    md_text_layout_xy_query* pQueries;
+    size_t iQuery;
+
+    if (pX == NULL || pY == NULL || pCPs == NULL) {
+        return MD_INVALID_ARGS;
+    }
+
+    /* Safety. */
+    for (iQuery = 0; iQuery < count; ++iQuery) {
+        pCPs[iQuery] = 0;
+    }
+
+    if (pFont == NULL || pTextUTF8 == NULL || pLayout == NULL) {
+        return MD_INVALID_ARGS;
+    }
+
+    if (textLength == 0 || count == 0) {
+        return MD_SUCCESS;
+    }
+
+    if (count <= MD_COUNTOF(pQueriesStack)) {
+        pQueries = pQueriesStack;
+    } else {
+        pQueriesHeap = (md_text_layout_xy_query*)MD_MALLOC(sizeof(*pQueriesHeap) * count);
+        if (pQueriesHeap == NULL) {
+            return MD_OUT_OF_MEMORY;
+        }
+
+        pQueries = pQueriesHeap;
+    }
+
+    for (iQuery = 0; iQuery < count; ++iQuery) {
+        pQueries[iQuery].x          = pX[iQuery];
+        pQueries[iQuery].y          = pY[iQuery];
+        pQueries[iQuery].index      = iQuery;
+        pQueries[iQuery].isResolved = MD_FALSE;
+    }
+
+    qsort(pQueries, count, sizeof(*pQueries), md_compare_xy_queries);
+
+    MD_ZERO_OBJECT(&state);
+    state.pAPI        = pFont->pAPI;
+    state.textLength  = textLength;
+    state.singleLine  = pLayout->singleLine;
+    state.pQueries    = pQueries;
+    state.queryCount  = count;
+    state.pCPs        = pCPs;
+
+    callbacks.pUserData    = &state;
+    callbacks.onInit       = NULL;
+    callbacks.onUninit     = NULL;
+    callbacks.onBeginItems = NULL;
+    callbacks.onEndItems   = NULL;
+    callbacks.onBeginLine  = md_text_layout_xy_to_cp_utf8__on_begin_line;
+    callbacks.onEndLine    = md_text_layout_xy_to_cp_utf8__on_end_line;
+    callbacks.onItem       = md_text_layout_xy_to_cp_utf8__on_item;
+    result = md_text_layout_do_layout_utf8(pFont, pTextUTF8, textLength, pLayout, &callbacks);
+
+    MD_FREE(pQueriesHeap);
+    return result;
+}
+
+void md_text_layout_xy_to_cp_utf8(md_font* pFont, const md_utf8* pTextUTF8, size_t textLength, const md_text_layout* pLayout, md_int32 x, md_int32 y, size_t* pCP)
+{
+    size_t cp = 0;
+
+    md_text_layout_xy_to_cp_batch_utf8(pFont, pTextUTF8, textLength, pLayout, &x, &y, 1, &cp);
+
+    if (pCP != NULL) {
+        *pCP = cp;
+    }
+}
+
+
+
+/*
+Finds the part of the text that needs to be laid out in order to get every line between [top] and [bottom], and a layout that puts that
+text in the same place as it would be if the whole text were laid out. Lines are only ever skipped at new-line characters which means the
+text doesn't need to be itemized or shaped to find them. Returns false if everything needs to be laid out.
+*/
+static md_bool32 md_text_layout_get_visible_text_utf8(md_font* pFont, const md_utf8* pTextUTF8, size_t textLength, const md_text_layout* pLayout, md_int32 top, md_int32 bottom, size_t* pOffset, size_t* pLength, md_text_layout* pVisibleLayout)
+{
+    md_int32 lineSizeY = pFont->metricsCache.lineSizeY;
+    md_int32 textSizeY = lineSizeY;
+    md_int32 originX;
+    md_int32 originY;
+    md_bool32 isWrapping;
+    size_t firstLine = 0;
+    size_t endLine = 0;
+    size_t linesSkipped;
+    size_t beg;
+    size_t end;
+
+    MD_ASSERT(pFont   != NULL);
+    MD_ASSERT(pLayout != NULL);
+
+    if (pLayout->singleLine || lineSizeY <= 0) {
+        return MD_FALSE;
+    }
+
+    /*
+    With wrapping, a line of text can take up any number of lines in the layout so there's no way to know where a line will be without
+    shaping everything above it. All we can do is skip the lines at the end, but only if the text is aligned to the top. Otherwise the
+    whole text needs to be shaped just to find where it starts.
+    */
+    isWrapping = (pLayout->wrapMode != md_text_wrap_mode_none);
+    if (isWrapping && pLayout->alignmentY != md_alignment_top) {
+        return MD_FALSE;
+    }
+
+    if (pLayout->alignmentY != md_alignment_top) {
+        size_t newlineCount;
+        md_skip_lines_utf8(pTextUTF8, textLength, (size_t)-1, &newlineCount);
+
+        if (newlineCount >= (size_t)(0x7FFFFFFF / lineSizeY)) {
+            return MD_FALSE;
+        }
+
+        textSizeY = (md_int32)(newlineCount + 1) * lineSizeY;
+    }
+
+    if (md_text_layout_get_origin(pLayout, textSizeY, &originX, &originY) != MD_SUCCESS) {
+        return MD_FALSE;
+    }
+
+    if (top > originY && !isWrapping) {
+        firstLine = (size_t)(((md_int64)top - originY) / lineSizeY);
+    }
+    if (bottom > originY) {
+        endLine = (size_t)(((md_int64)bottom - originY + lineSizeY - 1) / lineSizeY);
+    }
+
+    beg = md_skip_lines_utf8(pTextUTF8, textLength, firstLine, &linesSkipped);
+    if (beg == textLength) {
+        /* Everything is above the visible area. Keep the last line so that something still gets drawn. */
+        beg = md_skip_lines_utf8(pTextUTF8, textLength, linesSkipped, &linesSkipped);
+        if (beg == textLength && linesSkipped > 0) {
+            beg = md_skip_lines_utf8(pTextUTF8, textLength, linesSkipped - 1, &linesSkipped);   /* The text ends with a new line. */
+        }
+    }
+
+    /* The new-line character at the end of the last line is included so that the pen ends up in the same place. */
+    end = beg + md_skip_lines_utf8(pTextUTF8 + beg, textLength - beg, (endLine > linesSkipped + 1) ? endLine - linesSkipped : 1, NULL);
+
+    if (beg == 0 && end == textLength) {
+        return MD_FALSE;    /* Everything can be seen. */
+    }
+
+    *pOffset = beg;
+    *pLength = end - beg;
+
+    /* The text is positioned with the vertical offset so that the bounds are left unchanged for the benefit of the callbacks. */
+    *pVisibleLayout = *pLayout;
+    pVisibleLayout->alignmentY  = md_alignment_top;
+    pVisibleLayout->textOffsetY = originY + (md_int32)linesSkipped*lineSizeY - pLayout->boundsY - pLayout->padding.top;
+    if (pLayout->borderWidth > 0) {
+        pVisibleLayout->textOffsetY -= pLayout->borderWidth;
+    }
+
+    return MD_TRUE;
+}
+
+typedef struct
+{
+    md_gc* pGC;
+    md_int32 firstLineX;
+    md_int32 firstLineY;
+    md_int32 lineX;
+    md_int32 lineY;
+    md_int32 lineSizeX;
+    md_int32 lineSizeY;
+    md_int32 cullBottom;    /* Nothing at or below this can be seen so there's no need to go any further. */
+} md_gc_draw_text_layout_utf8_state;
+
+/*
+Retrieves the range on the Y axis where text drawn with the given layout can be seen. This is the layout bounds, minus padding, and the
+clipping region of the graphics context. It's extended by a line on both sides in case any glyphs go a bit outside of their line.
+*/
+static void md_gc_get_text_layout_visible_range(md_gc* pGC, const md_text_layout* pLayout, md_int32 lineSizeY, md_int32* pTop, md_int32* pBottom)
+{
+    md_int32 top;
+    md_int32 bottom;
+    md_int32 clipLeft;
+    md_int32 clipTop;
+    md_int32 clipRight;
+    md_int32 clipBottom;
+
+    /* This needs to be kept in sync with the clip in md_gc_draw_text_layout_utf8__on_begin_items(). */
+    top    = pLayout->boundsY + pLayout->padding.top;
+    bottom = pLayout->boundsY + pLayout->boundsSizeY - pLayout->padding.bottom;
+
+    if (md_gc_get_clip_bounds(pGC, &clipLeft, &clipTop, &clipRight, &clipBottom) == MD_SUCCESS) {
+        top    = MD_MAX(top,    clipTop);
+        bottom = MD_MIN(bottom, clipBottom);
+    }
+
+    *pTop    = top    - lineSizeY;
+    *pBottom = bottom + lineSizeY;
+}
+
+void md_gc_draw_text_layout_utf8__on_init(void* pUserData, const md_text_layout* pLayout)
+{
+    md_gc_draw_text_layout_utf8_state* pState = (md_gc_draw_text_layout_utf8_state*)pUserData;
+    md_gc_save(pState->pGC);
+
+    (void)pLayout;
+}
+
+void md_gc_draw_text_layout_utf8__on_uninit(void* pUserData, const md_text_layout* pLayout)
+{
+    md_gc_draw_text_layout_utf8_state* pState = (md_gc_draw_text_layout_utf8_state*)pUserData;
+    md_gc_restore(pState->pGC);
+
+    (void)pLayout;
+}
+
+void md_gc_draw_text_layout_utf8__on_begin_items(void* pUserData, const md_text_layout* pLayout, md_int32 penX, md_int32 penY)
+{
+    md_gc_draw_text_layout_utf8_state* pState = (md_gc_draw_text_layout_utf8_state*)pUserData;
+
+    pState->firstLineX = penX;
+    pState->firstLineY = penY;
+
+    /* Draw the border first. */
+    if (pLayout->borderWidth != 0) {
+        if (pLayout->borderWidth > 0) {
+            md_gc_rectangle_border_inner(pState->pGC, pLayout->boundsX, pLayout->boundsY, pLayout->boundsX + pLayout->boundsSizeX, pLayout->boundsY + pLayout->boundsSizeY, pLayout->borderWidth);
+        } else {
+            md_gc_rectangle_border_outer(pState->pGC, pLayout->boundsX, pLayout->boundsY, pLayout->boundsX + pLayout->boundsSizeX, pLayout->boundsY + pLayout->boundsSizeY, pLayout->borderWidth);
+        }
+        md_gc_set_fill_brush_solid(pState->pGC, pLayout->borderColor);
+        md_gc_fill(pState->pGC);
+    }
+
+    /* We need to clip against the bounds in case of overflow. */
+    md_gc_rectangle(pState->pGC, pLayout->boundsX + pLayout->padding.left, pLayout->boundsY + pLayout->padding.top, pLayout->boundsX + pLayout->boundsSizeX - pLayout->padding.right, pLayout->boundsY + pLayout->boundsSizeY - pLayout->padding.bottom);
+    md_gc_clip(pState->pGC);
+}
+
+void md_gc_draw_text_layout_utf8__on_end_items(void* pUserData, const md_text_layout* pLayout, md_int32 penX, md_int32 penY)
+{
+    md_gc_draw_text_layout_utf8_state* pState = (md_gc_draw_text_layout_utf8_state*)pUserData;
+
+    (void)penX;
+
+    /* Now we need to draw rectangles to fill the section above and below the main block of text. */
+    if (pLayout->fillBackground) {
+        md_color bgColor = md_gc_get_text_bg_color(pState->pGC);
+        if (bgColor.a != 0) {
+            md_int32 borderWidth = (pLayout->borderWidth > 0) ? pLayout->borderWidth : 0;
+
+            md_gc_set_antialias_mode(pState->pGC, md_antialias_mode_none);
+            md_gc_set_fill_brush_solid(pState->pGC, bgColor);
+            md_gc_rectangle(pState->pGC, pLayout->boundsX + borderWidth, pLayout->boundsY + borderWidth, pLayout->boundsX + pLayout->boundsSizeX - borderWidth, pState->firstLineY);                                    /* Above the text. */
+            md_gc_rectangle(pState->pGC, pLayout->boundsX + borderWidth, penY,                           pLayout->boundsX + pLayout->boundsSizeX - borderWidth, pLayout->boundsY + pLayout->boundsSizeY - borderWidth); /* Below the text. */
+            md_gc_fill(pState->pGC);
+        }
+    }
+}
+
+void md_gc_draw_text_layout_utf8__on_begin_line(void* pUserData, const md_text_layout* pLayout, const char* pTextUTF8, const md_item* pItems, md_uint32 itemCount, md_int32 penX, md_int32 penY, md_int32 sizeX, md_int32 sizeY)
+{
+    md_gc_draw_text_layout_utf8_state* pState = (md_gc_draw_text_layout_utf8_state*)pUserData;
+
+    (void)pLayout;
+    (void)pTextUTF8;
+    (void)pItems;
+    (void)itemCount;
+
+    pState->lineX     = penX;
+    pState->lineY     = penY;
+    pState->lineSizeX = sizeX;
+    pState->lineSizeY = sizeY;
+}
+
+void md_gc_draw_text_layout_utf8__on_end_line(void* pUserData, const md_text_layout* pLayout, md_int32 penX, md_int32 penY)
+{
+    md_gc_draw_text_layout_utf8_state* pState = (md_gc_draw_text_layout_utf8_state*)pUserData;
+
+    /* We need to draw the background of the layout bounds where the text doesn't cover. */
+    if (pLayout->fillBackground) {
+        md_color bgColor = md_gc_get_text_bg_color(pState->pGC);
+        if (bgColor.a != 0) {
+            md_int32 borderWidth = (pLayout->borderWidth > 0) ? pLayout->borderWidth : 0;
+
+            md_gc_set_antialias_mode(pState->pGC, md_antialias_mode_none);
+            md_gc_set_fill_brush_solid(pState->pGC, bgColor);
+            md_gc_rectangle(pState->pGC, pLayout->boundsX + borderWidth, penY, pState->lineX,                                         penY + pState->lineSizeY);  /* Left of the line. */
+            md_gc_rectangle(pState->pGC, penX,                           penY, pLayout->boundsX + pLayout->boundsSizeX - borderWidth, penY + pState->lineSizeY);  /* Right of the line. */
+            md_gc_fill(pState->pGC);
+        }
+    }
+}
+
+md_result md_gc_draw_text_layout_utf8__on_item(void* pUserData, const md_text_layout* pLayout, const char* pTextUTF8, const md_item* pItem, const md_glyph* pGlyphs, md_uint32 glyphCount, const size_t* pClusters, md_int32 penX, md_int32 penY, md_int32 sizeX, md_int32 sizeY, md_uint32 flags)
+{
+    md_gc_draw_text_layout_utf8_state* pState = (md_gc_draw_text_layout_utf8_state*)pUserData;
+
+    (void)pLayout;
+    (void)pTextUTF8;
+    (void)pClusters;
+
+    /* Lines come through from top to bottom so once we're past the bottom of the visible area there's nothing more to draw. */
+    if (penY >= pState->cullBottom) {
+        return MD_CANCELLED;
+    }
+
+    if ((flags & MD_TEXT_LAYOUT_WHITESPACE) != 0) {
+        /* Whitespace is drawn as a quad. */
+        md_gc_set_antialias_mode(pState->pGC, md_antialias_mode_none);
+        md_gc_set_fill_brush_solid(pState->pGC, md_gc_get_text_bg_color(pState->pGC));
+        md_gc_rectangle(pState->pGC, penX, penY, penX + sizeX, penY + sizeY);
+        md_gc_fill(pState->pGC);
+    } else {
+        /* This hack is specifically for GDI. We need to clip against the item metrics or else we'll overwrite one pixel too far to the left. Very annoying. */
+        if (pState->pGC->pAPI->backend == md_backend_gdi) {
+            md_gc_save(pState->pGC);
+            {
+                md_gc_rectangle(pState->pGC, penX, penY, penX + sizeX, penY + sizeY);
+                md_gc_clip(pState->pGC);
+                md_gc_draw_glyphs(pState->pGC, pItem, pGlyphs, glyphCount, penX, penY);
+            }
+            md_gc_restore(pState->pGC);
+        } else {
+            md_gc_draw_glyphs(pState->pGC, pItem, pGlyphs, glyphCount, penX, penY);
+        }
+    }
+
+    return MD_SUCCESS;
+}
+
+void md_gc_draw_text_layout_utf8(md_gc* pGC, md_font* pFont, const md_utf8* pTextUTF8, size_t textLength, const md_text_layout* pLayout)
+{
+    if (pGC == NULL || pFont == NULL || pTextUTF8 == NULL || textLength == 0 || pLayout == NULL) {
+        return;
+    }
+
+    if (textLength == (size_t)-1) {
+        textLength = strlen(pTextUTF8);
+    }
+
+#if 0
+    if (pGC->pAPI->procs.gcDrawTextLayoutUTF8) {
+        pGC->pAPI->procs.gcDrawTextLayoutUTF8(pGC, pFont, pTextUTF8, textLength, pLayout);
+    } else
+#endif
+    {
+        md_gc_draw_text_layout_utf8_state state;
+        md_layout_callbacks callbacks;
+        md_text_layout visibleLayout;
+        md_int32 visibleTop;
+        md_int32 visibleBottom;
+        size_t visibleOffset;
+        size_t visibleLength;
+
+        md_gc_get_text_layout_visible_range(pGC, pLayout, pFont->metricsCache.lineSizeY, &visibleTop, &visibleBottom);
+
+        /* Only the lines that can be seen need to be laid out. For large amounts of text this is most of the work. */
+        if (md_text_layout_get_visible_text_utf8(pFont, pTextUTF8, textLength, pLayout, visibleTop, visibleBottom, &visibleOffset, &visibleLength, &visibleLayout)) {
+            pTextUTF8  = pTextUTF8 + visibleOffset;
+            textLength = visibleLength;
+            pLayout    = &visibleLayout;
+        }
+
+        MD_ZERO_OBJECT(&state);
+        state.pGC        = pGC;
+        state.cullBottom = visibleBottom;
+
+        callbacks.pUserData    = &state;
+        callbacks.onInit       = md_gc_draw_text_layout_utf8__on_init;
+        callbacks.onUninit     = md_gc_draw_text_layout_utf8__on_uninit;
+        callbacks.onBeginItems = md_gc_draw_text_layout_utf8__on_begin_items;
+        callbacks.onEndItems   = md_gc_draw_text_layout_utf8__on_end_items;
+        callbacks.onBeginLine  = md_gc_draw_text_layout_utf8__on_begin_line;
+        callbacks.onEndLine    = md_gc_draw_text_layout_utf8__on_end_line;
+        callbacks.onItem       = md_gc_draw_text_layout_utf8__on_item;
+        md_text_layout_do_layout_utf8(pFont, pTextUTF8, textLength, pLayout, &callbacks);
+    }
+}
+
+
+static md_bool32 md_text_layout_equal(const md_text_layout* pA, const md_text_layout* pB)
+{
+    /* This is done field by field rather than with memcmp() because of the bit fields. */
+    return
+        pA->boundsX          == pB->boundsX          &&
+        pA->boundsY          == pB->boundsY          &&
+        pA->boundsSizeX      == pB->boundsSizeX      &&
+        pA->boundsSizeY      == pB->boundsSizeY      &&
+        pA->textOffsetX      == pB->textOffsetX      &&
+        pA->textOffsetY      == pB->textOffsetY      &&
+        pA->padding.left     == pB->padding.left     &&
+        pA->padding.top      == pB->padding.top      &&
+        pA->padding.right    == pB->padding.right    &&
+        pA->padding.bottom   == pB->padding.bottom   &&
+        pA->alignmentX       == pB->alignmentX       &&
+        pA->alignmentY       == pB->alignmentY       &&
+        pA->wrapMode         == pB->wrapMode         &&
+        pA->borderWidth      == pB->borderWidth      &&
+        pA->borderColor.r    == pB->borderColor.r    &&
+        pA->borderColor.g    == pB->borderColor.g    &&
+        pA->borderColor.b    == pB->borderColor.b    &&
+        pA->borderColor.a    == pB->borderColor.a    &&
+        pA->tabWidthInPixels == pB->tabWidthInPixels &&
+        pA->tabWidthInSpaces == pB->tabWidthInSpaces &&
+        pA->fillBackground   == pB->fillBackground   &&
+        pA->singleLine       == pB->singleLine;
+}
+
+typedef struct
+{
+    md_text_block* pBlock;
+    md_item* pItems;            /* The items of the paragraph being laid out. */
+    size_t iItem;               /* The item that the last run came from. Items that are split by wrapping are passed to onItem as copies so this is tracked by offset. */
+    md_result result;
+} md_text_block_layout_state;
+
+static void md_text_block_layout__on_begin_line(void* pUserData, const md_text_layout* pLayout, const char* pTextUTF8, const md_item* pItems, md_uint32 itemCount, md_int32 penX, md_int32 penY, md_int32 sizeX, md_int32 sizeY)
+{
+    md_text_block_layout_state* pState = (md_text_block_layout_state*)pUserData;
+    md_text_block* pBlock = pState->pBlock;
+    md_text_block_line* pLine;
+    void* pNewLines;
+
+    (void)pLayout;
+    (void)pTextUTF8;
+
+    if (pState->result != MD_SUCCESS) {
+        return;
+    }
+
+    pNewLines = md_grow_array(pBlock->scratch.pLines, &pBlock->scratch.lineCap, pBlock->scratch.lineCount + 1, sizeof(*pBlock->scratch.pLines), 16);
+    if (pNewLines == NULL) {
+        pState->result = MD_OUT_OF_MEMORY;
+        return;
+    }
+    pBlock->scratch.pLines = (md_text_block_line*)pNewLines;
+
+    pLine = &pBlock->scratch.pLines[pBlock->scratch.lineCount];
+    pLine->itemIndex = (size_t)(pItems - pState->pItems);
+    pState->iItem    = pLine->itemIndex;
+    pLine->itemCount = itemCount;
+    pLine->runIndex  = pBlock->scratch.runCount;
+    pLine->runCount  = 0;
+    pLine->posX      = penX;
+    pLine->posY      = penY;
+    pLine->sizeX     = sizeX;
+    pLine->sizeY     = sizeY;
+    pLine->endX      = penX;
+    pLine->endY      = penY;
+    pBlock->scratch.lineCount += 1;
+}
+
+static void md_text_block_layout__on_end_line(void* pUserData, const md_text_layout* pLayout, md_int32 penX, md_int32 penY)
+{
+    md_text_block_layout_state* pState = (md_text_block_layout_state*)pUserData;
+    md_text_block* pBlock = pState->pBlock;
+
+    (void)pLayout;
+
+    if (pState->result != MD_SUCCESS) {
+        return;
+    }
+
+    pBlock->scratch.pLines[pBlock->scratch.lineCount - 1].endX = penX;
+    pBlock->scratch.pLines[pBlock->scratch.lineCount - 1].endY = penY;
+}
+
+static md_result md_text_block_layout__on_item(void* pUserData, const md_text_layout* pLayout, const char* pTextUTF8, const md_item* pItem, const md_glyph* pGlyphs, md_uint32 glyphCount, const size_t* pClusters, md_int32 penX, md_int32 penY, md_int32 sizeX, md_int32 sizeY, md_uint32 flags)
+{
+    md_text_block_layout_state* pState = (md_text_block_layout_state*)pUserData;
+    md_text_block* pBlock = pState->pBlock;
+    md_text_block_run* pRun;
+    void* pNewArray;
+
+    (void)pLayout;
+    (void)pTextUTF8;
+
+    if (pState->result != MD_SUCCESS) {
+        return pState->result;
+    }
+
+    pNewArray = md_grow_array(pBlock->scratch.pRuns, &pBlock->scratch.runCap, pBlock->scratch.runCount + 1, sizeof(*pBlock->scratch.pRuns), 16);
+    if (pNewArray == NULL) {
+        return MD_OUT_OF_MEMORY;
+    }
+    pBlock->scratch.pRuns = (md_text_block_run*)pNewArray;
+
+    pNewArray = md_grow_array(pBlock->scratch.pGlyphs, &pBlock->scratch.glyphCap, pBlock->scratch.glyphCount + glyphCount, sizeof(*pBlock->scratch.pGlyphs), 256);
+    if (pNewArray == NULL) {
+        return MD_OUT_OF_MEMORY;
+    }
+    pBlock->scratch.pGlyphs = (md_glyph*)pNewArray;
+
+    pNewArray = md_grow_array(pBlock->scratch.pClusters, &pBlock->scratch.clusterCap, pBlock->scratch.clusterCount + pItem->length, sizeof(*pBlock->scratch.pClusters), 256);
+    if (pNewArray == NULL) {
+        return MD_OUT_OF_MEMORY;
+    }
+    pBlock->scratch.pClusters = (size_t*)pNewArray;
+
+    MD_COPY_MEMORY(pBlock->scratch.pGlyphs   + pBlock->scratch.glyphCount,   pGlyphs,   sizeof(*pGlyphs)   * glyphCount);
+    MD_COPY_MEMORY(pBlock->scratch.pClusters + pBlock->scratch.clusterCount, pClusters, sizeof(*pClusters) * pItem->length);
+
+    /* Runs come through in order so the item they belong to is always the current one or one after it. */
+    while (pItem->offset >= pState->pItems[pState->iItem].offset + pState->pItems[pState->iItem].length) {
+        pState->iItem += 1;
+    }
+
+    pRun = &pBlock->scratch.pRuns[pBlock->scratch.runCount];
+    pRun->itemIndex     = pState->iItem;
+    pRun->offset        = pItem->offset;
+    pRun->length        = pItem->length;
+    pRun->glyphOffset   = pBlock->scratch.glyphCount;
+    pRun->glyphCount    = glyphCount;
+    pRun->clusterOffset = pBlock->scratch.clusterCount;
+    pRun->posX          = penX;
+    pRun->posY          = penY;
+    pRun->sizeX         = sizeX;
+    pRun->sizeY         = sizeY;
+    pRun->flags         = flags;
+
+    pBlock->scratch.runCount     += 1;
+    pBlock->scratch.glyphCount   += glyphCount;
+    pBlock->scratch.clusterCount += pItem->length;
+    pBlock->scratch.pLines[pBlock->scratch.lineCount - 1].runCount += 1;
+
+    return MD_SUCCESS;
+}
+
+static size_t md_text_block_align_size(size_t size)
+{
+    return (size + 15) & ~(size_t)15;
+}
+
+static void md_text_block_free_paragraph(md_text_block_paragraph* pParagraph)
+{
+    MD_ASSERT(pParagraph != NULL);
+
+    md_free_itemize_state(&pParagraph->itemizeState);
+    MD_FREE(pParagraph->pItems);
+    MD_FREE(pParagraph->pGlyphClusters);  /* pGlyphX is part of the same allocation. */
+}
+
+static md_result md_text_block_grow_items(md_item_buffer* pItems, md_uint32 newCapacity)
+{
+    md_text_block* pBlock = (md_text_block*)pItems->pUserData;
+    void* pNewItems;
+
+    pNewItems = md_grow_array(pBlock->scratch.pItems, &pBlock->scratch.itemCap, newCapacity, sizeof(*pBlock->scratch.pItems), 16);
+    if (pNewItems == NULL) {
+        return MD_OUT_OF_MEMORY;
+    }
+
+    pBlock->scratch.pItems = (md_item*)pNewItems;
+
+    pItems->pItems   = pBlock->scratch.pItems;
+    pItems->capacity = (md_uint32)MD_MIN(pBlock->scratch.itemCap, 0xFFFFFFFF);
+
+    return MD_SUCCESS;
+}
+
+/*
+Itemizes, shapes and lays out a single paragraph. This runs the same layout as md_gc_draw_text_layout_utf8() and records everything it's
+given, except that positions are made relative to the top of the paragraph so that the paragraph can be moved without laying it out again.
+*/
+static md_result md_text_block_layout_paragraph(md_text_block* pBlock, size_t textOffset, size_t textLength, md_text_block_paragraph* pParagraph)
+{
+    md_result result;
+    const md_utf8* pTextUTF8 = pBlock->pTextUTF8 + textOffset;
+    md_item_buffer items;
+    md_uint32 itemCount;
+    md_text_layout layout;
+    md_int32 originX;
+    md_int32 originY;
+    md_text_block_layout_state state;
+    md_layout_callbacks callbacks;
+    size_t itemsSize;
+    size_t clustersSize;
+    size_t runsSize;
+    size_t linesSize;
+    size_t glyphsSize;
+    md_uint8* pData;
+    size_t iLine;
+    size_t iRun;
+
+    MD_ASSERT(textLength > 0);
+
+    MD_ZERO_OBJECT(pParagraph);
+    pParagraph->textOffset = textOffset;
+    pParagraph->textLength = textLength;
+
+    /* The items need to stay alive for as long as the paragraph because they're needed for drawing the glyphs. */
+    items.pItems    = pBlock->scratch.pItems;
+    items.capacity  = (md_uint32)pBlock->scratch.itemCap;
+    items.count     = 0;
+    items.onGrow    = md_text_block_grow_items;
+    items.pUserData = pBlock;
+
+    result = md_itemize_utf8_to_buffer(pBlock->pFont, pTextUTF8, textLength, &items, &pParagraph->itemizeState);
+    if (result != MD_SUCCESS) {
+        return result;
+    }
+
+    itemCount = items.count;
+
+    /* Paragraphs are always laid out from the top. Vertical alignment is applied to the block as a whole. */
+    layout = pBlock->layout;
+    layout.alignmentY = md_alignment_top;
+    md_text_layout_get_origin(&layout, 0, &originX, &originY);
+
+    pBlock->scratch.runCount     = 0;
+    pBlock->scratch.lineCount    = 0;
+    pBlock->scratch.glyphCount   = 0;
+    pBlock->scratch.clusterCount = 0;
+
+    state.pBlock = pBlock;
+    state.pItems = pBlock->scratch.pItems;
+    state.iItem  = 0;
+    state.result = MD_SUCCESS;
+
+    MD_ZERO_OBJECT(&callbacks);
+    callbacks.pUserData   = &state;
+    callbacks.onBeginLine = md_text_block_layout__on_begin_line;
+    callbacks.onEndLine   = md_text_block_layout__on_end_line;
+    callbacks.onItem      = md_text_block_layout__on_item;
+    result = md_text_layout_do_layout_items_utf8(pBlock->pFont, pTextUTF8, pBlock->scratch.pItems, itemCount, &layout, &callbacks);
+    if (result == MD_SUCCESS) {
+        result = state.result;
+    }
+
+    if (result != MD_SUCCESS) {
+        md_free_itemize_state(&pParagraph->itemizeState);
+        return result;
+    }
+
+    /* Everything is put into a single allocation. */
+    itemsSize    = md_text_block_align_size(sizeof(*pBlock->scratch.pItems)    * itemCount);
+    clustersSize = md_text_block_align_size(sizeof(*pBlock->scratch.pClusters) * pBlock->scratch.clusterCount);
+    runsSize     = md_text_block_align_size(sizeof(*pBlock->scratch.pRuns)     * pBlock->scratch.runCount);
+    linesSize    = md_text_block_align_size(sizeof(*pBlock->scratch.pLines)    * pBlock->scratch.lineCount);
+    glyphsSize   = md_text_block_align_size(sizeof(*pBlock->scratch.pGlyphs)   * pBlock->scratch.glyphCount);
+
+    pData = (md_uint8*)MD_MALLOC(itemsSize + clustersSize + runsSize + linesSize + glyphsSize);
+    if (pData == NULL) {
+        md_free_itemize_state(&pParagraph->itemizeState);
+        return MD_OUT_OF_MEMORY;
+    }
+
+    pParagraph->pItems    = (md_item*)pData;
+    pParagraph->pClusters = (size_t*)(pData + itemsSize);
+    pParagraph->pRuns     = (md_text_block_run*)(pData + itemsSize + clustersSize);
+    pParagraph->pLines    = (md_text_block_line*)(pData + itemsSize + clustersSize + runsSize);
+    pParagraph->pGlyphs   = (md_glyph*)(pData + itemsSize + clustersSize + runsSize + linesSize);
+
+    pParagraph->itemCount  = itemCount;
+    pParagraph->runCount   = pBlock->scratch.runCount;
+    pParagraph->lineCount  = pBlock->scratch.lineCount;
+    pParagraph->glyphCount = pBlock->scratch.glyphCount;
+
+    MD_COPY_MEMORY(pParagraph->pItems,    pBlock->scratch.pItems,    sizeof(*pParagraph->pItems)    * pParagraph->itemCount);
+    MD_COPY_MEMORY(pParagraph->pClusters, pBlock->scratch.pClusters, sizeof(*pParagraph->pClusters) * pBlock->scratch.clusterCount);
+    MD_COPY_MEMORY(pParagraph->pRuns,     pBlock->scratch.pRuns,     sizeof(*pParagraph->pRuns)     * pParagraph->runCount);
+    MD_COPY_MEMORY(pParagraph->pLines,    pBlock->scratch.pLines,    sizeof(*pParagraph->pLines)    * pParagraph->lineCount);
+    MD_COPY_MEMORY(pParagraph->pGlyphs,   pBlock->scratch.pGlyphs,   sizeof(*pParagraph->pGlyphs)   * pParagraph->glyphCount);
+
+    /* Make positions relative to the paragraph. */
+    for (iLine = 0; iLine < pParagraph->lineCount; ++iLine) {
+        pParagraph->pLines[iLine].posY -= originY;
+        pParagraph->pLines[iLine].endY -= originY;
+
+        if (pParagraph->sizeX < pParagraph->pLines[iLine].sizeX) {
+            pParagraph->sizeX = pParagraph->pLines[iLine].sizeX;
+        }
+        pParagraph->sizeY += pParagraph->pLines[iLine].sizeY;
+    }
+
+    for (iRun = 0; iRun < pParagraph->runCount; ++iRun) {
+        pParagraph->pRuns[iRun].posY -= originY;
+    }
+
+    return MD_SUCCESS;
+}
+
+/*
+Recalculates the offset and position of each paragraph from [iFirst] onwards, and the size and origin of the block. Paragraphs before
+[iFirst] are left alone. When [recalculateSizeX] is false the width of the block is only allowed to grow.
+*/
+static void md_text_block_update_positions(md_text_block* pBlock, size_t iFirst, md_bool32 recalculateSizeX)
+{
+    size_t iParagraph;
+    size_t textOffset = 0;
+    md_int32 posY = 0;
+    md_int32 lineSizeY = pBlock->pFont->metricsCache.lineSizeY;
+
+    if (iFirst > 0 && iFirst <= pBlock->paragraphCount) {
+        textOffset = pBlock->pParagraphs[iFirst - 1].textOffset + pBlock->pParagraphs[iFirst - 1].textLength;
+        posY       = pBlock->pParagraphs[iFirst - 1].posY       + pBlock->pParagraphs[iFirst - 1].sizeY;
+    } else {
+        iFirst = 0;
+    }
+
+    for (iParagraph = iFirst; iParagraph < pBlock->paragraphCount; ++iParagraph) {
+        md_text_block_paragraph* pParagraph = &pBlock->pParagraphs[iParagraph];
+
+        pParagraph->textOffset = textOffset;
+        pParagraph->posY       = posY;
+
+        textOffset += pParagraph->textLength;
+        posY       += pParagraph->sizeY;
+    }
+
+    MD_ASSERT(textOffset == pBlock->textLength);
+
+    if (recalculateSizeX) {
+        pBlock->sizeX = 0;
+        for (iParagraph = 0; iParagraph < pBlock->paragraphCount; ++iParagraph) {
+            if (pBlock->sizeX < pBlock->pParagraphs[iParagraph].sizeX) {
+                pBlock->sizeX = pBlock->pParagraphs[iParagraph].sizeX;
+            }
+        }
+    }
+
+    MD_ASSERT(textOffset == pBlock->textLength);
+
+    /* A trailing new line starts an empty line, and empty text still takes up one line. */
+    if (pBlock->paragraphCount == 0 || (pBlock->layout.singleLine == MD_FALSE && md_is_newline_utf8(pBlock->pTextUTF8 + pBlock->textLength - 1, 1))) {
+        posY += lineSizeY;
+    }
+
+    pBlock->sizeY = posY;
+
+    if (md_text_layout_get_origin(&pBlock->layout, pBlock->sizeY, &pBlock->originX, &pBlock->originY) != MD_SUCCESS) {
+        pBlock->originX = 0;
+        pBlock->originY = 0;
+    }
+}
+
+/*
+Lays out the text between [textBeg] and [textEnd] and uses the resulting paragraphs to replace [replaceCount] paragraphs starting at
+[iParagraph]. The text range must start at the start of a paragraph and end at the end of one.
+*/
+static md_result md_text_block_relayout(md_text_block* pBlock, size_t iParagraph, size_t replaceCount, size_t textBeg, size_t textEnd)
+{
+    md_result result = MD_SUCCESS;
+    md_text_block_paragraph* pNewParagraphs = NULL;
+    size_t newParagraphCount = 0;
+    size_t newParagraphCap = 0;
+    size_t iNewParagraph;
+    size_t textOffset;
+    md_bool32 recalculateSizeX = MD_FALSE;
+    void* pNewArray;
+
+    MD_ASSERT(iParagraph + replaceCount <= pBlock->paragraphCount);
+    MD_ASSERT(textBeg <= textEnd && textEnd <= pBlock->textLength);
+
+    textOffset = textBeg;
+    while (textOffset < textEnd) {
+        size_t paragraphLength;
+
+        /* Every line is a paragraph, unless we're in single line mode in which case the whole lot is a single paragraph. */
+        if (pBlock->layout.singleLine) {
+            paragraphLength = textEnd - textOffset;
+        } else {
+            const md_utf8* pLineEndUTF8;
+            const md_utf8* pNextLineBegUTF8 = md_next_line_utf8(pBlock->pTextUTF8 + textOffset, textEnd - textOffset, &pLineEndUTF8);
+            if (pNextLineBegUTF8 != NULL) {
+                paragraphLength = (size_t)(pNextLineBegUTF8 - (pBlock->pTextUTF8 + textOffset));
+            } else {
+                paragraphLength = textEnd - textOffset;
+            }
+        }
+
+        pNewArray = md_grow_array(pNewParagraphs, &newParagraphCap, newParagraphCount + 1, sizeof(*pNewParagraphs), 16);
+        if (pNewArray == NULL) {
+            result = MD_OUT_OF_MEMORY;
+            break;
+        }
+        pNewParagraphs = (md_text_block_paragraph*)pNewArray;
+
+        result = md_text_block_layout_paragraph(pBlock, textOffset, paragraphLength, &pNewParagraphs[newParagraphCount]);
+        if (result != MD_SUCCESS) {
+            break;
+        }
+
+        newParagraphCount += 1;
+        textOffset += paragraphLength;
+    }
+
+    if (result == MD_SUCCESS && pBlock->paragraphCount - replaceCount + newParagraphCount > pBlock->paragraphCap) {
+        pNewArray = md_grow_array(pBlock->pParagraphs, &pBlock->paragraphCap, pBlock->paragraphCount - replaceCount + newParagraphCount, sizeof(*pBlock->pParagraphs), 16);
+        if (pNewArray == NULL) {
+            result = MD_OUT_OF_MEMORY;
+        } else {
+            pBlock->pParagraphs = (md_text_block_paragraph*)pNewArray;
+        }
+    }
+
+    if (result != MD_SUCCESS) {
+        for (iNewParagraph = 0; iNewParagraph < newParagraphCount; ++iNewParagraph) {
+            md_text_block_free_paragraph(&pNewParagraphs[iNewParagraph]);
+        }
+
+        MD_FREE(pNewParagraphs);
+        return result;
+    }
+
+    /*
+    If one of the paragraphs being removed was the widest, and none of the new ones are at least as wide, the block may have become
+    narrower and the width needs to be calculated from scratch. Otherwise it can only get wider.
+    */
+    for (iNewParagraph = iParagraph; iNewParagraph < iParagraph + replaceCount; ++iNewParagraph) {
+        if (pBlock->pParagraphs[iNewParagraph].sizeX >= pBlock->sizeX) {
+            recalculateSizeX = MD_TRUE;
+        }
+
+        md_text_block_free_paragraph(&pBlock->pParagraphs[iNewParagraph]);
+    }
+
+    for (iNewParagraph = 0; iNewParagraph < newParagraphCount; ++iNewParagraph) {
+        if (pBlock->sizeX <= pNewParagraphs[iNewParagraph].sizeX) {
+            pBlock->sizeX = pNewParagraphs[iNewParagraph].sizeX;
+            recalculateSizeX = MD_FALSE;
+        }
+    }
+
+    /* Everything after the replaced paragraphs is moved into place. Their offsets and positions are fixed up by md_text_block_update_positions(). */
+    if (newParagraphCount != replaceCount && pBlock->paragraphCount > iParagraph + replaceCount) {
+        MD_MOVE_MEMORY(pBlock->pParagraphs + iParagraph + newParagraphCount, pBlock->pParagraphs + iParagraph + replaceCount, sizeof(*pBlock->pParagraphs) * (pBlock->paragraphCount - iParagraph - replaceCount));
+    }
+    if (newParagraphCount > 0) {
+        MD_COPY_MEMORY(pBlock->pParagraphs + iParagraph, pNewParagraphs, sizeof(*pBlock->pParagraphs) * newParagraphCount);
+    }
+    pBlock->paragraphCount = pBlock->paragraphCount - replaceCount + newParagraphCount;
+
+    MD_FREE(pNewParagraphs);
+
+    md_text_block_update_positions(pBlock, iParagraph, recalculateSizeX);
+
+    return MD_SUCCESS;
+}
+
+/*
+Redoes the layout of the entire block if it's been flagged as dirty.
+*/
+static md_result md_text_block_update(md_text_block* pBlock)
+{
+    md_result result;
+
+    MD_ASSERT(pBlock != NULL);
+
+    if (pBlock->isDirty == MD_FALSE) {
+        return MD_SUCCESS;
+    }
+
+    result = md_text_block_relayout(pBlock, 0, pBlock->paragraphCount, 0, pBlock->textLength);
+    if (result != MD_SUCCESS) {
+        return result;
+    }
+
+    pBlock->isDirty = MD_FALSE;
+    return MD_SUCCESS;
+}
+
+/*
+Finds the paragraph containing the given code unit. Offsets at the end of the text belong to the last paragraph.
+*/
+static size_t md_text_block_find_paragraph_by_offset(const md_text_block* pBlock, size_t offset)
+{
+    size_t lo = 0;
+    size_t hi = pBlock->paragraphCount;
+
+    MD_ASSERT(pBlock->paragraphCount > 0);
+
+    /* Find the last paragraph that starts at or before the offset. */
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo)/2;
+        if (pBlock->pParagraphs[mid].textOffset <= offset) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+/*
+Finds the paragraph under the given position, relative to the top of the text. Positions above or below the text are clamped.
+*/
+static size_t md_text_block_find_paragraph_by_y(const md_text_block* pBlock, md_int32 y)
+{
+    size_t lo = 0;
+    size_t hi = pBlock->paragraphCount;
+
+    MD_ASSERT(pBlock->paragraphCount > 0);
+
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo)/2;
+        if (pBlock->pParagraphs[mid].posY <= y) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+/*
+Retrieves the item to pass around with a run. When the run only covers part of the item, [pSplitItem] is filled with a copy of the item
+that's been adjusted to match the run.
+*/
+static const md_item* md_text_block_get_run_item(const md_text_block_paragraph* pParagraph, const md_text_block_run* pRun, md_item* pSplitItem)
+{
+    const md_item* pItem = &pParagraph->pItems[pRun->itemIndex];
+
+    if (pRun->offset == pItem->offset && pRun->length == pItem->length) {
+        return pItem;
+    }
+
+    *pSplitItem = *pItem;
+    pSplitItem->offset = pRun->offset;
+    pSplitItem->length = pRun->length;
+
+    return pSplitItem;
+}
+
+/*
+Retrieves the run index of a run for hit testing. The index data for the whole paragraph is built the first time any of its runs are hit
+tested. Most paragraphs are never hit tested so it isn't worth doing at layout time.
+*/
+static md_result md_text_block_get_run_index(md_text_block_paragraph* pParagraph, const md_text_block_run* pRun, md_run_index* pRunIndex)
+{
+    if (pParagraph->pGlyphClusters == NULL) {
+        size_t iRun;
+        void* pHeap;
+
+        pHeap = MD_MALLOC((sizeof(*pParagraph->pGlyphClusters) + sizeof(*pParagraph->pGlyphX)) * (pParagraph->glyphCount + 1));
+        if (pHeap == NULL) {
+            return MD_OUT_OF_MEMORY;
+        }
+
+        pParagraph->pGlyphClusters = (size_t*)pHeap;
+        pParagraph->pGlyphX        = (md_int32*)MD_OFFSET_PTR(pHeap, sizeof(*pParagraph->pGlyphClusters) * (pParagraph->glyphCount + 1));
+
+        for (iRun = 0; iRun < pParagraph->runCount; ++iRun) {
+            const md_text_block_run* pIndexedRun = &pParagraph->pRuns[iRun];
+            md_run_index_build(pParagraph->pClusters + pIndexedRun->clusterOffset, pIndexedRun->length, pParagraph->pGlyphs + pIndexedRun->glyphOffset, pIndexedRun->glyphCount, pParagraph->pGlyphX + pIndexedRun->glyphOffset, pParagraph->pGlyphClusters + pIndexedRun->glyphOffset);
+        }
+    }
+
+    md_run_index_init_preallocated(pParagraph->pClusters + pRun->clusterOffset, pRun->length, pParagraph->pGlyphs + pRun->glyphOffset, pRun->glyphCount, pParagraph->pGlyphX + pRun->glyphOffset, pParagraph->pGlyphClusters + pRun->glyphOffset, pRunIndex);
+
+    return MD_SUCCESS;
+}
+
+/*
+Passes the recorded layout of the block to the given callbacks in the same order as md_text_layout_do_layout_utf8().
+*/
+static md_result md_text_block_replay(md_text_block* pBlock, const md_layout_callbacks* pCallbacks)
+{
+    md_result result = MD_SUCCESS;
+    size_t iParagraph;
+    size_t iLine;
+    size_t iRun;
+    md_int32 endX = pBlock->originX;
+    md_int32 endY = pBlock->originY;
+
+    MD_ASSERT(pBlock     != NULL);
+    MD_ASSERT(pCallbacks != NULL);
+    MD_ASSERT(pBlock->isDirty == MD_FALSE);
+
+    if (pCallbacks->onInit) {
+        pCallbacks->onInit(pCallbacks->pUserData, &pBlock->layout);
+    }
+    if (pCallbacks->onBeginItems) {
+        pCallbacks->onBeginItems(pCallbacks->pUserData, &pBlock->layout, pBlock->originX, pBlock->originY);
+    }
+
+    for (iParagraph = 0; iParagraph < pBlock->paragraphCount; ++iParagraph) {
+        const md_text_block_paragraph* pParagraph = &pBlock->pParagraphs[iParagraph];
+        const md_utf8* pTextUTF8 = pBlock->pTextUTF8 + pParagraph->textOffset;
+        md_int32 offsetY = pBlock->originY + pParagraph->posY;
+
+        for (iLine = 0; iLine < pParagraph->lineCount; ++iLine) {
+            const md_text_block_line* pLine = &pParagraph->pLines[iLine];
+
+            if (pCallbacks->onBeginLine) {
+                pCallbacks->onBeginLine(pCallbacks->pUserData, &pBlock->layout, pTextUTF8, pParagraph->pItems + pLine->itemIndex, pLine->itemCount, pLine->posX, offsetY + pLine->posY, pLine->sizeX, pLine->sizeY);
+            }
+
+            if (pCallbacks->onItem) {
+                for (iRun = pLine->runIndex; iRun < pLine->runIndex + pLine->runCount; ++iRun) {
+                    const md_text_block_run* pRun = &pParagraph->pRuns[iRun];
+                    md_item splitItem;
+
+                    result = pCallbacks->onItem(pCallbacks->pUserData, &pBlock->layout, pTextUTF8, md_text_block_get_run_item(pParagraph, pRun, &splitItem), pParagraph->pGlyphs + pRun->glyphOffset, pRun->glyphCount, pParagraph->pClusters + pRun->clusterOffset, pRun->posX, offsetY + pRun->posY, pRun->sizeX, pRun->sizeY, pRun->flags);
+                    if (result != MD_SUCCESS) {
+                        break;
+                    }
+                }
+            }
+
+            endX = pLine->endX;
+            endY = offsetY + pLine->endY;
+
+            if (pCallbacks->onEndLine) {
+                pCallbacks->onEndLine(pCallbacks->pUserData, &pBlock->layout, endX, endY);
+            }
+
+            if (result != MD_SUCCESS) {
+                break;
+            }
+        }
+
+        if (result != MD_SUCCESS) {
+            break;
+        }
+    }
+
+    if (pCallbacks->onEndItems) {
+        pCallbacks->onEndItems(pCallbacks->pUserData, &pBlock->layout, endX, endY);
+    }
+    if (pCallbacks->onUninit) {
+        pCallbacks->onUninit(pCallbacks->pUserData, &pBlock->layout);
+    }
+
+    if (result == MD_CANCELLED) {
+        result = MD_SUCCESS;
+    }
+
+    return result;
+}
+
+md_result md_text_block_init(md_font* pFont, const md_utf8* pTextUTF8, size_t textLength, const md_text_layout* pLayout, md_text_block* pBlock)
+{
+    md_result result;
+
+    if (pBlock == NULL) {
+        return MD_INVALID_ARGS;
+    }
+
+    MD_ZERO_OBJECT(pBlock);
+
+    if (pFont == NULL || pLayout == NULL) {
+        return MD_INVALID_ARGS;
+    }
+
+    pBlock->pFont   = pFont;
+    pBlock->layout  = *pLayout;
+    pBlock->isDirty = MD_TRUE;
+
+    result = md_text_block_set_text_utf8(pBlock, pTextUTF8, textLength);
+    if (result != MD_SUCCESS) {
+        return result;
+    }
+
+    return MD_SUCCESS;
+}
+
+void md_text_block_uninit(md_text_block* pBlock)
+{
+    size_t iParagraph;
+
+    if (pBlock == NULL) {
+        return;
+    }
+
+    for (iParagraph = 0; iParagraph < pBlock->paragraphCount; ++iParagraph) {
+        md_text_block_free_paragraph(&pBlock->pParagraphs[iParagraph]);
+    }
+
+    MD_FREE(pBlock->scratch.pClusters);
+    MD_FREE(pBlock->scratch.pGlyphs);
+    MD_FREE(pBlock->scratch.pLines);
+    MD_FREE(pBlock->scratch.pRuns);
+    MD_FREE(pBlock->scratch.pItems);
+    MD_FREE(pBlock->pParagraphs);
+    MD_FREE(pBlock->pTextUTF8);
+    MD_ZERO_OBJECT(pBlock);
+}
+
+const md_utf8* md_text_block_get_text_utf8(const md_text_block* pBlock, size_t* pTextLength)
+{
+    if (pTextLength != NULL) {
+        *pTextLength = 0;
+    }
+
+    if (pBlock == NULL) {
+        return NULL;
+    }
+
+    if (pTextLength != NULL) {
+        *pTextLength = pBlock->textLength;
+    }
+
+    return pBlock->pTextUTF8;
+}
+
+md_result md_text_block_set_text_utf8(md_text_block* pBlock, const md_utf8* pTextUTF8, size_t textLength)
+{
+    if (pBlock == NULL) {
+        return MD_INVALID_ARGS;
+    }
+
+    if (pTextUTF8 == NULL) {
+        if (textLength != 0) {
+            return MD_INVALID_ARGS;
+        }
+
+        pTextUTF8 = "";
+    }
+
+    if (textLength == (size_t)-1) {
+        textLength = strlen(pTextUTF8);
+    }
+
+    /* Nothing to do if the text hasn't changed. */
+    if (pBlock->pTextUTF8 != NULL && pBlock->textLength == textLength && memcmp(pBlock->pTextUTF8, pTextUTF8, textLength) == 0) {
+        return MD_SUCCESS;
+    }
+
+    if (textLength + 1 > pBlock->textCap) {
+        md_utf8* pNewText = (md_utf8*)MD_REALLOC(pBlock->pTextUTF8, textLength + 1);
+        if (pNewText == NULL) {
+            return MD_OUT_OF_MEMORY;
+        }
+
+        pBlock->pTextUTF8 = pNewText;
+        pBlock->textCap   = textLength + 1;
+    }
+
+    MD_COPY_MEMORY(pBlock->pTextUTF8, pTextUTF8, textLength);
+    pBlock->pTextUTF8[textLength] = '\0';
+    pBlock->textLength = textLength;
+    pBlock->isDirty    = MD_TRUE;
+
+    return MD_SUCCESS;
+}
+
+md_result md_text_block_replace_text_utf8(md_text_block* pBlock, size_t offset, size_t length, const md_utf8* pTextUTF8, size_t textLength)
+{
+    md_result result;
+    size_t newTextLength;
+    size_t iFirst;
+    size_t iLast;
+    size_t textBeg;
+    size_t textEnd;
+
+    if (pBlock == NULL) {
+        return MD_INVALID_ARGS;
+    }
+
+    if (pTextUTF8 == NULL) {
+        if (textLength != 0) {
+            return MD_INVALID_ARGS;
+        }
+
+        pTextUTF8 = "";
+    }
+
+    if (textLength == (size_t)-1) {
+        textLength = strlen(pTextUTF8);
+    }
+
+    if (offset > pBlock->textLength || length > pBlock->textLength - offset) {
+        return MD_INVALID_ARGS;
+    }
+
+    if (length == 0 && textLength == 0) {
+        return MD_SUCCESS;  /* Nothing to do. */
+    }
+
+    /*
+    Find the paragraphs touched by the edit before changing the text. The paragraph before the edit is included when the edit starts right
+    at the start of a paragraph because removing or inserting text there can join a "\r" at the end of the previous paragraph with a "\n".
+    */
+    if (pBlock->isDirty == MD_FALSE && pBlock->paragraphCount > 0) {
+        iFirst = md_text_block_find_paragraph_by_offset(pBlock, offset);
+        if (iFirst > 0 && offset == pBlock->pParagraphs[iFirst].textOffset) {
+            iFirst -= 1;
+        }
+
+        iLast = md_text_block_find_paragraph_by_offset(pBlock, offset + length);
+        if (iLast > iFirst && offset + length == pBlock->pParagraphs[iLast].textOffset) {
+            iLast -= 1;
+        }
+    } else {
+        iFirst = 0;
+        iLast  = 0;
+    }
+
+    /* Now update the text. */
+    newTextLength = pBlock->textLength - length + textLength;
+    if (newTextLength + 1 > pBlock->textCap) {
+        size_t newTextCap = pBlock->textCap * 2;
+        md_utf8* pNewText;
 
-                /* Don't continue iteration if we've cancelled.*/
-                if (result == MD_CANCELLED) {
-                    break;
-                }
-            }
+        if (newTextCap < newTextLength + 1) {
+            newTextCap = newTextLength + 1;
         }
-        if (pCallbacks->onEndItems) {
-            pCallbacks->onEndItems(pCallbacks->pUserData, pLayout, penX, penY);
+
+        pNewText = (md_utf8*)MD_REALLOC(pBlock->pTextUTF8, newTextCap);
+        if (pNewText == NULL) {
+            return MD_OUT_OF_MEMORY;
         }
-    }
-    if (pCallbacks->onUninit) {
-        pCallbacks->onUninit(pCallbacks->pUserData, pLayout);
+
+        pBlock->pTextUTF8 = pNewText;
+        pBlock->textCap   = newTextCap;
     }
 
-    md_free_itemize_state(&itemizeState);
+    MD_MOVE_MEMORY(pBlock->pTextUTF8 + offset + textLength, pBlock->pTextUTF8 + offset + length, pBlock->textLength - offset - length);
+    MD_COPY_MEMORY(pBlock->pTextUTF8 + offset, pTextUTF8, textLength);
+    pBlock->pTextUTF8[newTextLength] = '\0';
+    pBlock->textLength = newTextLength;
+
+    /* If the whole block is going to be laid out again anyway there's nothing more to do. */
+    if (pBlock->isDirty || pBlock->paragraphCount == 0) {
+        pBlock->isDirty = MD_TRUE;
+        return MD_SUCCESS;
+    }
 
-    MD_FREE(pGlyphsHeap);
-    pGlyphsHeap = NULL;
+    textBeg = pBlock->pParagraphs[iFirst].textOffset;
+    textEnd = pBlock->pParagraphs[iLast].textOffset + pBlock->pParagraphs[iLast].textLength - length + textLength;
 
-    MD_FREE(pClustersHeap);
-    pClustersHeap = NULL;
+    /*
+    The edit may have removed the new line at the end of the last affected paragraph, or left a "\r" that's now followed by the "\n" at the
+    start of the next one. In these cases the next paragraph needs to be joined with it.
+    */
+    while (iLast + 1 < pBlock->paragraphCount) {
+        if (textEnd > textBeg) {
+            md_utf8 lastCh = pBlock->pTextUTF8[textEnd - 1];
+            if (lastCh == '\n' || (lastCh == '\r' && pBlock->pTextUTF8[textEnd] != '\n')) {
+                break;
+            }
+        }
 
-    MD_FREE(pItemsHeap);
-    pItemsHeap = NULL;
+        iLast   += 1;
+        textEnd += pBlock->pParagraphs[iLast].textLength;
+    }
 
-    /* It's not an error if we cancelled. */
-    if (result == MD_CANCELLED) {
-        result =  MD_SUCCESS;
+    result = md_text_block_relayout(pBlock, iFirst, iLast - iFirst + 1, textBeg, textEnd);
+    if (result != MD_SUCCESS) {
+        pBlock->isDirty = MD_TRUE;  /* The paragraphs are now out of sync with the text. Try again from scratch next time. */
+        return result;
     }
 
-    return result;
+    return MD_SUCCESS;
 }
 
+md_result md_text_block_insert_text_utf8(md_text_block* pBlock, size_t offset, const md_utf8* pTextUTF8, size_t textLength)
+{
+    return md_text_block_replace_text_utf8(pBlock, offset, 0, pTextUTF8, textLength);
+}
 
-typedef struct
+md_result md_text_block_delete_text(md_text_block* pBlock, size_t offset, size_t length)
 {
-    md_api* pAPI;
-    size_t cp;
-    md_int32 x;
-    md_int32 y;
-    md_bool32 found;
-} md_text_layout_cp_to_xy_utf8_state;
+    return md_text_block_replace_text_utf8(pBlock, offset, length, NULL, 0);
+}
 
-void md_text_layout_cp_to_xy_utf8__on_end_items(void* pUserData, const md_text_layout* pLayout, md_int32 penX, md_int32 penY)
+md_result md_text_block_set_font(md_text_block* pBlock, md_font* pFont)
 {
-    md_text_layout_cp_to_xy_utf8_state* pState = (md_text_layout_cp_to_xy_utf8_state*)pUserData;
+    if (pBlock == NULL || pFont == NULL) {
+        return MD_INVALID_ARGS;
+    }
 
-    (void)pLayout;
+    if (pBlock->pFont != pFont) {
+        pBlock->pFont   = pFont;
+        pBlock->isDirty = MD_TRUE;
+    }
+
+    return MD_SUCCESS;
+}
+
+md_result md_text_block_set_layout(md_text_block* pBlock, const md_text_layout* pLayout)
+{
+    if (pBlock == NULL || pLayout == NULL) {
+        return MD_INVALID_ARGS;
+    }
 
-    /* If we haven't yet found our coordinates we need to put ourselves at the end. */
-    if (!pState->found) {
-        pState->x = penX;
-        pState->y = penY;
-        pState->found = MD_TRUE;
+    if (!md_text_layout_equal(&pBlock->layout, pLayout)) {
+        pBlock->layout  = *pLayout;
+        pBlock->isDirty = MD_TRUE;
     }
+
+    return MD_SUCCESS;
 }
 
-md_result md_text_layout_cp_to_xy_utf8__on_item(void* pUserData, const md_text_layout* pLayout, const char* pTextUTF8, const md_item* pItem, const md_glyph* pGlyphs, md_uint32 glyphCount, const size_t* pClusters, md_int32 penX, md_int32 penY, md_int32 sizeX, md_int32 sizeY, md_uint32 flags)
+md_result md_text_block_get_text_metrics(md_text_block* pBlock, md_text_metrics* pMetrics)
 {
-    md_text_layout_cp_to_xy_utf8_state* pState = (md_text_layout_cp_to_xy_utf8_state*)pUserData;
+    md_result result;
 
-    (void)pLayout;
-    (void)sizeX;
-    (void)sizeY;
-    (void)pTextUTF8;
-    (void)flags;
+    if (pMetrics == NULL) {
+        return MD_INVALID_ARGS;
+    }
 
-    /* If this item contains our code point we can do a hit test on it. */
-    if (pState->cp >= pItem->offset && pState->cp < pItem->offset + pItem->length) {
-        /* It's in this item. Get the exact glyph position and then terminate. */
-        pState->y = penY;
-        
-        md_index_to_x(pState->pAPI, pItem, pState->cp - pItem->offset, pItem->length, pClusters, pGlyphs, glyphCount, &pState->x);
-        pState->x += penX;
+    MD_ZERO_OBJECT(pMetrics);
 
-        pState->found = MD_TRUE;
-        return MD_CANCELLED;    /* We're done. Don't iterate any more items. */
-    } else {
-        /* It's not here. Continue. */
-        return MD_SUCCESS;
+    if (pBlock == NULL) {
+        return MD_INVALID_ARGS;
+    }
+
+    result = md_text_block_update(pBlock);
+    if (result != MD_SUCCESS) {
+        return result;
     }
+
+    pMetrics->sizeX = pBlock->sizeX;
+    pMetrics->sizeY = pBlock->sizeY;
+
+    return MD_SUCCESS;
 }
 
-void md_text_layout_cp_to_xy_utf8(md_font* pFont, const md_utf8* pTextUTF8, size_t textLength, const md_text_layout* pLayout, size_t cp, md_int32* pX, md_int32* pY)
+md_result md_text_block_cp_to_xy(md_text_block* pBlock, size_t cp, md_int32* pX, md_int32* pY)
 {
+    md_result result;
+    md_text_block_paragraph* pParagraph;
+    const md_text_block_line* pLastLine;
+    size_t iRun;
+
     /* Safety. */
     if (pX != NULL) { *pX = 0; }
     if (pY != NULL) { *pY = 0; }
 
-    if (pFont == NULL || pTextUTF8 == NULL || textLength == 0 || pLayout == NULL) {
-        return;
+    if (pBlock == NULL) {
+        return MD_INVALID_ARGS;
     }
 
-#if 0
-    if (pGC->pAPI->procs.textLayoutCPToXYUTF8) {
-        pGC->pAPI->procs.textLayoutCPToXYUTF8(pFont, pTextUTF8, textLength, pLayout, cp, pX, pY);
-    } else
-#endif
-    {
-        /* Generic implementation. This is based on the same algorithm as is used in md_gc_draw_text_layout_utf8(). */
-        md_text_layout_cp_to_xy_utf8_state state;
-        md_layout_callbacks callbacks;
+    result = md_text_block_update(pBlock);
+    if (result != MD_SUCCESS) {
+        return result;
+    }
 
-        state.pAPI  = pFont->pAPI;
-        state.cp    = cp;
-        state.x     = 0;
-        state.y     = 0;
-        state.found = MD_FALSE;
+    if (pBlock->paragraphCount == 0) {
+        return MD_SUCCESS;
+    }
 
-        callbacks.pUserData    = &state;
-        callbacks.onInit       = NULL;
-        callbacks.onUninit     = NULL;
-        callbacks.onBeginItems = NULL;
-        callbacks.onEndItems   = md_text_layout_cp_to_xy_utf8__on_end_items;
-        callbacks.onBeginLine  = NULL;
-        callbacks.onEndLine    = NULL;
-        callbacks.onItem       = md_text_layout_cp_to_xy_utf8__on_item;
-        md_text_layout_do_layout_utf8(pFont, pTextUTF8, textLength, pLayout, &callbacks);
+    pParagraph = &pBlock->pParagraphs[md_text_block_find_paragraph_by_offset(pBlock, cp)];
 
-        if (pX != NULL) { *pX = state.x; }
-        if (pY != NULL) { *pY = state.y; }
-    }
-}
+    if (cp < pParagraph->textOffset + pParagraph->textLength) {
+        size_t cpInParagraph = cp - pParagraph->textOffset;
 
+        for (iRun = 0; iRun < pParagraph->runCount; ++iRun) {
+            const md_text_block_run* pRun = &pParagraph->pRuns[iRun];
 
+            if (cpInParagraph >= pRun->offset && cpInParagraph < pRun->offset + pRun->length) {
+                md_run_index runIndex;
+                size_t index = cpInParagraph - pRun->offset;
+                md_int32 x;
 
-typedef struct
-{
-    md_gc* pGC;
-    md_int32 firstLineX;
-    md_int32 firstLineY;
-    md_int32 lineX;
-    md_int32 lineY;
-    md_int32 lineSizeX;
-    md_int32 lineSizeY;
-} md_gc_draw_text_layout_utf8_state;
+                result = md_text_block_get_run_index(pParagraph, pRun, &runIndex);
+                if (result != MD_SUCCESS) {
+                    return result;
+                }
 
-void md_gc_draw_text_layout_utf8__on_init(void* pUserData, const md_text_layout* pLayout)
-{
-    md_gc_draw_text_layout_utf8_state* pState = (md_gc_draw_text_layout_utf8_state*)pUserData;
-    md_gc_save(pState->pGC);
+                md_run_index_index_to_x(&runIndex, &index, 1, &x);
 
-    (void)pLayout;
-}
+                if (pX != NULL) { *pX = pRun->posX + x; }
+                if (pY != NULL) { *pY = pBlock->originY + pParagraph->posY + pRun->posY; }
+                return MD_SUCCESS;
+            }
+        }
+    }
 
-void md_gc_draw_text_layout_utf8__on_uninit(void* pUserData, const md_text_layout* pLayout)
-{
-    md_gc_draw_text_layout_utf8_state* pState = (md_gc_draw_text_layout_utf8_state*)pUserData;
-    md_gc_restore(pState->pGC);
+    /* Getting here means the code point is past the end of the text. It goes where the pen finished up. */
+    pParagraph = &pBlock->pParagraphs[pBlock->paragraphCount - 1];
+    pLastLine  = &pParagraph->pLines[pParagraph->lineCount - 1];
 
-    (void)pLayout;
+    if (pX != NULL) { *pX = pLastLine->endX; }
+    if (pY != NULL) { *pY = pBlock->originY + pParagraph->posY + pLastLine->endY; }
+
+    return MD_SUCCESS;
 }
 
-void md_gc_draw_text_layout_utf8__on_begin_items(void* pUserData, const md_text_layout* pLayout, md_int32 penX, md_int32 penY)
+md_result md_text_block_xy_to_cp(md_text_block* pBlock, md_int32 x, md_int32 y, size_t* pCP)
 {
-    md_gc_draw_text_layout_utf8_state* pState = (md_gc_draw_text_layout_utf8_state*)pUserData;
+    md_result result;
+    md_text_block_paragraph* pParagraph;
+    const md_text_block_line* pLine;
+    const md_text_block_run* pRun;
+    size_t iLine;
+    size_t iRun;
 
-    pState->firstLineX = penX;
-    pState->firstLineY = penY;
+    if (pCP == NULL) {
+        return MD_INVALID_ARGS;
+    }
 
-    /* Draw the border first. */
-    if (pLayout->borderWidth != 0) {
-        if (pLayout->borderWidth > 0) {
-            md_gc_rectangle_border_inner(pState->pGC, pLayout->boundsX, pLayout->boundsY, pLayout->boundsX + pLayout->boundsSizeX, pLayout->boundsY + pLayout->boundsSizeY, pLayout->borderWidth);
-        } else {
-            md_gc_rectangle_border_outer(pState->pGC, pLayout->boundsX, pLayout->boundsY, pLayout->boundsX + pLayout->boundsSizeX, pLayout->boundsY + pLayout->boundsSizeY, pLayout->borderWidth);
-        }
-        md_gc_set_fill_brush_solid(pState->pGC, pLayout->borderColor);
-        md_gc_fill(pState->pGC);
+    *pCP = 0;
+
+    if (pBlock == NULL) {
+        return MD_INVALID_ARGS;
     }
 
-    /* We need to clip against the bounds in case of overflow. */
-    md_gc_rectangle(pState->pGC, pLayout->boundsX + pLayout->padding.left, pLayout->boundsY + pLayout->padding.top, pLayout->boundsX + pLayout->boundsSizeX - pLayout->padding.right, pLayout->boundsY + pLayout->boundsSizeY - pLayout->padding.bottom);
-    md_gc_clip(pState->pGC);
-}
+    result = md_text_block_update(pBlock);
+    if (result != MD_SUCCESS) {
+        return result;
+    }
 
-void md_gc_draw_text_layout_utf8__on_end_items(void* pUserData, const md_text_layout* pLayout, md_int32 penX, md_int32 penY)
-{
-    md_gc_draw_text_layout_utf8_state* pState = (md_gc_draw_text_layout_utf8_state*)pUserData;
+    if (pBlock->paragraphCount == 0) {
+        return MD_SUCCESS;
+    }
 
-    (void)penX;
+    /* Find the line first. Anything past the last line is clamped to it. */
+    y -= pBlock->originY;
 
-    /* Now we need to draw rectangles to fill the section above and below the main block of text. */
-    if (pLayout->fillBackground) {
-        md_color bgColor = md_gc_get_text_bg_color(pState->pGC);
-        if (bgColor.a != 0) {
-            md_int32 borderWidth = (pLayout->borderWidth > 0) ? pLayout->borderWidth : 0;
+    pParagraph = &pBlock->pParagraphs[md_text_block_find_paragraph_by_y(pBlock, y)];
+    y -= pParagraph->posY;
 
-            md_gc_set_antialias_mode(pState->pGC, md_antialias_mode_none);
-            md_gc_set_fill_brush_solid(pState->pGC, bgColor);
-            md_gc_rectangle(pState->pGC, pLayout->boundsX + borderWidth, pLayout->boundsY + borderWidth, pLayout->boundsX + pLayout->boundsSizeX - borderWidth, pState->firstLineY);                                    /* Above the text. */
-            md_gc_rectangle(pState->pGC, pLayout->boundsX + borderWidth, penY,                           pLayout->boundsX + pLayout->boundsSizeX - borderWidth, pLayout->boundsY + pLayout->boundsSizeY - borderWidth); /* Below the text. */
-            md_gc_fill(pState->pGC);
+    for (iLine = 0; iLine < pParagraph->lineCount - 1; ++iLine) {
+        if (y < pParagraph->pLines[iLine].posY + pParagraph->pLines[iLine].sizeY) {
+            break;
         }
     }
-}
 
-void md_gc_draw_text_layout_utf8__on_begin_line(void* pUserData, const md_text_layout* pLayout, const char* pTextUTF8, const md_item* pItems, md_uint32 itemCount, md_int32 penX, md_int32 penY, md_int32 sizeX, md_int32 sizeY)
-{
-    md_gc_draw_text_layout_utf8_state* pState = (md_gc_draw_text_layout_utf8_state*)pUserData;
+    pLine = &pParagraph->pLines[iLine];
+    MD_ASSERT(pLine->runCount > 0);
 
-    (void)pLayout;
-    (void)pTextUTF8;
-    (void)pItems;
-    (void)itemCount;
+    /* When the text ends with a new line there's an empty line after the last one. That's where the end of the text is. */
+    if (pParagraph == &pBlock->pParagraphs[pBlock->paragraphCount - 1] && iLine == pParagraph->lineCount - 1 && y >= pLine->posY + pLine->sizeY && (pParagraph->pRuns[pLine->runIndex + pLine->runCount - 1].flags & MD_TEXT_LAYOUT_NEWLINE) != 0 && pBlock->layout.singleLine == MD_FALSE) {
+        *pCP = pBlock->textLength;
+        return MD_SUCCESS;
+    }
 
-    pState->lineX     = penX;
-    pState->lineY     = penY;
-    pState->lineSizeX = sizeX;
-    pState->lineSizeY = sizeY;
-}
+    /* Now the run. */
+    for (iRun = pLine->runIndex; iRun < pLine->runIndex + pLine->runCount; ++iRun) {
+        pRun = &pParagraph->pRuns[iRun];
 
-void md_gc_draw_text_layout_utf8__on_end_line(void* pUserData, const md_text_layout* pLayout, md_int32 penX, md_int32 penY)
-{
-    md_gc_draw_text_layout_utf8_state* pState = (md_gc_draw_text_layout_utf8_state*)pUserData;
+        if (x < pRun->posX) {
+            *pCP = pParagraph->textOffset + pRun->offset;  /* Only happens to the left of the first run. */
+            return MD_SUCCESS;
+        }
 
-    /* We need to draw the background of the layout bounds where the text doesn't cover. */
-    if (pLayout->fillBackground) {
-        md_color bgColor = md_gc_get_text_bg_color(pState->pGC);
-        if (bgColor.a != 0) {
-            md_int32 borderWidth = (pLayout->borderWidth > 0) ? pLayout->borderWidth : 0;
+        if (x < pRun->posX + pRun->sizeX) {
+            if ((pRun->flags & MD_TEXT_LAYOUT_NEWLINE) != 0) {
+                *pCP = pParagraph->textOffset + pRun->offset;
+            } else if ((pRun->flags & MD_TEXT_LAYOUT_WHITESPACE) != 0) {
+                /* Tabs. Snap to whichever side is closest. */
+                *pCP = pParagraph->textOffset + pRun->offset + (((x - pRun->posX) < (pRun->sizeX / 2)) ? 0 : pRun->length);
+            } else {
+                md_run_index runIndex;
+                md_int32 runX = x - pRun->posX;
+                size_t index;
 
-            md_gc_set_antialias_mode(pState->pGC, md_antialias_mode_none);
-            md_gc_set_fill_brush_solid(pState->pGC, bgColor);
-            md_gc_rectangle(pState->pGC, pLayout->boundsX + borderWidth, penY, pState->lineX,                                         penY + pState->lineSizeY);  /* Left of the line. */
-            md_gc_rectangle(pState->pGC, penX,                           penY, pLayout->boundsX + pLayout->boundsSizeX - borderWidth, penY + pState->lineSizeY);  /* Right of the line. */
-            md_gc_fill(pState->pGC);
+                result = md_text_block_get_run_index(pParagraph, pRun, &runIndex);
+                if (result != MD_SUCCESS) {
+                    return result;
+                }
+
+                md_run_index_x_to_index(&runIndex, &runX, 1, &index, NULL);
+
+                *pCP = pParagraph->textOffset + pRun->offset + index;
+            }
+
+            return MD_SUCCESS;
         }
     }
-}
-
-md_result md_gc_draw_text_layout_utf8__on_item(void* pUserData, const md_text_layout* pLayout, const char* pTextUTF8, const md_item* pItem, const md_glyph* pGlyphs, md_uint32 glyphCount, const size_t* pClusters, md_int32 penX, md_int32 penY, md_int32 sizeX, md_int32 sizeY, md_uint32 flags)
-{
-    md_gc_draw_text_layout_utf8_state* pState = (md_gc_draw_text_layout_utf8_state*)pUserData;
 
-    (void)pLayout;
-    (void)pTextUTF8;
-    (void)pClusters;
+    /* Getting here means we're past the end of the line. The cursor goes before the new-line character if there is one. */
+    pRun = &pParagraph->pRuns[pLine->runIndex + pLine->runCount - 1];
 
-    if ((flags & MD_TEXT_LAYOUT_WHITESPACE) != 0) {
-        /* Whitespace is drawn as a quad. */
-        md_gc_set_antialias_mode(pState->pGC, md_antialias_mode_none);
-        md_gc_set_fill_brush_solid(pState->pGC, md_gc_get_text_bg_color(pState->pGC));
-        md_gc_rectangle(pState->pGC, penX, penY, penX + sizeX, penY + sizeY);
-        md_gc_fill(pState->pGC);
+    if ((pRun->flags & MD_TEXT_LAYOUT_NEWLINE) != 0) {
+        *pCP = pParagraph->textOffset + pRun->offset;
     } else {
-        /* This hack is specifically for GDI. We need to clip against the item metrics or else we'll overwrite one pixel too far to the left. Very annoying. */
-        if (pState->pGC->pAPI->backend == md_backend_gdi) {
-            md_gc_save(pState->pGC);
-            {
-                md_gc_rectangle(pState->pGC, penX, penY, penX + sizeX, penY + sizeY);
-                md_gc_clip(pState->pGC);
-                md_gc_draw_glyphs(pState->pGC, pItem, pGlyphs, glyphCount, penX, penY);
-            }
-            md_gc_restore(pState->pGC);
-        } else {
-            md_gc_draw_glyphs(pState->pGC, pItem, pGlyphs, glyphCount, penX, penY);
-        }
+        *pCP = pParagraph->textOffset + pRun->offset + pRun->length;
     }
 
     return MD_SUCCESS;
 }
 
-void md_gc_draw_text_layout_utf8(md_gc* pGC, md_font* pFont, const md_utf8* pTextUTF8, size_t textLength, const md_text_layout* pLayout)
+void md_gc_draw_text_block(md_gc* pGC, md_text_block* pBlock)
 {
-    if (pGC == NULL || pFont == NULL || pTextUTF8 == NULL || textLength == 0 || pLayout == NULL) {
+    md_gc_draw_text_layout_utf8_state state;
+    md_layout_callbacks callbacks;
+    md_int32 visibleTop;
+
+    if (pGC == NULL || pBlock == NULL) {
         return;
     }
 
-    if (textLength == (size_t)-1) {
-        textLength = strlen(pTextUTF8);
+    if (md_text_block_update(pBlock) != MD_SUCCESS) {
+        return;
     }
 
-#if 0
-    if (pGC->pAPI->procs.gcDrawTextLayoutUTF8) {
-        pGC->pAPI->procs.gcDrawTextLayoutUTF8(pGC, pFont, pTextUTF8, textLength, pLayout);
-    } else
-#endif
-    {
-        md_gc_draw_text_layout_utf8_state state;
-        md_layout_callbacks callbacks;
+    if (pBlock->textLength == 0) {
+        return;
+    }
 
-        MD_ZERO_OBJECT(&state);
-        state.pGC = pGC;
+    MD_ZERO_OBJECT(&state);
+    state.pGC = pGC;
+    md_gc_get_text_layout_visible_range(pGC, &pBlock->layout, pBlock->pFont->metricsCache.lineSizeY, &visibleTop, &state.cullBottom);
 
-        callbacks.pUserData    = &state;
-        callbacks.onInit       = md_gc_draw_text_layout_utf8__on_init;
-        callbacks.onUninit     = md_gc_draw_text_layout_utf8__on_uninit;
-        callbacks.onBeginItems = md_gc_draw_text_layout_utf8__on_begin_items;
-        callbacks.onEndItems   = md_gc_draw_text_layout_utf8__on_end_items;
-        callbacks.onBeginLine  = md_gc_draw_text_layout_utf8__on_begin_line;
-        callbacks.onEndLine    = md_gc_draw_text_layout_utf8__on_end_line;
-        callbacks.onItem       = md_gc_draw_text_layout_utf8__on_item;
-        md_text_layout_do_layout_utf8(pFont, pTextUTF8, textLength, pLayout, &callbacks);
-    }
+    callbacks.pUserData    = &state;
+    callbacks.onInit       = md_gc_draw_text_layout_utf8__on_init;
+    callbacks.onUninit     = md_gc_draw_text_layout_utf8__on_uninit;
+    callbacks.onBeginItems = md_gc_draw_text_layout_utf8__on_begin_items;
+    callbacks.onEndItems   = md_gc_draw_text_layout_utf8__on_end_items;
+    callbacks.onBeginLine  = md_gc_draw_text_layout_utf8__on_begin_line;
+    callbacks.onEndLine    = md_gc_draw_text_layout_utf8__on_end_line;
+    callbacks.onItem       = md_gc_draw_text_layout_utf8__on_item;
+    md_text_block_replay(pBlock, &callbacks);
 }
 
 void md_gc_clear(md_gc* pGC, md_color color)
@@ -716,6 +716,615 @@ done:
 }
 
 
+/*
+Boundary tests for the vectorized paths. Each vector is a run of code points with a single other code point
+inserted at a given offset. The run lengths are chosen so that the code point lands on every lane of the
+first and second 16 unit block as well as in the scalar tail. The run is either plain ASCII or a mix of 1, 2
+and 3 byte UTF-8 sequences.
+*/
+#define TEST_UTF_BOUNDARY_MAX    64     /* Maximum number of code points in a vector. */
+#define TEST_UTF_BOUNDARY_UNITS  (TEST_UTF_BOUNDARY_MAX * 4)
+#define TEST_UTF_BOUNDARY_GUARD  16
+#define TEST_UTF_INVALID_OCTET   0xFFFFFFFF /* Encoded as a lone 0xFF octet in UTF-8 and decoded as U+FFFD. */
+#define TEST_UTF_LONE_SURROGATE  0xFFFFFFFE /* Encoded as a lone 0xDFFF unit in UTF-32 and decoded as U+FFFD. */
+#define TEST_UTF_STRAY_CONTINUATION 0xFFFFFFFD /* Encoded as a lone 0x80 octet in UTF-8 and decoded as U+FFFD. */
+#define TEST_UTF_OVERLONG_LEAD   0xFFFFFFFC /* Encoded as a 0xC1 octet in UTF-8 and decoded as U+FFFD. */
+#define TEST_UTF_OVERLONG        0xFFFFFFFB /* Inserted as TEST_UTF_OVERLONG_LEAD followed by TEST_UTF_STRAY_CONTINUATION. */
+
+static const size_t g_utfBoundaryLengths[] = {15, 16, 17, 31, 32, 33, 48};
+
+/* Includes the first and last code points of each UTF-8 sequence length below 4. */
+static const md_utf32 g_utfBoundaryMixedRun[] = {'a', 0xE9, 0x4E2D, 0x7FF, 'b', 0x800, 0x3B1, 0xFFFF, 0xAC00, 'c', 0x80, 0xFF21};
+
+typedef struct
+{
+    md_uint32 units[TEST_UTF_BOUNDARY_UNITS];
+    size_t len;
+    size_t offsets[TEST_UTF_BOUNDARY_MAX + 1];  /* The offset of each code point in units. */
+} test_utf_units;
+
+/* Output and input are passed through void pointers so that each conversion can be run by the same test. */
+typedef md_result (* test_utf_boundary_proc)(void* pOutput, size_t outputCap, size_t* pOutputLen, const void* pInput, size_t inputLen, size_t* pInputLenProcessed);
+
+md_result test__utf8_to_utf16ne_boundary_proc(void* pOutput, size_t outputCap, size_t* pOutputLen, const void* pInput, size_t inputLen, size_t* pInputLenProcessed)
+{
+    return md_utf8_to_utf16ne((md_utf16*)pOutput, outputCap, pOutputLen, (const md_utf8*)pInput, inputLen, pInputLenProcessed, 0);
+}
+
+md_result test__utf8_to_utf32ne_boundary_proc(void* pOutput, size_t outputCap, size_t* pOutputLen, const void* pInput, size_t inputLen, size_t* pInputLenProcessed)
+{
+    return md_utf8_to_utf32ne((md_utf32*)pOutput, outputCap, pOutputLen, (const md_utf8*)pInput, inputLen, pInputLenProcessed, 0);
+}
+
+md_result test__utf16le_to_utf8_boundary_proc(void* pOutput, size_t outputCap, size_t* pOutputLen, const void* pInput, size_t inputLen, size_t* pInputLenProcessed)
+{
+    return md_utf16le_to_utf8((md_utf8*)pOutput, outputCap, pOutputLen, (const md_utf16*)pInput, inputLen, pInputLenProcessed, 0);
+}
+
+md_result test__utf16be_to_utf8_boundary_proc(void* pOutput, size_t outputCap, size_t* pOutputLen, const void* pInput, size_t inputLen, size_t* pInputLenProcessed)
+{
+    return md_utf16be_to_utf8((md_utf8*)pOutput, outputCap, pOutputLen, (const md_utf16*)pInput, inputLen, pInputLenProcessed, 0);
+}
+
+md_result test__utf32le_to_utf8_boundary_proc(void* pOutput, size_t outputCap, size_t* pOutputLen, const void* pInput, size_t inputLen, size_t* pInputLenProcessed)
+{
+    return md_utf32le_to_utf8((md_utf8*)pOutput, outputCap, pOutputLen, (const md_utf32*)pInput, inputLen, pInputLenProcessed, 0);
+}
+
+md_result test__utf32be_to_utf8_boundary_proc(void* pOutput, size_t outputCap, size_t* pOutputLen, const void* pInput, size_t inputLen, size_t* pInputLenProcessed)
+{
+    return md_utf32be_to_utf8((md_utf8*)pOutput, outputCap, pOutputLen, (const md_utf32*)pInput, inputLen, pInputLenProcessed, 0);
+}
+
+md_result test__utf32le_to_utf16le_boundary_proc(void* pOutput, size_t outputCap, size_t* pOutputLen, const void* pInput, size_t inputLen, size_t* pInputLenProcessed)
+{
+    return md_utf32le_to_utf16le((md_utf16*)pOutput, outputCap, pOutputLen, (const md_utf32*)pInput, inputLen, pInputLenProcessed, 0);
+}
+
+md_result test__utf32be_to_utf16be_boundary_proc(void* pOutput, size_t outputCap, size_t* pOutputLen, const void* pInput, size_t inputLen, size_t* pInputLenProcessed)
+{
+    return md_utf32be_to_utf16be((md_utf16*)pOutput, outputCap, pOutputLen, (const md_utf32*)pInput, inputLen, pInputLenProcessed, 0);
+}
+
+size_t test__utf_boundary_code_points(md_utf32* pCodePoints, size_t runLen, md_bool32 isMixedRun, size_t offset, md_utf32 codePoint)
+{
+    size_t count = 0;
+    size_t i;
+
+    for (i = 0; i < runLen; i += 1) {
+        if (i == offset) {
+            if (codePoint == TEST_UTF_OVERLONG) {
+                pCodePoints[count++] = TEST_UTF_OVERLONG_LEAD;
+                pCodePoints[count++] = TEST_UTF_STRAY_CONTINUATION;
+            } else {
+                pCodePoints[count++] = codePoint;
+            }
+        }
+
+        if (isMixedRun) {
+            pCodePoints[count++] = g_utfBoundaryMixedRun[i % MD_COUNTOF(g_utfBoundaryMixedRun)];
+        } else {
+            pCodePoints[count++] = (md_utf32)('a' + (i % 26));
+        }
+    }
+
+    if (offset == runLen) {
+        if (codePoint == TEST_UTF_OVERLONG) {
+            pCodePoints[count++] = TEST_UTF_OVERLONG_LEAD;
+            pCodePoints[count++] = TEST_UTF_STRAY_CONTINUATION;
+        } else {
+            pCodePoints[count++] = codePoint;
+        }
+    }
+
+    return count;
+}
+
+size_t test__utf_encode(md_uint32* pUnits, md_uint32 unitSize, md_utf32 codePoint)
+{
+    if (codePoint == TEST_UTF_INVALID_OCTET) {
+        if (unitSize == 1) {
+            pUnits[0] = 0xFF;
+            return 1;
+        } else {
+            codePoint = MD_UNICODE_REPLACEMENT_CHARACTER;
+        }
+    }
+
+    if (codePoint == TEST_UTF_STRAY_CONTINUATION) {
+        if (unitSize == 1) {
+            pUnits[0] = 0x80;
+            return 1;
+        } else {
+            codePoint = MD_UNICODE_REPLACEMENT_CHARACTER;
+        }
+    }
+
+    if (codePoint == TEST_UTF_OVERLONG_LEAD) {
+        if (unitSize == 1) {
+            pUnits[0] = 0xC1;
+            return 1;
+        } else {
+            codePoint = MD_UNICODE_REPLACEMENT_CHARACTER;
+        }
+    }
+
+    if (codePoint == TEST_UTF_LONE_SURROGATE) {
+        if (unitSize == 4) {
+            pUnits[0] = 0xDFFF;
+            return 1;
+        } else {
+            codePoint = MD_UNICODE_REPLACEMENT_CHARACTER;
+        }
+    }
+
+    if (unitSize == 1) {
+        if (codePoint < 0x80) {
+            pUnits[0] = codePoint;
+            return 1;
+        } else if (codePoint < 0x800) {
+            pUnits[0] = 0xC0 | (codePoint >> 6);
+            pUnits[1] = 0x80 | (codePoint & 0x3F);
+            return 2;
+        } else if (codePoint < 0x10000) {
+            pUnits[0] = 0xE0 | (codePoint >> 12);
+            pUnits[1] = 0x80 | ((codePoint >> 6) & 0x3F);
+            pUnits[2] = 0x80 | (codePoint & 0x3F);
+            return 3;
+        } else {
+            pUnits[0] = 0xF0 | (codePoint >> 18);
+            pUnits[1] = 0x80 | ((codePoint >> 12) & 0x3F);
+            pUnits[2] = 0x80 | ((codePoint >> 6) & 0x3F);
+            pUnits[3] = 0x80 | (codePoint & 0x3F);
+            return 4;
+        }
+    } else if (unitSize == 2 && codePoint >= 0x10000) {
+        pUnits[0] = 0xD800 + ((codePoint - 0x10000) >> 10);
+        pUnits[1] = 0xDC00 + ((codePoint - 0x10000) & 0x3FF);
+        return 2;
+    } else {
+        pUnits[0] = codePoint;
+        return 1;
+    }
+}
+
+void test__utf_encode_code_points(test_utf_units* pUnits, md_uint32 unitSize, const md_utf32* pCodePoints, size_t codePointCount)
+{
+    size_t i;
+
+    pUnits->len = 0;
+    for (i = 0; i < codePointCount; i += 1) {
+        pUnits->offsets[i] = pUnits->len;
+        pUnits->len += test__utf_encode(pUnits->units + pUnits->len, unitSize, pCodePoints[i]);
+    }
+    pUnits->offsets[i] = pUnits->len;
+}
+
+/* Returns whether or not units of the given byte order need to be swapped to or from native endian. */
+md_bool32 test__utf_is_swapped(md_bool32 isBE)
+{
+    return (isBE) ? md_is_little_endian() : !md_is_little_endian();
+}
+
+md_uint32 test__utf_get_unit(const void* pUnits, md_uint32 unitSize, md_bool32 isSwapped, size_t index)
+{
+    if (unitSize == 1) {
+        return ((const md_uint8*)pUnits)[index];
+    } else if (unitSize == 2) {
+        md_uint16 unit = ((const md_uint16*)pUnits)[index];
+        return (isSwapped) ? md_swap_endian_uint16(unit) : unit;
+    } else {
+        md_uint32 unit = ((const md_uint32*)pUnits)[index];
+        return (isSwapped) ? md_swap_endian_uint32(unit) : unit;
+    }
+}
+
+void test__utf_set_unit(void* pUnits, md_uint32 unitSize, md_bool32 isSwapped, size_t index, md_uint32 value)
+{
+    if (unitSize == 1) {
+        ((md_uint8*)pUnits)[index] = (md_uint8)value;
+    } else if (unitSize == 2) {
+        ((md_uint16*)pUnits)[index] = (isSwapped) ? md_swap_endian_uint16((md_uint16)value) : (md_uint16)value;
+    } else {
+        ((md_uint32*)pUnits)[index] = (isSwapped) ? md_swap_endian_uint32(value) : value;
+    }
+}
+
+/*
+Runs a conversion with a null output buffer, which must return the length, and then with every output
+capacity from 1 up to one more than what is needed. On success the
+output and the processed count must match exactly. When the output buffer is too small, nothing must be
+written past the capacity, what was written must be a prefix of the expected output, and the processed
+count must stop on the same code point as the output.
+*/
+int test__utf_boundary_run(const char* pTestName, test_utf_boundary_proc proc, const test_utf_units* pInput, md_uint32 inputUnitSize, md_bool32 isInputSwapped, const test_utf_units* pExpected, md_uint32 outputUnitSize, md_bool32 isOutputSwapped, md_bool32 nullTerminated)
+{
+    md_result result;
+    void* pInputData;
+    md_uint8 output[(TEST_UTF_BOUNDARY_UNITS + TEST_UTF_BOUNDARY_GUARD) * 4];
+    size_t outputLen;
+    size_t inputLenProcessed;
+    size_t cap;
+    size_t i;
+    int errorCount = 0;
+
+    /* The input is allocated at exactly the right size so that any over-read is caught by the address sanitizer. */
+    pInputData = MD_MALLOC((pInput->len + (nullTerminated ? 1 : 0)) * inputUnitSize);
+    if (pInputData == NULL) {
+        return MD_OUT_OF_MEMORY;
+    }
+
+    for (i = 0; i < pInput->len; i += 1) {
+        test__utf_set_unit(pInputData, inputUnitSize, isInputSwapped, i, pInput->units[i]);
+    }
+
+    if (nullTerminated) {
+        test__utf_set_unit(pInputData, inputUnitSize, isInputSwapped, i, 0);
+    }
+
+    /* A null output buffer retrieves the length. */
+    result = proc(NULL, 0, &outputLen, pInputData, (nullTerminated) ? (size_t)-1 : pInput->len, NULL);
+    if (result != MD_SUCCESS || outputLen != pExpected->len) {
+        print_error("%s: Wrong length (%s).\n", pTestName, (nullTerminated) ? "null terminated" : "fixed length");
+        errorCount += 1;
+    }
+
+    for (cap = 1; cap <= pExpected->len + 1 && errorCount == 0; cap += 1) {
+        memset(output, 0xAA, sizeof(output));
+
+        result = proc(output, cap, &outputLen, pInputData, (nullTerminated) ? (size_t)-1 : pInput->len, &inputLenProcessed);
+
+        if (cap > pExpected->len) {
+            if (result != MD_SUCCESS || outputLen != pExpected->len || inputLenProcessed != pInput->len) {
+                errorCount += 1;
+            }
+        } else {
+            if (result != MD_OUT_OF_MEMORY || outputLen > cap) {
+                errorCount += 1;
+            }
+        }
+
+        if (errorCount == 0) {
+            for (i = 0; i < outputLen; i += 1) {
+                if (test__utf_get_unit(output, outputUnitSize, isOutputSwapped, i) != pExpected->units[i]) {
+                    errorCount += 1;
+                    break;
+                }
+            }
+
+            if (outputLen < cap && test__utf_get_unit(output, outputUnitSize, isOutputSwapped, outputLen) != 0) {
+                errorCount += 1;    /* Not null terminated. */
+            }
+
+            for (i = cap * outputUnitSize; i < sizeof(output); i += 1) {
+                if (output[i] != 0xAA) {
+                    errorCount += 1;    /* Wrote past the end of the buffer. */
+                    break;
+                }
+            }
+
+            i = 0;
+            while (pExpected->offsets[i] != outputLen && pExpected->offsets[i] != pExpected->len) {
+                i += 1;
+            }
+
+            if (pExpected->offsets[i] != outputLen || inputLenProcessed != pInput->offsets[i]) {
+                errorCount += 1;
+            }
+        }
+
+        if (errorCount > 0) {
+            print_error("%s: Failed with an output capacity of %d (%s).\n", pTestName, (int)cap, (nullTerminated) ? "null terminated" : "fixed length");
+        }
+    }
+
+    MD_FREE(pInputData);
+
+    return (errorCount == 0) ? MD_SUCCESS : MD_ERROR;
+}
+
+int test__utf8_to_utf16ne_utf32ne_boundaries()
+{
+    static const md_utf32 codePoints[] = {0xE9, 0x4E2D, 0x1F600, TEST_UTF_INVALID_OCTET, TEST_UTF_STRAY_CONTINUATION, TEST_UTF_OVERLONG};
+    md_utf32 vector[TEST_UTF_BOUNDARY_MAX];
+    size_t vectorLen;
+    test_utf_units utf8;
+    test_utf_units utf16;
+    test_utf_units utf32;
+    char testName[256];
+    size_t iLength;
+    size_t iCodePoint;
+    size_t offset;
+    int isMixedRun;
+    int nullTerminated;
+
+    for (isMixedRun = 0; isMixedRun < 2; isMixedRun += 1) {
+        for (iLength = 0; iLength < MD_COUNTOF(g_utfBoundaryLengths); iLength += 1) {
+            for (iCodePoint = 0; iCodePoint < MD_COUNTOF(codePoints); iCodePoint += 1) {
+                for (offset = 0; offset <= g_utfBoundaryLengths[iLength]; offset += 1) {
+                    vectorLen = test__utf_boundary_code_points(vector, g_utfBoundaryLengths[iLength], isMixedRun, offset, codePoints[iCodePoint]);
+                    test__utf_encode_code_points(&utf8,  1, vector, vectorLen);
+                    test__utf_encode_code_points(&utf16, 2, vector, vectorLen);
+                    test__utf_encode_code_points(&utf32, 4, vector, vectorLen);
+
+                    for (nullTerminated = 0; nullTerminated < 2; nullTerminated += 1) {
+                        sprintf(testName, "test__utf8_to_utf16ne_utf32ne_boundaries: md_utf8_to_utf16ne() with U+%04X at %d of %d (%s run)", (unsigned int)codePoints[iCodePoint], (int)offset, (int)vectorLen, (isMixedRun) ? "mixed" : "ASCII");
+                        if (test__utf_boundary_run(testName, test__utf8_to_utf16ne_boundary_proc, &utf8, 1, MD_FALSE, &utf16, 2, MD_FALSE, nullTerminated) != MD_SUCCESS) {
+                            return MD_ERROR;
+                        }
+
+                        sprintf(testName, "test__utf8_to_utf16ne_utf32ne_boundaries: md_utf8_to_utf32ne() with U+%04X at %d of %d (%s run)", (unsigned int)codePoints[iCodePoint], (int)offset, (int)vectorLen, (isMixedRun) ? "mixed" : "ASCII");
+                        if (test__utf_boundary_run(testName, test__utf8_to_utf32ne_boundary_proc, &utf8, 1, MD_FALSE, &utf32, 4, MD_FALSE, nullTerminated) != MD_SUCCESS) {
+                            return MD_ERROR;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    return MD_SUCCESS;
+}
+
+typedef struct
+{
+    const char* pName;
+    test_utf_boundary_proc proc;
+    md_uint32 inputUnitSize;
+    md_uint32 outputUnitSize;
+    md_bool32 isBE;
+} test_utf_boundary_conversion;
+
+static const test_utf_boundary_conversion g_utfBoundaryConversions[] = {
+    {"md_utf16le_to_utf8()",    test__utf16le_to_utf8_boundary_proc,    2, 1, MD_FALSE},
+    {"md_utf16be_to_utf8()",    test__utf16be_to_utf8_boundary_proc,    2, 1, MD_TRUE },
+    {"md_utf32le_to_utf8()",    test__utf32le_to_utf8_boundary_proc,    4, 1, MD_FALSE},
+    {"md_utf32be_to_utf8()",    test__utf32be_to_utf8_boundary_proc,    4, 1, MD_TRUE },
+    {"md_utf32le_to_utf16le()", test__utf32le_to_utf16le_boundary_proc, 4, 2, MD_FALSE},
+    {"md_utf32be_to_utf16be()", test__utf32be_to_utf16be_boundary_proc, 4, 2, MD_TRUE }
+};
+
+int test__utf16_utf32_to_utf8_utf16_boundaries()
+{
+    static const md_utf32 codePoints[] = {0xE9, 0x4E2D, 0x1F600, TEST_UTF_LONE_SURROGATE};
+    md_utf32 vector[TEST_UTF_BOUNDARY_MAX];
+    size_t vectorLen;
+    test_utf_units input;
+    test_utf_units expected;
+    char testName[256];
+    size_t iConversion;
+    size_t iLength;
+    size_t iCodePoint;
+    size_t offset;
+    int isMixedRun;
+    int nullTerminated;
+
+    for (iConversion = 0; iConversion < MD_COUNTOF(g_utfBoundaryConversions); iConversion += 1) {
+        const test_utf_boundary_conversion* pConversion = &g_utfBoundaryConversions[iConversion];
+        md_bool32 isSwapped = test__utf_is_swapped(pConversion->isBE);
+
+        for (isMixedRun = 0; isMixedRun < 2; isMixedRun += 1) {
+            for (iLength = 0; iLength < MD_COUNTOF(g_utfBoundaryLengths); iLength += 1) {
+                for (iCodePoint = 0; iCodePoint < MD_COUNTOF(codePoints); iCodePoint += 1) {
+                    if (codePoints[iCodePoint] == TEST_UTF_LONE_SURROGATE && pConversion->inputUnitSize != 4) {
+                        continue;   /* A lone surrogate can only be represented in UTF-32. */
+                    }
+
+                    for (offset = 0; offset <= g_utfBoundaryLengths[iLength]; offset += 1) {
+                        vectorLen = test__utf_boundary_code_points(vector, g_utfBoundaryLengths[iLength], isMixedRun, offset, codePoints[iCodePoint]);
+                        test__utf_encode_code_points(&input,    pConversion->inputUnitSize,  vector, vectorLen);
+                        test__utf_encode_code_points(&expected, pConversion->outputUnitSize, vector, vectorLen);
+
+                        for (nullTerminated = 0; nullTerminated < 2; nullTerminated += 1) {
+                            sprintf(testName, "test__utf16_utf32_to_utf8_utf16_boundaries: %s with U+%04X at %d of %d (%s run)", pConversion->pName, (unsigned int)codePoints[iCodePoint], (int)offset, (int)vectorLen, (isMixedRun) ? "mixed" : "ASCII");
+                            if (test__utf_boundary_run(testName, pConversion->proc, &input, pConversion->inputUnitSize, isSwapped, &expected, pConversion->outputUnitSize, isSwapped, nullTerminated) != MD_SUCCESS) {
+                                return MD_ERROR;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    return MD_SUCCESS;
+}
+
+/*
+A counted swap must swap every unit, including those after an embedded U+0000, and must not touch anything
+past the count. The counts cover the vectorized body and the scalar tail.
+*/
+int test__utf_swap_endian_counted()
+{
+    md_utf16 utf16[34];
+    md_utf32 utf32[34];
+    size_t count;
+    size_t zeroIndex;
+    size_t i;
+
+    for (count = 1; count < MD_COUNTOF(utf16); count += 1) {
+        for (zeroIndex = 0; zeroIndex < count; zeroIndex += 1) {
+            for (i = 0; i < MD_COUNTOF(utf16); i += 1) {
+                utf16[i] = (i == zeroIndex) ? 0 : (md_utf16)(0x4E00 + i);
+                utf32[i] = (i == zeroIndex) ? 0 : (md_utf32)(0x1F600 + i);
+            }
+
+            md_swap_endian_utf16(utf16, count);
+            md_swap_endian_utf32(utf32, count);
+
+            for (i = 0; i < MD_COUNTOF(utf16); i += 1) {
+                md_utf16 expected16 = (i == zeroIndex) ? 0 : (md_utf16)(0x4E00 + i);
+                md_utf32 expected32 = (i == zeroIndex) ? 0 : (md_utf32)(0x1F600 + i);
+
+                if (i < count) {
+                    expected16 = md_swap_endian_uint16(expected16);
+                    expected32 = md_swap_endian_uint32(expected32);
+                }
+
+                if (utf16[i] != expected16) {
+                    print_error("test__utf_swap_endian_counted: md_swap_endian_utf16() failed at unit %d with a count of %d and U+0000 at %d.\n", (int)i, (int)count, (int)zeroIndex);
+                    return MD_ERROR;
+                }
+
+                if (utf32[i] != expected32) {
+                    print_error("test__utf_swap_endian_counted: md_swap_endian_utf32() failed at unit %d with a count of %d and U+0000 at %d.\n", (int)i, (int)count, (int)zeroIndex);
+                    return MD_ERROR;
+                }
+            }
+        }
+    }
+
+    return MD_SUCCESS;
+}
+
+/*
+The UTF-8 to UTF-16/32 LE and BE conversions convert to native endian and then do a counted swap. A fixed
+length input with an embedded U+0000 must come out with every unit in the requested byte order.
+*/
+int test__utf8_to_utf16_utf32_embedded_null()
+{
+    md_utf32 vector[TEST_UTF_BOUNDARY_MAX];
+    size_t vectorLen;
+    test_utf_units utf8;
+    test_utf_units utf16;
+    test_utf_units utf32;
+    md_utf8 input[TEST_UTF_BOUNDARY_MAX];
+    md_utf16 output16[TEST_UTF_BOUNDARY_MAX + 1];
+    md_utf32 output32[TEST_UTF_BOUNDARY_MAX + 1];
+    size_t outputLen;
+    size_t utf8LenProcessed;
+    size_t iLength;
+    size_t offset;
+    size_t i;
+    int isBE;
+
+    for (iLength = 0; iLength < MD_COUNTOF(g_utfBoundaryLengths); iLength += 1) {
+        for (offset = 0; offset <= g_utfBoundaryLengths[iLength]; offset += 1) {
+            vectorLen = test__utf_boundary_code_points(vector, g_utfBoundaryLengths[iLength], MD_FALSE, offset, 0);
+            test__utf_encode_code_points(&utf8,  1, vector, vectorLen);
+            test__utf_encode_code_points(&utf16, 2, vector, vectorLen);
+            test__utf_encode_code_points(&utf32, 4, vector, vectorLen);
+
+            for (i = 0; i < utf8.len; i += 1) {
+                input[i] = (md_utf8)utf8.units[i];
+            }
+
+            for (isBE = 0; isBE < 2; isBE += 1) {
+                md_result result16;
+                md_result result32;
+                md_bool32 isSwapped = test__utf_is_swapped(isBE);
+                int errorCount = 0;
+
+                if (isBE) {
+                    result16 = md_utf8_to_utf16be(output16, MD_COUNTOF(output16), &outputLen, input, utf8.len, &utf8LenProcessed, 0);
+                } else {
+                    result16 = md_utf8_to_utf16le(output16, MD_COUNTOF(output16), &outputLen, input, utf8.len, &utf8LenProcessed, 0);
+                }
+
+                if (result16 != MD_SUCCESS || outputLen != utf16.len || utf8LenProcessed != utf8.len) {
+                    errorCount += 1;
+                } else {
+                    for (i = 0; i <= utf16.len; i += 1) {
+                        if (test__utf_get_unit(output16, 2, isSwapped, i) != ((i < utf16.len) ? utf16.units[i] : 0)) {
+                            errorCount += 1;
+                        }
+                    }
+                }
+
+                if (isBE) {
+                    result32 = md_utf8_to_utf32be(output32, MD_COUNTOF(output32), &outputLen, input, utf8.len, &utf8LenProcessed, 0);
+                } else {
+                    result32 = md_utf8_to_utf32le(output32, MD_COUNTOF(output32), &outputLen, input, utf8.len, &utf8LenProcessed, 0);
+                }
+
+                if (result32 != MD_SUCCESS || outputLen != utf32.len || utf8LenProcessed != utf8.len) {
+                    errorCount += 1;
+                } else {
+                    for (i = 0; i <= utf32.len; i += 1) {
+                        if (test__utf_get_unit(output32, 4, isSwapped, i) != ((i < utf32.len) ? utf32.units[i] : 0)) {
+                            errorCount += 1;
+                        }
+                    }
+                }
+
+                if (errorCount > 0) {
+                    print_error("test__utf8_to_utf16_utf32_embedded_null: Failed with U+0000 at %d of %d (%s).\n", (int)offset, (int)vectorLen, (isBE) ? "big endian" : "little endian");
+                    return MD_ERROR;
+                }
+            }
+        }
+    }
+
+    return MD_SUCCESS;
+}
+
+/*
+A high surrogate in the last code unit of a fixed length string has no pair. The conversion must stop
+before it with MD_INVALID_ARGS without reading the unit after it, which the address sanitizer catches
+because the input is allocated at exactly the right size.
+*/
+int test__utf16_truncated_surrogate_pair()
+{
+    md_utf16* pInput;
+    md_utf8 output8[TEST_UTF_BOUNDARY_MAX + 1];
+    md_utf32 output32[TEST_UTF_BOUNDARY_MAX + 1];
+    md_result result8;
+    md_result result32;
+    md_result resultLength8;
+    md_result resultLength32;
+    size_t outputLen8;
+    size_t outputLen32;
+    size_t lengthLen;
+    size_t utf16LenProcessed8;
+    size_t utf16LenProcessed32;
+    size_t iLength;
+    size_t len;
+    size_t i;
+    int isBE;
+
+    for (iLength = 0; iLength < MD_COUNTOF(g_utfBoundaryLengths); iLength += 1) {
+        len = g_utfBoundaryLengths[iLength];
+
+        pInput = (md_utf16*)MD_MALLOC((len + 1) * sizeof(md_utf16));
+        if (pInput == NULL) {
+            return MD_OUT_OF_MEMORY;
+        }
+
+        for (isBE = 0; isBE < 2; isBE += 1) {
+            md_bool32 isSwapped = test__utf_is_swapped(isBE);
+
+            for (i = 0; i < len; i += 1) {
+                test__utf_set_unit(pInput, 2, isSwapped, i, 'a' + (i % 26));
+            }
+            test__utf_set_unit(pInput, 2, isSwapped, len, 0xD83D);
+
+            if (isBE) {
+                result8        = md_utf16be_to_utf8(output8, MD_COUNTOF(output8), &outputLen8, pInput, len + 1, &utf16LenProcessed8, 0);
+                result32       = md_utf16be_to_utf32be(output32, MD_COUNTOF(output32), &outputLen32, pInput, len + 1, &utf16LenProcessed32, 0);
+                resultLength8  = md_utf16be_to_utf8(NULL, 0, &lengthLen, pInput, len + 1, NULL, 0);
+                resultLength32 = md_utf16be_to_utf32be(NULL, 0, &lengthLen, pInput, len + 1, NULL, 0);
+            } else {
+                result8        = md_utf16le_to_utf8(output8, MD_COUNTOF(output8), &outputLen8, pInput, len + 1, &utf16LenProcessed8, 0);
+                result32       = md_utf16le_to_utf32le(output32, MD_COUNTOF(output32), &outputLen32, pInput, len + 1, &utf16LenProcessed32, 0);
+                resultLength8  = md_utf16le_to_utf8(NULL, 0, &lengthLen, pInput, len + 1, NULL, 0);
+                resultLength32 = md_utf16le_to_utf32le(NULL, 0, &lengthLen, pInput, len + 1, NULL, 0);
+            }
+
+            if (result8 != MD_INVALID_ARGS || outputLen8 != len || utf16LenProcessed8 != len || memcmp(output8, "abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz", len) != 0 ||
+                result32 != MD_INVALID_ARGS || outputLen32 != len || utf16LenProcessed32 != len ||
+                resultLength8 != MD_INVALID_ARGS || resultLength32 != MD_INVALID_ARGS) {
+                print_error("test__utf16_truncated_surrogate_pair: Failed with a high surrogate at %d (%s).\n", (int)len, (isBE) ? "big endian" : "little endian");
+                MD_FREE(pInput);
+                return MD_ERROR;
+            }
+        }
+
+        MD_FREE(pInput);
+    }
+
+    return MD_SUCCESS;
+}
+
 
 int test__utf_conversion()
 {
@@ -757,18 +1366,2466 @@ int test__utf_conversion()
         return result;
     }
 
+    /* UTF-8 -> UTF-16/32 across the boundaries of the vectorized path. */
+    result = test__utf8_to_utf16ne_utf32ne_boundaries();
+    if (result != 0) {
+        return result;
+    }
+
+    /* UTF-16/32 -> UTF-8 and UTF-32 -> UTF-16 across the boundaries of the vectorized path, in both byte orders. */
+    result = test__utf16_utf32_to_utf8_utf16_boundaries();
+    if (result != 0) {
+        return result;
+    }
+
+    /* Counted byte swaps with an embedded U+0000. */
+    result = test__utf_swap_endian_counted();
+    if (result != 0) {
+        return result;
+    }
+
+    result = test__utf8_to_utf16_utf32_embedded_null();
+    if (result != 0) {
+        return result;
+    }
+
+    result = test__utf16_truncated_surrogate_pair();
+    if (result != 0) {
+        return result;
+    }
+
     return 0;
 }
 
 
-int main(int argc, char** argv)
+/******************************************************************************
+
+Software Backend
+
+******************************************************************************/
+/*
+The software backend is the only one that can run without a window system, so these tests check exact pixel values. Surfaces start out cleared
+to zero and pixels are read back with md_gc_get_image_data() as premultiplied RGBA.
+*/
+#define TEST_SOFTWARE_SIZE  32
+
+typedef struct
 {
-    /* UTF Conversion */
-    test__utf_conversion();
+    md_api api;
+    md_gc gc;
+    md_uint8 pixels[TEST_SOFTWARE_SIZE*TEST_SOFTWARE_SIZE*4];
+} test_software_context;
 
+md_result test__software_init(test_software_context* pContext)
+{
+    md_result result;
+    md_api_config apiConfig;
+    md_gc_config gcConfig;
 
+    MD_ZERO_OBJECT(&apiConfig);
+    apiConfig.backend = md_backend_software;
 
-    (void)argc;
-    (void)argv;
-    return 0;
+    result = md_init(&apiConfig, &pContext->api);
+    if (result != MD_SUCCESS) {
+        print_error("test__software_init: md_init() failed.\n");
+        return result;
+    }
+
+    MD_ZERO_OBJECT(&gcConfig);
+    gcConfig.sizeX  = TEST_SOFTWARE_SIZE;
+    gcConfig.sizeY  = TEST_SOFTWARE_SIZE;
+    gcConfig.format = md_format_rgba;
+
+    result = md_gc_init(&pContext->api, &gcConfig, &pContext->gc);
+    if (result != MD_SUCCESS) {
+        md_uninit(&pContext->api);
+        print_error("test__software_init: md_gc_init() failed.\n");
+        return result;
+    }
+
+    return MD_SUCCESS;
+}
+
+void test__software_uninit(test_software_context* pContext)
+{
+    md_gc_uninit(&pContext->gc);
+    md_uninit(&pContext->api);
+}
+
+/* md_gc_clear() blends over the top of the existing contents so it can't be used to go back to transparent. This relies on the default blend op. */
+void test__software_reset(test_software_context* pContext)
+{
+    md_gc_set_fill_brush_solid(&pContext->gc, md_rgba(0, 0, 0, 0));
+    md_gc_rectangle(&pContext->gc, 0, 0, TEST_SOFTWARE_SIZE, TEST_SOFTWARE_SIZE);
+    md_gc_fill(&pContext->gc);
+}
+
+const md_uint8* test__software_pixel(test_software_context* pContext, md_uint32 x, md_uint32 y)
+{
+    return pContext->pixels + ((y * TEST_SOFTWARE_SIZE) + x) * 4;
+}
+
+md_result test__software_read_pixels(test_software_context* pContext)
+{
+    return md_gc_get_image_data(&pContext->gc, md_format_rgba, pContext->pixels);
+}
+
+md_bool32 test__software_check_pixel(test_software_context* pContext, const char* pTestName, md_uint32 x, md_uint32 y, md_uint8 r, md_uint8 g, md_uint8 b, md_uint8 a)
+{
+    const md_uint8* pPixel = test__software_pixel(pContext, x, y);
+    if (pPixel[0] != r || pPixel[1] != g || pPixel[2] != b || pPixel[3] != a) {
+        print_error("%s: Pixel (%d, %d) is (%d, %d, %d, %d). Expected (%d, %d, %d, %d).\n", pTestName, (int)x, (int)y, pPixel[0], pPixel[1], pPixel[2], pPixel[3], r, g, b, a);
+        return MD_FALSE;
+    }
+
+    return MD_TRUE;
+}
+
+md_bool32 test__software_check_alpha(test_software_context* pContext, const char* pTestName, md_uint32 x, md_uint32 y, md_uint8 alphaMin, md_uint8 alphaMax)
+{
+    md_uint8 a = test__software_pixel(pContext, x, y)[3];
+    if (a < alphaMin || a > alphaMax) {
+        print_error("%s: Pixel (%d, %d) has an alpha of %d. Expected [%d, %d].\n", pTestName, (int)x, (int)y, a, alphaMin, alphaMax);
+        return MD_FALSE;
+    }
+
+    return MD_TRUE;
+}
+
+int test__software_fill_rect()
+{
+    md_result result;
+    test_software_context context;
+    md_uint32 x;
+    md_uint32 y;
+
+    result = test__software_init(&context);
+    if (result != MD_SUCCESS) {
+        return result;
+    }
+
+    md_gc_clear(&context.gc, md_rgb(255, 255, 255));
+    md_gc_set_fill_brush_solid(&context.gc, md_rgb(255, 0, 0));
+    md_gc_rectangle(&context.gc, 4, 6, 20, 10);
+    md_gc_fill(&context.gc);
+
+    /* An empty path should not touch anything. */
+    md_gc_fill(&context.gc);
+    md_gc_rectangle(&context.gc, 8, 8, 8, 20);
+    md_gc_fill(&context.gc);
+
+    test__software_read_pixels(&context);
+
+    for (y = 0; y < TEST_SOFTWARE_SIZE; y += 1) {
+        for (x = 0; x < TEST_SOFTWARE_SIZE; x += 1) {
+            if (x >= 4 && x < 20 && y >= 6 && y < 10) {
+                if (!test__software_check_pixel(&context, "test__software_fill_rect", x, y, 255, 0, 0, 255)) { result = MD_ERROR; goto done; }
+            } else {
+                if (!test__software_check_pixel(&context, "test__software_fill_rect", x, y, 255, 255, 255, 255)) { result = MD_ERROR; goto done; }
+            }
+        }
+    }
+
+done:
+    test__software_uninit(&context);
+    return result;
+}
+
+int test__software_antialiasing()
+{
+    md_result result;
+    test_software_context context;
+    md_uint32 x;
+    md_uint32 y;
+
+    result = test__software_init(&context);
+    if (result != MD_SUCCESS) {
+        return result;
+    }
+
+    /* A right triangle whose hypotenuse cuts each pixel along the diagonal exactly in half. */
+    md_gc_set_fill_brush_solid(&context.gc, md_rgb(255, 255, 255));
+    md_gc_move_to(&context.gc,  0,  0);
+    md_gc_line_to(&context.gc, 16,  0);
+    md_gc_line_to(&context.gc,  0, 16);
+    md_gc_close_path(&context.gc);
+    md_gc_fill(&context.gc);
+
+    test__software_read_pixels(&context);
+
+    for (y = 0; y < 16; y += 1) {
+        for (x = 0; x < 16; x += 1) {
+            if (x + y < 15) {
+                if (!test__software_check_pixel(&context, "test__software_antialiasing", x, y, 255, 255, 255, 255)) { result = MD_ERROR; goto done; }
+            } else if (x + y == 15) {
+                if (!test__software_check_pixel(&context, "test__software_antialiasing", x, y, 128, 128, 128, 128)) { result = MD_ERROR; goto done; }
+            } else {
+                if (!test__software_check_pixel(&context, "test__software_antialiasing", x, y, 0, 0, 0, 0)) { result = MD_ERROR; goto done; }
+            }
+        }
+    }
+
+    /* With anti-aliasing disabled the diagonal should be either fully in or fully out. */
+    test__software_reset(&context);
+    md_gc_set_antialias_mode(&context.gc, md_antialias_mode_none);
+    md_gc_set_fill_brush_solid(&context.gc, md_rgb(255, 255, 255));
+    md_gc_move_to(&context.gc,  0,  0);
+    md_gc_line_to(&context.gc, 16,  0);
+    md_gc_line_to(&context.gc,  0, 16);
+    md_gc_close_path(&context.gc);
+    md_gc_fill(&context.gc);
+
+    test__software_read_pixels(&context);
+
+    for (y = 0; y < 16; y += 1) {
+        for (x = 0; x < 16; x += 1) {
+            md_uint8 a = test__software_pixel(&context, x, y)[3];
+            if (a != 0 && a != 255) {
+                result = MD_ERROR;
+                print_error("test__software_antialiasing: Pixel (%d, %d) has an alpha of %d with anti-aliasing disabled.\n", (int)x, (int)y, a);
+                goto done;
+            }
+        }
+    }
+
+done:
+    test__software_uninit(&context);
+    return result;
+}
+
+int test__software_stroke_caps_and_joins()
+{
+    md_result result;
+    test_software_context context;
+    md_uint8 roundJoinAlpha;
+
+    result = test__software_init(&context);
+    if (result != MD_SUCCESS) {
+        return result;
+    }
+
+    md_gc_set_line_width(&context.gc, 4);
+    md_gc_set_line_brush_solid(&context.gc, md_rgb(255, 255, 255));
+
+    /*
+    Caps. A horizontal line from x = 8 to x = 24 covering y = [6, 10). The flat cap ends at x = 8. The square cap extends to x = 6. The round cap is a
+    half circle of radius 2 centered on (8, 8).
+    */
+    md_gc_set_line_cap(&context.gc, md_line_cap_flat);
+    md_gc_move_to(&context.gc,  8, 8);
+    md_gc_line_to(&context.gc, 24, 8);
+    md_gc_stroke(&context.gc);
+    test__software_read_pixels(&context);
+    if (!test__software_check_alpha(&context, "test__software_stroke_caps_and_joins (flat cap)",  8, 7, 255, 255) ||
+        !test__software_check_alpha(&context, "test__software_stroke_caps_and_joins (flat cap)",  7, 7,   0,   0) ||
+        !test__software_check_alpha(&context, "test__software_stroke_caps_and_joins (flat cap)",  8, 5,   0,   0) ||
+        !test__software_check_alpha(&context, "test__software_stroke_caps_and_joins (flat cap)", 23, 9, 255, 255)) {
+        result = MD_ERROR;
+        goto done;
+    }
+
+    test__software_reset(&context);
+    md_gc_set_line_cap(&context.gc, md_line_cap_square);
+    md_gc_move_to(&context.gc,  8, 8);
+    md_gc_line_to(&context.gc, 24, 8);
+    md_gc_stroke(&context.gc);
+    test__software_read_pixels(&context);
+    if (!test__software_check_alpha(&context, "test__software_stroke_caps_and_joins (square cap)", 6, 6, 255, 255) ||
+        !test__software_check_alpha(&context, "test__software_stroke_caps_and_joins (square cap)", 7, 9, 255, 255) ||
+        !test__software_check_alpha(&context, "test__software_stroke_caps_and_joins (square cap)", 5, 7,   0,   0)) {
+        result = MD_ERROR;
+        goto done;
+    }
+
+    test__software_reset(&context);
+    md_gc_set_line_cap(&context.gc, md_line_cap_round);
+    md_gc_move_to(&context.gc,  8, 8);
+    md_gc_line_to(&context.gc, 24, 8);
+    md_gc_stroke(&context.gc);
+    test__software_read_pixels(&context);
+    if (!test__software_check_alpha(&context, "test__software_stroke_caps_and_joins (round cap)", 7, 7, 200, 255) ||    /* Mostly inside the circle. */
+        !test__software_check_alpha(&context, "test__software_stroke_caps_and_joins (round cap)", 6, 6,   1, 128) ||    /* The circle only clips the corner. */
+        !test__software_check_alpha(&context, "test__software_stroke_caps_and_joins (round cap)", 5, 7,   0,   0)) {
+        result = MD_ERROR;
+        goto done;
+    }
+
+    /*
+    Joins. A right angle turning down at (20, 8). The outer corner of the join is the 2x2 block of pixels at [20, 22) x [6, 8). The miter fills it, the
+    bevel cuts it along the diagonal and the round join is in between.
+    */
+    md_gc_set_line_cap(&context.gc, md_line_cap_flat);
+
+    test__software_reset(&context);
+    md_gc_set_line_join(&context.gc, md_line_join_miter);
+    md_gc_move_to(&context.gc,  8,  8);
+    md_gc_line_to(&context.gc, 20,  8);
+    md_gc_line_to(&context.gc, 20, 24);
+    md_gc_stroke(&context.gc);
+    test__software_read_pixels(&context);
+    if (!test__software_check_alpha(&context, "test__software_stroke_caps_and_joins (miter join)", 21, 6, 255, 255) ||
+        !test__software_check_alpha(&context, "test__software_stroke_caps_and_joins (miter join)", 22, 6,   0,   0)) {
+        result = MD_ERROR;
+        goto done;
+    }
+
+    test__software_reset(&context);
+    md_gc_set_line_join(&context.gc, md_line_join_bevel);
+    md_gc_move_to(&context.gc,  8,  8);
+    md_gc_line_to(&context.gc, 20,  8);
+    md_gc_line_to(&context.gc, 20, 24);
+    md_gc_stroke(&context.gc);
+    test__software_read_pixels(&context);
+    if (!test__software_check_alpha(&context, "test__software_stroke_caps_and_joins (bevel join)", 21, 6,   0,   0) ||
+        !test__software_check_alpha(&context, "test__software_stroke_caps_and_joins (bevel join)", 20, 6, 127, 128) ||
+        !test__software_check_alpha(&context, "test__software_stroke_caps_and_joins (bevel join)", 20, 7, 255, 255)) {
+        result = MD_ERROR;
+        goto done;
+    }
+
+    test__software_reset(&context);
+    md_gc_set_line_join(&context.gc, md_line_join_round);
+    md_gc_move_to(&context.gc,  8,  8);
+    md_gc_line_to(&context.gc, 20,  8);
+    md_gc_line_to(&context.gc, 20, 24);
+    md_gc_stroke(&context.gc);
+    test__software_read_pixels(&context);
+    roundJoinAlpha = test__software_pixel(&context, 21, 6)[3];
+    if (roundJoinAlpha == 0 || roundJoinAlpha == 255) {
+        result = MD_ERROR;
+        print_error("test__software_stroke_caps_and_joins (round join): Pixel (21, 6) has an alpha of %d. Expected partial coverage.\n", roundJoinAlpha);
+        goto done;
+    }
+
+done:
+    test__software_uninit(&context);
+    return result;
+}
+
+int test__software_clip()
+{
+    md_result result;
+    test_software_context context;
+    md_uint32 x;
+    md_uint32 y;
+
+    result = test__software_init(&context);
+    if (result != MD_SUCCESS) {
+        return result;
+    }
+
+    md_gc_save(&context.gc);
+    {
+        md_gc_rectangle(&context.gc, 5, 3, 17, 29);
+        md_gc_clip(&context.gc);
+
+        md_gc_set_fill_brush_solid(&context.gc, md_rgb(0, 255, 0));
+        md_gc_rectangle(&context.gc, 0, 0, TEST_SOFTWARE_SIZE, TEST_SOFTWARE_SIZE);
+        md_gc_fill(&context.gc);
+    }
+    md_gc_restore(&context.gc);
+
+    /* Restoring should remove the clip. */
+    md_gc_set_fill_brush_solid(&context.gc, md_rgb(0, 0, 255));
+    md_gc_rectangle(&context.gc, 0, 30, TEST_SOFTWARE_SIZE, TEST_SOFTWARE_SIZE);
+    md_gc_fill(&context.gc);
+
+    test__software_read_pixels(&context);
+
+    for (y = 0; y < TEST_SOFTWARE_SIZE; y += 1) {
+        for (x = 0; x < TEST_SOFTWARE_SIZE; x += 1) {
+            md_bool32 passed;
+            if (y >= 30) {
+                passed = test__software_check_pixel(&context, "test__software_clip", x, y, 0, 0, 255, 255);
+            } else if (x >= 5 && x < 17 && y >= 3 && y < 29) {
+                passed = test__software_check_pixel(&context, "test__software_clip", x, y, 0, 255, 0, 255);
+            } else {
+                passed = test__software_check_pixel(&context, "test__software_clip", x, y, 0, 0, 0, 0);
+            }
+
+            if (!passed) {
+                result = MD_ERROR;
+                goto done;
+            }
+        }
+    }
+
+done:
+    test__software_uninit(&context);
+    return result;
+}
+
+int test__software_gradient()
+{
+    md_result result;
+    test_software_context context;
+    md_color_stop stops[2];
+    md_brush_config brushConfig;
+    md_brush brush;
+    md_uint32 y;
+
+    result = test__software_init(&context);
+    if (result != MD_SUCCESS) {
+        return result;
+    }
+
+    stops[0].offset = 0;
+    stops[0].color  = md_rgb(255, 0, 0);
+    stops[1].offset = 1;
+    stops[1].color  = md_rgb(0, 0, 255);
+
+    MD_ZERO_OBJECT(&brushConfig);
+    brushConfig.type           = md_brush_type_linear;
+    brushConfig.pColorStops    = stops;
+    brushConfig.colorStopCount = 2;
+    brushConfig.linear.x0      = 8;
+    brushConfig.linear.y0      = 0;
+    brushConfig.linear.x1      = 24;
+    brushConfig.linear.y1      = 0;
+
+    result = md_brush_init(&context.api, &brushConfig, &brush);
+    if (result != MD_SUCCESS) {
+        print_error("test__software_gradient: md_brush_init() failed.\n");
+        goto done;
+    }
+
+    md_gc_set_fill_brush(&context.gc, &brush);
+    md_gc_rectangle(&context.gc, 0, 0, TEST_SOFTWARE_SIZE, TEST_SOFTWARE_SIZE);
+    md_gc_fill(&context.gc);
+    md_gc_set_fill_brush_solid(&context.gc, md_rgb(0, 0, 0));  /* Release the brush before uninitializing it. */
+    md_brush_uninit(&brush);
+
+    test__software_read_pixels(&context);
+
+    /* Everything before the start point and after the end point should be the color of the first and last stop respectively. */
+    for (y = 0; y < TEST_SOFTWARE_SIZE; y += 1) {
+        if (!test__software_check_pixel(&context, "test__software_gradient",  0, y, 255, 0,   0, 255) ||
+            !test__software_check_pixel(&context, "test__software_gradient",  7, y, 255, 0,   0, 255) ||
+            !test__software_check_pixel(&context, "test__software_gradient", 24, y,   0, 0, 255, 255) ||
+            !test__software_check_pixel(&context, "test__software_gradient", 31, y,   0, 0, 255, 255)) {
+            result = MD_ERROR;
+            goto done;
+        }
+    }
+
+    /* The middle should be roughly half way. */
+    if (!test__software_check_alpha(&context, "test__software_gradient", 16, 0, 255, 255) || test__software_pixel(&context, 16, 0)[0] < 112 || test__software_pixel(&context, 16, 0)[0] > 144) {
+        result = MD_ERROR;
+        print_error("test__software_gradient: Pixel (16, 0) is not half way between the two stops.\n");
+        goto done;
+    }
+
+done:
+    test__software_uninit(&context);
+    return result;
+}
+
+void test__software_draw_scene(md_gc* pGC)
+{
+    md_uint32 i;
+
+    md_gc_clear(pGC, md_rgb(255, 255, 255));
+
+    md_gc_set_fill_brush_solid(pGC, md_rgba(255, 0, 0, 192));
+    md_gc_arc(pGC, 40, 40, 30, 0, 6.2831853f);
+    md_gc_fill(pGC);
+
+    md_gc_set_line_width(pGC, 5);
+    md_gc_set_line_join(pGC, md_line_join_round);
+    md_gc_set_line_brush_solid(pGC, md_rgba(0, 128, 0, 160));
+    md_gc_move_to(pGC, 3, 90);
+    for (i = 0; i < 12; i += 1) {
+        md_gc_line_to(pGC, 10 + i*9, (i & 1) ? 70 : 120);
+    }
+    md_gc_stroke(pGC);
+
+    md_gc_save(pGC);
+    {
+        md_gc_translate(pGC, 80, 40);
+        md_gc_rotate(pGC, 0.4f);
+        md_gc_rectangle(pGC, -25, -25, 25, 25);
+        md_gc_clip(pGC);
+
+        md_gc_set_fill_brush_solid(pGC, md_rgba(0, 0, 255, 128));
+        md_gc_rectangle(pGC, -60, -8, 60, 8);
+        md_gc_fill(pGC);
+    }
+    md_gc_restore(pGC);
+}
+
+int test__software_multithreaded()
+{
+    md_result result;
+    md_api api;
+    md_api_config apiConfig;
+    md_gc gc[2];
+    md_gc_config gcConfig;
+    md_uint8* pPixels[2] = {NULL, NULL};
+    md_uint32 sizeX = 128;
+    md_uint32 sizeY = 128;
+    md_uint32 iGC;
+    size_t i;
+
+    MD_ZERO_OBJECT(&apiConfig);
+    apiConfig.backend = md_backend_software;
+
+    result = md_init(&apiConfig, &api);
+    if (result != MD_SUCCESS) {
+        print_error("test__software_multithreaded: md_init() failed.\n");
+        return result;
+    }
+
+    for (iGC = 0; iGC < 2; iGC += 1) {
+        MD_ZERO_OBJECT(&gcConfig);
+        gcConfig.sizeX                = sizeX;
+        gcConfig.sizeY                = sizeY;
+        gcConfig.format               = md_format_rgba;
+        gcConfig.software.threadCount = (iGC == 0) ? 1 : 4;
+        gcConfig.software.tileSize    = 16;
+
+        result = md_gc_init(&api, &gcConfig, &gc[iGC]);
+        if (result != MD_SUCCESS) {
+            print_error("test__software_multithreaded: md_gc_init() failed.\n");
+            while (iGC > 0) {
+                iGC -= 1;
+                md_gc_uninit(&gc[iGC]);
+            }
+            md_uninit(&api);
+            return result;
+        }
+    }
+
+    for (iGC = 0; iGC < 2; iGC += 1) {
+        test__software_draw_scene(&gc[iGC]);
+
+        pPixels[iGC] = (md_uint8*)MD_MALLOC(sizeX * sizeY * 4);
+        if (pPixels[iGC] == NULL) {
+            result = MD_OUT_OF_MEMORY;
+            goto done;
+        }
+
+        md_gc_get_image_data(&gc[iGC], md_format_rgba, pPixels[iGC]);
+    }
+
+    for (i = 0; i < sizeX * sizeY * 4; i += 1) {
+        if (pPixels[0][i] != pPixels[1][i]) {
+            result = MD_ERROR;
+            print_error("test__software_multithreaded: Multithreaded output differs from single threaded output at pixel (%d, %d).\n", (int)((i/4) % sizeX), (int)((i/4) / sizeX));
+            goto done;
+        }
+    }
+
+done:
+    MD_FREE(pPixels[0]);
+    MD_FREE(pPixels[1]);
+    md_gc_uninit(&gc[0]);
+    md_gc_uninit(&gc[1]);
+    md_uninit(&api);
+    return result;
+}
+
+int test__software()
+{
+    int result = 0;
+
+    result = test__software_fill_rect();
+    if (result != 0) {
+        return result;
+    }
+
+    result = test__software_antialiasing();
+    if (result != 0) {
+        return result;
+    }
+
+    result = test__software_stroke_caps_and_joins();
+    if (result != 0) {
+        return result;
+    }
+
+    result = test__software_clip();
+    if (result != 0) {
+        return result;
+    }
+
+    result = test__software_gradient();
+    if (result != 0) {
+        return result;
+    }
+
+    result = test__software_multithreaded();
+    if (result != 0) {
+        return result;
+    }
+
+    return 0;
+}
+
+
+/******************************************************************************
+
+Text
+
+******************************************************************************/
+/* The text tests use the software backend's built-in font so that they're not affected by the fonts installed on the system. */
+/* The font every text test uses. Tests that need a different font configuration start from this. */
+void test__text_font_config_init(md_font_config* pFontConfig)
+{
+    MD_ZERO_OBJECT(pFontConfig);
+    pFontConfig->family       = "monospace";
+    pFontConfig->sizeInPixels = 8;
+}
+
+md_result test__text_init_with_config(md_api* pAPI, const md_font_config* pFontConfig, md_font* pFont)
+{
+    md_result result;
+    md_api_config apiConfig;
+
+    MD_ZERO_OBJECT(&apiConfig);
+    apiConfig.backend = md_backend_software;
+
+    result = md_init(&apiConfig, pAPI);
+    if (result != MD_SUCCESS) {
+        print_error("test__text_init: md_init() failed.\n");
+        return result;
+    }
+
+    result = md_font_init(pAPI, pFontConfig, pFont);
+    if (result != MD_SUCCESS) {
+        md_uninit(pAPI);
+        print_error("test__text_init: md_font_init() failed.\n");
+        return result;
+    }
+
+    return MD_SUCCESS;
+}
+
+md_result test__text_init(md_api* pAPI, md_font* pFont)
+{
+    md_font_config fontConfig;
+
+    test__text_font_config_init(&fontConfig);
+
+    return test__text_init_with_config(pAPI, &fontConfig, pFont);
+}
+
+void test__text_uninit(md_api* pAPI, md_font* pFont)
+{
+    md_font_uninit(pFont);
+    md_uninit(pAPI);
+}
+
+
+/*
+Checks that a block that has been edited is laid out exactly the same as a block that was created from scratch with the same text.
+*/
+int test__text_block_compare(md_text_block* pEdited, const char* pTestName)
+{
+    md_result result;
+    md_text_block fresh;
+    md_text_metrics editedMetrics;
+    md_text_metrics freshMetrics;
+    const md_utf8* pText;
+    size_t textLength;
+    size_t iParagraph;
+    size_t iRun;
+    size_t cp;
+
+    pText = md_text_block_get_text_utf8(pEdited, &textLength);
+
+    result = md_text_block_init(pEdited->pFont, pText, textLength, &pEdited->layout, &fresh);
+    if (result != MD_SUCCESS) {
+        print_error("%s: md_text_block_init() failed.\n", pTestName);
+        return result;
+    }
+
+    /* Metrics forces the layout to be done. */
+    md_text_block_get_text_metrics(pEdited, &editedMetrics);
+    md_text_block_get_text_metrics(&fresh,  &freshMetrics);
+
+    if (editedMetrics.sizeX != freshMetrics.sizeX || editedMetrics.sizeY != freshMetrics.sizeY) {
+        result = MD_ERROR;
+        print_error("%s: Metrics differ. Edited %dx%d. Expected %dx%d.\n", pTestName, editedMetrics.sizeX, editedMetrics.sizeY, freshMetrics.sizeX, freshMetrics.sizeY);
+        goto done;
+    }
+
+    if (pEdited->paragraphCount != fresh.paragraphCount) {
+        result = MD_ERROR;
+        print_error("%s: Paragraph count is %d. Expected %d.\n", pTestName, (int)pEdited->paragraphCount, (int)fresh.paragraphCount);
+        goto done;
+    }
+
+    for (iParagraph = 0; iParagraph < fresh.paragraphCount; iParagraph += 1) {
+        const md_text_block_paragraph* pEditedParagraph = &pEdited->pParagraphs[iParagraph];
+        const md_text_block_paragraph* pFreshParagraph  = &fresh.pParagraphs[iParagraph];
+
+        if (pEditedParagraph->textOffset != pFreshParagraph->textOffset || pEditedParagraph->textLength != pFreshParagraph->textLength || pEditedParagraph->posY != pFreshParagraph->posY) {
+            result = MD_ERROR;
+            print_error("%s: Paragraph %d is at [%d, %d) y=%d. Expected [%d, %d) y=%d.\n", pTestName, (int)iParagraph,
+                (int)pEditedParagraph->textOffset, (int)(pEditedParagraph->textOffset + pEditedParagraph->textLength), pEditedParagraph->posY,
+                (int)pFreshParagraph->textOffset,  (int)(pFreshParagraph->textOffset  + pFreshParagraph->textLength),  pFreshParagraph->posY);
+            goto done;
+        }
+
+        if (pEditedParagraph->lineCount != pFreshParagraph->lineCount || pEditedParagraph->runCount != pFreshParagraph->runCount) {
+            result = MD_ERROR;
+            print_error("%s: Paragraph %d has %d lines and %d runs. Expected %d lines and %d runs.\n", pTestName, (int)iParagraph,
+                (int)pEditedParagraph->lineCount, (int)pEditedParagraph->runCount, (int)pFreshParagraph->lineCount, (int)pFreshParagraph->runCount);
+            goto done;
+        }
+
+        for (iRun = 0; iRun < pFreshParagraph->runCount; iRun += 1) {
+            const md_text_block_run* pEditedRun = &pEditedParagraph->pRuns[iRun];
+            const md_text_block_run* pFreshRun  = &pFreshParagraph->pRuns[iRun];
+
+            if (pEditedRun->offset != pFreshRun->offset || pEditedRun->length != pFreshRun->length || pEditedRun->posX != pFreshRun->posX || pEditedRun->posY != pFreshRun->posY) {
+                result = MD_ERROR;
+                print_error("%s: Run %d of paragraph %d is [%d, %d) at (%d, %d). Expected [%d, %d) at (%d, %d).\n", pTestName, (int)iRun, (int)iParagraph,
+                    (int)pEditedRun->offset, (int)(pEditedRun->offset + pEditedRun->length), pEditedRun->posX, pEditedRun->posY,
+                    (int)pFreshRun->offset,  (int)(pFreshRun->offset  + pFreshRun->length),  pFreshRun->posX,  pFreshRun->posY);
+                goto done;
+            }
+        }
+    }
+
+    for (cp = 0; cp <= textLength; cp += 1) {
+        md_int32 editedX;
+        md_int32 editedY;
+        md_int32 freshX;
+        md_int32 freshY;
+        size_t editedCP;
+        size_t freshCP;
+
+        md_text_block_cp_to_xy(pEdited, cp, &editedX, &editedY);
+        md_text_block_cp_to_xy(&fresh,  cp, &freshX,  &freshY);
+
+        if (editedX != freshX || editedY != freshY) {
+            result = MD_ERROR;
+            print_error("%s: Code point %d is at (%d, %d). Expected (%d, %d).\n", pTestName, (int)cp, editedX, editedY, freshX, freshY);
+            goto done;
+        }
+
+        md_text_block_xy_to_cp(pEdited, freshX + 1, freshY + 1, &editedCP);
+        md_text_block_xy_to_cp(&fresh,  freshX + 1, freshY + 1, &freshCP);
+
+        if (editedCP != freshCP) {
+            result = MD_ERROR;
+            print_error("%s: (%d, %d) is at code point %d. Expected %d.\n", pTestName, freshX + 1, freshY + 1, (int)editedCP, (int)freshCP);
+            goto done;
+        }
+    }
+
+done:
+    md_text_block_uninit(&fresh);
+    return result;
+}
+
+typedef struct
+{
+    const char* pName;
+    const char* pText;      /* The text before the edit. */
+    size_t offset;          /* Where the edit is. (size_t)-1 for the end of the text. */
+    size_t length;          /* The number of code units to replace. */
+    const char* pNewText;
+    const char* pExpected;  /* The text after the edit. */
+} test_text_block_edit;
+
+int test__text_block_edits()
+{
+    md_result result;
+    md_api api;
+    md_font font;
+    md_text_layout layout;
+    md_uint32 iWrapMode;
+    size_t iEdit;
+    const test_text_block_edit edits[] = {
+        {"insert splitting a paragraph",        "first line\nsecond paragraph with more words", 17, 0, "\n",        "first line\nsecond\n paragraph with more words"},
+        {"insert splitting the last paragraph", "first\nsecond",                                8, 0, "\r\n\n",    "first\nse\r\n\ncond"},
+        {"delete merging two paragraphs",       "first line\nsecond line\nthird line",         10, 1, "",          "first linesecond line\nthird line"},
+        {"delete merging three paragraphs",     "first\nsecond\nthird\nfourth",                3, 13, "",          "firrd\nfourth"},
+        {"insert at offset 0",                  "first\nsecond",                                0, 0, "zero ",     "zero first\nsecond"},
+        {"insert new-line at offset 0",         "first\nsecond",                                0, 0, "\n",        "\nfirst\nsecond"},
+        {"delete at offset 0",                  "first\nsecond",                                0, 6, "",          "second"},
+        {"insert at the end",                   "first\nsecond",                        (size_t)-1, 0, " end\n",   "first\nsecond end\n"},
+        {"delete at the end",                   "first\nsecond\n",                             11, 2, "",          "first\nsecon"},
+        {"replace everything",                  "first\nsecond",                                0, 12, "other",    "other"},
+        {"insert between \\r and \\n",          "one\r\ntwo\r\nthree",                          4, 0, "X",         "one\rX\ntwo\r\nthree"},
+        {"insert \\n after \\r",                "one\rtwo",                                     4, 0, "\n",        "one\r\ntwo"},
+        {"insert \\r before \\n",               "one\ntwo",                                     3, 0, "\r",        "one\r\ntwo"},
+        {"delete the \\r of \\r\\n",            "one\r\ntwo",                                   3, 1, "",          "one\ntwo"},
+        {"delete the \\n of \\r\\n",            "one\r\ntwo",                                   4, 1, "",          "one\rtwo"},
+        {"replace across \\r\\n",               "one\r\ntwo",                                   4, 2, "\nT",       "one\r\nTwo"}
+    };
+
+    result = test__text_init(&api, &font);
+    if (result != MD_SUCCESS) {
+        return result;
+    }
+
+    /* Each edit is done without wrapping, and then with wrapping narrow enough to give most paragraphs more than one line. */
+    for (iWrapMode = 0; iWrapMode < 2; iWrapMode += 1) {
+        layout = md_text_layout_init_default();
+        layout.boundsSizeX = 64;
+        layout.boundsSizeY = 256;
+        layout.wrapMode    = (iWrapMode == 0) ? md_text_wrap_mode_none : md_text_wrap_mode_word;
+
+        for (iEdit = 0; iEdit < MD_COUNTOF(edits); iEdit += 1) {
+            md_text_block block;
+            md_text_metrics metrics;
+            const md_utf8* pText;
+            size_t textLength;
+            size_t offset;
+
+            result = md_text_block_init(&font, edits[iEdit].pText, (size_t)-1, &layout, &block);
+            if (result != MD_SUCCESS) {
+                print_error("test__text_block_edits (%s): md_text_block_init() failed.\n", edits[iEdit].pName);
+                goto done;
+            }
+
+            /* Lay out the block before editing it so that the edit is done incrementally. */
+            md_text_block_get_text_metrics(&block, &metrics);
+
+            offset = edits[iEdit].offset;
+            if (offset == (size_t)-1) {
+                md_text_block_get_text_utf8(&block, &offset);
+            }
+
+            result = md_text_block_replace_text_utf8(&block, offset, edits[iEdit].length, edits[iEdit].pNewText, (size_t)-1);
+            if (result != MD_SUCCESS) {
+                md_text_block_uninit(&block);
+                print_error("test__text_block_edits (%s): md_text_block_replace_text_utf8() failed.\n", edits[iEdit].pName);
+                goto done;
+            }
+
+            pText = md_text_block_get_text_utf8(&block, &textLength);
+            if (textLength != strlen(edits[iEdit].pExpected) || strcmp(pText, edits[iEdit].pExpected) != 0) {
+                md_text_block_uninit(&block);
+                result = MD_ERROR;
+                print_error("test__text_block_edits (%s): Text after the edit is wrong.\n", edits[iEdit].pName);
+                goto done;
+            }
+
+            result = test__text_block_compare(&block, edits[iEdit].pName);
+            md_text_block_uninit(&block);
+
+            if (result != MD_SUCCESS) {
+                goto done;
+            }
+        }
+    }
+
+done:
+    test__text_uninit(&api, &font);
+    return result;
+}
+
+/*
+Line break test vectors. These are written the same way as LineBreakTest.txt from the UCD except that the break markers are in ASCII:
+
+    x   No break before the next code point.
+    /   A break is allowed before the next code point.
+    !   A break is mandatory before the next code point.
+
+There is no marker at the start or end of the text since md_find_line_breaks_utf8() never reports a break there. Each vector depends on the
+line breaking class of the code points in it so these will catch a bad regeneration of the class table as well as mistakes in the rules.
+*/
+static const char* g_lineBreakTests[] = {
+    /* Basic alphabetic text, spaces and mandatory breaks. */
+    "0061 x 0062 x 0020 / 0063",
+    "0061 x 0020 x 0020 / 0062",
+    "0061 x 000A ! 0062",
+    "0061 x 000D x 000A ! 0062",
+    "0061 x 000D ! 0062",
+    "0061 x 0085 ! 0062",
+    "0061 x 2028 ! 0062",
+
+    /* CM. Combining marks take the class of the character they're attached to (LB9), or are alphabetic when there's nothing to attach to (LB10). */
+    "0061 x 0308 x 0062",
+    "0308 x 0061",
+    "0061 x 0020 / 0308 x 0062",
+    "4E00 x 0308 / 4E01",
+    "0031 x 0308 x 0032",
+    "0028 x 0308 x 0061",
+
+    /* ZWJ. Never break after a zero width joiner (LB8a). */
+    "0061 x 200D x 0062",
+    "4E00 x 200D x 4E01",
+    "1F469 x 200D x 1F467",
+    "0061 x 0020 / 200D x 4E00",
+
+    /* ZW, WJ and GL. */
+    "0061 x 200B / 0062",
+    "0061 x 0020 x 200B / 0062",
+    "0061 x 2060 x 0062",
+    "4E00 x 2060 x 4E01",
+    "0061 x 00A0 x 0062",
+    "0061 x 0020 / 00A0 x 0062",
+
+    /* QU. Quotation marks are not broken on either side (LB19), and QU SP* x OP (LB15). */
+    "0061 x 0020 / 0022 x 0062 x 0022 x 0020 / 0063",
+    "0022 x 0020 x 0028 x 0061 x 0029",
+    "4E00 x 0022 x 4E01",
+    "0061 x 0027 x 0073",
+
+    /* OP, CL and CP. */
+    "0028 x 0020 x 0061 x 0029",
+    "0061 x 0028 x 0062 x 0029 x 0063",
+    "0029 x 0020 x 3041",
+    "0061 x 0020 / 0028 x 0062 x 0029 x 0021 x 0020 / 0063",
+
+    /* Numeric sequences (LB25), and numbers next to letters (LB23) and prefixes and postfixes (LB24). */
+    "0024 x 0031 x 0030 x 0030 x 002E x 0035 x 0030 x 0025",
+    "0031 x 002C x 0030 x 0030 x 0030",
+    "0020 / 002D x 0035",
+    "0028 x 0031 x 0032 x 0029 x 0025",
+    "0061 x 0031 x 0062",
+    "0031 x 0020 / 0032",
+    "0031 x 0032 x 002D / 0061 x 0062",
+    "0031 x 002F x 0032",
+    "20AC x 0035",
+
+    /* CJK. Ideographs can be broken between (LB31) except before closing punctuation (LB13) and small kana (LB21). */
+    "4E2D / 6587 / 5B57 x 3002",
+    "4E2D x 3002 / 6587",
+    "4E2D / 300C x 6587 / 5B57 x 300D / 4E2D",
+    "4E2D x 3041 / 6587",
+    "30AB x 30FC / 30C9",
+    "4E2D x FF01 / 6587",
+    "1100 x 1161 x 11A8 / AC00 / AC01",
+
+    /* BA, BB, HY and B2. */
+    "0061 x 2010 / 0062",
+    "00B4 x 0061",
+    "0061 x 002D / 0062",
+    "2014 x 2014",
+    "05D0 x 002D x 05D1",
+
+    /* IS, SY and EX. */
+    "0061 x 002E x 0062",
+    "0061 x 002F / 0062",
+    "0061 x 0021 x 0020 / 0062",
+
+    /* RI, EB and EM. Regional indicators are paired up (LB30a) and emoji modifiers stick to their base (LB30b). */
+    "1F1E6 x 1F1E7 / 1F1E8 x 1F1E9",
+    "1F1E6 x 1F1E7 / 1F1E8",
+    "1F466 x 1F3FB / 1F466"
+};
+
+int test__text_line_breaks()
+{
+    size_t iTest;
+
+    for (iTest = 0; iTest < MD_COUNTOF(g_lineBreakTests); iTest += 1) {
+        const char* pTest = g_lineBreakTests[iTest];
+        md_utf8 text[64];
+        md_uint8 expectedBreaks[64];
+        md_uint8 actualBreaks[64];
+        size_t textLength = 0;
+        md_uint8 breakType = 0;
+        size_t i;
+
+        /* Parse the test into UTF-8 text and the expected break for each code unit. */
+        while (*pTest != '\0') {
+            if (*pTest == ' ') {
+                pTest += 1;
+            } else if (*pTest == 'x') {
+                breakType = 0;
+                pTest += 1;
+            } else if (*pTest == '/') {
+                breakType = MD_LINE_BREAK_ALLOWED;
+                pTest += 1;
+            } else if (*pTest == '!') {
+                breakType = MD_LINE_BREAK_MANDATORY;
+                pTest += 1;
+            } else {
+                char* pEnd;
+                md_utf32 cp = (md_utf32)strtoul(pTest, &pEnd, 16);
+                size_t cpLength;
+
+                md_utf32ne_to_utf8(text + textLength, MD_COUNTOF(text) - textLength, &cpLength, &cp, 1, NULL, 0);
+                MD_ZERO_MEMORY(expectedBreaks + textLength, cpLength);
+                expectedBreaks[textLength] = breakType;
+
+                textLength += cpLength;
+                pTest = pEnd;
+            }
+        }
+
+        md_find_line_breaks_utf8(text, textLength, actualBreaks);
+
+        for (i = 0; i < textLength; i += 1) {
+            if (actualBreaks[i] != expectedBreaks[i]) {
+                print_error("test__text_line_breaks: \"%s\": Break before code unit %d is %d. Expected %d.\n", g_lineBreakTests[iTest], (int)i, actualBreaks[i], expectedBreaks[i]);
+                return MD_ERROR;
+            }
+        }
+    }
+
+    return MD_SUCCESS;
+}
+
+/*
+Run index tests. The runs are built by hand rather than shaped so that the ligatures and right-to-left clusters don't depend on the backend.
+Every result is also checked against md_x_to_index() and md_index_to_x() which walk the glyphs directly.
+*/
+#define TEST_RUN_INDEX_MAX  8
+
+typedef struct
+{
+    const char* pName;
+    size_t textLength;
+    size_t clusters[TEST_RUN_INDEX_MAX];                /* The glyph of each code unit. */
+    size_t glyphCount;
+    md_int32 advances[TEST_RUN_INDEX_MAX];
+    size_t xCount;
+    md_int32 x[TEST_RUN_INDEX_MAX];                     /* Positions to test. */
+    size_t expectedIndices[TEST_RUN_INDEX_MAX];         /* The expected code unit under each position in [x]. */
+    md_int32 expectedX[TEST_RUN_INDEX_MAX];             /* The expected position of each code unit from 0 to textLength+1 inclusive. */
+} test_run_index;
+
+int test__text_run_index()
+{
+    md_result result;
+    md_api api;
+    md_font font;
+    md_item item;
+    size_t iTest;
+    const test_run_index tests[] = {
+        /* "ffia" where "ffi" is a ligature. */
+        {"ligature",              4, {0, 0, 0, 1}, 2, {12,  8},    7, {-5, 0, 11, 12, 19, 20, 30}, {0, 0, 0, 3, 3, 4, 4}, {0, 0, 0, 12, 20, 20}},
+
+        /* A right-to-left run. The glyphs are in visual order so the cluster of each code unit goes down. */
+        {"right-to-left",         3, {2, 1, 0},    3, { 5,  6, 7}, 7, {-5, 0, 4, 5, 11, 17, 18},  {0, 2, 2, 1, 0, 0, 3},   {11, 5, 0, 18, 18}},
+
+        /* A right-to-left run where each pair of code units is a ligature. */
+        {"right-to-left ligature", 4, {1, 1, 0, 0}, 2, { 9, 10},   6, {-1, 0, 8, 9, 18, 19},      {0, 2, 2, 0, 0, 4},      {9, 9, 0, 0, 19, 19}},
+
+        /* A base character and a combining mark shaped as two glyphs followed by another character. The mark has no advance and no code unit. */
+        {"zero advance glyph",    2, {0, 2},       3, { 7,  0, 7}, 5, {0, 6, 7, 13, 14},          {0, 0, 1, 1, 2},         {0, 7, 14, 14}},
+
+        /* A single glyph. */
+        {"one glyph",             1, {0},          1, { 8},        5, {-1, 0, 7, 8, 100},         {0, 0, 0, 1, 1},         {0, 8, 8}}
+    };
+
+    result = test__text_init(&api, &font);
+    if (result != MD_SUCCESS) {
+        return result;
+    }
+
+    MD_ZERO_OBJECT(&item);
+
+    for (iTest = 0; iTest < MD_COUNTOF(tests); iTest += 1) {
+        const test_run_index* pTest = &tests[iTest];
+        md_glyph glyphs[TEST_RUN_INDEX_MAX];
+        md_run_index runIndex;
+        size_t iGlyph;
+        size_t i;
+        md_int32 x;
+
+        MD_ZERO_MEMORY(glyphs, sizeof(glyphs));
+        for (iGlyph = 0; iGlyph < pTest->glyphCount; iGlyph += 1) {
+            glyphs[iGlyph].index   = (md_uint32)iGlyph;
+            glyphs[iGlyph].advance = pTest->advances[iGlyph];
+        }
+
+        result = md_run_index_init(pTest->clusters, pTest->textLength, glyphs, pTest->glyphCount, &runIndex);
+        if (result != MD_SUCCESS) {
+            print_error("test__text_run_index (%s): md_run_index_init() failed.\n", pTest->pName);
+            goto done;
+        }
+
+        for (i = 0; i < pTest->xCount; i += 1) {
+            size_t index;
+
+            md_run_index_x_to_index(&runIndex, &pTest->x[i], 1, &index, NULL);
+            if (index != pTest->expectedIndices[i]) {
+                result = MD_ERROR;
+                print_error("test__text_run_index (%s): x=%d is at code unit %d. Expected %d.\n", pTest->pName, pTest->x[i], (int)index, (int)pTest->expectedIndices[i]);
+                goto done_run;
+            }
+        }
+
+        for (i = 0; i <= pTest->textLength + 1; i += 1) {
+            md_run_index_index_to_x(&runIndex, &i, 1, &x);
+            if (x != pTest->expectedX[i]) {
+                result = MD_ERROR;
+                print_error("test__text_run_index (%s): Code unit %d is at x=%d. Expected %d.\n", pTest->pName, (int)i, x, pTest->expectedX[i]);
+                goto done_run;
+            }
+        }
+
+        /* Every position, including those before and after the run, should give the same result as the unindexed functions. */
+        for (x = -2; x <= runIndex.sizeX + 2; x += 1) {
+            size_t index;
+            size_t expectedIndex;
+            md_int32 offsetToEdge;
+            md_int32 expectedOffsetToEdge;
+
+            md_run_index_x_to_index(&runIndex, &x, 1, &index, &offsetToEdge);
+            md_x_to_index(&api, &item, x, pTest->textLength, pTest->clusters, glyphs, pTest->glyphCount, &expectedIndex, &expectedOffsetToEdge);
+
+            if (index != expectedIndex || offsetToEdge != expectedOffsetToEdge) {
+                result = MD_ERROR;
+                print_error("test__text_run_index (%s): x=%d is at code unit %d offset %d. md_x_to_index() gives code unit %d offset %d.\n", pTest->pName, x, (int)index, offsetToEdge, (int)expectedIndex, expectedOffsetToEdge);
+                goto done_run;
+            }
+        }
+
+        for (i = 0; i <= pTest->textLength; i += 1) {
+            md_int32 expectedX;
+
+            md_run_index_index_to_x(&runIndex, &i, 1, &x);
+            md_index_to_x(&api, &item, i, pTest->textLength, pTest->clusters, glyphs, pTest->glyphCount, &expectedX);
+
+            if (x != expectedX) {
+                result = MD_ERROR;
+                print_error("test__text_run_index (%s): Code unit %d is at x=%d. md_index_to_x() gives %d.\n", pTest->pName, (int)i, x, expectedX);
+                goto done_run;
+            }
+        }
+
+    done_run:
+        md_run_index_uninit(&runIndex);
+        if (result != MD_SUCCESS) {
+            goto done;
+        }
+    }
+
+done:
+    test__text_uninit(&api, &font);
+    return result;
+}
+
+/*
+Checks that the batched cp/xy queries give the same results as doing one query at a time. The queries are unsorted, contain duplicates and
+go out of range, and there are more of them than fit in the batch functions' stack buffers so the heap path is used.
+*/
+#define TEST_BATCH_QUERY_COUNT  100
+
+int test__text_layout_batch_queries()
+{
+    md_result result;
+    md_api api;
+    md_font font;
+    md_text_layout layout;
+    md_text_block block;
+    const char* pText = "The quick brown fox\njumps over\tthe lazy dog.\r\n\nend of text";
+    size_t textLength = strlen(pText);
+    size_t cps[TEST_BATCH_QUERY_COUNT];
+    md_int32 x[TEST_BATCH_QUERY_COUNT];
+    md_int32 y[TEST_BATCH_QUERY_COUNT];
+    size_t i;
+
+    result = test__text_init(&api, &font);
+    if (result != MD_SUCCESS) {
+        return result;
+    }
+
+    layout = md_text_layout_init_default();
+    layout.boundsSizeX = 96;
+    layout.boundsSizeY = 128;
+    layout.alignmentX  = md_alignment_center;
+    layout.alignmentY  = md_alignment_center;
+    layout.wrapMode    = md_text_wrap_mode_word;
+
+    result = md_text_block_init(&font, pText, textLength, &layout, &block);
+    if (result != MD_SUCCESS) {
+        print_error("test__text_layout_batch_queries: md_text_block_init() failed.\n");
+        goto done_font;
+    }
+
+    /* Code point to position. */
+    for (i = 0; i < TEST_BATCH_QUERY_COUNT; i += 1) {
+        cps[i] = (i * 37) % (textLength + 8);   /* Unsorted, with some past the end of the text. */
+    }
+    cps[1] = cps[0];                            /* Duplicates. */
+    cps[2] = cps[0];
+    cps[3] = (size_t)-1;
+
+    result = md_text_layout_cp_to_xy_batch_utf8(&font, pText, textLength, &layout, cps, TEST_BATCH_QUERY_COUNT, x, y);
+    if (result != MD_SUCCESS) {
+        print_error("test__text_layout_batch_queries: md_text_layout_cp_to_xy_batch_utf8() failed.\n");
+        goto done;
+    }
+
+    for (i = 0; i < TEST_BATCH_QUERY_COUNT; i += 1) {
+        md_int32 expectedX;
+        md_int32 expectedY;
+
+        md_text_layout_cp_to_xy_utf8(&font, pText, textLength, &layout, cps[i], &expectedX, &expectedY);
+        if (x[i] != expectedX || y[i] != expectedY) {
+            result = MD_ERROR;
+            print_error("test__text_layout_batch_queries: Query %d for code point %d gave (%d, %d). Expected (%d, %d).\n", (int)i, (int)cps[i], x[i], y[i], expectedX, expectedY);
+            goto done;
+        }
+
+        /* The text block does its own layout so it's an independent check for code points inside the text. */
+        if (cps[i] <= textLength) {
+            md_text_block_cp_to_xy(&block, cps[i], &expectedX, &expectedY);
+            if (x[i] != expectedX || y[i] != expectedY) {
+                result = MD_ERROR;
+                print_error("test__text_layout_batch_queries: Query %d for code point %d gave (%d, %d). The text block gives (%d, %d).\n", (int)i, (int)cps[i], x[i], y[i], expectedX, expectedY);
+                goto done;
+            }
+        }
+    }
+
+    /* Position to code point. */
+    for (i = 0; i < TEST_BATCH_QUERY_COUNT; i += 1) {
+        x[i] = (md_int32)((i * 29) % (layout.boundsSizeX + 40)) - 20;  /* Unsorted, with some outside the bounds on every side. */
+        y[i] = (md_int32)((i * 17) % (layout.boundsSizeY + 40)) - 20;
+    }
+    x[1] = x[0];                                                        /* Duplicates. */
+    y[1] = y[0];
+    x[2] = x[0];
+    y[2] = y[0];
+
+    result = md_text_layout_xy_to_cp_batch_utf8(&font, pText, textLength, &layout, x, y, TEST_BATCH_QUERY_COUNT, cps);
+    if (result != MD_SUCCESS) {
+        print_error("test__text_layout_batch_queries: md_text_layout_xy_to_cp_batch_utf8() failed.\n");
+        goto done;
+    }
+
+    for (i = 0; i < TEST_BATCH_QUERY_COUNT; i += 1) {
+        size_t expectedCP;
+
+        md_text_layout_xy_to_cp_utf8(&font, pText, textLength, &layout, x[i], y[i], &expectedCP);
+        if (cps[i] != expectedCP) {
+            result = MD_ERROR;
+            print_error("test__text_layout_batch_queries: Query %d for (%d, %d) gave code point %d. Expected %d.\n", (int)i, x[i], y[i], (int)cps[i], (int)expectedCP);
+            goto done;
+        }
+    }
+
+done:
+    md_text_block_uninit(&block);
+done_font:
+    test__text_uninit(&api, &font);
+    return result;
+}
+
+/*
+Checks that runs of printable ASCII shaped from the fast shaping table come out exactly the same as when they're shaped by the backend. The
+software backend never kerns or substitutes so the table must be reported as safe, which is what allows it to be used in the default mode.
+*/
+#define TEST_FAST_SHAPING_MAX_ITEMS   8
+#define TEST_FAST_SHAPING_MAX_GLYPHS  128
+
+static const char* g_fastShapingStrings[] = {
+    "Hello, World!",
+    " ",
+    "~",
+    "a  b",
+    "The quick brown fox jumps over the lazy dog. 0123456789",
+    " !\"#$%&'()*+,-./0123456789:;<=>?@ABCDEFGHIJKLMNOPQRSTUVWXYZ[\\]^_`abcdefghijklmnopqrstuvwxyz{|}~",
+    "Line one\nLine two\tTabbed"
+};
+
+int test__text_fast_shaping()
+{
+    md_result result;
+    md_api api;
+    md_font font;           /* md_fast_shaping_mode_auto. */
+    md_font fontBackend;    /* md_fast_shaping_mode_disabled. */
+    md_font_config fontConfig;
+    md_item items[TEST_FAST_SHAPING_MAX_ITEMS];
+    md_item itemsBackend[TEST_FAST_SHAPING_MAX_ITEMS];
+    md_uint32 itemCount;
+    md_uint32 itemCountBackend;
+    md_glyph glyphs[TEST_FAST_SHAPING_MAX_GLYPHS];
+    md_glyph glyphsBackend[TEST_FAST_SHAPING_MAX_GLYPHS];
+    size_t clusters[TEST_FAST_SHAPING_MAX_GLYPHS];
+    size_t clustersBackend[TEST_FAST_SHAPING_MAX_GLYPHS];
+    md_text_metrics metrics;
+    md_text_metrics metricsBackend;
+    const md_fast_shaping_table* pTable;
+    size_t iString;
+    md_uint32 iItem;
+
+    test__text_font_config_init(&fontConfig);
+    fontConfig.fastShapingMode = md_fast_shaping_mode_auto;
+
+    result = test__text_init_with_config(&api, &fontConfig, &font);
+    if (result != MD_SUCCESS) {
+        return result;
+    }
+
+    fontConfig.fastShapingMode = md_fast_shaping_mode_disabled;
+
+    result = md_font_init(&api, &fontConfig, &fontBackend);
+    if (result != MD_SUCCESS) {
+        print_error("test__text_fast_shaping: md_font_init() failed.\n");
+        goto done_font;
+    }
+
+    for (iString = 0; iString < MD_COUNTOF(g_fastShapingStrings); iString += 1) {
+        const char* pText = g_fastShapingStrings[iString];
+        size_t textLength = strlen(pText);
+
+        itemCount = MD_COUNTOF(items);
+        itemCountBackend = MD_COUNTOF(itemsBackend);
+
+        result = md_itemize_utf8(&font, pText, textLength, items, &itemCount, NULL);
+        if (result == MD_SUCCESS) {
+            result = md_itemize_utf8(&fontBackend, pText, textLength, itemsBackend, &itemCountBackend, NULL);
+        }
+
+        if (result != MD_SUCCESS || itemCount != itemCountBackend) {
+            result = MD_ERROR;
+            print_error("test__text_fast_shaping: Failed to itemize \"%s\".\n", pText);
+            goto done;
+        }
+
+        for (iItem = 0; iItem < itemCount; iItem += 1) {
+            const char* pRun = pText + items[iItem].offset;
+            size_t runLength = items[iItem].length;
+            size_t glyphCount = MD_COUNTOF(glyphs);
+            size_t glyphCountBackend = MD_COUNTOF(glyphsBackend);
+
+            /* The glyphs are compared byte for byte so the parts the backend doesn't set need to be the same. */
+            MD_ZERO_MEMORY(glyphs, sizeof(glyphs));
+            MD_ZERO_MEMORY(glyphsBackend, sizeof(glyphsBackend));
+
+            result = md_shape_utf8(&font, &items[iItem], pRun, runLength, glyphs, &glyphCount, clusters, &metrics);
+            if (result == MD_SUCCESS) {
+                result = md_shape_utf8(&fontBackend, &itemsBackend[iItem], pRun, runLength, glyphsBackend, &glyphCountBackend, clustersBackend, &metricsBackend);
+            }
+
+            if (result != MD_SUCCESS) {
+                print_error("test__text_fast_shaping: Failed to shape item %d of \"%s\".\n", (int)iItem, pText);
+                goto done;
+            }
+
+            if (glyphCount != glyphCountBackend || memcmp(glyphs, glyphsBackend, sizeof(*glyphs) * glyphCount) != 0 || memcmp(clusters, clustersBackend, sizeof(*clusters) * runLength) != 0) {
+                result = MD_ERROR;
+                print_error("test__text_fast_shaping: Glyphs or clusters for item %d of \"%s\" differ from the backend.\n", (int)iItem, pText);
+                goto done;
+            }
+
+            if (metrics.lPadding != metricsBackend.lPadding || metrics.rPadding != metricsBackend.rPadding || metrics.sizeX != metricsBackend.sizeX || metrics.sizeY != metricsBackend.sizeY) {
+                result = MD_ERROR;
+                print_error("test__text_fast_shaping: Run metrics for item %d of \"%s\" are {%d, %d, %d, %d}. The backend gives {%d, %d, %d, %d}.\n", (int)iItem, pText,
+                    metrics.lPadding, metrics.rPadding, metrics.sizeX, metrics.sizeY, metricsBackend.lPadding, metricsBackend.rPadding, metricsBackend.sizeX, metricsBackend.sizeY);
+                goto done;
+            }
+
+            /* Querying the glyph count must agree as well. */
+            glyphCount = 0;
+            result = md_shape_utf8(&font, &items[iItem], pRun, runLength, NULL, &glyphCount, NULL, NULL);
+            if (result != MD_SUCCESS || glyphCount != glyphCountBackend) {
+                result = MD_ERROR;
+                print_error("test__text_fast_shaping: Glyph count query for item %d of \"%s\" gave %d. Expected %d.\n", (int)iItem, pText, (int)glyphCount, (int)glyphCountBackend);
+                goto done;
+            }
+        }
+    }
+
+    /* The comparisons above are only meaningful if the table was actually used. */
+    pTable = md_font_get_fast_shaping_table(&font, &items[0]);
+    if (pTable == NULL || !pTable->isValid || !pTable->isSafe || font.fastShapingTableCount == 0) {
+        result = MD_ERROR;
+        print_error("test__text_fast_shaping: The fast shaping table is not reported as safe.\n");
+        goto done;
+    }
+
+    if (fontBackend.fastShapingTableCount != 0) {
+        result = MD_ERROR;
+        print_error("test__text_fast_shaping: A fast shaping table was built with md_fast_shaping_mode_disabled.\n");
+        goto done;
+    }
+
+done:
+    md_font_uninit(&fontBackend);
+done_font:
+    test__text_uninit(&api, &font);
+    return result;
+}
+
+/*
+Checks the shape cache. Output from the cache must be byte for byte the same as shaping without it, the hit and miss counts must add up,
+the least recently used runs must be evicted first, and a run that's too big to ever fit must still be returned without being stored. Fast
+shaping is disabled because it bypasses the cache for printable ASCII.
+*/
+#define TEST_SHAPE_CACHE_MAX_GLYPHS  64
+
+typedef struct
+{
+    md_result result;
+    size_t glyphCount;
+    md_glyph glyphs[TEST_SHAPE_CACHE_MAX_GLYPHS];
+    size_t clusters[TEST_SHAPE_CACHE_MAX_GLYPHS];
+    md_text_metrics metrics;
+} test_shaped_run;
+
+static const char* g_shapeCacheStrings[] = {
+    "Hello",
+    "Hello, World!",
+    "caf\xC3\xA9",
+    "\xE4\xB8\xAD\xE6\x96\x87",
+    "\xF0\x9F\x98\x80 smile",
+    "x"
+};
+
+/* Shapes a string that itemizes to a single item. */
+md_result test__shape_run(md_font* pFont, const char* pText, test_shaped_run* pRun)
+{
+    md_result result;
+    md_item item;
+    md_uint32 itemCount = 1;
+
+    MD_ZERO_OBJECT(pRun);
+
+    result = md_itemize_utf8(pFont, pText, strlen(pText), &item, &itemCount, NULL);
+    if (result != MD_SUCCESS || itemCount != 1) {
+        return MD_ERROR;
+    }
+
+    pRun->glyphCount = TEST_SHAPE_CACHE_MAX_GLYPHS;
+    pRun->result = md_shape_utf8(pFont, &item, pText, strlen(pText), pRun->glyphs, &pRun->glyphCount, pRun->clusters, &pRun->metrics);
+
+    return MD_SUCCESS;
+}
+
+md_bool32 test__shape_cache_stats_are(md_font* pFont, const char* pTestName, md_uint64 hitCount, md_uint64 missCount, md_uint32 runCount)
+{
+    md_shape_cache_stats stats;
+
+    if (md_font_get_shape_cache_stats(pFont, &stats) != MD_SUCCESS) {
+        print_error("test__text_shape_cache (%s): md_font_get_shape_cache_stats() failed.\n", pTestName);
+        return MD_FALSE;
+    }
+
+    if (stats.hitCount != hitCount || stats.missCount != missCount || stats.runCount != runCount || stats.sizeInBytes > stats.capacityInBytes) {
+        print_error("test__text_shape_cache (%s): %d hits, %d misses and %d runs using %d of %d bytes. Expected %d hits, %d misses and %d runs.\n", pTestName,
+            (int)stats.hitCount, (int)stats.missCount, (int)stats.runCount, (int)stats.sizeInBytes, (int)stats.capacityInBytes, (int)hitCount, (int)missCount, (int)runCount);
+        return MD_FALSE;
+    }
+
+    return MD_TRUE;
+}
+
+int test__text_shape_cache()
+{
+    md_result result;
+    md_api api;
+    md_font fontUncached;
+    md_font font;
+    md_font fontLRU;
+    md_font_config fontConfig;
+    md_shape_cache_stats stats;
+    test_shaped_run expected;
+    test_shaped_run actual;
+    md_item item;
+    md_uint32 itemCount;
+    size_t entrySizeInBytes;
+    size_t glyphCount;
+    size_t iString;
+    int iPass;
+    int iStep;
+    md_bool32 isFontInitialized = MD_FALSE;
+    md_bool32 isFontLRUInitialized = MD_FALSE;
+
+    /* Each step shapes one of four runs of the same size in a cache with room for three and lists the expected hit or miss. */
+    static const struct
+    {
+        const char* pText;
+        md_bool32 isHit;
+    } lruSteps[] = {
+        {"aaaa", MD_FALSE}, {"bbbb", MD_FALSE}, {"cccc", MD_FALSE},
+        {"aaaa", MD_TRUE },                                 /* "bbbb" is now the least recently used. */
+        {"dddd", MD_FALSE},                                 /* Evicts "bbbb". */
+        {"aaaa", MD_TRUE }, {"cccc", MD_TRUE }, {"dddd", MD_TRUE },
+        {"bbbb", MD_FALSE},                                 /* Evicts "aaaa". */
+        {"cccc", MD_TRUE }, {"dddd", MD_TRUE }, {"bbbb", MD_TRUE },
+        {"aaaa", MD_FALSE}
+    };
+    md_uint64 lruHitCount = 0;
+    md_uint64 lruMissCount = 0;
+    const char* pLongText = "The quick brown fox jumps over the lazy dog.";    /* Needs more than three times the memory of a run of four characters. */
+
+    test__text_font_config_init(&fontConfig);
+    fontConfig.fastShapingMode = md_fast_shaping_mode_disabled;
+
+    result = test__text_init_with_config(&api, &fontConfig, &fontUncached);
+    if (result != MD_SUCCESS) {
+        return result;
+    }
+
+    if (md_font_get_shape_cache_stats(&fontUncached, &stats) != MD_INVALID_OPERATION) {
+        result = MD_ERROR;
+        print_error("test__text_shape_cache: md_font_get_shape_cache_stats() should fail when the cache is disabled.\n");
+        goto done;
+    }
+
+    fontConfig.shapeCacheSizeInBytes = 64 * 1024;
+    result = md_font_init(&api, &fontConfig, &font);
+    if (result != MD_SUCCESS) {
+        print_error("test__text_shape_cache: md_font_init() failed.\n");
+        goto done;
+    }
+    isFontInitialized = MD_TRUE;
+
+    /* The first pass misses on every string and the second pass hits. Both must match the uncached output exactly. */
+    for (iPass = 0; iPass < 2; iPass += 1) {
+        for (iString = 0; iString < MD_COUNTOF(g_shapeCacheStrings); iString += 1) {
+            if (test__shape_run(&fontUncached, g_shapeCacheStrings[iString], &expected) != MD_SUCCESS || test__shape_run(&font, g_shapeCacheStrings[iString], &actual) != MD_SUCCESS) {
+                result = MD_ERROR;
+                print_error("test__text_shape_cache: Failed to itemize \"%s\".\n", g_shapeCacheStrings[iString]);
+                goto done;
+            }
+
+            if (expected.result != MD_SUCCESS || memcmp(&expected, &actual, sizeof(expected)) != 0) {
+                result = MD_ERROR;
+                print_error("test__text_shape_cache: Cached output for \"%s\" differs from uncached output (pass %d).\n", g_shapeCacheStrings[iString], iPass);
+                goto done;
+            }
+        }
+
+        if (!test__shape_cache_stats_are(&font, (iPass == 0) ? "first pass" : "second pass", (md_uint64)(iPass * MD_COUNTOF(g_shapeCacheStrings)), MD_COUNTOF(g_shapeCacheStrings), MD_COUNTOF(g_shapeCacheStrings))) {
+            result = MD_ERROR;
+            goto done;
+        }
+    }
+
+    /* Too small an output buffer fails the same way with and without the cache, and is still a hit. */
+    itemCount = 1;
+    md_itemize_utf8(&font, g_shapeCacheStrings[1], strlen(g_shapeCacheStrings[1]), &item, &itemCount, NULL);
+    glyphCount = 2;
+    result = md_shape_utf8(&font, &item, g_shapeCacheStrings[1], strlen(g_shapeCacheStrings[1]), actual.glyphs, &glyphCount, actual.clusters, NULL);
+    if (result != MD_NO_SPACE || glyphCount != strlen(g_shapeCacheStrings[1])) {
+        result = MD_ERROR;
+        print_error("test__text_shape_cache: A cached run should fail with MD_NO_SPACE and the required glyph count when the output is too small.\n");
+        goto done;
+    }
+
+    if (!test__shape_cache_stats_are(&font, "no space", MD_COUNTOF(g_shapeCacheStrings) + 1, MD_COUNTOF(g_shapeCacheStrings), MD_COUNTOF(g_shapeCacheStrings))) {
+        result = MD_ERROR;
+        goto done;
+    }
+
+    /* Find out how big an entry for a run of four characters is so the next cache can be given room for exactly three. */
+    md_font_get_shape_cache_stats(&font, &stats);
+    entrySizeInBytes = stats.sizeInBytes;
+    test__shape_run(&font, "wxyz", &actual);
+    md_font_get_shape_cache_stats(&font, &stats);
+    entrySizeInBytes = stats.sizeInBytes - entrySizeInBytes;
+
+    fontConfig.shapeCacheSizeInBytes = entrySizeInBytes * 3;
+    result = md_font_init(&api, &fontConfig, &fontLRU);
+    if (result != MD_SUCCESS) {
+        print_error("test__text_shape_cache: md_font_init() failed.\n");
+        goto done;
+    }
+    isFontLRUInitialized = MD_TRUE;
+
+    for (iStep = 0; iStep < (int)MD_COUNTOF(lruSteps); iStep += 1) {
+        char testName[64];
+
+        test__shape_run(&fontUncached, lruSteps[iStep].pText, &expected);
+        test__shape_run(&fontLRU, lruSteps[iStep].pText, &actual);
+        if (memcmp(&expected, &actual, sizeof(expected)) != 0) {
+            result = MD_ERROR;
+            print_error("test__text_shape_cache: Cached output for \"%s\" differs from uncached output (step %d).\n", lruSteps[iStep].pText, iStep);
+            goto done;
+        }
+
+        if (lruSteps[iStep].isHit) {
+            lruHitCount += 1;
+        } else {
+            lruMissCount += 1;
+        }
+
+        sprintf(testName, "LRU step %d", iStep);
+        if (!test__shape_cache_stats_are(&fontLRU, testName, lruHitCount, lruMissCount, (lruMissCount < 3) ? (md_uint32)lruMissCount : 3)) {
+            result = MD_ERROR;
+            goto done;
+        }
+    }
+
+    /* A run that's bigger than the whole cache is returned as normal but never stored, so it's a miss every time and nothing is evicted for it. */
+    for (iPass = 0; iPass < 2; iPass += 1) {
+        test__shape_run(&fontUncached, pLongText, &expected);
+        test__shape_run(&fontLRU, pLongText, &actual);
+        if (memcmp(&expected, &actual, sizeof(expected)) != 0) {
+            result = MD_ERROR;
+            print_error("test__text_shape_cache: Output for a run that's too big to cache differs from uncached output.\n");
+            goto done;
+        }
+
+        lruMissCount += 1;
+        if (!test__shape_cache_stats_are(&fontLRU, "too big", lruHitCount, lruMissCount, 3)) {
+            result = MD_ERROR;
+            goto done;
+        }
+    }
+
+    md_font_get_shape_cache_stats(&fontLRU, &stats);
+    if (stats.sizeInBytes != entrySizeInBytes * 3) {
+        result = MD_ERROR;
+        print_error("test__text_shape_cache: The cache is using %d bytes. Expected %d.\n", (int)stats.sizeInBytes, (int)(entrySizeInBytes * 3));
+        goto done;
+    }
+
+    result = MD_SUCCESS;
+
+done:
+    if (isFontLRUInitialized) {
+        md_font_uninit(&fontLRU);
+    }
+    if (isFontInitialized) {
+        md_font_uninit(&font);
+    }
+    test__text_uninit(&api, &fontUncached);
+    return result;
+}
+
+/*
+Checks that the UTF-16 and UTF-32 entry points behave exactly like the UTF-8 ones. The software backend only itemizes and shapes UTF-8 so
+the other encodings are converted, and item offsets and clusters need to be mapped back to the input encoding. The text mixes 1, 2, 3 and
+4 byte code points, two of which are surrogate pairs in UTF-16, and has line breaks and a tab so there's more than one item.
+*/
+#define TEST_ENCODINGS_MAX_ITEMS   16
+#define TEST_ENCODINGS_MAX_GLYPHS  32
+
+/* The last line is the widest so that losing the last code point changes the measured size. */
+static const char g_encodingsUTF8[] = "\xE4\xB8\xAD" "c\nd\xF0\x90\x90\xB7\nab\xC3\xA9\xF0\x9F\x98\x80\te";
+static const md_utf16 g_encodingsUTF16[] = { 0x4E2D, 'c', '\n', 'd', 0xD801, 0xDC37, '\n', 'a', 'b', 0x00E9, 0xD83D, 0xDE00, '\t', 'e', 0 };
+static const md_utf32 g_encodingsUTF32[] = { 0x4E2D, 'c', '\n', 'd', 0x10437, '\n', 'a', 'b', 0x00E9, 0x1F600, '\t', 'e', 0 };
+
+/* Returns the index of the code point starting at the given offset, or -1 if the offset is not on a code point boundary. */
+int test__encodings_code_point_index(const size_t* pOffsets, size_t codePointCount, size_t offset)
+{
+    size_t iCodePoint;
+
+    for (iCodePoint = 0; iCodePoint <= codePointCount; iCodePoint += 1) {
+        if (pOffsets[iCodePoint] == offset) {
+            return (int)iCodePoint;
+        }
+    }
+
+    return -1;
+}
+
+int test__text_encodings()
+{
+    md_result result;
+    test_software_context context;
+    md_font font;
+    md_font_config fontConfig;
+    md_item items8[TEST_ENCODINGS_MAX_ITEMS];
+    md_item items16[TEST_ENCODINGS_MAX_ITEMS];
+    md_item items32[TEST_ENCODINGS_MAX_ITEMS];
+    md_uint32 itemCount8;
+    md_uint32 itemCount16;
+    md_uint32 itemCount32;
+    md_glyph glyphs8[TEST_ENCODINGS_MAX_GLYPHS];
+    md_glyph glyphs16[TEST_ENCODINGS_MAX_GLYPHS];
+    md_glyph glyphs32[TEST_ENCODINGS_MAX_GLYPHS];
+    size_t clusters8[TEST_ENCODINGS_MAX_GLYPHS];
+    size_t clusters16[TEST_ENCODINGS_MAX_GLYPHS];
+    size_t clusters32[TEST_ENCODINGS_MAX_GLYPHS];
+    md_text_metrics metrics8;
+    md_text_metrics metrics16;
+    md_text_metrics metrics32;
+    size_t offsets8[MD_COUNTOF(g_encodingsUTF32)];     /* Code unit offset of each code point, plus one for the end of the string. */
+    size_t offsets16[MD_COUNTOF(g_encodingsUTF32)];
+    md_uint8 pixels8[TEST_SOFTWARE_SIZE*TEST_SOFTWARE_SIZE*4];
+    size_t length8  = MD_COUNTOF(g_encodingsUTF8)  - 1;
+    size_t length16 = MD_COUNTOF(g_encodingsUTF16) - 1;
+    size_t length32 = MD_COUNTOF(g_encodingsUTF32) - 1;
+    size_t iCodePoint;
+    size_t iPixel;
+    md_uint32 iItem;
+    md_bool32 hasPixels;
+
+    /* Work out where each code point starts in each encoding. The UTF-32 offset is the code point index. */
+    offsets8[0]  = 0;
+    offsets16[0] = 0;
+    for (iCodePoint = 0; iCodePoint < length32; iCodePoint += 1) {
+        md_utf32 cp = g_encodingsUTF32[iCodePoint];
+        offsets8[iCodePoint+1]  = offsets8[iCodePoint]  + ((cp < 0x80) ? 1 : (cp < 0x800) ? 2 : (cp < 0x10000) ? 3 : 4);
+        offsets16[iCodePoint+1] = offsets16[iCodePoint] + ((cp < 0x10000) ? 1 : 2);
+    }
+
+    if (offsets8[length32] != length8 || offsets16[length32] != length16) {
+        print_error("test__text_encodings: The test strings are not the same text.\n");
+        return MD_ERROR;
+    }
+
+    result = test__software_init(&context);
+    if (result != MD_SUCCESS) {
+        return result;
+    }
+
+    test__text_font_config_init(&fontConfig);
+
+    result = md_font_init(&context.api, &fontConfig, &font);
+    if (result != MD_SUCCESS) {
+        print_error("test__text_encodings: md_font_init() failed.\n");
+        goto done_context;
+    }
+
+    /* Itemization. */
+    itemCount8  = MD_COUNTOF(items8);
+    itemCount16 = MD_COUNTOF(items16);
+    itemCount32 = MD_COUNTOF(items32);
+
+    result = md_itemize_utf8(&font, g_encodingsUTF8, length8, items8, &itemCount8, NULL);
+    if (result == MD_SUCCESS) {
+        result = md_itemize_utf16(&font, g_encodingsUTF16, length16, items16, &itemCount16, NULL);
+    }
+    if (result == MD_SUCCESS) {
+        result = md_itemize_utf32(&font, g_encodingsUTF32, length32, items32, &itemCount32, NULL);
+    }
+
+    if (result != MD_SUCCESS || itemCount8 < 2 || itemCount16 != itemCount8 || itemCount32 != itemCount8) {
+        result = MD_ERROR;
+        print_error("test__text_encodings: Itemization gave %d, %d and %d items for UTF-8, UTF-16 and UTF-32.\n", (int)itemCount8, (int)itemCount16, (int)itemCount32);
+        goto done;
+    }
+
+    for (iItem = 0; iItem < itemCount8; iItem += 1) {
+        int iFirst8 = test__encodings_code_point_index(offsets8, length32, items8[iItem].offset);
+        int iLast8  = test__encodings_code_point_index(offsets8, length32, items8[iItem].offset + items8[iItem].length);
+
+        if (iFirst8 < 0 || iLast8 < 0 ||
+            items16[iItem].offset != offsets16[iFirst8] || items16[iItem].offset + items16[iItem].length != offsets16[iLast8] ||
+            items32[iItem].offset != (size_t)iFirst8    || items32[iItem].offset + items32[iItem].length != (size_t)iLast8) {
+            result = MD_ERROR;
+            print_error("test__text_encodings: Item %d is {%d, %d} in UTF-8, {%d, %d} in UTF-16 and {%d, %d} in UTF-32, which is not the same text.\n", (int)iItem,
+                (int)items8[iItem].offset, (int)items8[iItem].length, (int)items16[iItem].offset, (int)items16[iItem].length, (int)items32[iItem].offset, (int)items32[iItem].length);
+            goto done;
+        }
+    }
+
+    /* A null terminated string must give the same number of items. */
+    itemCount16 = MD_COUNTOF(items16);
+    itemCount32 = MD_COUNTOF(items32);
+
+    result = md_itemize_utf16(&font, g_encodingsUTF16, (size_t)-1, items16, &itemCount16, NULL);
+    if (result == MD_SUCCESS) {
+        result = md_itemize_utf32(&font, g_encodingsUTF32, (size_t)-1, items32, &itemCount32, NULL);
+    }
+
+    if (result != MD_SUCCESS || itemCount16 != itemCount8 || itemCount32 != itemCount8) {
+        result = MD_ERROR;
+        print_error("test__text_encodings: Null terminated itemization gave %d and %d items for UTF-16 and UTF-32. Expected %d.\n", (int)itemCount16, (int)itemCount32, (int)itemCount8);
+        goto done;
+    }
+
+    /* Shaping. The clusters are indexed by code unit so they're compared at each code unit of each code point. */
+    for (iItem = 0; iItem < itemCount8; iItem += 1) {
+        size_t glyphCount8  = MD_COUNTOF(glyphs8);
+        size_t glyphCount16 = MD_COUNTOF(glyphs16);
+        size_t glyphCount32 = MD_COUNTOF(glyphs32);
+        size_t iFirst = items32[iItem].offset;
+        size_t iLast  = items32[iItem].offset + items32[iItem].length;
+
+        MD_ZERO_MEMORY(glyphs8,  sizeof(glyphs8));
+        MD_ZERO_MEMORY(glyphs16, sizeof(glyphs16));
+        MD_ZERO_MEMORY(glyphs32, sizeof(glyphs32));
+
+        result = md_shape_utf8(&font, &items8[iItem], g_encodingsUTF8 + items8[iItem].offset, items8[iItem].length, glyphs8, &glyphCount8, clusters8, &metrics8);
+        if (result == MD_SUCCESS) {
+            result = md_shape_utf16(&font, &items16[iItem], g_encodingsUTF16 + items16[iItem].offset, items16[iItem].length, glyphs16, &glyphCount16, clusters16, &metrics16);
+        }
+        if (result == MD_SUCCESS) {
+            result = md_shape_utf32(&font, &items32[iItem], g_encodingsUTF32 + items32[iItem].offset, items32[iItem].length, glyphs32, &glyphCount32, clusters32, &metrics32);
+        }
+
+        if (result != MD_SUCCESS) {
+            print_error("test__text_encodings: Failed to shape item %d.\n", (int)iItem);
+            goto done;
+        }
+
+        if (glyphCount16 != glyphCount8 || glyphCount32 != glyphCount8 || memcmp(glyphs16, glyphs8, sizeof(*glyphs8) * glyphCount8) != 0 || memcmp(glyphs32, glyphs8, sizeof(*glyphs8) * glyphCount8) != 0) {
+            result = MD_ERROR;
+            print_error("test__text_encodings: Item %d shaped to %d, %d and %d glyphs for UTF-8, UTF-16 and UTF-32, or the glyphs differ.\n", (int)iItem, (int)glyphCount8, (int)glyphCount16, (int)glyphCount32);
+            goto done;
+        }
+
+        if (metrics16.lPadding != metrics8.lPadding || metrics16.rPadding != metrics8.rPadding || metrics16.sizeX != metrics8.sizeX || metrics16.sizeY != metrics8.sizeY ||
+            metrics32.lPadding != metrics8.lPadding || metrics32.rPadding != metrics8.rPadding || metrics32.sizeX != metrics8.sizeX || metrics32.sizeY != metrics8.sizeY) {
+            result = MD_ERROR;
+            print_error("test__text_encodings: Run metrics for item %d differ between encodings.\n", (int)iItem);
+            goto done;
+        }
+
+        for (iCodePoint = iFirst; iCodePoint < iLast; iCodePoint += 1) {
+            size_t cluster = clusters32[iCodePoint - iFirst];
+            size_t iUnit;
+
+            for (iUnit = offsets8[iCodePoint]; iUnit < offsets8[iCodePoint+1]; iUnit += 1) {
+                if (clusters8[iUnit - offsets8[iFirst]] != cluster) {
+                    result = MD_ERROR;
+                    print_error("test__text_encodings: Item %d: The UTF-8 cluster for byte %d is %d. The UTF-32 cluster for the same code point is %d.\n", (int)iItem, (int)iUnit, (int)clusters8[iUnit - offsets8[iFirst]], (int)cluster);
+                    goto done;
+                }
+            }
+
+            for (iUnit = offsets16[iCodePoint]; iUnit < offsets16[iCodePoint+1]; iUnit += 1) {
+                if (clusters16[iUnit - offsets16[iFirst]] != cluster) {
+                    result = MD_ERROR;
+                    print_error("test__text_encodings: Item %d: The UTF-16 cluster for code unit %d is %d. The UTF-32 cluster for the same code point is %d.\n", (int)iItem, (int)iUnit, (int)clusters16[iUnit - offsets16[iFirst]], (int)cluster);
+                    goto done;
+                }
+            }
+        }
+    }
+
+    /* Measuring. */
+    result = md_font_get_text_metrics_utf8(&font, g_encodingsUTF8, length8, &metrics8);
+    if (result == MD_SUCCESS) {
+        result = md_font_get_text_metrics_utf16(&font, g_encodingsUTF16, length16, &metrics16);
+    }
+    if (result == MD_SUCCESS) {
+        result = md_font_get_text_metrics_utf32(&font, g_encodingsUTF32, length32, &metrics32);
+    }
+
+    if (result != MD_SUCCESS || metrics8.sizeX == 0 ||
+        metrics16.sizeX != metrics8.sizeX || metrics16.sizeY != metrics8.sizeY || metrics32.sizeX != metrics8.sizeX || metrics32.sizeY != metrics8.sizeY) {
+        result = MD_ERROR;
+        print_error("test__text_encodings: Text metrics are %dx%d, %dx%d and %dx%d for UTF-8, UTF-16 and UTF-32.\n",
+            metrics8.sizeX, metrics8.sizeY, metrics16.sizeX, metrics16.sizeY, metrics32.sizeX, metrics32.sizeY);
+        goto done;
+    }
+
+    /* Drawing. Each encoding is drawn onto a cleared surface and must produce the same pixels and metrics as UTF-8. */
+    md_gc_set_text_fg_color(&context.gc, md_rgba(255, 255, 255, 255));
+
+    md_gc_draw_text_utf8(&context.gc, &font, g_encodingsUTF8, length8, 0, 0, md_alignment_left, md_alignment_top, &metrics8);
+    result = test__software_read_pixels(&context);
+    if (result != MD_SUCCESS) {
+        print_error("test__text_encodings: Failed to read the UTF-8 pixels.\n");
+        goto done;
+    }
+    MD_COPY_MEMORY(pixels8, context.pixels, sizeof(pixels8));
+
+    hasPixels = MD_FALSE;
+    for (iPixel = 0; iPixel < sizeof(pixels8); iPixel += 1) {
+        if (pixels8[iPixel] != 0) {
+            hasPixels = MD_TRUE;
+            break;
+        }
+    }
+
+    if (!hasPixels) {
+        result = MD_ERROR;
+        print_error("test__text_encodings: Nothing was drawn for the UTF-8 text.\n");
+        goto done;
+    }
+
+    test__software_reset(&context);
+    md_gc_draw_text_utf16(&context.gc, &font, g_encodingsUTF16, length16, 0, 0, md_alignment_left, md_alignment_top, &metrics16);
+    result = test__software_read_pixels(&context);
+    if (result != MD_SUCCESS || memcmp(context.pixels, pixels8, sizeof(pixels8)) != 0 || metrics16.sizeX != metrics8.sizeX || metrics16.sizeY != metrics8.sizeY) {
+        result = MD_ERROR;
+        print_error("test__text_encodings: Drawing UTF-16 text does not match UTF-8.\n");
+        goto done;
+    }
+
+    test__software_reset(&context);
+    md_gc_draw_text_utf32(&context.gc, &font, g_encodingsUTF32, length32, 0, 0, md_alignment_left, md_alignment_top, &metrics32);
+    result = test__software_read_pixels(&context);
+    if (result != MD_SUCCESS || memcmp(context.pixels, pixels8, sizeof(pixels8)) != 0 || metrics32.sizeX != metrics8.sizeX || metrics32.sizeY != metrics8.sizeY) {
+        result = MD_ERROR;
+        print_error("test__text_encodings: Drawing UTF-32 text does not match UTF-8.\n");
+        goto done;
+    }
+
+    result = MD_SUCCESS;
+
+done:
+    md_font_uninit(&font);
+done_context:
+    test__software_uninit(&context);
+    return result;
+}
+
+/*
+Checks itemizing into an md_item_buffer. The buffer must grow through onGrow, report MD_NO_SPACE with the required count when there's no
+onGrow, report MD_OUT_OF_MEMORY when onGrow fails, and append after any items that are already in the buffer. The text has enough tabs and
+line breaks that the buffer needs to grow more than once.
+*/
+#define TEST_ITEM_BUFFER_MAX_ITEMS  64
+#define TEST_ITEM_BUFFER_EXISTING   3
+
+static const char g_itemBufferText[] = "one\ttwo\tthree\nfour\tfive\tsix\nseven\teight\tnine\nten\televen\ttwelve\nthirteen\tfourteen\n";
+
+typedef struct
+{
+    md_uint32 growCount;
+    md_uint32 failAfter;    /* onGrow fails once it has been called this many times. */
+} test_item_buffer_state;
+
+md_result test__item_buffer_grow(md_item_buffer* pBuffer, md_uint32 newCapacity)
+{
+    test_item_buffer_state* pState = (test_item_buffer_state*)pBuffer->pUserData;
+    md_item* pNewItems;
+
+    if (pState->growCount == pState->failAfter || newCapacity <= pBuffer->capacity) {
+        return MD_OUT_OF_MEMORY;
+    }
+
+    pNewItems = (md_item*)MD_REALLOC(pBuffer->pItems, sizeof(*pNewItems) * newCapacity);
+    if (pNewItems == NULL) {
+        return MD_OUT_OF_MEMORY;
+    }
+
+    pBuffer->pItems   = pNewItems;
+    pBuffer->capacity = newCapacity;
+    pState->growCount += 1;
+
+    return MD_SUCCESS;
+}
+
+void test__item_buffer_init(md_item_buffer* pBuffer, test_item_buffer_state* pState, md_uint32 failAfter)
+{
+    MD_ZERO_OBJECT(pBuffer);
+    MD_ZERO_OBJECT(pState);
+    pState->failAfter  = failAfter;
+    pBuffer->onGrow    = test__item_buffer_grow;
+    pBuffer->pUserData = pState;
+}
+
+/* Checks that items [first, first+count) of the buffer are the same as the expected items. */
+md_bool32 test__item_buffer_items_are(const md_item_buffer* pBuffer, const char* pTestName, md_uint32 first, const md_item* pExpected, md_uint32 count)
+{
+    md_uint32 iItem;
+
+    for (iItem = 0; iItem < count; iItem += 1) {
+        const md_item* pItem = &pBuffer->pItems[first + iItem];
+        if (pItem->offset != pExpected[iItem].offset || pItem->length != pExpected[iItem].length) {
+            print_error("test__text_item_buffer (%s): Item %d is {%d, %d}. Expected {%d, %d}.\n", pTestName, (int)(first + iItem),
+                (int)pItem->offset, (int)pItem->length, (int)pExpected[iItem].offset, (int)pExpected[iItem].length);
+            return MD_FALSE;
+        }
+    }
+
+    return MD_TRUE;
+}
+
+int test__text_item_buffer()
+{
+    md_result result;
+    md_api api;
+    md_font font;
+    md_item expected[TEST_ITEM_BUFFER_MAX_ITEMS];
+    md_item fixedItems[4];
+    md_uint32 expectedCount;
+    md_item_buffer buffer;
+    test_item_buffer_state state;
+    md_uint32 iItem;
+    size_t textLength = MD_COUNTOF(g_itemBufferText) - 1;
+
+    result = test__text_init(&api, &font);
+    if (result != MD_SUCCESS) {
+        return result;
+    }
+
+    /* The items from a fixed size array that's big enough are what every other buffer is compared against. */
+    expectedCount = MD_COUNTOF(expected);
+    result = md_itemize_utf8(&font, g_itemBufferText, textLength, expected, &expectedCount, NULL);
+    if (result != MD_SUCCESS || expectedCount <= 16 || expectedCount > MD_COUNTOF(expected)) {
+        result = MD_ERROR;
+        print_error("test__text_item_buffer: The text itemized to %d items. Expected more than 16 so the buffer grows more than once.\n", (int)expectedCount);
+        goto done_font;
+    }
+
+    /* Growing from empty. */
+    test__item_buffer_init(&buffer, &state, 0xFFFFFFFF);
+
+    result = md_itemize_utf8_to_buffer(&font, g_itemBufferText, textLength, &buffer, NULL);
+    if (result != MD_SUCCESS || buffer.count != expectedCount || buffer.capacity < expectedCount || state.growCount < 2) {
+        result = MD_ERROR;
+        print_error("test__text_item_buffer (grow): Got %d items with a capacity of %d after %d grows. Expected %d items.\n", (int)buffer.count, (int)buffer.capacity, (int)state.growCount, (int)expectedCount);
+        goto done;
+    }
+
+    if (!test__item_buffer_items_are(&buffer, "grow", 0, expected, expectedCount)) {
+        result = MD_ERROR;
+        goto done;
+    }
+
+    /* Appending after existing items. Start full so the first push needs to grow. The existing items must be left alone. */
+    MD_FREE(buffer.pItems);
+    test__item_buffer_init(&buffer, &state, 0xFFFFFFFF);
+
+    buffer.pItems = (md_item*)MD_MALLOC(sizeof(*buffer.pItems) * TEST_ITEM_BUFFER_EXISTING);
+    if (buffer.pItems == NULL) {
+        result = MD_OUT_OF_MEMORY;
+        goto done_font;
+    }
+
+    MD_ZERO_MEMORY(buffer.pItems, sizeof(*buffer.pItems) * TEST_ITEM_BUFFER_EXISTING);
+    for (iItem = 0; iItem < TEST_ITEM_BUFFER_EXISTING; iItem += 1) {
+        buffer.pItems[iItem].offset = 1000 + iItem;
+        buffer.pItems[iItem].length = 2000 + iItem;
+    }
+    buffer.capacity = TEST_ITEM_BUFFER_EXISTING;
+    buffer.count    = TEST_ITEM_BUFFER_EXISTING;
+
+    result = md_itemize_utf8_to_buffer(&font, g_itemBufferText, textLength, &buffer, NULL);
+    if (result != MD_SUCCESS || buffer.count != TEST_ITEM_BUFFER_EXISTING + expectedCount || !test__item_buffer_items_are(&buffer, "append", TEST_ITEM_BUFFER_EXISTING, expected, expectedCount)) {
+        result = MD_ERROR;
+        print_error("test__text_item_buffer (append): Got %d items. Expected %d.\n", (int)buffer.count, (int)(TEST_ITEM_BUFFER_EXISTING + expectedCount));
+        goto done;
+    }
+
+    for (iItem = 0; iItem < TEST_ITEM_BUFFER_EXISTING; iItem += 1) {
+        if (buffer.pItems[iItem].offset != 1000 + iItem || buffer.pItems[iItem].length != 2000 + iItem) {
+            result = MD_ERROR;
+            print_error("test__text_item_buffer (append): Existing item %d was changed.\n", (int)iItem);
+            goto done;
+        }
+    }
+
+    /* The same again through the UTF-16 entry point which remaps offsets after itemizing. Only the new items can be remapped. */
+    {
+        md_utf16 textUTF16[MD_COUNTOF(g_itemBufferText)];
+        size_t iChar;
+        md_uint32 countBefore = buffer.count;
+
+        for (iChar = 0; iChar < MD_COUNTOF(g_itemBufferText); iChar += 1) {
+            textUTF16[iChar] = (md_utf16)g_itemBufferText[iChar];  /* The text is ASCII. */
+        }
+
+        result = md_itemize_utf16_to_buffer(&font, textUTF16, textLength, &buffer, NULL);
+        if (result != MD_SUCCESS || buffer.count != countBefore + expectedCount ||
+            !test__item_buffer_items_are(&buffer, "append UTF-16", TEST_ITEM_BUFFER_EXISTING, expected, expectedCount) ||
+            !test__item_buffer_items_are(&buffer, "append UTF-16", countBefore, expected, expectedCount)) {
+            result = MD_ERROR;
+            print_error("test__text_item_buffer (append UTF-16): Got %d items. Expected %d.\n", (int)buffer.count, (int)(countBefore + expectedCount));
+            goto done;
+        }
+
+        for (iItem = 0; iItem < TEST_ITEM_BUFFER_EXISTING; iItem += 1) {
+            if (buffer.pItems[iItem].offset != 1000 + iItem || buffer.pItems[iItem].length != 2000 + iItem) {
+                result = MD_ERROR;
+                print_error("test__text_item_buffer (append UTF-16): Existing item %d was changed.\n", (int)iItem);
+                goto done;
+            }
+        }
+    }
+
+    /* onGrow failing after the first call. */
+    MD_FREE(buffer.pItems);
+    test__item_buffer_init(&buffer, &state, 1);
+
+    result = md_itemize_utf8_to_buffer(&font, g_itemBufferText, textLength, &buffer, NULL);
+    if (result != MD_OUT_OF_MEMORY || state.growCount != 1) {
+        print_error("test__text_item_buffer (grow failure): Result is %d after %d grows. Expected MD_OUT_OF_MEMORY after 1.\n", (int)result, (int)state.growCount);
+        result = MD_ERROR;
+        goto done;
+    }
+
+    /* No onGrow. The items that fit are filled in and the count is the number of items needed. */
+    {
+        md_item_buffer fixed;
+
+        MD_ZERO_OBJECT(&fixed);
+        fixed.pItems   = fixedItems;
+        fixed.capacity = MD_COUNTOF(fixedItems);
+
+        result = md_itemize_utf8_to_buffer(&font, g_itemBufferText, textLength, &fixed, NULL);
+        if (result != MD_NO_SPACE || fixed.count != expectedCount) {
+            print_error("test__text_item_buffer (no space): Result is %d with a count of %d. Expected MD_NO_SPACE and %d.\n", (int)result, (int)fixed.count, (int)expectedCount);
+            result = MD_ERROR;
+            goto done;
+        }
+
+        if (!test__item_buffer_items_are(&fixed, "no space", 0, expected, MD_COUNTOF(fixedItems))) {
+            result = MD_ERROR;
+            goto done;
+        }
+
+        /* Without any items the buffer only counts, which is not an error. */
+        MD_ZERO_OBJECT(&fixed);
+
+        result = md_itemize_utf8_to_buffer(&font, g_itemBufferText, textLength, &fixed, NULL);
+        if (result != MD_SUCCESS || fixed.count != expectedCount) {
+            print_error("test__text_item_buffer (count only): Result is %d with a count of %d. Expected MD_SUCCESS and %d.\n", (int)result, (int)fixed.count, (int)expectedCount);
+            result = MD_ERROR;
+            goto done;
+        }
+    }
+
+    result = MD_SUCCESS;
+
+done:
+    MD_FREE(buffer.pItems);
+done_font:
+    test__text_uninit(&api, &font);
+    return result;
+}
+
+/*
+Checks the software backend's glyph cache. Drawing the same text twice must render each glyph once and then draw it from the cache, and a cache
+that's too small for the text must keep flushing without changing what's drawn. Each line of the text repeats the same three glyphs and fits
+on the surface so no glyphs are culled.
+*/
+#define TEST_GLYPH_CACHE_SMALL_CAPACITY  2
+
+static const char g_glyphCacheText[] = "abc\nabc";
+
+md_bool32 test__glyph_cache_stats_are(md_font* pFont, const char* pTestName, md_uint64 hitCount, md_uint64 missCount, md_uint32 glyphCount, md_uint32 capacity)
+{
+    md_glyph_cache_stats stats;
+
+    if (md_font_get_glyph_cache_stats(pFont, &stats) != MD_SUCCESS) {
+        print_error("test__text_glyph_cache (%s): md_font_get_glyph_cache_stats() failed.\n", pTestName);
+        return MD_FALSE;
+    }
+
+    if (stats.hitCount != hitCount || stats.missCount != missCount || stats.glyphCount != glyphCount || stats.capacity != capacity) {
+        print_error("test__text_glyph_cache (%s): %d hits, %d misses and %d of %d glyphs. Expected %d hits, %d misses and %d of %d glyphs.\n", pTestName,
+            (int)stats.hitCount, (int)stats.missCount, (int)stats.glyphCount, (int)stats.capacity, (int)hitCount, (int)missCount, (int)glyphCount, (int)capacity);
+        return MD_FALSE;
+    }
+
+    return MD_TRUE;
+}
+
+/* Draws the text onto a cleared surface and reads back the pixels. */
+md_result test__glyph_cache_draw(test_software_context* pContext, md_font* pFont)
+{
+    test__software_reset(pContext);
+    md_gc_draw_text_utf8(&pContext->gc, pFont, g_glyphCacheText, MD_COUNTOF(g_glyphCacheText) - 1, 0, 0, md_alignment_left, md_alignment_top, NULL);
+
+    return test__software_read_pixels(pContext);
+}
+
+int test__text_glyph_cache()
+{
+    md_result result;
+    test_software_context context;
+    md_font font;
+    md_font fontSmall;
+    md_font_config fontConfig;
+    md_uint8 pixels[TEST_SOFTWARE_SIZE*TEST_SOFTWARE_SIZE*4];
+    size_t iPixel;
+    md_bool32 hasPixels;
+    md_bool32 isFontSmallInitialized = MD_FALSE;
+
+    result = test__software_init(&context);
+    if (result != MD_SUCCESS) {
+        return result;
+    }
+
+    md_gc_set_text_fg_color(&context.gc, md_rgba(255, 255, 255, 255));
+
+    test__text_font_config_init(&fontConfig);
+
+    result = md_font_init(&context.api, &fontConfig, &font);
+    if (result != MD_SUCCESS) {
+        print_error("test__text_glyph_cache: md_font_init() failed.\n");
+        goto done_context;
+    }
+
+    fontConfig.software.glyphCacheCapacity = TEST_GLYPH_CACHE_SMALL_CAPACITY;
+
+    result = md_font_init(&context.api, &fontConfig, &fontSmall);
+    if (result != MD_SUCCESS) {
+        print_error("test__text_glyph_cache: md_font_init() failed for the small cache.\n");
+        goto done;
+    }
+    isFontSmallInitialized = MD_TRUE;
+
+    result = MD_ERROR;
+
+    if (!test__glyph_cache_stats_are(&font, "initial", 0, 0, 0, 1024)) {
+        goto done;
+    }
+
+    /* The first time through each of the three glyphs is a miss and the second line is all hits. */
+    if (test__glyph_cache_draw(&context, &font) != MD_SUCCESS || !test__glyph_cache_stats_are(&font, "first draw", 3, 3, 3, 1024)) {
+        goto done;
+    }
+
+    MD_COPY_MEMORY(pixels, context.pixels, sizeof(pixels));
+
+    hasPixels = MD_FALSE;
+    for (iPixel = 0; iPixel < sizeof(pixels); iPixel += 1) {
+        if (pixels[iPixel] != 0) {
+            hasPixels = MD_TRUE;
+            break;
+        }
+    }
+
+    if (!hasPixels) {
+        print_error("test__text_glyph_cache: Nothing was drawn.\n");
+        goto done;
+    }
+
+    if (test__glyph_cache_draw(&context, &font) != MD_SUCCESS || !test__glyph_cache_stats_are(&font, "second draw", 9, 3, 3, 1024)) {
+        goto done;
+    }
+
+    if (memcmp(context.pixels, pixels, sizeof(pixels)) != 0) {
+        print_error("test__text_glyph_cache: Drawing from the cache does not match the first draw.\n");
+        goto done;
+    }
+
+    /*
+    With room for two glyphs the cache is flushed whenever the third distinct glyph comes along. The text cycles through three glyphs so every
+    one of them is a miss.
+    */
+    if (test__glyph_cache_draw(&context, &fontSmall) != MD_SUCCESS || !test__glyph_cache_stats_are(&fontSmall, "small cache, first draw", 0, 6, 2, TEST_GLYPH_CACHE_SMALL_CAPACITY)) {
+        goto done;
+    }
+
+    if (memcmp(context.pixels, pixels, sizeof(pixels)) != 0) {
+        print_error("test__text_glyph_cache: Drawing with a small cache does not match the default cache.\n");
+        goto done;
+    }
+
+    if (test__glyph_cache_draw(&context, &fontSmall) != MD_SUCCESS || !test__glyph_cache_stats_are(&fontSmall, "small cache, second draw", 0, 12, 2, TEST_GLYPH_CACHE_SMALL_CAPACITY)) {
+        goto done;
+    }
+
+    if (memcmp(context.pixels, pixels, sizeof(pixels)) != 0) {
+        print_error("test__text_glyph_cache: Drawing with a small cache after a flush does not match the default cache.\n");
+        goto done;
+    }
+
+    result = MD_SUCCESS;
+
+done:
+    if (isFontSmallInitialized) {
+        md_font_uninit(&fontSmall);
+    }
+    md_font_uninit(&font);
+done_context:
+    test__software_uninit(&context);
+    return result;
+}
+
+/*
+Checks that drawing a text layout only lays out the visible lines without changing what ends up on the surface. Each layout is drawn with a
+clip that cuts through lines and through glyphs, and the result is compared against a reference where the clip is reset and the bounds fit
+the whole text exactly so there's nothing to cull. The reference is positioned with textOffsetY so that its lines land in the same place.
+The surface is tall enough for all of the text so the reference draws every line, and for each alignment there are lines culled above and
+below the clip.
+*/
+#define TEST_CULLING_SIZE_X  32
+#define TEST_CULLING_SIZE_Y  128
+#define TEST_CULLING_TEXT_SIZE_Y    80     /* 10 lines of 8 pixels. */
+#define TEST_CULLING_BOUNDS_Y       32
+#define TEST_CULLING_BOUNDS_SIZE_Y  48
+#define TEST_CULLING_CLIP_LEFT      4
+#define TEST_CULLING_CLIP_TOP       50
+#define TEST_CULLING_CLIP_RIGHT     21
+#define TEST_CULLING_CLIP_BOTTOM    62
+
+static const char g_cullingText[] = "0\n1a\n2ab\n3abc\n4\n5a\n6ab\n7abc\n8\n9a";
+
+/* Clears the whole surface to transparent and reads it back after drawing the layout. */
+md_result test__culling_draw(md_gc* pGC, md_font* pFont, const md_text_layout* pLayout, md_bool32 isClipped, md_uint8* pPixels)
+{
+    md_gc_reset_clip(pGC);
+    md_gc_set_fill_brush_solid(pGC, md_rgba(0, 0, 0, 0));
+    md_gc_rectangle(pGC, 0, 0, TEST_CULLING_SIZE_X, TEST_CULLING_SIZE_Y);
+    md_gc_fill(pGC);
+
+    if (isClipped) {
+        md_gc_rectangle(pGC, TEST_CULLING_CLIP_LEFT, TEST_CULLING_CLIP_TOP, TEST_CULLING_CLIP_RIGHT, TEST_CULLING_CLIP_BOTTOM);
+        md_gc_clip(pGC);
+    }
+
+    md_gc_set_text_fg_color(pGC, md_rgba(255, 255, 255, 255));
+    md_gc_set_text_bg_color(pGC, md_rgba(0, 0, 255, 255));
+    md_gc_draw_text_layout_utf8(pGC, pFont, g_cullingText, MD_COUNTOF(g_cullingText) - 1, pLayout);
+    md_gc_reset_clip(pGC);
+
+    return md_gc_get_image_data(pGC, md_format_rgba, pPixels);
+}
+
+int test__text_layout_culling()
+{
+    md_result result;
+    md_api api;
+    md_font font;
+    md_gc gc;
+    md_gc_config gcConfig;
+    md_text_layout layout;
+    md_text_layout reference;
+    md_uint8 pixels[TEST_CULLING_SIZE_X*TEST_CULLING_SIZE_Y*4];
+    md_uint8 pixelsReference[TEST_CULLING_SIZE_X*TEST_CULLING_SIZE_Y*4];
+    size_t iCase;
+    md_int32 x;
+    md_int32 y;
+
+    /* Where the first line starts for each alignment. The text is taller than the bounds so it starts above them when centered or aligned to the bottom. */
+    static const struct
+    {
+        const char* pName;
+        md_alignment alignmentY;
+        md_int32 originY;
+    } cases[] = {
+        { "top",    md_alignment_top,    TEST_CULLING_BOUNDS_Y      },
+        { "center", md_alignment_center, TEST_CULLING_BOUNDS_Y + (TEST_CULLING_BOUNDS_SIZE_Y - TEST_CULLING_TEXT_SIZE_Y)/2 },
+        { "bottom", md_alignment_bottom, TEST_CULLING_BOUNDS_Y + (TEST_CULLING_BOUNDS_SIZE_Y - TEST_CULLING_TEXT_SIZE_Y)   }
+    };
+
+    result = test__text_init(&api, &font);
+    if (result != MD_SUCCESS) {
+        return result;
+    }
+
+    MD_ZERO_OBJECT(&gcConfig);
+    gcConfig.sizeX  = TEST_CULLING_SIZE_X;
+    gcConfig.sizeY  = TEST_CULLING_SIZE_Y;
+    gcConfig.format = md_format_rgba;
+
+    result = md_gc_init(&api, &gcConfig, &gc);
+    if (result != MD_SUCCESS) {
+        print_error("test__text_layout_culling: md_gc_init() failed.\n");
+        goto done_font;
+    }
+
+    for (iCase = 0; iCase < MD_COUNTOF(cases); iCase += 1) {
+        md_bool32 hasGlyphPixels = MD_FALSE;
+
+        layout = md_text_layout_init_default();
+        layout.boundsY     = TEST_CULLING_BOUNDS_Y;
+        layout.boundsSizeX = TEST_CULLING_SIZE_X;
+        layout.boundsSizeY = TEST_CULLING_BOUNDS_SIZE_Y;
+        layout.alignmentY  = cases[iCase].alignmentY;
+
+        reference = md_text_layout_init_default();
+        reference.boundsY     = cases[iCase].originY;
+        reference.boundsSizeX = TEST_CULLING_SIZE_X;
+        reference.boundsSizeY = TEST_CULLING_TEXT_SIZE_Y;
+
+        result = test__culling_draw(&gc, &font, &layout, MD_TRUE, pixels);
+        if (result == MD_SUCCESS) {
+            result = test__culling_draw(&gc, &font, &reference, MD_FALSE, pixelsReference);
+        }
+
+        if (result != MD_SUCCESS) {
+            print_error("test__text_layout_culling (%s): Failed to read the pixels.\n", cases[iCase].pName);
+            goto done;
+        }
+
+        /* Inside the bounds and the clip the pixels must be the same as the reference. Everything else must be left alone. */
+        for (y = 0; y < TEST_CULLING_SIZE_Y; y += 1) {
+            for (x = 0; x < TEST_CULLING_SIZE_X; x += 1) {
+                size_t iPixel = ((size_t)y*TEST_CULLING_SIZE_X + x) * 4;
+                const md_uint8* pPixel = pixels + iPixel;
+                md_uint8 expected[4] = { 0, 0, 0, 0 };
+
+                if (x >= TEST_CULLING_CLIP_LEFT && x < TEST_CULLING_CLIP_RIGHT &&
+                    y >= MD_MAX(TEST_CULLING_CLIP_TOP, TEST_CULLING_BOUNDS_Y) && y < MD_MIN(TEST_CULLING_CLIP_BOTTOM, TEST_CULLING_BOUNDS_Y + TEST_CULLING_BOUNDS_SIZE_Y)) {
+                    MD_COPY_MEMORY(expected, pixelsReference + iPixel, 4);
+                    if (expected[0] != 0) {
+                        hasGlyphPixels = MD_TRUE;
+                    }
+                }
+
+                if (memcmp(pPixel, expected, 4) != 0) {
+                    result = MD_ERROR;
+                    print_error("test__text_layout_culling (%s): Pixel (%d, %d) is (%d, %d, %d, %d). Expected (%d, %d, %d, %d).\n", cases[iCase].pName, (int)x, (int)y,
+                        pPixel[0], pPixel[1], pPixel[2], pPixel[3], expected[0], expected[1], expected[2], expected[3]);
+                    goto done;
+                }
+            }
+        }
+
+        /* Make sure there's actually some text in the clip. The background alone would match even if every line was culled. */
+        if (!hasGlyphPixels) {
+            result = MD_ERROR;
+            print_error("test__text_layout_culling (%s): No glyphs were drawn inside the clip.\n", cases[iCase].pName);
+            goto done;
+        }
+    }
+
+    result = MD_SUCCESS;
+
+done:
+    md_gc_uninit(&gc);
+done_font:
+    test__text_uninit(&api, &font);
+    return result;
+}
+
+int test__text()
+{
+    int result = 0;
+
+    result = test__text_line_breaks();
+    if (result != 0) {
+        return result;
+    }
+
+    result = test__text_block_edits();
+    if (result != 0) {
+        return result;
+    }
+
+    result = test__text_run_index();
+    if (result != 0) {
+        return result;
+    }
+
+    result = test__text_layout_batch_queries();
+    if (result != 0) {
+        return result;
+    }
+
+    result = test__text_fast_shaping();
+    if (result != 0) {
+        return result;
+    }
+
+    result = test__text_shape_cache();
+    if (result != 0) {
+        return result;
+    }
+
+    result = test__text_encodings();
+    if (result != 0) {
+        return result;
+    }
+
+    result = test__text_item_buffer();
+    if (result != 0) {
+        return result;
+    }
+
+    result = test__text_glyph_cache();
+    if (result != 0) {
+        return result;
+    }
+
+    result = test__text_layout_culling();
+    if (result != 0) {
+        return result;
+    }
+
+    return 0;
+}
+
+
+int main(int argc, char** argv)
+{
+    int result = 0;
+
+    /* UTF Conversion */
+    if (test__utf_conversion() != 0) {
+        result = 1;
+    }
+
+    /* Software Backend */
+    if (test__software() != 0) {
+        result = 1;
+    }
+
+    /* Text */
+    if (test__text() != 0) {
+        result = 1;
+    }
+
+    (void)argc;
+    (void)argv;
+    return result;
 }
@@ -242,25 +242,23 @@ int mdbuild_itoa_s(int value, char* dst, size_t dstSizeInBytes, int radix)
 }
 
 
+/* The input string is freed. Use it like `str = mdbuild_string_append(str, other)`. */
 char* mdbuild_string_append(char* str, const char* other)
 {
     size_t len0;
     size_t len1;
+    char* newStr;
 
-    if (str == NULL) {
-        str = "";
-    }
-
-    len0 = strlen(str);
+    len0 = (str != NULL) ? strlen(str) : 0;
     len1 = strlen(other);
     
-    char* newStr = (char*)malloc(len0 + len1 + 1);
+    newStr = (char*)realloc(str, len0 + len1 + 1);
     if (newStr == NULL) {
+        free(str);
         return NULL;
     }
 
-    strcpy_s(newStr,        len0 + len1 + 1, str);
-    strcpy_s(newStr + len0,        len1 + 1, other);
+    memcpy(newStr + len0, other, len1 + 1);
 
     return newStr;
 }
@@ -308,9 +306,14 @@ typedef struct
 typedef struct
 {
     mdbuild_ucd_proplist proplist;
+    mdbuild_ucd_proplist linebreak;     /* LineBreak.txt has the same layout as PropList.txt. The category is the line breaking class. */
 } mdbuild_ucd;
 
-mdbuild_result mdbuild_ucd_proplist_load(mdbuild_ucd_proplist* pPropList)
+/*
+Loads a UCD file made up of lines in the form "XXXX..YYYY ; Value # Comment". This is the format used by PropList.txt, LineBreak.txt and
+others. Comment lines and blank lines are skipped.
+*/
+mdbuild_result mdbuild_ucd_proplist_load_file(mdbuild_ucd_proplist* pPropList, const char* filePath)
 {
     mdbuild_result result;
     size_t fileSize;
@@ -322,7 +325,7 @@ mdbuild_result mdbuild_ucd_proplist_load(mdbuild_ucd_proplist* pPropList)
 
     MDBUILD_ZERO_OBJECT(pPropList);
 
-    result = mdbuild_open_and_read_file(MDBUILD_UCD_PATH"/PropList.txt", &fileSize, (void**)&pPropList->_pRawData);
+    result = mdbuild_open_and_read_file(filePath, &fileSize, (void**)&pPropList->_pRawData);
     if (result != MDBUILD_SUCCESS) {
         return result;
     }
@@ -371,34 +374,28 @@ mdbuild_result mdbuild_ucd_proplist_load(mdbuild_ucd_proplist* pPropList)
                 char* cpEnd = NULL;
                 char* category = NULL;
 
-                /* First code point. */
+                /* First code point. Code points are at least 4 digits, but can be up to 6. */
                 cpBeg = pPropList->_pRawData + iByte;
                 cpEnd = cpBeg;
-                iByte += 4; /* This file uses a minimum of 4 characters for code points. We can safely skip past these. */
-                for (; iByte < fileSize; ++iByte) {
-                    if (pPropList->_pRawData[iByte] == '.') {
-                        /* We have a code point range. */
-                        pPropList->_pRawData[iByte] = '\0';
+                while (iByte < fileSize && mdbuild_is_hex_digit(pPropList->_pRawData[iByte])) {
+                    iByte += 1;
+                }
 
-                        /* Second code point. */
-                        iByte += 2; /* Skip past the ".." */
-                        cpEnd = pPropList->_pRawData + iByte;
-                        iByte += 4; /* This file uses a minimum of 4 characters for code points. We can safely skip past these. */
-                        for (; iByte < fileSize; ++iByte) {
-                            if (pPropList->_pRawData[iByte] == ' ' || pPropList->_pRawData[iByte] == ';') {
-                                pPropList->_pRawData[iByte] = '\0';
-                                break;  /* Found the end of the second code point. */
-                            }
-                        }
+                if (iByte + 2 < fileSize && pPropList->_pRawData[iByte] == '.') {
+                    /* We have a code point range. */
+                    pPropList->_pRawData[iByte] = '\0';
 
-                        break;
-                    } else {
-                        /* It's a single code point. */
-                        pPropList->_pRawData[iByte] = '\0';
-                        break;
+                    /* Second code point. */
+                    iByte += 2; /* Skip past the ".." */
+                    cpEnd = pPropList->_pRawData + iByte;
+                    while (iByte < fileSize && mdbuild_is_hex_digit(pPropList->_pRawData[iByte])) {
+                        iByte += 1;
                     }
                 }
 
+                /* This will be a space or semi-colon. */
+                pPropList->_pRawData[iByte] = '\0';
+
                 /* Now we need to retrieve the category name. The first character that is not a space and not a semi-colon is the start of the category name. */
                 iByte += 1;
                 for (; iByte < fileSize; ++iByte) {
@@ -436,6 +433,11 @@ mdbuild_result mdbuild_ucd_proplist_load(mdbuild_ucd_proplist* pPropList)
     return MDBUILD_SUCCESS;
 }
 
+mdbuild_result mdbuild_ucd_proplist_load(mdbuild_ucd_proplist* pPropList)
+{
+    return mdbuild_ucd_proplist_load_file(pPropList, MDBUILD_UCD_PATH"/PropList.txt");
+}
+
 void mdbuild_ucd_proplist_unload(mdbuild_ucd_proplist* pPropList)
 {
     assert(pPropList != NULL);
@@ -462,11 +464,6 @@ mdbuild_result mdbuild_ucd_proplist_generate_code__is_null_or_whitespace_utf8(md
         if (strcmp(pItem->category, "White_Space") == 0) {
             const char* utf8LenStr = "";
 
-            for (cp = pItem->cp.beg; cp <= pItem->cp.end; cp += 1) {
-                printf("%d\n", cp);
-            }
-            
-
             /* A quick little hack for sequential ASCII characters. This will be made generic later. */
             if (pItem->cp.beg <= 0x7F && pItem->cp.end <= 0x7F && pItem->cp.beg != pItem->cp.end) {
                 utf8LenStr = "1";
@@ -539,6 +536,210 @@ mdbuild_result mdbuild_ucd_proplist_generate_code__is_null_or_whitespace_utf8(md
 }
 
 
+/*
+The line breaking classes from UAX #14, in the order they're assigned in the generated md_line_break_class enum. Code points that aren't
+listed in LineBreak.txt, or have a class that isn't listed here, are given XX which is always zero.
+*/
+static const char* g_mdbuildLineBreakClassNames[] = {
+    "XX", "BK", "CR", "LF", "CM", "NL", "SG", "WJ", "ZW", "GL", "SP", "ZWJ", "B2", "BA", "BB", "HY", "CB", "CL", "CP", "EX", "IN", "NS",
+    "OP", "QU", "IS", "NU", "PO", "PR", "SY", "AI", "AL", "CJ", "EB", "EM", "H2", "H3", "HL", "ID", "JL", "JV", "JT", "RI", "SA"
+};
+
+/*
+The line break table is made up of three stages. The code point space is split into blocks of (1 << MDBUILD_LINE_BREAK_BLOCK_SHIFT)
+code points, and identical blocks are only stored once. The list of block indices is itself split into chunks of
+(1 << MDBUILD_LINE_BREAK_CHUNK_SHIFT) blocks which are also only stored once. The sizes below give the smallest table for the current UCD.
+*/
+#define MDBUILD_LINE_BREAK_BLOCK_SHIFT  4
+#define MDBUILD_LINE_BREAK_CHUNK_SHIFT  5
+#define MDBUILD_CODE_POINT_COUNT        0x110000
+
+static char* mdbuild_string_append_uint_array(char* pCodeOut, const char* type, const char* name, const mdbuild_uint32* pValues, size_t count, size_t valuesPerLine)
+{
+    char str[256];
+    size_t i;
+
+    sprintf(str, "static const %s %s[%u] = {\n", type, name, (unsigned int)count);
+    pCodeOut = mdbuild_string_append(pCodeOut, str);
+
+    for (i = 0; i < count; i += 1) {
+        if ((i % valuesPerLine) == 0) {
+            pCodeOut = mdbuild_string_append(pCodeOut, "    ");
+        }
+
+        sprintf(str, "%u%s", (unsigned int)pValues[i], (i + 1 < count) ? "," : "");
+        pCodeOut = mdbuild_string_append(pCodeOut, str);
+
+        if ((i % valuesPerLine) == valuesPerLine - 1 || i + 1 == count) {
+            pCodeOut = mdbuild_string_append(pCodeOut, "\n");
+        }
+    }
+
+    pCodeOut = mdbuild_string_append(pCodeOut, "};\n");
+    return pCodeOut;
+}
+
+mdbuild_result mdbuild_ucd_linebreak_generate_code__get_line_break_class(mdbuild_ucd_proplist* pLineBreak, char** ppCodeOut)
+{
+    char* pCodeOut = NULL;
+    char str[256];
+    size_t iItem;
+    size_t iClass;
+    size_t iBlock;
+    size_t iChunk;
+    mdbuild_utf32 cp;
+    mdbuild_uint8* pClasses;        /* One for each code point. */
+    mdbuild_uint32* pBlocks;        /* The unique blocks. Each entry is the class of a code point. */
+    mdbuild_uint32* pBlockIndices;  /* For each block in the code point space, the index of the unique block. */
+    mdbuild_uint32* pChunks;        /* The unique chunks. Each entry is the index of a unique block. */
+    mdbuild_uint32* pChunkIndices;  /* For each chunk in the code point space, the index of the unique chunk. */
+    size_t uniqueBlockCount = 0;
+    size_t uniqueChunkCount = 0;
+    const size_t blockSize  = (size_t)1 << MDBUILD_LINE_BREAK_BLOCK_SHIFT;
+    const size_t chunkSize  = (size_t)1 << MDBUILD_LINE_BREAK_CHUNK_SHIFT;
+    const size_t blockCount = MDBUILD_CODE_POINT_COUNT >> MDBUILD_LINE_BREAK_BLOCK_SHIFT;
+    const size_t chunkCount = blockCount >> MDBUILD_LINE_BREAK_CHUNK_SHIFT;
+
+    assert(pLineBreak != NULL);
+    assert(ppCodeOut  != NULL);
+
+    *ppCodeOut = NULL;
+
+    pClasses      = (mdbuild_uint8* )calloc(MDBUILD_CODE_POINT_COUNT, sizeof(*pClasses));
+    pBlocks       = (mdbuild_uint32*)malloc(MDBUILD_CODE_POINT_COUNT * sizeof(*pBlocks));
+    pBlockIndices = (mdbuild_uint32*)malloc(blockCount * sizeof(*pBlockIndices));
+    pChunks       = (mdbuild_uint32*)malloc(blockCount * sizeof(*pChunks));
+    pChunkIndices = (mdbuild_uint32*)malloc(chunkCount * sizeof(*pChunkIndices));
+    if (pClasses == NULL || pBlocks == NULL || pBlockIndices == NULL || pChunks == NULL || pChunkIndices == NULL) {
+        free(pClasses);
+        free(pBlocks);
+        free(pBlockIndices);
+        free(pChunks);
+        free(pChunkIndices);
+        return MDBUILD_OUT_OF_MEMORY;
+    }
+
+    /* Flatten the ranges out to one class per code point. */
+    for (iItem = 0; iItem < pLineBreak->itemCount; ++iItem) {
+        mdbuild_ucd_proplist_item* pItem = &pLineBreak->pItems[iItem];
+        mdbuild_uint8 lineBreakClass = 0;
+
+        for (iClass = 0; iClass < sizeof(g_mdbuildLineBreakClassNames) / sizeof(g_mdbuildLineBreakClassNames[0]); ++iClass) {
+            if (strcmp(pItem->category, g_mdbuildLineBreakClassNames[iClass]) == 0) {
+                lineBreakClass = (mdbuild_uint8)iClass;
+                break;
+            }
+        }
+
+        if (iClass == sizeof(g_mdbuildLineBreakClassNames) / sizeof(g_mdbuildLineBreakClassNames[0])) {
+            fprintf(stderr, "Unknown line break class \"%s\". Treating as XX.\n", pItem->category);
+        }
+
+        for (cp = pItem->cp.beg; cp <= pItem->cp.end && cp < MDBUILD_CODE_POINT_COUNT; cp += 1) {
+            pClasses[cp] = lineBreakClass;
+        }
+    }
+
+    /* Find the unique blocks. */
+    for (iBlock = 0; iBlock < blockCount; ++iBlock) {
+        const mdbuild_uint8* pBlockClasses = pClasses + (iBlock * blockSize);
+        size_t iUniqueBlock;
+
+        for (iUniqueBlock = 0; iUniqueBlock < uniqueBlockCount; ++iUniqueBlock) {
+            size_t i;
+            for (i = 0; i < blockSize; ++i) {
+                if (pBlocks[iUniqueBlock*blockSize + i] != pBlockClasses[i]) {
+                    break;
+                }
+            }
+
+            if (i == blockSize) {
+                break;  /* Found it. */
+            }
+        }
+
+        if (iUniqueBlock == uniqueBlockCount) {
+            size_t i;
+            for (i = 0; i < blockSize; ++i) {
+                pBlocks[uniqueBlockCount*blockSize + i] = pBlockClasses[i];
+            }
+
+            uniqueBlockCount += 1;
+        }
+
+        pBlockIndices[iBlock] = (mdbuild_uint32)iUniqueBlock;
+    }
+
+    /* Now the unique chunks of block indices. */
+    for (iChunk = 0; iChunk < chunkCount; ++iChunk) {
+        const mdbuild_uint32* pChunkBlocks = pBlockIndices + (iChunk * chunkSize);
+        size_t iUniqueChunk;
+
+        for (iUniqueChunk = 0; iUniqueChunk < uniqueChunkCount; ++iUniqueChunk) {
+            if (memcmp(pChunks + iUniqueChunk*chunkSize, pChunkBlocks, chunkSize * sizeof(*pChunkBlocks)) == 0) {
+                break;
+            }
+        }
+
+        if (iUniqueChunk == uniqueChunkCount) {
+            memcpy(pChunks + uniqueChunkCount*chunkSize, pChunkBlocks, chunkSize * sizeof(*pChunkBlocks));
+            uniqueChunkCount += 1;
+        }
+
+        pChunkIndices[iChunk] = (mdbuild_uint32)iUniqueChunk;
+    }
+
+    /* The enum. */
+    pCodeOut = mdbuild_string_append(pCodeOut, "/* Line breaking classes from UAX #14. Generated by tools/minidraw_build from LineBreak.txt. */\n");
+    pCodeOut = mdbuild_string_append(pCodeOut, "typedef enum\n{\n");
+    for (iClass = 0; iClass < sizeof(g_mdbuildLineBreakClassNames) / sizeof(g_mdbuildLineBreakClassNames[0]); ++iClass) {
+        size_t i;
+        char name[16];
+
+        for (i = 0; g_mdbuildLineBreakClassNames[iClass][i] != '\0'; ++i) {
+            name[i] = (char)tolower(g_mdbuildLineBreakClassNames[iClass][i]);
+        }
+        name[i] = '\0';
+
+        sprintf(str, "    md_line_break_class_%s%s = %u%s\n", name, (i == 2) ? " " : "", (unsigned int)iClass, (iClass + 1 < sizeof(g_mdbuildLineBreakClassNames) / sizeof(g_mdbuildLineBreakClassNames[0])) ? "," : "");
+        pCodeOut = mdbuild_string_append(pCodeOut, str);
+    }
+    pCodeOut = mdbuild_string_append(pCodeOut, "} md_line_break_class;\n\n");
+
+    /* The tables. */
+    pCodeOut = mdbuild_string_append_uint_array(pCodeOut, (uniqueChunkCount <= 256) ? "md_uint8 " : "md_uint16", "g_mdLineBreakChunks", pChunkIndices, chunkCount, 32);
+    pCodeOut = mdbuild_string_append(pCodeOut, "\n");
+    pCodeOut = mdbuild_string_append_uint_array(pCodeOut, (uniqueBlockCount <= 256) ? "md_uint8 " : "md_uint16", "g_mdLineBreakBlocks", pChunks, uniqueChunkCount * chunkSize, chunkSize);
+    pCodeOut = mdbuild_string_append(pCodeOut, "\n");
+    pCodeOut = mdbuild_string_append_uint_array(pCodeOut, "md_uint8 ", "g_mdLineBreakClasses", pBlocks, uniqueBlockCount * blockSize, blockSize);
+    pCodeOut = mdbuild_string_append(pCodeOut, "\n");
+
+    /* The lookup. */
+    pCodeOut = mdbuild_string_append(pCodeOut, "static md_line_break_class md_get_line_break_class(md_utf32 cp)\n{\n");
+    pCodeOut = mdbuild_string_append(pCodeOut, "    md_uint32 block;\n\n");
+    sprintf(str, "    if (cp > 0x%X) {\n        return md_line_break_class_xx;\n    }\n\n", MDBUILD_CODE_POINT_COUNT - 1);
+    pCodeOut = mdbuild_string_append(pCodeOut, str);
+    sprintf(str, "    block = g_mdLineBreakBlocks[(g_mdLineBreakChunks[cp >> %d] << %d) + ((cp >> %d) & %d)];\n", MDBUILD_LINE_BREAK_BLOCK_SHIFT + MDBUILD_LINE_BREAK_CHUNK_SHIFT, MDBUILD_LINE_BREAK_CHUNK_SHIFT, MDBUILD_LINE_BREAK_BLOCK_SHIFT, (int)chunkSize - 1);
+    pCodeOut = mdbuild_string_append(pCodeOut, str);
+    sprintf(str, "    return (md_line_break_class)g_mdLineBreakClasses[(block << %d) + (cp & %d)];\n", MDBUILD_LINE_BREAK_BLOCK_SHIFT, (int)blockSize - 1);
+    pCodeOut = mdbuild_string_append(pCodeOut, str);
+    pCodeOut = mdbuild_string_append(pCodeOut, "}\n");
+
+    free(pClasses);
+    free(pBlocks);
+    free(pBlockIndices);
+    free(pChunks);
+    free(pChunkIndices);
+
+    if (pCodeOut == NULL) {
+        return MDBUILD_OUT_OF_MEMORY;
+    }
+
+    *ppCodeOut = pCodeOut;
+    return MDBUILD_SUCCESS;
+}
+
+
 mdbuild_result mdbuild_ucd_load(mdbuild_ucd* pUCD)
 {
     mdbuild_result result;
@@ -550,12 +751,19 @@ mdbuild_result mdbuild_ucd_load(mdbuild_ucd* pUCD)
         return result;
     }
 
+    result = mdbuild_ucd_proplist_load_file(&pUCD->linebreak, MDBUILD_UCD_PATH"/LineBreak.txt");
+    if (result != MDBUILD_SUCCESS) {
+        mdbuild_ucd_proplist_unload(&pUCD->proplist);
+        return result;
+    }
+
     return MDBUILD_SUCCESS;
 }
 
 void mdbuild_ucd_unload(mdbuild_ucd* pUCD)
 {
     assert(pUCD != NULL);
+    mdbuild_ucd_proplist_unload(&pUCD->linebreak);
     mdbuild_ucd_proplist_unload(&pUCD->proplist);
 }
 
@@ -563,17 +771,27 @@ mdbuild_result mdbuild_ucd_generate_code(mdbuild_ucd* pUCD)
 {
     mdbuild_result result;
     char* pCodeGen_IsNullOrWhitespaceUTF8;
+    char* pCodeGen_GetLineBreakClass;
 
     assert(pUCD != NULL);
 
     result = mdbuild_ucd_proplist_generate_code__is_null_or_whitespace_utf8(&pUCD->proplist, &pCodeGen_IsNullOrWhitespaceUTF8);
-    if (result == MDBUILD_SUCCESS) {
+    if (result != MDBUILD_SUCCESS) {
+        return result;
+    }
+
+    result = mdbuild_ucd_linebreak_generate_code__get_line_break_class(&pUCD->linebreak, &pCodeGen_GetLineBreakClass);
+    if (result != MDBUILD_SUCCESS) {
+        free(pCodeGen_IsNullOrWhitespaceUTF8);
         return result;
     }
 
     printf("%s", pCodeGen_IsNullOrWhitespaceUTF8);
+    printf("\n\n");
+    printf("%s", pCodeGen_GetLineBreakClass);
 
 
+    free(pCodeGen_GetLineBreakClass);
     free(pCodeGen_IsNullOrWhitespaceUTF8);
     return MDBUILD_SUCCESS;
 }